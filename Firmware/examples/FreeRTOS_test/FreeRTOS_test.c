@@ -99,3 +99,8 @@ void vApplicationIdleHook( void )
 {
 }
 
+void vApplicationStackOverflowHook( xTaskHandle *pxTask, signed portCHAR *pcTaskName )
+{
+	// required since configCHECK_FOR_STACK_OVERFLOW is on; just halt here
+	while(1) ;
+}
@@ -0,0 +1,200 @@
+/*
+ *   Cycle-count microbenchmarks for the hot kernels of the autopilot.
+ *
+ *   Runs every kernel RUNS times under the free-running cycle counter of
+ *   the timer lib (TMR4/TMR5 at FCY) and prints a cycles-per-call table
+ *   over uart1. The empty-loop baseline is printed first; subtract it
+ *   from the other rows for the cost of the kernel itself.
+ *
+ *   Use this as the before/after measurement for any optimization work:
+ *   a regression between releases shows up here long before it shows up
+ *   in flight behavior.
+ *
+ *   @author   Tom Pycke
+ *   @date     31-aug-2026
+ */
+#include <stdio.h>
+#include <math.h>
+
+#include "microcontroller/microcontroller.h"
+#include "uart1/uart1.h"
+#include "timer/timer.h"
+#include "fastmath/fastmath.h"
+#include "matrix/matrix.h"
+#include "quaternion/quaternion.h"
+#include "pid/pid.h"
+
+#define RUNS 100
+
+//! Sinks the results so the compiler cannot optimize a kernel away.
+volatile float sink_f = 0.0f;
+volatile int sink_i = 0;
+volatile long sink_l = 0;
+
+static unsigned long t_start;
+
+static void bench_begin()
+{
+	t_start = timer_ticks_32();
+}
+
+static void bench_end(char *name)
+{
+	unsigned long cycles = timer_ticks_32() - t_start;
+	printf("%s: %lu cycles/call\n\r", name, cycles / RUNS);
+}
+
+
+//! Minimal integer printer, the same digit loop communication_csv.c uses
+//! to avoid the printf machinery in the telemetry path.
+static int format_int(char *dst, int x)
+{
+	char buf[7];
+	int i = 0, n = 0;
+
+	if (x < 0)
+	{
+		dst[n++] = '-';
+		x = -x;
+	}
+	do
+	{
+		buf[i++] = '0' + (x % 10);
+		x /= 10;
+	} while (x > 0);
+	while (i > 0)
+		dst[n++] = buf[--i];
+	return n;
+}
+
+
+int main()
+{
+	int i;
+	float q[4];
+	float A23[6] = { 0.02f, 0.0f, -0.02f, 0.0f, 0.02f, 0.01f };
+	float B33[9] = { 1.0f, 0.0f, 0.02f, 0.0f, 1.0f, -0.01f, 0.0f, 0.0f, 1.0f };
+	float R23[6];
+	char buf[16];
+	struct pid pid;
+	struct pid_fixed pidf;
+
+	microcontroller_init();
+	uart1_open(115200L);
+
+	printf("\n\rGluonpilot microbenchmarks [%s %s], %d runs per kernel\n\r\n\r", __DATE__, __TIME__, RUNS);
+
+	timer_init_freerunning();
+	fastmath_init();
+
+	quaternion_from_attitude(0.1f, 0.2f, 0.3f, q);
+	pid_init(&pid, 0.02f, 0.7f, 0.1f, -1.0f, 1.0f, 0.0f);
+	pid_fixed_init(&pidf, &pid, 630.0f, 0.004f, -800, 800);
+
+	while (1)
+	{
+		// loop overhead; subtract this from every other row
+		bench_begin();
+		for (i = 0; i < RUNS; i++)
+			sink_i = i;
+		bench_end("baseline (empty loop)");
+
+		// libm trigonometry against the fastmath replacements
+		bench_begin();
+		for (i = 0; i < RUNS; i++)
+			sink_f = sinf(0.01f * i);
+		bench_end("sinf");
+
+		bench_begin();
+		for (i = 0; i < RUNS; i++)
+			sink_f = fast_sin(0.01f * i);
+		bench_end("fast_sin");
+
+		bench_begin();
+		for (i = 0; i < RUNS; i++)
+			sink_f = atan2f(0.01f * i, 1.0f);
+		bench_end("atan2f");
+
+		bench_begin();
+		for (i = 0; i < RUNS; i++)
+			sink_f = fast_atan2(0.01f * i, 1.0f);
+		bench_end("fast_atan2");
+
+		bench_begin();
+		for (i = 0; i < RUNS; i++)
+			sink_f = 1.0f / sqrtf(1.0f + 0.01f * i);
+		bench_end("1/sqrtf");
+
+		bench_begin();
+		for (i = 0; i < RUNS; i++)
+			sink_f = fast_rsqrt(1.0f + 0.01f * i);
+		bench_end("fast_rsqrt");
+
+		// the matrix kernels of the kalman covariance update
+		bench_begin();
+		for (i = 0; i < RUNS; i++)
+		{
+			matrix_2x3_times_3x3(A23, B33, R23);
+			sink_f = R23[0];
+		}
+		bench_end("matrix_2x3_times_3x3");
+
+		bench_begin();
+		for (i = 0; i < RUNS; i++)
+		{
+			float det;
+			float Inv[9];
+			INVERT_3X3(Inv, det, B33);
+			sink_f = Inv[0];
+		}
+		bench_end("INVERT_3X3");
+
+		// quaternion attitude propagation (multicopter filter)
+		bench_begin();
+		for (i = 0; i < RUNS; i++)
+			quaternion_update_with_rates(0.01f, -0.02f, 0.005f, q, 0.004f);
+		bench_end("quaternion_update_with_rates");
+
+		bench_begin();
+		for (i = 0; i < RUNS; i++)
+			sink_f = quaternion_to_roll(q);
+		bench_end("quaternion_to_roll");
+
+		bench_begin();
+		for (i = 0; i < RUNS; i++)
+			quaternion_normalize(q);
+		bench_end("quaternion_normalize");
+
+		bench_begin();
+		for (i = 0; i < RUNS; i++)
+			quaternion_normalize_fast(q);
+		bench_end("quaternion_normalize_fast");
+
+		// the control loop PIDs: float against the incremental fixed-point one
+		bench_begin();
+		for (i = 0; i < RUNS; i++)
+			sink_f = pid_update(&pid, 0.001f * i, 0.004f);
+		bench_end("pid_update");
+
+		bench_begin();
+		for (i = 0; i < RUNS; i++)
+			sink_i = pid_fixed_update(&pidf, i);
+		bench_end("pid_fixed_update");
+
+		// formatting: the printf machinery against the plain digit loop
+		bench_begin();
+		for (i = 0; i < RUNS; i++)
+			sink_i = sprintf(buf, "%d", i - 50);
+		bench_end("sprintf %d");
+
+		bench_begin();
+		for (i = 0; i < RUNS; i++)
+			sink_i = format_int(buf, i - 50);
+		bench_end("format_int");
+
+		printf("\n\r");
+		microcontroller_delay_ms(5000);
+	}
+
+	return 0;
+}
@@ -53,9 +53,6 @@ static void vTickTask( void *pvParameters )
 	}
 }
 
-extern xQueueHandle xRxedChars;
-
-
 /*
  *   This task will wake when a character is received on uart1.
  *   It will parse a line into the several tokens (separated by a space).
@@ -81,7 +78,7 @@ static void vParseTask( void *pvParameters )
 	for( ;; )
 	{
 		/* Wait until it is time for the next cycle. */
-		if( xQueueReceive( xRxedChars, &tmp, portMAX_DELAY  ) )
+		if( uart1_queue_getc( &tmp, portMAX_DELAY ) )
         {
             // pcRxedMessage now points to the struct AMessage variable posted
             // by vATask.
@@ -134,3 +131,8 @@ void vApplicationIdleHook( void )
 {
 }
 
+void vApplicationStackOverflowHook( xTaskHandle *pxTask, signed portCHAR *pcTaskName )
+{
+	// required since configCHECK_FOR_STACK_OVERFLOW is on; just halt here
+	while(1) ;
+}
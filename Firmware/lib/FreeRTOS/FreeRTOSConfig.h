@@ -34,17 +34,31 @@ T5CONbits.TCS = 0;    \
 #define configMAX_PRIORITIES			( ( unsigned portBASE_TYPE ) 8 )
 //#define configMINIMAL_STACK_SIZE		( 115 )
 #define configMINIMAL_STACK_SIZE		( 215 )
-#define configTOTAL_HEAP_SIZE			( ( size_t ) 11300 )
+#ifdef STATIC_TASK_STACKS
+	/* The task stacks live in static arrays (rtos_pilot.c); the heap only
+	   serves the idle task, the TCBs and the queues/semaphores. */
+	#define configTOTAL_HEAP_SIZE		( ( size_t ) 3500 )
+#else
+	#define configTOTAL_HEAP_SIZE		( ( size_t ) 11300 )
+#endif
 #define configMAX_TASK_NAME_LEN			( 8 )
 #define configUSE_TRACE_FACILITY		0
 #define configUSE_16_BIT_TICKS			1
 #define configIDLE_SHOULD_YIELD			1
 
+/* Priority-inheritance mutexes guard uart1 and the SPI bus: a low-priority
+holder gets bumped to the priority of the highest waiter, so the console
+task can no longer sit on a lock while the task that holds it is preempted. */
+#define configUSE_MUTEXES				1
+
 /* Co-routine definitions. */
 #define configUSE_CO_ROUTINES 		1
 #define configMAX_CO_ROUTINE_PRIORITIES ( 2 )
 
-#define configCHECK_FOR_STACK_OVERFLOW 0
+/* Method 2 fills every stack with a pattern at creation and verifies it on
+each context switch; the application must supply vApplicationStackOverflowHook
+(rtos_pilot captures a blackbox crash dump there). */
+#define configCHECK_FOR_STACK_OVERFLOW 2
 
 /* Set the following definitions to 1 to include the API function, or zero
 to exclude the API function. */
@@ -70,6 +84,28 @@ to exclude the API function. */
     #define traceTASK_SWITCHED_IN()                    \
         if ((int) pxCurrentTCB->pxTaskTag > 0) \
             PORTD |= 1 << (( int ) pxCurrentTCB->pxTaskTag - 1);
+#elif defined PROFILING
+    /* Per-task CPU profiler (rtos_pilot/profiler.c owns the storage and
+    starts TMR4/TMR5 as one free-running 32-bit cycle counter): every
+    context switch books the elapsed cycles on the outgoing task's tag.
+    Tags run 1..8, bucket 0 catches kernel time and untagged tasks. Only
+    the rtos_pilot project defines PROFILING, so the example projects
+    keep linking tasks.c without profiler.c. */
+    extern volatile unsigned long ulProfilerTaskTime[ 9 ];
+    extern volatile unsigned long ulProfilerSwitchedInTime;
+
+    #define traceTASK_SWITCHED_OUT()                                        \
+    {                                                                       \
+        unsigned long ulNow;                                                \
+        int iTag;                                                           \
+        ulNow = ( unsigned long ) TMR4;   /* latches TMR5 into TMR5HLD */   \
+        ulNow |= ( unsigned long ) TMR5HLD << 16;                           \
+        iTag = ( int ) pxCurrentTCB->pxTaskTag;                             \
+        if( iTag < 0 || iTag > 8 )                                          \
+            iTag = 0;                                                       \
+        ulProfilerTaskTime[ iTag ] += ulNow - ulProfilerSwitchedInTime;     \
+        ulProfilerSwitchedInTime = ulNow;                                   \
+    }
 #endif
 
 #endif /* FREERTOS_CONFIG_H */
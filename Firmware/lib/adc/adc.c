@@ -1,11 +1,13 @@
 
 #include <adc.h>
 #include "microcontroller/microcontroller.h"
+#include "microcontroller/isr_time.h"
 #include "adc/adc.h"
 #include "configuration.h"
+#include "uart1_queue/uart1_queue.h"
 
 // Define Message Buffer Length for ECAN1/ECAN2
-#define  MAX_CHNUM	 			24		// Highest Analog input number in Channel Scan
+#define  MAX_CHNUM	 			ADC_NUM_CHANNELS	// Highest Analog input number in Channel Scan
 #define  SAMP_BUFF_SIZE	 		8		// Size of the input buffer per analog input
 int  NUM_CHS2SCAN=8;		// Number of channels enabled for channel scan
 
@@ -195,8 +197,19 @@ unsigned int ProcessADCSamples(unsigned int * AdcBuffer)
 
 unsigned int DmaBuffer = 0;
 
+// Oversampled results: full-precision sum of the 16 samples (both ping-pong
+// buffers) per scanned channel, decimated by 4 in the DMA completion
+// interrupt. Same scale as adc_get_channel(), but no sample is truncated
+// before the summation, so the result keeps the 2 extra bits the 16x
+// oversampling buys and the noise power drops by the full factor 16.
+static volatile unsigned int adc_filtered[MAX_CHNUM];
+static volatile unsigned int adc_epoch = 0;    // completed scans, see adc_get_scan()
+
 void __attribute__((interrupt, no_auto_psv)) _DMA0Interrupt(void)
 {
+	ISR_TIME_DECLARE;
+
+	ISR_TIME_ENTER();
 	if(DmaBuffer == 0)
 	{
 	/*	ProcessADCSamples(&BufferA[0][0]); 
@@ -208,7 +221,7 @@ void __attribute__((interrupt, no_auto_psv)) _DMA0Interrupt(void)
 		ProcessADCSamples(&BufferA[6][0]);
 		ProcessADCSamples(&BufferA[7][0]);
 	*/
-        //printf("\r\n%u %u %u %u\r\n", BufferA[23][0], BufferA[23][1], BufferA[23][2], BufferA[23][3]);
+        //uart1_printf("\r\n%u %u %u %u\r\n", BufferA[23][0], BufferA[23][1], BufferA[23][2], BufferA[23][3]);
 	}
 	else
 	{
@@ -223,17 +236,67 @@ void __attribute__((interrupt, no_auto_psv)) _DMA0Interrupt(void)
 	*/
 		adc_stop();
 		// we converted everything * 8 * 2buffers every 8ms
-	
+
+		// both buffers are fresh now: sum and decimate the scanned channels
+		{
+			int ch, s;
+			for (ch = 0; ch < MAX_CHNUM; ch++)
+			{
+				long sum = 0;
+
+				if (ch < 16)
+				{
+					if (! (AD1CSSL & (1 << ch)))
+						continue;
+				}
+				else
+				{
+					if (! (AD1CSSH & (1 << (ch - 16))))
+						continue;
+				}
+
+				for (s = 0; s < SAMP_BUFF_SIZE; s++)
+					sum += (long)BufferA[ch][s] + (long)BufferB[ch][s];
+
+				adc_filtered[ch] = (unsigned int) (sum >> 4);
+			}
+		}
+		adc_epoch++;
 	}
 
 	DmaBuffer ^= 1;
 
 	IFS0bits.DMA0IF = 0;		// Clear the DMA0 Interrupt Flag
+	ISR_TIME_EXIT(ISR_TIME_ADC);
 }
 
 
 unsigned int adc_get_channel(int i)
 {
-    //printf("\r\n%u %u %u %u\r\n", BufferA[i][0], BufferB[i][7], BufferA[i][6], BufferB[i][7]);
-	return ProcessADCSamples(&BufferA[i][0]) / 2 + ProcessADCSamples(&BufferB[i][0]) / 2; 
+    //uart1_printf("\r\n%u %u %u %u\r\n", BufferA[i][0], BufferB[i][7], BufferA[i][6], BufferB[i][7]);
+	return ProcessADCSamples(&BufferA[i][0]) / 2 + ProcessADCSamples(&BufferB[i][0]) / 2;
+}
+
+
+unsigned int adc_get_channel_filtered(int i)
+{
+	return adc_filtered[i];
+}
+
+
+/*!
+ *   Copies the most recently completed scan into *scan. The interrupts are
+ *   held off during the copy, so every channel comes from the same scan
+ *   burst - reading channel by channel can straddle a DMA completion and
+ *   mix two bursts, which shows up as inter-channel skew downstream.
+ */
+void adc_get_scan(struct AdcScan *scan)
+{
+	int ch;
+
+	INTERRUPT_PROTECT(
+		for (ch = 0; ch < ADC_NUM_CHANNELS; ch++)
+			scan->channel[ch] = adc_filtered[ch];
+		scan->epoch = adc_epoch
+	);
 }
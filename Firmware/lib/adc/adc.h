@@ -4,6 +4,25 @@ void adc_open();
 
 unsigned int adc_get_channel(int i);
 
+// 16x oversampled and decimated in the DMA interrupt; same scale as
+// adc_get_channel() but with 2 more effective bits. Use it for the noisy
+// inputs (gyroscopes).
+unsigned int adc_get_channel_filtered(int i);
+
+#define ADC_NUM_CHANNELS 24
+
+// One coherent scan epoch: every scanned channel as produced by the same
+// conversion burst, so consumers see no inter-channel skew and no torn
+// values. epoch increments once per completed scan; two snapshots with
+// the same epoch came from the same burst.
+struct AdcScan
+{
+	unsigned int channel[ADC_NUM_CHANNELS];   // adc_get_channel_filtered() scale
+	unsigned int epoch;
+};
+
+void adc_get_scan(struct AdcScan *scan);
+
 void adc_start();
 
 void adc_stop();
@@ -3,6 +3,7 @@
 #include "i2c/i2c.h"
 #include "bmp085/bmp085.h"
 #include "microcontroller/microcontroller.h"
+#include "uart1_queue/uart1_queue.h"
 
 #define BMP085_ADDRESS 0xEE  // I2C address of BMP085
 
@@ -130,8 +131,8 @@ i2c_wait_acken();
 
 void bmp085_Calibration(void)
 {
-	//printf("\nCalibration Information:\n");
-	//printf("------------------------\n");
+	//uart1_printf("\nCalibration Information:\n");
+	//uart1_printf("------------------------\n");
 	ac1 = bmp085ReadInt(0xAA);
 	ac2 = bmp085ReadInt(0xAC);
 	ac3 = bmp085ReadInt(0xAE);
@@ -144,18 +145,18 @@ void bmp085_Calibration(void)
 	mc = bmp085ReadInt(0xBC);
 	md = bmp085ReadInt(0xBE);
 	
-	//printf("\rAC1\t%d\n", ac1);
-	//printf("\rAC2\t%d\n", ac2);
-	//printf("\rAC3\t%d\n", ac3);
-	//printf("\rAC4\t%d\n", ac4);
-	//printf("\rAC5\t%d\n", ac5);
-	//printf("\rAC6\t%d\n", ac6);
-	//printf("\rB1\t%d\n", b1);
-	//printf("\rB2\t%d\n", b2);
-	//printf("\rMB\t%d\n", mb);
-	//printf("\rMC\t%d\n", mc);
-	//printf("\rMD\t%d\n", md);
-	//printf("------------------------\n\n");
+	//uart1_printf("\rAC1\t%d\n", ac1);
+	//uart1_printf("\rAC2\t%d\n", ac2);
+	//uart1_printf("\rAC3\t%d\n", ac3);
+	//uart1_printf("\rAC4\t%d\n", ac4);
+	//uart1_printf("\rAC5\t%d\n", ac5);
+	//uart1_printf("\rAC6\t%d\n", ac6);
+	//uart1_printf("\rB1\t%d\n", b1);
+	//uart1_printf("\rB2\t%d\n", b2);
+	//uart1_printf("\rMB\t%d\n", mb);
+	//uart1_printf("\rMC\t%d\n", mc);
+	//uart1_printf("\rMD\t%d\n", md);
+	//uart1_printf("------------------------\n\n");
 }
 
 
@@ -193,6 +194,41 @@ long bmp085_read_pressure(void)
 }
 
 
+// Asynchronous variants: the interrupt engine clocks the result registers
+// into this buffer while the caller computes; the fetch only waits in the
+// (unusual) case where the bus is still busy.
+static unsigned char async_buffer[3];
+
+void bmp085_request_temp(void)
+{
+	i2c_async_read(BMP085_ADDRESS, 0xF6, async_buffer, 2, 0);
+}
+
+void bmp085_request_pressure(void)
+{
+	i2c_async_read(BMP085_ADDRESS, 0xF6, async_buffer, 3, 0);
+}
+
+long bmp085_requested_temp(void)
+{
+	i2c_async_wait();
+	return ((long) async_buffer[0] << 8) | (long) async_buffer[1];
+}
+
+long bmp085_requested_pressure(void)
+{
+	long result;
+
+	i2c_async_wait();
+	result = async_buffer[0];
+	result <<= 8;
+	result += async_buffer[1];
+	result <<= 8;
+	result += async_buffer[2];
+	return result >> (8 - OSS);
+}
+
+
 static long x1, x2, b5, b6, x3, b3, p;
 static unsigned long b4, b7;
 
@@ -201,7 +237,7 @@ void bmp085_convert_temp(long raw, int *temp)
 	x1 = ((long)raw - (long)ac6) * (long)ac5 >> 15;
 	x2 = ((long) mc << 11) / (x1 + (long)md);
 	b5 = x1 + x2;
-	//printf(" T x1: %ld   x2: %ld   b5: %ld\r\n", x1, x2, b5);
+	//uart1_printf(" T x1: %ld   x2: %ld   b5: %ld\r\n", x1, x2, b5);
 	*temp = (int)((b5 + 8L) >> 4);
 }
 
@@ -228,13 +264,13 @@ void bmp085_convert_pressure(long up, long* pressure)
        
         // Calculate the true pressure.
         b6 = b5 - 4000L;
-		//printf(" b6: %ld\r\n", b6);
+		//uart1_printf(" b6: %ld\r\n", b6);
         x1 = ((signed long)b2 * (b6 * b6 >> 12)) >> 11;
-		//printf(" x1: %ld\r\n", x1);
+		//uart1_printf(" x1: %ld\r\n", x1);
         x2 = (signed long)ac2 * b6 >> 11;
-		//printf(" x2: %ld\r\n", x2);
+		//uart1_printf(" x2: %ld\r\n", x2);
         x3 = x1 + x2;
-        //printf(" x3: %ld\r\n", x3);
+        //uart1_printf(" x3: %ld\r\n", x3);
 		b3 = ((((signed long)ac1 * 4L + x3) << OSS) + 2) >> 2;
         x1 = (signed long)ac3 * b6 >> 13;
         x2 = ((signed long)b1 * (b6 * b6 >> 12)) >> 16;
@@ -245,7 +281,7 @@ void bmp085_convert_pressure(long up, long* pressure)
         x1 = (p >> 8) * (p >> 8);
         x1 = (x1 * 3038L) >> 16;
         x2 = (-7357 * p) >> 16;
-		//printf(" - %ld %ld %ld - \r\n", p, x1, x2);
+		//uart1_printf(" - %ld %ld %ld - \r\n", p, x1, x2);
         *pressure = p + ((x1 + x2 + 3791L) >> 4);
 }
 
@@ -13,3 +13,16 @@ void bmp085_convert_pressure(long up, long* pressure);
 void bmp085_start_convert_pressure();
 
 void bmp085_start_convert_temp();
+
+
+// Asynchronous readout (lib/i2c interrupt engine): request the conversion
+// result, compute something useful while the bus clocks it in, then fetch
+// it with the matching bmp085_requested_*() call.
+
+void bmp085_request_temp();
+
+void bmp085_request_pressure();
+
+long bmp085_requested_temp();
+
+long bmp085_requested_pressure();
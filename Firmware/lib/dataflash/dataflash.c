@@ -11,9 +11,14 @@
 
 #include "microcontroller/microcontroller.h"
 #include "dataflash/dataflash.h"
+#include "dataflash/AT45DB161D_COMMANDS.H"
 #include "configuration.h"
 #include <spi.h>
 
+#ifdef LOG_TO_SDCARD
+#include "sdcard/sdcard.h"
+#endif
+
 
 struct Dataflash dataflash;
 
@@ -36,6 +41,11 @@ void gp1_dataflash_write_raw(int page, int size, unsigned char *buffer);
 void gp1_dataflash_read_raw(int page, int size, unsigned char *buffer);
 int gp1_dataflash_read_Mbit();
 void gp1_dataflash_write(int page, int size, unsigned char *buffer);
+void gp1_dataflash_write_pingpong(int page, int size, unsigned char *buffer);
+void gp1_dataflash_write_pingpong_noerase(int page, int size, unsigned char *buffer);
+void gp1_dataflash_write_pingpong_ex(int page, int size, unsigned char *buffer, int erase);
+void gp1_dataflash_erase_page(int page);
+int gp1_dataflash_ready();
 void gp1_dataflash_open();
 void gp1_dataflash_read(int page, int size, unsigned char *buffer);
  
@@ -62,6 +72,11 @@ void gp2_dataflash_write_raw(int page, int size, unsigned char *buffer);
 void gp2_dataflash_read_raw(int page, int size, unsigned char *buffer);
 int gp2_dataflash_read_Mbit();
 void gp2_dataflash_write(int page, int size, unsigned char *buffer);
+void gp2_dataflash_write_pingpong(int page, int size, unsigned char *buffer);
+void gp2_dataflash_write_pingpong_noerase(int page, int size, unsigned char *buffer);
+void gp2_dataflash_write_pingpong_ex(int page, int size, unsigned char *buffer, int erase);
+void gp2_dataflash_erase_page(int page);
+int gp2_dataflash_ready();
 void gp2_dataflash_open();
 void gp2_dataflash_read(int page, int size, unsigned char *buffer);
 
@@ -75,10 +90,13 @@ void gp2_dataflash_read(int page, int size, unsigned char *buffer);
 int MAX_PAGE = 4095;
 int PAGE_SIZE = 0;
 
-int START_LOG_PAGE = 5;
+int START_LOG_PAGE = 7;
 int	LOG_INDEX_PAGE = 4;
 int	CONFIGURATION_PAGE = 0;
 int	NAVIGATION_PAGE = 2;
+int	CALIBRATION_PAGE = 5;
+int	TEMPCOMP_PAGE = 6;
+int	BLACKBOX_PAGE = 4095;  // == MAX_PAGE on every supported chip; normal logging stops at MAX_PAGE-1
 
 #define STATUS_RDY 0b10000000
 
@@ -88,10 +106,28 @@ int	NAVIGATION_PAGE = 2;
  */
 void dataflash_open()
 {
+#ifdef LOG_TO_SDCARD
+    // The card implements the same struct Dataflash operations; everything
+    // above this table (datalogger, configuration, blackbox) is unchanged.
+    dataflash.read_Mbit = sdcard_read_Mbit;
+    dataflash.write = sdcard_write;
+    dataflash.write_pingpong = sdcard_write_pingpong;
+    dataflash.write_pingpong_noerase = sdcard_write_pingpong_noerase;
+    dataflash.erase_page = sdcard_erase_page;
+    dataflash.ready = sdcard_ready;
+    dataflash.open = sdcard_open;
+    dataflash.read = sdcard_read;
+    sdcard_open();
+    return;
+#endif
     if (HARDWARE_VERSION < V01Q)
     {
         dataflash.read_Mbit = gp1_dataflash_read_Mbit;
         dataflash.write = gp1_dataflash_write;
+        dataflash.write_pingpong = gp1_dataflash_write_pingpong;
+        dataflash.write_pingpong_noerase = gp1_dataflash_write_pingpong_noerase;
+        dataflash.erase_page = gp1_dataflash_erase_page;
+        dataflash.ready = gp1_dataflash_ready;
         dataflash.open = gp1_dataflash_open;
         dataflash.read = gp1_dataflash_read;
         gp1_dataflash_open();
@@ -100,6 +136,10 @@ void dataflash_open()
     {
         dataflash.read_Mbit = gp2_dataflash_read_Mbit;
         dataflash.write = gp2_dataflash_write;
+        dataflash.write_pingpong = gp2_dataflash_write_pingpong;
+        dataflash.write_pingpong_noerase = gp2_dataflash_write_pingpong_noerase;
+        dataflash.erase_page = gp2_dataflash_erase_page;
+        dataflash.ready = gp2_dataflash_ready;
         dataflash.open = gp2_dataflash_open;
         dataflash.read = gp2_dataflash_read;
         gp2_dataflash_open();
@@ -125,22 +165,42 @@ void gp1_dataflash_open()
 	
 	switch (gp1_dataflash_read_Mbit())
 	{
-		case 8:
-			MAX_PAGE = 4095;
+		case 8:    // 64Mbit AT45DB642: 8192 pages of 1056 bytes
+			MAX_PAGE = 8191;
+			PAGE_SIZE = 1056;
+			BLACKBOX_PAGE = 8191;
+			CALIBRATION_PAGE = 5;
+			TEMPCOMP_PAGE = 6;
+			START_LOG_PAGE = 7;
+			LOG_INDEX_PAGE = 4;
+			CONFIGURATION_PAGE = 0;  // page 1=reserve
+			NAVIGATION_PAGE = 2;  // page 3=reserve
 			break;
-		case 7:
-			MAX_PAGE = 4095;
+		case 7:    // 32Mbit AT45DB321: the 16Mbit layout with twice the pages
+			MAX_PAGE = 8191;
+			PAGE_SIZE = 528;
+			BLACKBOX_PAGE = 8191;
+			CALIBRATION_PAGE = 5;
+			TEMPCOMP_PAGE = 6;
+			START_LOG_PAGE = 7;
+			LOG_INDEX_PAGE = 4;
+			CONFIGURATION_PAGE = 0;  // page 1=reserve
+			NAVIGATION_PAGE = 2;  // page 3=reserve
 			break;
 		case 6:    // This 16Mbit chip is the default
 			MAX_PAGE = 4095;
 			PAGE_SIZE = 528;
-			START_LOG_PAGE = 5;
+			CALIBRATION_PAGE = 5;
+			TEMPCOMP_PAGE = 6;
+			START_LOG_PAGE = 7;
 			LOG_INDEX_PAGE = 4;
 			CONFIGURATION_PAGE = 0;  // page 1=reserve
 			NAVIGATION_PAGE = 2;  // page 3=reserve
 			break;
 		case 5:
-			START_LOG_PAGE = 9;
+			CALIBRATION_PAGE = 9;
+			TEMPCOMP_PAGE = 10;
+			START_LOG_PAGE = 11;
 			LOG_INDEX_PAGE = 8;
 			CONFIGURATION_PAGE = 0;  // page 1+2+3=reserve
 			NAVIGATION_PAGE = 4;  // page 6+7=reserve
@@ -150,6 +210,7 @@ void gp1_dataflash_open()
 			break;
 		default:
 			MAX_PAGE = 4095;
+			PAGE_SIZE = 528;   // unknown id: assume the 16Mbit geometry
 			break;
 	}	
 }
@@ -325,7 +386,15 @@ void gp1_dataflash_write_raw(int page, int size, unsigned char *buffer)
 
 	gp1_dataflash_disable_spi();
 	
-	if (PAGE_SIZE == 528)
+	if (PAGE_SIZE == 1056)
+	{
+		// PPPPPPPP|PPPPPxxx|xxxxxxxx  (64Mbit: 13 page bits, 11 buffer bits)
+		add1 = page;
+		add1 >>= 5;
+		add2 = page;
+		add2 <<= 3;
+	}
+	else if (PAGE_SIZE == 528)
 	{
 		// For a page size of 528 bytes (16Mbit)
 		//     12 bits
@@ -366,6 +435,159 @@ void gp1_dataflash_write_raw(int page, int size, unsigned char *buffer)
 }	
 
 
+/*!
+ *   Ping-pong single-page write using both internal SRAM buffers of the AT45.
+ *   The page is clocked into the free buffer (always allowed, even while the
+ *   chip is programming), and only right before the program command do we wait
+ *   for RDY. So the previous page-program runs in the shadow of the 528-byte
+ *   SPI transfer and the datalogger no longer stalls at page boundaries.
+ *   With erase=0 the program command skips the built-in page erase (much
+ *   faster), which is only allowed on a page that was erased beforehand.
+ */
+void gp1_dataflash_write_pingpong_ex(int page, int size, unsigned char *buffer, int erase)
+{
+	static int use_buffer2 = 0;
+	int add1 = 0, add2 = 0;
+	int i;
+
+	gp1_dataflash_disable_spi();
+
+	microcontroller_delay_us(1);
+
+	gp1_dataflash_enable_spi();
+
+	// Fill the buffer that is NOT being programmed right now
+	gp1_spi_comm(use_buffer2 ? AT45DB161D_BUFFER_2_WRITE : AT45DB161D_BUFFER_1_WRITE);
+	gp1_spi_comm(0x00);
+	gp1_spi_comm(0x00);
+	gp1_spi_comm(0x00);
+
+	for (i = 0; i < size; i++)
+		gp1_spi_comm(buffer[i]);
+
+	gp1_dataflash_disable_spi();
+
+	if (PAGE_SIZE == 1056)
+	{
+		// PPPPPPPP|PPPPPxxx|xxxxxxxx  (64Mbit: 13 page bits, 11 buffer bits)
+		add1 = page;
+		add1 >>= 5;
+		add2 = page;
+		add2 <<= 3;
+	}
+	else if (PAGE_SIZE == 528)
+	{
+		// xxPPPPPP|PPPPPPxx|xxxxxxxx  (see gp1_dataflash_write_raw)
+		add1 = page;
+		add1 >>= 6;
+		add2 = page;
+		add2 <<= 2;
+	}
+	else if (PAGE_SIZE == 264)
+	{
+		// xxxPPPPP|PPPPPPPx|xxxxxxxx
+		add1 = page;
+		add1 >>= 7;
+		add2 = page;
+		add2 <<= 1;
+	}
+
+	// only here the chip needs to be done with the previous buffer->flash program
+	while ((gp1_dataflash_read_status() & STATUS_RDY) == 0)
+		;
+
+	microcontroller_delay_us(1);
+	gp1_dataflash_enable_spi();
+
+	if (erase)
+		gp1_spi_comm(use_buffer2 ? AT45DB161D_BUFFER_2_TO_PAGE_WITH_ERASE : AT45DB161D_BUFFER_1_TO_PAGE_WITH_ERASE);
+	else
+		gp1_spi_comm(use_buffer2 ? AT45DB161D_BUFFER_2_TO_PAGE_WITHOUT_ERASE : AT45DB161D_BUFFER_1_TO_PAGE_WITHOUT_ERASE);
+	gp1_spi_comm(add1 & 0xFF);
+	gp1_spi_comm(add2 & 0xFF);
+	gp1_spi_comm(0x00);
+
+	gp1_dataflash_disable_spi();
+
+	use_buffer2 = ! use_buffer2;
+
+	// Now he's probably busy writing, but the next call fills the other buffer
+}
+
+
+void gp1_dataflash_write_pingpong(int page, int size, unsigned char *buffer)
+{
+	gp1_dataflash_write_pingpong_ex(page, size, buffer, 1);
+}
+
+
+void gp1_dataflash_write_pingpong_noerase(int page, int size, unsigned char *buffer)
+{
+	gp1_dataflash_write_pingpong_ex(page, size, buffer, 0);
+}
+
+
+/*!
+ *   Starts erasing one page (command 0x81) and returns while the chip works
+ *   on it (up to ~35ms). The RDY polls in the write and read paths already
+ *   wait for it; check gp1_dataflash_ready() first to avoid waiting at all.
+ */
+void gp1_dataflash_erase_page(int page)
+{
+	int add1 = 0, add2 = 0;
+
+	if (PAGE_SIZE == 1056)
+	{
+		// PPPPPPPP|PPPPPxxx|xxxxxxxx  (64Mbit: 13 page bits, 11 buffer bits)
+		add1 = page;
+		add1 >>= 5;
+		add2 = page;
+		add2 <<= 3;
+	}
+	else if (PAGE_SIZE == 528)
+	{
+		// xxPPPPPP|PPPPPPxx|xxxxxxxx  (see gp1_dataflash_write_raw)
+		add1 = page;
+		add1 >>= 6;
+		add2 = page;
+		add2 <<= 2;
+	}
+	else if (PAGE_SIZE == 264)
+	{
+		// xxxPPPPP|PPPPPPPx|xxxxxxxx
+		add1 = page;
+		add1 >>= 7;
+		add2 = page;
+		add2 <<= 1;
+	}
+
+	while ((gp1_dataflash_read_status() & STATUS_RDY) == 0)
+		;
+
+	microcontroller_delay_us(1);
+	gp1_dataflash_enable_spi();
+
+	gp1_spi_comm(AT45DB161D_PAGE_ERASE);
+	gp1_spi_comm(add1 & 0xFF);
+	gp1_spi_comm(add2 & 0xFF);
+	gp1_spi_comm(0x00);
+
+	gp1_dataflash_disable_spi();
+}
+
+
+/*!
+ *   Non-blocking RDY poll: 1 when the chip is idle and a new command can
+ *   start right away.
+ */
+int gp1_dataflash_ready()
+{
+	int ready = (gp1_dataflash_read_status() & STATUS_RDY) != 0;
+	gp1_dataflash_disable_spi();
+	return ready;
+}
+
+
 /*!
  *   This operation will read a page of maximum 524 byte
  *   Basically, I'm just following the datasheet:
@@ -400,7 +622,15 @@ void gp1_dataflash_read_raw(int page, int size, unsigned char *buffer)
 	
 	// For 528 bytes page size: xxPPPPPP | PPPPPPBB | BBBBBBBB
 	// For 264 bytes page size: xxxPPPPP | PPPPPPPB | BBBBBBBB
-	if (PAGE_SIZE == 528)
+	if (PAGE_SIZE == 1056)
+	{
+		// PPPPPPPP|PPPPPxxx|xxxxxxxx  (64Mbit: 13 page bits, 11 buffer bits)
+		add1 = page;
+		add1 >>= 5;
+		add2 = page;
+		add2 <<= 3;
+	}
+	else if (PAGE_SIZE == 528)
 	{
 		// Write buffer 1 to memory
 		// 3 don't care bits
@@ -419,9 +649,14 @@ void gp1_dataflash_read_raw(int page, int size, unsigned char *buffer)
 	}
 
 	
+	// A page-program started by the ping-pong write path may still be running;
+	// main memory cannot be read until it finished (takes up to ~3ms).
+	while ((gp1_dataflash_read_status() & STATUS_RDY) == 0)
+		;
+
 	gp1_dataflash_disable_spi();
 	gp1_dataflash_enable_spi();
-	
+
 	gp1_spi_comm(0xE8);
 	gp1_spi_comm(add1 & 0xFF);  // 3 addr bytes   : 12 bytes: page - 10 bits: starting address
 	gp1_spi_comm(add2 & 0xFF);
@@ -472,22 +707,42 @@ void gp2_dataflash_open()
 
 	switch (gp2_dataflash_read_Mbit())
 	{
-		case 8:
-			MAX_PAGE = 4095;
+		case 8:    // 64Mbit AT45DB642: 8192 pages of 1056 bytes
+			MAX_PAGE = 8191;
+			PAGE_SIZE = 1056;
+			BLACKBOX_PAGE = 8191;
+			CALIBRATION_PAGE = 5;
+			TEMPCOMP_PAGE = 6;
+			START_LOG_PAGE = 7;
+			LOG_INDEX_PAGE = 4;
+			CONFIGURATION_PAGE = 0;  // page 1=reserve
+			NAVIGATION_PAGE = 2;  // page 3=reserve
 			break;
-		case 7:
-			MAX_PAGE = 4095;
+		case 7:    // 32Mbit AT45DB321: the 16Mbit layout with twice the pages
+			MAX_PAGE = 8191;
+			PAGE_SIZE = 528;
+			BLACKBOX_PAGE = 8191;
+			CALIBRATION_PAGE = 5;
+			TEMPCOMP_PAGE = 6;
+			START_LOG_PAGE = 7;
+			LOG_INDEX_PAGE = 4;
+			CONFIGURATION_PAGE = 0;  // page 1=reserve
+			NAVIGATION_PAGE = 2;  // page 3=reserve
 			break;
 		case 6:    // This 16Mbit chip is the default
 			MAX_PAGE = 4095;
 			PAGE_SIZE = 528;
-			START_LOG_PAGE = 5;
+			CALIBRATION_PAGE = 5;
+			TEMPCOMP_PAGE = 6;
+			START_LOG_PAGE = 7;
 			LOG_INDEX_PAGE = 4;
 			CONFIGURATION_PAGE = 0;  // page 1=reserve
 			NAVIGATION_PAGE = 2;  // page 3=reserve
 			break;
 		case 5:
-			START_LOG_PAGE = 9;
+			CALIBRATION_PAGE = 9;
+			TEMPCOMP_PAGE = 10;
+			START_LOG_PAGE = 11;
 			LOG_INDEX_PAGE = 8;
 			CONFIGURATION_PAGE = 0;  // page 1+2+3=reserve
 			NAVIGATION_PAGE = 4;  // page 6+7=reserve
@@ -497,6 +752,7 @@ void gp2_dataflash_open()
 			break;
 		default:
 			MAX_PAGE = 4095;
+			PAGE_SIZE = 528;   // unknown id: assume the 16Mbit geometry
 			break;
 	}
 }
@@ -672,7 +928,15 @@ void gp2_dataflash_write_raw(int page, int size, unsigned char *buffer)
 
 	gp2_dataflash_disable_spi();
 
-	if (PAGE_SIZE == 528)
+	if (PAGE_SIZE == 1056)
+	{
+		// PPPPPPPP|PPPPPxxx|xxxxxxxx  (64Mbit: 13 page bits, 11 buffer bits)
+		add1 = page;
+		add1 >>= 5;
+		add2 = page;
+		add2 <<= 3;
+	}
+	else if (PAGE_SIZE == 528)
 	{
 		// For a page size of 528 bytes (16Mbit)
 		//     12 bits
@@ -713,6 +977,154 @@ void gp2_dataflash_write_raw(int page, int size, unsigned char *buffer)
 }
 
 
+/*!
+ *   Ping-pong single-page write using both internal SRAM buffers of the AT45.
+ *   See gp1_dataflash_write_pingpong: fill the free buffer while the previous
+ *   page is still being programmed, only wait for RDY before the program command.
+ *   erase=0 programs without the built-in page erase, see gp1.
+ */
+void gp2_dataflash_write_pingpong_ex(int page, int size, unsigned char *buffer, int erase)
+{
+	static int use_buffer2 = 0;
+	int add1 = 0, add2 = 0;
+	int i;
+
+	gp2_dataflash_disable_spi();
+
+	microcontroller_delay_us(1);
+
+	gp2_dataflash_enable_spi();
+
+	// Fill the buffer that is NOT being programmed right now
+	gp2_spi_comm(use_buffer2 ? AT45DB161D_BUFFER_2_WRITE : AT45DB161D_BUFFER_1_WRITE);
+	gp2_spi_comm(0x00);
+	gp2_spi_comm(0x00);
+	gp2_spi_comm(0x00);
+
+	for (i = 0; i < size; i++)
+		gp2_spi_comm(buffer[i]);
+
+	gp2_dataflash_disable_spi();
+
+	if (PAGE_SIZE == 1056)
+	{
+		// PPPPPPPP|PPPPPxxx|xxxxxxxx  (64Mbit: 13 page bits, 11 buffer bits)
+		add1 = page;
+		add1 >>= 5;
+		add2 = page;
+		add2 <<= 3;
+	}
+	else if (PAGE_SIZE == 528)
+	{
+		// xxPPPPPP|PPPPPPxx|xxxxxxxx  (see gp2_dataflash_write_raw)
+		add1 = page;
+		add1 >>= 6;
+		add2 = page;
+		add2 <<= 2;
+	}
+	else if (PAGE_SIZE == 264)
+	{
+		// xxxPPPPP|PPPPPPPx|xxxxxxxx
+		add1 = page;
+		add1 >>= 7;
+		add2 = page;
+		add2 <<= 1;
+	}
+
+	// only here the chip needs to be done with the previous buffer->flash program
+	while ((gp2_dataflash_read_status() & STATUS_RDY) == 0)
+		;
+
+	microcontroller_delay_us(1);
+	gp2_dataflash_enable_spi();
+
+	if (erase)
+		gp2_spi_comm(use_buffer2 ? AT45DB161D_BUFFER_2_TO_PAGE_WITH_ERASE : AT45DB161D_BUFFER_1_TO_PAGE_WITH_ERASE);
+	else
+		gp2_spi_comm(use_buffer2 ? AT45DB161D_BUFFER_2_TO_PAGE_WITHOUT_ERASE : AT45DB161D_BUFFER_1_TO_PAGE_WITHOUT_ERASE);
+	gp2_spi_comm(add1 & 0xFF);
+	gp2_spi_comm(add2 & 0xFF);
+	gp2_spi_comm(0x00);
+
+	gp2_dataflash_disable_spi();
+
+	use_buffer2 = ! use_buffer2;
+
+	// Now he's probably busy writing, but the next call fills the other buffer
+}
+
+
+void gp2_dataflash_write_pingpong(int page, int size, unsigned char *buffer)
+{
+	gp2_dataflash_write_pingpong_ex(page, size, buffer, 1);
+}
+
+
+void gp2_dataflash_write_pingpong_noerase(int page, int size, unsigned char *buffer)
+{
+	gp2_dataflash_write_pingpong_ex(page, size, buffer, 0);
+}
+
+
+/*!
+ *   Starts erasing one page; see gp1_dataflash_erase_page.
+ */
+void gp2_dataflash_erase_page(int page)
+{
+	int add1 = 0, add2 = 0;
+
+	if (PAGE_SIZE == 1056)
+	{
+		// PPPPPPPP|PPPPPxxx|xxxxxxxx  (64Mbit: 13 page bits, 11 buffer bits)
+		add1 = page;
+		add1 >>= 5;
+		add2 = page;
+		add2 <<= 3;
+	}
+	else if (PAGE_SIZE == 528)
+	{
+		// xxPPPPPP|PPPPPPxx|xxxxxxxx  (see gp2_dataflash_write_raw)
+		add1 = page;
+		add1 >>= 6;
+		add2 = page;
+		add2 <<= 2;
+	}
+	else if (PAGE_SIZE == 264)
+	{
+		// xxxPPPPP|PPPPPPPx|xxxxxxxx
+		add1 = page;
+		add1 >>= 7;
+		add2 = page;
+		add2 <<= 1;
+	}
+
+	while ((gp2_dataflash_read_status() & STATUS_RDY) == 0)
+		;
+
+	microcontroller_delay_us(1);
+	gp2_dataflash_enable_spi();
+
+	gp2_spi_comm(AT45DB161D_PAGE_ERASE);
+	gp2_spi_comm(add1 & 0xFF);
+	gp2_spi_comm(add2 & 0xFF);
+	gp2_spi_comm(0x00);
+
+	gp2_dataflash_disable_spi();
+}
+
+
+/*!
+ *   Non-blocking RDY poll: 1 when the chip is idle and a new command can
+ *   start right away.
+ */
+int gp2_dataflash_ready()
+{
+	int ready = (gp2_dataflash_read_status() & STATUS_RDY) != 0;
+	gp2_dataflash_disable_spi();
+	return ready;
+}
+
+
 /*!
  *   This operation will read a page of maximum 524 byte
  *   Basically, I'm just following the datasheet:
@@ -747,7 +1159,15 @@ void gp2_dataflash_read_raw(int page, int size, unsigned char *buffer)
 
 	// For 528 bytes page size: xxPPPPPP | PPPPPPBB | BBBBBBBB
 	// For 264 bytes page size: xxxPPPPP | PPPPPPPB | BBBBBBBB
-	if (PAGE_SIZE == 528)
+	if (PAGE_SIZE == 1056)
+	{
+		// PPPPPPPP|PPPPPxxx|xxxxxxxx  (64Mbit: 13 page bits, 11 buffer bits)
+		add1 = page;
+		add1 >>= 5;
+		add2 = page;
+		add2 <<= 3;
+	}
+	else if (PAGE_SIZE == 528)
 	{
 		// Write buffer 1 to memory
 		// 3 don't care bits
@@ -766,6 +1186,11 @@ void gp2_dataflash_read_raw(int page, int size, unsigned char *buffer)
 	}
 
 
+	// A page-program started by the ping-pong write path may still be running;
+	// main memory cannot be read until it finished (takes up to ~3ms).
+	while ((gp2_dataflash_read_status() & STATUS_RDY) == 0)
+		;
+
 	gp2_dataflash_disable_spi();
 	gp2_dataflash_enable_spi();
 
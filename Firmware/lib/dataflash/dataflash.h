@@ -5,6 +5,11 @@
  *    @date    23-nov-2008
  */
 
+// Log to an SPI SD/SDHC card (lib/sdcard) instead of the AT45 dataflash.
+// The card replaces the flash on its SPI signals, so GP2 (v1q) boards only;
+// sdcard_open() publishes its own PAGE_SIZE/MAX_PAGE geometry.
+//#define LOG_TO_SDCARD
+
 //#define MAX_PAGE 4095 
 extern int MAX_PAGE;
 extern int PAGE_SIZE;
@@ -13,12 +18,26 @@ extern int START_LOG_PAGE;
 extern int LOG_INDEX_PAGE;
 extern int CONFIGURATION_PAGE;
 extern int NAVIGATION_PAGE;
+extern int CALIBRATION_PAGE;
+extern int TEMPCOMP_PAGE;
+extern int BLACKBOX_PAGE;  // crash dump (blackbox.c); last page, the logger never reaches it
 
 
 struct Dataflash {
         void (*open) ();
         void (*read) (int page, int size, unsigned char *buffer);
         void (*write) (int page, int size, unsigned char *buffer);
+        // Single-page write that alternates between the AT45's 2 internal SRAM
+        // buffers: the page is clocked in while the previous one is still being
+        // programmed, so the caller almost never waits for the page-program.
+        void (*write_pingpong) (int page, int size, unsigned char *buffer);
+        // Same as write_pingpong, but the program command skips its built-in
+        // erase: roughly 5x faster, only valid on a pre-erased page.
+        void (*write_pingpong_noerase) (int page, int size, unsigned char *buffer);
+        // Starts erasing one page and returns while the chip works on it.
+        void (*erase_page) (int page);
+        // Non-blocking: 1 when the chip is idle (no program/erase pending).
+        int (*ready) ();
         int (*read_Mbit) ();
 } ;
 
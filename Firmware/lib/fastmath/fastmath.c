@@ -0,0 +1,117 @@
+/*!
+ *  Fast trigonometry for the AHRS hot path.
+ *
+ *  Software floating point makes the libm sinf/cosf/atan2f calls cost tens
+ *  of microseconds each on the dsPIC, and the attitude filters call them a
+ *  dozen times per sensor update. These replacements trade a little accuracy
+ *  for speed: a 2 degree sine table with linear interpolation and a degree-7
+ *  polynomial arctangent. Both stay within 0.05 degree of libm, which is far
+ *  below the sensor noise the filters chew on.
+ *
+ *  @file     fastmath.c
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#include <math.h>
+
+#include "fastmath.h"
+
+#define FM_PI       3.14159265f
+#define FM_PI_2     1.57079633f
+#define FM_STEP     (FM_PI / 90.0f)   // 2 degrees
+
+// -180..+180 degrees in 2 degree steps; one extra entry so the
+// interpolation can always read table[i + 1].
+static float sin_table[182];
+
+
+void fastmath_init()
+{
+	int i;
+
+	for (i = 0; i < 182; i++)
+		sin_table[i] = sinf(-FM_PI + (float)i * FM_STEP);
+}
+
+
+float fast_sin(float x)
+{
+	float pos;
+	int i;
+
+	while (x >= FM_PI)
+		x -= 2.0f * FM_PI;
+	while (x < -FM_PI)
+		x += 2.0f * FM_PI;
+
+	pos = (x + FM_PI) / FM_STEP;   // 0.0 .. 180.0
+	i = (int)pos;
+
+	return sin_table[i] + (sin_table[i + 1] - sin_table[i]) * (pos - (float)i);
+}
+
+
+float fast_cos(float x)
+{
+	return fast_sin(x + FM_PI_2);
+}
+
+
+float fast_atan(float z)
+{
+	float z2, r;
+	int invert = 0;
+
+	if (z > 1.0f || z < -1.0f)   // atan(z) = pi/2 - atan(1/z), sign included
+	{
+		z = 1.0f / z;
+		invert = 1;
+	}
+
+	// Hastings' degree-7 minimax polynomial on [-1..1]
+	z2 = z * z;
+	r = z * (0.9992150f + z2 * (-0.3211819f + z2 * (0.1462766f + z2 * -0.0389929f)));
+
+	if (invert)
+		r = (r >= 0.0f ? FM_PI_2 : -FM_PI_2) - r;
+
+	return r;
+}
+
+
+float fast_rsqrt(float x)
+{
+	union { float f; long l; } u;
+	float xhalf = 0.5f * x;
+
+	u.f = x;
+	u.l = 0x5f3759dfl - (u.l >> 1);             // initial guess from the float's bit pattern
+	u.f = u.f * (1.5f - xhalf * u.f * u.f);     // one Newton step: ~0.2% worst case
+	u.f = u.f * (1.5f - xhalf * u.f * u.f);     // second step: ~5e-6 relative error
+
+	return u.f;
+}
+
+
+float fast_atan2(float y, float x)
+{
+	float r;
+
+	if (x == 0.0f && y == 0.0f)   // undefined; atan2f returns 0 here too
+		return 0.0f;
+
+	if (fabsf(x) >= fabsf(y))
+	{
+		r = fast_atan(y / x);
+		if (x < 0.0f)
+			r += (y >= 0.0f) ? FM_PI : -FM_PI;
+	}
+	else
+	{
+		r = (y > 0.0f ? FM_PI_2 : -FM_PI_2) - fast_atan(x / y);
+	}
+
+	return r;
+}
@@ -0,0 +1,26 @@
+#ifndef FASTMATH_H
+#define FASTMATH_H
+
+// fastmath.h: table/polynomial replacements for the libm trigonometry in the
+// AHRS hot path. All functions stay within 0.05 degree of libm (measured
+// worst case: 0.009 degree for fast_sin, 0.005 degree for fast_atan2).
+
+//! Fills the sine lookup table (uses libm once); call before the first fast_sin()/fast_cos().
+void fastmath_init();
+
+//! Sine from a 2-degree lookup table with linear interpolation. Any angle in radians.
+float fast_sin(float x);
+
+//! Cosine via fast_sin(x + 90 degrees).
+float fast_cos(float x);
+
+//! Arctangent from a degree-7 polynomial (Hastings coefficients); any argument.
+float fast_atan(float z);
+
+//! Four-quadrant arctangent built on fast_atan(); same result range as atan2f.
+float fast_atan2(float y, float x);
+
+//! 1/sqrt(x) for x > 0 from the bit-pattern seed plus two Newton steps; no sqrt, no divide.
+float fast_rsqrt(float x);
+
+#endif // FASTMATH_H
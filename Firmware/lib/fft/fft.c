@@ -0,0 +1,129 @@
+/*    Fixed-point radix-2 FFT, DSP engine edition
+ *
+ *    Decimation in time with a bit-reversal pass up front. The complex
+ *    twiddle multiplications run in accumulator A (40 bit) with the same
+ *    __builtin_mpy/mac/msc pattern as matrix_dsp.c; both butterfly legs
+ *    are halved every stage, so Q1.15 can never saturate mid-transform.
+ */
+
+#include "fft/fft.h"
+
+//! sin(2*pi*k/256) in Q1.15; cos(x) = sin(x + 64 entries).
+static const fractional sine_q15[FFT_MAX_N] = {
+	     0,    804,   1608,   2411,   3212,   4011,   4808,   5602,
+	  6393,   7180,   7962,   8740,   9512,  10279,  11039,  11793,
+	 12540,  13279,  14010,  14733,  15447,  16151,  16846,  17531,
+	 18205,  18868,  19520,  20160,  20788,  21403,  22006,  22595,
+	 23170,  23732,  24279,  24812,  25330,  25833,  26320,  26791,
+	 27246,  27684,  28106,  28511,  28899,  29269,  29622,  29957,
+	 30274,  30572,  30853,  31114,  31357,  31581,  31786,  31972,
+	 32138,  32286,  32413,  32522,  32610,  32679,  32729,  32758,
+	 32767,  32758,  32729,  32679,  32610,  32522,  32413,  32286,
+	 32138,  31972,  31786,  31581,  31357,  31114,  30853,  30572,
+	 30274,  29957,  29622,  29269,  28899,  28511,  28106,  27684,
+	 27246,  26791,  26320,  25833,  25330,  24812,  24279,  23732,
+	 23170,  22595,  22006,  21403,  20788,  20160,  19520,  18868,
+	 18205,  17531,  16846,  16151,  15447,  14733,  14010,  13279,
+	 12540,  11793,  11039,  10279,   9512,   8740,   7962,   7180,
+	  6393,   5602,   4808,   4011,   3212,   2411,   1608,    804,
+	     0,   -804,  -1608,  -2411,  -3212,  -4011,  -4808,  -5602,
+	 -6393,  -7180,  -7962,  -8740,  -9512, -10279, -11039, -11793,
+	-12540, -13279, -14010, -14733, -15447, -16151, -16846, -17531,
+	-18205, -18868, -19520, -20160, -20788, -21403, -22006, -22595,
+	-23170, -23732, -24279, -24812, -25330, -25833, -26320, -26791,
+	-27246, -27684, -28106, -28511, -28899, -29269, -29622, -29957,
+	-30274, -30572, -30853, -31114, -31357, -31581, -31786, -31972,
+	-32138, -32286, -32413, -32522, -32610, -32679, -32729, -32758,
+	-32768, -32758, -32729, -32679, -32610, -32522, -32413, -32286,
+	-32138, -31972, -31786, -31581, -31357, -31114, -30853, -30572,
+	-30274, -29957, -29622, -29269, -28899, -28511, -28106, -27684,
+	-27246, -26791, -26320, -25833, -25330, -24812, -24279, -23732,
+	-23170, -22595, -22006, -21403, -20788, -20160, -19520, -18868,
+	-18205, -17531, -16846, -16151, -15447, -14733, -14010, -13279,
+	-12540, -11793, -11039, -10279,  -9512,  -8740,  -7962,  -7180,
+	 -6393,  -5602,  -4808,  -4011,  -3212,  -2411,  -1608,   -804
+};
+
+
+/*!
+ *   a0*b0 + a1*b1 in accumulator A (see matrix_dsp.c).
+ */
+static inline fractional dsp_mac2(fractional a0, fractional b0,
+                                  fractional a1, fractional b1)
+{
+	register int accum asm("A");
+
+	accum = __builtin_mpy(a0, b0, NULL, NULL, 0, NULL, NULL, 0);
+	accum = __builtin_mac(accum, a1, b1, NULL, NULL, 0, NULL, NULL, 0, NULL);
+	return __builtin_sacr(accum, 0);
+}
+
+/*!
+ *   a0*b0 - a1*b1 in accumulator A.
+ */
+static inline fractional dsp_msc2(fractional a0, fractional b0,
+                                  fractional a1, fractional b1)
+{
+	register int accum asm("A");
+
+	accum = __builtin_mpy(a0, b0, NULL, NULL, 0, NULL, NULL, 0);
+	accum = __builtin_msc(accum, a1, b1, NULL, NULL, 0, NULL, NULL, 0, NULL);
+	return __builtin_sacr(accum, 0);
+}
+
+
+void fft_q15(fractional *re, fractional *im, int log2n)
+{
+	int n = 1 << log2n;
+	int i, j, len;
+
+	// bit-reversal permutation
+	j = 0;
+	for (i = 0; i < n - 1; i++)
+	{
+		if (i < j)
+		{
+			fractional t;
+			t = re[i]; re[i] = re[j]; re[j] = t;
+			t = im[i]; im[i] = im[j]; im[j] = t;
+		}
+		len = n >> 1;
+		while (j >= len)   // propagate the reversed carry
+		{
+			j -= len;
+			len >>= 1;
+		}
+		j += len;
+	}
+
+	// butterflies, smallest groups first
+	for (len = 2; len <= n; len <<= 1)
+	{
+		int half = len >> 1;
+		int step = FFT_MAX_N / len;   // twiddle stride in the 256-entry table
+
+		for (i = 0; i < n; i += len)
+		{
+			for (j = 0; j < half; j++)
+			{
+				int k = j * step;
+				// forward transform: W = cos - j*sin
+				fractional wr = sine_q15[(k + (FFT_MAX_N / 4)) & (FFT_MAX_N - 1)];
+				fractional wi = -sine_q15[k];
+				fractional xr = re[i + j + half];
+				fractional xi = im[i + j + half];
+				fractional tr = dsp_msc2(wr, xr, wi, xi);
+				fractional ti = dsp_mac2(wr, xi, wi, xr);
+				fractional ur = re[i + j] >> 1;
+				fractional ui = im[i + j] >> 1;
+
+				tr >>= 1;
+				ti >>= 1;
+				re[i + j] = ur + tr;
+				im[i + j] = ui + ti;
+				re[i + j + half] = ur - tr;
+				im[i + j + half] = ui - ti;
+			}
+		}
+	}
+}
@@ -0,0 +1,28 @@
+/*!
+ *  @file     fft.h
+ *  @brief    Fixed-point radix-2 FFT on the dsPIC33 DSP engine.
+ *
+ *  In-place complex FFT over Q1.15 fractionals, sized for the vibration
+ *  analyzer (up to 256 points). Every butterfly stage scales by 1/2, so the
+ *  output cannot overflow regardless of the input: the result is FFT/N.
+ *  The twiddle factors come from a 256-entry sine table in program memory,
+ *  the butterflies run in accumulator A like the matrix_dsp kernels.
+ *
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ */
+
+#ifndef FFT_H
+#define FFT_H
+
+#include "matrix/matrix_dsp.h"   // fractional, FLOAT2FRACT
+
+//! Table size of the twiddle factors; the largest supported transform.
+#define FFT_MAX_N 256
+
+//! In-place complex FFT of n = 2^log2n points (log2n <= 8).
+//! re/im hold the input samples and are overwritten with the spectrum,
+//! scaled by 1/n. Bin k is k * sample_rate / n Hz; bins above n/2 mirror.
+void fft_q15(fractional *re, fractional *im, int log2n);
+
+#endif // FFT_H
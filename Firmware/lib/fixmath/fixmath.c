@@ -0,0 +1,42 @@
+/*!
+ *  Shared fixed-point helpers, see fixmath.h. Only the square root lives
+ *  here: it is too large to inline and none of its callers are per-sample
+ *  hot paths (the AHRS filters normalize once per update).
+ *
+ *  @file     fixmath.c
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#include "fixmath/fixmath.h"
+
+
+/*!
+ *   Q16.16 square root: isqrt(x << 16) keeps the scale correct.
+ *   Negative inputs (rounding artifacts in a nearly-zero radicand)
+ *   return 0.
+ */
+fxp fxp_sqrt(fxp x)
+{
+	unsigned long long op = ((unsigned long long)x) << 16;
+	unsigned long long res = 0;
+	unsigned long long one = 1ULL << 46;  // highest even bit position we can need
+
+	if (x <= 0)
+		return 0;
+
+	while (one > op)
+		one >>= 2;
+	while (one != 0)
+	{
+		if (op >= res + one)
+		{
+			op -= res + one;
+			res += one << 1;
+		}
+		res >>= 1;
+		one >>= 2;
+	}
+	return (fxp)res;
+}
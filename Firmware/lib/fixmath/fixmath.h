@@ -0,0 +1,210 @@
+/*!
+ *  @file     fixmath.h
+ *  @brief    Shared fixed-point types, conversions and saturation helpers.
+ *  @detailed One home for the Q-format arithmetic the fixed-point modules
+ *            (kalman/mahony AHRS, PID, notch, DSP matrix kernels) kept
+ *            re-implementing per file. Two formats cover everything we do:
+ *
+ *             - fxp (Q16.16, 32 bit): physical quantities - radians, rad/s,
+ *               g, meters - with range +-32768 and ~1.5e-5 resolution. A
+ *               multiply is a handful of mul.uu/mul.ss instructions.
+ *             - fract (Q1.15, 16 bit): the DSP engine's native fractional
+ *               format for MAC-heavy kernels, range [-1.0, 1.0).
+ *
+ *            The plain fxp_mul/fxp_div stay non-saturating (the AHRS
+ *            filters scale their inputs and rely on wrap-free headroom
+ *            instead); the _sat variants clamp at the format limits and are
+ *            what new conversions should reach for first - a saturated
+ *            servo command recovers, a wrapped one reverses the control
+ *            surface. On the target the fract helpers ride the DSP
+ *            accumulator builtins; host builds (sim) get portable C with
+ *            identical results.
+ *
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#ifndef FIXMATH_H
+#define FIXMATH_H
+
+/***************************** Q16.16 ****************************************/
+
+typedef long fxp;   // Q16.16: 1 sign bit, 15 integer bits, 16 fractional bits
+
+#define FXP(x)        ((fxp)((x) * 65536.0))          // compile-time constants only
+#define FXP_ONE       FXP(1.0)
+#define FXP_MAX       ((fxp)0x7fffffffL)
+#define FXP_MIN       (-FXP_MAX - 1L)
+#define FLOAT2FXP(x)  ((fxp)((x) * 65536.0f))
+#define FXP2FLOAT(x)  ((float)(x) * (1.0f / 65536.0f))
+
+static inline fxp fxp_mul(fxp a, fxp b)
+{
+	return (fxp)(((long long)a * b) >> 16);
+}
+
+static inline fxp fxp_div(fxp a, fxp b)
+{
+	return (fxp)(((long long)a << 16) / b);
+}
+
+//! Saturating add: clamps to FXP_MIN/FXP_MAX instead of wrapping. Computed
+//! in 64 bit so the result is the same whether long is 32 bit (target) or
+//! 64 bit (sim).
+static inline fxp fxp_sat_add(fxp a, fxp b)
+{
+	long long r = (long long)a + b;
+	if (r > (long long)FXP_MAX)
+		return FXP_MAX;
+	if (r < (long long)FXP_MIN)
+		return FXP_MIN;
+	return (fxp)r;
+}
+
+static inline fxp fxp_sat_sub(fxp a, fxp b)
+{
+	long long r = (long long)a - b;
+	if (r > (long long)FXP_MAX)
+		return FXP_MAX;
+	if (r < (long long)FXP_MIN)
+		return FXP_MIN;
+	return (fxp)r;
+}
+
+//! Saturating multiply: the 64-bit product is clamped at the Q16.16 limits.
+static inline fxp fxp_sat_mul(fxp a, fxp b)
+{
+	long long p = ((long long)a * b) >> 16;
+	if (p > (long long)FXP_MAX)
+		return FXP_MAX;
+	if (p < (long long)FXP_MIN)
+		return FXP_MIN;
+	return (fxp)p;
+}
+
+//! acc + a*b, both stages saturating.
+static inline fxp fxp_sat_mac(fxp acc, fxp a, fxp b)
+{
+	return fxp_sat_add(acc, fxp_sat_mul(a, b));
+}
+
+//! Q16.16 square root (fixmath.c): isqrt(x << 16) keeps the scale correct.
+fxp fxp_sqrt(fxp x);
+
+/***************************** Q1.15 *****************************************/
+
+//! Same format as the fractional typedef in matrix/matrix_dsp.h.
+typedef int fract;
+
+#define FRACT_MAX     ((fract)32767)
+#define FRACT_MIN     ((fract)-32768)
+
+//! Float to Q1.15 with clamping: +-1.0 and beyond map onto the limits.
+static inline fract fract_from_float(float x)
+{
+	float s = x * 32768.0f;
+	if (s >= 32767.0f)
+		return FRACT_MAX;
+	if (s <= -32768.0f)
+		return FRACT_MIN;
+	return (fract)s;
+}
+
+static inline float fract_to_float(fract x)
+{
+	return (float)x * (1.0f / 32768.0f);
+}
+
+//! Q16.16 to Q1.15 with clamping; the inverse is exact.
+static inline fract fxp_to_fract(fxp x)
+{
+	if (x >= (fxp)0x8000L)
+		return FRACT_MAX;
+	if (x <= (fxp)-0x8000L)
+		return FRACT_MIN;
+	return (fract)(x >> 1);
+}
+
+static inline fxp fract_to_fxp(fract x)
+{
+	return ((fxp)x) << 1;
+}
+
+static inline fract fract_sat_add(fract a, fract b)
+{
+	long r = (long)a + b;
+	if (r > FRACT_MAX)
+		return FRACT_MAX;
+	if (r < FRACT_MIN)
+		return FRACT_MIN;
+	return (fract)r;
+}
+
+#if defined(__C30__) || defined(__XC16__)
+
+/* The DSP accumulator is 40 bits wide, so the 2- and 3-term MACs below
+cannot overflow internally; sac.r rounds and saturates on the way out.
+Same idiom as the private helpers in matrix_dsp.c and fft.c. */
+
+static inline fract fract_mul(fract a, fract b)
+{
+	register int accum asm("A");
+
+	accum = __builtin_mpy(a, b, NULL, NULL, 0, NULL, NULL, 0);
+	return __builtin_sacr(accum, 0);
+}
+
+//! a0*b0 + a1*b1, rounded and saturated once at the end.
+static inline fract fract_mac2(fract a0, fract b0, fract a1, fract b1)
+{
+	register int accum asm("A");
+
+	accum = __builtin_mpy(a0, b0, NULL, NULL, 0, NULL, NULL, 0);
+	accum = __builtin_mac(accum, a1, b1, NULL, NULL, 0, NULL, NULL, 0, NULL);
+	return __builtin_sacr(accum, 0);
+}
+
+//! a0*b0 + a1*b1 + a2*b2, rounded and saturated once at the end.
+static inline fract fract_mac3(fract a0, fract b0, fract a1, fract b1,
+                               fract a2, fract b2)
+{
+	register int accum asm("A");
+
+	accum = __builtin_mpy(a0, b0, NULL, NULL, 0, NULL, NULL, 0);
+	accum = __builtin_mac(accum, a1, b1, NULL, NULL, 0, NULL, NULL, 0, NULL);
+	accum = __builtin_mac(accum, a2, b2, NULL, NULL, 0, NULL, NULL, 0, NULL);
+	return __builtin_sacr(accum, 0);
+}
+
+#else   // host builds (sim): portable mirrors with the same rounding
+
+static inline fract fract_sat_store(long acc)
+{
+	acc = (acc + 0x4000L) >> 15;   // round like sac.r
+	if (acc > FRACT_MAX)
+		return FRACT_MAX;
+	if (acc < FRACT_MIN)
+		return FRACT_MIN;
+	return (fract)acc;
+}
+
+static inline fract fract_mul(fract a, fract b)
+{
+	return fract_sat_store((long)a * b);
+}
+
+static inline fract fract_mac2(fract a0, fract b0, fract a1, fract b1)
+{
+	return fract_sat_store((long)a0 * b0 + (long)a1 * b1);
+}
+
+static inline fract fract_mac3(fract a0, fract b0, fract a1, fract b1,
+                               fract a2, fract b2)
+{
+	return fract_sat_store((long)a0 * b0 + (long)a1 * b1 + (long)a2 * b2);
+}
+
+#endif
+
+#endif // FIXMATH_H
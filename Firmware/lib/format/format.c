@@ -0,0 +1,142 @@
+/*
+ *   Small printf-style formatter, see format.h. Grown out of the telemetry
+ *   formatter in communication_csv.c and moved here so the uart1 transmit
+ *   path (and with it every boot and diagnostic message) can use it too,
+ *   instead of dragging the stdio machinery into the binary.
+ */
+
+#include "format/format.h"
+
+
+static const char format_hex[] = {'0','1','2','3','4','5','6','7','8','9','a','b','c','d','e','f'};
+
+/*
+ *   One integer conversion: digits of x in the given base, an optional
+ *   minus sign and zero/space padding up to width. A zero pad goes after
+ *   the sign ("-042"), a space pad before it (" -42"), like printf.
+ */
+static int format_number(char *dst, int maxlen, unsigned long x,
+                         int base, int negative, int width, char pad)
+{
+	char tmp[12];
+	int i = 0, n = 0, len;
+
+	do
+	{
+		tmp[i++] = format_hex[x % base];
+		x /= base;
+	} while (x > 0);
+
+	len = i + (negative ? 1 : 0);
+	if (negative && pad == '0' && n < maxlen)
+		dst[n++] = '-';
+	while (len < width && n < maxlen)
+	{
+		dst[n++] = pad;
+		len++;
+	}
+	if (negative && pad == ' ' && n < maxlen)
+		dst[n++] = '-';
+	while (i > 0 && n < maxlen)
+		dst[n++] = tmp[--i];
+	return n;
+}
+
+int format_args(char *dst, int maxlen, const char *fmt, va_list ap)
+{
+	int n = 0;
+
+	while (*fmt != '\0' && n < maxlen)
+	{
+		int is_long = 0;
+		int precision = 6;
+		int width = 0;
+		char pad = ' ';
+		long l;
+		unsigned long u;
+		double d;   // same size as float on C30 unless large doubles are enabled
+
+		if (*fmt != '%')
+		{
+			dst[n++] = *fmt++;
+			continue;
+		}
+		fmt++;
+		if (*fmt == '0')   // zero pad, only meaningful with a width
+		{
+			pad = '0';
+			fmt++;
+		}
+		while (*fmt >= '0' && *fmt <= '9')
+			width = width * 10 + (*fmt++ - '0');
+		if (*fmt == '.')   // only used as a precision for %f
+		{
+			fmt++;
+			precision = 0;
+			while (*fmt >= '0' && *fmt <= '9')
+				precision = precision * 10 + (*fmt++ - '0');
+		}
+		if (*fmt == 'l')
+		{
+			is_long = 1;
+			fmt++;
+		}
+		switch (*fmt++)
+		{
+			case 'd':
+				l = is_long ? va_arg(ap, long) : (long)va_arg(ap, int);
+				if (l < 0)
+					n += format_number(&dst[n], maxlen - n, (unsigned long)-l, 10, 1, width, pad);
+				else
+					n += format_number(&dst[n], maxlen - n, (unsigned long)l, 10, 0, width, pad);
+				break;
+			case 'u':
+				u = is_long ? va_arg(ap, unsigned long) : (unsigned long)va_arg(ap, unsigned int);
+				n += format_number(&dst[n], maxlen - n, u, 10, 0, width, pad);
+				break;
+			case 'x':
+				u = is_long ? va_arg(ap, unsigned long) : (unsigned long)va_arg(ap, unsigned int);
+				n += format_number(&dst[n], maxlen - n, u, 16, 0, width, pad);
+				break;
+			case 'c':
+				dst[n++] = (char)va_arg(ap, int);
+				break;
+			case 's':
+			{
+				const char *s = va_arg(ap, const char *);
+				while (*s != '\0' && n < maxlen)
+					dst[n++] = *s++;
+				break;
+			}
+			case 'f':
+				d = va_arg(ap, double);
+				if (d < 0.0)
+				{
+					dst[n++] = '-';
+					d = -d;
+				}
+				l = (long)d;
+				n += format_number(&dst[n], maxlen - n, (unsigned long)l, 10, 0, 0, ' ');
+				if (precision > 0 && n < maxlen)
+				{
+					dst[n++] = '.';
+					d -= (double)l;
+					while (precision-- > 0 && n < maxlen)
+					{
+						d *= 10.0;
+						l = (long)d;
+						dst[n++] = '0' + (char)l;
+						d -= (double)l;
+					}
+				}
+				break;
+			case '%':
+				dst[n++] = '%';
+				break;
+			default:
+				dst[n++] = '?';
+				break;
+		}
+	}
+	return n;
+}
@@ -0,0 +1,18 @@
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include <stdarg.h>
+
+// format.h: the small formatter behind comm_format() and uart1_printf().
+// It only understands what the firmware actually prints - %d, %u, %x, %c,
+// %s, their 'l' variants and %f - plus an optional zero/space padded field
+// width for the integer conversions and a precision for %f (default 6).
+// Unknown conversions come out as '?' so they show up on the console
+// instead of corrupting the stack. The C30 vfprintf this replaces costs
+// several KB of flash and a large slice of every printing task's stack.
+
+//! Formats fmt into dst (not '\0'-terminated), writing at most maxlen
+//! characters; returns the number of characters written.
+int format_args(char *dst, int maxlen, const char *fmt, va_list ap);
+
+#endif // FORMAT_H
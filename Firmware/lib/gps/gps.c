@@ -17,8 +17,10 @@
 
 #include "gps/gps.h"
 #include "microcontroller/microcontroller.h"
+#include "microcontroller/isr_time.h"
 #include "uart2/uart2.h"
 #include "uart1_queue/uart1_queue.h"
+#include "ringbuffer/ringbuffer.h"
 
 
 #define KTS2MS       0.5144f                // knots to meter per second
@@ -42,6 +44,43 @@ volatile char nmea_buffer_GGA[100];
 volatile int  nmea_buffer_GGA_counter = 0;
 
 
+/*
+ *   MTK binary protocol (AXN firmware with the DIYDrones command set).
+ *   One 32-byte frame replaces the RMC + GGA pair and the position comes
+ *   in as int32 1e-7 degree units, so the per-fix character loops and
+ *   double conversions disappear. Enabled with use_binary_protocol in
+ *   struct GpsConfig; the module always boots in NMEA, we switch it over
+ *   in gps_config_output().
+ *
+ *   Frame:   0xD0 0xDD | size (0x20) | payload | ck_a ck_b
+ *   Payload: latitude (int32, 1e-7 deg), longitude (int32, 1e-7 deg),
+ *            altitude (int32, cm), ground speed (int32, cm/s),
+ *            heading (int32, 1e-2 deg), satellites (u8),
+ *            fix type (u8, 2 = 2D, 3 = 3D), date (int32, ddmmyy),
+ *            time (int32, hhmmss * 1000 + ms), hdop (u16).
+ *   The Fletcher checksum pair runs over the size byte and the payload.
+ */
+#define MTK_PREAMBLE1     0xD0
+#define MTK_PREAMBLE2     0xDD
+#define MTK_PAYLOAD_SIZE  32
+
+static int use_binary_protocol = 0;
+volatile int mtk_sentence_number = -1;
+static volatile unsigned char mtk_buffer[MTK_PAYLOAD_SIZE];
+
+/*
+ *   ISR-to-task path: the uart2 interrupt only stores the raw characters
+ *   here, the NMEA and MTK state machines run in the gps task when it
+ *   drains the ring. The task is woken when a checksum-valid GGA or RMC
+ *   newline arrives (see gps_isr_gate) or - the binary frames carry no
+ *   newline - once a whole frame's worth of bytes is waiting.
+ */
+#define GPS_RX_BUFFER_SIZE 256
+static volatile unsigned char gps_rx_buffer[GPS_RX_BUFFER_SIZE];
+static struct ringbuffer gps_rx_ring;
+static volatile unsigned int gps_rx_wake_bytes = GPS_RX_BUFFER_SIZE / 2;
+
+
 //! Contains the state of the RMC parser.
 // state   1234567                                                                98|99|100
 //         $GPRMC,235955.505,V,8960.000000,N,00000.000000,E,0.000,0.00,050180,,,N*40 
@@ -49,28 +88,31 @@ volatile unsigned int state = 0;
 //! Contains the current checksum of the RMC sentence.
 volatile unsigned int checksum = 0;
 
+static void gps_process_char(unsigned char c);
+
 
 void gps_init(struct GpsConfig *gpsconfig)
 {
 	gps_open_port(gpsconfig);
 		
 	// Wait for GPS output. On some old EB85 devices, this can take over 2sec
-	if (rmc_sentence_number == -1 && nmea_buffer_RMC_counter == 0)
+	// (gps_valid_frames_receiving() also parses what arrived in the ring)
+	if (! gps_valid_frames_receiving())
 		microcontroller_delay_ms(10);
-	if (rmc_sentence_number == -1 && nmea_buffer_RMC_counter == 0)
+	if (! gps_valid_frames_receiving())
 		microcontroller_delay_ms(50);
-	if (rmc_sentence_number == -1 && nmea_buffer_RMC_counter == 0)
+	if (! gps_valid_frames_receiving())
 		microcontroller_delay_ms(100);
-	if (rmc_sentence_number == -1 && nmea_buffer_RMC_counter == 0)
+	if (! gps_valid_frames_receiving())
 		microcontroller_delay_ms(200);		
-	if (rmc_sentence_number == -1 && nmea_buffer_RMC_counter == 0)
+	if (! gps_valid_frames_receiving())
 		microcontroller_delay_ms(400);	 // 760ms
-	if (rmc_sentence_number == -1 && nmea_buffer_RMC_counter == 0)
+	if (! gps_valid_frames_receiving())
 		microcontroller_delay_ms(800);	 // 1560ms
-	if (rmc_sentence_number == -1 && nmea_buffer_RMC_counter == 0)
+	if (! gps_valid_frames_receiving())
 		microcontroller_delay_ms(1000);	 // 2560ms
 
-	if (rmc_sentence_number == -1 && nmea_buffer_RMC_counter == 0)
+	if (! gps_valid_frames_receiving())
 	{
 		uart1_puts("timeout...");
 		uart2_open(115200l);
@@ -87,6 +129,13 @@ void gps_init(struct GpsConfig *gpsconfig)
 // Valid frames received/receiving if RMC counter >= 0
 int gps_valid_frames_receiving()
 {
+	unsigned char c;
+
+	// the boot-time polling loops call this before the task blocks on the
+	// semaphore; parse whatever the interrupt buffered so far
+	while (ringbuffer_get(&gps_rx_ring, &c))
+		gps_process_char(c);
+
 	return rmc_sentence_number != -1 || nmea_buffer_RMC_counter != 0;
 }	
 
@@ -100,12 +149,45 @@ void gps_open_port(struct GpsConfig *gpsconfig)
 	
 	uart2_open(gpsconfig->initial_baudrate);
 
+	ringbuffer_init(&gps_rx_ring, gps_rx_buffer, GPS_RX_BUFFER_SIZE);
+	ringbuffer_watch_ring(&gps_rx_ring, "gps rx");
+	// Interrupt per character again: the ISR is just a ring push now, and
+	// the 3/4-full batching left the last bytes of a burst stranded in the
+	// hardware FIFO until the next burst came in.
+	U2STAbits.URXISEL = 0;
 
 	IFS1bits.U2RXIF = 0;	// Clear the Recieve Interrupt Flag
 	IEC1bits.U2RXIE = 1;
 }	
 
 
+void gps_open_raw(long baudrate, unsigned int wake_bytes)
+{
+	uart2_open(baudrate);
+
+	ringbuffer_init(&gps_rx_ring, gps_rx_buffer, GPS_RX_BUFFER_SIZE);
+	ringbuffer_watch_ring(&gps_rx_ring, "gps rx");
+	// the binary path of the receive interrupt is exactly what a raw tap
+	// needs: buffer everything, wake on the high-water mark, no gates
+	use_binary_protocol = 1;
+	gps_rx_wake_bytes = wake_bytes;
+
+	U2STAbits.URXISEL = 0;
+	IFS1bits.U2RXIF = 0;
+	IEC1bits.U2RXIE = 1;
+}
+
+
+int gps_raw_getc()
+{
+	unsigned char c;
+
+	if (ringbuffer_get(&gps_rx_ring, &c))
+		return (int)c;
+	return -1;
+}
+
+
 // Configs the GPS using MTK sentences to use RMC & GGA sentences at 5Hz, and switch to 115200 baud
 void gps_config_output(struct GpsConfig *gpsconfig)
 {
@@ -120,9 +202,22 @@ void gps_config_output(struct GpsConfig *gpsconfig)
 	uart2_puts("$PMTK314,0,1,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0*28\r\n");  // this can take a while if no GPS is connected
 	microcontroller_delay_ms(10);	
 
-	// 5Hz mode
+	// Fix rate: 5Hz default, 10Hz for the modules that support it
 	microcontroller_delay_ms(10);
-	uart2_puts("$PMTK220,200*2C\r\n");
+	if (gpsconfig->fix_rate_10hz)
+		uart2_puts("$PMTK220,100*2F\r\n");
+	else
+		uart2_puts("$PMTK220,200*2C\r\n");
+
+	if (gpsconfig->use_binary_protocol)
+	{
+		// Switch the output from NMEA to the binary protocol
+		microcontroller_delay_ms(10);
+		uart2_puts("$PGCMD,16,0,0,0,0,0*6A\r\n");
+		use_binary_protocol = 1;
+		// no newlines to wake the task on: wake once a frame is buffered
+		gps_rx_wake_bytes = MTK_PAYLOAD_SIZE + 5;   // preamble, size, payload, ck_a/ck_b
+	}
 
     if (gpsconfig->enable_waas)
     {
@@ -279,10 +374,92 @@ double read_positive_double (const char *str)
 }
 
 
+/*!
+ *  Parse an NMEA latitude or longitude field (ddmm.mmmm) straight into
+ *  1e-7 degree units. Integer adds only, plus one multiply/divide pair
+ *  at the end: the minutes are accumulated in 1e-6 minute units and
+ *  1e-6 minutes * 10 / 6 = 1e-7 degrees.
+ *  @param str Pointer to the start of the position field.
+ */
+long read_position_deg_1e7 (const char *str)
+{
+	int i = 0;
+	long raw = 0;        // the "ddmm" part as one integer
+	long min_1e6 = 0;    // fractional minutes in 1e-6 minute units
+	long scale = 100000l;
+	char c;
+
+	while (1)
+	{
+		c = str[i++];
+		if (c >= '0' && c <= '9')
+			raw = raw*10 + (long)(c-'0');
+		else
+			break;
+	}
+	if (c == '.')
+	{
+		while (scale > 0)
+		{
+			c = str[i++];
+			if (c >= '0' && c <= '9')
+				min_1e6 += (long)(c-'0') * scale;
+			else
+				break;
+			scale /= 10;
+		}
+	}
+
+	min_1e6 += (raw % 100l) * 1000000l;   // add the whole minutes
+
+	return (raw / 100l) * 10000000l       // whole degrees
+	       + min_1e6 * 10l / 6l;          // minutes -> 1e-7 degrees
+}
+
+
+/*!
+ *  Parse the RMC ground speed field (knots) straight into cm/s.
+ *  1 knot = 51.44 cm/s, so with the knots accumulated in 1e-3 knot
+ *  units the conversion is a single 32-bit multiply and divide.
+ *  @param str Pointer to the start of the speed field.
+ */
+long read_speed_cm_s (const char *str)
+{
+	int i = 0;
+	long knots_1e3 = 0;
+	long scale = 100l;
+	char c;
+
+	while (1)
+	{
+		c = str[i++];
+		if (c >= '0' && c <= '9')
+			knots_1e3 = knots_1e3*10 + (long)(c-'0');
+		else
+			break;
+	}
+	knots_1e3 *= 1000l;
+	if (c == '.')
+	{
+		while (scale > 0)
+		{
+			c = str[i++];
+			if (c >= '0' && c <= '9')
+				knots_1e3 += (long)(c-'0') * scale;
+			else
+				break;
+			scale /= 10;
+		}
+	}
+
+	return knots_1e3 * 5144l / 100000l;
+}
+
+
 /*!
  *  Convert default NMEA latitude or langitude to radians.
  *  NMEA positions are formatted as 4916.46 when the actual position
- *  is 49� 16.45'. This function transforms this to radians (49.2711666/180.0/3.14159).
+ *  is 49� 16.45'. This function transforms this to radians (49.2711666/180.0/3.14159).
  *  @param p NMEA-formatted position.
  *  @return p converted to radians.
  */
@@ -297,6 +474,69 @@ double position_NMEA_to_rad(double p)
 
 
 
+/*!
+ *  Helper function to assemble a little endian int32 from the binary buffer
+ *  (byte per byte, so the buffer needs no alignment).
+ */
+static long mtk_read_long(int offset)
+{
+	return  ((long) mtk_buffer[offset]) |
+	       (((long) mtk_buffer[offset + 1]) << 8) |
+	       (((long) mtk_buffer[offset + 2]) << 16) |
+	       (((long) mtk_buffer[offset + 3]) << 24);
+}
+
+
+/*!
+ *  Byte-per-byte state machine for the binary frames, called from the
+ *  uart2 interrupt instead of the NMEA parser when the binary protocol
+ *  is active.
+ */
+static void gps_parse_binary(unsigned char c)
+{
+	static int binary_state = 0;
+	static int payload_counter = 0;
+	static unsigned char ck_a, ck_b;
+
+	switch (binary_state)
+	{
+		case 0:   // hunting for the preamble
+			if (c == MTK_PREAMBLE1)
+				binary_state = 1;
+			break;
+		case 1:
+			binary_state = (c == MTK_PREAMBLE2) ? 2 : 0;
+			break;
+		case 2:   // size byte, starts the checksum
+			if (c == MTK_PAYLOAD_SIZE)
+			{
+				ck_a = c;
+				ck_b = c;
+				payload_counter = 0;
+				binary_state = 3;
+			}
+			else
+				binary_state = 0;
+			break;
+		case 3:   // payload
+			mtk_buffer[payload_counter++] = c;
+			ck_a += c;
+			ck_b += ck_a;
+			if (payload_counter == MTK_PAYLOAD_SIZE)
+				binary_state = 4;
+			break;
+		case 4:
+			binary_state = (c == ck_a) ? 5 : 0;
+			break;
+		case 5:
+			if (c == ck_b)
+				mtk_sentence_number++;   // runs in the task now; the wake came from the ISR
+			binary_state = 0;
+			break;
+	}
+}
+
+
 /*!
  *  When the GPS input buffer contains a new RMC sentence, this function
  *  parses the sentence and stores it in the gps_info struct.
@@ -308,11 +548,51 @@ char gps_update_info(struct gps_info *gpsinfo)
 {
 	static int last_call_rmc_sentence_number = -1; // the sentence number
 	static int last_call_gga_sentence_number = -1; // the sentence number
-	
-	if (gga_sentence_number != last_call_gga_sentence_number)
+	static int last_call_mtk_sentence_number = -1;
+
+	unsigned char c;
+
+	// Run the parsers over whatever the interrupt buffered. One writer
+	// (the ISR), one reader (this task): the ring needs no masking of the
+	// RX interrupt, so uart2 keeps receiving while we parse.
+	while (ringbuffer_get(&gps_rx_ring, &c))
+		gps_process_char(c);
+
+	if (use_binary_protocol)
+	{
+		if (mtk_sentence_number == last_call_mtk_sentence_number)
+			return 0;
+
+		gpsinfo->latitude_deg_1e7 = mtk_read_long(0);
+		gpsinfo->longitude_deg_1e7 = mtk_read_long(4);
+		// the radians stay available for the float users; 2 multiplies
+		// per fix instead of the full ASCII parse
+		gpsinfo->latitude_rad = (double) gpsinfo->latitude_deg_1e7 * (DEG2RAD * 1.0e-7);
+		gpsinfo->longitude_rad = (double) gpsinfo->longitude_deg_1e7 * (DEG2RAD * 1.0e-7);
+		gpsinfo->height_m = (int) (mtk_read_long(8) / 100l);
+		gpsinfo->speed_cm_s = mtk_read_long(12);
+		gpsinfo->speed_ms = (float) gpsinfo->speed_cm_s * 0.01f;
+		gpsinfo->heading_rad = (float) mtk_read_long(16) * 0.01f * DEG2RAD;
+		gpsinfo->satellites_in_view = (int) mtk_buffer[20];
+		gpsinfo->date = mtk_read_long(22);
+		gpsinfo->time = mtk_read_long(26) / 1000l;
+
+		if (mtk_buffer[21] >= 2)   // 2D or 3D fix
+		{
+			gpsinfo->last_fix_time = gpsinfo->time;
+			gpsinfo->sentence_number_last_fix = mtk_sentence_number;
+			gpsinfo->status = ACTIVE;
+		}
+		else
+			gpsinfo->status = VOID;
+
+		last_call_mtk_sentence_number = mtk_sentence_number;
+		return 1;
+	}
+	else if (gga_sentence_number != last_call_gga_sentence_number)
 	{
 		//  $GPGGA,110917.000,5051.0242,N,00340.1555,E,1,6,1.16,41.5,M,47.3,M,,*65
-		//printf("new gga");
+		//uart1_printf("new gga");
 		char *stringpointer = (char*) nmea_buffer_GGA;   // overriding the volatileness
 		
 		//Time
@@ -368,30 +648,36 @@ char gps_update_info(struct gps_info *gpsinfo)
 		while (*(stringpointer++) != ',') 
 			;
 				
-		gpsinfo->latitude_rad = position_NMEA_to_rad(read_positive_double(stringpointer));
-		
-		while (*(stringpointer++) != ',') 
+		gpsinfo->latitude_deg_1e7 = read_position_deg_1e7(stringpointer);
+
+		while (*(stringpointer++) != ',')
 			;
-		
+
 		// N or S
 		if (*(stringpointer) == 'S')
-			gpsinfo->latitude_rad *= -1.0;
-			
-		while (*(stringpointer++) != ',') 
+			gpsinfo->latitude_deg_1e7 = -gpsinfo->latitude_deg_1e7;
+
+		while (*(stringpointer++) != ',')
 			;
-			
-		gpsinfo->longitude_rad = position_NMEA_to_rad(read_positive_double(stringpointer));
-		
-		while (*(stringpointer++) != ',') 
+
+		gpsinfo->longitude_deg_1e7 = read_position_deg_1e7(stringpointer);
+
+		while (*(stringpointer++) != ',')
 			;
-		
+
 		if (*(stringpointer) == 'W')
-			gpsinfo->longitude_rad *= -1.0;
-			
-		while (*(stringpointer++) != ',') 
+			gpsinfo->longitude_deg_1e7 = -gpsinfo->longitude_deg_1e7;
+
+		// the radians stay available for the float users, same as the
+		// binary protocol: 2 multiplies instead of the double ASCII parse
+		gpsinfo->latitude_rad = (double) gpsinfo->latitude_deg_1e7 * (DEG2RAD * 1.0e-7);
+		gpsinfo->longitude_rad = (double) gpsinfo->longitude_deg_1e7 * (DEG2RAD * 1.0e-7);
+
+		while (*(stringpointer++) != ',')
 			;
-	
-		gpsinfo->speed_ms = read_positive_float(stringpointer) * KTS2MS;   // convert knots to meter per second
+
+		gpsinfo->speed_cm_s = read_speed_cm_s(stringpointer);
+		gpsinfo->speed_ms = (float) gpsinfo->speed_cm_s * 0.01f;
 		
 		while (*(stringpointer++) != ',') 
 			;
@@ -413,17 +699,20 @@ char gps_update_info(struct gps_info *gpsinfo)
 
 
 /*!
- *  Interrupt routine notifying us a new character is available from the
- *  GPS's uart module.
+ *  Parses one character coming from the GPS's uart module.
  *  This function buffers a valid (structure and checksum) RMC sentence. The
  *  used buffer is nmea_buffer_RMC.
  */
-void __attribute__((__interrupt__, __shadow__, __auto_psv__)) _U2RXInterrupt(void)
+static void gps_process_char(unsigned char c)
 {
-	unsigned char c = U2RXREG;
 	//uart1_putc(c);
-	
- 
+
+	if (use_binary_protocol)
+	{
+		gps_parse_binary(c);
+		return;
+	}
+
 	if (c == '$')   // Beginnng of new sequence
 	{
 		state = 1;
@@ -448,10 +737,6 @@ void __attribute__((__interrupt__, __shadow__, __auto_psv__)) _U2RXInterrupt(voi
 		if (checksum == 0)
 			gga_sentence_number++;
 		state = 92;
-#ifndef TEST
-		static portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE; 
-		xSemaphoreGiveFromISR( xGpsSemaphore, &xHigherPriorityTaskWoken );
-#endif		
 	}	
 	else if (state == 98)
 	{
@@ -466,12 +751,6 @@ void __attribute__((__interrupt__, __shadow__, __auto_psv__)) _U2RXInterrupt(voi
 			rmc_sentence_number++;
 
 		state = 100;
-
-// small test programs don't use FreeRTOS so we need a way to avoid 
-#ifndef TEST
-		static portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE; 
-		xSemaphoreGiveFromISR( xGpsSemaphore, &xHigherPriorityTaskWoken );
-#endif
 	}
 	else 
 	{
@@ -534,5 +813,113 @@ void __attribute__((__interrupt__, __shadow__, __auto_psv__)) _U2RXInterrupt(voi
 				nmea_buffer_GGA_counter = 0;
 		}
 	}
-	_U2RXIF = 0;
+}
+
+
+/*
+ *   Wake gate for the receive interrupt: a running XOR checksum and a
+ *   header match against the two sentences we asked for in $PMTK314,
+ *   so a noise burst or a bad checksum never wakes the task. Only the
+ *   accumulator runs at interrupt level; gps_process_char() in the task
+ *   stays the authoritative parser and validates the checksum again
+ *   from the ring. Returns 1 on the newline of a validated sentence.
+ */
+static const char gate_rmc[6] = {'G','P','R','M','C',','};
+static const char gate_gga[6] = {'G','P','G','G','A',','};
+
+static int gps_isr_gate(unsigned char c)
+{
+	static unsigned char gate_state = 0;   // 0 idle, 1-6 header, 7 payload, 8-9 checksum digits, 10 complete
+	static unsigned char gate_checksum = 0;
+	static unsigned char gate_expected = 0;
+	static unsigned char gate_rmc_ok = 0, gate_gga_ok = 0;
+
+	if (c == '$')   // also resyncs after a dropped or corrupted character
+	{
+		gate_state = 1;
+		gate_checksum = 0;
+		gate_rmc_ok = 1;
+		gate_gga_ok = 1;
+	}
+	else if (c == '\n')
+	{
+		int valid = (gate_state == 10 && gate_checksum == gate_expected);
+		gate_state = 0;
+		return valid;
+	}
+	else if (gate_state >= 1 && gate_state <= 6)
+	{
+		gate_checksum ^= c;
+		if (gate_rmc_ok && c != gate_rmc[gate_state - 1])
+			gate_rmc_ok = 0;
+		if (gate_gga_ok && c != gate_gga[gate_state - 1])
+			gate_gga_ok = 0;
+		if (gate_rmc_ok || gate_gga_ok)
+			gate_state++;
+		else
+			gate_state = 0;   // not a sentence we wake for
+	}
+	else if (gate_state == 7)
+	{
+		if (c == '*')
+		{
+			gate_expected = 0;
+			gate_state = 8;
+		}
+		else
+			gate_checksum ^= c;
+	}
+	else if (gate_state == 8)
+	{
+		gate_expected = hexchar2int(c) * 16;
+		gate_state = 9;
+	}
+	else if (gate_state == 9)
+	{
+		gate_expected += hexchar2int(c);
+		gate_state = 10;
+	}
+	return 0;
+}
+
+
+/*!
+ *  Receive interrupt: pushes the raw characters into the ring and decides
+ *  when to wake the gps task - on the newline of a checksum-valid GGA or
+ *  RMC sentence, or once a binary frame's worth of bytes is buffered
+ *  (gps_rx_wake_bytes). The sentence parsing itself moved into the task,
+ *  so this routine costs a header compare and a checksum xor per
+ *  character, instead of a full state-machine step at interrupt level.
+ */
+void __attribute__((__interrupt__, __shadow__, __auto_psv__)) _U2RXInterrupt(void)
+{
+	unsigned char c;
+	int signal = 0;
+	ISR_TIME_DECLARE;
+
+	ISR_TIME_ENTER();
+	_U2RXIF = 0;   // clear first: a FIFO that fills up again re-asserts it
+
+	while (U2STAbits.URXDA)
+	{
+		c = (unsigned char) U2RXREG;
+		if (! ringbuffer_put(&gps_rx_ring, c))
+			continue;   // full: drop; the parsers resync on '$' or the preamble
+		if (use_binary_protocol)
+		{
+			if (ringbuffer_used(&gps_rx_ring) == gps_rx_wake_bytes)
+				signal = 1;
+		}
+		else if (gps_isr_gate(c) || ringbuffer_used(&gps_rx_ring) == gps_rx_wake_bytes)
+			signal = 1;   // high-water wake: a noise-filled ring still gets drained
+	}
+
+#ifndef TEST
+	if (signal)
+	{
+		static portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+		xSemaphoreGiveFromISR( xGpsSemaphore, &xHigherPriorityTaskWoken );
+	}
+#endif
+	ISR_TIME_EXIT(ISR_TIME_GPS_RX);
 }
@@ -11,11 +11,18 @@ struct gps_info {
 	long last_fix_time;
 	int  satellites_in_view;
 	int  height_m;
-	
+
 	double latitude_rad,
 	       longitude_rad;
+
+	// Same position in 1e-7 degree units; the binary protocol delivers
+	// these directly, the NMEA parser derives them from the radians.
+	// Integer math on these is a lot cheaper than double trig.
+	long latitude_deg_1e7,
+	     longitude_deg_1e7;
 	      
 	float speed_ms;      // meter per second
+	long  speed_cm_s;    // same speed in cm/s for the fixed-point users
 	float heading_rad;   // in radians
 	
 	int sentence_number_last_fix;
@@ -28,7 +35,9 @@ struct GpsConfig
 	long initial_baudrate;
 	long operational_baudrate;
     unsigned int enable_waas : 1;
-};	
+    unsigned int use_binary_protocol : 1;   // MTK binary instead of NMEA, see gps.c
+    unsigned int fix_rate_10hz : 1;         // 10Hz fixes instead of 5Hz (MTK only)
+};
 
 void gps_init(struct GpsConfig *gpsconfig);
 
@@ -40,6 +49,15 @@ void gps_config_output();
 
 void gps_open_port(struct GpsConfig *gpsconfig);
 
+//! Opens uart2 as a raw byte tap for non-gps uses of the port (the
+//! redundancy mirror): the receive interrupt buffers everything and gives
+//! the gps semaphore every wake_bytes characters; no gps parsing runs.
+//! Drain with gps_raw_getc().
+void gps_open_raw(long baudrate, unsigned int wake_bytes);
+
+//! Next buffered raw character, or -1 when the ring is empty.
+int gps_raw_getc();
+
 int gps_valid_frames_receiving();
 
 
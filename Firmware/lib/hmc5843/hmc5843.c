@@ -21,6 +21,7 @@
 #include "i2c/i2c.h"
 #include "hmc5843.h"
 #include "microcontroller/microcontroller.h"
+#include "uart1_queue/uart1_queue.h"
 
 
 // initialize HMC5843
@@ -73,12 +74,35 @@ void hmc5843_read(struct intvector *magdata)
     magdata->y.i16 = -magdata->y.i16;
 }
 
+// Asynchronous variant of hmc5843_read(): one interrupt-driven burst of the
+// six data registers instead of six full blocking transactions. Submit,
+// compute something useful, then fetch with hmc5843_requested_read().
+static unsigned char async_magbuffer[6];
+
+void hmc5843_request_read(void)
+{
+	i2c_async_read(0x3C, 3, async_magbuffer, 6, 0);
+}
+
+void hmc5843_requested_read(struct intvector *magdata)
+{
+	i2c_async_wait();
+	magdata->x.b2.hbyte = async_magbuffer[0];
+	magdata->x.b2.lbyte = async_magbuffer[1];
+	magdata->z.b2.hbyte = async_magbuffer[2];
+	magdata->z.b2.lbyte = async_magbuffer[3];
+	magdata->y.b2.hbyte = async_magbuffer[4];
+	magdata->y.b2.lbyte = async_magbuffer[5];
+	magdata->z.i16 = -magdata->z.i16;
+	magdata->y.i16 = -magdata->y.i16;
+}
+
 // exhibit the status of the HMC5843
-void test_HMC5843() 
+void test_HMC5843()
 {
-	printf( "rega %u \r\n", I2Cread(0x03C,0));
-	printf( "regb %u \r\n", I2Cread(0x03C,1));
-	printf( "mode %u \r\n", I2Cread(0x03C,2));
-	printf( "stat %u \r\n", I2Cread(0x03C,9));
-	printf( "id   %1c%1c%1c \r\n",I2Cread(0x03C,10),I2Cread(0x03C,11),I2Cread(0x03C,12));
+	uart1_printf( "rega %u \r\n", I2Cread(0x03C,0));
+	uart1_printf( "regb %u \r\n", I2Cread(0x03C,1));
+	uart1_printf( "mode %u \r\n", I2Cread(0x03C,2));
+	uart1_printf( "stat %u \r\n", I2Cread(0x03C,9));
+	uart1_printf( "id   %1c%1c%1c \r\n",I2Cread(0x03C,10),I2Cread(0x03C,11),I2Cread(0x03C,12));
 }
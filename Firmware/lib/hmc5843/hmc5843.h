@@ -56,6 +56,12 @@ void hmc5843_init(void);
 // get new data 3 axis
 void hmc5843_read(struct intvector *magdata);
 
+// asynchronous version: submit the 6-byte burst to the interrupt engine...
+void hmc5843_request_read(void);
+
+// ...and fetch the unpacked vector once it is in (waits if it is not)
+void hmc5843_requested_read(struct intvector *magdata);
+
 // read misc registers
 void test_HMC5843(void);
 
@@ -17,6 +17,7 @@ void i2c_wait_acken()
 void i2c_start(void)
 {
 	int x = 0;
+	i2c_async_wait(); // never walk into a transaction the interrupt engine still owns
 	I2C1CONbits.ACKDT = 0; //Reset any previous Ack
 	microcontroller_delay_us(10);
 	I2C1CONbits.SEN = 1; //Initiate Start condition
@@ -176,3 +177,147 @@ char I2Cread(char addr, char subaddr)
 	reset_i2c_bus();
 	return temp;
 }
+
+
+/*
+ *   Asynchronous engine: one transaction at a time, driven entirely by the
+ *   MI2C1 interrupt (which fires after every completed start/restart/stop,
+ *   transmitted byte and acknowledge sequence). The caller submits a
+ *   register read or write and gets its callback from the interrupt when
+ *   the stop condition is out, so the task can compute while the bus works.
+ *   The blocking primitives above stay valid: i2c_start() first waits for
+ *   the engine to go idle.
+ */
+
+enum i2c_async_state
+{
+	AS_IDLE = 0,
+	AS_DEVICE,      // start done, device address goes out
+	AS_SUBADDR,     // device acked, register address goes out
+	AS_VALUE,       // register acked, data byte goes out (write only)
+	AS_RESTART,     // register acked, repeated start (read only)
+	AS_DEVICE_R,    // restart done, device address + read bit goes out
+	AS_RECEIVE,     // byte is being clocked in
+	AS_ACK,         // master (n)ack of the received byte
+	AS_STOP2,       // last byte is done, stop condition goes out
+	AS_STOP         // stop condition is going out
+};
+
+static volatile enum i2c_async_state async_state = AS_IDLE;
+static unsigned char async_device;
+static unsigned char async_subaddr;
+static unsigned char async_value;
+static unsigned char *async_rxdata;
+static int async_rxlen;
+static int async_rxpos;
+static void (*async_on_complete)(void);
+
+static void i2c_async_launch(void)
+{
+	async_state = AS_DEVICE;
+	IFS1bits.MI2C1IF = 0;
+	IEC1bits.MI2C1IE = 1;
+	I2C1CONbits.ACKDT = 0;
+	I2C1CONbits.SEN = 1;
+}
+
+void i2c_async_write(unsigned char device, unsigned char subaddr, unsigned char value,
+                     void (*on_complete)(void))
+{
+	i2c_async_wait();
+	async_device = device;
+	async_subaddr = subaddr;
+	async_value = value;
+	async_rxlen = 0;
+	async_on_complete = on_complete;
+	i2c_async_launch();
+}
+
+void i2c_async_read(unsigned char device, unsigned char subaddr,
+                    unsigned char *rxdata, int rxlen, void (*on_complete)(void))
+{
+	i2c_async_wait();
+	async_device = device;
+	async_subaddr = subaddr;
+	async_rxdata = rxdata;
+	async_rxlen = rxlen;
+	async_rxpos = 0;
+	async_on_complete = on_complete;
+	i2c_async_launch();
+}
+
+int i2c_async_busy(void)
+{
+	return async_state != AS_IDLE;
+}
+
+void i2c_async_wait(void)
+{
+	long i = 0;
+	while (async_state != AS_IDLE)
+	{
+		if (i++ > 100000l)   // a transaction takes ~150us; this is a broken bus
+		{
+			IEC1bits.MI2C1IE = 0;
+			async_state = AS_IDLE;
+			reset_i2c_bus();
+			break;
+		}
+	}
+}
+
+void __attribute__((__interrupt__, auto_psv)) _MI2C1Interrupt( void )
+{
+	IFS1bits.MI2C1IF = 0;
+
+	switch (async_state)
+	{
+		case AS_DEVICE:
+			I2CTRN = async_device;
+			async_state = AS_SUBADDR;
+			break;
+		case AS_SUBADDR:
+			if (I2C1STATbits.ACKSTAT)   // no device: just get off the bus
+			{
+				I2C1CONbits.PEN = 1;
+				async_state = AS_STOP;
+				break;
+			}
+			I2CTRN = async_subaddr;
+			async_state = (async_rxlen > 0) ? AS_RESTART : AS_VALUE;
+			break;
+		case AS_VALUE:
+			I2CTRN = async_value;
+			async_state = AS_STOP2;
+			break;
+		case AS_RESTART:
+			I2C1CONbits.RSEN = 1;
+			async_state = AS_DEVICE_R;
+			break;
+		case AS_DEVICE_R:
+			I2CTRN = async_device | 0x01;
+			async_state = AS_RECEIVE;
+			break;
+		case AS_RECEIVE:
+			I2C1CONbits.RCEN = 1;
+			async_state = AS_ACK;
+			break;
+		case AS_ACK:
+			async_rxdata[async_rxpos++] = I2CRCV;
+			I2C1CONbits.ACKDT = (async_rxpos < async_rxlen) ? 0 : 1;   // nack the last byte
+			I2C1CONbits.ACKEN = 1;
+			async_state = (async_rxpos < async_rxlen) ? AS_RECEIVE : AS_STOP2;
+			break;
+		case AS_STOP2:
+			I2C1CONbits.PEN = 1;
+			async_state = AS_STOP;
+			break;
+		case AS_STOP:
+		default:
+			IEC1bits.MI2C1IE = 0;
+			async_state = AS_IDLE;
+			if (async_on_complete)
+				async_on_complete();
+			break;
+	}
+}
@@ -31,3 +31,21 @@ void I2Cwrite(char addr, char subaddr, char value);
 
 //read from an address
 char I2Cread(char addr, char subaddr);
+
+
+// Asynchronous engine: submit a register read/write and get the callback
+// from the MI2C1 interrupt when the stop condition is out. One transaction
+// at a time; the blocking calls above wait for the engine before starting.
+// The callback runs in interrupt context, so keep it to setting a flag.
+
+void i2c_async_write(unsigned char device, unsigned char subaddr, unsigned char value,
+                     void (*on_complete)(void));
+
+void i2c_async_read(unsigned char device, unsigned char subaddr,
+                    unsigned char *rxdata, int rxlen, void (*on_complete)(void));
+
+//returns 1 while a submitted transaction is still on the bus
+int i2c_async_busy(void);
+
+//blocks (with timeout) until the engine is idle
+void i2c_async_wait(void);
@@ -10,6 +10,7 @@
 #include <stdio.h>
 
 #include "matrix/matrix.h"
+#include "uart1_queue/uart1_queue.h"
 
 /**
  *   A + B = R
@@ -44,21 +45,21 @@ float * matrix_3x3_add(float *A, float *B, float *R)
 
 void matrix_print_2x2(float *A)
 {
-	printf ("%.2f  %.2f	\r\n%.2f  %.2f\r\n", A[0], A[1], A[2], A[3]);
+	uart1_printf ("%.2f  %.2f	\r\n%.2f  %.2f\r\n", A[0], A[1], A[2], A[3]);
 }	
 
 void matrix_print_3x2(float *A)
 {
-	printf ("%.2f  %.2f	\r\n%.2f  %.2f\r\n%.2f  %.2f\r\n", A[0], A[1], A[2], A[3], A[4], A[5]);
+	uart1_printf ("%.2f  %.2f	\r\n%.2f  %.2f\r\n%.2f  %.2f\r\n", A[0], A[1], A[2], A[3], A[4], A[5]);
 }
 
 void matrix_print_2x3(float *A)
 {
-	printf ("%.2f  %.2f	 %.2f\r\n%.2f  %.2f  %.2f\r\n", A[0], A[1], A[2], A[3], A[4], A[5]);
+	uart1_printf ("%.2f  %.2f	 %.2f\r\n%.2f  %.2f  %.2f\r\n", A[0], A[1], A[2], A[3], A[4], A[5]);
 }
 
 void matrix_print_3x3(float *A)
 {
-	printf ("%.3f  %.3f	 %.3f\r\n%.3f  %.3f  %.3f\r\n%.3f  %.3f  %.3f\r\n", A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[8]);
+	uart1_printf ("%.3f  %.3f	 %.3f\r\n%.3f  %.3f  %.3f\r\n%.3f  %.3f  %.3f\r\n", A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[8]);
 }	
 */
@@ -1,5 +1,9 @@
- 
- 
+
+// DSP-engine (Q1.15 MAC) versions of the hot kernels below; same shapes and
+// naming with a _fract suffix. Callers with fractional state use these, the
+// float macros stay as they are for the float filters.
+#include "matrix/matrix_dsp.h"
+
  /**
   *    MACROS from GLUT (vvector.h) see http://developer.apple.com/mac/library/samplecode/glut/Listings/gle_vvector_h.html#//apple_ref/doc/uid/DTS10000528-gle_vvector_h-DontLinkElementID_52
   */
@@ -0,0 +1,154 @@
+/*    Matrix library, DSP engine edition
+ *
+ *    Q1.15 kernels for the shapes the kalman filters need. Each dot product
+ *    runs in accumulator A (40 bit, so no intermediate overflow for our
+ *    2- and 3-term sums) and is stored back rounded with sac.r.
+ *
+ *    Major row, same layout as matrix.c:
+ *
+ *    [ a00, a01;
+ *      a10, a11]
+ *    is saved as [ a00, a01, a10, a11 ]
+ */
+
+#include "matrix/matrix_dsp.h"
+#include "microcontroller/hotcode.h"
+
+
+/*!
+ *   a0*b0 + a1*b1 in accumulator A.
+ */
+static inline fractional dsp_mac2(fractional a0, fractional b0,
+                                  fractional a1, fractional b1)
+{
+	register int accum asm("A");
+
+	accum = __builtin_mpy(a0, b0, NULL, NULL, 0, NULL, NULL, 0);
+	accum = __builtin_mac(accum, a1, b1, NULL, NULL, 0, NULL, NULL, 0, NULL);
+	return __builtin_sacr(accum, 0);
+}
+
+/*!
+ *   a0*b0 + a1*b1 + a2*b2 in accumulator A.
+ */
+static inline fractional dsp_mac3(fractional a0, fractional b0,
+                                  fractional a1, fractional b1,
+                                  fractional a2, fractional b2)
+{
+	register int accum asm("A");
+
+	accum = __builtin_mpy(a0, b0, NULL, NULL, 0, NULL, NULL, 0);
+	accum = __builtin_mac(accum, a1, b1, NULL, NULL, 0, NULL, NULL, 0, NULL);
+	accum = __builtin_mac(accum, a2, b2, NULL, NULL, 0, NULL, NULL, 0, NULL);
+	return __builtin_sacr(accum, 0);
+}
+
+
+/**
+ *   A + B = R
+ */
+void matrix_2x2_add_fract(fractional *A, fractional *B, fractional *R)
+{
+	R[0] = A[0] + B[0];
+	R[1] = A[1] + B[1];
+	R[2] = A[2] + B[2];
+	R[3] = A[3] + B[3];
+}
+
+/**
+ *   A + B = R
+ */
+void matrix_3x3_add_fract(fractional *A, fractional *B, fractional *R)
+{
+	int i;
+	for (i = 0; i < 9; i++)
+		R[i] = A[i] + B[i];
+}
+
+/**
+ *   A[2x2] * B[2x2] = R
+ */
+HOT_CODE void matrix_2x2_mul_fract(fractional *A, fractional *B, fractional *R)
+{
+	R[0] = dsp_mac2(A[0], B[0], A[1], B[2]);
+	R[1] = dsp_mac2(A[0], B[1], A[1], B[3]);
+	R[2] = dsp_mac2(A[2], B[0], A[3], B[2]);
+	R[3] = dsp_mac2(A[2], B[1], A[3], B[3]);
+}
+
+/**
+ *   A[2x2] * B'[2x2] = R
+ */
+HOT_CODE void matrix_2x2_mul_transp_fract(fractional *A, fractional *B, fractional *R)
+{
+	R[0] = dsp_mac2(A[0], B[0], A[1], B[1]);
+	R[1] = dsp_mac2(A[0], B[2], A[1], B[3]);
+	R[2] = dsp_mac2(A[2], B[0], A[3], B[1]);
+	R[3] = dsp_mac2(A[2], B[2], A[3], B[3]);
+}
+
+/**
+ *   A[2x2] * B'[3x2] = R[2x3]
+ */
+HOT_CODE void matrix_2x2_times_3x2_transp_fract(fractional *A, fractional *B, fractional *R)
+{
+	R[0] = dsp_mac2(A[0], B[0], A[1], B[1]);
+	R[1] = dsp_mac2(A[0], B[2], A[1], B[3]);
+	R[2] = dsp_mac2(A[0], B[4], A[1], B[5]);
+	R[3] = dsp_mac2(A[2], B[0], A[3], B[1]);
+	R[4] = dsp_mac2(A[2], B[2], A[3], B[3]);
+	R[5] = dsp_mac2(A[2], B[4], A[3], B[5]);
+}
+
+/**
+ *   A[3x2] * B[2x2] = R[3x2]
+ */
+HOT_CODE void matrix_3x2_times_2x2_fract(fractional *A, fractional *B, fractional *R)
+{
+	R[0] = dsp_mac2(A[0], B[0], A[1], B[2]);
+	R[1] = dsp_mac2(A[0], B[1], A[1], B[3]);
+	R[2] = dsp_mac2(A[2], B[0], A[3], B[2]);
+	R[3] = dsp_mac2(A[2], B[1], A[3], B[3]);
+	R[4] = dsp_mac2(A[4], B[0], A[5], B[2]);
+	R[5] = dsp_mac2(A[4], B[1], A[5], B[3]);
+}
+
+/**
+ *   A[3x2] * B'[3x2] = R[3x3]
+ */
+HOT_CODE void matrix_3x2_times_3x2_transp_fract(fractional *A, fractional *B, fractional *R)
+{
+	R[0] = dsp_mac2(A[0], B[0], A[1], B[1]);
+	R[1] = dsp_mac2(A[0], B[2], A[1], B[3]);
+	R[2] = dsp_mac2(A[0], B[4], A[1], B[5]);
+	R[3] = dsp_mac2(A[2], B[0], A[3], B[1]);
+	R[4] = dsp_mac2(A[2], B[2], A[3], B[3]);
+	R[5] = dsp_mac2(A[2], B[4], A[3], B[5]);
+	R[6] = dsp_mac2(A[4], B[0], A[5], B[1]);
+	R[7] = dsp_mac2(A[4], B[2], A[5], B[3]);
+	R[8] = dsp_mac2(A[4], B[4], A[5], B[5]);
+}
+
+/**
+ *   A[2x3] * B[3x2] = R[2x2]
+ */
+HOT_CODE void matrix_2x3_times_3x2_fract(fractional *A, fractional *B, fractional *R)
+{
+	R[0] = dsp_mac3(A[0], B[0], A[1], B[2], A[2], B[4]);
+	R[1] = dsp_mac3(A[0], B[1], A[1], B[3], A[2], B[5]);
+	R[2] = dsp_mac3(A[3], B[0], A[4], B[2], A[5], B[4]);
+	R[3] = dsp_mac3(A[3], B[1], A[4], B[3], A[5], B[5]);
+}
+
+/**
+ *   A[2x3] * B[3x3] = R[2x3]
+ */
+HOT_CODE void matrix_2x3_times_3x3_fract(fractional *A, fractional *B, fractional *R)
+{
+	R[0] = dsp_mac3(A[0], B[0], A[1], B[3], A[2], B[6]);
+	R[1] = dsp_mac3(A[0], B[1], A[1], B[4], A[2], B[7]);
+	R[2] = dsp_mac3(A[0], B[2], A[1], B[5], A[2], B[8]);
+	R[3] = dsp_mac3(A[3], B[0], A[4], B[3], A[5], B[6]);
+	R[4] = dsp_mac3(A[3], B[1], A[4], B[4], A[5], B[7]);
+	R[5] = dsp_mac3(A[3], B[2], A[4], B[5], A[5], B[8]);
+}
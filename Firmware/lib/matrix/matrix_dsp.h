@@ -0,0 +1,34 @@
+/*!
+ *  @file     matrix_dsp.h
+ *  @brief    Small-matrix kernels on the dsPIC33 DSP engine (single-cycle MAC).
+ *
+ *  The DSP accumulators work on Q1.15 fractionals, so these kernels take
+ *  fractional arrays instead of the float arrays used by the macros in
+ *  matrix.h. Same shapes, same row-major layout, same naming: any caller
+ *  that keeps its state in fractionals (e.g. the fixed-point kalman filter)
+ *  can swap the macro for the _fract function without further changes.
+ *
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ */
+
+#ifndef MATRIX_DSP_H
+#define MATRIX_DSP_H
+
+typedef int fractional;   // Q1.15: [-1.0, 1.0)
+
+#define FLOAT2FRACT(x)  ((fractional)((x) * 32768.0))
+#define FRACT2FLOAT(x)  ((float)(x) / 32768.0f)
+
+void matrix_2x2_add_fract(fractional *A, fractional *B, fractional *R);
+void matrix_3x3_add_fract(fractional *A, fractional *B, fractional *R);
+
+void matrix_2x2_mul_fract(fractional *A, fractional *B, fractional *R);
+void matrix_2x2_mul_transp_fract(fractional *A, fractional *B, fractional *R);
+void matrix_2x2_times_3x2_transp_fract(fractional *A, fractional *B, fractional *R);
+void matrix_3x2_times_2x2_fract(fractional *A, fractional *B, fractional *R);
+void matrix_3x2_times_3x2_transp_fract(fractional *A, fractional *B, fractional *R);
+void matrix_2x3_times_3x2_fract(fractional *A, fractional *B, fractional *R);
+void matrix_2x3_times_3x3_fract(fractional *A, fractional *B, fractional *R);
+
+#endif // MATRIX_DSP_H
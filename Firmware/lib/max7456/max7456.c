@@ -56,20 +56,54 @@ int max756_read_status()
 }	
 
 
+//! Bump this when the font table below changes; it is what decides whether
+//! a boot needs to upload the character set at all.
+#define CHARSET_VERSION           0x01
+
 void max7456_loadchars()
 {
 	int i, j;
-	
+	unsigned char nvm[0x36];
+	unsigned char video_mode;
+
+	// Glyph 0xFF can never be displayed (0xFF ends an auto-increment burst),
+	// so its first two bytes hold a charset version tag. When the tag
+	// matches, the NVM already contains this font: skip the whole upload
+	// instead of re-burning 256 characters every boot.
+	spiReadFM(0xFF, nvm);
+	if (nvm[0] == CHARSET_VERSION && nvm[1] == (unsigned char) ~CHARSET_VERSION)
+		return;
+
+	video_mode = spiReadReg(VIDEO_MODE_0_READ);
+	spiWriteReg(VIDEO_MODE_0_WRITE, video_mode & 0xF7);   // OSD off once, not per character
+
 	for (i = 0; i < 256; i++)
 	{
-		for (j = 0; j < 56; j++)
+		for (j = 0; j < 0x36; j++)
 		{
 			data[j+2] = chars[i][j];
 		}	
 		data[1] = (unsigned char) i;
-			spiWriteFM();
-	}	
-	
+		if (i == 0xFF)
+		{
+			data[2] = CHARSET_VERSION;                    // the version tag glyph
+			data[3] = (unsigned char) ~CHARSET_VERSION;   // written last: an interrupted upload retries
+		}
+
+		// the ~12ms NV array burn per character is what made the full
+		// upload take seconds; a shadow RAM readback is far cheaper, so
+		// only burn the characters that actually differ
+		spiReadFM((unsigned char) i, nvm);
+		for (j = 0; j < 0x36; j++)
+		{
+			if (nvm[j] != (unsigned char) data[j+2])
+				break;
+		}
+		if (j == 0x36)
+			continue;
+
+		spiWriteFM();
+	}
 }	
 
 
@@ -298,12 +332,10 @@ void spiWriteCM()                                       // On entry: global data
  *
  * Writes to the Character Memory (54 bytes) from "data" extern
 **************************************************************************************/
-void spiWriteFM()
-{
+void spiWriteFM()                                       // The caller must have DISABLED the OSD display
+{                                                       // (VIDEO_MODE_0 bit 0x08) before writing font memory
      unsigned char Index;
      
-     spiWriteReg(VIDEO_MODE_0_WRITE,spiReadReg
-                 (VIDEO_MODE_0_READ)&0xF7);             // Clear bit 0x08 to DISABLE the OSD display
      spiWriteReg(FM_ADDRH_WRITE,data[1]);               // Write the address of the character to be written
                                                   	// MAX7456 glyph tile definition length = 0x36 = 54 bytes
                                                         // MAX7456 64-byte Shadow RAM accessed
@@ -323,6 +355,28 @@ void spiWriteFM()
      
 }
 
+/**************************************************************************************
+ * spiReadFM
+ *
+ * Reads one character (54 bytes) from the Character Memory into dst:
+ * triggers the NV array to shadow RAM copy and reads the shadow back.
+**************************************************************************************/
+void spiReadFM(unsigned char char_index, unsigned char *dst)
+{
+     unsigned char Index;
+
+     spiWriteReg(FM_ADDRH_WRITE,char_index);            // Character to read
+     spiWriteReg(FM_MODE_WRITE,0x50);                   // MAX7456 "Font Memory Mode" write 0x50 triggers
+                                                        // copy from NV array to 64-byte Shadow RAM.
+     while ((spiReadReg(STATUS_READ) & 0x20) != 0x00);  // Wait while NV Memory status is BUSY
+
+     for(Index=0x00; Index<0x36; Index++)
+     {
+          spiWriteReg(FM_ADDRL_WRITE,Index);            // Address within the shadow RAM
+          dst[Index] = spiReadReg(FM_DATA_OUT_READ);
+     }
+}
+
 
 // chars 0 - 255 with 54 byte per char
 // orginal filename: gluonpilot2 (6).mcm
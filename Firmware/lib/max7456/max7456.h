@@ -121,9 +121,11 @@
 
 void max7456_init();
 void spiWriteReg(const unsigned char regAddr, const unsigned char regData);
+void spiWriteRegAutoIncr(const unsigned char regData);
 unsigned char spiReadReg (const unsigned char regAddr);
 void spiWriteCM();
 void spiWriteFM();
+void spiReadFM(unsigned char char_index, unsigned char *dst);
 
 int max756_read_status();
 
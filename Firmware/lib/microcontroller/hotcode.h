@@ -0,0 +1,26 @@
+/*! 
+ *  @file     hotcode.h
+ *  @brief    Placement annotation for the hottest control and AHRS kernels.
+ *  @detailed HOT_CODE marks a function definition as belonging to the grouped
+ *            ".hotcode" program section. The dsPIC33F flash already runs at
+ *            zero wait states up to 40 MIPS and the core cannot execute from
+ *            RAM, so on this part the annotation costs nothing at run time:
+ *            it groups the kernels in the map file so their footprint can be
+ *            tracked. A port to a part where flash wait states do bite (and a
+ *            startup copy into a RAM section pays off) only has to change
+ *            this one macro.
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#ifndef HOTCODE_H
+#define HOTCODE_H
+
+#if defined(__C30__) || defined(__XC16__)
+	#define HOT_CODE __attribute__((section(".hotcode")))
+#else
+	#define HOT_CODE    // host builds (sim) keep the default placement
+#endif
+
+#endif // HOTCODE_H
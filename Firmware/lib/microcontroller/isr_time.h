@@ -0,0 +1,80 @@
+/*!
+ *  @file     isr_time.h
+ *  @brief    Optional per-vector ISR cycle accounting.
+ *  @detailed Define ISR_PROFILING in the build configuration (rtos_pilot.X)
+ *            to time every instrumented interrupt routine: entry and exit
+ *            read the free-running TMR5:TMR4 cycle counter (started by
+ *            profiler_init) and book the delta on the vector's accumulator.
+ *            Without the define all three macros compile away, so the
+ *            library ISRs cost nothing extra in normal builds.
+ *
+ *            Like the PROFILING trace macro in FreeRTOSConfig.h, the
+ *            storage lives in rtos_pilot/profiler.c - only that project
+ *            defines ISR_PROFILING, so the example projects keep linking
+ *            the library ISRs without it.
+ *
+ *            Reading TMR4 latches TMR5 into the one shared TMR5HLD
+ *            register (the pps capture ISR reads the pair the same way;
+ *            task level code goes through timer_ticks_32(), which raises
+ *            IPL around the two reads). A higher-priority instrumented
+ *            ISR preempting between the two reads can therefore clobber
+ *            the latch - a rare, one-off error of at most 65536 cycles,
+ *            which the 5s reporting window drowns out. Not worth raising
+ *            IPL on every interrupt entry.
+ *
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+#ifndef ISR_TIME_H
+#define ISR_TIME_H
+
+//! Accumulator index per instrumented vector.
+#define ISR_TIME_UART1_TX   0   //!< _DMA3Interrupt (uart1_queue.c)
+#define ISR_TIME_UART1_RX   1   //!< _U1RXInterrupt (uart1_queue.c, both variants)
+#define ISR_TIME_GPS_RX     2   //!< _U2RXInterrupt (gps.c)
+#define ISR_TIME_PPM_IN     3   //!< _AltIC4Interrupt (ppm_in.c)
+#define ISR_TIME_ADC        4   //!< _DMA0Interrupt (adc.c)
+#define ISR_TIME_DEADLINE   5   //!< _T7Interrupt (timer.c)
+#define ISR_TIME_MPU_DMA    6   //!< _DMA1Interrupt (mpu6000.c)
+#define ISR_TIME_MPU_INT    7   //!< _INT1Interrupt (mpu6000.c)
+
+#define ISR_TIME_MAX_VECTORS 8
+
+#ifdef ISR_PROFILING
+
+//! Cycles and invocations per vector; storage in rtos_pilot/profiler.c.
+extern volatile unsigned long ulIsrTimeCycles[ISR_TIME_MAX_VECTORS];
+extern volatile unsigned long ulIsrTimeCount[ISR_TIME_MAX_VECTORS];
+
+//! Put among the ISR's local declarations (C89: before any statement).
+#define ISR_TIME_DECLARE    unsigned long ulIsrTimeEntry
+
+//! First statement of the ISR body.
+#define ISR_TIME_ENTER()                                                \
+	{                                                                   \
+		ulIsrTimeEntry = (unsigned long) TMR4;                          \
+		ulIsrTimeEntry |= (unsigned long) TMR5HLD << 16;                \
+	}
+
+//! Last statement of the ISR body (before any taskYIELD()).
+#define ISR_TIME_EXIT(vector)                                           \
+	{                                                                   \
+		unsigned long ulIsrTimeNow;                                     \
+		ulIsrTimeNow = (unsigned long) TMR4;                            \
+		ulIsrTimeNow |= (unsigned long) TMR5HLD << 16;                  \
+		ulIsrTimeCycles[vector] += ulIsrTimeNow - ulIsrTimeEntry;       \
+		ulIsrTimeCount[vector]++;                                       \
+	}
+
+#else // ISR_PROFILING
+
+// The dummy local keeps the declaration slot legal in C89; the cast in
+// ENTER silences the unused warning and the optimizer drops both.
+#define ISR_TIME_DECLARE    unsigned long ulIsrTimeEntry
+#define ISR_TIME_ENTER()    (void) ulIsrTimeEntry
+#define ISR_TIME_EXIT(vector)
+
+#endif // ISR_PROFILING
+
+#endif // ISR_TIME_H
@@ -8,7 +8,10 @@ RCONBITS RCONbits_backup;
 _FOSCSEL(FNOSC_PRIPLL);
 _FOSC(FCKSM_CSDCMD & OSCIOFNC_OFF  & POSCMD_XT);  
 
-//_FWDT(FWDTEN_OFF);       // Watchdog Timer Enabled/disabled by user software	
+// Watchdog enabled/disabled by user software (RCONbits.SWDTEN). The fuse
+// stays off, but set the prescalers so an armed watchdog bites after ~1s
+// instead of the 128s power-on default.
+_FWDT(FWDTEN_OFF & WINDIS_OFF & WDTPRE_PR32 & WDTPOST_PS1024);
 
 
 
@@ -118,11 +121,14 @@ int microcontroller_after_reboot()
 
 unsigned int StkAddrLo;  // order matters
 unsigned int StkAddrHi;
-char TrapMsgBuf[24];
 
 extern void (*getErrLoc(void))(void);  // Get Address Error Loc
 void (*errLoc)(void);           // Function Pointer
 
+// Filled in by the autopilot (blackbox.c): captures a crash dump into
+// persistent RAM just before the trap handlers reset the chip.
+void (*microcontroller_trap_hook)(char *code, unsigned long pc) = 0;
+
 // Notify some debug panel, if possible.
 void NotifyTrapAddress(char* code, unsigned int note)
 {
@@ -131,13 +137,16 @@ void NotifyTrapAddress(char* code, unsigned int note)
 
     for (i = 0; i < sizeof (void*); i++)
     {
-        printf("%02x ", p[i]);
+        uart1_printf("%02x ", p[i]);
     }
-    printf("\n");
+    uart1_printf("\n");
+
+    // generate debug string. %x instead of the old sprintf %p: the trap
+    // address fits a word and this keeps stdio out of the binary.
+    uart1_printf("\r\nTrap %s %x\r\n", code, (unsigned int)errLoc);
 
-    // generate debug string.
-    sprintf(TrapMsgBuf, "\r\nTrap %s %p\r\n", code, errLoc);
-    uart1_puts( TrapMsgBuf );
+    if (microcontroller_trap_hook)
+        microcontroller_trap_hook(code, ((unsigned long)StkAddrHi << 16) | StkAddrLo);
 
     // Now get ready to power up.
     asm("reset");
@@ -156,12 +165,12 @@ void NotifyTrapAddress(char* code, unsigned int note)
    unsigned char *p = (unsigned char *) & _AbortAddressContainer;
    INTCON1bits.ADDRERR = 0; //Clear the trap flag
     int i;
-printf("\r\nAddress error: ");
+uart1_printf("\r\nAddress error: ");
     for (i = 0; i <6; i++)
     {
-        printf("%02x ", p[i]);
+        uart1_printf("%02x ", p[i]);
     }
-    printf("\n");
+    uart1_printf("\n");
  }
 
 
@@ -21,6 +21,10 @@ void microcontroller_delay_ms(unsigned long ms);
 int microcontroller_after_reboot();
 void microcontroller_reset_type();
 
+//! Optional crash-dump hook, called by the trap handlers with the trap code
+//! and the trapped program counter just before they reset the chip.
+extern void (*microcontroller_trap_hook)(char *code, unsigned long pc);
+
 
 #define INTERRUPT_PROTECT(x) {              \
     char saved_ipl;                         \
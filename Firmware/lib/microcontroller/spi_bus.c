@@ -0,0 +1,97 @@
+/*!
+ *  @file     spi_bus.c
+ *  @brief    Arbitration for the SPI bus shared by the sensors, the dataflash and the OSD.
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ *
+ *  The bus used to be guarded by a bare binary semaphore: first come, first
+ *  served. A 528-byte dataflash transfer or a full OSD redraw in progress
+ *  could therefore delay a sensor read by milliseconds. All our clients
+ *  already batch their transfers under a single claim, so instead of a
+ *  separate scheduler task the arbitration is done at claim time:
+ *
+ *   - a client refuses the bus when somebody more urgent is already waiting
+ *     for it, and
+ *   - a refused claim from a more urgent client raises a preempt request,
+ *     which interruptible holders (the OSD frame flush) poll to release the
+ *     bus early.
+ */
+
+#include "FreeRTOS/FreeRTOS.h"
+#include "FreeRTOS/task.h"
+#include "FreeRTOS/semphr.h"
+
+#include "spi_bus.h"
+
+#define SPI_BUS_PRIORITY_NONE 4
+
+static xSemaphoreHandle xSpiBusSemaphore = NULL;
+
+static volatile int waiting[SPI_BUS_PRIORITY_NONE] = { 0, 0, 0, 0 };  // blocked claimants per priority
+static volatile int owner_priority = SPI_BUS_PRIORITY_NONE;
+static volatile int preempt_request = 0;
+
+
+void spi_bus_init()
+{
+	// Priority-inheritance mutex: a dataflash write in a low-priority task
+	// cannot park the sensor task behind a preempted holder. The claim-time
+	// arbitration above still decides who may even queue up for the bus.
+	xSpiBusSemaphore = xSemaphoreCreateMutex();
+}
+
+
+/*!
+ *   Claim the bus. Returns pdTRUE on success; the claim then lasts until
+ *   spi_bus_give(). Refuses immediately when a more urgent client is
+ *   already waiting, even if ticks_to_wait is not over yet: a binary
+ *   semaphore wakes blocked tasks first come first served, so without this
+ *   check a queued OSD frame could get the bus before a sensor read
+ *   (the underlying lock is now a priority-inheritance mutex, which keeps
+ *   the holder running but does not reorder admissions by urgency).
+ */
+int spi_bus_take(enum SpiBusPriority priority, portTickType ticks_to_wait)
+{
+	int i;
+
+	for (i = 0; i < (int)priority; i++)
+	{
+		if (waiting[i] > 0)
+			return pdFALSE;
+	}
+
+	waiting[priority]++;
+	if (xSemaphoreTake( xSpiBusSemaphore, ticks_to_wait ) == pdTRUE)
+	{
+		waiting[priority]--;
+		owner_priority = priority;
+		preempt_request = 0;
+		return pdTRUE;
+	}
+	waiting[priority]--;
+
+	if ((int)priority < owner_priority)
+		preempt_request = 1;   // ask the current holder to wrap up
+
+	return pdFALSE;
+}
+
+
+void spi_bus_give()
+{
+	owner_priority = SPI_BUS_PRIORITY_NONE;
+	preempt_request = 0;
+	xSemaphoreGive( xSpiBusSemaphore );
+}
+
+
+/*!
+ *   Did a more urgent client get refused while we hold the bus? Holders of
+ *   long transactions poll this between transfers and release early; the
+ *   remainder is sent on their next turn.
+ */
+int spi_bus_preempt_requested()
+{
+	return preempt_request;
+}
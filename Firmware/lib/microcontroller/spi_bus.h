@@ -0,0 +1,31 @@
+/*!
+ *  @file     spi_bus.h
+ *  @brief    Arbitration for the SPI bus shared by the sensors, the dataflash and the OSD.
+ *  @detailed Replaces the bare xSpiSemaphore: every client claims the bus with a
+ *            priority, and a refused high-priority claim leaves a preempt request
+ *            behind so long transactions (OSD frame flush, dataflash readout) can
+ *            release the bus early instead of delaying the next sensor read.
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+#ifndef SPI_BUS_H
+#define SPI_BUS_H
+
+#include "FreeRTOS/FreeRTOS.h"
+#include "FreeRTOS/semphr.h"
+
+enum SpiBusPriority
+{
+	SPI_BUS_PRIORITY_SENSOR = 0,   //!< pressure sensor reads on the control path
+	SPI_BUS_PRIORITY_LOG    = 1,   //!< dataflash page transfers
+	SPI_BUS_PRIORITY_OSD    = 2,   //!< cosmetic only, a skipped frame is redrawn 200ms later
+	SPI_BUS_PRIORITY_SCRUB  = 3    //!< background media scrub; only runs on an otherwise idle bus
+};
+
+void spi_bus_init();
+int spi_bus_take(enum SpiBusPriority priority, portTickType ticks_to_wait);
+void spi_bus_give();
+int spi_bus_preempt_requested();
+
+#endif // SPI_BUS_H
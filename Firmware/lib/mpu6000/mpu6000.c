@@ -1,6 +1,14 @@
 
 #include "mpu6000/mpu6000.h"
 #include "microcontroller/microcontroller.h"
+#include "microcontroller/isr_time.h"
+
+#if defined(MPU6000_USE_DMA) || defined(MPU6000_USE_INT)
+#include <spi.h>
+#include "FreeRTOS/FreeRTOS.h"
+#include "FreeRTOS/semphr.h"
+#include "FreeRTOS/task.h"
+#endif
 
 #define CS PORTGbits.RG9
 #define MISO PORTGbits.RG8
@@ -16,6 +24,21 @@ unsigned char spi_read_reg(unsigned char addr);
 
 struct mpu6000_raw_sensors mpu6000_raw_sensor_readings;
 
+#ifdef MPU6000_USE_DMA
+// First byte is the (dummy) echo of the register address, then 14 data bytes
+static unsigned char mpu6000_dma_tx[15] __attribute__((space(dma)));
+static unsigned char mpu6000_dma_rx[15] __attribute__((space(dma)));
+
+static xSemaphoreHandle xMpu6000TransferDone = NULL;
+
+static void mpu6000_dma_init();
+#endif
+
+#ifdef MPU6000_USE_INT
+static xSemaphoreHandle xMpu6000DataReady = NULL;
+static volatile int motion_latched = 0;   // MOT_INT seen while filtering data-ready wakeups
+#endif
+
 void mpu6000_init()
 {
     TRISGbits.TRISG9 = 0; // cs
@@ -45,25 +68,49 @@ void mpu6000_init()
    // microcontroller_delay_us(100);
     spi_write_reg(MPUREG_CONFIG, BITS_DLPF_CFG_42HZ);  // BITS_DLPF_CFG_20HZ BITS_DLPF_CFG_42HZ BITS_DLPF_CFG_98HZ
     microcontroller_delay_us(100);
-//  spi_write_reg(MPUREG_GYRO_CONFIG, BITS_FS_2000DPS);  // Gyro scale 2000�/s
-    spi_write_reg(MPUREG_GYRO_CONFIG, BITS_FS_1000DPS);  // Gyro scale 1000�/s
+//  spi_write_reg(MPUREG_GYRO_CONFIG, BITS_FS_2000DPS);  // Gyro scale 2000�/s
+    spi_write_reg(MPUREG_GYRO_CONFIG, BITS_FS_1000DPS);  // Gyro scale 1000�/s
     microcontroller_delay_us(100);
 //  spi_write_reg(MPUREG_ACCEL_CONFIG, BITS_FS_2G);           // Accel scele 2g (g=8192)
     spi_write_reg(MPUREG_ACCEL_CONFIG, BITS_FS_8G);           // Accel scele 8g
     microcontroller_delay_us(100);
 
-    //spi_write_reg(0x38, BIT_MOT_EN);
+    // Motion detection: sets MOT_INT in the status register on any >40mg
+    // excursion lasting 2ms, so polling mpu6000_is_moving() answers "did
+    // anything move since the last poll" (reading the status clears it).
+    spi_write_reg(MPUREG_MOT_THR, 20);          // 20 * 2mg = 40mg
+    microcontroller_delay_us(100);
+    spi_write_reg(MPUREG_MOT_DUR, 2);           // 2ms
+    microcontroller_delay_us(100);
+    spi_write_reg(MPUREG_INT_ENABLE, BIT_MOT_EN);
 
+#ifdef MPU6000_USE_DMA
+    // All configuration registers are written bit-banged (slow clock);
+    // only the sensor block read runs over the hardware module + DMA.
+    mpu6000_dma_init();
+#endif
 }
 
 int mpu6000_is_moving()
 {
-    return (int)spi_read_reg(0x3A);// & BIT_MOT_INT;
+#ifdef MPU6000_USE_INT
+    // mpu6000_wait_data_ready() reads (and so clears) the status register
+    // on every wakeup; anything it saw is latched for us here.
+    int moving = motion_latched | ((int)spi_read_reg(MPUREG_INT_STATUS) & BIT_MOT_INT);
+    motion_latched = 0;
+    return moving;
+#else
+    return (int)spi_read_reg(MPUREG_INT_STATUS) & BIT_MOT_INT;
+#endif
 }
 
 // very rough measurement: takes 0,0001s (0,1ms)
 void mpu6000_update_sensor_readings()
 {
+#ifdef MPU6000_USE_DMA
+    mpu6000_start_sensor_readings();
+    mpu6000_wait_sensor_readings();
+#else
     // We start a SPI multibyte read of sensors
     spi_cs_enable();
     spi_comm_bitbang(MPUREG_ACCEL_XOUT_H | 0x80);
@@ -75,8 +122,160 @@ void mpu6000_update_sensor_readings()
     mpu6000_raw_sensor_readings.gyro_y = spiGet16();
     mpu6000_raw_sensor_readings.gyro_z = spiGet16();
     spi_cs_disable();
+#endif
+}
+
+#ifdef MPU6000_USE_DMA
+
+static void mpu6000_dma_init()
+{
+    int i;
+
+    if (xMpu6000TransferDone == NULL)
+        vSemaphoreCreateBinary(xMpu6000TransferDone);
+    xSemaphoreTake(xMpu6000TransferDone, 0);  // start empty: only the ISR gives it
+
+    mpu6000_dma_tx[0] = MPUREG_ACCEL_XOUT_H | 0x80;
+    for (i = 1; i < 15; i++)
+        mpu6000_dma_tx[i] = 0;
+
+    // The dataflash on v1q moved to the port F pins, so SPI2 is ours.
+    // Fcy/8 = 5MHz: fine for the sensor registers (config regs stay bit-banged @ <1MHz)
+    OpenSPI2(ENABLE_SCK_PIN & ENABLE_SDO_PIN & SPI_MODE16_OFF & SPI_SMP_OFF & SPI_CKE_OFF &
+             SLAVE_ENABLE_OFF & MASTER_ENABLE_ON & PRI_PRESCAL_4_1 & SEC_PRESCAL_2_1,
+             FRAME_ENABLE_OFF, SPI_ENABLE & SPI_RX_OVFLOW_CLR);
+
+    // DMA1: SPI2 -> mpu6000_dma_rx, raises the interrupt that wakes the sensor task
+    DMA1CONbits.AMODE = 0;          // Register indirect with post-increment
+    DMA1CONbits.MODE  = 1;          // One-shot
+    DMA1CONbits.SIZE  = 1;          // Byte transfers
+    DMA1CONbits.DIR   = 0;          // Peripheral to RAM
+    DMA1PAD = (int)&SPI2BUF;
+    DMA1REQ = 0x21;                 // SPI2 transfer done
+    DMA1STA = __builtin_dmaoffset(mpu6000_dma_rx);
+    DMA1CNT = 14;                   // 15 transfers: address echo + 14 data bytes
+    _DMA1IP = configKERNEL_INTERRUPT_PRIORITY;
+    IFS0bits.DMA1IF = 0;
+    IEC0bits.DMA1IE = 1;
+
+    // DMA2: mpu6000_dma_tx -> SPI2, keeps the clock running; no interrupt needed
+    DMA2CONbits.AMODE = 0;
+    DMA2CONbits.MODE  = 1;
+    DMA2CONbits.SIZE  = 1;
+    DMA2CONbits.DIR   = 1;          // RAM to peripheral
+    DMA2PAD = (int)&SPI2BUF;
+    DMA2REQ = 0x21;
+    DMA2STA = __builtin_dmaoffset(mpu6000_dma_tx);
+    DMA2CNT = 14;
+    IFS1bits.DMA2IF = 0;
+    IEC1bits.DMA2IE = 0;
+}
+
+void mpu6000_start_sensor_readings()
+{
+    spi_cs_enable();
+
+    DMA1CONbits.CHEN = 1;
+    DMA2CONbits.CHEN = 1;
+    DMA2REQbits.FORCE = 1;  // prime the first byte, the rest follows on "transfer done"
+}
+
+void mpu6000_wait_sensor_readings()
+{
+    xSemaphoreTake(xMpu6000TransferDone, portMAX_DELAY);
+}
+
+#define DMA_RX_INT16(n)  ((int)(((unsigned int)mpu6000_dma_rx[n] << 8) | mpu6000_dma_rx[(n)+1]))
+
+void __attribute__((interrupt, no_auto_psv)) _DMA1Interrupt(void)
+{
+    portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+    ISR_TIME_DECLARE;
+
+    ISR_TIME_ENTER();
+    spi_cs_disable();
+
+    mpu6000_raw_sensor_readings.acc_x  = DMA_RX_INT16(1);
+    mpu6000_raw_sensor_readings.acc_y  = DMA_RX_INT16(3);
+    mpu6000_raw_sensor_readings.acc_z  = DMA_RX_INT16(5);
+    mpu6000_raw_sensor_readings.temp   = DMA_RX_INT16(7);
+    mpu6000_raw_sensor_readings.gyro_x = DMA_RX_INT16(9);
+    mpu6000_raw_sensor_readings.gyro_y = DMA_RX_INT16(11);
+    mpu6000_raw_sensor_readings.gyro_z = DMA_RX_INT16(13);
+
+    xSemaphoreGiveFromISR(xMpu6000TransferDone, &xHigherPriorityTaskWoken);
+
+    IFS0bits.DMA1IF = 0;
+    ISR_TIME_EXIT(ISR_TIME_MPU_DMA);
+    if (xHigherPriorityTaskWoken != pdFALSE)
+    {
+        taskYIELD();
+    }
+}
+
+#endif // MPU6000_USE_DMA
+
+#ifdef MPU6000_USE_INT
+
+void mpu6000_enable_data_ready_int(int smplrt_div)
+{
+    if (xMpu6000DataReady == NULL)
+        vSemaphoreCreateBinary(xMpu6000DataReady);
+    xSemaphoreTake(xMpu6000DataReady, 0);  // start empty: only the ISR gives it
+
+    spi_write_reg(MPUREG_SMPLRT_DIV, (unsigned char)smplrt_div);
+    microcontroller_delay_us(100);
+    spi_write_reg(MPUREG_INT_PIN_CFG, 0);  // active high, push-pull, 50us pulse
+    microcontroller_delay_us(100);
+    spi_write_reg(MPUREG_INT_ENABLE, BIT_DATA_RDY_EN | BIT_MOT_EN);
+
+    TRISEbits.TRISE8 = 1;      // INT1 = RE8 = in (scp1000 data-ready on old boards)
+    INTCON2bits.INT1EP = 0;    // rising edge
+    _INT1IP = configKERNEL_INTERRUPT_PRIORITY;
+    _INT1IF = 0;
+    _INT1IE = 1;
+}
+
+
+/*!
+ *   The motion detector shares the INT pin with data-ready, so a wakeup is
+ *   only trusted after the status register confirms DATA_RDY; a motion-only
+ *   pulse is latched for mpu6000_is_moving() and the wait continues.
+ */
+int mpu6000_wait_data_ready(portTickType max_wait)
+{
+    int status;
+
+    for (;;)
+    {
+        if (xSemaphoreTake(xMpu6000DataReady, max_wait) == pdFALSE)
+            return pdFALSE;
+        status = (int)spi_read_reg(MPUREG_INT_STATUS);
+        motion_latched |= status & BIT_MOT_INT;
+        if (status & BIT_DATA_RDY_INT)
+            return pdTRUE;
+    }
 }
 
+
+void __attribute__((interrupt, no_auto_psv)) _INT1Interrupt(void)
+{
+    portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+    ISR_TIME_DECLARE;
+
+    ISR_TIME_ENTER();
+    xSemaphoreGiveFromISR(xMpu6000DataReady, &xHigherPriorityTaskWoken);
+
+    _INT1IF = 0;
+    ISR_TIME_EXIT(ISR_TIME_MPU_INT);
+    if (xHigherPriorityTaskWoken != pdFALSE)
+    {
+        taskYIELD();
+    }
+}
+
+#endif // MPU6000_USE_INT
+
 unsigned int spiGet16(void)
 {
        return ((int)spi_comm_bitbang(0) << 8) | ((int)spi_comm_bitbang(0) & 0xFF);
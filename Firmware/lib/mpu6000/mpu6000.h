@@ -28,8 +28,11 @@
 #define MPUREG_CONFIG 0x1A
 #define MPUREG_GYRO_CONFIG 0x1B
 #define MPUREG_ACCEL_CONFIG 0x1C
+#define MPUREG_MOT_THR 0x1F     // motion detection threshold, 1 LSB = 2mg
+#define MPUREG_MOT_DUR 0x20     // motion detection duration, 1 LSB = 1ms
 #define MPUREG_INT_PIN_CFG 0x37
 #define MPUREG_INT_ENABLE 0x38
+#define MPUREG_INT_STATUS 0x3A
 #define MPUREG_ACCEL_XOUT_H 0x3B
 #define MPUREG_ACCEL_XOUT_L 0x3C
 #define MPUREG_ACCEL_YOUT_H 0x3D
@@ -133,10 +136,42 @@ struct mpu6000_raw_sensors
 
 extern struct mpu6000_raw_sensors mpu6000_raw_sensor_readings;
 
+// Comment out to fall back to the bit-banged SPI burst read.
+// In DMA mode the full 14-byte sensor block is clocked in by the SPI2 module
+// and DMA1/DMA2, and the calling task sleeps on a semaphore instead of
+// spinning on the port pins (RG6..RG9 are the SPI2 pins on v1q).
+#define MPU6000_USE_DMA
+
+// Comment out to go back to the vTaskDelayUntil-paced sensor loop.
+// In INT mode the sensor's data-ready pulse (wired to INT1/RE8, the pin
+// that was the scp1000 data-ready on the older boards) gives a semaphore
+// the sensor task blocks on, so the loop runs on the MPU6000's own sample
+// clock instead of beating against the 1ms RTOS tick.
+#define MPU6000_USE_INT
+
 void mpu6000_init();
 void mpu6000_update_sensor_readings();
 int mpu6000_is_moving();
 
+#ifdef MPU6000_USE_DMA
+// Kick off a DMA burst read of the full sensor block (non-blocking).
+void mpu6000_start_sensor_readings();
+// Block on the transfer-done semaphore until the DMA ISR has unpacked
+// the sensor block into mpu6000_raw_sensor_readings.
+void mpu6000_wait_sensor_readings();
+#endif
+
+#ifdef MPU6000_USE_INT
+// Route the data-ready pulse to INT1 and set the sample clock to
+// 1kHz / (smplrt_div + 1); call after mpu6000_init(), which rewrites
+// the interrupt enables.
+void mpu6000_enable_data_ready_int(int smplrt_div);
+// Sleep until the next data-ready edge; pdFALSE on timeout (dead INT
+// line), so the caller can pace itself. Motion-only pulses are filtered
+// out here and latched for mpu6000_is_moving().
+int mpu6000_wait_data_ready(portTickType max_wait);
+#endif
+
 
 #endif // __MPU6000_H__
 
@@ -0,0 +1,85 @@
+/*    Fixed-point biquad notch filter
+ *
+ *    Direct form I with the constrained-notch symmetry b2 = b0, in the
+ *    plain-long idiom of pid_fixed_update(). The zeros sit on the unit
+ *    circle at the notch frequency, the poles at radius r just inside;
+ *    r sets the bandwidth. b0 is normalized for a DC gain of exactly 1,
+ *    so the gyro bias passes through untouched.
+ */
+
+#include "fastmath/fastmath.h"
+#include "notch/notch.h"
+
+
+void notch_fixed_init(struct notch_fixed *f)
+{
+	f->b0 = NOTCH_FIXED_ONE;
+	f->b1 = 0;
+	f->a1 = 0;
+	f->a2 = 0;
+	notch_fixed_reset(f);
+}
+
+
+void notch_fixed_tune(struct notch_fixed *f, float freq_hz, float sample_hz, float bandwidth_hz)
+{
+	float w, c, r, a1, a2, k;
+
+	if (freq_hz <= 0.0f || freq_hz >= 0.45f * sample_hz)
+	{
+		notch_fixed_init(f);   // pass-through
+		return;
+	}
+
+	w = 6.2831853f * freq_hz / sample_hz;
+	c = fast_cos(w);
+
+	// pole radius from the -3dB bandwidth; keep a margin to the unit
+	// circle so coefficient rounding cannot push the filter unstable
+	r = 1.0f - 3.1415927f * bandwidth_hz / sample_hz;
+	if (r < 0.0f)
+		r = 0.0f;
+	else if (r > 0.98f)
+		r = 0.98f;
+
+	a1 = -2.0f * r * c;
+	a2 = r * r;
+	k = (1.0f + a1 + a2) / (2.0f - 2.0f * c);   // unity DC gain
+
+	f->b0 = (int) (k * NOTCH_FIXED_ONE);
+	f->b1 = (int) (-2.0f * k * c * NOTCH_FIXED_ONE);
+	f->a1 = (int) (a1 * NOTCH_FIXED_ONE);
+	f->a2 = (int) (a2 * NOTCH_FIXED_ONE);
+}
+
+
+void notch_fixed_reset(struct notch_fixed *f)
+{
+	f->x1 = 0;
+	f->x2 = 0;
+	f->y1 = 0;
+	f->y2 = 0;
+}
+
+
+int notch_fixed_update(struct notch_fixed *f, int x)
+{
+	long acc;
+	int y;
+
+	if (f->a2 == 0)   // pass-through: tuned off (or never tuned)
+		return x;
+
+	acc  = (long) f->b0 * ((long) x + f->x2);
+	acc += (long) f->b1 * f->x1;
+	acc -= (long) f->a1 * f->y1;
+	acc -= (long) f->a2 * f->y2;
+	y = (int) (acc >> 14);
+
+	f->x2 = f->x1;
+	f->x1 = x;
+	f->y2 = f->y1;
+	f->y1 = y;
+
+	return y;
+}
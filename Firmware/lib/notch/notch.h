@@ -0,0 +1,46 @@
+/*!
+ *  @file     notch.h
+ *  @brief    Fixed-point biquad notch filter.
+ *
+ *  A narrow band-stop for periodic disturbances (prop-rate vibration on
+ *  the gyros). Integer states and Q2.14 coefficients, so one update costs
+ *  four long multiplies and no floating point: cheap enough to run per
+ *  gyro axis inside the sensor loop. The coefficients are precomputed by
+ *  notch_fixed_tune() whenever the center frequency moves; DC gain is
+ *  exactly one, so sensor bias (and its estimator) is unaffected.
+ *
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ */
+
+#ifndef NOTCH_H
+#define NOTCH_H
+
+//! Q2.14 unity; coefficients can reach magnitude 2, so Q1.15 is too small.
+#define NOTCH_FIXED_ONE 16384
+
+struct notch_fixed
+{
+	int b0;       //!< = b2 (constrained notch), Q2.14
+	int b1;       //!< Q2.14
+	int a1;       //!< Q2.14
+	int a2;       //!< Q2.14
+	int x1, x2;   //!< previous inputs (raw counts)
+	int y1, y2;   //!< previous outputs
+};
+
+//! Pass-through (disabled) filter with cleared states.
+void notch_fixed_init(struct notch_fixed *f);
+
+//! Precomputes the coefficients for a notch at freq_hz. A center of 0 (or
+//! one too close to the Nyquist rate) turns the filter into a pass-through.
+//! Call notch_fixed_reset() afterwards when the filter was running.
+void notch_fixed_tune(struct notch_fixed *f, float freq_hz, float sample_hz, float bandwidth_hz);
+
+//! Clears the state history (not the coefficients).
+void notch_fixed_reset(struct notch_fixed *f);
+
+//! One sample in, one sample out.
+int notch_fixed_update(struct notch_fixed *f, int x);
+
+#endif // NOTCH_H
@@ -14,6 +14,7 @@
 #include <math.h>
 
 #include "pid/pid.h"
+#include "microcontroller/hotcode.h"
 
 
 
@@ -57,7 +58,7 @@ __attribute__((__const__)) int isNaN_PID (float* f)
  *  @param dt       Time since last update, needed for the integral and derivative term.
  *  @return The calculated pid output.
  */
-float pid_update(struct pid *pid, float position, float dt)
+HOT_CODE float pid_update(struct pid *pid, float position, float dt)
 {
 	float tmp;
 	
@@ -90,6 +91,118 @@ float pid_update(struct pid *pid, float position, float dt)
 
 
 
+/*!
+ *  PID update with a feedforward path and a low-pass filtered derivative
+ *  taken on the measurement instead of the error. Differences with
+ *  pid_update():
+ *    - a setpoint step does not kick the derivative term (no "derivative
+ *      kick"), only real movement of the measurement does;
+ *    - the derivative runs through a single-pole filter so sensor noise
+ *      does not reach the output; precompute the coefficient once as
+ *      d_alpha = dt / (dt + 1/(2*pi*f_cutoff));
+ *    - ff_gain * setpoint is added straight to the output, which buys
+ *      tracking without cranking the P gain (and without loop rate).
+ *  The struct pid fields are reused: last_error holds the previous
+ *  measurement and d_state the filtered derivative, so use one struct
+ *  with either pid_update() or this function, not both. The gains are
+ *  not stored in the struct because struct pid is part of the flash
+ *  configuration layout.
+ *  @param pid         The pid structure.
+ *  @param setpoint    The desired value.
+ *  @param measurement The measured value.
+ *  @param ff_gain     Feedforward gain, in output units per setpoint unit.
+ *  @param d_alpha     Precomputed derivative filter coefficient (0..1,
+ *                     1 = unfiltered).
+ *  @param dt          Time since last update.
+ *  @return The calculated pid output.
+ */
+float pid_update_ff(struct pid *pid, float setpoint, float measurement, float ff_gain, float d_alpha, float dt)
+{
+	float error = setpoint - measurement;
+	float d_raw;
+
+	d_raw = -(measurement - pid->last_error) / dt;   // on the measurement: sign flips
+	pid->last_error = measurement;
+	pid->d_state += d_alpha * (d_raw - pid->d_state);
+
+	if (isNaN_PID(&(pid->i_state))) // no NAN
+		pid->i_state = 0.0;
+
+	pid->i_state += error * dt;                      // I-term
+	if (pid->i_state > pid->i_max)
+		pid->i_state = pid->i_max;
+	else if (pid->i_state < pid->i_min)
+		pid->i_state = pid->i_min;
+
+	return ff_gain * setpoint
+	     + pid->p_gain * error
+	     + pid->i_state * pid->i_gain
+	     + pid->d_gain * pid->d_state;
+}
+
+
+/*!
+ *  Folds a float PID configuration into the incremental fixed-point form.
+ *  The unit scale and the (fixed) loop period go into the gains, so the
+ *  update itself needs no float emulation at all.
+ *  @param f       The fixed-point state to initialize.
+ *  @param pid     The float gains, as configured by the groundstation.
+ *  @param scale   Output units per input unit (e.g. 0.63 for an error in
+ *                 mrad and an output in mixer units of 630/rad).
+ *  @param dt      The loop period in seconds; the loop must run at this
+ *                 fixed rate for the folded I and D gains to be correct.
+ *  @param out_min Saturation of the output accumulator.
+ *  @param out_max Saturation of the output accumulator.
+ */
+void pid_fixed_init(struct pid_fixed *f, struct pid *pid, float scale, float dt, int out_min, int out_max)
+{
+	f->p_gain = (long)(pid->p_gain * scale * (float)PID_FIXED_ONE);
+	f->i_gain = (long)(pid->i_gain * scale * dt * (float)PID_FIXED_ONE);
+	f->d_gain = (long)(pid->d_gain * scale / dt * (float)PID_FIXED_ONE);
+	f->out = 0;
+	f->out_min = (long)out_min * PID_FIXED_ONE;
+	f->out_max = (long)out_max * PID_FIXED_ONE;
+	f->last_error = 0;
+	f->prev_error = 0;
+}
+
+
+/*!
+ *  Incremental (velocity form) fixed-point PID update:
+ *
+ *     du = Kp*(e[k]-e[k-1]) + Ki*e[k] + Kd*(e[k]-2*e[k-1]+e[k-2])
+ *
+ *  accumulated into a saturating output, which gives anti-windup for
+ *  free: while the output sits on a limit the integration simply stops.
+ *  Three long multiply-accumulates per call, no float emulation, so it
+ *  fits inner loops that run at 250-500Hz. The d_term_min_var jitter
+ *  filter of the float version has no equivalent here; at these rates
+ *  the Q16 quantization already swallows sub-count jitter.
+ *  @param f     The fixed-point state.
+ *  @param error The current error, in the caller's integer units.
+ *  @return The accumulated output, in units of scale * input units.
+ */
+HOT_CODE int pid_fixed_update(struct pid_fixed *f, int error)
+{
+	long delta;
+
+	delta  = f->p_gain * (long)(error - f->last_error);
+	delta += f->i_gain * (long)error;
+	delta += f->d_gain * (long)((error - f->last_error) - (f->last_error - f->prev_error));
+
+	f->prev_error = f->last_error;
+	f->last_error = error;
+
+	f->out += delta;
+	if (f->out > f->out_max)
+		f->out = f->out_max;
+	else if (f->out < f->out_min)
+		f->out = f->out_min;
+
+	return (int)(f->out / PID_FIXED_ONE);
+}
+
+
 /*!
  *  Update the pid struct using only the proportional term.
  *  @param position The reading (proportional term).
@@ -13,9 +13,28 @@ struct pid
 	float d_term_min_var;
 };
 
+//! Gains of the incremental fixed-point PID are stored in Q16.
+#define PID_FIXED_ONE 65536L
+
+//! State of the incremental fixed-point PID (pid_fixed_update()). The
+//! integration lives in the saturating output accumulator, so there is no
+//! separate i_state to anti-windup.
+struct pid_fixed
+{
+	long p_gain, i_gain, d_gain;   // Q16, unit scale and loop period folded in
+	long out;                      // Q16 accumulated output
+	long out_min, out_max;         // Q16 saturation of the accumulator
+	int last_error;                // e[k-1]
+	int prev_error;                // e[k-2]
+};
+
 void pid_init(struct pid *pid, float d_gain, float p_gain, float i_gain, float i_min, float i_max, float d_term_min_var);
 
+void pid_fixed_init(struct pid_fixed *f, struct pid *pid, float scale, float dt, int out_min, int out_max);
+int pid_fixed_update(struct pid_fixed *f, int error);
+
 float pid_update(struct pid *pid, float position, float dt);
+float pid_update_ff(struct pid *pid, float setpoint, float measurement, float ff_gain, float d_alpha, float dt);
 float pid_update_external_d(struct pid *pid, float position, float d, float dt);
 float pid_update_only_p(struct pid *pid, float position, float dt);
 float pid_update_only_p_and_i(struct pid *pid, float position, float dt);
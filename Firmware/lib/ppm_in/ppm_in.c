@@ -12,7 +12,10 @@
 #include <stdio.h>
 
 #include "microcontroller/microcontroller.h"
+#include "microcontroller/isr_time.h"
 #include "ppm_in/ppm_in.h"
+#include "ringbuffer/ringbuffer.h"
+#include "uart1_queue/uart1_queue.h"
 
 
 static unsigned int NUM_CHANNELS = 7; //0..7 = 8
@@ -23,18 +26,40 @@ unsigned int servo_pulse_max;
 unsigned int servo_pulse_min;
 //! The minimum length of the PPM sync pulse, in timer ticks.
 unsigned int sync_pulse;
+//! The shortest span accepted as a real edge, in timer ticks. Anything
+//! shorter is an RF spike that split a pulse in two; the edge is dropped
+//! so the two halves are measured as one pulse again.
+unsigned int glitch_pulse;
 
 //! Global struct that contains the state of the PPM pulses.
 volatile struct ppm_info ppm;
 
 volatile unsigned int frame_counter = 0;
 
+//! Incremented before and after ppm_in_decode() publishes an accepted
+//! frame into ppm.channel[], so ppm_in_get_frame() can detect a copy that
+//! raced the publication (odd value or a change during the copy).
+static volatile unsigned int channel_sequence = 0;
+
+//! Pulse widths measured by the capture interrupt, waiting for
+//! ppm_in_decode(). A full PPM frame is at most 13 pulses, so 32 covers
+//! more than two frames of decoder lag; a dropped width simply fails the
+//! frame's channel count and the frame is rejected, like any glitch.
+#define PPM_PULSE_RING_SIZE 32
+static volatile unsigned int ppm_pulse_buffer[PPM_PULSE_RING_SIZE];
+static struct ringbuffer16 ppm_pulse_ring;
+
 float dt_no_valid_frame = 1.0;
 int ticks_no_valid_frame = 1;
 
 #define CONNECTION_LOST_AFTER_SECONDS_NO_FRAME  0.5
 #define CONNECTION_LOST_AFTER_MS_NO_FRAME  500
 
+//! Frame-gap timeout of the hardware failsafe (Timer3 period match);
+//! 625 ticks per ms with the 1:64 prescaler at FCY = 40MHz.
+#define FAILSAFE_DEFAULT_MS      80
+#define FAILSAFE_TICKS_PER_MS    625
+
 unsigned int ppm_in_us_to_raw(unsigned int us);
 
 
@@ -47,14 +72,18 @@ void ppm_in_open()
 	INTCON2bits.ALTIVT = 1;	
 		
 	ppm.connection_alive = 0;
+	ppm.failsafe = 0;
 	T3CONbits.TCS = 0;		// Use internal clock source
     T3CONbits.TCKPS = 0b10;	// Prescale Select 1:64
-    PR3 = 0xFFFF;           // Timer 3 uses full 16 bit
+    PR3 = 0xFFFF;           // full 16 bit until the failsafe timeout is set below
     T3CONbits.TON = 1;	    // Enable timer 3
 
     //         9876543210
 	TRISD |= 0b100000000000;   // IC4 = RD11 = in
 
+	ringbuffer16_init(&ppm_pulse_ring, ppm_pulse_buffer, PPM_PULSE_RING_SIZE);
+	ringbuffer16_watch_ring(&ppm_pulse_ring, "ppm pulses");
+
 	// Interrupt capture:
 	_IC4IF = 0;             // Clear interrupt flag
 	_IC4IE = 1;             // Enable interrupts
@@ -68,6 +97,15 @@ void ppm_in_open()
 	servo_pulse_max = ppm_in_us_to_raw(2300);
 	servo_pulse_min = ppm_in_us_to_raw(700);
 	sync_pulse = ppm_in_us_to_raw(4500);
+	glitch_pulse = ppm_in_us_to_raw(300);
+
+	// hardware frame-gap failsafe: the capture interrupt zeroes TMR3 on
+	// every edge batch, so a Timer3 period match means PR3 of silence on
+	// the PPM line - detection armed by the pulse train itself
+	ppm_in_set_failsafe_ms(FAILSAFE_DEFAULT_MS);
+	_T3IF = 0;
+	_T3IP = 5;
+	_T3IE = 1;
 	
 	ppm.valid_frame = 0;
 	ppm.channel[0] = 0;
@@ -93,7 +131,8 @@ void ppm_in_update_status(float dt)
 	else if (dt_no_valid_frame <= CONNECTION_LOST_AFTER_SECONDS_NO_FRAME)
 		dt_no_valid_frame += dt;
 	
-	ppm.connection_alive = (dt_no_valid_frame < CONNECTION_LOST_AFTER_SECONDS_NO_FRAME);
+	ppm.connection_alive = (dt_no_valid_frame < CONNECTION_LOST_AFTER_SECONDS_NO_FRAME)
+	                       && !ppm.failsafe;
 }	
 
 
@@ -127,7 +166,18 @@ void ppm_in_update_status_ticks_50hz()
 	} else if (!ppm.valid_frame && ticks_no_valid_frame < TICKS_FOR_NO_CONNECTION)
 		ticks_no_valid_frame += 1;
 	*/
-	ppm.connection_alive = (ticks_no_valid_frame < TICKS_FOR_NO_CONNECTION);
+	ppm.connection_alive = (ticks_no_valid_frame < TICKS_FOR_NO_CONNECTION)
+	                       && !ppm.failsafe;
+}
+
+
+void ppm_in_set_failsafe_ms(int ms)
+{
+	if (ms < 25)    // must span at least one whole PPM frame (~22.5ms)
+		ms = 25;
+	if (ms > 100)   // TMR3 rolls over at 104ms with the 1:64 prescaler
+		ms = 100;
+	PR3 = (unsigned int)((unsigned long)ms * FAILSAFE_TICKS_PER_MS);
 }
 
 unsigned int ppm_in_us_to_raw(unsigned int us)
@@ -146,6 +196,30 @@ int ppm_signal_quality()
 {
 	return ticks_no_valid_frame; //(int)(dt_no_valid_frame * 20.0);
 }
+
+
+/*!
+ *   Copies the last accepted frame into *out, so the caller works on
+ *   channel values that all belong to the same frame. Reading
+ *   ppm.channel[] directly can return a mix of two frames when the
+ *   decoder interrupt publishes between two reads; in manual mode that
+ *   showed up as servo twitches. Lock-free: the copy is simply retried
+ *   when it raced the interrupt, which takes at most one retry.
+ */
+void ppm_in_get_frame(struct ppm_info *out)
+{
+	unsigned int sequence, i;
+
+	do
+	{
+		sequence = channel_sequence;
+		out->connection_alive = ppm.connection_alive;
+		out->valid_frame = ppm.valid_frame;
+		out->failsafe = ppm.failsafe;
+		for (i = 0; i < 14; i++)
+			out->channel[i] = ppm.channel[i];
+	} while (sequence != channel_sequence || (sequence & 0x0001));
+}
 	
 
 unsigned int ppm_in_raw_to_us(unsigned int raw)
@@ -177,57 +251,49 @@ void ppm_in_guess_num_channels()
 		{
 			NUM_CHANNELS = i;
 			microcontroller_delay_ms(50);
+			ppm_in_decode();
 			if (ppm.valid_frame)
 			{
 				microcontroller_delay_ms(24);
+				ppm_in_decode();
 				if (ppm.valid_frame)
 				{
-					printf ("channels: %d", NUM_CHANNELS+1);
+					uart1_printf ("channels: %d", NUM_CHANNELS+1);
 					return;
 				}	
 			}	
 		}	
 	}
-	printf("timeout...");
+	uart1_printf("timeout...");
 }	
 
 
-// shadow: fast context save DONT USE IT HERE!!!
-// no_auto_psv: code does not access string literals or const vars
 /*!
- *  Interrupt routing that decodes the PPM signal.
- *  This routing is called on every 4th falling edge, and this to save
- *  processing power. The PPM frame is accepted when:
+ *  Decodes the buffered pulse widths into channels. The PPM frame is
+ *  accepted when:
  *    - Every channel is between a certain minimum and maximum
  *    - If it ends with a synch pulse
  *    - If it contains a predefined number of channels.
  *
- *  If these conditions are not met, the frame is discared. The results
+ *  If these conditions are not met, the frame is discarded. The results
  *  are saved in the global ppm_info struct.
  *
- *
- *  This routine uses the alternate interrupt vector table pwm_in uses the normal one.
+ *  This used to run inside the capture interrupt; it now runs in the
+ *  control task (which calls it right before reading the sticks), so the
+ *  interrupt is down to the timing capture and the scaling divisions no
+ *  longer preempt the 250Hz loop. The published frame is just as fresh:
+ *  decode and read happen in the same loop iteration.
  */
-void __attribute__((__interrupt__, __auto_psv__)) _AltIC4Interrupt(void)
+void ppm_in_decode()
 {
-	static volatile unsigned int counter = 0;
-	static volatile unsigned char invalid_pulse = 1;
-	static volatile int ppm_in[14];
+	static unsigned int counter = 0;
+	static unsigned char invalid_pulse = 1;
+	static int ppm_in[14];
 
-	unsigned int raw_in, 
-	             last_raw_in = 0,
-	             in;
-	TMR3 = 0;
-	_IC4IF = 0;		
-	while (IC4CONbits.ICBNE)
+	unsigned int in;
+
+	while (ringbuffer16_get(&ppm_pulse_ring, &in))
 	{
-		raw_in = IC4BUF;
-		
-		if (last_raw_in < raw_in)
-			in = raw_in - last_raw_in;
-		else
-			in = 0xFFFF - last_raw_in + raw_in;
-		
 		if (in > sync_pulse)
 		{
 			// this is a valid frame if 
@@ -238,9 +304,12 @@ void __attribute__((__interrupt__, __auto_psv__)) _AltIC4Interrupt(void)
 			invalid_pulse = 0;
 			if (ppm.valid_frame) //
             {
+				channel_sequence++;   // odd: publication in progress
 				for (counter=0; counter < NUM_CHANNELS; counter++)
 					ppm.channel[counter] = ppm_in[counter];
                 frame_counter++;
+				channel_sequence++;   // even again
+				ppm.failsafe = 0;     // pulse train is back; TMR3 re-arms itself
             }
 			counter = 0;
 
@@ -265,8 +334,63 @@ void __attribute__((__interrupt__, __auto_psv__)) _AltIC4Interrupt(void)
 			invalid_pulse = 1;
 			ppm.valid_frame = 0;
 		}
-			
+	}	
+}
+
+
+// shadow: fast context save DONT USE IT HERE!!!
+// no_auto_psv: code does not access string literals or const vars
+/*!
+ *  Interrupt routine that measures the PPM pulse train, called on every
+ *  4th falling edge to save processing power. Only the width measurement
+ *  and the RF glitch filter stay at interrupt level; the widths go into
+ *  a lock-free ring and ppm_in_decode() turns them into channel values
+ *  in the control task's context.
+ *
+ *  This routine uses the alternate interrupt vector table pwm_in uses the normal one.
+ */
+void __attribute__((__interrupt__, __auto_psv__)) _AltIC4Interrupt(void)
+{
+	unsigned int raw_in, 
+	             last_raw_in = 0,
+	             in;
+	ISR_TIME_DECLARE;
+
+	ISR_TIME_ENTER();
+	TMR3 = 0;
+	_IC4IF = 0;		
+	while (IC4CONbits.ICBNE)
+	{
+		raw_in = IC4BUF;
+		
+		if (last_raw_in < raw_in)
+			in = raw_in - last_raw_in;
+		else
+			in = 0xFFFF - last_raw_in + raw_in;
+		
+		if (in < glitch_pulse)   // RF spike: drop this edge and keep timing from the previous one
+			continue;
+
+		ringbuffer16_put(&ppm_pulse_ring, in);   // full: dropped, the frame fails its channel count
+
 		last_raw_in = raw_in;
 	}	
-	
+	ISR_TIME_EXIT(ISR_TIME_PPM_IN);
+}
+
+
+/*!
+ *  Timer3 period match: PR3 worth of silence on the PPM line. Publishes
+ *  the failsafe verdict straight from the capture layer, so the control
+ *  task sees a dead link at its next cycle instead of after the frame
+ *  counting hysteresis of ppm_in_update_status_ticks_50hz() (which still
+ *  covers the noise case, where edges keep arriving but no frame is
+ *  ever valid). Keeps firing every PR3 while the line stays dead; both
+ *  stores are single bytes, so the flag reads are atomic.
+ */
+void __attribute__((__interrupt__, __auto_psv__)) _AltT3Interrupt(void)
+{
+	_T3IF = 0;
+	ppm.failsafe = 1;
+	ppm.connection_alive = 0;
 }
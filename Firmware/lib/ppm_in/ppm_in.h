@@ -7,6 +7,11 @@ void ppm_in_guess_num_channels();
 struct ppm_info {
 	char connection_alive;
 	char valid_frame;
+	//! Set by the hardware frame-gap timeout (Timer3 period match) when
+	//! the pulse train stops, cleared when a valid frame is published
+	//! again. One byte, so the control task reads it atomically; it also
+	//! forces connection_alive to 0 until the frames return.
+	char failsafe;
 	unsigned int channel[14]; // max 14!!
 };
 
@@ -15,8 +20,24 @@ extern volatile struct ppm_info ppm;
 void ppm_in_update_status(float dt);
 void ppm_in_update_status_ticks_50hz();
 
+//! Frame-gap timeout of the hardware failsafe, clamped to 25..100ms
+//! (one PPM frame is ~22.5ms, the capture timer rolls over at 104ms).
+//! Default 80ms; runtime-tunable with the CS console command.
+void ppm_in_set_failsafe_ms(int ms);
+
 int ppm_signal_quality();
 
+//! Copies the last accepted frame into *out. Use this instead of reading
+//! several ppm.channel[] entries in a row: it cannot return a frame torn
+//! by the decoder.
+void ppm_in_get_frame(struct ppm_info *out);
+
+//! Decodes the pulse widths the capture interrupt buffered and publishes
+//! accepted frames into ppm. Single consumer: call it from the control
+//! task only (main calls it during the boot-time channel autodetect,
+//! before that task exists). A no-op while nothing arrived.
+void ppm_in_decode();
+
 
 #define MODE1 ppm.channel[config.channel_mode]<1400
 #define MODE2 (ppm.channel[config.channel_mode]>1400 && ppm.channel[config.channel_mode]<1700)
@@ -0,0 +1,111 @@
+/*! 
+ *  GPS PPS edge capture, see pps.h.
+ *
+ *  The edge itself is taken by input capture module 7 (the RC receiver
+ *  claims IC1..IC6, see pwm_in). The capture fifo is only used to detect
+ *  the edge: the timestamp comes from timer_millis() read in the interrupt
+ *  routine, so the offset lives in the same clock as the log and telemetry
+ *  stamps. Interrupt latency puts the stamp a few us late, well inside the
+ *  ~1ms the survey post-processing asks for.
+ *
+ *  @file     pps.c
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#include "microcontroller/microcontroller.h"
+#include "timer/timer.h"
+#include "pps/pps.h"
+
+static volatile unsigned int edge_count = 0;
+static volatile unsigned long edge_millis = 0;
+static volatile long offset_ms = 0;
+static unsigned int labeled_edge = 0;   // edge_count the last label was matched to
+
+
+void pps_open()
+{
+	TRISDbits.TRISD14 = 1;  // IC7 = RD14 = in
+
+	_IC7IF = 0;             // Clear interrupt flag
+	_IC7IE = 1;             // Enable interrupts
+	IC7CON = 1;             // start module
+	IC7CONbits.ICTMR = 0;   // TMR3 (value unused, the stamp comes from timer_millis)
+	IC7CONbits.ICM = 0b011; // Capture every rising edge
+	_IC7IP = 5;
+}
+
+
+void __attribute__((__interrupt__, no_auto_psv)) _IC7Interrupt(void)
+{
+	unsigned int dummy;
+
+	while (IC7CONbits.ICBNE)
+		dummy = IC7BUF;      // drain the fifo, we only care that the edge happened
+
+	edge_millis = timer_millis();
+	edge_count++;
+
+	_IC7IF = 0;
+}
+
+
+unsigned int pps_edge_count()
+{
+	return edge_count;
+}
+
+
+unsigned long pps_last_edge_millis()
+{
+	unsigned long millis;
+
+	INTERRUPT_PROTECT(millis = edge_millis);
+	return millis;
+}
+
+
+/*!
+ *   Pairs a fix time with the pps edge that started its second. The fix
+ *   sentence arrives well after the edge it belongs to, so only the first
+ *   fix of a new second is used, and only when the edge is fresh - that
+ *   rejects the wrap-around case where a late fix would label the edge of
+ *   the next second.
+ */
+void pps_label_second(long gps_time_hhmmss)
+{
+	static long last_label = -1;
+	long ms_of_day;
+	unsigned int count;
+	unsigned long millis;
+
+	if (gps_time_hhmmss == last_label)
+		return;                      // not the first fix of this second
+	last_label = gps_time_hhmmss;
+
+	INTERRUPT_PROTECT(
+		count = edge_count;
+		millis = edge_millis
+	);
+	if (count == 0 || count == labeled_edge)
+		return;                      // no new edge to label
+	if (timer_millis() - millis > 500)
+		return;                      // stale edge, receiver stopped pulsing?
+	labeled_edge = count;
+
+	ms_of_day = ((gps_time_hhmmss / 10000l) * 3600l +
+	             ((gps_time_hhmmss / 100l) % 100l) * 60l +
+	             (gps_time_hhmmss % 100l)) * 1000l;
+
+	INTERRUPT_PROTECT(offset_ms = ms_of_day - (long)millis);
+}
+
+
+long pps_offset_ms()
+{
+	long o;
+
+	INTERRUPT_PROTECT(o = offset_ms);   // 32 bit, keep the read in one piece
+	return o;
+}
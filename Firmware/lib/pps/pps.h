@@ -0,0 +1,35 @@
+/*! 
+ *  @file     pps.h
+ *  @brief    GPS PPS input capture for cross-aircraft log alignment.
+ *  @detailed Captures the gps receiver's 1-pulse-per-second output on IC7
+ *            (RD14) and stamps every rising edge with the monotonic
+ *            timer_millis() clock. The gps task labels the edge with the
+ *            fix time that follows it; from then on pps_offset_ms() is the
+ *            number to add to a local millisecond stamp to get GPS time of
+ *            day. Logged in every LogLine, it lets post-processing align
+ *            the logs of several aircraft to about a millisecond.
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#ifndef PPS_H
+#define PPS_H
+
+void pps_open();
+
+//! Rising edges seen since boot; stays 0 when no PPS is wired up.
+unsigned int pps_edge_count();
+
+//! timer_millis() at the last rising edge.
+unsigned long pps_last_edge_millis();
+
+// Called by the gps task with the fix time (UTC, HHMMSS) of every fix;
+// labels the pps edge that started that second.
+void pps_label_second(long gps_time_hhmmss);
+
+//! GPS time of day in ms minus timer_millis(); 0 until the first labeled
+//! edge. Moves only by crystal drift (or a label correction) afterwards.
+long pps_offset_ms();
+
+#endif // PPS_H
@@ -116,6 +116,18 @@ void pwm_in_open()
 	IC1CONbits.ICM = 0b001; // Capture every edge 
 	_IC1IP = 5;
 
+#ifdef PWM_IN_FIFO_PAIRS
+	// Let the 4-deep capture fifo of each module hold the timestamps and
+	// only interrupt once per rising/falling pair: half the interrupt
+	// entries of the edge-per-interrupt decoder below.
+	IC1CONbits.ICI = 0b01;
+	IC2CONbits.ICI = 0b01;
+	IC3CONbits.ICI = 0b01;
+	IC4CONbits.ICI = 0b01;
+	IC5CONbits.ICI = 0b01;
+	IC6CONbits.ICI = 0b01;
+#endif
+
 	servo_pulse_max = pwm_in_us_to_raw(2300);
 	servo_pulse_min = pwm_in_us_to_raw(700);
 }
@@ -136,6 +148,149 @@ unsigned int pwm_in_raw_to_us(unsigned int raw)
 }
 
 
+#ifdef PWM_IN_FIFO_PAIRS
+
+/*
+ *   Decodes one rising/falling timestamp pair into a channel value.
+ */
+static void pwm_in_decode(unsigned int channel, unsigned int rise, unsigned int fall)
+{
+	unsigned int in;
+
+	if (rise < fall)
+		in = fall - rise;
+	else
+		in = 0xFFFF - rise + fall;  // 16 bit counter
+
+	if (in < servo_pulse_max && in > servo_pulse_min)
+	{
+		ppm.channel[channel] = pwm_in_raw_to_us(in);
+		ppm.valid_frame = 1;
+	}
+	else
+	{
+		ppm.valid_frame = 0;
+	}
+}
+
+/*
+ *   Pair decoders: each interrupt drains the capture fifo, which holds a
+ *   rising and a falling timestamp per pulse. The port level after the
+ *   drain tells which edge was captured last (high = rising), so the
+ *   decoder realigns itself when it starts in the middle of a pulse.
+ *
+ *   True DMA capture is not possible here: on this dsPic only IC1 and
+ *   IC2 are DMA request sources, and we use six capture modules.
+ */
+void __attribute__((__interrupt__, __auto_psv__)) _IC6Interrupt(void)
+{
+	static unsigned int last_t = 0;
+	static unsigned char next_is_falling = 0;
+
+	_IC6IF = 0;
+	while (IC6CONbits.ICBNE)
+	{
+		unsigned int t = IC6BUF;
+		if (next_is_falling)
+			pwm_in_decode(4, last_t, t);
+		last_t = t;
+		next_is_falling = !next_is_falling;
+	}
+	next_is_falling = PORTDbits.RD13;
+}
+
+
+void __attribute__((__interrupt__, __auto_psv__)) _IC5Interrupt(void)
+{
+	static unsigned int last_t = 0;
+	static unsigned char next_is_falling = 0;
+
+	_IC5IF = 0;
+	while (IC5CONbits.ICBNE)
+	{
+		unsigned int t = IC5BUF;
+		if (next_is_falling)
+			pwm_in_decode(5, last_t, t);
+		last_t = t;
+		next_is_falling = !next_is_falling;
+	}
+	next_is_falling = PORTDbits.RD12;
+}
+
+
+void __attribute__((__interrupt__, __auto_psv__)) _IC4Interrupt(void)
+{
+	static unsigned int last_t = 0;
+	static unsigned char next_is_falling = 0;
+
+	_IC4IF = 0;
+	while (IC4CONbits.ICBNE)
+	{
+		unsigned int t = IC4BUF;
+		if (next_is_falling)
+			pwm_in_decode(0, last_t, t);
+		last_t = t;
+		next_is_falling = !next_is_falling;
+	}
+	next_is_falling = PORTDbits.RD11;
+}
+
+
+void __attribute__((__interrupt__, __auto_psv__)) _IC3Interrupt(void)
+{
+	static unsigned int last_t = 0;
+	static unsigned char next_is_falling = 0;
+
+	_IC3IF = 0;
+	while (IC3CONbits.ICBNE)
+	{
+		unsigned int t = IC3BUF;
+		if (next_is_falling)
+			pwm_in_decode(3, last_t, t);
+		last_t = t;
+		next_is_falling = !next_is_falling;
+	}
+	next_is_falling = PORTDbits.RD10;
+}
+
+
+void __attribute__((__interrupt__, __auto_psv__)) _IC2Interrupt(void)
+{
+	static unsigned int last_t = 0;
+	static unsigned char next_is_falling = 0;
+
+	_IC2IF = 0;
+	while (IC2CONbits.ICBNE)
+	{
+		unsigned int t = IC2BUF;
+		if (next_is_falling)
+			pwm_in_decode(2, last_t, t);
+		last_t = t;
+		next_is_falling = !next_is_falling;
+	}
+	next_is_falling = PORTDbits.RD9;
+}
+
+
+void __attribute__((__interrupt__, __auto_psv__)) _IC1Interrupt(void)
+{
+	static unsigned int last_t = 0;
+	static unsigned char next_is_falling = 0;
+
+	_IC1IF = 0;
+	while (IC1CONbits.ICBNE)
+	{
+		unsigned int t = IC1BUF;
+		if (next_is_falling)
+			pwm_in_decode(1, last_t, t);
+		last_t = t;
+		next_is_falling = !next_is_falling;
+	}
+	next_is_falling = PORTDbits.RD8;
+}
+
+#else // PWM_IN_FIFO_PAIRS
+
 // shadow: fast context save DONT USE IT HERE!!!
 // no_auto_psv: code does not access string literals or const vars
 void __attribute__((__interrupt__, __auto_psv__)) _IC6Interrupt(void)
@@ -317,3 +472,5 @@ void __attribute__((__interrupt__, __auto_psv__)) _IC1Interrupt(void)
 	else
 		last_raw_in = raw_in;
 }
+
+#endif // PWM_IN_FIFO_PAIRS
@@ -1,4 +1,11 @@
 
+// When defined, the input capture modules capture every edge into their
+// 4-deep fifo and only interrupt once per rising/falling pair instead of
+// once per edge, halving the interrupt load of a PWM receiver. Comment
+// out to get the old edge-per-interrupt decoder.
+#define PWM_IN_FIFO_PAIRS
+
+
 
 void pwm_in_open();
 void pwm_in_wait_for();
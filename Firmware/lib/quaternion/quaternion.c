@@ -12,7 +12,9 @@
  
 #include <errno.h>
 #include <math.h>
+#include "fastmath/fastmath.h"
 #include "quaternion.h"
+#include "microcontroller/hotcode.h"
 
 /*!
  *	 Initialize quaternion (q[4]) with roll, pitch and yaw euclidian angles.
@@ -41,7 +43,7 @@ void quaternion_from_attitude (const float roll, const float pitch, const float
  *   @param q = along the y-axis = pitch-rate
  *   @param z = along the z-axis = yaw-rate
  */
-void quaternion_update_with_rates (const float rollrate, const float pitchrate, const float headingrate, float *q, const float dt)
+HOT_CODE void quaternion_update_with_rates (const float rollrate, const float pitchrate, const float headingrate, float *q, const float dt)
 {
 	const float w1 = rollrate;
 	const float w2 = pitchrate;
@@ -62,20 +64,17 @@ void quaternion_update_with_rates (const float rollrate, const float pitchrate,
 	q[2] = q2;
 	q[3] = q3;
 
-	quaternion_normalize(q);
+	// called at the full sensor rate, and the norm only drifts a little per
+	// step, so the fast inverse square root is accurate enough here
+	quaternion_normalize_fast(q);
 }
 
 float quaternion_to_roll (const float* q)
 {
-	float r;
-	errno = 0;
-	r = atan2( 2.0 * ( q[2]*q[3] + q[0]*q[1] ) ,
-	             (1.0 - 2.0 * (q[1]*q[1] + q[2]*q[2])) );  
-	if (errno)
-		return  0.0;
-	else
-		return r;
-}	
+	// fast_atan2 (lib/fastmath) never raises a domain error, so no errno dance
+	return fast_atan2( 2.0f * ( q[2]*q[3] + q[0]*q[1] ) ,
+	             (1.0f - 2.0f * (q[1]*q[1] + q[2]*q[2])) );
+}
 
 float quaternion_to_pitch(const float* q)
 {
@@ -91,23 +90,31 @@ float quaternion_to_pitch(const float* q)
 
 float quaternion_to_yaw(const float* q)
 {
-	float r;
-	errno = 0;
-	r = atan2( 2.0 * ( q[0]*q[3] + q[1]*q[2] ) ,
-	          (1.0 - 2.0 * (q[2]*q[2] + q[3]*q[3])) );  
-	if (errno)
-		return  0.0;
-	else
-		return r;
-}	
+	return fast_atan2( 2.0f * ( q[0]*q[3] + q[1]*q[2] ) ,
+	          (1.0f - 2.0f * (q[2]*q[2] + q[3]*q[3])) );
+}
 
 void quaternion_normalize(float *q)
 {
 	float norm = sqrtf(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
 
-	q[0] /= norm;	
+	q[0] /= norm;
 	q[1] /= norm;
 	q[2] /= norm;
 	q[3] /= norm;
 }
 
+/*!
+ *   Same as quaternion_normalize(), but with fast_rsqrt() (lib/fastmath)
+ *   instead of the software sqrt plus four divides.
+ */
+void quaternion_normalize_fast(float *q)
+{
+	float rnorm = fast_rsqrt(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
+
+	q[0] *= rnorm;
+	q[1] *= rnorm;
+	q[2] *= rnorm;
+	q[3] *= rnorm;
+}
+
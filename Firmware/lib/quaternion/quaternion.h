@@ -9,3 +9,7 @@ float quaternion_to_pitch(const float* q);
 float quaternion_to_yaw(const float* q);
 
 void quaternion_normalize(float* q);
+
+// fast_rsqrt() based; used in the update path, while quaternion_from_attitude()
+// keeps the accurate sqrt version
+void quaternion_normalize_fast(float* q);
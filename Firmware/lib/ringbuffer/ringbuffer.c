@@ -0,0 +1,180 @@
+/*!
+ *  @file     ringbuffer.c
+ *  @brief    Lock-free single-producer single-consumer ring buffers.
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#include "ringbuffer/ringbuffer.h"
+
+
+void ringbuffer_init(struct ringbuffer *rb, volatile unsigned char *data, unsigned int size)
+{
+	rb->data = data;
+	rb->mask = size - 1;
+	rb->head = 0;
+	rb->tail = 0;
+	rb->max_used = 0;
+	rb->drops = 0;
+}
+
+
+int ringbuffer_put(struct ringbuffer *rb, unsigned char c)
+{
+	// head - tail is wrap-safe: the indices run freely over the full
+	// unsigned range and only get masked when they touch the storage
+	unsigned int used = rb->head - rb->tail;
+	if (used > rb->mask)
+	{
+		rb->drops++;
+		return 0;
+	}
+	rb->data[rb->head & rb->mask] = c;
+	rb->head++;   // publishing the byte; a single 16-bit write, so atomic
+	if (used + 1 > rb->max_used)
+		rb->max_used = used + 1;   // producer-owned, like head
+	return 1;
+}
+
+
+void ringbuffer_replace_last(struct ringbuffer *rb, unsigned char c)
+{
+	if (rb->head == rb->tail)
+		return;
+	rb->data[(rb->head - 1) & rb->mask] = c;
+}
+
+
+int ringbuffer_get(struct ringbuffer *rb, unsigned char *c)
+{
+	if (rb->head == rb->tail)
+		return 0;
+	*c = rb->data[rb->tail & rb->mask];
+	rb->tail++;
+	return 1;
+}
+
+
+unsigned int ringbuffer_used(struct ringbuffer *rb)
+{
+	return rb->head - rb->tail;
+}
+
+
+unsigned int ringbuffer_free(struct ringbuffer *rb)
+{
+	return rb->mask + 1 - (rb->head - rb->tail);
+}
+
+
+void ringbuffer16_init(struct ringbuffer16 *rb, volatile unsigned int *data, unsigned int size)
+{
+	rb->data = data;
+	rb->mask = size - 1;
+	rb->head = 0;
+	rb->tail = 0;
+	rb->max_used = 0;
+	rb->drops = 0;
+}
+
+
+int ringbuffer16_put(struct ringbuffer16 *rb, unsigned int v)
+{
+	unsigned int used = rb->head - rb->tail;
+	if (used > rb->mask)
+	{
+		rb->drops++;
+		return 0;
+	}
+	rb->data[rb->head & rb->mask] = v;
+	rb->head++;
+	if (used + 1 > rb->max_used)
+		rb->max_used = used + 1;
+	return 1;
+}
+
+
+int ringbuffer16_get(struct ringbuffer16 *rb, unsigned int *v)
+{
+	if (rb->head == rb->tail)
+		return 0;
+	*v = rb->data[rb->tail & rb->mask];
+	rb->tail++;
+	return 1;
+}
+
+
+unsigned int ringbuffer16_used(struct ringbuffer16 *rb)
+{
+	return rb->head - rb->tail;
+}
+
+
+/*************************** watermark registry ****************************/
+
+struct RingbufferWatch
+{
+	const char *name;
+	unsigned int capacity;
+	volatile unsigned int *max_used;
+	volatile unsigned int *drops;
+};
+
+static struct RingbufferWatch watch[RINGBUFFER_MAX_WATCHES];
+static int watches = 0;
+
+
+int ringbuffer_watch(const char *name, unsigned int capacity,
+                     volatile unsigned int *max_used, volatile unsigned int *drops)
+{
+	if (watches >= RINGBUFFER_MAX_WATCHES)
+		return -1;
+	watch[watches].name = name;
+	watch[watches].capacity = capacity;
+	watch[watches].max_used = max_used;
+	watch[watches].drops = drops;
+	return watches++;
+}
+
+
+void ringbuffer_watch_ring(struct ringbuffer *rb, const char *name)
+{
+	ringbuffer_watch(name, rb->mask + 1, &rb->max_used, &rb->drops);
+}
+
+
+void ringbuffer16_watch_ring(struct ringbuffer16 *rb, const char *name)
+{
+	ringbuffer_watch(name, rb->mask + 1, &rb->max_used, &rb->drops);
+}
+
+
+int ringbuffer_watch_count()
+{
+	return watches;
+}
+
+
+const char *ringbuffer_watch_name(int i)
+{
+	return watch[i].name;
+}
+
+
+unsigned int ringbuffer_watch_capacity(int i)
+{
+	return watch[i].capacity;
+}
+
+
+unsigned int ringbuffer_watch_max_used(int i)
+{
+	return *watch[i].max_used;
+}
+
+
+unsigned int ringbuffer_watch_drops(int i)
+{
+	return *watch[i].drops;
+}
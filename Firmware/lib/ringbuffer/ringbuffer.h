@@ -0,0 +1,95 @@
+/*!
+ *  @file     ringbuffer.h
+ *  @brief    Lock-free single-producer single-consumer ring buffers.
+ *
+ *  The ISR-to-task data paths (uart1 console bytes, the gps characters on
+ *  uart2, the decoded ppm pulse widths) all need the same thing: one
+ *  interrupt routine writing, one task reading, no interrupt-disable
+ *  window on either side. On the dsPIC an aligned 16-bit write is atomic,
+ *  so a ring with one index owned by each side needs no other protection.
+ *
+ *  The indices run freely and are masked on access, which makes every
+ *  slot usable and the fill level a simple subtraction; sizes must be a
+ *  power of two. One producer and one consumer only: a second writer
+ *  (or reader) needs its own ring or a critical section around the calls.
+ *
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+//! Byte ring; the backing storage is supplied by the caller so it can live
+//! wherever it must (the uart1 transmit ring, for one, sits in DMA SRAM).
+struct ringbuffer
+{
+	volatile unsigned char *data;
+	unsigned int mask;            //!< size - 1; size must be a power of two
+	volatile unsigned int head;   //!< written only by the producer
+	volatile unsigned int tail;   //!< written only by the consumer
+	volatile unsigned int max_used;   //!< deepest fill level ever seen
+	volatile unsigned int drops;      //!< puts refused because the ring was full
+};
+
+//! size must be a power of two (not checked; a wrong size corrupts the ring).
+void ringbuffer_init(struct ringbuffer *rb, volatile unsigned char *data, unsigned int size);
+
+//! Producer side. Returns 0 when the ring is full (the byte is dropped).
+int ringbuffer_put(struct ringbuffer *rb, unsigned char c);
+
+//! Producer side: overwrites the most recently stored byte. The uart1
+//! receive path uses this to turn the newest byte of a full ring into a
+//! newline so the reader's line parser resynchronizes.
+void ringbuffer_replace_last(struct ringbuffer *rb, unsigned char c);
+
+//! Consumer side. Returns 0 when the ring is empty.
+int ringbuffer_get(struct ringbuffer *rb, unsigned char *c);
+
+//! Fill level / free space, callable from either side.
+unsigned int ringbuffer_used(struct ringbuffer *rb);
+unsigned int ringbuffer_free(struct ringbuffer *rb);
+
+//! Same ring for 16-bit elements (timer captures, pulse widths).
+struct ringbuffer16
+{
+	volatile unsigned int *data;
+	unsigned int mask;
+	volatile unsigned int head;
+	volatile unsigned int tail;
+	volatile unsigned int max_used;
+	volatile unsigned int drops;
+};
+
+void ringbuffer16_init(struct ringbuffer16 *rb, volatile unsigned int *data, unsigned int size);
+int ringbuffer16_put(struct ringbuffer16 *rb, unsigned int v);
+int ringbuffer16_get(struct ringbuffer16 *rb, unsigned int *v);
+unsigned int ringbuffer16_used(struct ringbuffer16 *rb);
+
+/*
+ *   Central watermark registry. Every ring (and the hand-rolled uart1 DMA
+ *   transmit ring, which registers its own counters) shows up on the CQ
+ *   console command, so queue depths can be sized from the measured maxima
+ *   across real flights instead of from guesses - and a nonzero drop count
+ *   is no longer invisible. Counters are owned by the ring's producer;
+ *   the registry only stores pointers to them.
+ */
+#define RINGBUFFER_MAX_WATCHES 8
+
+//! Registers a named set of counters; capacity in elements. Returns the
+//! entry index, or -1 when the registry is full.
+int ringbuffer_watch(const char *name, unsigned int capacity,
+                     volatile unsigned int *max_used, volatile unsigned int *drops);
+
+//! Convenience wrappers registering a ring's built-in counters.
+void ringbuffer_watch_ring(struct ringbuffer *rb, const char *name);
+void ringbuffer16_watch_ring(struct ringbuffer16 *rb, const char *name);
+
+int ringbuffer_watch_count();
+const char *ringbuffer_watch_name(int i);
+unsigned int ringbuffer_watch_capacity(int i);
+unsigned int ringbuffer_watch_max_used(int i);
+unsigned int ringbuffer_watch_drops(int i);
+
+#endif // RINGBUFFER_H
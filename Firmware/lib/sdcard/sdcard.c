@@ -0,0 +1,421 @@
+/*!
+ *   SPI SD/SDHC card backend for the datalogger, see sdcard.h.
+ *
+ *   The card shares the GP2 dataflash wiring: bit-banged SPI on RF6 (SCK),
+ *   RF7 (MOSI), RF8 (MISO) with the chip select on RF0. One logical page
+ *   is one 512-byte block; the write_pingpong path keeps a CMD25
+ *   multi-block write open across consecutive pages, so each page costs
+ *   one data token and the card programs it while the logger builds the
+ *   next one - the same shadowing the AT45's 2 SRAM buffers gave us.
+ *
+ *   @file    sdcard.c
+ *   @author  Tom Pycke
+ *   @date    31-aug-2026
+ *   @since   0.9
+ */
+
+#include "microcontroller/microcontroller.h"
+#include "sdcard/sdcard.h"
+#include "dataflash/dataflash.h"
+
+
+#define SD_CS    PORTFbits.RF0
+#define SD_SCK   PORTFbits.RF6
+#define SD_MOSI  PORTFbits.RF7
+#define SD_MISO  PORTFbits.RF8
+
+#define SD_BLOCK_SIZE     512
+//! Blocks pre-erased per ACMD23 when a new multi-block write opens; same
+//! idea as the datalogger's erase-ahead window on the AT45.
+#define SD_PREERASE_BLOCKS 32
+
+#define SD_TOKEN_SINGLE   0xFE   // CMD17/CMD24 data token
+#define SD_TOKEN_MULTI    0xFC   // CMD25 data token
+#define SD_TOKEN_STOP     0xFD   // CMD25 stop tran token
+
+static int card_ok = 0;
+static int card_is_sdhc = 0;
+static unsigned long card_blocks = 0;
+
+//! Next block of the open CMD25 session; -1 = no session open.
+static long session_next_block = -1;
+//! 1 while the last written block may still be programming.
+static int program_pending = 0;
+
+
+/*!
+ *    SPI communication basic operation using bit-banged software SPI,
+ *    same signals and idiom as gp2_spi_comm_bitbang().
+ */
+static unsigned char sd_spi(unsigned char outgoing_byte)
+{
+	unsigned char incoming_byte = 0, x;
+
+	for (x = 0; x < 8; x++)
+	{
+		SD_SCK = 0;
+
+		SD_MOSI = outgoing_byte >> 7;
+		outgoing_byte <<= 1;
+
+		SD_SCK = 1;
+
+		incoming_byte <<= 1;
+		incoming_byte |= SD_MISO & 0x01;
+	}
+
+	return incoming_byte;
+}
+
+
+static void sd_enable()
+{
+	SD_CS = 0;
+}
+
+
+static void sd_disable()
+{
+	SD_CS = 1;
+	sd_spi(0xFF);   // 8 clocks with CS high release the card's DO
+}
+
+
+//! Clocks until the card leaves busy (DO high) or the timeout strikes.
+static int sd_wait_not_busy()
+{
+	unsigned int i;
+
+	for (i = 0; i < 50000u; i++)
+	{
+		if (sd_spi(0xFF) == 0xFF)
+			return 1;
+	}
+	return 0;
+}
+
+
+/*!
+ *    Sends one command frame and returns the R1 response (0xFF on
+ *    timeout). The CRC byte only matters for CMD0 and CMD8, the cards
+ *    ignore it afterwards.
+ */
+static unsigned char sd_command(unsigned char cmd, unsigned long arg, unsigned char crc)
+{
+	unsigned char r1;
+	int i;
+
+	sd_spi(0xFF);
+	sd_spi(0x40 | cmd);
+	sd_spi((unsigned char)(arg >> 24));
+	sd_spi((unsigned char)(arg >> 16));
+	sd_spi((unsigned char)(arg >> 8));
+	sd_spi((unsigned char)arg);
+	sd_spi(crc);
+
+	for (i = 0; i < 10; i++)   // R1 arrives within 8 bytes
+	{
+		r1 = sd_spi(0xFF);
+		if (! (r1 & 0x80))
+			return r1;
+	}
+	return 0xFF;
+}
+
+
+static unsigned char sd_acommand(unsigned char cmd, unsigned long arg)
+{
+	sd_command(55, 0, 0xFF);   // APP_CMD prefix
+	return sd_command(cmd, arg, 0xFF);
+}
+
+
+//! Closes the open multi-block write, waiting out the last program.
+static void sd_end_session()
+{
+	if (session_next_block == -1)
+		return;
+
+	sd_wait_not_busy();        // the previous block may still be programming
+	sd_spi(SD_TOKEN_STOP);
+	sd_spi(0xFF);              // one byte gap before busy shows
+	sd_wait_not_busy();
+	sd_disable();
+	session_next_block = -1;
+	program_pending = 0;
+}
+
+
+//! Byte (SDSC) or block (SDHC) address of a block number.
+static unsigned long sd_address(unsigned long block)
+{
+	if (card_is_sdhc)
+		return block;
+	return block << 9;
+}
+
+
+/*!
+ *    Reads the CSD register and works out the capacity in blocks; both
+ *    the v1 (SDSC) and the v2 (SDHC) layout.
+ */
+static void sd_read_capacity()
+{
+	unsigned char csd[16];
+	int i;
+
+	card_blocks = 0;
+
+	sd_enable();
+	if (sd_command(9, 0, 0xFF) != 0)   // SEND_CSD
+	{
+		sd_disable();
+		return;
+	}
+	for (i = 0; i < 10000; i++)
+	{
+		if (sd_spi(0xFF) == SD_TOKEN_SINGLE)
+			break;
+	}
+	for (i = 0; i < 16; i++)
+		csd[i] = sd_spi(0xFF);
+	sd_spi(0xFF);   // 2 CRC bytes
+	sd_spi(0xFF);
+	sd_disable();
+
+	if ((csd[0] >> 6) == 1)
+	{
+		// CSD v2: C_SIZE in 512K-block units of (C_SIZE+1)*1024 blocks
+		unsigned long c_size = ((unsigned long)(csd[7] & 0x3F) << 16) |
+		                       ((unsigned long)csd[8] << 8) | csd[9];
+		card_blocks = (c_size + 1) * 1024ul;
+	}
+	else
+	{
+		// CSD v1: blocknr = (C_SIZE+1) * 2^(C_SIZE_MULT+2) * 2^READ_BL_LEN / 512
+		unsigned long c_size = (((unsigned long)(csd[6] & 0x03) << 10) |
+		                        ((unsigned long)csd[7] << 2) | (csd[8] >> 6));
+		int c_size_mult = ((csd[9] & 0x03) << 1) | (csd[10] >> 7);
+		int read_bl_len = csd[5] & 0x0F;
+
+		card_blocks = (c_size + 1);
+		card_blocks <<= (c_size_mult + 2 + read_bl_len - 9);
+	}
+}
+
+
+/*!
+ *   Initializes the card and publishes the geometry. The system page
+ *   layout matches the 16Mbit dataflash, so configuration, calibration
+ *   and log index live on the same page numbers either way.
+ */
+void sdcard_open()
+{
+	unsigned char r1;
+	int i;
+
+	TRISFbits.TRISF6 = 0;   // SCK
+	TRISFbits.TRISF7 = 0;   // MOSI
+	TRISFbits.TRISF8 = 1;   // MISO
+	TRISFbits.TRISF0 = 0;   // CS
+	SD_CS = 1;
+
+	card_ok = 0;
+	card_is_sdhc = 0;
+	session_next_block = -1;
+	program_pending = 0;
+
+	for (i = 0; i < 10; i++)   // >74 clocks with CS high: card enters SPI mode
+		sd_spi(0xFF);
+
+	sd_enable();
+	r1 = sd_command(0, 0, 0x95);           // GO_IDLE_STATE
+	if (r1 != 0x01)
+	{
+		sd_disable();
+		uart1_puts("sdcard: no card\r\n");
+	}
+	else
+	{
+		r1 = sd_command(8, 0x1AAul, 0x87); // SEND_IF_COND: v2 cards echo the pattern
+		if (r1 == 0x01)
+		{
+			sd_spi(0xFF); sd_spi(0xFF);    // R7 tail
+			sd_spi(0xFF); sd_spi(0xFF);
+		}
+
+		for (i = 0; i < 10000; i++)        // ACMD41 with HCS until out of idle
+		{
+			if (sd_acommand(41, 0x40000000ul) == 0x00)
+				break;
+		}
+		if (i < 10000)
+		{
+			if (sd_command(58, 0, 0xFF) == 0x00)   // READ_OCR: CCS = block addressing
+			{
+				card_is_sdhc = (sd_spi(0xFF) & 0x40) != 0;
+				sd_spi(0xFF); sd_spi(0xFF); sd_spi(0xFF);
+			}
+			if (! card_is_sdhc)
+				sd_command(16, SD_BLOCK_SIZE, 0xFF);   // SET_BLOCKLEN
+
+			sd_disable();
+			sd_read_capacity();
+			card_ok = (card_blocks > 0);
+		}
+		else
+			sd_disable();
+	}
+
+	// Geometry: the 16Mbit dataflash layout with 512-byte pages. Page
+	// numbers are int, so the log area caps at 32768 blocks (16MB) - still
+	// 4x the biggest AT45 and enough for a full flight at 50Hz.
+	PAGE_SIZE = SD_BLOCK_SIZE;
+	if (card_ok && card_blocks <= 32768ul)
+		MAX_PAGE = (int)card_blocks - 1;
+	else
+		MAX_PAGE = 32767;
+	BLACKBOX_PAGE = MAX_PAGE;
+	CALIBRATION_PAGE = 5;
+	TEMPCOMP_PAGE = 6;
+	START_LOG_PAGE = 7;
+	LOG_INDEX_PAGE = 4;
+	CONFIGURATION_PAGE = 0;  // page 1=reserve
+	NAVIGATION_PAGE = 2;  // page 3=reserve
+}
+
+
+int sdcard_read_Mbit()
+{
+	return (int)(card_blocks / 256ul);   // blocks of 4Kbit
+}
+
+
+int sdcard_ready()
+{
+	int idle;
+
+	if (! card_ok)
+		return 1;
+	if (session_next_block == -1 || ! program_pending)
+		return 1;
+
+	idle = (sd_spi(0xFF) == 0xFF);   // CS is still low inside the session
+	if (idle)
+		program_pending = 0;
+	return idle;
+}
+
+
+void sdcard_read(int page, int size, unsigned char *buffer)
+{
+	int i;
+
+	if (! card_ok)
+		return;
+
+	sd_end_session();   // main memory reads need the write session closed
+
+	while (size > 0)
+	{
+		int n = size > SD_BLOCK_SIZE ? SD_BLOCK_SIZE : size;
+
+		sd_enable();
+		if (sd_command(17, sd_address((unsigned long)page), 0xFF) != 0)   // READ_SINGLE_BLOCK
+		{
+			sd_disable();
+			return;
+		}
+		for (i = 0; i < 30000; i++)
+		{
+			if (sd_spi(0xFF) == SD_TOKEN_SINGLE)
+				break;
+		}
+		for (i = 0; i < n; i++)
+			buffer[i] = sd_spi(0xFF);
+		for (; i < SD_BLOCK_SIZE; i++)   // clock out the rest of the block
+			sd_spi(0xFF);
+		sd_spi(0xFF);   // 2 CRC bytes
+		sd_spi(0xFF);
+		sd_disable();
+
+		size -= n;
+		buffer += n;
+		page++;
+	}
+}
+
+
+//! Single-block write inside the open CMD25 session; opens one when the
+//! page does not continue the previous write.
+static void sd_write_block_session(int page, int size, unsigned char *buffer)
+{
+	int i;
+
+	if (session_next_block != (long)page)
+	{
+		sd_end_session();
+
+		sd_enable();
+		sd_acommand(23, SD_PREERASE_BLOCKS);   // pre-erase ahead of the writes
+		if (sd_command(25, sd_address((unsigned long)page), 0xFF) != 0)   // WRITE_MULTIPLE_BLOCK
+		{
+			sd_disable();
+			return;
+		}
+		session_next_block = page;
+	}
+	else
+		sd_wait_not_busy();   // previous block ran in our shadow
+
+	sd_spi(SD_TOKEN_MULTI);
+	for (i = 0; i < size; i++)
+		sd_spi(buffer[i]);
+	for (; i < SD_BLOCK_SIZE; i++)
+		sd_spi(0xFF);
+	sd_spi(0xFF);   // 2 CRC bytes
+	sd_spi(0xFF);
+	sd_spi(0xFF);   // data response token, ignored like the AT45 status
+
+	session_next_block = page + 1;
+	program_pending = 1;   // card programs while the logger carries on
+}
+
+
+void sdcard_write_pingpong(int page, int size, unsigned char *buffer)
+{
+	if (! card_ok)
+		return;
+	sd_write_block_session(page, size, buffer);
+}
+
+
+void sdcard_write_pingpong_noerase(int page, int size, unsigned char *buffer)
+{
+	// ACMD23 already pre-erases the session; both paths are the fast one
+	sdcard_write_pingpong(page, size, buffer);
+}
+
+
+void sdcard_write(int page, int size, unsigned char *buffer)
+{
+	if (! card_ok)
+		return;
+
+	while (size > 0)
+	{
+		int n = size > SD_BLOCK_SIZE ? SD_BLOCK_SIZE : size;
+
+		sd_write_block_session(page, n, buffer);
+		size -= n;
+		buffer += n;
+		page++;
+	}
+	sd_end_session();   // blocking semantics: data is on the card when we return
+}
+
+
+void sdcard_erase_page(int page)
+{
+	// nothing to do: blocks need no explicit erase over SPI
+}
@@ -0,0 +1,41 @@
+/*!
+ *   SPI SD/SDHC card backend for the datalogger.
+ *
+ *   Exposes the same operations as the AT45 dataflash (see struct
+ *   Dataflash in dataflash/dataflash.h), mapping one logical "page" onto
+ *   one 512-byte card block. Sequential log writes stay inside one open
+ *   multi-block write (CMD25 with ACMD23 pre-erase), which is what lets
+ *   the card sustain the 50Hz full-LogLine rate. Selected at compile time
+ *   with LOG_TO_SDCARD in dataflash/dataflash.h; GP2 boards only, the
+ *   card sits on the dataflash SPI signals.
+ *
+ *   @file    sdcard.h
+ *   @author  Tom Pycke
+ *   @date    31-aug-2026
+ *   @since   0.9
+ */
+
+#ifndef SDCARD_H
+#define SDCARD_H
+
+//! Initializes the card (CMD0/CMD8/ACMD41) and publishes the geometry
+//! (PAGE_SIZE, MAX_PAGE, system pages) like the dataflash open does.
+void sdcard_open();
+
+void sdcard_read(int page, int size, unsigned char *buffer);
+void sdcard_write(int page, int size, unsigned char *buffer);
+
+//! Sequential-friendly single-page write: consecutive pages continue the
+//! open multi-block write and return while the card programs the block.
+void sdcard_write_pingpong(int page, int size, unsigned char *buffer);
+void sdcard_write_pingpong_noerase(int page, int size, unsigned char *buffer);
+
+//! No-op: the card pre-erases through ACMD23, kept for the interface.
+void sdcard_erase_page(int page);
+
+//! 1 when no block program is pending.
+int sdcard_ready();
+
+int sdcard_read_Mbit();
+
+#endif // SDCARD_H
@@ -3,6 +3,12 @@
  *   using the dsPic's Output Capture module.
  *   This code uses TIMER2 as a reference, make sure not to reconfigure this timer
  *   when using this library!
+ *
+ *   servo_set_highrate_mask() switches the shared frame to 400Hz for ESCs.
+ *   All 8 output compare channels run from the same TMR2 period (TMR3 is
+ *   taken by the R/C input capture), so channels that must stay at 50Hz
+ *   (analog gimbal servos) are frame-skipped instead: a TMR2 interrupt
+ *   lets their pulse through on every 8th frame and blanks the other 7.
  */
  
 
@@ -15,8 +21,9 @@
 
 void servo_turbopwm()
 {
-	PR2 = FCY/50/8;         //= 400Hz = 0.0025ms period
-}	
+	// legacy entry point: every channel to the fast frame
+	servo_set_highrate_mask(0xff);
+}
 
 
 void servo_init()
@@ -118,6 +125,17 @@ unsigned int servo_raw_to_us(unsigned int raw)
 volatile unsigned int* OCxRS[] = { &OC1RS, &OC2RS, &OC3RS, &OC4RS, &OC5RS, &OC6RS, &OC7RS, &OC8RS };
 volatile OC1CONBITS* OCxCONbits[] = { (volatile OC1CONBITS*)&OC1CONbits, (volatile OC1CONBITS*)&OC2CONbits, (volatile OC1CONBITS*)&OC3CONbits, (volatile OC1CONBITS*)&OC4CONbits, (volatile OC1CONBITS*)&OC5CONbits, (volatile OC1CONBITS*)&OC6CONbits, (volatile OC1CONBITS*)&OC7CONbits, (volatile OC1CONBITS*)&OC8CONbits };
 
+//! Last commanded pulse width (raw ticks) per channel; the frame-skipping
+//! interrupt replays these on the 50Hz channels when the fast frame is on.
+static unsigned int servo_raw[8];
+//! Channels that get a pulse in every 400Hz frame; 0 = everything at 50Hz.
+static volatile unsigned char servo_highrate_mask = 0;
+
+//! Pulse widths staged by servo_stage_us(), waiting for servo_commit().
+static unsigned int servo_staged[8];
+//! One bit per channel that was staged since the last commit.
+static unsigned char servo_staged_mask = 0;
+
 /*!
  *  Assigns a new value to the servo-output buffer.
  *  @param index Servo number (0 to 7)
@@ -128,6 +146,8 @@ void servo_set_us(int servo, unsigned int us)
 {
 	unsigned int raw = servo_us_to_raw(us);
 
+	if (servo >= 0 && servo < 8)
+		servo_raw[servo] = raw;
 
     //*(OCxRS[servo]) = raw;
     switch (servo)
@@ -161,6 +181,98 @@ void servo_set_us(int servo, unsigned int us)
     }
 }	
 
+/*!
+ *  Stages a new value for a servo without touching the output yet; 
+ *  servo_commit() applies all staged channels at once.
+ *  @param servo Servo number (0 to 7)
+ *  @param us    Number of microseconds the PWM pulse to the servo must 
+ *               last (preferable between 1000 and 2000).
+ */
+void servo_stage_us(int servo, unsigned int us)
+{
+	if (servo >= 0 && servo < 8)
+	{
+		servo_staged[servo] = servo_us_to_raw(us);
+		servo_staged_mask |= (1 << servo);
+	}
+}
+
+
+/*!
+ *  Applies every channel staged with servo_stage_us() so they all latch
+ *  into the same output frame. The Output Compare hardware only transfers
+ *  OCxRS into the pulse generator when TMR2 rolls over, so the writes are
+ *  atomic per frame as long as they do not straddle the rollover: when we
+ *  are within ~100us of the period end, the rollover is waited out first.
+ *  Without this, a mix computed while TMR2 wraps reaches the left and the
+ *  right elevon in different frames.
+ */
+void servo_commit()
+{
+	int i;
+
+	while (PR2 - TMR2 < 64)
+		;
+
+	for (i = 0; i < 8; i++)
+	{
+		if (servo_staged_mask & (1 << i))
+		{
+			servo_raw[i] = servo_staged[i];
+			*(OCxRS[i]) = servo_staged[i];
+		}
+	}
+	servo_staged_mask = 0;
+}
+
+
+/*!
+ *  Selects which channels run at the 400Hz output frame. With a non-zero
+ *  mask the shared TMR2 period drops to 2.5ms and the channels outside the
+ *  mask are frame-skipped back to 50Hz by the TMR2 interrupt below; with
+ *  mask 0 the interrupt is off and everything behaves as it always did.
+ *  @param mask One bit per channel (bit 0 = servo 0) that may pulse at 400Hz.
+ */
+void servo_set_highrate_mask(unsigned char mask)
+{
+	servo_highrate_mask = mask;
+	if (mask)
+	{
+		PR2 = FCY/400/64;    // period = 2.5ms; a 2ms pulse still fits
+		_T2IF = 0;
+		_T2IP = 5;
+		_T2IE = 1;
+	}
+	else
+	{
+		_T2IE = 0;
+		PR2 = FCY/50/64;     // period = 0.02s
+	}
+}
+
+
+/*!
+ *  Runs once per 400Hz frame (only while a highrate mask is set). The
+ *  output compare hardware latches OCxRS at every period rollover, so to
+ *  keep a channel at 50Hz we let its programmed width through on one frame
+ *  out of 8 and load a zero-length pulse for the other seven.
+ */
+void __attribute__ ((interrupt, no_auto_psv)) _T2Interrupt( void )
+{
+	static int frame = 0;
+	int i;
+
+	if (++frame >= 8)   // 400Hz / 8 = 50Hz
+		frame = 0;
+	for (i = 0; i < 8; i++)
+	{
+		if (!(servo_highrate_mask & (1 << i)))
+			*(OCxRS[i]) = (frame == 0) ? servo_raw[i] : 0;
+	}
+	_T2IF = 0;
+}
+
+
 /*!
  *    Set the servo's output to a high level (5V). Used for other triggering peripherals that can't use PWM
  *    Remark: after calling this command, the channel will output no longer in PWM, even when calling the servo_set_us command.
@@ -207,6 +319,11 @@ void servo_set_ms(int servo, float ms)
 unsigned int servo_read_us(int channel)
 {
 	unsigned int raw;
+
+	// a frame-skipped channel reads 0 most of the time; report the command
+	if (servo_highrate_mask != 0 && channel >= 0 && channel < 8 &&
+	    !(servo_highrate_mask & (1 << channel)))
+		return servo_raw_to_us(servo_raw[channel]);
 	switch (channel)
 	{
 		case 0: 
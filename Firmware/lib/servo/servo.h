@@ -6,6 +6,10 @@ void servo_init();
 
 void servo_set_us(int servo, unsigned int us);
 
+void servo_stage_us(int servo, unsigned int us);
+
+void servo_commit();
+
 void servo_set_ms(int servo, float ms);
 
 unsigned int servo_raw_to_us(unsigned int raw);
@@ -16,6 +20,9 @@ void servo_all_neutral();
 
 void servo_turbopwm();
 
+//! Channels in the mask pulse at 400Hz (ESCs), the rest stay at 50Hz.
+void servo_set_highrate_mask(unsigned char mask);
+
 void servo_set_logical_0(int servo);
 
 void servo_set_logical_1(int servo);
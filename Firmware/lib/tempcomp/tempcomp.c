@@ -0,0 +1,138 @@
+/*!
+ *  Gyroscope temperature compensation with a per-degree lookup table.
+ *
+ *  The analog gyroscopes drift with board temperature, which shows up as
+ *  bias creep on cold-morning flights while the board warms up. The old
+ *  temperature_compensation example only dumped temperature/gyro pairs so
+ *  the curve could be fitted by hand; here the curve lives in a per-degree
+ *  table in dataflash, filled by an on-board calibration run and applied
+ *  as a plain integer subtraction per sample. No polynomial is evaluated
+ *  at run time.
+ *
+ *  @file     tempcomp.c
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#include "dataflash/dataflash.h"
+#include "tempcomp.h"
+
+//! Memory allocation for the table; mirror of the TEMPCOMP_PAGE content.
+static struct TempCompTable table;
+
+int tempcomp_gyro_x = 0;
+int tempcomp_gyro_y = 0;
+int tempcomp_gyro_z = 0;
+
+static int capture_active = 0;
+
+//! Calibration bookkeeping (ram only): which rows received a sample.
+static unsigned char row_seen[TEMPCOMP_ENTRIES];
+
+
+//! Maps a board temperature (0.1 deg C) onto a table row, clamped to the range.
+static int tempcomp_row(int temperature_10)
+{
+	int row = temperature_10 / 10 - TEMPCOMP_MIN_TEMP;
+	if (row < 0)
+		row = 0;
+	if (row >= TEMPCOMP_ENTRIES)
+		row = TEMPCOMP_ENTRIES - 1;
+	return row;
+}
+
+
+void tempcomp_init()
+{
+	int i;
+	for (i = 0; i < TEMPCOMP_ENTRIES; i++)
+	{
+		table.gyro_x_offset[i] = 0;
+		table.gyro_y_offset[i] = 0;
+		table.gyro_z_offset[i] = 0;
+		row_seen[i] = 0;
+	}
+	table.magic = 0;
+	table.rows_filled = 0;
+	tempcomp_gyro_x = 0;
+	tempcomp_gyro_y = 0;
+	tempcomp_gyro_z = 0;
+}
+
+
+void tempcomp_load()
+{
+	dataflash.read(TEMPCOMP_PAGE, sizeof(struct TempCompTable), (unsigned char*)&table);
+	if (table.magic != TEMPCOMP_MAGIC)
+		tempcomp_init();   // erased or never calibrated: compensate nothing
+}
+
+
+void tempcomp_write()
+{
+	table.magic = TEMPCOMP_MAGIC;
+	dataflash.write(TEMPCOMP_PAGE, sizeof(struct TempCompTable), (unsigned char*)&table);
+}
+
+
+void tempcomp_set_temperature(int temperature_10)
+{
+	int row = tempcomp_row(temperature_10);
+	tempcomp_gyro_x = table.gyro_x_offset[row];
+	tempcomp_gyro_y = table.gyro_y_offset[row];
+	tempcomp_gyro_z = table.gyro_z_offset[row];
+}
+
+
+void tempcomp_calibrate_start()
+{
+	tempcomp_init();
+	capture_active = 1;
+}
+
+
+int tempcomp_calibrate_stop()
+{
+	capture_active = 0;
+	tempcomp_write();
+	return table.rows_filled;
+}
+
+
+int tempcomp_calibrating()
+{
+	return capture_active;
+}
+
+
+void tempcomp_calibrate_sample(int temperature_10,
+                               unsigned int gyro_x_raw, unsigned int gyro_y_raw, unsigned int gyro_z_raw,
+                               float gyro_x_neutral, float gyro_y_neutral, float gyro_z_neutral)
+{
+	int row, dx, dy, dz;
+
+	if (!capture_active)
+		return;
+
+	row = tempcomp_row(temperature_10);
+	dx = (int)((long)gyro_x_raw - (long)gyro_x_neutral);
+	dy = (int)((long)gyro_y_raw - (long)gyro_y_neutral);
+	dz = (int)((long)gyro_z_raw - (long)gyro_z_neutral);
+
+	if (!row_seen[row])
+	{
+		table.gyro_x_offset[row] = dx;
+		table.gyro_y_offset[row] = dy;
+		table.gyro_z_offset[row] = dz;
+		row_seen[row] = 1;
+		table.rows_filled++;
+	}
+	else
+	{
+		// smooth out the sensor noise over the samples landing in this row
+		table.gyro_x_offset[row] = (table.gyro_x_offset[row] * 3 + dx) / 4;
+		table.gyro_y_offset[row] = (table.gyro_y_offset[row] * 3 + dy) / 4;
+		table.gyro_z_offset[row] = (table.gyro_z_offset[row] * 3 + dz) / 4;
+	}
+}
@@ -0,0 +1,69 @@
+/*!
+ *  Gyroscope temperature compensation with a per-degree lookup table.
+ *
+ *  @file     tempcomp.h
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#ifndef TEMPCOMP_H
+#define TEMPCOMP_H
+
+#define TEMPCOMP_MIN_TEMP    0     // deg C; everything below uses the first row
+#define TEMPCOMP_MAX_TEMP    40    // deg C; everything above uses the last row
+#define TEMPCOMP_ENTRIES     41    // one row per degree
+
+//! The table as it lives in dataflash: per-degree gyroscope neutral
+//! deviations in raw adc counts, relative to the calibrated neutrals.
+struct TempCompTable
+{
+	int magic;                           //!< TEMPCOMP_MAGIC when the table is valid
+	int rows_filled;                     //!< number of rows seen during calibration
+	int gyro_x_offset[TEMPCOMP_ENTRIES]; //!< counts to subtract from gyro_x_raw
+	int gyro_y_offset[TEMPCOMP_ENTRIES];
+	int gyro_z_offset[TEMPCOMP_ENTRIES];
+};
+
+#define TEMPCOMP_MAGIC  0x7C01
+
+//! The active row, refreshed by tempcomp_set_temperature(). Subtract these
+//! from the raw gyroscope samples before the neutral: a per-sample cost of
+//! one integer subtraction per axis.
+extern int tempcomp_gyro_x;
+extern int tempcomp_gyro_y;
+extern int tempcomp_gyro_z;
+
+//! Clears the table and the active offsets (compensates nothing).
+void tempcomp_init();
+
+//! Reads the table from its dataflash page; falls back to an empty table
+//! when the page was never written.
+void tempcomp_load();
+
+//! Writes the table to its dataflash page.
+void tempcomp_write();
+
+//! Selects the table row for the current board temperature (0.1 deg C).
+//! Call at housekeeping rate; the per-sample path never searches the table.
+void tempcomp_set_temperature(int temperature_10);
+
+//! Starts a calibration run: the table is cleared and every stationary
+//! sample fed to tempcomp_calibrate_sample() refines the row for its
+//! temperature. Let the board warm up (or cool down) through the range.
+void tempcomp_calibrate_start();
+
+//! Ends the calibration run and writes the table to dataflash.
+//! Returns the number of rows that received data.
+int tempcomp_calibrate_stop();
+
+//! Returns 1 while a calibration run is active.
+int tempcomp_calibrating();
+
+//! Feeds one stationary gyroscope sample to the calibration run.
+//! Deviations are measured against the configured neutrals.
+void tempcomp_calibrate_sample(int temperature_10,
+                               unsigned int gyro_x_raw, unsigned int gyro_y_raw, unsigned int gyro_z_raw,
+                               float gyro_x_neutral, float gyro_y_neutral, float gyro_z_neutral);
+
+#endif // TEMPCOMP_H
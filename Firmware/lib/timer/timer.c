@@ -1,5 +1,6 @@
 
 #include "microcontroller/microcontroller.h"
+#include "microcontroller/isr_time.h"
 #include "timer/timer.h"
 
 static const float ticks_per_second = (float)FCY;
@@ -38,6 +39,132 @@ float timer_dt()
 	t += TMR4;
 	t <<= 8;       // we use a 1/256 prescaler!
 	float ticks = (float)t;
-	timer_reset();	
+	timer_reset();
 	return ticks/ticks_per_second;
 }
+
+
+/*
+ *   Free-running mode: TMR4/TMR5 paired as one 32-bit counter at FCY
+ *   (1:1 prescaler, cycle resolution, wraps every ~107s at 40MHz) that
+ *   is never reset. Multiple users can measure intervals from their own
+ *   captures with timer_dt_from(), so one timer serves the control
+ *   loop's dt and the task profiler at the same time.
+ */
+void timer_init_freerunning()
+{
+	T4CONbits.TON = 0;
+	T4CONbits.TCS = 0;      // Internal clock (FOSC/2)
+	T4CONbits.TCKPS = 0;    // 1:1 prescaler
+	T4CONbits.T32 = 1;      // TMR5:TMR4 count as one 32 bit timer
+	PR4 = 0xffff;
+	PR5 = 0xffff;
+	TMR5HLD = 0;            // writing TMR4 loads TMR5 from the holding register
+	TMR4 = 0;
+	T4CONbits.TON = 1;
+}
+
+
+unsigned long timer_ticks_32()
+{
+	unsigned long t;
+
+	// Reading TMR4 latches TMR5 into the shared TMR5HLD holding register.
+	// The pps edge capture reads this timer from its interrupt routine, so
+	// keep it from re-latching TMR5HLD between our two reads.
+	INTERRUPT_PROTECT(
+		t = TMR4;
+		t |= ((unsigned long)TMR5HLD << 16)
+	);
+	return t;
+}
+
+
+float timer_dt_from(unsigned long *last_ticks)
+{
+	unsigned long now = timer_ticks_32();
+	unsigned long elapsed = now - *last_ticks;   // unsigned: survives the wrap
+	*last_ticks = now;
+	return (float)elapsed / ticks_per_second;
+}
+
+
+unsigned long timer_millis()
+{
+	static unsigned long ms = 0;
+	static unsigned long last_ticks = 0;
+	static unsigned long rest = 0;   // leftover cycles below one millisecond
+	unsigned long now, elapsed;
+
+	// The statics are shared between every calling task; DISI masks all
+	// user interrupts (and with them the scheduler tick) for the few
+	// hundred cycles the software division takes.
+	__builtin_disi(0x3FFF);
+	now = timer_ticks_32();
+	elapsed = (now - last_ticks) + rest;
+	last_ticks = now;
+	ms += elapsed / (FCY / 1000);
+	rest = elapsed % (FCY / 1000);
+	__builtin_disi(0x0000);
+
+	return ms;
+}
+
+
+/*
+ *   One-shot microsecond deadline: TMR6/TMR7 paired as a 32 bit timer at
+ *   FCY with the period registers as the compare value, so the handler
+ *   runs within a cycle of the programmed moment instead of on the next
+ *   task wakeup. First user is the camera trigger, which converts the
+ *   distance to the trigger point into a deadline.
+ */
+static void (*deadline_handler)(void) = 0;
+
+void timer_deadline_us(unsigned long us, void (*handler)(void))
+{
+	unsigned long ticks;
+
+	if (us > 100000000ul)
+		us = 100000000ul;           // 100s; keeps the tick count in 32 bit
+	ticks = us * (FCY / 1000000l);
+
+	T6CONbits.TON = 0;
+	_T7IE = 0;
+	T6CONbits.TCS = 0;              // Internal clock (FOSC/2)
+	T6CONbits.TCKPS = 0;            // 1:1 prescaler
+	T6CONbits.T32 = 1;              // TMR7:TMR6 count as one 32 bit timer
+	if (ticks < 16)
+		ticks = 16;                 // a deadline in the past still fires, just right away
+	PR6 = (unsigned int)(ticks & 0xffff);
+	PR7 = (unsigned int)(ticks >> 16);
+	TMR7HLD = 0;                    // writing TMR6 loads TMR7 from the holding register
+	TMR6 = 0;
+	deadline_handler = handler;
+	_T7IF = 0;
+	_T7IP = 5;
+	_T7IE = 1;
+	T6CONbits.TON = 1;
+}
+
+
+void timer_deadline_cancel()
+{
+	_T7IE = 0;
+	T6CONbits.TON = 0;
+	deadline_handler = 0;
+}
+
+
+void __attribute__((__interrupt__, no_auto_psv)) _T7Interrupt(void)
+{
+	void (*handler)(void) = deadline_handler;
+	ISR_TIME_DECLARE;
+
+	ISR_TIME_ENTER();
+	_T7IF = 0;
+	T6CONbits.TON = 0;              // one shot
+	_T7IE = 0;
+	if (handler)
+		handler();
+	ISR_TIME_EXIT(ISR_TIME_DEADLINE);
+}
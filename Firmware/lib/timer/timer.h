@@ -1,8 +1,31 @@
-
-
-
 void timer_init();
 
 void timer_reset();
 
 float timer_dt();
+
+// Free-running 32-bit mode (TMR4/TMR5 at FCY, never reset); every user
+// keeps its own capture and measures against it with timer_dt_from().
+void timer_init_freerunning();
+
+unsigned long timer_ticks_32();
+
+float timer_dt_from(unsigned long *last_ticks);
+
+// Monotonic 32-bit millisecond clock derived from the free-running
+// counter; wraps after ~49 days instead of the counter's ~107s. Shared
+// between tasks (the update runs with interrupts masked), but it must be
+// called at least once per counter wrap to not lose time - any periodic
+// task faster than a minute keeps it honest. May also be called from an
+// interrupt of priority 6 or below (the pps edge capture does): DISI
+// masks those while a task is inside the update.
+unsigned long timer_millis();
+
+// One-shot deadline on the TMR6/TMR7 pair at FCY: the handler is called
+// from the timer interrupt (priority 5) once the given number of
+// microseconds has elapsed. Arming replaces any pending deadline; the
+// handler must be interrupt-safe (no blocking RTOS calls). Deadlines are
+// clamped to 100 seconds.
+void timer_deadline_us(unsigned long us, void (*handler)(void));
+
+void timer_deadline_cancel();
@@ -1,16 +1,170 @@
 
 #include "microcontroller/microcontroller.h"
+#include "microcontroller/isr_time.h"
 #include "uart1_queue/uart1_queue.h"
+#include "ringbuffer/ringbuffer.h"
+#include "format/format.h"
 
 #include "FreeRTOS/FreeRTOS.h"
 #include "FreeRTOS/queue.h"
 #include "FreeRTOS/task.h"
+#include "FreeRTOS/semphr.h"
 
+#ifdef UART1_QUEUE_RX_RING
+/*
+ *   Receive path: the ISR used to post every byte to xRxedChars, waking the
+ *   console task once per character - a GluonCS configuration burst at 115k2
+ *   means >10000 scheduler round trips per second, and those context
+ *   switches measurably delayed the control task. The bytes now land in a
+ *   plain ring buffer and the reader is only signalled on a line ending or
+ *   when the ring passes its high-water mark (binary uplink frames carry no
+ *   newline, so a half-full ring must wake the reader too).
+ */
+#define UART1_RX_BUFFER_SIZE 512
+#define UART1_RX_HIGH_WATER  (UART1_RX_BUFFER_SIZE / 2)
+static volatile unsigned char uart1_rx_buffer[UART1_RX_BUFFER_SIZE];
+static struct ringbuffer uart1_rx_ring;   // producer: the ISR, consumer: the console task
+static xSemaphoreHandle xRxSignal;
+#else
 xQueueHandle xRxedChars;
+// watch counters for the legacy queue path, kept by the receive ISR
+static volatile unsigned int uart1_rxq_max = 0;
+static volatile unsigned int uart1_rxq_drops = 0;
+#endif
+
+#ifdef UART1_QUEUE_DMA_TX
+/*
+ *   DMA transmit path. The dsPIC's DMA engine can only read from DMA SRAM,
+ *   so a true zero-copy send of caller buffers is not possible: instead the
+ *   put-functions copy into this ring buffer and DMA channel 3 clocks it
+ *   into U1TXREG on every U1TX request. The tasks never wait for the uart
+ *   anymore (unless the ring is full, which at 115k2 means >45ms of
+ *   backlog), which removes the telemetry jitter from the control loop.
+ *
+ *   DMA0 is taken by the ADC, DMA1/DMA2 by the MPU6000 SPI transfers.
+ */
+#define UART1_TX_BUFFER_SIZE 512
+static unsigned char uart1_tx_buffer[UART1_TX_BUFFER_SIZE] __attribute__((space(dma)));
+static volatile int uart1_tx_head = 0;   // next free position, written by tasks
+static volatile int uart1_tx_tail = 0;   // start of the chunk DMA is sending
+static volatile int uart1_tx_chunk = 0;  // length of the chunk DMA is sending
+static volatile int uart1_tx_busy = 0;
+
+// Registered with the ringbuffer watch registry like the real rings; the
+// transmit ring never drops (uart1_tx_write blocks instead), so its "drop"
+// counter counts those write stalls - equally invisible and equally bad.
+static volatile unsigned int uart1_tx_max_used = 0;
+static volatile unsigned int uart1_tx_stalls = 0;
+
+static void uart1_dma_tx_init()
+{
+	DMA3CONbits.SIZE = 1;   // byte
+	DMA3CONbits.DIR = 1;    // ram -> peripheral
+	DMA3CONbits.AMODE = 0;  // register indirect with post-increment
+	DMA3CONbits.MODE = 1;   // one-shot, no ping-pong
+	DMA3REQ = 0x000C;       // U1TX
+	DMA3PAD = (volatile unsigned int) &U1TXREG;
+	_DMA3IP = configKERNEL_INTERRUPT_PRIORITY;
+	_DMA3IF = 0;
+	_DMA3IE = 1;
+}
+
+/*
+ *   Starts DMA on the next contiguous chunk of the ring (a wrap is simply
+ *   sent as 2 chunks). Call with the DMA3 interrupt masked or from its ISR.
+ */
+static void uart1_dma_start_chunk()
+{
+	if (uart1_tx_busy || uart1_tx_head == uart1_tx_tail)
+		return;
+
+	if (uart1_tx_head > uart1_tx_tail)
+		uart1_tx_chunk = uart1_tx_head - uart1_tx_tail;
+	else
+		uart1_tx_chunk = UART1_TX_BUFFER_SIZE - uart1_tx_tail;
+
+	DMA3STA = __builtin_dmaoffset(uart1_tx_buffer) + uart1_tx_tail;
+	DMA3CNT = uart1_tx_chunk - 1;
+	uart1_tx_busy = 1;
+	DMA3CONbits.CHEN = 1;
+	DMA3REQbits.FORCE = 1;   // first byte by hand, the rest on U1TX requests
+}
+
+static void uart1_dma_tx_done()
+{
+	uart1_tx_tail += uart1_tx_chunk;
+	if (uart1_tx_tail >= UART1_TX_BUFFER_SIZE)
+		uart1_tx_tail = 0;
+	uart1_tx_busy = 0;
+	uart1_dma_start_chunk();
+}
+
+void __attribute__((__interrupt__, auto_psv)) _DMA3Interrupt( void )
+{
+	ISR_TIME_DECLARE;
+
+	ISR_TIME_ENTER();
+	uart1_dma_tx_done();
+	_DMA3IF = 0;
+	ISR_TIME_EXIT(ISR_TIME_UART1_TX);
+}
+
+static void uart1_tx_write(char c)
+{
+	int next = uart1_tx_head + 1;
+	if (next >= UART1_TX_BUFFER_SIZE)
+		next = 0;
+	if (next == uart1_tx_tail)
+		uart1_tx_stalls++;   // the caller is about to block on a full ring
+	while (next == uart1_tx_tail)   // ring full: wait for DMA to drain a chunk
+	{
+		// When we got here from inside another ISR (the rx overrun
+		// messages), the DMA interrupt cannot preempt us and the ring
+		// would never drain: service the completion by hand.
+		if (_DMA3IF)
+		{
+			_DMA3IE = 0;
+			if (_DMA3IF)
+			{
+				_DMA3IF = 0;
+				uart1_dma_tx_done();
+			}
+			_DMA3IE = 1;
+		}
+	}
+	uart1_tx_buffer[uart1_tx_head] = c;
+	uart1_tx_head = next;
+}
+
+/*
+ *   Kicks the DMA channel when it is idle; the interrupt is masked so the
+ *   completion ISR cannot start the same chunk at the same time.
+ */
+static void uart1_dma_flush()
+{
+	int used = uart1_tx_head - uart1_tx_tail;
+	if (used < 0)
+		used += UART1_TX_BUFFER_SIZE;
+	if ((unsigned int) used > uart1_tx_max_used)
+		uart1_tx_max_used = used;   // once per put call, not per byte
+
+	_DMA3IE = 0;
+	uart1_dma_start_chunk();
+	_DMA3IE = 1;
+}
+#endif // UART1_QUEUE_DMA_TX
 
 void uart1_queue_init(long baud)
 {
+#ifdef UART1_QUEUE_RX_RING
+	ringbuffer_init( &uart1_rx_ring, uart1_rx_buffer, UART1_RX_BUFFER_SIZE );
+	ringbuffer_watch_ring( &uart1_rx_ring, "uart1 rx" );
+	vSemaphoreCreateBinary( xRxSignal );
+	xSemaphoreTake( xRxSignal, ( portTickType ) 0 );   // created in the "given" state
+#else
     xRxedChars = xQueueCreate( 300, ( unsigned portBASE_TYPE ) sizeof( char ) ); // problem in simulation mode if buffer is too small
+    ringbuffer_watch( "uart1 rxq", 300, &uart1_rxq_max, &uart1_rxq_drops );
+#endif
 
 	// configure U2MODE
 	U1MODEbits.UARTEN = 0;	// Bit15 TX, RX DISABLED, ENABLE at end of func
@@ -55,13 +209,109 @@ void uart1_queue_init(long baud)
 
 	U1STAbits.UTXEN = 1;
     _U1RXIP = configKERNEL_INTERRUPT_PRIORITY; // same as freerots?
-}	
+
+#ifdef UART1_QUEUE_DMA_TX
+	uart1_dma_tx_init();
+	ringbuffer_watch( "uart1 tx", UART1_TX_BUFFER_SIZE, &uart1_tx_max_used, &uart1_tx_stalls );
+#endif
+}
+
+
+void uart1_queue_set_baud(long baud)
+{
+#ifdef UART1_QUEUE_DMA_TX
+	while (uart1_tx_busy || uart1_tx_head != uart1_tx_tail)
+		;	// let DMA send what is queued (the ack at the old rate)
+#endif
+	while (! U1STAbits.TRMT)
+		;	// and wait for the shift register to empty out
+
+	U1MODEbits.UARTEN = 0;
+	if (baud > 115200l)
+	{
+		// 16 clocks per bit cannot reach the high rates (921600 would
+		// land 8% off); 4 clocks per bit with a rounded divider stays
+		// within 1.4% all the way up.
+		U1MODEbits.BRGH = 1;
+		U1BRG = (int)((FCY/4 + baud/2) / baud - 1);
+	}
+	else
+	{
+		U1MODEbits.BRGH = 0;
+		U1BRG = (int)(FCY / (16*baud) - 1);
+	}
+	U1MODEbits.UARTEN = 1;
+	U1STAbits.UTXEN = 1;	// cleared by UARTEN, like in init
+}
+
+#ifdef UART1_QUEUE_RX_RING
+
+void __attribute__((__interrupt__, auto_psv)) _U1RXInterrupt( void )
+{
+	char cChar;
+	portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+	int signal = 0;
+	ISR_TIME_DECLARE;
+
+	ISR_TIME_ENTER();
+
+    if (U1STAbits.OERR) // buffer overrun, no way we can receive correct data!
+    {
+        U1STAbits.OERR = 0;
+    }
+
+	while( U1STAbits.URXDA )
+	{
+		cChar = U1RXREG;
+		if (! ringbuffer_put( &uart1_rx_ring, (unsigned char) cChar ))
+		{
+			// ring full: drop the byte and turn the newest stored one into
+			// a newline, so the reader's line parser resynchronizes
+			ringbuffer_replace_last( &uart1_rx_ring, '\n' );
+			signal = 1;
+			continue;
+		}
+		if (cChar == '\n' || cChar == '\r')
+			signal = 1;   // a complete console line is waiting
+	}
+
+	if (ringbuffer_used( &uart1_rx_ring ) >= UART1_RX_HIGH_WATER)
+		signal = 1;
+
+	if (signal)
+		xSemaphoreGiveFromISR( xRxSignal, &xHigherPriorityTaskWoken );
+	IFS0bits.U1RXIF = 0;
+	ISR_TIME_EXIT(ISR_TIME_UART1_RX);
+	// NO YIELDING! We are in an interrupt routine, and parsing input is not urgent anyway
+    if( xHigherPriorityTaskWoken != pdFALSE )
+	{
+		taskYIELD();
+	}
+}
+
+
+int uart1_queue_getc(char *c, unsigned int timeout_ticks)
+{
+	while (! ringbuffer_get( &uart1_rx_ring, (unsigned char *) c ))
+	{
+		// the signal may be stale (given for bytes a previous call already
+		// drained); just wait again in that case
+		if (xSemaphoreTake( xRxSignal, ( portTickType ) timeout_ticks ) == pdFALSE)
+			return 0;
+	}
+	return 1;
+}
+
+#else // UART1_QUEUE_RX_RING
 
 static const char newline = '\n';
 void __attribute__((__interrupt__, auto_psv)) _U1RXInterrupt( void )
 {
 	char cChar;
 	portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+	ISR_TIME_DECLARE;
+
+	ISR_TIME_ENTER();
 
 	/* Get the character and post it on the queue of Rxed characters.
 	If the post causes a task to wake force a context switch as the woken task
@@ -77,9 +327,13 @@ void __attribute__((__interrupt__, auto_psv)) _U1RXInterrupt( void )
 	
 	while( U1STAbits.URXDA )
 	{
+		unsigned int waiting = (unsigned int) uxQueueMessagesWaitingFromISR( xRxedChars );
+		if (waiting > uart1_rxq_max)
+			uart1_rxq_max = waiting;
 		cChar = U1RXREG;
 		if (xQueueSendFromISR( xRxedChars, &cChar, &xHigherPriorityTaskWoken ) == errQUEUE_FULL)  // oh no, the queue is full
         {
+            uart1_rxq_drops++;
             if (xQueueReset(xRxedChars) == pdFALSE)  // empty it to avoid another full queue in the near future
             {
                 uart1_puts("\r\nUnable to reset a blocked queue\r\n");
@@ -91,6 +345,7 @@ void __attribute__((__interrupt__, auto_psv)) _U1RXInterrupt( void )
         }
 	}
 	IFS0bits.U1RXIF = 0;
+	ISR_TIME_EXIT(ISR_TIME_UART1_RX);
 	// NO YIELDING! We are in an interrupt routine, and parsing input is not urgent anyway
     if( xHigherPriorityTaskWoken != pdFALSE )
 	{
@@ -98,6 +353,84 @@ void __attribute__((__interrupt__, auto_psv)) _U1RXInterrupt( void )
 	}
 }
 
+
+int uart1_queue_getc(char *c, unsigned int timeout_ticks)
+{
+	return xQueueReceive( xRxedChars, c, ( portTickType ) timeout_ticks ) == pdTRUE;
+}
+
+#endif // UART1_QUEUE_RX_RING
+
+#ifdef UART1_QUEUE_DMA_TX
+
+void uart1_puts(char *str)
+{
+	while(*str != '\0')
+		uart1_tx_write(*str++);
+	uart1_dma_flush();
+}
+
+void uart1_put(char *str, int len)
+{
+	while(len-- > 0)
+		uart1_tx_write(*str++);
+	uart1_dma_flush();
+}
+
+void uart1_putc(char c)
+{
+	uart1_tx_write(c);
+	uart1_dma_flush();
+}
+
+/*
+ *   Overrides the C library's stdout helper so printf also goes through
+ *   the ring. Otherwise the library would poke U1TXREG directly and its
+ *   output would interleave with a running DMA transfer.
+ */
+int write(int handle, void *buffer, unsigned int len)
+{
+	uart1_put((char*) buffer, (int) len);
+	return len;
+}
+
+
+/*
+ *   printf replacement on the buffered transmit path: formats with the
+ *   small formatter from lib/format and hands the result to uart1_put(),
+ *   so a diagnostic message costs a ring copy instead of a trip through
+ *   the stdio machinery (and keeps that machinery out of the binary
+ *   altogether). The buffer lives on the caller's stack, so concurrent
+ *   callers interleave at worst between messages, exactly like printf
+ *   through the write() hook above did.
+ */
+void uart1_printf(const char *fmt, ...)
+{
+	char buf[160];
+	va_list ap;
+	int n;
+
+	va_start(ap, fmt);
+	n = format_args(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+	uart1_put(buf, n);
+}
+
+/*
+ *   Free space in the transmit ring, in bytes. The telemetry task uses this
+ *   as its byte budget per tick, so it can defer low-priority frames when a
+ *   degraded link keeps the ring from draining.
+ */
+int uart1_tx_free()
+{
+	int used = uart1_tx_head - uart1_tx_tail;
+	if (used < 0)
+		used += UART1_TX_BUFFER_SIZE;
+	return UART1_TX_BUFFER_SIZE - 1 - used;
+}
+
+#else // UART1_QUEUE_DMA_TX
+
 void uart1_puts(char *str)
 {
 	while(*str != '\0')
@@ -124,3 +457,10 @@ void uart1_putc(char c)
 			;
 	U1TXREG = c;
 }
+
+int uart1_tx_free()
+{
+	return 0x7fff;   // the polled path waits per character; there is no ring to fill up
+}
+
+#endif // UART1_QUEUE_DMA_TX
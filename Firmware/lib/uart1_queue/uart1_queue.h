@@ -1,7 +1,39 @@
 
+// When defined, uart1_puts/uart1_put/uart1_putc no longer busy-wait on the
+// 4-deep hardware fifo but copy into a ring buffer in DMA SRAM that DMA
+// channel 3 drains into U1TXREG: one DMA setup per chunk instead of one
+// UTXBF poll per character. Comment out to get the old polled transmit.
+#define UART1_QUEUE_DMA_TX
+
+// When defined, the receive interrupt no longer posts every byte to a
+// FreeRTOS queue (one task wakeup per character) but accumulates into a
+// ring buffer and only signals the reader on a line ending or when the
+// ring passes its high-water mark. Comment out for the per-character queue.
+#define UART1_QUEUE_RX_RING
+
 void uart1_queue_init(long baud);
+
+// Drains the transmitter and reprograms the baud rate generator on the
+// fly; used by the SB console command to lift a bench session (log
+// download, HIL injection, raw streaming) over the 57600 radio default.
+// Rates above 115200 switch to the 4-clocks-per-bit mode so the divider
+// error stays within 1.4%; 921600 is the practical ceiling at 40 MIPS.
+void uart1_queue_set_baud(long baud);
 void uart1_puts(char *str);
 void uart1_putc(char c);
 void uart1_put(char *str, int len);
 
+// printf replacement built on the lib/format formatter and the buffered
+// transmit path; understands the format subset documented in format.h.
+// Keeps stdio out of the binary: nothing in the firmware calls printf.
+void uart1_printf(const char *fmt, ...);
+
+// Free bytes in the transmit path; a large constant in the polled build.
+int uart1_tx_free();
+
+// Blocking read of one received character. Returns 1 when *c was filled,
+// 0 after timeout_ticks without data. Bytes already buffered are returned
+// without touching the scheduler.
+int uart1_queue_getc(char *c, unsigned int timeout_ticks);
+
 
@@ -43,7 +43,8 @@ void uart2_open(long baud)
 	U2STAbits.UTXISEL0 = 0;	//Bit13 Other half of Bit15
 	U2STAbits.UTXBRK = 0;	//Bit11 Disabled
 	U2STAbits.UTXEN = 1;	//Bit10 TX pins controlled by periph
-	U2STAbits.URXISEL = 0;	//Bits6,7 Int. on character recieved
+	U2STAbits.URXISEL = 2;	//Bits6,7 Int. when RX FIFO is 3/4 full; the ISR drains
+				//        the whole FIFO so we get 1 interrupt per 3 chars
 	U2STAbits.ADDEN = 0;	//Bit5 Address Detect Disabled
 
 	IPC7 = 0x4400;	// Mid Range Interrupt Priority level, no urgent reason
@@ -80,6 +81,20 @@ void uart2_puts(char *str)
 		;
 }
 
+//! Blocking write of len bytes; unlike uart2_puts this can carry binary
+//! data with embedded zeroes (dgps corrections, see communication_binary.c).
+void uart2_put(char *buf, int len)
+{
+	while (len-- > 0)
+	{
+		while(U2STAbits.UTXBF)
+			;  /* wait if the buffer is full */
+		U2TXREG = *buf++;   /* transfer data byte to TX reg */
+	}
+	while(U2STAbits.UTXBF)
+		;
+}
+
 void uart2_putc(char c)
 {
 	U2TXREG = c;
@@ -4,4 +4,5 @@ char uart2_dataready();
 char uart2_getc();
 void uart2_puts(char *str);
 void uart2_putc(char c);
+void uart2_put(char *buf, int len);
 
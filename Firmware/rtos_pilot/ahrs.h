@@ -4,5 +4,57 @@
 void ahrs_filter(float dt);
 void ahrs_init();
 
+//! Define AHRS_MAHONY in the build configuration (rtos_pilot.X) to swap
+//! ahrs_simple_quaternion.c for the fixed-point mahony complementary
+//! filter (ahrs_mahony_fixed.c) on quadrocopter/F1E builds.
+
+/*
+ *   Shadow mode: define AHRS_SHADOW in the build configuration
+ *   (rtos_pilot.X) to also compile the *other* kalman implementation -
+ *   ahrs_kalman_2x3_fixed.c beside the float filter, or the float filter
+ *   beside it when AHRS_KALMAN_FIXED_POINT is defined - renamed to the
+ *   ahrs_shadow_* entry points. The sensor task then calls
+ *   ahrs_shadow_step() instead of ahrs_filter(): the primary runs first
+ *   and keeps control authority, the shadow runs on the same sensor
+ *   snapshot with its own attitude state swapped into sensor_data and
+ *   back out. Both per-update cycle counts and the shadow attitude are
+ *   exported here and logged side-by-side in struct LogLine, which is
+ *   what lets us evaluate a filter in flight before trusting it.
+ */
+#ifdef AHRS_SHADOW
+
+#if defined ENABLE_QUADROCOPTER || defined F1E_STEERING
+#error AHRS_SHADOW pairs the two fixed-wing kalman filters and is not available on this target
+#endif
+
+//! The secondary implementation (renamed, see the AHRS_SHADOW blocks in
+//! ahrs_kalman_2x3.c and ahrs_kalman_2x3_fixed.c).
+void ahrs_shadow_init();
+void ahrs_shadow_filter(float dt);
+
+struct AhrsShadow
+{
+	// the shadow filter's view of the attitude state in sensor_data;
+	// parked here between updates so the primary's values stay in place
+	float pitch;
+	float roll;
+	float yaw;
+	float p_bias;
+	float q_bias;
+
+	unsigned long primary_cycles;   //!< last ahrs_filter() call
+	unsigned long shadow_cycles;    //!< last ahrs_shadow_filter() call
+};
+
+extern struct AhrsShadow ahrs_shadow;
+
+//! Call instead of ahrs_init(): initializes both filters.
+void ahrs_shadow_open();
+
+//! Call instead of ahrs_filter(): primary first (timed), then the shadow
+//! on the same snapshot, both cycle counts recorded.
+void ahrs_shadow_step(float dt);
+
+#endif // AHRS_SHADOW
 
 #endif // AHRS_H
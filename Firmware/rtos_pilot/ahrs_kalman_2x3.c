@@ -18,6 +18,15 @@
 #error Please use ahrs_simple_quaternion_c for multicopter use!
 #endif
 
+#if !defined AHRS_KALMAN_FIXED_POINT || defined AHRS_SHADOW  // else ahrs_kalman_2x3_fixed.c supplies the filter
+
+#if defined AHRS_KALMAN_FIXED_POINT && defined AHRS_SHADOW
+// The fixed-point filter owns the primary entry points in this build;
+// this file is compiled as the shadow (see AHRS_SHADOW in ahrs.h).
+#define ahrs_init   ahrs_shadow_init
+#define ahrs_filter ahrs_shadow_filter
+#endif
+
 #include <math.h>
  
 #include "button/button.h"
@@ -28,15 +37,14 @@
 #include "sensors.h"
 #include "configuration.h"
 #include "common.h"
-
-
-static float sin_lookup[182];  // lookup table to avoid sinus calculations
+#include "latency.h"
+#include "warmstart.h"
+#include "fastmath/fastmath.h"
+#include "uart1_queue/uart1_queue.h"
 
 float gravity_to_roll(float a_y, float a_z);
 float gravity_to_pitch(float a_x, float a_z);
 
-inline float fast_sin(float x);
-inline float fast_cos(float x);
 __attribute__((__const__)) int isNaN (float* f) ;
 
 static float pitch_rad = 0.0, roll_rad = 0.0;
@@ -46,21 +54,28 @@ float roll_rad_sum_error = 0.0;
 
 void ahrs_init()
 {
-	float x;
-	int i;
-	
-	for (x=(-3.14159f), i = 0; i < 181; x+=(2.0f/180.0f*3.14159f), i++)
+	float warm_roll, warm_pitch;
+
+	fastmath_init();   // the filter runs on the table sine/cosine (lib/fastmath)
+
+	if (warmstart_attitude(&warm_roll, &warm_pitch, &sensor_data.p_bias, &sensor_data.q_bias))
 	{
-		sin_lookup[i] = sinf(x);
-	}	
-	
-	// initialize our attitude with the current accelerometer's data
-	//printf("-> %f %f %f <-\r\n", sensor_data.acc_x, sensor_data.acc_y, sensor_data.acc_z);
-    pitch_rad = gravity_to_pitch(sensor_data.acc_x, sensor_data.acc_z);
-    roll_rad = gravity_to_roll(sensor_data.acc_y, sensor_data.acc_z);
-    
-    sensor_data.p_bias = 0.0f;
-	sensor_data.q_bias = 0.0f;
+		// mid-flight reset: resume from the attitude the filter had ~100ms
+		// ago. The accelerometers may be reading centripetal acceleration
+		// right now, and the bias states took tens of seconds to converge.
+		roll_rad = warm_roll;
+		pitch_rad = warm_pitch + config.sensors.neutral_pitch;
+	}
+	else
+	{
+		// initialize our attitude with the current accelerometer's data
+		//uart1_printf("-> %f %f %f <-\r\n", sensor_data.acc_x, sensor_data.acc_y, sensor_data.acc_z);
+		pitch_rad = gravity_to_pitch(sensor_data.acc_x, sensor_data.acc_z);
+		roll_rad = gravity_to_roll(sensor_data.acc_y, sensor_data.acc_z);
+
+		sensor_data.p_bias = 0.0f;
+		sensor_data.q_bias = 0.0f;
+	}
 
     sensor_data.pitch = pitch_rad - config.sensors.neutral_pitch;
 	sensor_data.roll = roll_rad;
@@ -130,34 +145,139 @@ void normalize_pitch_roll()
     }
 }
 
+// Pipelined schedule: the cheap gyro prediction runs every cycle, so the
+// control loop always consumes an attitude no older than one sample; the
+// covariance propagation and accelerometer correction - nearly all of the
+// filter's floating point - run once per AHRS_CORRECT_DIVIDER cycles on
+// the dt accumulated in between.
+#define AHRS_CORRECT_DIVIDER 4
+
+static int i = 0;
+static float sin_roll = 0.0;
+static float cos_roll = 1.0;
+static float sin_pitch = 0.0;
+static float cos_pitch = 1.0;
+static float tan_pitch = 0.0;
+static float df_dx[4] = {0.0, 0.0, 0.0, 0.0};
+static float P[4] = {1.0, 0.0, 0.0, 1.0};
+static float tmp1[9];
+static float tmp2[9];
+static float dh_dx_3x2[6];
+static float L[6];
+static float dt_correct = 0.0;   // dt accumulated towards the next correction slot
+
+static void ahrs_predict(float dt);
+static void ahrs_correct(float dt_cov);
+
+
 void ahrs_filter(float dt)
 {
-	static int i = 0;
-	static float sin_roll=0.0;
-	static float cos_roll=1.0;
-	static float sin_pitch=0.0;
-	static float cos_pitch=1.0;
-	static float tan_pitch=0.0;
-	static float df_dx[4] = {0.0, 0.0, 0.0, 0.0};
-	static float P[4] = {1.0, 0.0, 0.0, 1.0};
-	static float tmp1[9];
-	static float tmp2[9];
-	static float dh_dx_3x2[6];
-	static float L[6];
-
-
-	/*if (button_down())
+	ahrs_predict(dt);
+
+	dt_correct += dt;
+	if (i++ % AHRS_CORRECT_DIVIDER == 1)
 	{
-		printf("down\r\n");
-	}*/
-				
-	/* optimization: comment this: */
-	/*sin_roll = sin(roll_rad);
-    cos_roll = cos(roll_rad);
-    sin_pitch = sin(pitch_rad);
-    cos_pitch = cos(pitch_rad);
-    tan_pitch = tan(pitch_rad);*/
-    
+		ahrs_correct(dt_correct);
+		dt_correct = 0.0f;
+	}
+	else if (i % 25 == 0) // outer loop at 2Hz
+	{
+		// change bias with a max of 0.1°/s per second, update me, to 2°/s/minute
+		// on the bench the accelerometer corrections are trustworthy, so let
+		// the bias move 5x faster: this is what shortens boot-to-armable time
+		float max_step = sensor_data.stationary ? DEG2RAD(0.25f) : DEG2RAD(0.05f);
+		sensor_data.p_bias -= BIND(roll_rad_sum_error/10.0f, -max_step, max_step);
+		sensor_data.q_bias -= BIND(pitch_rad_sum_error/10.0f, -max_step, max_step);
+		//uart1_printf("\r\n %f \r\n", (roll_rad_sum_error/20.0));
+		roll_rad_sum_error = 0.0f;
+		pitch_rad_sum_error = 0.0f;
+	}
+#if defined F1E_STEERING || defined ENABLE_QUADROCOPTER
+// Blend weights for the tilt-compensated magnetometer heading. The F1E snaps
+// onto the compass quickly; the quadrocopter's yaw hold flies on this estimate,
+// so it only gets nudged incrementally and never steps.
+#ifdef ENABLE_QUADROCOPTER
+#define MAG_BLEND_LEVEL   0.05
+#define MAG_BLEND_TILTED  0.02
+#else
+#define MAG_BLEND_LEVEL   0.5
+#define MAG_BLEND_TILTED  0.1
+#endif
+	if (i % 5 == 0)
+	{
+		float mx = ((float)sensor_data.magnetometer_raw.x.i16);
+		float my = ((float)sensor_data.magnetometer_raw.y.i16);
+		float mz = ((float)sensor_data.magnetometer_raw.z.i16);
+
+		float YH =                my*cos_roll           - mz*sin_roll;
+		float XH = mx*cos_pitch + my*sin_roll*sin_pitch + mz*cos_roll*sin_pitch;
+
+        
+        float magneto_yaw = fast_atan2 (-YH, XH);
+        
+        if (magneto_yaw >= DEG2RAD(360.0))
+				magneto_yaw -= DEG2RAD(360.0);
+        else if (magneto_yaw < DEG2RAD(0.0))
+            magneto_yaw += DEG2RAD(360.0);
+
+        if (fabs(sensor_data.pitch) > DEG2RAD(30.0) || fabs(sensor_data.roll) > DEG2RAD(30.0))
+        {
+            // keep gyroscope sensor_data.yaw
+        }
+        else if (fabs(sensor_data.pitch) > DEG2RAD(5.0) || fabs(sensor_data.roll) > DEG2RAD(5.0))
+        {
+            if (magneto_yaw > DEG2RAD(250.0) && sensor_data.yaw < DEG2RAD(50.0))
+                sensor_data.yaw = (magneto_yaw - DEG2RAD(360.0)) * MAG_BLEND_TILTED + sensor_data.yaw * (1.0 - MAG_BLEND_TILTED);
+            else if (sensor_data.yaw > DEG2RAD(250.0) && magneto_yaw < DEG2RAD(50.0))
+                sensor_data.yaw = (magneto_yaw) * MAG_BLEND_TILTED + (sensor_data.yaw  - DEG2RAD(360.0)) * (1.0 - MAG_BLEND_TILTED);
+            else
+                sensor_data.yaw = (magneto_yaw) * MAG_BLEND_TILTED + (sensor_data.yaw) * (1.0 - MAG_BLEND_TILTED);
+        }
+        else
+        {
+            if (magneto_yaw > DEG2RAD(250.0) && sensor_data.yaw < DEG2RAD(50.0))
+                sensor_data.yaw = (magneto_yaw - DEG2RAD(360.0)) * MAG_BLEND_LEVEL + sensor_data.yaw * (1.0 - MAG_BLEND_LEVEL);
+            else if (sensor_data.yaw > DEG2RAD(250.0) && magneto_yaw < DEG2RAD(50.0))
+                sensor_data.yaw = (magneto_yaw) * MAG_BLEND_LEVEL + (sensor_data.yaw  - DEG2RAD(360.0)) * (1.0 - MAG_BLEND_LEVEL);
+            else
+                sensor_data.yaw = (magneto_yaw) * MAG_BLEND_LEVEL + (sensor_data.yaw) * (1.0 - MAG_BLEND_LEVEL);
+        }
+
+		if (sensor_data.yaw >= DEG2RAD(360.0))
+				sensor_data.yaw -= DEG2RAD(360.0);
+        else if (sensor_data.yaw < DEG2RAD(0.0))
+            sensor_data.yaw += DEG2RAD(360.0);
+
+		//sensor_data.yaw /= 2.0f;
+
+        /*if (i  % 25 == 0)
+        {
+            int heading = sensor_data.yaw/3.14*180.0;
+            if (heading < 0)
+                heading += 360;
+            uart1_printf("\r\nCompass: %d\r\n", heading);
+        }*/
+
+		/*uart1_printf("\r\n%5d %5d %5d -> %f\r\n",sensor_data.magnetometer_raw.x.i16,
+							sensor_data.magnetometer_raw.y.i16,
+							sensor_data.magnetometer_raw.z.i16, 
+							sensor_data.yaw*180.0/3.14159);*/
+	}	
+#endif	
+	sensor_data.pitch = pitch_rad - config.sensors.neutral_pitch;
+	sensor_data.roll = roll_rad;
+
+	latency_mark_ahrs();   // attitude is out; sample-to-ahrs latency ends here
+}
+
+
+/*!
+ *   Gyro integration at full sensor rate: attitude and yaw track the rates
+ *   every cycle, and the linearization terms the correction slot needs are
+ *   refreshed here.
+ */
+static void ahrs_predict(float dt)
+{
     // correction from outer loop
 	sensor_data.p -= sensor_data.p_bias;
 	sensor_data.q -= sensor_data.q_bias;
@@ -175,7 +295,7 @@ void ahrs_filter(float dt)
     sin_pitch = fast_sin(pitch_rad);
     cos_pitch = fast_cos(pitch_rad);
 
-    if (fabs(cos_pitch) < 0.02f)  // to avoid /0 and very large values. Here we will assume the values cant be larger than +-89�
+    if (fabs(cos_pitch) < 0.02f)  // to avoid /0 and very large values. Here we will assume the values cant be larger than +-89°
     {
         if (cos_pitch < 0.0f)
             cos_pitch = -0.02f;
@@ -185,8 +305,26 @@ void ahrs_filter(float dt)
     }
     //else
     	tan_pitch = sin_pitch / cos_pitch; //tan(pitch_rad);
-    
-    
+
+	// yaw used to advance only on correction cycles (with dt*2); at full
+	// rate it also keeps tracking through degraded-accelerometer episodes
+	if (fabs(pitch_rad) < DEG2RAD(89.0f)) // to overcome secans +-inf
+	{
+		sensor_data.yaw += (sin_roll * sensor_data.q / cos_pitch + cos_roll * sensor_data.r / cos_pitch) * dt;  // try to calculate yaw approx.
+		if (sensor_data.yaw >= DEG2RAD(360.0))
+			sensor_data.yaw -= DEG2RAD(360.0);
+		else if (sensor_data.yaw < DEG2RAD(0.0))
+			sensor_data.yaw += DEG2RAD(360.0);
+	}
+}
+
+
+/*!
+ *   Covariance propagation and accelerometer correction, once per
+ *   AHRS_CORRECT_DIVIDER cycles; dt_cov covers the cycles in between.
+ */
+static void ahrs_correct(float dt_cov)
+{
     df_dx[0] = (sensor_data.q*cos_roll - sensor_data.r*sin_roll) * tan_pitch;
     df_dx[1] = (sensor_data.q*sin_roll - sensor_data.r*cos_roll)/(cos_pitch*cos_pitch);
     df_dx[2] = -sensor_data.q*sin_roll - sensor_data.r*cos_roll;
@@ -194,7 +332,7 @@ void ahrs_filter(float dt)
 
 	//    A = df_dx;
     //    P = P + dt * (A*P + P*A' + Q);
-    
+
     /* optimize me: P is symmectric: P[1] = P[2] */
     matrix_2x2_mul(df_dx, P, tmp1);   // A * P = tmp1
     matrix_2x2_mul_transp(P, df_dx, tmp2);  //  P * A' = tmp2
@@ -202,15 +340,19 @@ void ahrs_filter(float dt)
     tmp2[1] += tmp1[1];
     //tmp2[2] += tmp1[2];
     tmp2[3] += 0.04f + tmp1[3];    // Q(2) = 0.02 for pitch, because the accelerometer is undergoing more non-compensated accelerations (at take-off for example)
-    P[0] += tmp2[0] * dt;
-    P[1] += tmp2[1] * dt;
-    //P[2] += tmp2[2] * dt;
+    P[0] += tmp2[0] * dt_cov;
+    P[1] += tmp2[1] * dt_cov;
+    //P[2] += tmp2[2] * dt_cov;
     P[2] = P[1];
-    P[3] += tmp2[3] * dt;
-    
+    P[3] += tmp2[3] * dt_cov;
+
     ////////////////////////////////
     
-    if (i++ % 2 == 0 &&    // only apply every other iteration
+    // 0 while the accelerometers saturate or disagree with 1g: fly on the
+    // gyros alone and ease the corrections back in afterwards
+    int acc_gain = sensors_acc_confidence();
+
+    if (acc_gain > 0 &&
         fabs(sensor_data.acc_x) < 1.0f)   // only apply when the acceleration along the x-axis is not too large (take-off!)
     {
 	    //dh_dx = [q(i)/G*w_droll                        cos_pitch + q(i)*w_dpitch/G;...
@@ -310,6 +452,12 @@ void ahrs_filter(float dt)
 		tmp2[0] = L[0] * tmp1[0] + L[1] * tmp1[1] +  L[2] * tmp1[2];  // roll "error"
 		tmp2[1] = L[3] * tmp1[0] + L[4] * tmp1[1] +  L[5] * tmp1[2];  // pitch "error"
 		
+		if (acc_gain < 256)   // staged re-entry after a degraded episode
+		{
+			tmp2[0] = tmp2[0] * (float)acc_gain / 256.0f;
+			tmp2[1] = tmp2[1] * (float)acc_gain / 256.0f;
+		}
+		
 	    roll_rad = roll_rad + tmp2[0];
 	    pitch_rad = pitch_rad + tmp2[1];
 	    
@@ -318,17 +466,11 @@ void ahrs_filter(float dt)
 		    roll_rad_sum_error += tmp2[0];
 			pitch_rad_sum_error += tmp2[1];
 		}
-		
 		if (fabs(pitch_rad) < DEG2RAD(89.0f)) // to overcome secans +-inf
 		{
-			sensor_data.yaw += (sin_roll * sensor_data.q / cos_pitch + cos_roll * sensor_data.r / cos_pitch) * dt*2 ;  // try to calculate yaw approx.
-			if (sensor_data.yaw >= DEG2RAD(360.0))
-				sensor_data.yaw -= DEG2RAD(360.0);
-			else if (sensor_data.yaw < DEG2RAD(0.0))
-				sensor_data.yaw += DEG2RAD(360.0);
-#ifndef F1E_STEERING
-			if (fabs(sensor_data.yaw - sensor_data.gps.heading_rad) < DEG2RAD(250.0) && sensor_data.gps.satellites_in_view > 5)  // do not change if e.g. yaw = 355� and heading = 2�
-				sensor_data.yaw = sensor_data.yaw*0.99 + sensor_data.gps.heading_rad*0.01;
+#if !defined F1E_STEERING && !defined ENABLE_QUADROCOPTER   // quadrocopter yaw is corrected from the magnetometer below; GPS course is meaningless at hover
+			if (fabs(sensor_data.yaw - sensor_data.gps.heading_rad) < DEG2RAD(250.0) && sensor_data.gps.satellites_in_view > 5)  // do not change if e.g. yaw = 355° and heading = 2°
+				sensor_data.yaw = sensor_data.yaw*0.98 + sensor_data.gps.heading_rad*0.02;   // 2x the old per-event blend: this slot runs at 1/4 rate, not 1/2
 #endif
 		}
 
@@ -336,101 +478,7 @@ void ahrs_filter(float dt)
         normalize(pitch_rad, roll_rad, sensor_data.yaw);
         normalize_pitch_roll();
     }
-	else if (i % 25 == 0) // outer loop at 2Hz
-	{
-		// change bias with a max of 0.1�/s per second, update me, to 2�/s/minute
-		sensor_data.p_bias -= BIND(roll_rad_sum_error/10.0f, DEG2RAD(-0.05f), DEG2RAD(0.05f));
-		sensor_data.q_bias -= BIND(pitch_rad_sum_error/10.0f, DEG2RAD(-0.05f), DEG2RAD(0.05f));
-		//printf("\r\n %f \r\n", (roll_rad_sum_error/20.0));
-		roll_rad_sum_error = 0.0f;
-		pitch_rad_sum_error = 0.0f;
-	}
-#ifdef F1E_STEERING
-	if (i % 5 == 0)
-	{
-		float mx = ((float)sensor_data.magnetometer_raw.x.i16);
-		float my = ((float)sensor_data.magnetometer_raw.y.i16);
-		float mz = ((float)sensor_data.magnetometer_raw.z.i16);
-
-		float YH =                my*cos_roll           - mz*sin_roll;
-		float XH = mx*cos_pitch + my*sin_roll*sin_pitch + mz*cos_roll*sin_pitch;
-
-        
-        float magneto_yaw = atan2f (-YH, XH);
-        
-        if (magneto_yaw >= DEG2RAD(360.0))
-				magneto_yaw -= DEG2RAD(360.0);
-        else if (magneto_yaw < DEG2RAD(0.0))
-            magneto_yaw += DEG2RAD(360.0);
-
-        if (fabs(sensor_data.pitch) > DEG2RAD(30.0) || fabs(sensor_data.roll) > DEG2RAD(30.0))
-        {
-            // keep gyroscope sensor_data.yaw
-        }
-        else if (fabs(sensor_data.pitch) > DEG2RAD(5.0) || fabs(sensor_data.roll) > DEG2RAD(5.0))
-        {
-            if (magneto_yaw > DEG2RAD(250.0) && sensor_data.yaw < DEG2RAD(50.0))
-                sensor_data.yaw = (magneto_yaw - DEG2RAD(360.0)) * 0.1 + sensor_data.yaw * 0.9;
-            else if (sensor_data.yaw > DEG2RAD(250.0) && magneto_yaw < DEG2RAD(50.0))
-                sensor_data.yaw = (magneto_yaw) * 0.1 + (sensor_data.yaw  - DEG2RAD(360.0)) * 0.9;
-            else
-                sensor_data.yaw = (magneto_yaw) * 0.1 + (sensor_data.yaw) * 0.9;
-        }
-        else
-        {
-            if (magneto_yaw > DEG2RAD(250.0) && sensor_data.yaw < DEG2RAD(50.0))
-                sensor_data.yaw = (magneto_yaw - DEG2RAD(360.0)) * 0.5 + sensor_data.yaw * 0.5;
-            else if (sensor_data.yaw > DEG2RAD(250.0) && magneto_yaw < DEG2RAD(50.0))
-                sensor_data.yaw = (magneto_yaw) * 0.5 + (sensor_data.yaw  - DEG2RAD(360.0)) * 0.5;
-            else
-                sensor_data.yaw = (magneto_yaw) * 0.5 + (sensor_data.yaw) * 0.5;
-        }
-
-		if (sensor_data.yaw >= DEG2RAD(360.0))
-				sensor_data.yaw -= DEG2RAD(360.0);
-        else if (sensor_data.yaw < DEG2RAD(0.0))
-            sensor_data.yaw += DEG2RAD(360.0);
-
-		//sensor_data.yaw /= 2.0f;
-
-        /*if (i  % 25 == 0)
-        {
-            int heading = sensor_data.yaw/3.14*180.0;
-            if (heading < 0)
-                heading += 360;
-            printf("\r\nCompass: %d\r\n", heading);
-        }*/
-
-		/*printf("\r\n%5d %5d %5d -> %f\r\n",sensor_data.magnetometer_raw.x.i16,
-							sensor_data.magnetometer_raw.y.i16,
-							sensor_data.magnetometer_raw.z.i16, 
-							sensor_data.yaw*180.0/3.14159);*/
-	}	
-#endif	
-   
-    /*int p = (int)pitch_rad;   
-    if (p == -1 || (int)roll_rad == -1)   // we have a NaN -> ALERT
-    {
-		// reset everything
-		pitch_rad = 0.0;
-		roll_rad = 0.0;
-		sin_roll = 0.0;
-		cos_roll = 1.0;
-		sin_pitch = 0.0;
-		cos_pitch = 1.0;
-		tan_pitch = 0.0;
-		P[0] = 1.0;
-		P[1] = 0.0;
-		P[2] = 0.0;
-		P[3] = 1.0;
-		//printf("\r\n!\r\n");
-	}*/
-   
-    
-	//normalize(pitch_rad, roll_rad, sensor_data.yaw);
-   	sensor_data.pitch = pitch_rad - config.sensors.neutral_pitch;
-	sensor_data.roll = roll_rad;
-}	
+}
 
 
 __attribute__((__const__)) int isNaN (float* f)
@@ -475,28 +523,4 @@ float gravity_to_pitch(float a_x, float a_z)
 }
 
 
-inline float fast_sin(float x)
-{
-	// -180..180 -> -60..60
-	//int i = (int)(x/(2.0f/(180.0f/3.14159f))) + (180/2);
-
-
-    // improve rounding
-	int i = (int)(x/0.034906585f) + 90;  // 0 = -180.. 180=+180
-
-    if (i < 0 || i > 180)
-        printf("\r\nSIN error: %d\r\n",(int) RAD2DEG(x));
-    if (i > 180)
-        i -= 180;
-    else if (i < 0)
-        i += 180;
-	return sin_lookup[i];
-}	
-inline float fast_cos(float x)
-{
-	// -180..180 -> 270..-90
-    double a = DEG2RAD(90.0f) - x;
-    if (a > DEG2RAD(180.0f))
-        a -= DEG2RAD(360.0f);
-	return fast_sin(a);
-}	
+#endif // !AHRS_KALMAN_FIXED_POINT || AHRS_SHADOW
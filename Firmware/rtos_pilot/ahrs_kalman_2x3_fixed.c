@@ -0,0 +1,499 @@
+/*!
+ *  Fixed-point (Q16.16) version of the 2x3 kalman attitude filter.
+ *
+ *  Same filter as ahrs_kalman_2x3.c (x = [roll pitch], y = [acc_x acc_y acc_z]),
+ *  but all hot-path arithmetic runs in Q16.16 so the dsPIC's hardware multiplier
+ *  is used instead of the software float library. A 32x32 multiply compiles to a
+ *  handfull of mul.uu/mul.ss instructions (~20 cycles) where a float multiply
+ *  costs well over 100, which is the headroom we need to push the inner loop
+ *  beyond 250Hz.
+ *
+ *  Define AHRS_KALMAN_FIXED_POINT in the build configuration (rtos_pilot.X) to
+ *  select this implementation; without it ahrs_kalman_2x3.c is compiled as before.
+ *
+ *  See http://www.gluonpilot.com/wiki/Matlab_attitude_estimation
+ *
+ *  @file     ahrs_kalman_2x3_fixed.c
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ */
+
+#if defined AHRS_KALMAN_FIXED_POINT || defined AHRS_SHADOW
+
+#ifndef AHRS_KALMAN_FIXED_POINT
+// The float filter owns the primary entry points in this build; this
+// file is compiled as the shadow (see AHRS_SHADOW in ahrs.h).
+#define ahrs_init   ahrs_shadow_init
+#define ahrs_filter ahrs_shadow_filter
+#endif
+
+#ifdef ENABLE_QUADROCOPTER
+#error Please use ahrs_simple_quaternion_c for multicopter use!
+#endif
+#ifdef F1E_STEERING
+#error The fixed-point kalman filter does not support F1E steering (magnetometer path); use ahrs_kalman_2x3.c
+#endif
+
+#include <math.h>
+
+#include "uart1_queue/uart1_queue.h"
+
+#include "sensors.h"
+#include "configuration.h"
+#include "warmstart.h"
+#include "common.h"
+#include "latency.h"
+
+
+/***************************** Q16.16 primitives *****************************/
+
+// moved to the shared fixed-point library; fxp, FXP()/FLOAT2FXP and
+// fxp_mul/fxp_div/fxp_sqrt all come from there unchanged
+#include "fixmath/fixmath.h"
+
+
+/************************* Q16.16 matrix kernels ****************************/
+/* Mirrors of the macros in matrix/matrix.h; plain '*' would overflow, so   */
+/* these go through fxp_mul.                                                */
+
+static void fxp_matrix_2x2_mul(fxp *A, fxp *B, fxp *R)
+{
+	R[0] = fxp_mul(A[0], B[0]) + fxp_mul(A[1], B[2]);
+	R[1] = fxp_mul(A[0], B[1]) + fxp_mul(A[1], B[3]);
+	R[2] = fxp_mul(A[2], B[0]) + fxp_mul(A[3], B[2]);
+	R[3] = fxp_mul(A[2], B[1]) + fxp_mul(A[3], B[3]);
+}
+
+static void fxp_matrix_2x2_mul_transp(fxp *A, fxp *B, fxp *R)
+{
+	R[0] = fxp_mul(A[0], B[0]) + fxp_mul(A[1], B[1]);
+	R[1] = fxp_mul(A[0], B[2]) + fxp_mul(A[1], B[3]);
+	R[2] = fxp_mul(A[2], B[0]) + fxp_mul(A[3], B[1]);
+	R[3] = fxp_mul(A[2], B[2]) + fxp_mul(A[3], B[3]);
+}
+
+static void fxp_matrix_3x2_times_2x2(fxp *A, fxp *B, fxp *R)
+{
+	R[0] = fxp_mul(A[0], B[0]) + fxp_mul(A[1], B[2]);
+	R[1] = fxp_mul(A[0], B[1]) + fxp_mul(A[1], B[3]);
+	R[2] = fxp_mul(A[2], B[0]) + fxp_mul(A[3], B[2]);
+	R[3] = fxp_mul(A[2], B[1]) + fxp_mul(A[3], B[3]);
+	R[4] = fxp_mul(A[4], B[0]) + fxp_mul(A[5], B[2]);
+	R[5] = fxp_mul(A[4], B[1]) + fxp_mul(A[5], B[3]);
+}
+
+static void fxp_matrix_3x2_times_3x2_transp(fxp *A, fxp *B, fxp *R)
+{
+	R[0] = fxp_mul(A[0], B[0]) + fxp_mul(A[1], B[1]);
+	R[1] = fxp_mul(A[0], B[2]) + fxp_mul(A[1], B[3]);
+	R[2] = fxp_mul(A[0], B[4]) + fxp_mul(A[1], B[5]);
+	R[3] = fxp_mul(A[2], B[0]) + fxp_mul(A[3], B[1]);
+	R[4] = fxp_mul(A[2], B[2]) + fxp_mul(A[3], B[3]);
+	R[5] = fxp_mul(A[2], B[4]) + fxp_mul(A[3], B[5]);
+	R[6] = fxp_mul(A[4], B[0]) + fxp_mul(A[5], B[1]);
+	R[7] = fxp_mul(A[4], B[2]) + fxp_mul(A[5], B[3]);
+	R[8] = fxp_mul(A[4], B[4]) + fxp_mul(A[5], B[5]);
+}
+
+static void fxp_matrix_2x2_times_3x2_transp(fxp *A, fxp *B, fxp *R)
+{
+	R[0] = fxp_mul(A[0], B[0]) + fxp_mul(A[1], B[1]);
+	R[1] = fxp_mul(A[0], B[2]) + fxp_mul(A[1], B[3]);
+	R[2] = fxp_mul(A[0], B[4]) + fxp_mul(A[1], B[5]);
+	R[3] = fxp_mul(A[2], B[0]) + fxp_mul(A[3], B[1]);
+	R[4] = fxp_mul(A[2], B[2]) + fxp_mul(A[3], B[3]);
+	R[5] = fxp_mul(A[2], B[4]) + fxp_mul(A[3], B[5]);
+}
+
+static void fxp_matrix_2x3_times_3x3(fxp *A, fxp *B, fxp *R)
+{
+	R[0] = fxp_mul(A[0], B[0]) + fxp_mul(A[1], B[3]) + fxp_mul(A[2], B[6]);
+	R[1] = fxp_mul(A[0], B[1]) + fxp_mul(A[1], B[4]) + fxp_mul(A[2], B[7]);
+	R[2] = fxp_mul(A[0], B[2]) + fxp_mul(A[1], B[5]) + fxp_mul(A[2], B[8]);
+	R[3] = fxp_mul(A[3], B[0]) + fxp_mul(A[4], B[3]) + fxp_mul(A[5], B[6]);
+	R[4] = fxp_mul(A[3], B[1]) + fxp_mul(A[4], B[4]) + fxp_mul(A[5], B[7]);
+	R[5] = fxp_mul(A[3], B[2]) + fxp_mul(A[4], B[5]) + fxp_mul(A[5], B[8]);
+}
+
+static void fxp_matrix_2x3_times_3x2(fxp *A, fxp *B, fxp *R)
+{
+	R[0] = fxp_mul(A[0], B[0]) + fxp_mul(A[1], B[2]) + fxp_mul(A[2], B[4]);
+	R[1] = fxp_mul(A[0], B[1]) + fxp_mul(A[1], B[3]) + fxp_mul(A[2], B[5]);
+	R[2] = fxp_mul(A[3], B[0]) + fxp_mul(A[4], B[2]) + fxp_mul(A[5], B[4]);
+	R[3] = fxp_mul(A[3], B[1]) + fxp_mul(A[4], B[3]) + fxp_mul(A[5], B[5]);
+}
+
+/*!
+ *   Invert a 3x3 matrix whose diagonal is dominated by the measurement noise
+ *   (entries up to ~40). The matrix is pre-scaled by 1/64 so the determinant
+ *   (three-factor product) stays inside the Q16.16 range: inv(M) = inv(M/64)/64.
+ */
+static void fxp_invert_3x3(fxp *m, fxp *r)
+{
+	fxp s[9];
+	fxp det, inv_det;
+	int i;
+
+	for (i = 0; i < 9; i++)
+		s[i] = m[i] >> 6;
+
+	det  = fxp_mul(s[0], fxp_mul(s[4], s[8]) - fxp_mul(s[5], s[7]));
+	det -= fxp_mul(s[1], fxp_mul(s[3], s[8]) - fxp_mul(s[5], s[6]));
+	det += fxp_mul(s[2], fxp_mul(s[3], s[7]) - fxp_mul(s[4], s[6]));
+
+	if (det == 0)  // same guard as the float version's fabs(d) < 0.01
+	{
+		uart1_puts("\r\n!!\r\n"); // debug output to let us know
+		det = 1;   // smallest representable: effectively the 9999 clamp
+	}
+	inv_det = fxp_div(FXP_ONE, det);
+
+	r[0] = fxp_mul(inv_det, fxp_mul(s[4], s[8]) - fxp_mul(s[5], s[7])) >> 6;
+	r[3] = fxp_mul(inv_det, fxp_mul(s[5], s[6]) - fxp_mul(s[3], s[8])) >> 6;
+	r[6] = fxp_mul(inv_det, fxp_mul(s[3], s[7]) - fxp_mul(s[4], s[6])) >> 6;
+
+	r[1] = fxp_mul(inv_det, fxp_mul(s[2], s[7]) - fxp_mul(s[1], s[8])) >> 6;
+	r[4] = fxp_mul(inv_det, fxp_mul(s[0], s[8]) - fxp_mul(s[2], s[6])) >> 6;
+	r[7] = fxp_mul(inv_det, fxp_mul(s[1], s[6]) - fxp_mul(s[0], s[7])) >> 6;
+
+	r[2] = fxp_mul(inv_det, fxp_mul(s[1], s[5]) - fxp_mul(s[2], s[4])) >> 6;
+	r[5] = fxp_mul(inv_det, fxp_mul(s[2], s[3]) - fxp_mul(s[0], s[5])) >> 6;
+	r[8] = fxp_mul(inv_det, fxp_mul(s[0], s[4]) - fxp_mul(s[1], s[3])) >> 6;
+}
+
+
+/******************************* trig tables ********************************/
+
+#define FXP_PI       FXP(3.14159265)
+#define FXP_TWO_PI   FXP(6.28318531)
+#define FXP_HALF_PI  FXP(1.57079633)
+#define FXP_DEG(x)   FXP((x) * (3.14159265 / 180.0))
+
+static fxp sin_lookup_fx[182];  // same 2 degree grid as the float filter
+
+static fxp fast_sin_fx(fxp x)
+{
+	int i = (int)(x / FXP(0.034906585)) + 90;  // 0 = -180 .. 180 = +180
+
+	if (i > 180)
+		i -= 180;
+	else if (i < 0)
+		i += 180;
+	return sin_lookup_fx[i];
+}
+
+static fxp fast_cos_fx(fxp x)
+{
+	fxp a = FXP_HALF_PI - x;
+	if (a > FXP_PI)
+		a -= FXP_TWO_PI;
+	return fast_sin_fx(a);
+}
+
+
+/******************************* filter state *******************************/
+
+static fxp pitch_fx = 0, roll_fx = 0;
+static fxp pitch_sum_error_fx = 0;
+static fxp roll_sum_error_fx = 0;
+static fxp p_bias_fx = 0, q_bias_fx = 0;
+
+static float gravity_to_roll(float a_y, float a_z);
+static float gravity_to_pitch(float a_x, float a_z);
+
+
+void ahrs_init()
+{
+	float x;
+	float warm_roll, warm_pitch;
+	int i;
+
+	for (x = (-3.14159f), i = 0; i < 181; x += (2.0f/180.0f*3.14159f), i++)
+	{
+		sin_lookup_fx[i] = FLOAT2FXP(sinf(x));  // float is fine at init time
+	}
+
+	if (warmstart_attitude(&warm_roll, &warm_pitch, &sensor_data.p_bias, &sensor_data.q_bias))
+	{
+		// mid-flight reset: resume from the attitude the filter had ~100ms
+		// ago. The accelerometers may be reading centripetal acceleration
+		// right now, and the bias states took tens of seconds to converge.
+		roll_fx = FLOAT2FXP(warm_roll);
+		pitch_fx = FLOAT2FXP(warm_pitch + config.sensors.neutral_pitch);
+		p_bias_fx = FLOAT2FXP(sensor_data.p_bias);
+		q_bias_fx = FLOAT2FXP(sensor_data.q_bias);
+	}
+	else
+	{
+		// initialize our attitude with the current accelerometer's data
+		pitch_fx = FLOAT2FXP(gravity_to_pitch(sensor_data.acc_x, sensor_data.acc_z));
+		roll_fx = FLOAT2FXP(gravity_to_roll(sensor_data.acc_y, sensor_data.acc_z));
+
+		p_bias_fx = 0;
+		q_bias_fx = 0;
+		sensor_data.p_bias = 0.0f;
+		sensor_data.q_bias = 0.0f;
+	}
+
+	sensor_data.pitch = FXP2FLOAT(pitch_fx) - config.sensors.neutral_pitch;
+	sensor_data.roll = FXP2FLOAT(roll_fx);
+}
+
+
+static void normalize_pitch_roll_fx()
+{
+	if (pitch_fx > FXP_PI)
+		pitch_fx -= FXP_TWO_PI;
+	else if (pitch_fx < -FXP_PI)
+		pitch_fx += FXP_TWO_PI;
+
+	if (roll_fx > FXP_PI)
+		roll_fx -= FXP_TWO_PI;
+	else if (roll_fx < -FXP_PI)
+		roll_fx += FXP_TWO_PI;
+}
+
+// pitch = (-90,90]; roll = (-180,180]
+static void normalize_fx()
+{
+	if (pitch_fx > FXP_HALF_PI)
+	{
+		pitch_fx = FXP_PI - pitch_fx;
+		roll_fx += FXP_PI;
+		sensor_data.yaw += 3.14159f;
+	}
+	if (pitch_fx < -FXP_HALF_PI)
+	{
+		pitch_fx = -FXP_PI - pitch_fx;
+		roll_fx += FXP_PI;
+		sensor_data.yaw += 3.14159f;
+	}
+	if (roll_fx > FXP_PI)
+		roll_fx -= FXP_TWO_PI;
+	if (roll_fx < -FXP_PI)
+		roll_fx += FXP_TWO_PI;
+}
+
+
+void ahrs_filter(float dt)
+{
+	static int i = 0;
+	static fxp sin_roll = 0;
+	static fxp cos_roll = FXP_ONE;
+	static fxp sin_pitch = 0;
+	static fxp cos_pitch = FXP_ONE;
+	static fxp tan_pitch = 0;
+	static fxp df_dx[4] = {0, 0, 0, 0};
+	static fxp P[4] = {FXP_ONE, 0, 0, FXP_ONE};
+	static fxp tmp1[9];
+	static fxp tmp2[9];
+	static fxp dh_dx_3x2[6];
+	static fxp L[6];
+
+	fxp dt_fx = FLOAT2FXP(dt);
+	fxp p = FLOAT2FXP(sensor_data.p);
+	fxp q = FLOAT2FXP(sensor_data.q);
+	fxp r = FLOAT2FXP(sensor_data.r);
+
+	// correction from outer loop
+	p -= p_bias_fx;
+	q -= q_bias_fx;
+
+	roll_fx += fxp_mul(dt_fx, p + fxp_mul(fxp_mul(q, sin_roll) + fxp_mul(r, cos_roll), tan_pitch));
+	pitch_fx += fxp_mul(dt_fx, fxp_mul(q, cos_roll) - fxp_mul(r, sin_roll));
+
+	normalize_pitch_roll_fx();
+	normalize_fx();
+	normalize_pitch_roll_fx();
+
+	sin_roll = fast_sin_fx(roll_fx);
+	cos_roll = fast_cos_fx(roll_fx);
+	sin_pitch = fast_sin_fx(pitch_fx);
+	cos_pitch = fast_cos_fx(pitch_fx);
+
+	if (cos_pitch < FXP(0.02) && cos_pitch > FXP(-0.02))  // to avoid /0, assume +-89 degree max
+	{
+		if (cos_pitch < 0)
+			cos_pitch = FXP(-0.02);
+		else
+			cos_pitch = FXP(0.02);
+	}
+	tan_pitch = fxp_div(sin_pitch, cos_pitch);
+
+	df_dx[0] = fxp_mul(fxp_mul(q, cos_roll) - fxp_mul(r, sin_roll), tan_pitch);
+	df_dx[1] = fxp_div(fxp_mul(q, sin_roll) - fxp_mul(r, cos_roll), fxp_mul(cos_pitch, cos_pitch));
+	df_dx[2] = -fxp_mul(q, sin_roll) - fxp_mul(r, cos_roll);
+	//df_dx[3] = 0;
+
+	//    A = df_dx;
+	//    P = P + dt * (A*P + P*A' + Q);
+	fxp_matrix_2x2_mul(df_dx, P, tmp1);          // A * P = tmp1
+	fxp_matrix_2x2_mul_transp(P, df_dx, tmp2);   // P * A' = tmp2
+	tmp2[0] += FXP(0.1) + tmp1[0];    // Q(1) = 0.1 for roll
+	tmp2[1] += tmp1[1];
+	tmp2[3] += FXP(0.04) + tmp1[3];   // Q(2) for pitch, see the float version for the reasoning
+	P[0] += fxp_mul(tmp2[0], dt_fx);
+	P[1] += fxp_mul(tmp2[1], dt_fx);
+	P[2] = P[1];   // P is symmetric
+	P[3] += fxp_mul(tmp2[3], dt_fx);
+
+	////////////////////////////////
+
+	// 0 while the accelerometers saturate or disagree with 1g: fly on the
+	// gyros alone and ease the corrections back in afterwards
+	int acc_gain = sensors_acc_confidence();
+
+	if (i++ % 2 == 0 &&    // only apply every other iteration
+	    acc_gain > 0 &&
+	    fabs(sensor_data.acc_x) < 1.0f)   // only apply when the acceleration along the x-axis is not too large (take-off!)
+	{
+		fxp acc_x = FLOAT2FXP(sensor_data.acc_x);
+		fxp acc_y = FLOAT2FXP(sensor_data.acc_y);
+		fxp acc_z = FLOAT2FXP(sensor_data.acc_z);
+		fxp speed = FLOAT2FXP(sensor_data.gps.speed_ms);
+		fxp dh = FLOAT2FXP(-sensor_data.vertical_speed);
+		fxp inv_g = FXP(1.0 / 9.81);
+
+		/* Without dh (see the float version): */
+		fxp u = fxp_sqrt(fxp_mul(speed, speed) + fxp_mul(dh, dh));
+		fxp w = fxp_mul(dh, fxp_mul(cos_pitch, cos_roll));
+
+		// w_droll = u_dpitch = w_dpitch = 0, so dh_dx reduces to:
+		dh_dx_3x2[0] = 0;
+		dh_dx_3x2[1] = cos_pitch;
+		dh_dx_3x2[2] = -fxp_mul(cos_pitch, cos_roll);
+		dh_dx_3x2[3] = fxp_mul(sin_roll, sin_pitch);
+		dh_dx_3x2[4] = fxp_mul(sin_roll, cos_pitch);
+		dh_dx_3x2[5] = fxp_mul(cos_roll, sin_pitch);
+
+		/*
+		C = dh_dx;  %C:3x2   P:2x2
+		L = P*C'*(R + C*P*C')^-1;  % 2x3
+		P = (eye(2,2) - L*C)*P;
+		*/
+		fxp_matrix_3x2_times_2x2(dh_dx_3x2, P, tmp1);          // C * P = tmp1
+		fxp_matrix_3x2_times_3x2_transp(tmp1, dh_dx_3x2, tmp2); // tmp1 * C' = tmp2
+
+		tmp2[0] += FXP(40.0);   // x-axis = forward acceleration (not compensated), so less thrustworthy
+		tmp2[4] += FXP(30.0);
+		tmp2[8] += FXP(35.0);   // z-axis = vertical acceleration (not compensated)
+
+		fxp_invert_3x3(tmp2, tmp1);   // result = tmp1
+
+		// P * C'  [2x3] = tmp2
+		fxp_matrix_2x2_times_3x2_transp(P, dh_dx_3x2, tmp2);
+
+		// L = tmp2 * tmp1   [2x3]
+		fxp_matrix_2x3_times_3x3(tmp2, tmp1, L);
+
+		// P = (eye(2,2) - L*C)*P;
+		fxp_matrix_2x3_times_3x2(L, dh_dx_3x2, tmp1);
+		tmp2[0] = FXP_ONE - tmp1[0];
+		tmp2[1] = -tmp1[1];
+		tmp2[2] = -tmp1[2];
+		tmp2[3] = FXP_ONE - tmp1[3];
+		fxp_matrix_2x2_mul(tmp2, P, tmp1);
+		P[0] = tmp1[0];
+		P[1] = tmp1[1];
+		P[2] = tmp1[2];
+		P[3] = tmp1[3];
+
+		/*
+		h = [q(i)*w/G + sin_pitch; ...
+		     (r(i)*u - p(i)*w )/G - cos_pitch*sin_roll; ...
+		     (p(i)*w - q(i)*u)/G  - cos_pitch*cos_roll];
+		*/
+		tmp1[0] = acc_x - (fxp_mul(fxp_mul(q, w), inv_g) + sin_pitch);
+		tmp1[1] = acc_y - (fxp_mul(fxp_mul(r, u) - fxp_mul(p, w), inv_g) - fxp_mul(cos_pitch, sin_roll));
+		tmp1[2] = acc_z - (fxp_mul(fxp_mul(p, w) - fxp_mul(q, u), inv_g) - fxp_mul(cos_pitch, cos_roll));
+
+		// x = x + L*([a_x(i);a_y(i);a_z(i)] - h);
+		tmp2[0] = fxp_mul(L[0], tmp1[0]) + fxp_mul(L[1], tmp1[1]) + fxp_mul(L[2], tmp1[2]);  // roll "error"
+		tmp2[1] = fxp_mul(L[3], tmp1[0]) + fxp_mul(L[4], tmp1[1]) + fxp_mul(L[5], tmp1[2]);  // pitch "error"
+
+		if (acc_gain < 256)   // staged re-entry after a degraded episode
+		{
+			tmp2[0] = (fxp)(((long long)tmp2[0] * acc_gain) >> 8);
+			tmp2[1] = (fxp)(((long long)tmp2[1] * acc_gain) >> 8);
+		}
+
+		roll_fx += tmp2[0];
+		pitch_fx += tmp2[1];
+
+		if (roll_fx < FXP_DEG(55.0) && roll_fx > FXP_DEG(-55.0) &&
+		    pitch_fx < FXP_DEG(55.0) && pitch_fx > FXP_DEG(-55.0))
+		{
+			roll_sum_error_fx += tmp2[0];
+			pitch_sum_error_fx += tmp2[1];
+		}
+
+		if (pitch_fx < FXP_DEG(89.0) && pitch_fx > FXP_DEG(-89.0)) // to overcome secans +-inf
+		{
+			fxp yaw_fx = FLOAT2FXP(sensor_data.yaw);
+			yaw_fx += fxp_mul(fxp_div(fxp_mul(sin_roll, q) + fxp_mul(cos_roll, r), cos_pitch), dt_fx * 2);
+			if (yaw_fx >= FXP_TWO_PI)
+				yaw_fx -= FXP_TWO_PI;
+			else if (yaw_fx < 0)
+				yaw_fx += FXP_TWO_PI;
+			sensor_data.yaw = FXP2FLOAT(yaw_fx);
+			if (fabs(sensor_data.yaw - sensor_data.gps.heading_rad) < DEG2RAD(250.0) && sensor_data.gps.satellites_in_view > 5)  // do not change if e.g. yaw = 355 degree and heading = 2 degree
+				sensor_data.yaw = sensor_data.yaw*0.99 + sensor_data.gps.heading_rad*0.01;
+		}
+
+		normalize_pitch_roll_fx();
+		normalize_fx();
+		normalize_pitch_roll_fx();
+	}
+	else if (i % 25 == 0) // outer loop at 2Hz
+	{
+		// change bias with a max of 0.1 degree/s per second
+		p_bias_fx -= BIND(roll_sum_error_fx / 10, FXP_DEG(-0.05), FXP_DEG(0.05));
+		q_bias_fx -= BIND(pitch_sum_error_fx / 10, FXP_DEG(-0.05), FXP_DEG(0.05));
+		roll_sum_error_fx = 0;
+		pitch_sum_error_fx = 0;
+		sensor_data.p_bias = FXP2FLOAT(p_bias_fx);  // telemetry only
+		sensor_data.q_bias = FXP2FLOAT(q_bias_fx);
+	}
+
+	sensor_data.pitch = FXP2FLOAT(pitch_fx) - config.sensors.neutral_pitch;
+	sensor_data.roll = FXP2FLOAT(roll_fx);
+
+	latency_mark_ahrs();   // attitude is out; sample-to-ahrs latency ends here
+}
+
+
+/*!
+ *   Calculates roll using accelerometer input (init time only, so float is ok).
+ *
+ *   Makes sure the output is similar to the quaternion's output.
+ */
+static float gravity_to_roll(float a_y, float a_z)
+{
+	float roll_acc = atan(a_y / a_z);
+	if (a_z > 0.0f)
+	{
+		if (a_y < 0.0f)
+			roll_acc = roll_acc + 3.14159f;
+		else
+			roll_acc = roll_acc - 3.14159f;
+	}
+	return roll_acc;
+}
+
+
+/*!
+ *   Calculates pitch using accelerometer input (init time only, so float is ok).
+ *
+ *   Makes sure the output is similar to the quaternion's output.
+ */
+static float gravity_to_pitch(float a_x, float a_z)
+{
+	float pitch_acc = -atan(a_x / a_z);
+
+	if (a_z > 0.0f)
+		pitch_acc = -pitch_acc;
+
+	return pitch_acc;
+}
+
+#endif // AHRS_KALMAN_FIXED_POINT || AHRS_SHADOW
@@ -0,0 +1,226 @@
+/*!
+ *  Mahony-style complementary attitude filter, fixed-point (Q16.16).
+ *
+ *  Third AHRS implementation, aimed at the multicopter inner loop: a
+ *  copter hovers near 1g nearly all the time, so steering the attitude
+ *  quaternion towards the accelerometer's gravity direction with a
+ *  proportional term plus a slow integral term (which doubles as the gyro
+ *  bias estimate) tracks just as well as the kalman's covariance math at
+ *  roughly a third of the per-cycle cost. All hot-path arithmetic is
+ *  Q16.16 (see ahrs_kalman_2x3_fixed.c for the cycle count reasoning);
+ *  only the euler extraction for sensor_data goes through the float
+ *  fast_atan2 path. Yaw is gyro integration from the magnetometer's
+ *  initial heading, as in the quaternion filter this replaces.
+ *
+ *  Define AHRS_MAHONY in the build configuration (rtos_pilot.X) to select
+ *  this implementation; without it ahrs_simple_quaternion.c is compiled
+ *  as before.
+ *
+ *  @file     ahrs_mahony_fixed.c
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#ifdef AHRS_MAHONY
+
+#ifndef ENABLE_QUADROCOPTER
+	#ifndef F1E_STEERING
+		#error The mahony filter targets the multicopter/F1E loop; use ahrs_kalman_2x3.c for fixed wing aircraft use!
+	#endif
+#endif
+
+#include <math.h>
+
+#include "button/button.h"
+#include "quaternion/quaternion.h"
+#include "fastmath/fastmath.h"
+
+#include "sensors.h"
+#include "common.h"
+#include "latency.h"
+
+
+/***************************** Q16.16 primitives *****************************/
+
+// moved to the shared fixed-point library; fxp, FXP()/FLOAT2FXP and
+// fxp_mul/fxp_div/fxp_sqrt all come from there unchanged
+#include "fixmath/fixmath.h"
+
+
+/******************************* filter state *******************************/
+
+// proportional gain towards the accelerometer's gravity direction, and the
+// integral gain that turns the standing part of that error into a bias
+#define MAHONY_KP  FXP(2.0)
+#define MAHONY_KI  FXP(0.02)
+
+// integral clamp: at 250Hz this allows ~0.2 rad/s of estimated gyro bias,
+// well beyond anything a warmed-up gyro produces
+#define MAHONY_SUM_MAX  FXP(2500.0)
+
+static fxp q0 = FXP_ONE, q1 = 0, q2 = 0, q3 = 0;
+
+// plain sums of the error vector; Ki and dt are applied where the sums are
+// used, because e*Ki*dt per step would vanish below the Q16.16 resolution
+static fxp ex_sum = 0, ey_sum = 0, ez_sum = 0;
+
+static void mahony_reset_from_sensors();
+
+
+void ahrs_init()
+{
+	fastmath_init();   // quaternion_to_roll/yaw run on fast_atan2 (lib/fastmath)
+
+	mahony_reset_from_sensors();
+
+	ex_sum = 0;
+	ey_sum = 0;
+	ez_sum = 0;
+	sensor_data.p_bias = 0.0f;
+	sensor_data.q_bias = 0.0f;
+}
+
+
+/*!
+ *   Levels the quaternion from the current accelerometer reading and the
+ *   magnetometer's heading. Init/reset time only, so float is fine.
+ */
+static void mahony_reset_from_sensors()
+{
+	float fq[4];
+	float roll_acc = atanf(sensor_data.acc_y / sensor_data.acc_z);
+	float pitch_acc = -atanf(sensor_data.acc_x / sensor_data.acc_z);
+	float yaw;
+
+	if (sensor_data.acc_z > 0.0f)   // same quadrant fixes as gravity_to_roll/pitch
+	{
+		pitch_acc = -pitch_acc;
+		if (sensor_data.acc_y < 0.0f)
+			roll_acc += 3.14159f;
+		else
+			roll_acc -= 3.14159f;
+	}
+
+	hmc5843_read(&sensor_data.magnetometer_raw);
+	yaw = atan2f(-(float)sensor_data.magnetometer_raw.y.i16,
+	              (float)sensor_data.magnetometer_raw.x.i16);
+
+	quaternion_from_attitude(roll_acc, pitch_acc, yaw, fq);
+	q0 = FLOAT2FXP(fq[0]);
+	q1 = FLOAT2FXP(fq[1]);
+	q2 = FLOAT2FXP(fq[2]);
+	q3 = FLOAT2FXP(fq[3]);
+}
+
+
+void ahrs_filter(float dt)
+{
+	fxp dt_fx = FLOAT2FXP(dt);
+	fxp halfdt = dt_fx >> 1;
+	fxp p = FLOAT2FXP(sensor_data.p);
+	fxp q = FLOAT2FXP(sensor_data.q);
+	fxp r = FLOAT2FXP(sensor_data.r);
+	fxp dq0, dq1, dq2, dq3;
+	fxp norm_err;
+	float fq[4];
+
+	if (button_down())
+	{
+		mahony_reset_from_sensors();
+		ex_sum = 0;
+		ey_sum = 0;
+		ez_sum = 0;
+	}
+
+	// 0 while the accelerometers saturate or disagree with 1g: fly on the
+	// gyros alone and ease the corrections back in afterwards
+	int acc_gain = sensors_acc_confidence();
+
+	if (acc_gain > 0)
+	{
+		fxp ax = FLOAT2FXP(sensor_data.acc_x);
+		fxp ay = FLOAT2FXP(sensor_data.acc_y);
+		fxp az = FLOAT2FXP(sensor_data.acc_z);
+		fxp vx, vy, vz, ex, ey, ez, inv_norm;
+		fxp bias_p, bias_q, bias_r;
+
+		// measured "down" is -acc, normalized (at rest acc_z reads -1g)
+		inv_norm = fxp_div(FXP_ONE, fxp_sqrt(fxp_mul(ax, ax) + fxp_mul(ay, ay) + fxp_mul(az, az)));
+		ax = -fxp_mul(ax, inv_norm);
+		ay = -fxp_mul(ay, inv_norm);
+		az = -fxp_mul(az, inv_norm);
+
+		// predicted "down" = third row of the rotation matrix
+		vx = (fxp_mul(q1, q3) - fxp_mul(q0, q2)) << 1;
+		vy = (fxp_mul(q0, q1) + fxp_mul(q2, q3)) << 1;
+		vz = FXP_ONE - ((fxp_mul(q1, q1) + fxp_mul(q2, q2)) << 1);
+
+		// e = a x v: the small rotation that carries the prediction onto the
+		// measurement; all factors are unit vectors so nothing can overflow
+		ex = fxp_mul(ay, vz) - fxp_mul(az, vy);
+		ey = fxp_mul(az, vx) - fxp_mul(ax, vz);
+		ez = fxp_mul(ax, vy) - fxp_mul(ay, vx);
+
+		if (acc_gain < 256)   // staged re-entry after a degraded episode
+		{
+			ex = (fxp)(((long long)ex * acc_gain) >> 8);
+			ey = (fxp)(((long long)ey * acc_gain) >> 8);
+			ez = (fxp)(((long long)ez * acc_gain) >> 8);
+		}
+
+		ex_sum = BIND(ex_sum + ex, -MAHONY_SUM_MAX, MAHONY_SUM_MAX);
+		ey_sum = BIND(ey_sum + ey, -MAHONY_SUM_MAX, MAHONY_SUM_MAX);
+		ez_sum = BIND(ez_sum + ez, -MAHONY_SUM_MAX, MAHONY_SUM_MAX);
+
+		// Ki first (the sum is large), dt last
+		bias_p = fxp_mul(fxp_mul(MAHONY_KI, ex_sum), dt_fx);
+		bias_q = fxp_mul(fxp_mul(MAHONY_KI, ey_sum), dt_fx);
+		bias_r = fxp_mul(fxp_mul(MAHONY_KI, ez_sum), dt_fx);
+
+		p += fxp_mul(MAHONY_KP, ex) + bias_p;
+		q += fxp_mul(MAHONY_KP, ey) + bias_q;
+		r += fxp_mul(MAHONY_KP, ez) + bias_r;
+
+		// telemetry only; the sign follows the kalman filters' "subtracted
+		// from the rate" convention
+		sensor_data.p_bias = -FXP2FLOAT(bias_p);
+		sensor_data.q_bias = -FXP2FLOAT(bias_q);
+
+		// accel view of the attitude, for the log (see struct LogLine);
+		// ax/ay/az hold the measured down direction here
+		sensor_data.roll_acc = fast_atan2(FXP2FLOAT(ay), FXP2FLOAT(az));
+		sensor_data.pitch_acc = fast_atan2(FXP2FLOAT(-ax), fabsf(FXP2FLOAT(az)));
+	}
+
+	// same form as quaternion_update_with_rates(); the small factor dt/2 is
+	// multiplied in last so its truncation hits each component only once
+	dq0 = -fxp_mul(q1, p) - fxp_mul(q2, q) - fxp_mul(q3, r);
+	dq1 =  fxp_mul(q0, p) + fxp_mul(q2, r) - fxp_mul(q3, q);
+	dq2 =  fxp_mul(q0, q) - fxp_mul(q1, r) + fxp_mul(q3, p);
+	dq3 =  fxp_mul(q0, r) + fxp_mul(q1, q) - fxp_mul(q2, p);
+	q0 += fxp_mul(dq0, halfdt);
+	q1 += fxp_mul(dq1, halfdt);
+	q2 += fxp_mul(dq2, halfdt);
+	q3 += fxp_mul(dq3, halfdt);
+
+	// first order renormalization: |q| never strays far from 1 in one step,
+	// so (1 - |q|^2) / 2 replaces the square root and divides
+	norm_err = (FXP_ONE - (fxp_mul(q0, q0) + fxp_mul(q1, q1) + fxp_mul(q2, q2) + fxp_mul(q3, q3))) >> 1;
+	q0 += fxp_mul(q0, norm_err);
+	q1 += fxp_mul(q1, norm_err);
+	q2 += fxp_mul(q2, norm_err);
+	q3 += fxp_mul(q3, norm_err);
+
+	fq[0] = FXP2FLOAT(q0);
+	fq[1] = FXP2FLOAT(q1);
+	fq[2] = FXP2FLOAT(q2);
+	fq[3] = FXP2FLOAT(q3);
+	sensor_data.roll = quaternion_to_roll(fq);
+	sensor_data.pitch = quaternion_to_pitch(fq);
+	sensor_data.yaw = quaternion_to_yaw(fq);
+
+	latency_mark_ahrs();   // attitude is out; sample-to-ahrs latency ends here
+}
+
+#endif // AHRS_MAHONY
@@ -0,0 +1,87 @@
+/*!
+ *  Shadow-mode AHRS runner, see the AHRS_SHADOW section in ahrs.h.
+ *
+ *  Both kalman filters keep part of their state in sensor_data (the float
+ *  filter reads its own yaw and biases back between updates), so the
+ *  shadow cannot simply run after the primary: its view of those fields
+ *  is parked in ahrs_shadow between updates and swapped in around its
+ *  call. One known asymmetry remains: the gyro rates were debiased with
+ *  the primary's bias estimate before either filter runs, so the shadow
+ *  sees the primary's bias correction on its inputs. For comparing
+ *  attitude tracking and cycle cost that bias coupling is acceptable;
+ *  promoting a filter still means flying it as the primary afterwards.
+ *
+ *  @file     ahrs_shadow.c
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#ifdef AHRS_SHADOW
+
+#include "timer/timer.h"
+
+#include "sensors.h"
+#include "ahrs.h"
+
+
+struct AhrsShadow ahrs_shadow;
+
+
+void ahrs_shadow_open()
+{
+	ahrs_init();
+	ahrs_shadow_init();
+
+	// both inits leave their estimate in sensor_data; the primary ran
+	// first, so seed the shadow's parked view from what the shadow wrote
+	// and put the primary's values back by re-running its init
+	ahrs_shadow.pitch = sensor_data.pitch;
+	ahrs_shadow.roll = sensor_data.roll;
+	ahrs_shadow.yaw = sensor_data.yaw;
+	ahrs_shadow.p_bias = sensor_data.p_bias;
+	ahrs_shadow.q_bias = sensor_data.q_bias;
+	ahrs_init();
+}
+
+
+void ahrs_shadow_step(float dt)
+{
+	float pitch, roll, yaw, p_bias, q_bias;
+	unsigned long t;
+
+	t = timer_ticks_32();
+	ahrs_filter(dt);
+	ahrs_shadow.primary_cycles = timer_ticks_32() - t;
+
+	// park the primary's outputs and swap the shadow's view in
+	pitch = sensor_data.pitch;
+	roll = sensor_data.roll;
+	yaw = sensor_data.yaw;
+	p_bias = sensor_data.p_bias;
+	q_bias = sensor_data.q_bias;
+	sensor_data.pitch = ahrs_shadow.pitch;
+	sensor_data.roll = ahrs_shadow.roll;
+	sensor_data.yaw = ahrs_shadow.yaw;
+	sensor_data.p_bias = ahrs_shadow.p_bias;
+	sensor_data.q_bias = ahrs_shadow.q_bias;
+
+	t = timer_ticks_32();
+	ahrs_shadow_filter(dt);
+	ahrs_shadow.shadow_cycles = timer_ticks_32() - t;
+
+	ahrs_shadow.pitch = sensor_data.pitch;
+	ahrs_shadow.roll = sensor_data.roll;
+	ahrs_shadow.yaw = sensor_data.yaw;
+	ahrs_shadow.p_bias = sensor_data.p_bias;
+	ahrs_shadow.q_bias = sensor_data.q_bias;
+
+	// the primary keeps control authority
+	sensor_data.pitch = pitch;
+	sensor_data.roll = roll;
+	sensor_data.yaw = yaw;
+	sensor_data.p_bias = p_bias;
+	sensor_data.q_bias = q_bias;
+}
+
+#endif // AHRS_SHADOW
@@ -16,6 +16,9 @@
 	#endif
 #endif
 
+// AHRS_MAHONY (see ahrs.h) swaps this file for ahrs_mahony_fixed.c
+#ifndef AHRS_MAHONY
+
 #include <math.h>
 #include <stdio.h>
 
@@ -23,9 +26,11 @@
 #include "matrix/matrix.h"
 #include "pid/pid.h"
 #include "quaternion/quaternion.h"
+#include "fastmath/fastmath.h"
 
 #include "sensors.h"
 #include "configuration.h"
+#include "uart1_queue/uart1_queue.h"
 
 
 // Usefull constants
@@ -49,6 +54,8 @@ inline float gravity_to_pitch(float a_x, float a_z);
 
 void ahrs_init()
 {
+	fastmath_init();   // quaternion_to_roll/yaw run on fast_atan2 (lib/fastmath)
+
 	// I is 10 to 100 times smaller than P
 	pid_init(&pid_p_bias, 0.0, 0.6, /*0.00001*/ 0.001, -100.0, 100.0, 0.0);
 	pid_init(&pid_q_bias, 0.0, 0.6, /*0.00001*/ 0.001, -100.0, 100.0, 0.0);
@@ -174,7 +181,7 @@ void ahrs_filter2()
         int heading = sensor_data.yaw/3.14*180.0;
         if (heading < 0)
             heading += 360;
-		printf("\r\nCompass: %d\r\n", heading);
+		uart1_printf("\r\nCompass: %d\r\n", heading);
     }
 }
 
@@ -218,11 +225,11 @@ void ahrs_filter(float dt)
 		     
 		int abs_roll = (int)fabs(roll_rad*RAD2DEG);
 		int abs_pitch = (int)fabs(pitch_rad*RAD2DEG);
-		if (abs_pitch < 75 || abs_pitch > 105)  		// don't trust accelerometer pitch when roll is around +-90�
+		if (abs_pitch < 75 || abs_pitch > 105)  		// don't trust accelerometer pitch when roll is around +-90�
 		{
 			double roll_error = (roll_acc - roll_rad);
 			
-			// tricky behaviour when acc is +175� and gyro one is -175�
+			// tricky behaviour when acc is +175� and gyro one is -175�
 			if (roll_error > (250.0/RAD2DEG))
 				roll_error -= 2.0 * 3.14159;
 			else if (roll_error < (-250.0f/RAD2DEG))
@@ -232,7 +239,7 @@ void ahrs_filter(float dt)
 		}	
 		
 		double pitch_error;
-		if (abs_roll < (75) || abs_roll > (105)) // don't trust accelerometer roll when pitch is around +-90�
+		if (abs_roll < (75) || abs_roll > (105)) // don't trust accelerometer roll when pitch is around +-90�
 		{
 			pitch_error = (pitch_acc - pitch_rad);
 			q_bias =  pid_update_only_p_and_i(&pid_q_bias, pitch_error, dt);
@@ -279,3 +286,5 @@ inline float gravity_to_pitch(float a_x, float a_z)
 
 	return pitch_acc;
 }
+
+#endif // !AHRS_MAHONY
@@ -0,0 +1,113 @@
+/*!
+ *  2-state altitude filter: x = [altitude vertical_speed].
+ *
+ *  Prediction integrates the earth-frame vertical acceleration at the
+ *  sensor loop rate; every barometer sample corrects both states through
+ *  fixed steady-state gains. Two MACs per step either way - a fraction
+ *  of what widening the attitude kalman with an altitude state would
+ *  cost, and it gives the altitude hold the clean derivative signal the
+ *  differentiated pressure never was.
+ *
+ *  State and integration run in Q16.16, the same convention as
+ *  ahrs_kalman_2x3_fixed.c; float inputs are converted at the boundary.
+ *
+ *  @file     altitude_filter.c
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#include "fastmath/fastmath.h"
+
+#include "sensors.h"
+#include "configuration.h"
+#include "common.h"
+#include "altitude_filter.h"
+
+typedef long fxp;   // Q16.16: 1 sign bit, 15 integer bits, 16 fractional bits
+
+#define FXP(x)        ((fxp)((x) * 65536.0))
+#define FLOAT2FXP(x)  ((fxp)((x) * 65536.0f))
+#define FXP2FLOAT(x)  ((float)(x) / 65536.0f)
+
+static inline fxp fxp_mul(fxp a, fxp b)
+{
+	return (fxp)(((long long)a * b) >> 16);
+}
+
+//! Steady-state correction gains per barometer sample. Tuned for the
+//! 9-10Hz pressure sensors; at the bmp085's slower cadence they converge
+//! a bit slower but stay well damped.
+#define ALT_GAIN_H  FXP(0.15)
+#define ALT_GAIN_V  FXP(0.08)
+
+static fxp altitude_fx = 0;
+static fxp vspeed_fx = 0;
+static int altitude_filter_ready = 0;   // first baro sample seeds the state
+
+
+static void altitude_filter_publish()
+{
+	sensor_data.pressure_height = FXP2FLOAT(altitude_fx);
+	sensor_data.vertical_speed = FXP2FLOAT(vspeed_fx);
+}
+
+
+void altitude_filter_predict(float dt)
+{
+	float sin_pitch, cos_pitch, sin_roll, cos_roll, f_down, a_up;
+	fxp dt_fx;
+
+	if (! altitude_filter_ready)
+		return;
+
+	// Earth-frame specific force along down, from the body measurements:
+	// at rest this reads -1g, so a_up = -(f_down + 1) * G. The attitude
+	// comes from the AHRS this same loop; the board mounting offset has
+	// to go back in because the accelerometers sit on the board.
+	sin_pitch = fast_sin(sensor_data.pitch + config.sensors.neutral_pitch);
+	cos_pitch = fast_cos(sensor_data.pitch + config.sensors.neutral_pitch);
+	sin_roll = fast_sin(sensor_data.roll);
+	cos_roll = fast_cos(sensor_data.roll);
+
+	f_down = -sin_pitch * sensor_data.acc_x
+	         + sin_roll * cos_pitch * sensor_data.acc_y
+	         + cos_roll * cos_pitch * sensor_data.acc_z;
+	a_up = -(f_down + 1.0f) * G;
+
+	dt_fx = FLOAT2FXP(dt);
+	vspeed_fx += fxp_mul(FLOAT2FXP(a_up), dt_fx);
+	altitude_fx += fxp_mul(vspeed_fx, dt_fx);
+
+	// accelerometer bias integrates between corrections; keep it sane
+	if (vspeed_fx > FXP(20.0))
+		vspeed_fx = FXP(20.0);
+	else if (vspeed_fx < FXP(-20.0))
+		vspeed_fx = FXP(-20.0);
+
+	altitude_filter_publish();
+}
+
+
+void altitude_filter_correct(float baro_height)
+{
+	fxp residual;
+
+	if (baro_height < -30000.0f || baro_height > 30000.0f)   // sometimes we get bad readings ~ -31000
+		return;
+
+	if (! altitude_filter_ready)
+	{
+		altitude_fx = FLOAT2FXP(baro_height);
+		vspeed_fx = 0;
+		altitude_filter_ready = 1;
+		altitude_filter_publish();
+		return;
+	}
+
+	residual = FLOAT2FXP(baro_height) - altitude_fx;
+	altitude_fx += fxp_mul(ALT_GAIN_H, residual);
+	vspeed_fx += fxp_mul(ALT_GAIN_V, residual);
+
+	altitude_filter_publish();
+}
@@ -0,0 +1,31 @@
+/*!
+ *  2-state altitude filter: x = [altitude vertical_speed].
+ *
+ *  Fuses the barometric height with the earth-frame vertical acceleration
+ *  derived from the accelerometers and the AHRS attitude. Replaces the
+ *  old differentiated-pressure vertical speed, which was noisy and lagged
+ *  enough to make the altitude hold oscillate in thermals.
+ *
+ *  The results are published into sensor_data.pressure_height and
+ *  sensor_data.vertical_speed, so every consumer (altitude hold, AHRS
+ *  centripetal terms, OSD climb indicator) picks them up unchanged.
+ *
+ *  @file     altitude_filter.h
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#ifndef ALTITUDE_FILTER_H
+#define ALTITUDE_FILTER_H
+
+//! Integrates the vertical acceleration over dt. Call from the sensor
+//! task once per loop, after ahrs_filter() published the attitude.
+//! A no-op until the first barometer sample initialized the state.
+void altitude_filter_predict(float dt);
+
+//! Feeds one new barometer height into the filter; call it wherever a
+//! pressure conversion finishes (2..10Hz depending on the board).
+void altitude_filter_correct(float baro_height);
+
+#endif // ALTITUDE_FILTER_H
@@ -0,0 +1,164 @@
+/*!
+ *  Blackbox: post-mortem dump for traps and stack overflows.
+ *
+ *  The dump is captured in two steps. A trap handler cannot safely drive
+ *  the dataflash: the SPI bus may be halfway through a logger transfer and
+ *  the RTOS primitives guarding it are unusable from a trap. So the handler
+ *  only fills a persistent RAM struct (the .pbss trick from warmstart.c)
+ *  and resets; blackbox_check() on the next boot writes it to the reserved
+ *  BLACKBOX_PAGE. The flash copy survives power cycles, so the dump of a
+ *  crash in the field is still there when the module reaches the bench.
+ *
+ *  @file     blackbox.c
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS/FreeRTOS.h"
+#include "FreeRTOS/task.h"
+
+#include "microcontroller/microcontroller.h"
+#include "dataflash/dataflash.h"
+
+#include "sensors.h"
+#include "gluonscript.h"
+#include "blackbox.h"
+#include "uart1_queue/uart1_queue.h"
+
+
+//! One crash, compactly. Fits a dataflash page with lots of room to spare.
+struct BlackboxDump
+{
+	unsigned int magic;       //!< BLACKBOX_MAGIC while the dump is live
+	char reason[4];           //!< "SO" = stack overflow, else the trap code from microcontroller.c
+	char task_name[8];        //!< task name (stack overflow path only)
+	int task_tag;             //!< 1..8, see the vTaskSetApplicationTaskTag calls
+	unsigned long pc;         //!< trapped program counter (0 for a stack overflow)
+	unsigned int stack_free;  //!< high-water mark of the running task, in words
+	unsigned long tick;       //!< RTOS tick at the moment of the crash
+	float roll;               //!< last published flight state
+	float pitch;
+	float p, q, r;
+	float pressure_height;
+	float latitude_rad;
+	float longitude_rad;
+	int codeline;             //!< active gluonscript codeline
+	unsigned int checksum;
+};
+
+#define BLACKBOX_MAGIC 0xB0CB
+
+//! Survives the reset between capture (trap context) and flush (next boot).
+static struct BlackboxDump __attribute__((persistent)) dump;
+
+
+//! Same additive checksum as the warmstart snapshot.
+static unsigned int blackbox_checksum(struct BlackboxDump *d)
+{
+	unsigned char *p = (unsigned char*)d;
+	unsigned int sum = 0x5a17;
+	int i;
+
+	for (i = sizeof(d->magic); i < sizeof(struct BlackboxDump) - sizeof(d->checksum); i++)
+		sum += p[i];
+	return sum;
+}
+
+
+/*!
+ *  Fills the persistent dump. Runs in trap context or in the stack overflow
+ *  hook: no printf, no RTOS calls that could block. Invalidate first,
+ *  checksum last, like warmstart_save().
+ */
+static void blackbox_capture(char *reason, char *task_name, unsigned long pc)
+{
+	int i;
+
+	dump.magic = 0;
+
+	for (i = 0; i < sizeof(dump.reason) - 1 && reason[i]; i++)
+		dump.reason[i] = reason[i];
+	dump.reason[i] = '\0';
+
+	for (i = 0; i < sizeof(dump.task_name) - 1 && task_name && task_name[i]; i++)
+		dump.task_name[i] = task_name[i];
+	dump.task_name[i] = '\0';
+
+	dump.pc = pc;
+	dump.task_tag = 0;
+	dump.stack_free = 0;
+	if (xTaskGetCurrentTaskHandle() != NULL)   // scheduler may not be running yet
+	{
+		dump.task_tag = (int) xTaskGetApplicationTaskTag(NULL);
+		dump.stack_free = uxTaskGetStackHighWaterMark(NULL);
+	}
+	dump.tick = xTaskGetTickCount();
+
+	dump.roll = sensor_data.roll;
+	dump.pitch = sensor_data.pitch;
+	dump.p = sensor_data.p;
+	dump.q = sensor_data.q;
+	dump.r = sensor_data.r;
+	dump.pressure_height = sensor_data.pressure_height;
+	dump.latitude_rad = (float) sensor_data.gps.latitude_rad;
+	dump.longitude_rad = (float) sensor_data.gps.longitude_rad;
+	dump.codeline = gluonscript_data.current_codeline;
+
+	dump.checksum = blackbox_checksum(&dump);
+	dump.magic = BLACKBOX_MAGIC;
+}
+
+
+//! Trap hook, called by NotifyTrapAddress just before its reset.
+static void blackbox_trap(char *code, unsigned long pc)
+{
+	blackbox_capture(code, NULL, pc);
+}
+
+
+void blackbox_init()
+{
+	microcontroller_trap_hook = blackbox_trap;
+}
+
+
+void blackbox_stack_overflow(char *task_name)
+{
+	blackbox_capture("SO", task_name, 0ul);
+	// the watchdog is off, so reset ourselves: spinning here would need a
+	// power cycle, and that wipes the persistent dump before it is flushed
+	asm("reset");
+}
+
+
+/*!
+ *  Boot-time bookkeeping: flush a dump that survived the reset to the
+ *  dataflash, then print whatever dump the dataflash holds. The flash copy
+ *  is kept until the next crash overwrites it, so it is printed on every
+ *  boot - cheap insurance against missing it once.
+ */
+void blackbox_check()
+{
+	struct BlackboxDump stored;
+
+	if (dump.magic == BLACKBOX_MAGIC && dump.checksum == blackbox_checksum(&dump))
+	{
+		dataflash.write(BLACKBOX_PAGE, sizeof(struct BlackboxDump), (unsigned char*) &dump);
+		uart1_printf("Blackbox: crash dump saved to flash\r\n");
+	}
+	dump.magic = 0;
+
+	dataflash.read(BLACKBOX_PAGE, sizeof(struct BlackboxDump), (unsigned char*) &stored);
+	if (stored.magic != BLACKBOX_MAGIC || stored.checksum != blackbox_checksum(&stored))
+		return;   // never crashed (or pre-0.9 flash)
+
+	uart1_printf("Blackbox: last crash %s task %d %s PC 0x%lx tick %lu stackfree %u\r\n",
+	       stored.reason, stored.task_tag, stored.task_name,
+	       stored.pc, stored.tick, stored.stack_free);
+	uart1_printf("Blackbox: roll %f pitch %f height %f codeline %d\r\n",
+	       stored.roll, stored.pitch, stored.pressure_height, stored.codeline);
+}
@@ -0,0 +1,35 @@
+/*!
+ *  Blackbox: post-mortem dump for traps and stack overflows.
+ *
+ *  A trap or a stack overflow used to leave nothing but a one-line print
+ *  that scrolled away before anyone saw it. This module captures a compact
+ *  dump - crash reason, trapped program counter, the task that ran, its
+ *  stack high-water mark and the last published flight state - and persists
+ *  it on a reserved dataflash page (BLACKBOX_PAGE), so one flight with a
+ *  mystery reset comes back with an answer instead of a guess.
+ *
+ *  The handlers themselves only copy the dump into persistent RAM and
+ *  reset; the next boot flushes it to the dataflash and prints it.
+ *
+ *  @file     blackbox.h
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#ifndef BLACKBOX_H
+#define BLACKBOX_H
+
+//! Hooks the dump capture into the trap handlers (microcontroller.c).
+//! Call from main(), after microcontroller_init().
+void blackbox_init();
+
+//! Flushes a dump that survived the reset to BLACKBOX_PAGE and prints the
+//! stored dump. Call from main() once the dataflash is open.
+void blackbox_check();
+
+//! Called by vApplicationStackOverflowHook with the name of the task that
+//! ran through its stack; captures the dump and resets.
+void blackbox_stack_overflow(char *task_name);
+
+#endif // BLACKBOX_H
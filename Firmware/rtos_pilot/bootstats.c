@@ -0,0 +1,92 @@
+/*!
+ *  @file     bootstats.c
+ *  @brief    Boot-phase timing table, see bootstats.h.
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#include "FreeRTOS/FreeRTOS.h"
+#include "FreeRTOS/task.h"
+
+#include "timer/timer.h"
+
+#include "bootstats.h"
+
+
+struct BootPhase
+{
+	const char *name;
+	unsigned long start_ms;
+	unsigned long duration_ms;
+	char open;
+};
+
+static struct BootPhase phase[BOOTSTATS_MAX_PHASES];
+static int phases = 0;
+
+
+int bootstats_begin(const char *name)
+{
+	int id = -1;
+
+	// the rc wait and the gps autodetect open their phases from parallel
+	// tasks; pre-scheduler (main) this just nests an interrupt disable
+	taskENTER_CRITICAL();
+	if (phases < BOOTSTATS_MAX_PHASES)
+	{
+		id = phases;
+		phase[id].name = name;
+		phase[id].start_ms = timer_millis();
+		phase[id].duration_ms = 0;
+		phase[id].open = 1;
+		phases = id + 1;
+	}
+	taskEXIT_CRITICAL();
+	return id;
+}
+
+
+void bootstats_end(int id)
+{
+	if (id < 0)
+		return;
+	phase[id].duration_ms = timer_millis() - phase[id].start_ms;
+	phase[id].open = 0;
+}
+
+
+int bootstats_complete()
+{
+	int i;
+
+	for (i = 0; i < phases; i++)
+		if (phase[i].open)
+			return 0;
+	return 1;
+}
+
+
+int bootstats_count()
+{
+	return phases;
+}
+
+
+const char *bootstats_name(int i)
+{
+	return phase[i].name;
+}
+
+
+unsigned long bootstats_start_ms(int i)
+{
+	return phase[i].start_ms;
+}
+
+
+unsigned long bootstats_duration_ms(int i)
+{
+	return phase[i].open ? timer_millis() - phase[i].start_ms
+	                     : phase[i].duration_ms;
+}
@@ -0,0 +1,40 @@
+/*!
+ *  @file     bootstats.h
+ *  @brief    Boot-phase timing table for chasing the multi-second boot.
+ *  @detailed The boot prints in main() say what happened but not when or
+ *            for how long, and since the receiver wait and the gps
+ *            autodetect moved into their tasks the slow phases overlap
+ *            and cannot be attributed from the console output at all.
+ *            Each init step brackets itself with bootstats_begin/_end and
+ *            gets its start and duration recorded against the monotonic
+ *            millisecond clock. The telemetry task prints the table once
+ *            when every opened phase has closed, and the CB console
+ *            command reprints it on demand. Times are relative to
+ *            profiler_init() (which starts the free-running timer), so
+ *            the few ms of microcontroller and uart setup before that are
+ *            not attributable.
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+#ifndef BOOTSTATS_H
+#define BOOTSTATS_H
+
+#define BOOTSTATS_MAX_PHASES 12
+
+//! Opens a phase; name must be a string literal (the pointer is kept).
+//! Safe from main() and from task context. Returns the phase id to pass
+//! to bootstats_end(), or -1 when the table is full.
+int bootstats_begin(const char *name);
+
+void bootstats_end(int id);
+
+//! 1 once every phase that was opened has also ended.
+int bootstats_complete();
+
+int bootstats_count();
+const char *bootstats_name(int i);
+unsigned long bootstats_start_ms(int i);
+unsigned long bootstats_duration_ms(int i);
+
+#endif // BOOTSTATS_H
@@ -14,6 +14,30 @@ struct TelemetryConfig
 	unsigned char stream_GpsBasic;
 	unsigned char stream_Attitude;       //! Since 0.4
 	unsigned char stream_Control;        //! Since 0.5
+	unsigned char use_binary;            //! Since 0.8: 1 = binary frames for TA/TG/TC (communication_binary.c)
+
+	//! Since 0.9: stream rates for a second, wired telemetry port on the
+	//! gps connector (uart2, 115200 baud, CSV only). Same divider semantics
+	//! as the rates above, set with the S2 command. When any of them is
+	//! non-zero the gps task leaves uart2 alone, so this is a bench mode;
+	//! takes effect after a configuration write and a reboot.
+	unsigned char stream2_GpsBasic;
+	unsigned char stream2_GyroAccRaw;
+	unsigned char stream2_GyroAccProc;
+	unsigned char stream2_PPM;
+	unsigned char stream2_PressureTemp;
+	unsigned char stream2_Attitude;
+
+	//! Since 0.9: redundancy mirror role on uart2 (mirror.h): 0 off,
+	//! 1 primary (streams flight state at 10Hz), 2 backup (shadows it).
+	//! Claims uart2 from the gps driver like the stream2 rates do; the
+	//! backup side needs FC + reboot, the primary starts at once.
+	unsigned char mirror;
+
+	//! Since 0.9: 0..7, carried in the top 3 bits of the binary msgid
+	//! byte so two autopilots can share one downlink channel (optional
+	//! 9th ST field). 0 keeps the frames identical to older firmware.
+	unsigned char aircraft_id;
 };
 
 /*!
@@ -23,6 +47,12 @@ void communication_telemetry_task( void *parameters );
 
 void communication_input_task( void *parameters );
 
+/*!
+ *    1 when the second telemetry port is configured (any stream2 rate set);
+ *    uart2 then belongs to the telemetry task instead of the gps driver.
+ */
+int telemetry_uart2_enabled();
+
 
 
 #endif // COMMUNICATION_H
@@ -0,0 +1,771 @@
+/*!
+ *  Implements the binary downlink frames (see communication_binary.h for
+ *  the frame layout). The high-rate telemetry streams have a binary form
+ *  and flightplans can be uploaded as one framed block; configuration
+ *  traffic stays on the CSV protocol.
+ *
+ *  The payload is serialized byte per byte so the frames have no padding
+ *  and the wire format does not depend on the compiler's struct layout.
+ *
+ *  @file     communication_binary.c
+ *  @author   Tom Pycke
+ *  @date     31-aug-2012
+ *  @since    0.8
+ */
+
+#include "FreeRTOS/FreeRTOS.h"
+#include "FreeRTOS/task.h"
+#include "FreeRTOS/semphr.h"
+
+#include "uart1_queue/uart1_queue.h"
+#include "uart2/uart2.h"
+#include "timer/timer.h"
+#include "servo/servo.h"
+
+#include "sensors.h"
+#include "communication.h"
+#include "communication_binary.h"
+#include "configuration.h"
+#include "handler_navigation.h"
+#include "gluonscript.h"
+#include "task_control.h"
+#include "ahrs.h"
+#include "cpuload.h"
+
+extern xSemaphoreHandle xUart1Semaphore;
+
+// Largest payload is the stamped control frame (23 bytes)
+#define BIN_MAX_PAYLOAD 24
+static unsigned char bin_payload[BIN_MAX_PAYLOAD];
+static int bin_length;
+
+static void bin_put_u8(unsigned char x)
+{
+	if (bin_length < BIN_MAX_PAYLOAD)
+		bin_payload[bin_length++] = x;
+}
+
+static void bin_put_i16(int x)
+{
+	bin_put_u8((unsigned char)(x & 0xff));
+	bin_put_u8((unsigned char)((x >> 8) & 0xff));
+}
+
+static void bin_put_i32(long x)
+{
+	bin_put_u8((unsigned char)(x & 0xff));
+	bin_put_u8((unsigned char)((x >> 8) & 0xff));
+	bin_put_u8((unsigned char)((x >> 16) & 0xff));
+	bin_put_u8((unsigned char)((x >> 24) & 0xff));
+}
+
+/*!
+ *   Sends the assembled payload as one frame. Takes the uart semaphore
+ *   without blocking: when the uart is in use the frame is dropped, the
+ *   stream sends a fresh one on its next period anyway.
+ */
+static void bin_send_frame(unsigned char msgid)
+{
+	unsigned char ck_a = 0, ck_b = 0;
+	int i;
+
+	// the top 3 bits of the msgid byte carry the aircraft id, so several
+	// autopilots can share one downlink channel; id 0 (the default) keeps
+	// the byte identical to pre-0.9 frames
+	msgid |= (config.telemetry.aircraft_id & 0x07) << 5;
+
+	if (xSemaphoreTake(xUart1Semaphore, 0) != pdTRUE)
+		return;
+
+	uart1_putc(BIN_SYNC1);
+	uart1_putc(BIN_SYNC2);
+	uart1_putc((char)msgid);
+	uart1_putc((char)bin_length);
+	ck_a += msgid;           ck_b += ck_a;
+	ck_a += (unsigned char)bin_length; ck_b += ck_a;
+	for (i = 0; i < bin_length; i++)
+	{
+		uart1_putc((char)bin_payload[i]);
+		ck_a += bin_payload[i];
+		ck_b += ck_a;
+	}
+	uart1_putc((char)ck_a);
+	uart1_putc((char)ck_b);
+
+	xSemaphoreGive(xUart1Semaphore);
+}
+
+/*!
+ *   One chunk of a log page, requested with the DP command. Too big for
+ *   bin_payload, so the bytes are streamed straight to the uart while the
+ *   checksum runs along. Unlike the periodic streams this frame is worth
+ *   waiting for, so the uart semaphore is taken with a timeout instead of
+ *   dropping; the groundstation re-requests the page when a chunk is lost.
+ */
+void comm_binary_send_log_chunk(unsigned int page, unsigned char chunk, unsigned char *data, unsigned char size)
+{
+	unsigned char ck_a = 0, ck_b = 0;
+	unsigned char len = size + 3;
+	unsigned char msgid = BIN_MSG_LOG_CHUNK | ((config.telemetry.aircraft_id & 0x07) << 5);
+	int i;
+
+	if (xSemaphoreTake(xUart1Semaphore, ( portTickType ) 1000 / portTICK_RATE_MS ) != pdTRUE)
+		return;
+
+	uart1_putc(BIN_SYNC1);
+	uart1_putc(BIN_SYNC2);
+	uart1_putc((char)msgid);
+	uart1_putc((char)len);
+	ck_a += msgid;             ck_b += ck_a;
+	ck_a += len;               ck_b += ck_a;
+	uart1_putc((char)(page & 0xff));
+	ck_a += (unsigned char)(page & 0xff); ck_b += ck_a;
+	uart1_putc((char)(page >> 8));
+	ck_a += (unsigned char)(page >> 8);   ck_b += ck_a;
+	uart1_putc((char)chunk);
+	ck_a += chunk;             ck_b += ck_a;
+	for (i = 0; i < size; i++)
+	{
+		uart1_putc((char)data[i]);
+		ck_a += data[i];
+		ck_b += ck_a;
+	}
+	uart1_putc((char)ck_a);
+	uart1_putc((char)ck_b);
+
+	xSemaphoreGive(xUart1Semaphore);
+}
+
+// The high-rate streams repeat mostly-unchanged fields, so between the
+// one-per-second keyframes they send delta frames with only the changed
+// fields (layout in communication_binary.h). Every frame carries one
+// continuously counting sequence byte per stream - appended to the
+// keyframe payload, first byte of a delta payload - and the baselines
+// advance even when bin_send_frame() drops a frame, so any gap shows up
+// as a sequence mismatch and the decoder waits for the next keyframe.
+#define BIN_KEYFRAME_TICKS (( portTickType ) 1000 / portTICK_RATE_MS)
+
+/*!
+ *   Same content as the "TA" line: roll, pitch and yaw in millirad.
+ *   Keyframe once a second or when a field moved more than 127 millirad
+ *   since the previous frame; an ATTITUDE_DELTA frame otherwise.
+ */
+void comm_binary_send_attitude()
+{
+	static unsigned char seq = 0;
+	static int last[3];
+	static int keyframe_sent = 0;
+	static portTickType keyframe_tick = 0;
+
+	int value[3];
+	int delta[3];
+	unsigned char mask = 0;
+	int fits = 1;
+	int i;
+	portTickType now = xTaskGetTickCount();
+
+	value[0] = (int)(sensor_data.roll * 1000.0);
+	value[1] = (int)(sensor_data.pitch * 1000.0);
+	value[2] = (int)(sensor_data.yaw * 1000.0);
+
+	for (i = 0; i < 3; i++)
+	{
+		delta[i] = value[i] - last[i];
+		if (delta[i] < -128 || delta[i] > 127)
+			fits = 0;
+		else if (delta[i] != 0)
+			mask |= 1 << i;
+	}
+
+	bin_length = 0;
+	if (!keyframe_sent || !fits || now - keyframe_tick >= BIN_KEYFRAME_TICKS)
+	{
+		bin_put_i16(value[0]);
+		bin_put_i16(value[1]);
+		bin_put_i16(value[2]);
+		bin_put_u8(seq);
+		bin_put_i32((long)timer_millis());
+		bin_send_frame(BIN_MSG_ATTITUDE);
+		keyframe_tick = now;
+		keyframe_sent = 1;
+	}
+	else
+	{
+		bin_put_u8(seq);
+		bin_put_u8(mask);
+		for (i = 0; i < 3; i++)
+			if (mask & (1 << i))
+				bin_put_u8((unsigned char)delta[i]);
+		bin_send_frame(BIN_MSG_ATTITUDE_DELTA);
+	}
+
+	seq++;
+	for (i = 0; i < 3; i++)
+		last[i] = value[i];
+}
+
+/*!
+ *   Same content as the "TG" line. Position is sent as rad * 1e8 in a
+ *   32-bit integer, which still resolves about 1cm on the ground. The
+ *   16-bit position deltas in a GPS_DELTA frame cover about 2km between
+ *   frames; a typical moving fix shrinks from 16 to 10 payload bytes,
+ *   a hovering one to 4.
+ */
+void comm_binary_send_gps_basic()
+{
+	static unsigned char seq = 0;
+	static unsigned char last_status = 0, last_sats = 0;
+	static long last_lat = 0, last_lon = 0;
+	static int last_speed = 0, last_heading = 0, last_height = 0;
+	static int keyframe_sent = 0;
+	static portTickType keyframe_tick = 0;
+
+	unsigned char status = (unsigned char)sensor_data.gps.status;
+	long lat = (long)(sensor_data.gps.latitude_rad * 100000000.0);
+	long lon = (long)(sensor_data.gps.longitude_rad * 100000000.0);
+	int speed = (int)(sensor_data.gps.speed_ms * 10.0);
+	int heading = (int)(sensor_data.gps.heading_rad * 100.0);
+	unsigned char sats = (unsigned char)sensor_data.gps.satellites_in_view;
+	int height = (int)sensor_data.gps.height_m;
+
+	long d_lat = lat - last_lat;
+	long d_lon = lon - last_lon;
+	int d_speed = speed - last_speed;
+	int d_heading = heading - last_heading;
+	int d_height = height - last_height;
+	unsigned char mask = 0;
+	int fits;
+	portTickType now = xTaskGetTickCount();
+
+	fits = d_lat >= -32768l && d_lat <= 32767l &&
+	       d_lon >= -32768l && d_lon <= 32767l &&
+	       d_speed >= -128 && d_speed <= 127 &&
+	       d_heading >= -128 && d_heading <= 127 &&
+	       d_height >= -128 && d_height <= 127;
+
+	if (status != last_status)
+		mask |= 0x01;
+	if (d_lat != 0l)
+		mask |= 0x02;
+	if (d_lon != 0l)
+		mask |= 0x04;
+	if (d_speed != 0)
+		mask |= 0x08;
+	if (d_heading != 0)
+		mask |= 0x10;
+	if (sats != last_sats)
+		mask |= 0x20;
+	if (d_height != 0)
+		mask |= 0x40;
+
+	bin_length = 0;
+	if (!keyframe_sent || !fits || now - keyframe_tick >= BIN_KEYFRAME_TICKS)
+	{
+		bin_put_u8(status);
+		bin_put_i32(lat);
+		bin_put_i32(lon);
+		bin_put_i16(speed);
+		bin_put_i16(heading);
+		bin_put_u8(sats);
+		bin_put_i16(height);
+		bin_put_u8(seq);
+		bin_put_i32((long)timer_millis());
+		bin_send_frame(BIN_MSG_GPS_BASIC);
+		keyframe_tick = now;
+		keyframe_sent = 1;
+	}
+	else
+	{
+		bin_put_u8(seq);
+		bin_put_u8(mask);
+		if (mask & 0x01)
+			bin_put_u8(status);
+		if (mask & 0x02)
+			bin_put_i16((int)d_lat);
+		if (mask & 0x04)
+			bin_put_i16((int)d_lon);
+		if (mask & 0x08)
+			bin_put_u8((unsigned char)d_speed);
+		if (mask & 0x10)
+			bin_put_u8((unsigned char)d_heading);
+		if (mask & 0x20)
+			bin_put_u8(sats);
+		if (mask & 0x40)
+			bin_put_u8((unsigned char)d_height);
+		bin_send_frame(BIN_MSG_GPS_DELTA);
+	}
+
+	seq++;
+	last_status = status;
+	last_lat = lat;
+	last_lon = lon;
+	last_speed = speed;
+	last_heading = heading;
+	last_sats = sats;
+	last_height = height;
+}
+
+/*!
+ *   Same content as the "TC" line. Altitude, link quality and throttle
+ *   are calculated in the telemetry task and passed in, so the logic is
+ *   shared with the CSV path.
+ */
+void comm_binary_send_control(int altitude, int sig_quality, int throttle)
+{
+	bin_length = 0;
+	bin_put_u8((unsigned char)control_state.flight_mode);
+	bin_put_i16(gluonscript_data.current_codeline);
+	bin_put_i16(altitude);
+	bin_put_i16((int)sensor_data.battery1_voltage_10);
+	bin_put_i16(navigation_data.time_airborne_s);
+	bin_put_i16(navigation_data.time_block_s);
+	bin_put_u8((unsigned char)sig_quality);
+	bin_put_u8((unsigned char)throttle);
+	bin_put_i16((int)navigation_data.desired_altitude_agl);
+	bin_put_i16((int)sensor_data.battery2_voltage_10);
+	bin_put_i16((int)(sensors_battery1_mAh() / 10.0));
+	bin_put_i32((long)timer_millis());
+	bin_put_u8(cpuload_percent());  // appended last: length-prefixed frame stays parseable by older readers
+	bin_send_frame(BIN_MSG_CONTROL);
+}
+
+
+/*************************** link benchmark ********************************/
+
+// One run streams a fixed number of BENCH frames as close to the requested
+// rate as the telemetry tick's byte budget allows; see the BE command.
+static unsigned long bench_remaining = 0;
+static unsigned long bench_seq;
+static unsigned int bench_rate_hz;
+static unsigned int bench_acc;       // rate accumulator in frames per 10Hz tick
+static unsigned char bench_filler;
+static unsigned long bench_start_ms;
+
+
+void comm_binary_bench_start(unsigned int rate_hz, unsigned int seconds, unsigned char filler)
+{
+	if (filler > BIN_MAX_PAYLOAD - 8)   // seq + timestamp take 8 payload bytes
+		filler = BIN_MAX_PAYLOAD - 8;
+
+	bench_remaining = (unsigned long)rate_hz * seconds;
+	bench_rate_hz = rate_hz;
+	bench_acc = 0;
+	bench_seq = 0;
+	bench_filler = filler;
+	bench_start_ms = timer_millis();
+}
+
+
+int comm_binary_bench_tick(int budget)
+{
+	// sync + msgid + length + checksum pair around the payload
+	int cost = 6 + 8 + bench_filler;
+	int used = 0;
+	int i;
+
+	if (bench_remaining == 0)
+		return 0;
+
+	bench_acc += bench_rate_hz;
+	if (bench_acc > bench_rate_hz + 10)   // budget backlog: catch up one frame per tick at most
+		bench_acc = bench_rate_hz + 10;
+
+	while (bench_acc >= 10 && bench_remaining > 0 && budget - used >= cost)
+	{
+		bin_length = 0;
+		bin_put_i32((long)bench_seq);
+		bin_put_i32((long)timer_millis());
+		for (i = 0; i < bench_filler; i++)
+			bin_put_u8((unsigned char)bench_seq);   // deterministic, but not compressible to idle line noise
+		bin_send_frame(BIN_MSG_BENCH);
+
+		// a frame bin_send_frame() dropped on uart contention counts as
+		// sent: the receiver sees the sequence gap as loss, which is the
+		// number the benchmark is after
+		bench_seq++;
+		bench_remaining--;
+		bench_acc -= 10;
+		used += cost;
+	}
+	return used;
+}
+
+
+int comm_binary_bench_done(unsigned long *sent, unsigned long *elapsed_ms)
+{
+	if (bench_remaining != 0 || bench_seq == 0)
+		return 0;
+	*sent = bench_seq;
+	*elapsed_ms = timer_millis() - bench_start_ms;
+	bench_seq = 0;   // report once
+	return 1;
+}
+
+
+/********************* dgps correction pass-through ************************/
+
+// Byte budget for forwarded rtcm corrections. A blocking uart2 write of
+// one full chunk costs ~4.7ms at 115200 baud and the forwarding runs in
+// the console input task, which also writes every ack and reply on uart1;
+// the budget keeps a runaway correction stream from starving those. 3000
+// bytes/s is about triple a typical RTCM3 correction rate.
+#define RTCM_BYTES_PER_S 3000
+
+static long rtcm_budget = RTCM_BYTES_PER_S;
+static unsigned long rtcm_last_refill_ms;
+static unsigned long rtcm_forwarded;   // chunks through, for the debugger
+static unsigned long rtcm_dropped;     // chunks the budget refused
+
+
+/*************************** HIL uplink parsing ****************************/
+
+// Largest uplink payload (a 4-line navigation chunk: 2 + 4*13 bytes)
+#define HIL_MAX_PAYLOAD 54
+
+static unsigned char hil_payload[HIL_MAX_PAYLOAD];
+static int hil_state = 0;       // position in sync/msgid/len/payload/ck sequence
+static unsigned char hil_msgid;
+static unsigned char hil_aircraft;
+static int hil_length;
+static int hil_position;
+static unsigned char hil_ck_a, hil_ck_b;
+
+/************************ navigation batch upload **************************/
+
+#define NAV_LINE_BYTES 13   // opcode u8, x f32, y f32, a i16, b i16
+
+// Chunks land here first; only a valid NAV_COMMIT touches the live script.
+static unsigned char nav_staging[MAX_GLUONSCRIPTCODES * NAV_LINE_BYTES];
+static unsigned char nav_received[(MAX_GLUONSCRIPTCODES + 7) / 8];
+
+//! CRC16-CCITT (poly 0x1021, init 0xffff), the block checksum of the
+//! navigation upload. Frame-level errors are already caught per chunk by
+//! the Fletcher pair; this guards the assembled block as a whole.
+static unsigned int nav_crc16(unsigned char *data, int size)
+{
+	unsigned int crc = 0xffff;
+	int i, bit;
+
+	for (i = 0; i < size; i++)
+	{
+		crc ^= (unsigned int)data[i] << 8;
+		for (bit = 0; bit < 8; bit++)
+		{
+			if (crc & 0x8000)
+				crc = (crc << 1) ^ 0x1021;
+			else
+				crc <<= 1;
+		}
+	}
+	return crc;
+}
+
+static int nav_read_i16(unsigned char *p)
+{
+	return (int)((unsigned int)p[0] | ((unsigned int)p[1] << 8));
+}
+
+static float nav_read_f32(unsigned char *p)
+{
+	union { float f; unsigned long l; } u;
+
+	u.l = (unsigned long)p[0] |
+	      ((unsigned long)p[1] << 8) |
+	      ((unsigned long)p[2] << 16) |
+	      ((unsigned long)p[3] << 24);
+	return u.f;
+}
+
+/*!
+ *   Copies the validated staging block into gluonscript_data.codes, pads
+ *   the rest with EMPTYCMD, rebuilds the navigation caches and burns the
+ *   script to dataflash - the same path the LN/FN commands take.
+ */
+static int nav_commit(int count)
+{
+	int i;
+	int bad;
+
+	for (i = 0; i < MAX_GLUONSCRIPTCODES; i++)
+	{
+		if (i < count)
+		{
+			unsigned char *p = &nav_staging[i * NAV_LINE_BYTES];
+
+			gluonscript_data.codes[i].opcode = p[0];
+			gluonscript_data.codes[i].x = nav_read_f32(p + 1);
+			gluonscript_data.codes[i].y = nav_read_f32(p + 5);
+			gluonscript_data.codes[i].a = nav_read_i16(p + 9);
+			gluonscript_data.codes[i].b = nav_read_i16(p + 11);
+		}
+		else
+		{
+			gluonscript_data.codes[i].opcode = EMPTYCMD;
+			gluonscript_data.codes[i].x = 0.0f;
+			gluonscript_data.codes[i].y = 0.0f;
+			gluonscript_data.codes[i].a = 0;
+			gluonscript_data.codes[i].b = 0;
+		}
+	}
+
+	// upload-time validation: fold relative GOTO/CALL targets to absolute
+	// indices and reject bad opcodes/arguments before anything is burned
+	bad = gluonscript_compile();
+	if (bad >= 0)
+	{
+		// keep the runtime safe (EMPTYCMD = return home), but keep the
+		// rejected plan out of dataflash so a fixed re-upload replaces it
+		while ((i = gluonscript_compile()) >= 0)
+		{
+			gluonscript_data.codes[i].opcode = EMPTYCMD;
+			gluonscript_data.codes[i].a = 0;
+			gluonscript_data.codes[i].b = 0;
+		}
+	}
+
+	if (navigation_data.relative_positions_calculated)
+		navigation_calculate_relative_positions();   // also rebuilds the leg cache
+	else
+		navigation_calculate_leg_cache();
+
+	if (bad < 0)
+		gluonscript_burn();
+	return bad;
+}
+
+static int hil_get_i16(int offset)
+{
+	return (int)((unsigned int)hil_payload[offset] |
+	             ((unsigned int)hil_payload[offset + 1] << 8));
+}
+
+static long hil_get_i32(int offset)
+{
+	return (long)((unsigned long)hil_payload[offset] |
+	              ((unsigned long)hil_payload[offset + 1] << 8) |
+	              ((unsigned long)hil_payload[offset + 2] << 16) |
+	              ((unsigned long)hil_payload[offset + 3] << 24));
+}
+
+
+/*!
+ *   A complete, checksum-valid uplink frame arrived; apply it.
+ *
+ *   The sensors task deleted itself when simulation mode was enabled, so
+ *   this is where the scaled sensor values, the filter step and the
+ *   snapshot publish happen - the same work the sensor task does per tick,
+ *   but clocked by the model's frames instead of the ADC.
+ */
+static void hil_handle_frame()
+{
+	switch (hil_msgid)
+	{
+		case BIN_MSG_HIL_SENSORS:
+		{
+			float dt = (float)hil_payload[14] / 1000.0f;
+
+			// injected sensor data must never reach the live filters
+			if (!control_state.simulation_mode)
+				break;
+			if (hil_length < 15 || dt <= 0.0f)
+				break;
+			sensor_data.acc_x = (float)hil_get_i16(0) / 1000.0f;
+			sensor_data.acc_y = (float)hil_get_i16(2) / 1000.0f;
+			sensor_data.acc_z = (float)hil_get_i16(4) / 1000.0f;
+			sensor_data.p = (float)hil_get_i16(6) / 1000.0f;
+			sensor_data.q = (float)hil_get_i16(8) / 1000.0f;
+			sensor_data.r = (float)hil_get_i16(10) / 1000.0f;
+			sensor_data.pressure_height = (float)hil_get_i16(12) / 10.0f;
+
+			ahrs_filter(dt);
+			sensors_publish_snapshot();   // the control task picks this up on its next tick
+			break;
+		}
+		case BIN_MSG_HIL_GPS:
+		{
+			if (!control_state.simulation_mode || hil_length < 15)
+				break;
+			sensor_data.gps.latitude_rad = (double)hil_get_i32(0) / 10000000.0;
+			sensor_data.gps.longitude_rad = (double)hil_get_i32(4) / 10000000.0;
+			sensor_data.gps.speed_ms = (float)hil_get_i16(8) / 10.0f;
+			sensor_data.gps.heading_rad = (float)hil_get_i16(10) / 100.0f;
+			sensor_data.gps.height_m = hil_get_i16(12);
+			sensor_data.gps.satellites_in_view = hil_payload[14];
+			sensor_data.gps.status = ACTIVE;
+			break;
+		}
+		case BIN_MSG_NAV_CHUNK:
+		{
+			int first = hil_payload[0];
+			int count = hil_payload[1];
+			int i;
+
+			if (hil_length != 2 + count * NAV_LINE_BYTES ||
+			    first + count > MAX_GLUONSCRIPTCODES)
+				break;
+
+			for (i = 0; i < count * NAV_LINE_BYTES; i++)
+				nav_staging[first * NAV_LINE_BYTES + i] = hil_payload[2 + i];
+			for (i = first; i < first + count; i++)
+				nav_received[i >> 3] |= 1 << (i & 7);
+
+			// ack by echoing the chunk header; the sender retries a chunk
+			// whose ack never came (the uart may have been busy)
+			bin_length = 0;
+			bin_put_u8((unsigned char)first);
+			bin_put_u8((unsigned char)count);
+			bin_send_frame(BIN_MSG_NAV_CHUNK);
+			break;
+		}
+		case BIN_MSG_NAV_COMMIT:
+		{
+			int count = hil_payload[0];
+			unsigned int crc = (unsigned int)hil_get_i16(1);
+			unsigned char status = 0;
+			int i;
+
+			if (hil_length < 3 || count > MAX_GLUONSCRIPTCODES)
+				break;
+
+			for (i = 0; i < count; i++)
+			{
+				if (!(nav_received[i >> 3] & (1 << (i & 7))))
+					status = 1;   // a chunk went missing
+			}
+			if (status == 0 && nav_crc16(nav_staging, count * NAV_LINE_BYTES) != crc)
+				status = 2;
+
+			if (status == 0)
+			{
+				int bad = nav_commit(count);
+				if (bad >= 0)
+				{
+					status = 3;   // invalid program; not burned
+					count = bad;  // ack carries the offending line
+				}
+				for (i = 0; i < sizeof(nav_received); i++)
+					nav_received[i] = 0;   // next upload starts clean
+			}
+
+			bin_length = 0;
+			bin_put_u8(status);
+			bin_put_u8((unsigned char)count);
+			bin_send_frame(BIN_MSG_NAV_COMMIT);
+			break;
+		}
+		case BIN_MSG_GPS_RTCM:
+		{
+			unsigned long now = timer_millis();
+
+			// the wired port belongs to the gps unless uart2 telemetry
+			// claimed it, and injected HIL gps fixes make corrections moot
+			if (telemetry_uart2_enabled() || control_state.simulation_mode)
+				break;
+
+			rtcm_budget += (long)((now - rtcm_last_refill_ms) * RTCM_BYTES_PER_S / 1000);
+			rtcm_last_refill_ms = now;
+			if (rtcm_budget > RTCM_BYTES_PER_S)
+				rtcm_budget = RTCM_BYTES_PER_S;
+
+			// whole chunks only; if the ground side did not align chunks
+			// to rtcm message boundaries the gps resyncs on the preamble
+			if (rtcm_budget < hil_length)
+			{
+				rtcm_dropped++;
+				break;
+			}
+			rtcm_budget -= hil_length;
+			uart2_put((char*)hil_payload, hil_length);
+			rtcm_forwarded++;
+			break;
+		}
+		default:   // unknown msgid: drop, the model may be newer than us
+			break;
+	}
+}
+
+
+/*!
+ *   One character of the HIL uplink. Mirrors the downlink frame layout;
+ *   a checksum failure silently drops the frame, the model sends a fresh
+ *   one a few ms later anyway. A lone 'G' that is not followed by 'P' is
+ *   consumed too: in simulation mode the console traffic is checksummed
+ *   $..* lines, which never start with 'G'.
+ */
+int comm_binary_receive_char(unsigned char c)
+{
+	switch (hil_state)
+	{
+		case 0:   // waiting for sync1
+			if (c != BIN_SYNC1)
+				return 0;
+			hil_state = 1;
+			return 1;
+		case 1:   // waiting for sync2
+			if (c != BIN_SYNC2)
+			{
+				hil_state = 0;
+				return 0;
+			}
+			hil_state = 2;
+			return 1;
+		case 2:   // msgid; the top 3 bits address one aircraft on the channel
+			hil_msgid = c & 0x1f;
+			hil_aircraft = c >> 5;
+			hil_ck_a = c;
+			hil_ck_b = c;
+			hil_state = 3;
+			return 1;
+		case 3:   // payload length
+			hil_length = c;
+			hil_ck_a += c;
+			hil_ck_b += hil_ck_a;
+			hil_position = 0;
+			if (hil_length > HIL_MAX_PAYLOAD)
+				hil_state = 0;   // can't be ours
+			else
+				hil_state = (hil_length == 0) ? 5 : 4;
+			return 1;
+		case 4:   // payload
+			hil_payload[hil_position++] = c;
+			hil_ck_a += c;
+			hil_ck_b += hil_ck_a;
+			if (hil_position == hil_length)
+				hil_state = 5;
+			return 1;
+		case 5:   // checksum a
+			hil_state = (c == hil_ck_a) ? 6 : 0;
+			return 1;
+		case 6:   // checksum b
+			hil_state = 0;
+			// the whole frame is consumed either way, but only the
+			// addressed aircraft acts on it: both autopilots hear the
+			// same coordinator on a shared channel
+			if (c == hil_ck_b && hil_aircraft == (config.telemetry.aircraft_id & 0x07))
+				hil_handle_frame();
+			return 1;
+	}
+	hil_state = 0;
+	return 0;
+}
+
+
+int comm_binary_active()
+{
+	return hil_state != 0;
+}
+
+
+/*!
+ *   The 6 servo outputs in us for the flight-dynamics model; the control
+ *   task sends one of these per control cycle in simulation mode.
+ */
+void comm_binary_send_hil_servos()
+{
+	int i;
+
+	bin_length = 0;
+	for (i = 0; i < 6; i++)
+		bin_put_i16((int)servo_read_us(i));
+	bin_send_frame(BIN_MSG_HIL_SERVOS);
+}
@@ -0,0 +1,146 @@
+/*!
+ *  Compact binary downlink frames, selectable next to the CSV streams.
+ *
+ *  Frame layout: 'G' 'P' | msgid | payload length | payload | ck_a | ck_b.
+ *  All payload fields are little endian and fixed width; the checksum is a
+ *  Fletcher-style 8-bit pair calculated over msgid, length and payload.
+ *  The top 3 bits of the msgid byte carry the aircraft id (optional 9th ST
+ *  field, default 0) so two autopilots can interleave their streams on one
+ *  shared channel; the bottom 5 bits select the message.
+ *  An attitude frame takes 12 bytes on the wire where the CSV "TA" line
+ *  needs 30-40, so the high-rate streams leave much more airtime on slow
+ *  telemetry links.
+ *
+ *  @file     communication_binary.h
+ *  @author   Tom Pycke
+ *  @date     31-aug-2012
+ *  @since    0.8
+ */
+
+#ifndef COMMUNICATION_BINARY_H
+#define COMMUNICATION_BINARY_H
+
+#define BIN_SYNC1   'G'
+#define BIN_SYNC2   'P'
+
+#define BIN_MSG_ATTITUDE   0x01
+#define BIN_MSG_GPS_BASIC  0x02
+#define BIN_MSG_CONTROL    0x03
+#define BIN_MSG_LOG_CHUNK  0x04
+#define BIN_MSG_HIL_SERVOS 0x05
+#define BIN_MSG_ATTITUDE_DELTA 0x06
+#define BIN_MSG_GPS_DELTA      0x07
+#define BIN_MSG_BENCH          0x08
+#define BIN_MSG_MIRROR         0x09   // board-to-board state mirror, see mirror.h
+
+// Uplink frames; same layout and checksum as the downlink, parsed by
+// comm_binary_receive_char(). The HIL injection frames are only applied in
+// simulation mode (SE command); the navigation upload works any time. The
+// rtcm payload is not interpreted at all: communication_binary.c forwards
+// it byte for byte to the gps uart for differential corrections.
+#define BIN_MSG_HIL_SENSORS 0x10
+#define BIN_MSG_HIL_GPS     0x11
+#define BIN_MSG_NAV_CHUNK   0x12
+#define BIN_MSG_NAV_COMMIT  0x13
+#define BIN_MSG_GPS_RTCM    0x14
+
+/*!
+ *   Binary replacements for the TA / TG / TC telemetry lines. They grab
+ *   xUart1Semaphore without blocking, just like printf_checksum_direct,
+ *   so a frame is silently dropped when the uart is busy.
+ *
+ *   The attitude and gps streams are delta coded: a full keyframe once a
+ *   second (or when a field jumps too far for its delta width), an
+ *   ATTITUDE_DELTA / GPS_DELTA frame in between. Every frame carries a
+ *   per-stream sequence byte that counts continuously: appended behind
+ *   the keyframe payload (old decoders ignore the extra byte), first
+ *   byte of a delta payload. A delta continues with a field mask in
+ *   keyframe field order, then the changed fields only - latitude and
+ *   longitude as 16-bit deltas, the other numeric fields as 8-bit
+ *   deltas, status and satellite count as full bytes. The decoder only
+ *   applies a delta whose sequence byte follows the last frame it saw
+ *   and falls back to waiting for a keyframe otherwise, so a lost frame
+ *   costs at most one second of a stream.
+ *
+ *   Keyframes and the control frame end with timer_millis() as a u32,
+ *   the same monotonic clock that stamps every LogLine: one timebase to
+ *   correlate log records, telemetry and groundstation events. Delta
+ *   frames are not stamped, their time is bounded by the neighbouring
+ *   keyframes.
+ */
+void comm_binary_send_attitude();
+void comm_binary_send_gps_basic();
+void comm_binary_send_control(int altitude, int sig_quality, int throttle);
+
+/*!
+ *   One chunk of a dataflash log page for the DP readout; payload is
+ *   page (u16), chunk number (u8) and the raw page bytes.
+ */
+void comm_binary_send_log_chunk(unsigned int page, unsigned char chunk, unsigned char *data, unsigned char size);
+
+/*!
+ *   Feeds one received character into the HIL frame parser. Returns 1 when
+ *   the character was consumed as part of a binary frame, 0 when the console
+ *   line parser should have it. Call only in simulation mode.
+ *
+ *   HIL_SENSORS payload (15 bytes): acc x/y/z in mg (i16), p/q/r in mrad/s
+ *   (i16), pressure height in dm (i16), dt in ms (u8). Physical units, so
+ *   the model does not need to know the sensor neutrals and scales. Each
+ *   frame runs one ahrs_filter() step and publishes a sensor snapshot: at
+ *   250 frames/s the control loop runs exactly like on live sensors.
+ *
+ *   HIL_GPS payload (15 bytes): latitude/longitude in 1e-7 rad (i32),
+ *   speed in 0.1 m/s (u16), heading in 0.01 rad (i16), height in m (i16),
+ *   satellites (u8).
+ *
+ *   NAV_CHUNK uploads part of a flightplan into a staging buffer: first
+ *   line (u8), line count (u8), then 13 bytes per line - opcode (u8),
+ *   x (f32), y (f32), a (i16), b (i16). Each chunk is acked by echoing
+ *   first line and count. NAV_COMMIT - line count (u8), CRC16-CCITT over
+ *   count*13 staging bytes (u16) - validates the staged block and only
+ *   then copies it into gluonscript_data.codes, runs the
+ *   gluonscript_compile() validation pass and burns it to dataflash;
+ *   the ack echoes the count plus a status byte (0 = ok, 1 = lines
+ *   missing, 2 = CRC mismatch, 3 = gluonscript_compile() rejected the
+ *   program - nothing is burned and the second byte carries the first
+ *   offending line instead of the count). A 64-line plan uploads in one
+ *   pass instead of 64 WN round trips.
+ */
+int comm_binary_receive_char(unsigned char c);
+
+/*!
+ *   1 while comm_binary_receive_char() is in the middle of a frame; the
+ *   console task keeps routing characters here until the frame ends.
+ */
+int comm_binary_active();
+
+/*!
+ *   Servo outputs for the flight-dynamics model: 6 pulse widths in us
+ *   (u16). The control task sends one per control cycle in simulation mode.
+ */
+void comm_binary_send_hil_servos();
+
+/*!
+ *   Link benchmark (BE command): streams rate_hz * seconds sequenced BENCH
+ *   frames - sequence number (u32), timer_millis() (u32), then filler
+ *   filler bytes - as close to rate_hz as the telemetry tick's byte budget
+ *   allows. The groundstation counts sequence gaps for loss, received
+ *   bytes over time for goodput and the drift between arrival times and
+ *   the embedded timestamps for latency jitter. rate_hz = 0 aborts a run.
+ */
+void comm_binary_bench_start(unsigned int rate_hz, unsigned int seconds, unsigned char filler);
+
+/*!
+ *   Called from the telemetry tick with the remaining byte budget; sends
+ *   the frames that are due and returns the wire bytes consumed.
+ */
+int comm_binary_bench_tick(int budget);
+
+/*!
+ *   Returns 1 exactly once after a run finishes, with the frames sent and
+ *   the elapsed milliseconds - the telemetry task turns it into the BE
+ *   completion line.
+ */
+int comm_binary_bench_done(unsigned long *sent, unsigned long *elapsed_ms);
+
+#endif // COMMUNICATION_BINARY_H
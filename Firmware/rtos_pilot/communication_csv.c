@@ -5,7 +5,7 @@
  *
  *   Commands:
  *   Telemetry: TR, TP, TA, TH, TT, TG
- *   Other: ST, SA, SI, SG, PP, PR, PH, FC, LC, LD, RC
+ *   Other: ST, S2, SA, SI, SG, PP, PR, PH, FC, LC, LD, RC
  *
  *  @file     communication_csv.c
  *  @author   Tom Pycke
@@ -26,18 +26,37 @@
 
 #include "microcontroller/microcontroller.h"
 #include "uart1_queue/uart1_queue.h"
+#include "format/format.h"
+#include "ringbuffer/ringbuffer.h"
+#include "uart2/uart2.h"
 #include "gps/gps.h"
 #include "ppm_in/ppm_in.h"
 #include "led/led.h"
 #include "servo/servo.h"
+#include "tempcomp/tempcomp.h"
 
 #include "task_osd.h"
 #include "sensors.h"
 #include "communication.h"
+#include "communication_binary.h"
+#include "telemetry_frames.h"
+#include "mirror.h"
+#include "flashcheck.h"
+#include "gyrocapture.h"
 #include "configuration.h"
 #include "task_datalogger.h"
 #include "handler_navigation.h"
 #include "handler_alarms.h"
+#include "handler_maximum_range.h"
+#include "profiler.h"
+#include "microcontroller/isr_time.h"
+#include "cpuload.h"
+#include "bootstats.h"
+#include "latency.h"
+#include "stackwatch.h"
+#include "vibration.h"
+#include "heartbeat.h"
+#include "task_sensors_mpu6000.h"
 
 #include "common.h"
 
@@ -49,46 +68,65 @@ void print_logline_simulation(struct LogLine *l);
 
 void print_configuration();
 void print_navigation();
+void print_cpu_load();
+void print_latency();
+void print_stack_usage();
+void print_vibration();
+void print_task_health();
+void print_queue_watermarks();
+void print_boot_stats();
 
 #define BUFFERSIZE 200
 static char  buffer[BUFFERSIZE];
 
+//! Two-letter console commands dispatch on this 16-bit code; used both for
+//! the received characters and in the case labels of the command switch.
+#define COMMAND_CODE(a, b)  ((((unsigned int)(unsigned char)(a)) << 8) | (unsigned char)(b))
+
 extern unsigned long idle_counter;
 
 #define COMM_BUFFER_LEN 100
 char comm_buffer[COMM_BUFFER_LEN];
 void comm_send_buffer_with_checksum(int length);
+void comm2_send_buffer_with_checksum(int length);
+int comm_format(char *dst, int maxlen, const char *fmt, ...);
+
+// Same framing on the second (wired) port. Only the telemetry task writes
+// uart2, so no semaphore guards this one; uart2 writes block until sent.
+static char comm2_buffer[COMM_BUFFER_LEN];
+#define printf2_checksum(T,...) \
+   comm2_send_buffer_with_checksum(comm_format(comm2_buffer, COMM_BUFFER_LEN, T, __VA_ARGS__))
 
 // Only write to output when the uart is available
 #define printf_checksum_direct(T,...) \
    if (xSemaphoreTake( xUart1Semaphore, 0 ) == pdTRUE) { \
-      comm_send_buffer_with_checksum(snprintf(comm_buffer, COMM_BUFFER_LEN, T, __VA_ARGS__)); \
+      comm_send_buffer_with_checksum(comm_format(comm_buffer, COMM_BUFFER_LEN, T, __VA_ARGS__)); \
       xSemaphoreGive( xUart1Semaphore ); \
       }
 
 // Write to output and wait at most 100ms until the semaphore becomes available
 #define printf_checksum(T,...) \
    if (xSemaphoreTake( xUart1Semaphore, ( portTickType ) 100 / portTICK_RATE_MS )  == pdTRUE) { \
-      comm_send_buffer_with_checksum(snprintf(comm_buffer, COMM_BUFFER_LEN, T, __VA_ARGS__)); \
+      comm_send_buffer_with_checksum(comm_format(comm_buffer, COMM_BUFFER_LEN, T, __VA_ARGS__)); \
       xSemaphoreGive( xUart1Semaphore ); \
       }
 
 // Write to output and wait at most 100ms until the semaphore becomes available
 #define printf_nochecksum(T,...) \
    if (xSemaphoreTake( xUart1Semaphore, ( portTickType ) 100 / portTICK_RATE_MS )  == pdTRUE) { \
-      printf(T, __VA_ARGS__); \
+      uart1_put(comm_buffer, comm_format(comm_buffer, COMM_BUFFER_LEN, T, __VA_ARGS__)); \
       xSemaphoreGive( xUart1Semaphore ); \
       }
 
 #define printf_nochecksum_direct(T,...) \
    if (xSemaphoreTake( xUart1Semaphore, ( portTickType ) 0 / portTICK_RATE_MS )  == pdTRUE) { \
-      printf(T, __VA_ARGS__); \
+      uart1_put(comm_buffer, comm_format(comm_buffer, COMM_BUFFER_LEN, T, __VA_ARGS__)); \
       xSemaphoreGive( xUart1Semaphore ); \
       }
 
 #define printf_message(T) \
 	if (xSemaphoreTake( xUart1Semaphore, ( portTickType ) 100 / portTICK_RATE_MS )  == pdTRUE) { \
-      printf(T); \
+      uart1_puts(T); \
       xSemaphoreGive( xUart1Semaphore ); \
       }
 
@@ -96,15 +134,177 @@ int check_checksum(char *s);
 
 xSemaphoreHandle xUart1Semaphore;
 
+// Approximate on-the-wire cost of each telemetry frame (payload plus
+// checksum framing); the telemetry task books these against the free
+// space in the uart1 transmit ring.
+#define FRAME_COST_ATTITUDE      48
+#define FRAME_COST_CONTROL       64
+#define FRAME_COST_GPSBASIC      72
+#define FRAME_COST_PPM           56
+#define FRAME_COST_GYROACCRAW    48
+#define FRAME_COST_GYROACCPROC   48
+#define FRAME_COST_PRESSURETEMP  24
+
+// Field type tables and frame descriptors expanded from the schema lists
+// in telemetry_frames.h; the serializer below walks these instead of a
+// per-frame format string, so the layout lives in the header only.
+#define TELEMETRY_FIELD_TYPE(name, ftype) ftype,
+#define TELEMETRY_FRAME_TABLE(tag) \
+	static const unsigned char telemetry_fields_##tag[] = { \
+		TELEMETRY_##tag##_FIELDS(TELEMETRY_FIELD_TYPE) };
+TELEMETRY_FRAME_LIST(TELEMETRY_FRAME_TABLE)
+
+struct telemetry_frame_desc
+{
+	const char *tag;
+	const unsigned char *types;
+	unsigned char nfields;
+};
+
+#define TELEMETRY_FRAME_DESC(tag) \
+	{ #tag, telemetry_fields_##tag, sizeof(telemetry_fields_##tag) },
+static const struct telemetry_frame_desc telemetry_frames[TELEMETRY_NUM_FRAMES] = {
+	TELEMETRY_FRAME_LIST(TELEMETRY_FRAME_DESC)
+};
+
+/*!
+ *  Serializes one telemetry frame into dst: the tag followed by every
+ *  field in schema order, each through the comm_format conversion its
+ *  TF_ type names. Returns the length, ready for the checksum senders.
+ */
+static int telemetry_format_frame(char *dst, int maxlen, enum telemetry_frame_id frame, const union telemetry_value *v)
+{
+	const struct telemetry_frame_desc *d = &telemetry_frames[frame];
+	int n = 0;
+	int i;
+
+	n += comm_format(&dst[n], maxlen - n, "%s", d->tag);
+	for (i = 0; i < d->nfields; i++)
+	{
+		switch (d->types[i])
+		{
+			case TF_D:
+				n += comm_format(&dst[n], maxlen - n, ";%d", v[i].d);
+				break;
+			case TF_U:
+				n += comm_format(&dst[n], maxlen - n, ";%u", v[i].u);
+				break;
+			case TF_LD:
+				n += comm_format(&dst[n], maxlen - n, ";%ld", v[i].ld);
+				break;
+			case TF_LU:
+				n += comm_format(&dst[n], maxlen - n, ";%lu", v[i].lu);
+				break;
+			case TF_F9:
+				n += comm_format(&dst[n], maxlen - n, ";%.9f", v[i].f);
+				break;
+			case TF_C:
+				n += comm_format(&dst[n], maxlen - n, ";%c", v[i].c);
+				break;
+		}
+	}
+	return n;
+}
+
+//! Frame out over the radio port; skipped when the uart is busy, like
+//! printf_checksum_direct.
+static void telemetry_send_frame(enum telemetry_frame_id frame, const union telemetry_value *v)
+{
+	if (xSemaphoreTake( xUart1Semaphore, 0 ) == pdTRUE)
+	{
+		comm_send_buffer_with_checksum(telemetry_format_frame(comm_buffer, COMM_BUFFER_LEN, frame, v));
+		xSemaphoreGive( xUart1Semaphore );
+	}
+}
+
+//! Frame out over the wired port (no semaphore: only the telemetry task
+//! writes uart2).
+static void telemetry2_send_frame(enum telemetry_frame_id frame, const union telemetry_value *v)
+{
+	comm2_send_buffer_with_checksum(telemetry_format_frame(comm2_buffer, COMM_BUFFER_LEN, frame, v));
+}
+
+// One fill helper per frame that goes out unchanged on both ports, so
+// the radio and the wired stream schedulers cannot disagree on content.
+static void telemetry_fill_attitude(union telemetry_value *v)
+{
+	v[TELEMETRY_TA_roll_mrad].d = (int)(sensor_data.roll*1000);
+	v[TELEMETRY_TA_pitch_mrad].d = (int)(sensor_data.pitch*1000);
+	v[TELEMETRY_TA_yaw_mrad].d = (int)(sensor_data.yaw*1000);
+}
+
+static void telemetry_fill_gps_basic(union telemetry_value *v)
+{
+	v[TELEMETRY_TG_status].c = '0' + (unsigned char)sensor_data.gps.status;
+	v[TELEMETRY_TG_latitude_rad].f = sensor_data.gps.latitude_rad;
+	v[TELEMETRY_TG_longitude_rad].f = sensor_data.gps.longitude_rad;
+	v[TELEMETRY_TG_speed_ms_10].u = (unsigned int)(sensor_data.gps.speed_ms*10);
+	v[TELEMETRY_TG_heading_rad_100].u = (unsigned int)(sensor_data.gps.heading_rad*100);
+	v[TELEMETRY_TG_satellites_in_view].u = (unsigned int)(sensor_data.gps.satellites_in_view);
+	v[TELEMETRY_TG_height_m].u = (unsigned int)(sensor_data.gps.height_m);
+}
+
+static void telemetry_fill_rc_input(union telemetry_value *v)
+{
+	int i;
+
+	for (i = 0; i < TELEMETRY_TT_NFIELDS; i++)
+		v[TELEMETRY_TT_channel_1 + i].u = (unsigned int)ppm.channel[i];
+}
+
+static void telemetry_fill_gyroacc_raw(union telemetry_value *v)
+{
+	v[TELEMETRY_TR_acc_x_raw].u = sensor_data.acc_x_raw;
+	v[TELEMETRY_TR_acc_y_raw].u = sensor_data.acc_y_raw;
+	v[TELEMETRY_TR_acc_z_raw].u = sensor_data.acc_z_raw;
+	v[TELEMETRY_TR_gyro_x_raw].u = sensor_data.gyro_x_raw;
+	v[TELEMETRY_TR_gyro_y_raw].u = sensor_data.gyro_y_raw;
+	v[TELEMETRY_TR_gyro_z_raw].u = sensor_data.gyro_z_raw;
+}
+
+static void telemetry_fill_gyroacc_proc(union telemetry_value *v)
+{
+	v[TELEMETRY_TP_acc_x_mg].d = (int)(sensor_data.acc_x*1000);
+	v[TELEMETRY_TP_acc_y_mg].d = (int)(sensor_data.acc_y*1000);
+	v[TELEMETRY_TP_acc_z_mg].d = (int)(sensor_data.acc_z*1000);
+	v[TELEMETRY_TP_p_mrad_s].d = (int)(sensor_data.p*1000);
+	v[TELEMETRY_TP_q_mrad_s].d = (int)(sensor_data.q*1000);
+	v[TELEMETRY_TP_r_mrad_s].d = (int)(sensor_data.r*1000);
+}
+
+static void telemetry_fill_pressure_temp(union telemetry_value *v)
+{
+	v[TELEMETRY_TH_pressure_pa].lu = (unsigned long)(sensor_data.pressure);
+	v[TELEMETRY_TH_temperature].d = (int)sensor_data.temperature;
+}
+
+// Link supervisor. The uplink shares the XBee with the downlink, so the
+// checksum verdict of every received $..* console line doubles as a probe
+// of link health: a lossy radio corrupts both directions alike. The
+// telemetry task evaluates a window every 5s and doubles the effective
+// stream dividers while lines keep arriving corrupted, halving again on
+// every clean window. Fewer complete frames carry more information than
+// many mangled ones, which is all a degrading link can deliver.
+#define LINK_WINDOW_TICKS     50   // counted in the 10Hz telemetry loop: 5s
+#define LINK_THROTTLE_MAX      8
+static volatile unsigned int link_lines_ok = 0;
+static volatile unsigned int link_lines_bad = 0;
+static int link_throttle = 1;
+
 /*!
  *    This task will send telemetry directly to uart1 at a rate of maximum 
  *    20 times a second.
  *
- *    Used stackspace: 356 / 860 bytes
+ *    Stack usage: see the TW telemetry line (or the CW command) for live
+ *    high-water marks of all tasks; the sizes in rtos_pilot.c were set by
+ *    hand and the old figures here went stale.
  */
 void communication_telemetry_task( void *parameters )
 {
+	static int boot_stats_printed = 0;
 	int c = 0;
+	int budget;
+	int hb;
 	struct TelemetryConfig counters;
 		
 	/* Used to wake the task at the correct frequency. */
@@ -113,7 +313,10 @@ void communication_telemetry_task( void *parameters )
 
 	uart1_puts("Telemetry task initializing...");
 	vTaskSetApplicationTaskTag( NULL, ( void * ) 6 );
-	vSemaphoreCreateBinary(xUart1Semaphore);
+	// Mutex, not a binary semaphore: a priority-2 task formatting telemetry
+	// inherits the console task's priority while the latter waits for uart1,
+	// instead of being preempted mid-hold (multi-ms telemetry stalls)
+	xUart1Semaphore = xSemaphoreCreateMutex();
 	
 	counters.stream_PPM = 0;
 	counters.stream_GyroAccRaw = 0;
@@ -122,6 +325,20 @@ void communication_telemetry_task( void *parameters )
 	counters.stream_GpsBasic = 0;
 	counters.stream_Control = 0;
 	counters.stream_Attitude = 0;
+	counters.stream2_GpsBasic = 0;
+	counters.stream2_GyroAccRaw = 0;
+	counters.stream2_GyroAccProc = 0;
+	counters.stream2_PPM = 0;
+	counters.stream2_PressureTemp = 0;
+	counters.stream2_Attitude = 0;
+
+	if (telemetry_uart2_enabled())   // the gps task saw the same flag and left the port alone
+	{
+		uart2_open(115200l);
+		uart2_puts("Wired telemetry port\r\n");
+	}
+	else if (config.telemetry.mirror == MIRROR_PRIMARY)
+		uart2_open(MIRROR_BAUDRATE);   // redundancy link to the backup board
 	
 	uart1_puts("done\r\n");
 	
@@ -134,10 +351,20 @@ void communication_telemetry_task( void *parameters )
 
 	/* Initialise xLastExecutionTime so the first call to vTaskDelayUntil() works correctly. */
 	xLastExecutionTime = xTaskGetTickCount();
+	hb = heartbeat_register("Telemetry", 2000);   // nominal 100ms, but the XBee reset guard times block for 2s
 	
 	for( ;; )
 	{
 		vTaskDelayUntil( &xLastExecutionTime, ( ( portTickType ) 100 / portTICK_RATE_MS ) );  // 10Hz
+		heartbeat_checkin(hb);
+		cpuload_update();   // single writer of the load window, see cpuload.h
+
+		if (! boot_stats_printed && bootstats_complete())
+		{
+			print_boot_stats();   // one summary, as soon as the last phase closes
+			boot_stats_printed = 1;
+		}
+
 		counters.stream_PPM++;
 		counters.stream_GyroAccRaw++;
 		counters.stream_GyroAccProc++;
@@ -145,12 +372,58 @@ void communication_telemetry_task( void *parameters )
 		counters.stream_GpsBasic++;
 		counters.stream_Attitude++;
 		counters.stream_Control++;
+		counters.stream2_GpsBasic++;
+		counters.stream2_GyroAccRaw++;
+		counters.stream2_GyroAccProc++;
+		counters.stream2_PPM++;
+		counters.stream2_PressureTemp++;
+		counters.stream2_Attitude++;
+
+		if (config.telemetry.mirror == MIRROR_PRIMARY)
+			mirror_send_state();   // 10Hz state frame to the backup board, uart2
+
+		budget = uart1_tx_free();   // this tick's byte budget
 		
 		if (c++ % 5 == 0)  // this counter will never be used at 20Hz
 			led1_on();
 		else
 			led1_off();
 
+		if (c % 50 == 0)  // every 5s; also keeps the profiler's deltas well within 32 bit
+			print_cpu_load();
+
+		if (c % 300 == 150)  // every 30s, offset from the TU line: high-water marks move slowly
+			print_stack_usage();
+
+		if (c % 300 == 75)  // every 30s, offset from the TU/TW reports
+			print_task_health();
+
+		if (c % LINK_WINDOW_TICKS == 25)  // offset from the TU and TW lines
+		{
+			unsigned int ok = link_lines_ok, bad = link_lines_bad;
+			int throttle_was = link_throttle;
+			link_lines_ok = 0;
+			link_lines_bad = 0;
+			if (bad > 0 && bad * 4 >= ok)   // over ~20% of the window's lines corrupted
+			{
+				if (link_throttle < LINK_THROTTLE_MAX)
+					link_throttle *= 2;
+			}
+			else if (bad == 0 && link_throttle > 1)   // clean (or silent) window
+				link_throttle /= 2;
+			if (link_throttle != throttle_was)
+				printf_checksum_direct("LS;%d;%u;%u", link_throttle, ok, bad);
+		}
+
+		if (vibration_ready())  // a CV burst finished capturing in the sensor task
+			print_vibration();
+
+		{   // a link benchmark run (BE command) just finished
+			unsigned long bench_sent, bench_ms;
+			if (comm_binary_bench_done(&bench_sent, &bench_ms))
+				printf_checksum_direct("BE;%lu;%lu", bench_sent, bench_ms);
+		}
+
 #ifdef ENABLE_XBEE_RESET
 		if (c % 3000 == 0) // reset Xbee every 5 minutes to prevent a lock-up (duty cycle)
 		{
@@ -174,98 +447,51 @@ void communication_telemetry_task( void *parameters )
 			printf_message("!!! Panic: Battery low !!!\r\n");
 			battery_alarm.alarm_battery_panic++; // an ugly hack to make sure it's never printed again
 		}
-				
-		///////////////////////////////////////////////////////////////
-		//               GYRO AND ACCELEROMETER RAW                  //
-		///////////////////////////////////////////////////////////////
-		if (counters.stream_GyroAccRaw == config.telemetry.stream_GyroAccRaw)
-		{
-			printf_checksum_direct("TR;%u;%u;%u;%u;%u;%u", (sensor_data.acc_x_raw), (sensor_data.acc_y_raw),
-			                                    (sensor_data.acc_z_raw), (sensor_data.gyro_x_raw),
-			                                    (sensor_data.gyro_y_raw), (sensor_data.gyro_z_raw));
-			counters.stream_GyroAccRaw = 0;
-		} 
-		else if (counters.stream_GyroAccRaw > config.telemetry.stream_GyroAccRaw)
-			counters.stream_GyroAccRaw = 0;
-		
-		///////////////////////////////////////////////////////////////
-		//            GYRO AND ACCELEROMETER PROCESSED              //
-		///////////////////////////////////////////////////////////////
-		if (counters.stream_GyroAccProc == config.telemetry.stream_GyroAccProc)
+		else if (flashcheck.alarm_pending == 1)
 		{
-			printf_checksum_direct("TP;%d;%d;%d;%d;%d;%d", (int)(sensor_data.acc_x*1000), (int)(sensor_data.acc_y*1000),
-			                                        (int)(sensor_data.acc_z*1000), (int)(sensor_data.p*1000),
-			                                        (int)(sensor_data.q*1000), (int)(sensor_data.r*1000));
-		}	
-		else if (counters.stream_GyroAccProc > config.telemetry.stream_GyroAccProc)
-			counters.stream_GyroAccProc = 0;
-		
+			// also printed once; the CF console line carries the counters
+			printf_message("!!! Panic: Program flash CRC mismatch !!!\r\n");
+			flashcheck.alarm_pending++;
+		}
+				
+		// The streams go out in priority order against the byte budget the
+		// transmit ring has left. When the link degrades it is the frames at
+		// the bottom of this list that wait, never the attitude frame; a
+		// deferred stream stays due and is retried on the next tick.
 		///////////////////////////////////////////////////////////////
 		//                         ATTITUDE                          //
-		///////////////////////////////////////////////////////////////	
-		if (counters.stream_Attitude == config.telemetry.stream_Attitude)
+		///////////////////////////////////////////////////////////////
+		if (config.telemetry.stream_Attitude > 0 && counters.stream_Attitude >= config.telemetry.stream_Attitude * link_throttle && budget >= FRAME_COST_ATTITUDE)
 		{
             int *t = (int*)&sensor_data.pitch;
+			union telemetry_value v[TELEMETRY_TA_NFIELDS];
 
-			printf_checksum_direct("TA;%d;%d;%d;%x;%x", (int)(sensor_data.roll*1000), (int)(sensor_data.pitch*1000), (int)(sensor_data.yaw*1000), t[1], t[0]);
+			telemetry_fill_attitude(v);
+			if (config.telemetry.use_binary)
+				comm_binary_send_attitude();
+			else if (xSemaphoreTake( xUart1Semaphore, 0 ) == pdTRUE)
+			{
+				// the two raw words of the pitch float ride behind the
+				// schema'd fields for debugging; GluonCS ignores trailers
+				int n = telemetry_format_frame(comm_buffer, COMM_BUFFER_LEN, TELEMETRY_FRAME_TA, v);
+				n += comm_format(&comm_buffer[n], COMM_BUFFER_LEN - n, ";%x;%x", t[1], t[0]);
+				comm_send_buffer_with_checksum(n);
+				xSemaphoreGive( xUart1Semaphore );
+			}
 
 			if (control_state.simulation_mode)
 			{
 				printf_checksum_direct("TS;%d;%d;%d", servo_read_us(2), servo_read_us(0), servo_read_us(3));
 			}
 			counters.stream_Attitude = 0;
+			budget -= FRAME_COST_ATTITUDE;
 		} 
-		else if (counters.stream_Attitude > config.telemetry.stream_Attitude)
-			counters.stream_Attitude = 0;
-			
-		///////////////////////////////////////////////////////////////
-		//           SCP1000: PRESSURE & TEMPERATURE                 //
-		///////////////////////////////////////////////////////////////
-		if (counters.stream_PressureTemp == config.telemetry.stream_PressureTemp)
-		{
-			printf_checksum_direct("TH;%lu;%d", (unsigned long)(sensor_data.pressure), (int)sensor_data.temperature);
-			counters.stream_PressureTemp = 0;
-		}
-		else if (counters.stream_PressureTemp > config.telemetry.stream_PressureTemp)
-			counters.stream_PressureTemp = 0;
 		
-		///////////////////////////////////////////////////////////////
-		//                   RC TRANSMITTER INPUT                    //
-		///////////////////////////////////////////////////////////////
-		if (counters.stream_PPM == config.telemetry.stream_PPM)
-		{
-			//vTaskGetRunTimeStats( buffer );
-			//uart1_puts(buffer);
-			printf_checksum_direct("TT;%u;%u;%u;%u;%u;%u;%u;%u", (unsigned int)ppm.channel[0], (unsigned int)ppm.channel[1],
-			                                          (unsigned int)ppm.channel[2], (unsigned int)ppm.channel[3],
-			                                          (unsigned int)ppm.channel[4], (unsigned int)ppm.channel[5],
-			                                          (unsigned int)ppm.channel[6], (unsigned int)ppm.channel[7]);
-			counters.stream_PPM = 0;
-		}
-		else if (counters.stream_PPM > config.telemetry.stream_PPM)
-			counters.stream_PPM = 0;
-		
-		///////////////////////////////////////////////////////////////
-		//                        GPS BASIC                          //
-		///////////////////////////////////////////////////////////////
-		if (counters.stream_GpsBasic == config.telemetry.stream_GpsBasic)
-		{
-			printf_checksum_direct("TG;%c;%.9f;%.9f;%u;%u;%u;%u", '0' + (unsigned char)sensor_data.gps.status,
-			                                            sensor_data.gps.latitude_rad, sensor_data.gps.longitude_rad,
-			                                            (unsigned int)(sensor_data.gps.speed_ms*10),
-			                                            (unsigned int)(sensor_data.gps.heading_rad*100),
-			                                            (unsigned int)(sensor_data.gps.satellites_in_view),
-			                                            (unsigned int)(sensor_data.gps.height_m));
-			counters.stream_GpsBasic = 0;
-		}
-		else if (counters.stream_GpsBasic > config.telemetry.stream_GpsBasic)
-			counters.stream_GpsBasic = 0;
-			
 		///////////////////////////////////////////////////////////////
 		//                          CONTROL                          //
 		///////////////////////////////////////////////////////////////
-		//printf("TC;CONTROL_STATUS;LINE;HEIGHT(;CARROTX;CARROTY;CARROTH)");
-		if (counters.stream_Control == config.telemetry.stream_Control)
+		//uart1_printf("TC;CONTROL_STATUS;LINE;HEIGHT(;CARROTX;CARROTY;CARROTH)");
+		if (config.telemetry.stream_Control > 0 && counters.stream_Control >= config.telemetry.stream_Control * link_throttle && budget >= FRAME_COST_CONTROL)
 		{
 			int sig_quality = 0;
 			if (config.control.use_pwm)
@@ -282,7 +508,7 @@ void communication_telemetry_task( void *parameters )
 				throttle = -throttle;
 			if (throttle < 0 || throttle > 100)
 				throttle = 0;
-			//printf("\r\n %d %d\r\n", config.control.servo_neutral[3], (int)servo_read_us(3));
+			//uart1_printf("\r\n %d %d\r\n", config.control.servo_neutral[3], (int)servo_read_us(3));
 			
             int altitude;
             if (config.control.altitude_mode == GPS_ABSOLUTE)
@@ -292,26 +518,184 @@ void communication_telemetry_task( void *parameters )
             else //if (config.control.altitude_mode == PRESSURE)
                 altitude = (int)(sensor_data.pressure_height - navigation_data.home_pressure_height);
             
-			printf_checksum_direct("TC;%d;%d;%d;%u;%d;%d;%d;%d;%d;%d;%u", (int)control_state.flight_mode,
-			       gluonscript_data.current_codeline, altitude,
-			       sensor_data.battery1_voltage_10,
-			       navigation_data.time_airborne_s, navigation_data.time_block_s,
-			       sig_quality, throttle, (int)navigation_data.desired_altitude_agl,
-                   sensor_data.battery2_voltage_10,(unsigned int)(sensor_data.battery1_mAh/10.0));
+			if (config.telemetry.use_binary)
+				comm_binary_send_control(altitude, sig_quality, throttle);
+			else
+			{
+				union telemetry_value v[TELEMETRY_TC_NFIELDS];
+
+				v[TELEMETRY_TC_flight_mode].d = (int)control_state.flight_mode;
+				v[TELEMETRY_TC_navigation_line].d = gluonscript_data.current_codeline;
+				v[TELEMETRY_TC_altitude_m].d = altitude;
+				v[TELEMETRY_TC_batt1_voltage_10].u = sensor_data.battery1_voltage_10;
+				v[TELEMETRY_TC_flight_time_s].d = navigation_data.time_airborne_s;
+				v[TELEMETRY_TC_block_time_s].d = navigation_data.time_block_s;
+				v[TELEMETRY_TC_rc_link_pct].d = sig_quality;
+				v[TELEMETRY_TC_throttle_pct].d = throttle;
+				v[TELEMETRY_TC_target_altitude_agl_m].d = (int)navigation_data.desired_altitude_agl;
+				v[TELEMETRY_TC_batt2_voltage_10].u = sensor_data.battery2_voltage_10;
+				v[TELEMETRY_TC_batt1_mah_10].u = (unsigned int)(sensors_battery1_mAh()/10.0);
+				v[TELEMETRY_TC_cpu_pct].u = (unsigned int)cpuload_percent();
+				telemetry_send_frame(TELEMETRY_FRAME_TC, v);
+			}
 			 
 			counters.stream_Control = 0;
+			budget -= FRAME_COST_CONTROL;
 			//printf_checksum_poll("-- %lu --", idle_counter);
             //idle_counter = 0;
 			//printf_checksum_poll("-- %lu --", idle_counter);
 		}
-		else if (counters.stream_Control > config.telemetry.stream_Control)
-			counters.stream_Control = 0;
+		
+		///////////////////////////////////////////////////////////////
+		//                        GPS BASIC                          //
+		///////////////////////////////////////////////////////////////
+		if (config.telemetry.stream_GpsBasic > 0 && counters.stream_GpsBasic >= config.telemetry.stream_GpsBasic * link_throttle && budget >= FRAME_COST_GPSBASIC)
+		{
+			if (config.telemetry.use_binary)
+				comm_binary_send_gps_basic();
+			else
+			{
+				union telemetry_value v[TELEMETRY_TG_NFIELDS];
+
+				telemetry_fill_gps_basic(v);
+				telemetry_send_frame(TELEMETRY_FRAME_TG, v);
+			}
+			counters.stream_GpsBasic = 0;
+			budget -= FRAME_COST_GPSBASIC;
+		}
+		
+		///////////////////////////////////////////////////////////////
+		//                   RC TRANSMITTER INPUT                    //
+		///////////////////////////////////////////////////////////////
+		if (config.telemetry.stream_PPM > 0 && counters.stream_PPM >= config.telemetry.stream_PPM * link_throttle && budget >= FRAME_COST_PPM)
+		{
+			//vTaskGetRunTimeStats( buffer );
+			//uart1_puts(buffer);
+			union telemetry_value v[TELEMETRY_TT_NFIELDS];
+
+			telemetry_fill_rc_input(v);
+			telemetry_send_frame(TELEMETRY_FRAME_TT, v);
+			counters.stream_PPM = 0;
+			budget -= FRAME_COST_PPM;
+		}
+		
+		///////////////////////////////////////////////////////////////
+		//               GYRO AND ACCELEROMETER RAW                  //
+		///////////////////////////////////////////////////////////////
+		if (config.telemetry.stream_GyroAccRaw > 0 && counters.stream_GyroAccRaw >= config.telemetry.stream_GyroAccRaw * link_throttle && budget >= FRAME_COST_GYROACCRAW)
+		{
+			union telemetry_value v[TELEMETRY_TR_NFIELDS];
+
+			telemetry_fill_gyroacc_raw(v);
+			telemetry_send_frame(TELEMETRY_FRAME_TR, v);
+			counters.stream_GyroAccRaw = 0;
+			budget -= FRAME_COST_GYROACCRAW;
+		} 
+		
+		///////////////////////////////////////////////////////////////
+		//            GYRO AND ACCELEROMETER PROCESSED              //
+		///////////////////////////////////////////////////////////////
+		if (config.telemetry.stream_GyroAccProc > 0 && counters.stream_GyroAccProc >= config.telemetry.stream_GyroAccProc * link_throttle && budget >= FRAME_COST_GYROACCPROC)
+		{
+			union telemetry_value v[TELEMETRY_TP_NFIELDS];
+
+			telemetry_fill_gyroacc_proc(v);
+			telemetry_send_frame(TELEMETRY_FRAME_TP, v);
+			counters.stream_GyroAccProc = 0;
+			budget -= FRAME_COST_GYROACCPROC;
+		}	
+		
+		///////////////////////////////////////////////////////////////
+		//           SCP1000: PRESSURE & TEMPERATURE                 //
+		///////////////////////////////////////////////////////////////
+		if (config.telemetry.stream_PressureTemp > 0 && counters.stream_PressureTemp >= config.telemetry.stream_PressureTemp * link_throttle && budget >= FRAME_COST_PRESSURETEMP)
+		{
+			union telemetry_value v[TELEMETRY_TH_NFIELDS];
+
+			telemetry_fill_pressure_temp(v);
+			telemetry_send_frame(TELEMETRY_FRAME_TH, v);
+			counters.stream_PressureTemp = 0;
+			budget -= FRAME_COST_PRESSURETEMP;
+		}
+
+		///////////////////////////////////////////////////////////////
+		//                LINK BENCHMARK (BE command)                 //
+		///////////////////////////////////////////////////////////////
+		// Last in line on purpose: the test frames only get the budget
+		// the real streams left over, so a benchmark run measures the
+		// link as the configured telemetry actually loads it.
+		budget -= comm_binary_bench_tick(budget);
+
+		///////////////////////////////////////////////////////////////
+		//           SECOND PORT (wired console on uart2)            //
+		///////////////////////////////////////////////////////////////
+		// The wired port has no XBee behind it, so there is no byte
+		// budget to book against: a full set of lines takes about 20ms
+		// of blocking uart2 writes at 115200 baud, well inside the tick.
+		if (telemetry_uart2_enabled())
+		{
+			if (config.telemetry.stream2_Attitude > 0 && counters.stream2_Attitude >= config.telemetry.stream2_Attitude)
+			{
+				union telemetry_value v[TELEMETRY_TA_NFIELDS];
+
+				telemetry_fill_attitude(v);
+				telemetry2_send_frame(TELEMETRY_FRAME_TA, v);
+				counters.stream2_Attitude = 0;
+			}
+			if (config.telemetry.stream2_GyroAccRaw > 0 && counters.stream2_GyroAccRaw >= config.telemetry.stream2_GyroAccRaw)
+			{
+				union telemetry_value v[TELEMETRY_TR_NFIELDS];
+
+				telemetry_fill_gyroacc_raw(v);
+				telemetry2_send_frame(TELEMETRY_FRAME_TR, v);
+				counters.stream2_GyroAccRaw = 0;
+			}
+			if (config.telemetry.stream2_GyroAccProc > 0 && counters.stream2_GyroAccProc >= config.telemetry.stream2_GyroAccProc)
+			{
+				union telemetry_value v[TELEMETRY_TP_NFIELDS];
+
+				telemetry_fill_gyroacc_proc(v);
+				telemetry2_send_frame(TELEMETRY_FRAME_TP, v);
+				counters.stream2_GyroAccProc = 0;
+			}
+			if (config.telemetry.stream2_PPM > 0 && counters.stream2_PPM >= config.telemetry.stream2_PPM)
+			{
+				union telemetry_value v[TELEMETRY_TT_NFIELDS];
+
+				telemetry_fill_rc_input(v);
+				telemetry2_send_frame(TELEMETRY_FRAME_TT, v);
+				counters.stream2_PPM = 0;
+			}
+			if (config.telemetry.stream2_PressureTemp > 0 && counters.stream2_PressureTemp >= config.telemetry.stream2_PressureTemp)
+			{
+				union telemetry_value v[TELEMETRY_TH_NFIELDS];
+
+				telemetry_fill_pressure_temp(v);
+				telemetry2_send_frame(TELEMETRY_FRAME_TH, v);
+				counters.stream2_PressureTemp = 0;
+			}
+			if (config.telemetry.stream2_GpsBasic > 0 && counters.stream2_GpsBasic >= config.telemetry.stream2_GpsBasic)
+			{
+				// no gps fixes come in while the gps task is parked, but the
+				// dead-reckoned position keeps moving in simulation mode
+				union telemetry_value v[TELEMETRY_TG_NFIELDS];
+
+				telemetry_fill_gps_basic(v);
+				telemetry2_send_frame(TELEMETRY_FRAME_TG, v);
+				counters.stream2_GpsBasic = 0;
+			}
+		}
 
 	}
 }
 
+int telemetry_uart2_enabled()
+{
+	return config.telemetry.stream2_GpsBasic > 0 || config.telemetry.stream2_GyroAccRaw > 0 ||
+	       config.telemetry.stream2_GyroAccProc > 0 || config.telemetry.stream2_PPM > 0 ||
+	       config.telemetry.stream2_PressureTemp > 0 || config.telemetry.stream2_Attitude > 0;
+}
 
-extern xQueueHandle xRxedChars;
 
 #define MAX_TOKEN 10
 
@@ -342,24 +726,36 @@ void communication_input_task( void *parameters )
 	
 	for( ;; )
 	{
-		/* Wait until it is time for the next cycle. */
-		if( xQueueReceive( xRxedChars, &tmp, portMAX_DELAY  ) )
+		/* Bytes arrive in bursts: one wakeup per received line instead of
+		   one per character. The 20ms backstop covers binary uplink frames,
+		   which end without a newline for the ISR to signal on. */
+		if( uart1_queue_getc( &tmp, 20 / portTICK_RATE_MS ) )
         {           
+            // Binary uplink frames (HIL injection, flightplan upload) share
+            // this port with the console. They are only recognized between
+            // console lines: a 'G' inside a half-assembled $..* line belongs
+            // to that line, not to a frame sync.
+            if ((comm_binary_active() || buffer_position == 0) &&
+                comm_binary_receive_char((unsigned char)tmp))
+                continue;
+
             if (tmp == '\n' || tmp == '\r')
             {
 	            buffer[buffer_position] = '\0';
-	            //printf("\r\nChecking checksum: %s\r\n", buffer);
+	            //uart1_printf("\r\nChecking checksum: %s\r\n", buffer);
 	            if (buffer[0] == '$')  // with checksum
 	            {
 		        	if (check_checksum(buffer))
 		        	{
                         with_checksum = 1;
+                        link_lines_ok++;
 			        	buffer[0] = buffer[1];
 			        	buffer[1] = buffer[2];
 			        } 
                     else
                     {
                         with_checksum = 0;
+                        link_lines_bad++;   // the link supervisor reads this
                     }
 		        }
                 else
@@ -374,13 +770,12 @@ void communication_input_task( void *parameters )
                     {
                         printf_nochecksum_direct("Data with invalid or no checksum received: %s\r\n", buffer);
                     }
-                    // first handle all navigation
-                    else if (c2 == 'N')
+                    else switch (COMMAND_CODE(c1, c2))  // the compiler turns this into a dispatch table: one jump instead of a compare chain
                     {
                         ///////////////////////////////////////////////////////////////
                         //                      WRITE NAVIGATION                     //
                         ///////////////////////////////////////////////////////////////
-                        if (c1 == 'W')
+                        case COMMAND_CODE('W','N'):
                         {
                             int i = atoi(&(buffer[token[1]])) - 1;
 
@@ -398,6 +793,7 @@ void communication_input_task( void *parameters )
 
                                 if (navigation_data.relative_positions_calculated)
                                     navigation_calculate_relative_position(i);
+                                navigation_calculate_leg_cache();   // cheap enough per uploaded line
 
                                 // confirm by sending it back...
                                 printf_checksum("ND;%d;%d;%f;%f;%d;%d", i+1, gluonscript_data.codes[i].opcode,
@@ -405,44 +801,115 @@ void communication_input_task( void *parameters )
                                                 gluonscript_data.codes[i].a, gluonscript_data.codes[i].b);
                             }
         #endif
+                            break;
+                        }
+                        ///////////////////////////////////////////////////////////////
+                        //                    WRITE FENCE VERTEX                     //
+                        ///////////////////////////////////////////////////////////////
+                        case COMMAND_CODE('W','F'):   // WF;index;latitude_rad;longitude_rad
+                        {
+                            int i = atoi(&(buffer[token[1]])) - 1;
+                            if (i >= 0 && i < GEOFENCE_MAX_POINTS)
+                            {
+                                float lat = atof(&(buffer[token[2]]));
+                                float lon = atof(&(buffer[token[3]]));
+                                geofence_set_point(i, lat, lon);
+                                // confirm by sending it back...
+                                printf_checksum("FD;%d;%f;%f", i+1, lat, lon);
+                            }
+                            break;
+                        }
+                        ///////////////////////////////////////////////////////////////
+                        //                      COMPILE GEOFENCE                     //
+                        ///////////////////////////////////////////////////////////////
+                        case COMMAND_CODE('F','G'):   // FG;point_count;target_codeline -- FG;0;0 disarms
+                        {
+                            int count = atoi(&(buffer[token[1]]));
+                            int target = atoi(&(buffer[token[2]]));
+                            if (geofence_compile(count, target) == 0)
+                                printf_checksum("FG;%d;%d", count, target);
+                            else
+                                printf_message("\r\nGeofence needs 3..32 points\r\n");
+                            break;
                         }
                         ///////////////////////////////////////////////////////////////
                         //                 JUMP TO NAVIGATION LINE                   //
                         ///////////////////////////////////////////////////////////////
-                        else if (c1 == 'J')
+                        case COMMAND_CODE('J','N'):
                         {
                             int number = atoi(&(buffer[token[1]]));
                             gluonscript_goto_from_gcs(number);
+                            break;
                         }
                         ///////////////////////////////////////////////////////////////
                         //                       BURN NAVIGATION                     //
                         ///////////////////////////////////////////////////////////////
-                        else if (c1 == 'F')
+                        case COMMAND_CODE('F','N'):
                         {
                             gluonscript_burn();
                             printf_message("\r\nScript burned to flash\r\n");
+                            break;
                         }
                         ///////////////////////////////////////////////////////////////
                         //                       LOAD NAVIGATION                     //
                         ///////////////////////////////////////////////////////////////
-                        else if (c1 == 'L')
+                        case COMMAND_CODE('L','N'):
                         {
                             gluonscript_load();
                             if (navigation_data.relative_positions_calculated)
-                                navigation_calculate_relative_positions();
+                                navigation_calculate_relative_positions();   // also rebuilds the leg cache
+                            else
+                                navigation_calculate_leg_cache();
+                            break;
                         }
                         ///////////////////////////////////////////////////////////////
                         //                       READ NAVIGATION                     //
                         ///////////////////////////////////////////////////////////////
-                        else if (c1 == 'R')
+                        case COMMAND_CODE('R','N'):
                         {
                             print_navigation();
+                            break;
+                        }
+                        ///////////////////////////////////////////////////////////////
+                        //                      LINK BENCHMARK                       //
+                        ///////////////////////////////////////////////////////////////
+                        case COMMAND_CODE('B','E'):   // BE;rate_hz;seconds;filler_bytes -- BE;0;0;0 aborts
+                        {
+                            comm_binary_bench_start((unsigned int)atoi(&(buffer[token[1]])),
+                                                    (unsigned int)atoi(&(buffer[token[2]])),
+                                                    (unsigned char)atoi(&(buffer[token[3]])));
+                            break;
+                        }
+                        ///////////////////////////////////////////////////////////////
+                        //                      VERIFY NAVIGATION                    //
+                        ///////////////////////////////////////////////////////////////
+                        case COMMAND_CODE('V','N'):
+                        {
+                            // Crc16 over the exact "ND;..." payloads print_navigation()
+                            // would send; the groundstation caches those strings verbatim
+                            // from the confirmations and mirrors this crc, so verifying a
+                            // diff upload costs one frame instead of a full re-read.
+                            // comm_buffer is shared with the printf_* macros, hence the
+                            // semaphore around the formatting loop.
+                            unsigned int crc = 0xffff;
+                            int i;
+                            if (xSemaphoreTake( xUart1Semaphore, ( portTickType ) 100 / portTICK_RATE_MS ) == pdTRUE)
+                            {
+                                for (i = 0; i < MAX_GLUONSCRIPTCODES; i++)
+                                    crc = configuration_crc_update(crc, (unsigned char*)comm_buffer,
+                                        comm_format(comm_buffer, COMM_BUFFER_LEN, "ND;%d;%d;%f;%f;%d;%d",
+                                            i+1, gluonscript_data.codes[i].opcode,
+                                            gluonscript_data.codes[i].x, gluonscript_data.codes[i].y,
+                                            gluonscript_data.codes[i].a, gluonscript_data.codes[i].b));
+                                xSemaphoreGive( xUart1Semaphore );
+                            }
+                            printf_checksum("NH;%u;%d", crc, MAX_GLUONSCRIPTCODES);
+                            break;
                         }
-                    }
                     ///////////////////////////////////////////////////////////////
                     //                       SET CONTROL                         //
                     ///////////////////////////////////////////////////////////////
-                    else if (c1 == 'S' && c2 == 'C')    // Set control
+                    case COMMAND_CODE('S','C'):    // Set control
                     {
                         config.control.servo_mix = (buffer[token[1] + 0]) - '0';
                         config.control.max_pitch = atof(&(buffer[token[2]])) / 180.0 * 3.14;
@@ -456,85 +923,115 @@ void communication_input_task( void *parameters )
                         config.control.altitude_mode = atoi(&(buffer[token[9]]));
                         if (config.control.altitude_mode < 1 || config.control.altitude_mode > 3)
                             config.control.altitude_mode = 1;
+                        control_precompute_mix();
+                        break;
                     }
                     ///////////////////////////////////////////////////////////////
                     //                  SET GPS CONFIGURATION                    //
                     ///////////////////////////////////////////////////////////////
-                    else if (c1 == 'S' && c2 == 'G')    // Set GPS
+                    case COMMAND_CODE('S','G'):    // Set GPS
                     {
-                        unsigned int x;
-                        sscanf(&(buffer[token[1]]), "%u", &x);
-                        config.gps.initial_baudrate = (long)x * 10;
+                        config.gps.initial_baudrate = atol(&(buffer[token[1]])) * 10;
                         config.gps.operational_baudrate = 0;
                         if (buffer[token[2]] == '1')
                             config.gps.enable_waas = 1;
                         else
                             config.gps.enable_waas = 0;
+                        break;
                     }
                     ///////////////////////////////////////////////////////////////
                     //                 SET PID PITCH 2 ELEVATOR                  //
                     ///////////////////////////////////////////////////////////////
-                    else if (c1 == 'P' && c2 == 'P')    // Set PID
+                    case COMMAND_CODE('P','P'):    // Set PID
                     {
-                        config.control.pid_pitch2elevator.p_gain = (float)atof(&(buffer[token[1]]));
-                        config.control.pid_pitch2elevator.i_gain = (float)atof(&(buffer[token[2]]));
-                        config.control.pid_pitch2elevator.d_gain = (float)atof(&(buffer[token[3]]));
-                        config.control.pid_pitch2elevator.i_min = (float)atof(&(buffer[token[4]]));
-                        config.control.pid_pitch2elevator.i_max = (float)atof(&(buffer[token[5]]));
-                        config.control.pid_pitch2elevator.d_term_min_var = (float)atof(&(buffer[token[6]]));
+                        // Parsed into a local and staged: the control task
+                        // swaps the gains in at its next loop boundary, so a
+                        // cycle never runs on a half-applied set. RAM only;
+                        // FC persists to flash separately.
+                        struct pid gains;
+                        gains.p_gain = (float)atof(&(buffer[token[1]]));
+                        gains.i_gain = (float)atof(&(buffer[token[2]]));
+                        gains.d_gain = (float)atof(&(buffer[token[3]]));
+                        gains.i_min = (float)atof(&(buffer[token[4]]));
+                        gains.i_max = (float)atof(&(buffer[token[5]]));
+                        gains.d_term_min_var = (float)atof(&(buffer[token[6]]));
+                        control_stage_pid(CONTROL_PID_PITCH, &gains);
+                        break;
                     }
                     ///////////////////////////////////////////////////////////////
                     //                  SET PID ROLL 2 AILERON                   //
                     ///////////////////////////////////////////////////////////////
-                    else if (c1 == 'P' && c2 == 'R')    // Set PID
+                    case COMMAND_CODE('P','R'):    // Set PID
                     {
-                        config.control.pid_roll2aileron.p_gain = (float)atof(&(buffer[token[1]]));
-                        config.control.pid_roll2aileron.i_gain = (float)atof(&(buffer[token[2]]));
-                        config.control.pid_roll2aileron.d_gain = (float)atof(&(buffer[token[3]]));
-                        config.control.pid_roll2aileron.i_min = (float)atof(&(buffer[token[4]]));
-                        config.control.pid_roll2aileron.i_max = (float)atof(&(buffer[token[5]]));
-                        config.control.pid_roll2aileron.d_term_min_var = (float)atof(&(buffer[token[6]]));
+                        // Parsed into a local and staged: the control task
+                        // swaps the gains in at its next loop boundary, so a
+                        // cycle never runs on a half-applied set. RAM only;
+                        // FC persists to flash separately.
+                        struct pid gains;
+                        gains.p_gain = (float)atof(&(buffer[token[1]]));
+                        gains.i_gain = (float)atof(&(buffer[token[2]]));
+                        gains.d_gain = (float)atof(&(buffer[token[3]]));
+                        gains.i_min = (float)atof(&(buffer[token[4]]));
+                        gains.i_max = (float)atof(&(buffer[token[5]]));
+                        gains.d_term_min_var = (float)atof(&(buffer[token[6]]));
+                        control_stage_pid(CONTROL_PID_ROLL, &gains);
+                        break;
                     }
                     ///////////////////////////////////////////////////////////////
                     //                SET PID HEADING 2 ROLL/YAW                 //
                     ///////////////////////////////////////////////////////////////
-                    else if (c1 == 'P' && c2 == 'H')    // Set PID
+                    case COMMAND_CODE('P','H'):    // Set PID
                     {
-                        config.control.pid_heading2roll.p_gain = (float)atof(&(buffer[token[1]]));
-                        config.control.pid_heading2roll.i_gain = (float)atof(&(buffer[token[2]]));
-                        config.control.pid_heading2roll.d_gain = (float)atof(&(buffer[token[3]]));
-                        config.control.pid_heading2roll.i_min = (float)atof(&(buffer[token[4]]));
-                        config.control.pid_heading2roll.i_max = (float)atof(&(buffer[token[5]]));
-                        config.control.pid_heading2roll.d_term_min_var = (float)atof(&(buffer[token[6]]));
+                        // Parsed into a local and staged: the control task
+                        // swaps the gains in at its next loop boundary, so a
+                        // cycle never runs on a half-applied set. RAM only;
+                        // FC persists to flash separately.
+                        struct pid gains;
+                        gains.p_gain = (float)atof(&(buffer[token[1]]));
+                        gains.i_gain = (float)atof(&(buffer[token[2]]));
+                        gains.d_gain = (float)atof(&(buffer[token[3]]));
+                        gains.i_min = (float)atof(&(buffer[token[4]]));
+                        gains.i_max = (float)atof(&(buffer[token[5]]));
+                        gains.d_term_min_var = (float)atof(&(buffer[token[6]]));
+                        control_stage_pid(CONTROL_PID_HEADING, &gains);
+                        break;
                     }
                     ///////////////////////////////////////////////////////////////
                     //                  SET PID ALTITUDE 2 PITCH                 //
                     ///////////////////////////////////////////////////////////////
-                    else if (c1 == 'P' && c2 == 'A')    // Set PID
+                    case COMMAND_CODE('P','A'):    // Set PID
                     {
-                        config.control.pid_altitude2pitch.p_gain = (float)atof(&(buffer[token[1]]));
-                        config.control.pid_altitude2pitch.i_gain = (float)atof(&(buffer[token[2]]));
-                        config.control.pid_altitude2pitch.d_gain = (float)atof(&(buffer[token[3]]));
-                        config.control.pid_altitude2pitch.i_min = (float)atof(&(buffer[token[4]]));
-                        config.control.pid_altitude2pitch.i_max = (float)atof(&(buffer[token[5]]));
-                        config.control.pid_altitude2pitch.d_term_min_var = (float)atof(&(buffer[token[6]]));
+                        // Parsed into a local and staged: the control task
+                        // swaps the gains in at its next loop boundary, so a
+                        // cycle never runs on a half-applied set. RAM only;
+                        // FC persists to flash separately.
+                        struct pid gains;
+                        gains.p_gain = (float)atof(&(buffer[token[1]]));
+                        gains.i_gain = (float)atof(&(buffer[token[2]]));
+                        gains.d_gain = (float)atof(&(buffer[token[3]]));
+                        gains.i_min = (float)atof(&(buffer[token[4]]));
+                        gains.i_max = (float)atof(&(buffer[token[5]]));
+                        gains.d_term_min_var = (float)atof(&(buffer[token[6]]));
+                        control_stage_pid(CONTROL_PID_ALTITUDE, &gains);
+                        break;
                     }
                     ///////////////////////////////////////////////////////////////
                     //                  SET AUTOTHROTTLE                 //
                     ///////////////////////////////////////////////////////////////
-                    else if (c1 == 'A' && c2 == 'T')    // Set PID
+                    case COMMAND_CODE('A','T'):    // Set PID
                     {
                         config.control.auto_throttle_min_pct = atoi(&(buffer[token[1]]));
                         config.control.auto_throttle_max_pct = atoi(&(buffer[token[2]]));
                         config.control.auto_throttle_cruise_pct = atoi(&(buffer[token[3]]));
                         config.control.auto_throttle_p_gain = atoi(&(buffer[token[4]]));
                         config.control.autopilot_auto_throttle = atoi(&(buffer[token[5]])) == 1;
+                        break;
                     }
 
                     ///////////////////////////////////////////////////////////////
                     //                      ENABLE SIMULATION                    //
                     ///////////////////////////////////////////////////////////////
-                    else if (c1 == 'S' && c2 == 'E')
+                    case COMMAND_CODE('S','E'):
                     {
                         printf_message("Simulation enabled\r\n");
                         control_state.simulation_mode = 1;
@@ -544,11 +1041,12 @@ void communication_input_task( void *parameters )
                         sensor_data.gps.time = atol(&(buffer[token[2]]));
                         navigation_data.home_pressure_height = 0;
                         navigation_data.home_gps_height = 0;
+                        break;
                     }
                     ///////////////////////////////////////////////////////////////
                     //                      WRITE SIMULATION                    //
                     ///////////////////////////////////////////////////////////////
-                    else if (c1 == 'S' && c2 == 'W')
+                    case COMMAND_CODE('S','W'):
                     {
                         if (control_state.simulation_mode == 1)
                         {
@@ -567,11 +1065,12 @@ void communication_input_task( void *parameters )
 
                             //navigation_update();
                         }
+                        break;
                     }
                     ///////////////////////////////////////////////////////////////
                     //                      SET TELEMETRY                        //
                     ///////////////////////////////////////////////////////////////
-                    else if (c1 == 'S' && c2 == 'T')    // Set Telemetry
+                    case COMMAND_CODE('S','T'):    // Set Telemetry
                     {
                         config.telemetry.stream_GpsBasic = atoi(&(buffer[token[1]]));
                         config.telemetry.stream_GyroAccRaw = atoi(&(buffer[token[2]]));
@@ -580,37 +1079,97 @@ void communication_input_task( void *parameters )
                         config.telemetry.stream_PressureTemp = atoi(&(buffer[token[5]]));
                         config.telemetry.stream_Attitude = atoi(&(buffer[token[6]]));
                         config.telemetry.stream_Control = atoi(&(buffer[token[7]]));
+                        // optional 8th field; older groundstations leave token[8] at 0
+                        // which makes atoi parse "ST..." -> 0 -> CSV
+                        config.telemetry.use_binary = atoi(&(buffer[token[8]])) == 1 ? 1 : 0;
+                        // optional 9th field: aircraft id for shared-channel
+                        // operation, same backwards-compatible trick
+                        config.telemetry.aircraft_id = (unsigned char)(atoi(&(buffer[token[9]])) & 0x07);
+                        break;
+                    }
+                    ///////////////////////////////////////////////////////////////
+                    //                 SET TELEMETRY SECOND PORT                 //
+                    ///////////////////////////////////////////////////////////////
+                    case COMMAND_CODE('S','2'):    // Set telemetry rates for the wired uart2 port
+                    {
+                        // same field order as ST; takes effect after FC + reboot
+                        // because the gps task only checks the flag at startup
+                        config.telemetry.stream2_GpsBasic = atoi(&(buffer[token[1]]));
+                        config.telemetry.stream2_GyroAccRaw = atoi(&(buffer[token[2]]));
+                        config.telemetry.stream2_GyroAccProc = atoi(&(buffer[token[3]]));
+                        config.telemetry.stream2_PPM = atoi(&(buffer[token[4]]));
+                        config.telemetry.stream2_PressureTemp = atoi(&(buffer[token[5]]));
+                        config.telemetry.stream2_Attitude = atoi(&(buffer[token[6]]));
+                        break;
+                    }
+                    ///////////////////////////////////////////////////////////////
+                    //                  SET MIRROR ROLE (uart2)                  //
+                    ///////////////////////////////////////////////////////////////
+                    case COMMAND_CODE('S','X'):    // SX;role -> 0 off, 1 primary, 2 backup (mirror.h)
+                    {
+                        config.telemetry.mirror = atoi(&(buffer[token[1]]));
+                        if (config.telemetry.mirror > MIRROR_BACKUP)
+                            config.telemetry.mirror = MIRROR_OFF;
+                        // the backup side needs FC + reboot: uart2 ownership
+                        // is decided when the gps task starts
+                        break;
+                    }
+                    ///////////////////////////////////////////////////////////////
+                    //                    SET UART1 BAUDRATE                     //
+                    ///////////////////////////////////////////////////////////////
+                    case COMMAND_CODE('S','B'):    // Set uart1 baudrate (bench link)
+                    {
+                        // On GP2 boards the USB connector is a usb-serial bridge
+                        // on this uart, so the 57600 radio default is all that
+                        // caps bench workflows: log download, HIL injection and
+                        // raw streaming run an order of magnitude faster over
+                        // the bridge at 921600. Deliberately not burned to
+                        // flash - a reset falls back to the radio-safe 57600.
+                        long baud = atol(&(buffer[token[1]]));
+
+                        if (baud >= 9600l && baud <= 921600l)
+                        {
+                            printf_checksum("SB;%ld", baud);   // ack at the old rate
+                            uart1_queue_set_baud(baud);        // drains, then switches
+                            printf_checksum("SB;%ld", baud);   // and again at the new one
+                        }
+                        else
+                            printf_message("Baudrate out of range (9600-921600)\r\n");
+                        break;
                     }
                     ///////////////////////////////////////////////////////////////
                     //                    SET ACCELEROMETER                      //
                     ///////////////////////////////////////////////////////////////
-                    else if (c1 == 'S' && c2 == 'A')    // Set Accelerometer neutral
+                    case COMMAND_CODE('S','A'):    // Set Accelerometer neutral
                     {
                         config.sensors.acc_x_neutral = (float)atof(&(buffer[token[1]]));
                         config.sensors.acc_y_neutral = (float)atof(&(buffer[token[2]]));
                         config.sensors.acc_z_neutral = (float)atof(&(buffer[token[3]]));
+                        break;
                     }
                     ///////////////////////////////////////////////////////////////
                     //                        SET GYRO                           //
                     ///////////////////////////////////////////////////////////////
-                    else if (c1 == 'S' && c2 == 'Y')    // Set Gyro neutral
+                    case COMMAND_CODE('S','Y'):    // Set Gyro neutral
                     {
                         config.sensors.gyro_x_neutral = (float)atof(&(buffer[token[1]]));
                         config.sensors.gyro_y_neutral = (float)atof(&(buffer[token[2]]));
                         config.sensors.gyro_z_neutral = (float)atof(&(buffer[token[3]]));
+                        break;
                     }
                     ///////////////////////////////////////////////////////////////
                     //                        SET IMU                            //
                     ///////////////////////////////////////////////////////////////
-                    else if (c1 == 'S' && c2 == '6')    // Set 6DOF settings
+                    case COMMAND_CODE('S','6'):    // Set 6DOF settings
                     {
                         config.sensors.imu_rotated = atoi(&(buffer[token[1]]));
                         config.sensors.neutral_pitch = DEG2RAD((float)atof(&(buffer[token[2]])));
+                        break;
                     }
                     ///////////////////////////////////////////////////////////////
                     //                     CALIBRATE GYRO                        //
                     ///////////////////////////////////////////////////////////////
-                    else if (c1 == 'C' && c2 == 'G')    // Calibrate gyro
+                    case COMMAND_CODE('C','G'):    // Calibrate gyro
                     {
                         int i;
                         long x=0, y=0, z=0;
@@ -628,12 +1187,13 @@ void communication_input_task( void *parameters )
                         // reset bias offsets
                         sensor_data.p_bias = 0.0;
                         sensor_data.q_bias = 0.0;
-                        printf("Gyros calibrated\r\n");
+                        uart1_printf("Gyros calibrated\r\n");
+                        break;
                     }
                     ///////////////////////////////////////////////////////////////
                     //                    CALIBRATE ACCELERO                     //
                     ///////////////////////////////////////////////////////////////
-                    else if (c1 == 'C' && c2 == 'A')    // Calibrate accelerometer
+                    case COMMAND_CODE('C','A'):    // Calibrate accelerometer
                     {
                         int i;
                         long x=0, y=0, z=0;
@@ -660,12 +1220,27 @@ void communication_input_task( void *parameters )
                                 config.sensors.acc_z_neutral = (float)(z / 10) - 4096.0;
                             }
                         }
-                        printf("Accelerometers calibrated\r\n");
+                        uart1_printf("Accelerometers calibrated\r\n");
+                        break;
+                    }
+                    ///////////////////////////////////////////////////////////////
+                    //              CALIBRATE TEMPERATURE TABLE                  //
+                    ///////////////////////////////////////////////////////////////
+                    case COMMAND_CODE('T','C'):    // TC -> toggle the gyro temperature calibration run
+                    {
+                        if (tempcomp_calibrating())
+                            uart1_printf("Temperature table: %d rows saved\r\n", tempcomp_calibrate_stop());
+                        else
+                        {
+                            tempcomp_calibrate_start();
+                            uart1_printf("Temperature calibration started; keep the board still while it warms up. Send TC again to save.\r\n");
+                        }
+                        break;
                     }
                     ///////////////////////////////////////////////////////////////
                     //                    SET INPUT CHANNELS                     //
                     ///////////////////////////////////////////////////////////////
-                    else if (c1 == 'S' && c2 == 'I')    // Set Input Channel
+                    case COMMAND_CODE('S','I'):    // Set Input Channel
                     {
                         config.control.use_pwm = (buffer[token[1] + 0]) == '1';
                         config.control.channel_ap = (buffer[token[2] + 0] - 'a');
@@ -674,11 +1249,12 @@ void communication_input_task( void *parameters )
                         config.control.channel_roll = (buffer[token[5] + 0] - 'a');
                         config.control.channel_yaw = (buffer[token[6] + 0] - 'a');
 
+                        break;
                     }
                     ///////////////////////////////////////////////////////////////
                     //                    SET SERVO REVERSE                      //
                     ///////////////////////////////////////////////////////////////
-                    else if (c1 == 'S' && c2 == 'R')    // Set servo reverse
+                    case COMMAND_CODE('S','R'):    // Set servo reverse
                     {
                         unsigned int tmp = atoi(&(buffer[token[1]]));
                         config.control.reverse_servo1 = ((tmp & 1) != 0);
@@ -688,11 +1264,13 @@ void communication_input_task( void *parameters )
                         config.control.reverse_servo5 = ((tmp & 16) != 0);
                         config.control.reverse_servo6 = ((tmp & 32) != 0);
                         config.control.manual_trim = buffer[token[2]] == '1'?1:0;
+                        control_precompute_mix();
+                        break;
                     }
                     ///////////////////////////////////////////////////////////////
                     //                    SET MIN MAX                            //
                     ///////////////////////////////////////////////////////////////
-                    else if (c1 == 'S' && c2 == 'M')    // Set servo reverse
+                    case COMMAND_CODE('S','M'):    // Set servo reverse
                     {
                         int nr = atoi(&(buffer[token[1]]));
                         int min = atoi(&(buffer[token[2]]));
@@ -701,11 +1279,21 @@ void communication_input_task( void *parameters )
                         config.control.servo_min[nr] = min;
                         config.control.servo_neutral[nr] = neutral;
                         config.control.servo_max[nr] = max;
+                        break;
+                    }
+                    ///////////////////////////////////////////////////////////////
+                    //                 SET SERVO FRAME RATES                     //
+                    ///////////////////////////////////////////////////////////////
+                    case COMMAND_CODE('S','F'):    // SF;mask -> channels in mask pulse at 400Hz, rest at 50Hz
+                    {
+                        config.control.servo_highrate_mask = (unsigned int)atoi(&(buffer[token[1]])) & 0xff;
+                        servo_set_highrate_mask((unsigned char)config.control.servo_highrate_mask);
+                        break;
                     }
                     ///////////////////////////////////////////////////////////////
                     //                    SET OSD                            //
                     ///////////////////////////////////////////////////////////////
-                    else if (c1 == 'S' && c2 == 'O')    // Set osd
+                    case COMMAND_CODE('S','O'):    // Set osd
                     {
                         osd_clear();
                         unsigned long bits = (unsigned long)atol(&(buffer[token[1]]));
@@ -728,28 +1316,31 @@ void communication_input_task( void *parameters )
                         config.osd.rssi = (enum RssiMode) atoi(&(buffer[token[2]]));
                         config.osd.voltage_low  = (unsigned char) atoi(&(buffer[token[3]]));
                         config.osd.voltage_high  = (unsigned char) atoi(&(buffer[token[4]]));
+                        break;
                     }
                     ///////////////////////////////////////////////////////////////
                     //                      FORMAT DATALOG                       //
                     ///////////////////////////////////////////////////////////////
-                    else if (c1 == 'F' && c2 == 'F')
+                    case COMMAND_CODE('F','F'):
                     {
                         datalogger_format();
+                        break;
                     }
                     ///////////////////////////////////////////////////////////////
                     //                    DATALOG INDEX TABLE                    //
                     ///////////////////////////////////////////////////////////////
-                    else if (c1 == 'F' && c2 == 'I')
+                    case COMMAND_CODE('F','I'):
                     {
                         int i;
                         //uart1_puts("\n\r");
                         for (i = 0; i < MAX_INDEX; i++)
                             printf_checksum("DT;%d;%d;%ld;%ld", i, datalogger_index_table[i].page_num, datalogger_index_table[i].date, datalogger_index_table[i].time);
+                        break;
                     }
                     ///////////////////////////////////////////////////////////////
                     //                           RESET                           //
                     ///////////////////////////////////////////////////////////////
-                    else if (c1 == 'Z' && c2 == 'Z')
+                    case COMMAND_CODE('Z','Z'):
                     {
                         if (atoi(&(buffer[token[1]])) == 1123)  // double check
                         {
@@ -757,11 +1348,12 @@ void communication_input_task( void *parameters )
                             vTaskDelay( ( ( portTickType ) 1000 / portTICK_RATE_MS ) );  // 1s
                             asm("reset");
                         }
+                        break;
                     }
                     ///////////////////////////////////////////////////////////////
                     //                       DATALOG READ                        //
                     ///////////////////////////////////////////////////////////////
-                    else if (c1 == 'D' && c2 == 'R')
+                    case COMMAND_CODE('D','R'):
                     {
                         int i = atoi(&(buffer[token[1]]));
 
@@ -774,7 +1366,7 @@ void communication_input_task( void *parameters )
     #else
                         printf_message ("\r\nDH;Date;Time;Latitude;Longitude;SpeedGPS;HeadingGPS;HeightGPS;");
                         printf_message ("HeightBaro;Pitch;Roll;Yaw;");
-                        printf_message ("TempC;FlightMode;NavigationLine;ServoTrigger\r\n");
+                        printf_message ("TempC;FlightMode;NavigationLine;ServoTrigger;P;Q;R\r\n");
     #endif
 
                         datalogger_disable();
@@ -789,33 +1381,190 @@ void communication_input_task( void *parameters )
                             ;
                         */
                         //datalogger_enable();
+                        break;
+                    }
+                    ///////////////////////////////////////////////////////////////
+                    //                 DATALOG PAGE, BINARY READOUT              //
+                    ///////////////////////////////////////////////////////////////
+                    case COMMAND_CODE('D','P'):    // DP;page -> 4 binary chunks; logging keeps running
+                    {
+                        datalogger_stream_page(atoi(&(buffer[token[1]])));
+                        break;
+                    }
+                    ///////////////////////////////////////////////////////////////
+                    //              DATALOG BULK, BINARY READOUT                 //
+                    ///////////////////////////////////////////////////////////////
+                    case COMMAND_CODE('D','B'):    // DB;page;count -> raw pages as binary chunks, any flash region
+                    {
+                        datalogger_stream_pages(atoi(&(buffer[token[1]])), atoi(&(buffer[token[2]])));
+                        break;
+                    }
+                    ///////////////////////////////////////////////////////////////
+                    //                       DATALOG SPEED                       //
+                    ///////////////////////////////////////////////////////////////
+                    case COMMAND_CODE('D','S'):    // DS;1 = 50Hz control-tuning logging, DS;0 = normal 4Hz
+                    {
+                        datalogger_set_highrate(atoi(&(buffer[token[1]])) == 1 ? 1 : 0);
+                        break;
+                    }
+                    ///////////////////////////////////////////////////////////////
+                    //                        CPU LOAD                           //
+                    ///////////////////////////////////////////////////////////////
+                    case COMMAND_CODE('C','U'):    // CU -> per-task CPU load since last report
+                    {
+                        print_cpu_load();
+                        break;
+                    }
+                    ///////////////////////////////////////////////////////////////
+                    //                    CONTROL LATENCY                        //
+                    ///////////////////////////////////////////////////////////////
+                    case COMMAND_CODE('C','L'):    // CL -> sensor-to-servo latency histograms, reset after printing
+                    {
+                        print_latency();
+                        break;
+                    }
+                    ///////////////////////////////////////////////////////////////
+                    //                       MIRROR STATUS                       //
+                    ///////////////////////////////////////////////////////////////
+                    case COMMAND_CODE('C','M'):    // CM -> mirror link status + attitude cross-check
+                    {
+                        // the deltas compare the mirrored attitude against this
+                        // board's own filter - a growing gap flags a sick board
+                        printf_checksum("CM;%u;%lu;%lu;%lu;%d;%d;%d;%d",
+                            (unsigned int)config.telemetry.mirror,
+                            (unsigned long)(timer_millis() - mirror_shadow.last_update_ms),
+                            mirror_shadow.frames, mirror_shadow.crc_errors,
+                            mirror_shadow.codeline,
+                            mirror_shadow.roll_mrad - (int)(sensor_data.roll * 1000.0),
+                            mirror_shadow.pitch_mrad - (int)(sensor_data.pitch * 1000.0),
+                            mirror_shadow.yaw_mrad - (int)(sensor_data.yaw * 1000.0));
+                        break;
+                    }
+                    ///////////////////////////////////////////////////////////////
+                    //                      FLASH VERIFY                         //
+                    ///////////////////////////////////////////////////////////////
+                    case COMMAND_CODE('C','F'):    // CF -> idle-time flash verify status
+                    {
+                        // descriptor_found = 0 means we are comparing against the
+                        // baseline measured on the first pass after boot
+                        printf_checksum("CF;%u;%lu;%u;%u;%u;%lu",
+                            flashcheck.faults, flashcheck.passes,
+                            flashcheck.crc, flashcheck.expected_crc,
+                            (unsigned int)flashcheck.descriptor_found,
+                            flashcheck.image_end);
+                        break;
+                    }
+                    ///////////////////////////////////////////////////////////////
+                    //                     STACK HIGH-WATER                      //
+                    ///////////////////////////////////////////////////////////////
+                    case COMMAND_CODE('C','W'):    // CW -> per-task stack high-water marks
+                    {
+                        print_stack_usage();
+                        break;
+                    }
+                    ///////////////////////////////////////////////////////////////
+                    //                    VIBRATION SPECTRUM                     //
+                    ///////////////////////////////////////////////////////////////
+                    case COMMAND_CODE('C','V'):    // CV;axis -> accel burst + FFT, reported as a TV line
+                    {
+                        vibration_start(atoi(&(buffer[token[1]])));
+                        break;
+                    }
+                    ///////////////////////////////////////////////////////////////
+                    //                    RAW GYRO CAPTURE                       //
+                    ///////////////////////////////////////////////////////////////
+                    case COMMAND_CODE('C','R'):    // CR;seconds -> raw 1kHz gyro capture to dataflash
+                    {
+                        // bench use: the AHRS freezes for the capture length;
+                        // the completion line names the pages to bulk-read.
+                        // Only the mpu6000 sensor task serves captures.
+                        if (HARDWARE_VERSION == V01Q)
+                            gyrocapture_start(atoi(&(buffer[token[1]])));
+                        break;
+                    }
+                    ///////////////////////////////////////////////////////////////
+                    //                       GYRO NOTCH                          //
+                    ///////////////////////////////////////////////////////////////
+                    case COMMAND_CODE('C','N'):    // CN;freq_hz -> gyro notch center, 0 = off
+                    {
+                        sensors_notch_request((float)atoi(&(buffer[token[1]])));
+                        printf_message("Gyro notch updated\r\n");
+                        break;
+                    }
+                    ///////////////////////////////////////////////////////////////
+                    //                        TASK HEALTH                        //
+                    ///////////////////////////////////////////////////////////////
+                    case COMMAND_CODE('C','H'):    // CH -> per-task heartbeat misses and ages
+                    {
+                        print_task_health();
+                        break;
+                    }
+                    ///////////////////////////////////////////////////////////////
+                    //                       BOOT TIMING                         //
+                    ///////////////////////////////////////////////////////////////
+                    case COMMAND_CODE('C','B'):    // CB -> boot-phase timing table
+                    {
+                        print_boot_stats();
+                        break;
+                    }
+                    ///////////////////////////////////////////////////////////////
+                    //                     QUEUE WATERMARKS                      //
+                    ///////////////////////////////////////////////////////////////
+                    case COMMAND_CODE('C','Q'):    // CQ -> per-ring depth watermarks and drop counts
+                    {
+                        print_queue_watermarks();
+                        break;
+                    }
+                    ///////////////////////////////////////////////////////////////
+                    //                     PRE-ARM SELF-TEST                     //
+                    ///////////////////////////////////////////////////////////////
+                    case COMMAND_CODE('C','P'):    // CP -> servo sweep + control loop timing, go/no-go
+                    {
+                        control_request_selftest();   // the control task runs it and reports
+                        break;
+                    }
+                    ///////////////////////////////////////////////////////////////
+                    //                    RELAY-FEEDBACK AUTOTUNE                //
+                    ///////////////////////////////////////////////////////////////
+                    case COMMAND_CODE('C','T'):    // CT;axis -> relay autotune, 0 = roll, 1 = pitch
+                    {
+                        control_request_autotune(atoi(&(buffer[token[1]])));   // the control task runs it in its stabilized loop
+                        break;
+                    }
+                    case COMMAND_CODE('C','S'):    // CS;ms -> rc failsafe frame-gap timeout, 25..100ms
+                    {
+                        ppm_in_set_failsafe_ms(atoi(&(buffer[token[1]])));
+                        break;
                     }
                     ///////////////////////////////////////////////////////////////
                     //                      WRITE TO FLASH                       //
                     ///////////////////////////////////////////////////////////////
-                    else if (c1 == 'F' && c2 == 'C')    // FC write to flash!
+                    case COMMAND_CODE('F','C'):    // FC write to flash!
                     {
-                        configuration_write();
+                        configuration_request_write();  // the datalogger task writes it, so telemetry keeps flowing
                         printf_message("Configuration burned to flash\r\n");
+                        break;
                     }
                     ///////////////////////////////////////////////////////////////
                     //                     LOAD FROM FLASH                       //
                     ///////////////////////////////////////////////////////////////
-                    else if (c1 == 'L' && c2 == 'C')    // Load configuration from flash!
+                    case COMMAND_CODE('L','C'):    // Load configuration from flash!
                     {
                         configuration_load();
+                        break;
                     }
                     ///////////////////////////////////////////////////////////////
                     //                LOAD DEFAULT CONFIGURATION                 //
                     ///////////////////////////////////////////////////////////////
-                    else if (c1 == 'L' && c2 == 'D')    // Load default configuration
+                    case COMMAND_CODE('L','D'):    // Load default configuration
                     {
                         configuration_default();
+                        break;
                     }
                     ///////////////////////////////////////////////////////////////
                     //                  READ ALL CONFIGURATION                   //
                     ///////////////////////////////////////////////////////////////
-                    else if (c1 == 'R' && c2 == 'C')    // RC;x  Read configuration
+                    case COMMAND_CODE('R','C'):    // RC;x  Read configuration
                     {
                         if (buffer[token[1]] == 'A')
                         {
@@ -825,12 +1574,16 @@ void communication_input_task( void *parameters )
                                 xSemaphoreGive( xUart1Semaphore );
                             }
                         }
+                        break;
                     }
-                    else if (current_token > 0)  // && \n or \r
-                    {
-                        buffer[buffer_position++] = '\0';
-                        buffer[buffer_position] = '\0';
-                        printf_nochecksum_direct("ERROR received data: %s\r\n", buffer);
+                    default:
+                        if (current_token > 0)  // && \n or \r
+                        {
+                            buffer[buffer_position++] = '\0';
+                            buffer[buffer_position] = '\0';
+                            printf_nochecksum_direct("ERROR received data: %s\r\n", buffer);
+                        }
+                        break;
                     }
                 }
             	buffer_position = 0;
@@ -857,7 +1610,7 @@ void communication_input_task( void *parameters )
 				{
 					buffer_position = 0;
 					current_token = 0;
-                    printf("\r\nError max token\r\n");
+                    uart1_printf("\r\nError max token\r\n");
 				}
 	        } 
             else if (buffer_position < BUFFERSIZE)  // no newline and no new token
@@ -866,7 +1619,7 @@ void communication_input_task( void *parameters )
             }
             else
             {
-                printf("\r\nRx parser buffer overflow\r\n");
+                uart1_printf("\r\nRx parser buffer overflow\r\n");
                 buffer_position = 0;
             	current_token = 0;
             	token[0] = 0;
@@ -884,6 +1637,162 @@ void communication_input_task( void *parameters )
 	}
 }
 
+/*!
+ *    Prints the CPU load per task since the last report, in 0.1% units and
+ *    task-tag order: kernel/untagged, control, sensors, gps/navigation,
+ *    console input, datalogger, telemetry, osd, idle. Sent every 5s by the
+ *    telemetry task and on demand with the CU console command.
+ */
+/*!
+ *    One TW line per task: name, configured stack depth and the high-water
+ *    mark (the smallest amount of stack that was ever left free), both in
+ *    16-bit words. A mark near zero means the task nearly overflowed; a
+ *    mark near the depth means the stack can shrink and the RAM go to the
+ *    logging and DMA buffers instead.
+ */
+void print_stack_usage()
+{
+	int i;
+
+	for (i = 0; i < stackwatch_count(); i++)
+		printf_checksum_direct("TW;%s;%u;%u", stackwatch_name(i),
+		                       stackwatch_depth(i), stackwatch_free(i));
+}
+
+
+/*!
+ *    One TK line per heartbeat-registered task: name, expected period (ms),
+ *    missed-deadline count and time since the last check-in (ms). A nonzero
+ *    miss count means the task once went silent for over twice its period;
+ *    while a task is overdue the idle hook stops feeding the watchdog, so
+ *    a wedge that persists ends in a watchdog reset and a warmstart.
+ */
+void print_task_health()
+{
+	int i;
+
+	for (i = 0; i < heartbeat_count(); i++)
+		printf_checksum_direct("TK;%s;%u;%u;%u", heartbeat_name(i),
+		                       heartbeat_period_ms(i), heartbeat_misses(i),
+		                       heartbeat_age_ms(i));
+}
+
+
+/*!
+ *    One TB line per boot phase: name, start and duration, both in ms on
+ *    the monotonic clock (which starts a few ms into main()). The rc and
+ *    gps phases run in parallel tasks, so durations can overlap and sum
+ *    past the wall-clock boot time. Printed once by the telemetry task
+ *    when the last phase closes; the CB command reprints it any time.
+ */
+void print_boot_stats()
+{
+	int i;
+
+	for (i = 0; i < bootstats_count(); i++)
+		printf_checksum_direct("TB;%s;%lu;%lu", bootstats_name(i),
+		                       bootstats_start_ms(i), bootstats_duration_ms(i));
+}
+
+
+/*!
+ *    One TQ line per registered ring buffer: name, capacity, the deepest
+ *    fill level ever seen and the drop count (write stalls for the uart1
+ *    tx ring, which blocks instead of dropping). A mark far below the
+ *    capacity means the ring can shrink and the RAM go elsewhere; any
+ *    nonzero drop count means data was lost under load.
+ */
+void print_queue_watermarks()
+{
+	int i;
+
+	for (i = 0; i < ringbuffer_watch_count(); i++)
+		printf_checksum_direct("TQ;%s;%u;%u;%u", ringbuffer_watch_name(i),
+		                       ringbuffer_watch_capacity(i),
+		                       ringbuffer_watch_max_used(i),
+		                       ringbuffer_watch_drops(i));
+}
+
+
+/*!
+ *    TV line: axis, sample rate and the 4 dominant bins of the vibration
+ *    spectrum as frequency (Hz) / magnitude (raw accel counts) pairs.
+ *    The FFT itself runs here, in the telemetry task: a few ms of Q1.15
+ *    butterflies must not delay the sensor loop.
+ */
+void print_vibration()
+{
+	struct VibrationPeak peaks[VIBRATION_PEAKS];
+
+	vibration_analyze(peaks);
+
+	// while the notch runs, follow the dominant peak: throttle changes move
+	// the prop rate, and a notch beside the peak is worse than none
+	if (sensors_notch_enabled() && peaks[0].frequency > 5.0f)
+		sensors_notch_request(peaks[0].frequency);
+	printf_checksum("TV;%d;%u;%.1f;%.0f;%.1f;%.0f;%.1f;%.0f;%.1f;%.0f",
+	                vibration_axis(), vibration_sample_hz(),
+	                peaks[0].frequency, peaks[0].magnitude,
+	                peaks[1].frequency, peaks[1].magnitude,
+	                peaks[2].frequency, peaks[2].magnitude,
+	                peaks[3].frequency, peaks[3].magnitude);
+}
+
+
+void print_cpu_load()
+{
+	unsigned int load[PROFILER_MAX_TAGS];
+
+	profiler_get_load_pct10(load, PROFILER_MAX_TAGS);
+	printf_checksum_direct("TU;%u;%u;%u;%u;%u;%u;%u;%u;%u",
+	                       load[0], load[1], load[2], load[3], load[4],
+	                       load[5], load[6], load[7], load[8]);
+
+#ifdef ISR_PROFILING
+	// interrupt share of wall time per vector (order: isr_time.h) plus the
+	// interrupt count of the window - rerun after moving a driver to DMA
+	// and this line is where the win (or its absence) shows up
+	{
+		unsigned int isr[ISR_TIME_MAX_VECTORS];
+		unsigned long interrupts;
+
+		profiler_get_isr_load_pct10(isr, ISR_TIME_MAX_VECTORS, &interrupts);
+		printf_checksum_direct("TI;%u;%u;%u;%u;%u;%u;%u;%u;%lu",
+		                       isr[0], isr[1], isr[2], isr[3],
+		                       isr[4], isr[5], isr[6], isr[7], interrupts);
+	}
+#endif
+}
+
+
+/*!
+ *    Prints the latency histograms gathered since the last CL command, one
+ *    line per histogram: A = sample-to-ahrs, S = sample-to-servo, followed
+ *    by the 16 bucket counts (2ms per bucket, last bucket = overflow) and
+ *    the worst latency in microseconds. Resets the histograms afterwards.
+ */
+void print_latency()
+{
+	struct LatencyHistogram *h = &latency_sample_to_ahrs;
+	char name = 'A';
+	int i;
+
+	for (i = 0; i < 2; i++)
+	{
+		printf_checksum_direct("TL;%c;%lu;%lu;%lu;%lu;%lu;%lu;%lu;%lu;%lu;%lu;%lu;%lu;%lu;%lu;%lu;%lu;%lu",
+		                       name,
+		                       h->count[0], h->count[1], h->count[2], h->count[3],
+		                       h->count[4], h->count[5], h->count[6], h->count[7],
+		                       h->count[8], h->count[9], h->count[10], h->count[11],
+		                       h->count[12], h->count[13], h->count[14], h->count[15],
+		                       h->max_us);
+		h = &latency_sample_to_servo;
+		name = 'S';
+	}
+	latency_reset();
+}
+
+
 void print_navigation()
 {
 	int i;
@@ -954,28 +1863,28 @@ void print_configuration()
 	vTaskDelay(( ( portTickType ) 50 / portTICK_RATE_MS ) );  // 50ms
 
 	// control.pid
-	printf("%f;%f;%f;%f;%f;%f;", config.control.pid_pitch2elevator.p_gain,
+	uart1_printf("%f;%f;%f;%f;%f;%f;", config.control.pid_pitch2elevator.p_gain,
 	                    config.control.pid_pitch2elevator.d_gain,
 	                    config.control.pid_pitch2elevator.i_gain,
 	                    config.control.pid_pitch2elevator.i_min,
 	                    config.control.pid_pitch2elevator.i_max,
 	                    config.control.pid_pitch2elevator.d_term_min_var);
 	vTaskDelay(( ( portTickType ) 50 / portTICK_RATE_MS ) );  // 50ms
-	printf("%f;%f;%f;%f;%f;%f;", config.control.pid_roll2aileron.p_gain,
+	uart1_printf("%f;%f;%f;%f;%f;%f;", config.control.pid_roll2aileron.p_gain,
 	                    config.control.pid_roll2aileron.d_gain,
 	                    config.control.pid_roll2aileron.i_gain,
 	                    config.control.pid_roll2aileron.i_min,
 	                    config.control.pid_roll2aileron.i_max,
 	                    config.control.pid_roll2aileron.d_term_min_var);
 	vTaskDelay(( ( portTickType ) 50 / portTICK_RATE_MS ) );  // 50ms
-	printf("%f;%f;%f;%f;%f;%f;", config.control.pid_heading2roll.p_gain,
+	uart1_printf("%f;%f;%f;%f;%f;%f;", config.control.pid_heading2roll.p_gain,
 	                    config.control.pid_heading2roll.d_gain,
 	                    config.control.pid_heading2roll.i_gain,
 	                    config.control.pid_heading2roll.i_min,
 	                    config.control.pid_heading2roll.i_max,
 	                    config.control.pid_heading2roll.d_term_min_var);
 	vTaskDelay(( ( portTickType ) 50 / portTICK_RATE_MS ) );  // 50ms
-	printf("%f;%f;%f;%f;%f;%f;", config.control.pid_altitude2pitch.p_gain,
+	uart1_printf("%f;%f;%f;%f;%f;%f;", config.control.pid_altitude2pitch.p_gain,
 	                    config.control.pid_altitude2pitch.d_gain,
 	                    config.control.pid_altitude2pitch.i_gain,
 	                    config.control.pid_altitude2pitch.i_min,
@@ -993,24 +1902,24 @@ void print_configuration()
 	// servo max/min/neutral
 	for (i = 0; i < 6; i++)
 	{
-		printf(";%d;%d;%d", config.control.servo_min[i], config.control.servo_max[i], config.control.servo_neutral[i]);
+		uart1_printf(";%d;%d;%d", config.control.servo_min[i], config.control.servo_max[i], config.control.servo_neutral[i]);
 	}	
 	vTaskDelay(( ( portTickType ) 50 / portTICK_RATE_MS ) );  // 50ms
 	
-	printf(";%d", (int)config.control.use_pwm);
+	uart1_printf(";%d", (int)config.control.use_pwm);
 	
-	printf(";%d;%d;%d;%d;%d", (int)config.control.servo_mix, 
+	uart1_printf(";%d;%d;%d;%d;%d", (int)config.control.servo_mix, 
 	                     	     (int)(RAD2DEG(config.control.max_pitch)+0.5), 
 	                     	     (int)(RAD2DEG(config.control.max_roll)+0.5),
 	                   	         (int)(config.control.waypoint_radius_m),
 	                 	         (int)(config.control.cruising_speed_ms));
-	printf(";%d;%d;%d", (int)(config.control.stabilization_with_altitude_hold), 
+	uart1_printf(";%d;%d;%d", (int)(config.control.stabilization_with_altitude_hold), 
 	                    config.control.aileron_differential*10, config.telemetry.stream_Control);
 	vTaskDelay(( ( portTickType ) 50 / portTICK_RATE_MS ) );  // 50ms
-    printf(";%d;%d;%d;%d;%d", (int)config.control.autopilot_auto_throttle, config.control.auto_throttle_min_pct, config.control.auto_throttle_max_pct,
+    uart1_printf(";%d;%d;%d;%d;%d", (int)config.control.autopilot_auto_throttle, config.control.auto_throttle_min_pct, config.control.auto_throttle_max_pct,
 	                    config.control.auto_throttle_cruise_pct, config.control.auto_throttle_p_gain);
-	printf(";%d", (int)(RAD2DEG(config.control.min_pitch)-0.5));
-	printf(";%d;%d;%u", (int)config.control.manual_trim, (int)config.control.altitude_mode, (unsigned int)config.gps.enable_waas);
+	uart1_printf(";%d", (int)(RAD2DEG(config.control.min_pitch)-0.5));
+	uart1_printf(";%d;%d;%u", (int)config.control.manual_trim, (int)config.control.altitude_mode, (unsigned int)config.gps.enable_waas);
 
     // osd
     unsigned int bitmask = 0;
@@ -1030,8 +1939,8 @@ void print_configuration()
                 (config.osd.show_voltage1? 8192 : 0) +
                 (config.osd.show_voltage2? 16384 : 0) +
                 (config.osd.show_block_name? 32768 : 0) ;
-    printf(";%u;%u;%u;%u", bitmask, (unsigned int)config.osd.rssi, (unsigned int)config.osd.voltage_low, (unsigned int)config.osd.voltage_high);
-    printf(";%d;%d", (int)config.sensors.imu_rotated, (int)RAD2DEG(config.sensors.neutral_pitch));
+    uart1_printf(";%u;%u;%u;%u", bitmask, (unsigned int)config.osd.rssi, (unsigned int)config.osd.voltage_low, (unsigned int)config.osd.voltage_high);
+    uart1_printf(";%d;%d", (int)config.sensors.imu_rotated, (int)RAD2DEG(config.sensors.neutral_pitch));
     uart1_puts("\r\n");
 }		
 
@@ -1055,14 +1964,14 @@ void print_logline(struct LogLine *l)
 
 #elif RAW_50HZ_LOG
 	// Raw sensor logging @ 50Hz
-	printf ("DD;%f;%f;", l->gps_latitude_rad*(180.0/3.14159), l->gps_longitude_rad*(180.0/3.14159));
-	printf ("%lu;%f;%d;", l->gps_time, ((float)l->gps_speed_m_s_10) / 10.0, ((int)l->gps_heading_2)*2);
+	uart1_printf ("DD;%f;%f;", l->gps_latitude_rad*(180.0/3.14159), l->gps_longitude_rad*(180.0/3.14159));
+	uart1_printf ("%lu;%f;%d;", l->gps_time, ((float)l->gps_speed_m_s_10) / 10.0, ((int)l->gps_heading_2)*2);
 
-	printf ("%u;%u;%u;", l->acc_x, l->acc_y, l->acc_z);
-	printf ("%u;%u;%u;", l->gyro_x, l->gyro_y, l->gyro_z);
+	uart1_printf ("%u;%u;%u;", l->acc_x, l->acc_y, l->acc_z);
+	uart1_printf ("%u;%u;%u;", l->gyro_x, l->gyro_y, l->gyro_z);
 
-//	printf ("%f;%d;%d;%d;%u;%d\r\n", ((float)l->height_m_5) / 5.0, l->pitch, l->roll, l->pitch_acc, l->idg500_vref, l->control_state);
-	printf ("%f;%d;%d;%d\r\n", ((float)l->height_m_5) / 5.0, l->pitch, l->roll, l->pitch_acc);
+//	uart1_printf ("%f;%d;%d;%d;%u;%d\r\n", ((float)l->height_m_5) / 5.0, l->pitch, l->roll, l->pitch_acc, l->idg500_vref, l->control_state);
+	uart1_printf ("%f;%d;%d;%d\r\n", ((float)l->height_m_5) / 5.0, l->pitch, l->roll, l->pitch_acc);
 #else
 	// Normal logging
 	//printf_nochecksum ("DD;%lu;%lu;%.9f;%.9f;", l->date, l->time, RAD2DEG(l->gps_latitude_rad), RAD2DEG(l->gps_longitude_rad));
@@ -1070,11 +1979,18 @@ void print_logline(struct LogLine *l)
 	//printf_nochecksum ("%d;%d;%d;%d;", l->height_m, l->pitch, l->roll, l->yaw);
 	//printf_nochecksum ("%d;%d;%d;%u\r\n", (int)l->temperature_c, (int)l->control_state, l->navigation_code_line+1, l->servo_trigger);
 
-    printf_checksum("DD;%lu;%lu;%.6f;%.6f;%.1f;%d;%d;%d;%d;%d;%d;%d;%d;%d;%u",
+    printf_checksum("DD;%lu;%lu;%.6f;%.6f;%.1f;%d;%d;%d;%d;%d;%d;%d;%d;%d;%u;%d;%d;%d;%lu;%u",
                             l->date, l->time, RAD2DEG(l->gps_latitude_rad), RAD2DEG(l->gps_longitude_rad),
                             ((float)l->gps_speed_m_s)/3.0, l->gps_heading, l->gps_height_m,
                             l->height_m, l->pitch, l->roll, l->yaw,
-                            (int)l->temperature_c, (int)l->control_state, l->navigation_code_line+1, l->servo_trigger);
+                            (int)l->temperature_c, (int)l->control_state, l->navigation_code_line+1, l->servo_trigger,
+                            l->p, l->q, l->r, l->time_ms, (unsigned int)l->cpu_load);
+#ifdef AHRS_SHADOW
+    // side-by-side line for the shadow filter: attitude plus both cycle
+    // counts (stored as cycles/4, reported in cycles)
+    printf_checksum("DA;%d;%d;%lu;%lu", l->shadow_pitch, l->shadow_roll,
+                            (l->ahrs_cycles & 0xfffful) << 2, (l->ahrs_cycles >> 16) << 2);
+#endif
 #endif
 }	
 
@@ -1118,7 +2034,7 @@ void print_logline_simulation(struct LogLine *l)
 	l->pitch = (sensor_data.pitch/3.14*180.0);
 	l->roll = (sensor_data.roll/3.14*180.0);
 	print_logline(l);
-	//printf ("%f;%f;%f\r\n", sensor_data.pitch, sensor_data.roll, sensor_data.pitch_acc );
+	//uart1_printf ("%f;%f;%f\r\n", sensor_data.pitch, sensor_data.roll, sensor_data.pitch_acc );
 }	
 #endif
 
@@ -1206,23 +2122,62 @@ void print_unsigned_integer(unsigned int x, void (*printer)(char[]))
 
 
 char hex[] = {'0','1','2','3','4','5','6','7','8','9','a','b','c','d','e','f'};
+
+/*!
+ *  Formatter behind the printf_checksum macros and the console replies.
+ *  The core moved to lib/format (format_args), so the uart1 transmit path
+ *  shares it; see format.h for the supported conversion subset.
+ *  @param dst    Destination buffer, not '\0'-terminated.
+ *  @param maxlen Size of the destination buffer.
+ *  @param fmt    printf-style format string.
+ *  @return The number of characters written.
+ */
+int comm_format(char *dst, int maxlen, const char *fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	va_start(ap, fmt);
+	n = format_args(dst, maxlen, fmt, ap);
+	va_end(ap);
+	return n;
+}
+
 void comm_send_buffer_with_checksum(int length)
 {
 	char checksum = 0;
+	char trailer[6] = "$*??\r\n";   // '$' is sent first, the rest after the payload
 	int j;
-	uart1_putc('$');
-	for (j=0;j < length && j < COMM_BUFFER_LEN; j++)
-	{
-		char c = comm_buffer[j];
-		uart1_putc(c);
-		checksum ^= c;
-	}
-	uart1_putc('*');
+
+	if (length > COMM_BUFFER_LEN)
+		length = COMM_BUFFER_LEN;
+	for (j = 0; j < length; j++)
+		checksum ^= comm_buffer[j];
 	//0123456789ABCDEF
-	uart1_putc(hex[checksum/16]);
-	uart1_putc(hex[checksum%16]);
-	uart1_putc('\r');
-	uart1_putc('\n');
+	trailer[2] = hex[checksum/16];
+	trailer[3] = hex[checksum%16];
+	uart1_put(trailer, 1);
+	uart1_put(comm_buffer, length);
+	uart1_put(&trailer[1], 5);   // 3 chunks instead of one putc per character
+}
+
+void comm2_send_buffer_with_checksum(int length)
+{
+	char checksum = 0;
+	int j;
+
+	if (length > COMM_BUFFER_LEN)
+		length = COMM_BUFFER_LEN;
+	for (j = 0; j < length; j++)
+		checksum ^= comm2_buffer[j];
+	uart2_putc('$');
+	for (j = 0; j < length; j++)
+		uart2_putc(comm2_buffer[j]);
+	uart2_putc('*');
+	uart2_putc(hex[checksum/16]);
+	uart2_putc(hex[checksum%16]);
+	uart2_putc('\r');
+	uart2_putc('\n');
 }
 
 int check_checksum(char *s)
@@ -1236,9 +2191,9 @@ int check_checksum(char *s)
 		i++;
 	}
 	//if (! (s[i+1] == hex[checksum/16] && s[i+2] == hex[checksum%16]))
-	//	printf("\r\n %c %c <> %c %c\r\n", s[i+1], s[i+2], hex[checksum/16], hex[checksum%16]);
+	//	uart1_printf("\r\n %c %c <> %c %c\r\n", s[i+1], s[i+2], hex[checksum/16], hex[checksum%16]);
 //	s[i]='*';
-//printf("\r\n %s  %d <> %c%c\r\n", s,checksum, s[i+1], s[i+2]);
+//uart1_printf("\r\n %s  %d <> %c%c\r\n", s,checksum, s[i+1], s[i+2]);
 	return s[i+1] == hex[checksum/16] && s[i+2] == hex[checksum%16];
 }	
 	
@@ -1249,7 +2204,7 @@ int check_checksum(char *s)
     va_start(args, fmt);
     int i;
 
-    //return printf(fmt, args);
+    //return uart1_printf(fmt, args);
 
 	comm_send_buffer_with_checksum(sprintf(comm_buffer, fmt, args));
 }*/
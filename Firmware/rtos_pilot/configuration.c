@@ -9,15 +9,22 @@
  *  @since    0.1
  */
  
+// Standard includes
+#include <math.h>
+#include <string.h>
+
 // Gluonpilot library includes
 #include "microcontroller/microcontroller.h"
 #include "dataflash/dataflash.h"
+#include "tempcomp/tempcomp.h"
 #include "gps/gps.h"
 
 // rtos_pilot includes
 #include "sensors.h"
 #include "communication.h"
+#include "mirror.h"
 #include "configuration.h"
+#include "uart1_queue/uart1_queue.h"
 
 //! Memory allocation for the configuration data.
 struct Configuration config;
@@ -26,13 +33,188 @@ struct Configuration config;
 int HARDWARE_VERSION;
 
 
+//! On-flash layout of one configuration bank: a small header in front of
+//! the configuration struct. The crc covers the configuration bytes only.
+struct ConfigurationBank
+{
+	unsigned int magic;      //!< CONFIGURATION_BANK_MAGIC once the bank was written
+	unsigned int sequence;   //!< incremented on every write; the newest valid bank wins
+	unsigned int crc;        //!< crc16 of the configuration bytes
+	struct Configuration config;
+};
+
+#define CONFIGURATION_BANK_MAGIC 0xC0F6
+
+//! Scratch copy used for reading and writing a bank; too large for a task stack.
+static struct ConfigurationBank bank_image;
+
+//! Sequence number of the newest valid bank and which bank holds it.
+//! active_bank stays -1 when the flash still holds a bare pre-0.9
+//! configuration struct (or nothing at all).
+static unsigned int bank_sequence = 0;
+static int active_bank = -1;
+
+
+//! Pages occupied by one bank. Both banks fit in the pages that were already
+//! reserved next to CONFIGURATION_PAGE: 1 page each on the 528-byte chips,
+//! 2 pages each on the 264-byte chips (NAVIGATION_PAGE starts at 4 there).
+static int configuration_bank_pages()
+{
+	return (sizeof(struct ConfigurationBank) + PAGE_SIZE - 1) / PAGE_SIZE;
+}
+
+
+//! Crc16-ccitt, bit by bit; it runs over ~350 bytes so speed is no concern.
+//! Public in update form (start with 0xffff) so the flightplan scrub can
+//! accumulate it page by page.
+unsigned int configuration_crc_update(unsigned int crc, unsigned char *data, int size)
+{
+	int i, b;
+
+	for (i = 0; i < size; i++)
+	{
+		crc ^= ((unsigned int)data[i]) << 8;
+		for (b = 0; b < 8; b++)
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+	}
+	return crc;
+}
+
+static unsigned int configuration_crc(unsigned char *data, int size)
+{
+	return configuration_crc_update(0xffff, data, size);
+}
+
+
 /*!
- *  Loads the configuration struct from the 1st dataflash page.
+ *  Loads the configuration from the newest valid dataflash bank. A bank is
+ *  valid when its magic and crc check out, so a write interrupted by a power
+ *  pull leaves the previous bank (and thus the previous configuration)
+ *  untouched instead of booting into garbage. Flash written by pre-0.9
+ *  firmware has no bank header; that is read back as a bare struct, exactly
+ *  like before.
  *  @todo  Add global min and max value for the output.
  */
 void configuration_load()
 {
-	dataflash.read(CONFIGURATION_PAGE, sizeof(struct Configuration), (unsigned char*)&config);
+	int bank;
+
+	configuration_commit();   // make sure a scheduled write is in the flash before we read it back
+
+	for (bank = 0; bank < CONFIGURATION_BANKS; bank++)
+	{
+		dataflash.read(CONFIGURATION_PAGE + bank * configuration_bank_pages(),
+		               sizeof(struct ConfigurationBank), (unsigned char*)&bank_image);
+		if (bank_image.magic != CONFIGURATION_BANK_MAGIC)
+			continue;
+		if (bank_image.crc != configuration_crc((unsigned char*)&bank_image.config, sizeof(struct Configuration)))
+			continue;
+		if (active_bank == -1 || (int)(bank_image.sequence - bank_sequence) > 0)
+		{
+			memcpy(&config, &bank_image.config, sizeof(struct Configuration));
+			bank_sequence = bank_image.sequence;
+			active_bank = bank;
+		}
+	}
+
+	if (active_bank == -1)   // pre-0.9 flash: a bare struct at the old location
+		dataflash.read(CONFIGURATION_PAGE, sizeof(struct Configuration), (unsigned char*)&config);
+
+	calibration_load();
+	tempcomp_load();
+}
+
+
+//! Ram copy of the calibration cache page (CALIBRATION_PAGE).
+static struct CalibrationSlot calibration_cache[CALIBRATION_SLOTS];
+
+//! The cache is refreshed at most once per boot: that is all the next boot
+//! needs, and it keeps the wear on the dataflash page negligible.
+static int calibration_saved_this_boot = 0;
+
+
+//! Maps a board temperature onto a cache slot: 5 deg C bands from 0 to 40,
+//! clamped at both ends.
+static int calibration_slot(int temperature_10)
+{
+	int slot = temperature_10 / 50;
+	if (slot < 0)
+		slot = 0;
+	if (slot >= CALIBRATION_SLOTS)
+		slot = CALIBRATION_SLOTS - 1;
+	return slot;
+}
+
+
+/*!
+ *  Loads the calibration cache from its dataflash page. An erased page reads
+ *  as garbage, which is why every slot carries a magic number.
+ */
+void calibration_load()
+{
+	dataflash.read(CALIBRATION_PAGE, sizeof(calibration_cache), (unsigned char*)calibration_cache);
+}
+
+
+/*!
+ *  Seeds the kalman gyroscope bias states from the cache slot captured at
+ *  the current board temperature, so the filter starts where it converged
+ *  to on the previous flight instead of drifting there over ~30s.
+ */
+void calibration_apply(int temperature_10)
+{
+	struct CalibrationSlot *slot = &calibration_cache[calibration_slot(temperature_10)];
+
+	if (slot->magic != CALIBRATION_MAGIC)
+		return;
+
+	// recalibrated through the console since this slot was written? Then the
+	// cached bias states belong to another neutral point: ignore them.
+	if (fabs(slot->gyro_x_neutral - config.sensors.gyro_x_neutral) > 1.0f ||
+	    fabs(slot->gyro_y_neutral - config.sensors.gyro_y_neutral) > 1.0f ||
+	    fabs(slot->gyro_z_neutral - config.sensors.gyro_z_neutral) > 1.0f)
+		return;
+
+	sensor_data.p_bias = slot->p_bias;
+	sensor_data.q_bias = slot->q_bias;
+}
+
+
+/*!
+ *  Called from the sensor task's housekeeping block (2-10Hz). After 20
+ *  consecutive stationary polls the bias states have had seconds of
+ *  undisturbed accelerometer corrections, so they are worth caching.
+ *  The page write happens pre-arm with the craft sitting still, where the
+ *  few ms on the SPI bus do not matter.
+ */
+void calibration_update(int temperature_10, int stationary)
+{
+	static int stationary_polls = 0;
+	struct CalibrationSlot *slot;
+
+	if (calibration_saved_this_boot)
+		return;
+
+	if (!stationary)
+	{
+		stationary_polls = 0;
+		return;
+	}
+
+	if (++stationary_polls < 20)
+		return;
+
+	slot = &calibration_cache[calibration_slot(temperature_10)];
+	slot->magic = CALIBRATION_MAGIC;
+	slot->temperature_10 = temperature_10;
+	slot->gyro_x_neutral = config.sensors.gyro_x_neutral;
+	slot->gyro_y_neutral = config.sensors.gyro_y_neutral;
+	slot->gyro_z_neutral = config.sensors.gyro_z_neutral;
+	slot->p_bias = sensor_data.p_bias;
+	slot->q_bias = sensor_data.q_bias;
+
+	dataflash.write(CALIBRATION_PAGE, sizeof(calibration_cache), (unsigned char*)calibration_cache);
+	calibration_saved_this_boot = 1;
 }
 
 
@@ -54,7 +236,7 @@ void configuration_determine_hardware_version()
 		microcontroller_delay_us(10);
 		if (PORTGbits.RG12 == 0)
 		{
-			//printf("RG12 and RG14 connected!\r\n");
+			//uart1_printf("RG12 and RG14 connected!\r\n");
 
 			if (PORTGbits.RG13 == 0)
 			{
@@ -85,12 +267,113 @@ void configuration_determine_hardware_version()
 }	
 
 
+//! Set by configuration_request_write(), cleared by configuration_commit().
+static volatile int configuration_write_requested = 0;
+
+
 /*!
- *  Writes the configuration struct to the 1st dataflash page.
+ *  Writes the configuration struct into the inactive dataflash bank and only
+ *  then marks it as the newest one (its header carries the next sequence
+ *  number). The active bank is never touched, so there is no point during
+ *  the write where the flash holds less than one complete, crc-valid
+ *  configuration. A write that would not change anything is skipped
+ *  entirely: a PID tuning session that burns the same values twice pays no
+ *  erase at all.
  */
 void configuration_write()
 {
-	dataflash.write(CONFIGURATION_PAGE, sizeof(struct Configuration), (unsigned char*)&config);
+	int bank;
+
+	if (active_bank != -1)
+	{
+		// unchanged since the last burn? Then don't wear the flash.
+		dataflash.read(CONFIGURATION_PAGE + active_bank * configuration_bank_pages(),
+		               sizeof(struct ConfigurationBank), (unsigned char*)&bank_image);
+		if (bank_image.magic == CONFIGURATION_BANK_MAGIC &&
+		    memcmp(&bank_image.config, &config, sizeof(struct Configuration)) == 0)
+			return;
+		bank = (active_bank + 1) % CONFIGURATION_BANKS;
+	}
+	else
+	{
+		// first new-style write: use the last bank so the bare pre-0.9
+		// struct at CONFIGURATION_PAGE survives until this write is complete
+		bank = CONFIGURATION_BANKS - 1;
+	}
+
+	bank_image.magic = CONFIGURATION_BANK_MAGIC;
+	bank_image.sequence = bank_sequence + 1;
+	memcpy(&bank_image.config, &config, sizeof(struct Configuration));
+	bank_image.crc = configuration_crc((unsigned char*)&bank_image.config, sizeof(struct Configuration));
+
+	dataflash.write(CONFIGURATION_PAGE + bank * configuration_bank_pages(),
+	                sizeof(struct ConfigurationBank), (unsigned char*)&bank_image);
+
+	bank_sequence++;
+	active_bank = bank;
+}
+
+
+/*!
+ *  Schedules a configuration write without doing it. The write itself is
+ *  picked up by the datalogger task (configuration_commit()), so the
+ *  console input task does not freeze the telemetry on the page erases.
+ */
+void configuration_request_write()
+{
+	configuration_write_requested = 1;
+}
+
+
+/*!
+ *  Runs a scheduled configuration write; called from the datalogger task
+ *  once per logging cycle (and from configuration_load(), to make a
+ *  scheduled write visible before reading back).
+ */
+void configuration_commit()
+{
+	if (configuration_write_requested)
+	{
+		configuration_write_requested = 0;
+		configuration_write();
+	}
+}
+
+
+/*!
+ *  Verifies one configuration bank against its stored crc and rebuilds it
+ *  from the ram copy when the check fails; the ram copy is the newest
+ *  configuration anyway, and the rewritten bank carries the next sequence
+ *  number so it simply becomes the active one. One bank per call keeps the
+ *  bus claim short. The caller holds the spi bus (background scrub, see
+ *  datalogger_scrub()).
+ *  @return 0 when the bank was clean (or the flash predates the bank
+ *          layout), 1 when bit rot was repaired, 2 when a blank or legacy
+ *          bank was silently seeded with a valid copy.
+ */
+int configuration_scrub(int bank)
+{
+	int had_magic;
+
+	if (bank < 0 || bank >= CONFIGURATION_BANKS || active_bank == -1)
+		return 0;   // pre-0.9 bare struct: nothing trustworthy to compare against
+
+	dataflash.read(CONFIGURATION_PAGE + bank * configuration_bank_pages(),
+	               sizeof(struct ConfigurationBank), (unsigned char*)&bank_image);
+	had_magic = (bank_image.magic == CONFIGURATION_BANK_MAGIC);
+	if (had_magic &&
+	    bank_image.crc == configuration_crc((unsigned char*)&bank_image.config, sizeof(struct Configuration)))
+		return 0;
+
+	bank_image.magic = CONFIGURATION_BANK_MAGIC;
+	bank_image.sequence = ++bank_sequence;
+	memcpy(&bank_image.config, &config, sizeof(struct Configuration));
+	bank_image.crc = configuration_crc((unsigned char*)&bank_image.config, sizeof(struct Configuration));
+	dataflash.write(CONFIGURATION_PAGE + bank * configuration_bank_pages(),
+	                sizeof(struct ConfigurationBank), (unsigned char*)&bank_image);
+	active_bank = bank;
+
+	return had_magic ? 1 : 2;
 }
 
 
@@ -151,9 +434,16 @@ void configuration_default()
     config.control.autopilot_auto_throttle = 0;   // disable auto throttle
 
     config.control.altitude_mode = PRESSURE;
+#ifdef ENABLE_QUADROCOPTER
+    config.control.servo_highrate_mask = 0x0f;   // 4 motor ESCs at 400Hz
+#else
+    config.control.servo_highrate_mask = 0;      // plain 50Hz servo frames
+#endif
     config.gps.operational_baudrate = 115200l;
     config.gps.initial_baudrate = 38400l;
     config.gps.enable_waas = 0;
+    config.gps.use_binary_protocol = 0;   // NMEA unless asked otherwise
+    config.gps.fix_rate_10hz = 0;         // 5Hz; not every module does 10Hz
     config.sensors.acc_x_neutral = 32000;
 	config.sensors.acc_y_neutral = 32000;
 	config.sensors.acc_z_neutral = 32000;
@@ -172,6 +462,15 @@ void configuration_default()
 	config.telemetry.stream_PressureTemp = 50;
 	config.telemetry.stream_Attitude = 5;
 	config.telemetry.stream_Control = 10;
+	config.telemetry.use_binary = 0;   // CSV unless the groundstation asks for binary
+	config.telemetry.stream2_GpsBasic = 0;      // second port disabled: uart2 stays with the gps
+	config.telemetry.stream2_GyroAccRaw = 0;
+	config.telemetry.stream2_GyroAccProc = 0;
+	config.telemetry.stream2_PPM = 0;
+	config.telemetry.stream2_PressureTemp = 0;
+	config.telemetry.stream2_Attitude = 0;
+	config.telemetry.aircraft_id = 0;   // single-plane: frames look like 0.8
+	config.telemetry.mirror = MIRROR_OFF;   // no second board
 
     config.osd.show_altitude = 1;
     config.osd.show_arrow_home = 1;
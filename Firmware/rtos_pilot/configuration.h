@@ -27,6 +27,27 @@ struct Configuration
 
 extern struct Configuration config;
 
+//! One cached sensor calibration, captured at a known board temperature.
+//! The gyroscope neutrals identify the configuration the bias states were
+//! estimated against: after a recalibration through the console the cached
+//! slots no longer match and are ignored.
+struct CalibrationSlot
+{
+	int magic;             //!< CALIBRATION_MAGIC when the slot holds data
+	int temperature_10;    //!< board temperature (0.1 deg C) at capture time
+	float gyro_x_neutral;
+	float gyro_y_neutral;
+	float gyro_z_neutral;
+	float p_bias;
+	float q_bias;
+};
+
+#define CALIBRATION_MAGIC  0x4CA1
+#define CALIBRATION_SLOTS  8       // 5 deg C bands covering 0..40 deg C
+
+//! Redundant on-flash copies of the configuration; see configuration.c.
+#define CONFIGURATION_BANKS 2
+
 #define V01J 1
 #define V01N 2
 #define V01O 3
@@ -40,6 +61,30 @@ void configuration_load();
 
 void configuration_write();
 
+//! Schedules a configuration write; the datalogger task performs it.
+void configuration_request_write();
+
+//! Performs a scheduled configuration write, if any. Datalogger context.
+void configuration_commit();
+
+//! Incremental crc16-ccitt; also behind the script burn trailer.
+unsigned int configuration_crc_update(unsigned int crc, unsigned char *data, int size);
+
+//! Crc-checks one bank and rewrites it from ram on a mismatch. Returns 0
+//! clean, 1 rot repaired, 2 blank bank seeded. Caller holds the spi bus.
+int configuration_scrub(int bank);
+
 void configuration_determine_hardware_version();
 
+//! Reads the calibration cache page into ram; called by configuration_load().
+void calibration_load();
+
+//! Seeds the kalman bias states from the cache slot matching the current
+//! board temperature. Call once, as soon as the barometer temperature is in.
+void calibration_apply(int temperature_10);
+
+//! Housekeeping call (2-10Hz): after a stretch of confirmed stillness the
+//! converged bias states are written back to the cache, once per boot.
+void calibration_update(int temperature_10, int stationary);
+
 #endif // CONFIGURATION_H
@@ -0,0 +1,53 @@
+/*!
+ *  @file     cpuload.c
+ *  @brief    Calibrated CPU load percentage, see cpuload.h.
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#include "timer/timer.h"
+
+#include "cpuload.h"
+
+extern unsigned long idle_counter;   // incremented by the idle hook in rtos_pilot.c
+
+static unsigned long window_start_ms = 0;
+static unsigned long window_start_count = 0;
+
+//! Fastest idle rate seen so far = the 100%-idle reference. A pre-scheduler
+//! calibration loop would measure the wrong thing here: the heartbeat table
+//! is still empty then (tasks register themselves after the scheduler
+//! starts), so the idle iteration would run several times faster than it
+//! ever does in flight. Peak tracking measures the real loop instead.
+static unsigned long peak_increments_per_ms = 1;
+
+static unsigned char load_percent = 0;
+
+
+void cpuload_update()
+{
+	unsigned long now = timer_millis();
+	unsigned long elapsed = now - window_start_ms;
+	unsigned long rate;
+
+	if (elapsed < 1000ul)
+		return;
+
+	// The idle task cannot be running while we are, and no isr touches
+	// idle_counter, so this 32-bit read cannot tear.
+	rate = (idle_counter - window_start_count) / elapsed;
+	if (rate > peak_increments_per_ms)
+		peak_increments_per_ms = rate;
+
+	load_percent = (unsigned char)(100ul - rate * 100ul / peak_increments_per_ms);
+
+	window_start_ms = now;
+	window_start_count = idle_counter;
+}
+
+
+unsigned char cpuload_percent()
+{
+	return load_percent;
+}
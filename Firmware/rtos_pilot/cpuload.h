@@ -0,0 +1,32 @@
+/*!
+ *  @file     cpuload.h
+ *  @brief    Calibrated CPU load percentage from the idle hook counter.
+ *  @detailed The idle hook spins incrementing idle_counter, so the counter
+ *            rate is a direct measure of spare CPU time - but the rate of a
+ *            100% idle CPU differs per board (hardware version, heartbeat
+ *            table size), so the raw counter was only ever eyeballed ad
+ *            hoc. This module turns it into a percentage: it tracks the
+ *            fastest increments-per-ms ever seen over a 1 second window as
+ *            the 100%-idle reference and reports each window's rate
+ *            against it. The reference converges during the mostly-idle
+ *            seconds right after boot (waiting for gps, rc, console), so
+ *            no bench calibration step is needed and mixed hardware
+ *            versions all self-calibrate. The value is appended to the TC
+ *            telemetry frame and logged in struct LogLine.
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+#ifndef CPULOAD_H
+#define CPULOAD_H
+
+//! Advances the 1 second measurement window when due. Called from one
+//! place only (the 10Hz telemetry task loop) so the bookkeeping needs no
+//! locking; other tasks just read cpuload_percent().
+void cpuload_update();
+
+//! CPU load over the last completed window, 0..100. Reads a cached byte,
+//! safe from any task. Reports 0 until the first window completes.
+unsigned char cpuload_percent();
+
+#endif // CPULOAD_H
@@ -0,0 +1,141 @@
+/*!
+ *  Idle-time CRC verification of the program flash, see flashcheck.h.
+ *
+ *  The flash is read with table reads (TBLPAG + __builtin_tblrdl/h)
+ *  rather than through the PSV window: PSV only maps 32KB at a time and
+ *  the compiler owns PSVPAG for the constants section, while TBLPAG is
+ *  saved and restored by the context switch (see port.c), so the idle
+ *  task can keep its own value across preemptions. Each instruction
+ *  word contributes its three programmed bytes (low, mid, upper) to the
+ *  crc16-ccitt from configuration.c - the same polynomial the bootloader
+ *  uses for the descriptor.
+ *
+ *  @file     flashcheck.c
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#include "microcontroller/microcontroller.h"
+
+#include "configuration.h"
+#include "handler_alarms.h"
+#include "flashcheck.h"
+
+
+struct FlashCheck flashcheck;
+
+//! Start of the last erase page (512 instruction words) on the
+//! dsPIC33FJ256MC710; the bootloader writes the descriptor here and the
+//! walk stops in front of it.
+#define FLASHCHECK_DESCRIPTOR_ADDR  0x02A800ul
+
+//! "GP" in the low word of the descriptor's first instruction word.
+#define FLASHCHECK_MAGIC            0x5047u
+
+//! Instruction words verified per idle slice: ~1.5KB of reads, well
+//! under a tick even with the crc bit loop, so no task ever waits on us.
+#define FLASHCHECK_WORDS_PER_STEP   256
+
+/* Descriptor layout, low 16 bits of four consecutive instruction words
+(the upper bytes stay erased):
+    +0  magic "GP"
+    +2  image length in program addresses, low word
+    +4  image length, high word
+    +6  crc16-ccitt over the image (seed 0xffff, 3 bytes per word)  */
+
+
+//! One instruction word, low word + upper byte, with TBLPAG restored.
+static unsigned long flashcheck_read_word(unsigned long addr)
+{
+	unsigned int save = TBLPAG;
+	unsigned long v;
+
+	TBLPAG = (unsigned int)(addr >> 16);
+	v = ((unsigned long)__builtin_tblrdh((unsigned int)addr) << 16) |
+	    __builtin_tblrdl((unsigned int)addr);
+	TBLPAG = save;
+	return v;
+}
+
+
+//! Alarm action (script-tick context): hand the telemetry task a flag to
+//! print, like the battery watches do.
+static void flashcheck_alarm()
+{
+	flashcheck.alarm_pending = 1;
+}
+
+
+void flashcheck_init()
+{
+	flashcheck.faults = 0;
+	flashcheck.passes = 0;
+	flashcheck.crc = 0;
+	flashcheck.expected_crc = 0;
+	flashcheck.descriptor_found = 0;
+	flashcheck.baseline_valid = 0;
+	flashcheck.alarm_pending = 0;
+	flashcheck.image_end = FLASHCHECK_DESCRIPTOR_ADDR;
+
+	if ((unsigned int)flashcheck_read_word(FLASHCHECK_DESCRIPTOR_ADDR) == FLASHCHECK_MAGIC)
+	{
+		unsigned long len = (unsigned int)flashcheck_read_word(FLASHCHECK_DESCRIPTOR_ADDR + 2) |
+		                    ((unsigned long)(unsigned int)flashcheck_read_word(FLASHCHECK_DESCRIPTOR_ADDR + 4) << 16);
+
+		if (len > 0 && len <= FLASHCHECK_DESCRIPTOR_ADDR && (len & 1) == 0)
+		{
+			flashcheck.image_end = len;
+			flashcheck.expected_crc = (unsigned int)flashcheck_read_word(FLASHCHECK_DESCRIPTOR_ADDR + 6);
+			flashcheck.descriptor_found = 1;
+			flashcheck.baseline_valid = 1;
+		}
+		// a bad length means a half-written descriptor: fall back to the
+		// self-baseline walk rather than alarming against garbage
+	}
+
+	// Fires once when faults rises above 0; it never re-arms (the image
+	// does not get better), so the watch costs one compare per tick.
+	alarms_subscribe(&flashcheck.faults, 0, 1, 0, &flashcheck_alarm);
+}
+
+
+void flashcheck_idle_step()
+{
+	static unsigned long addr = 0;
+	static unsigned int crc = 0xffff;
+	unsigned int save = TBLPAG;
+	unsigned char b[3];
+	int i;
+
+	for (i = 0; i < FLASHCHECK_WORDS_PER_STEP && addr < flashcheck.image_end; i++)
+	{
+		TBLPAG = (unsigned int)(addr >> 16);   // cheap; a slice may cross a page
+		b[0] = (unsigned char)__builtin_tblrdl((unsigned int)addr);
+		b[1] = (unsigned char)(__builtin_tblrdl((unsigned int)addr) >> 8);
+		b[2] = (unsigned char)__builtin_tblrdh((unsigned int)addr);
+		crc = configuration_crc_update(crc, b, 3);
+		addr += 2;
+	}
+	TBLPAG = save;
+
+	if (addr < flashcheck.image_end)
+		return;
+
+	// pass complete
+	flashcheck.crc = crc;
+	flashcheck.passes++;
+	if (flashcheck.baseline_valid)
+	{
+		if (crc != flashcheck.expected_crc)
+			flashcheck.faults++;   // the subscribed watch raises the alarm
+	}
+	else
+	{
+		// no descriptor: the first full walk becomes the baseline
+		flashcheck.expected_crc = crc;
+		flashcheck.baseline_valid = 1;
+	}
+	addr = 0;
+	crc = 0xffff;
+}
@@ -0,0 +1,51 @@
+/*!
+ *  Idle-time CRC verification of the program flash.
+ *
+ *  After a marginal bootloader session we have flown an image with a
+ *  corrupted page. This module re-reads the program flash in the
+ *  background - a few hundred instruction words per idle slice, from
+ *  vApplicationIdleHook - and checks the running image against a crc16
+ *  the bootloader leaves in a descriptor on the last erase page. When
+ *  the bootloader did not write one (older loaders), the first complete
+ *  walk becomes the baseline and later walks must keep matching it, so
+ *  bit rot is still caught, just not a bad flash session itself.
+ *
+ *  A mismatch raises an alarm through handler_alarms.c and the telemetry
+ *  task prints a panic line; the CF console command reports the running
+ *  counters. The walk never stops: after a full pass it simply starts
+ *  over, so the image is re-verified continuously for the cost of idle
+ *  cycles only.
+ *
+ *  @file     flashcheck.h
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#ifndef FLASHCHECK_H
+#define FLASHCHECK_H
+
+//! Progress and result counters, reported on the CF console line.
+struct FlashCheck
+{
+	unsigned int faults;            //!< completed passes with a crc mismatch; the alarm watch field
+	unsigned long passes;           //!< completed passes
+	unsigned int crc;               //!< crc of the last completed pass
+	unsigned int expected_crc;      //!< descriptor crc, or the baseline from pass 1
+	unsigned long image_end;        //!< first program address NOT covered by the walk
+	unsigned int descriptor_found : 1;   //!< 1 = verifying against the bootloader descriptor
+	unsigned int baseline_valid : 1;     //!< 1 once expected_crc holds a value to compare against
+	int alarm_pending;              //!< set by the alarm action, printed by the telemetry task
+};
+
+extern struct FlashCheck flashcheck;
+
+//! Reads and validates the bootloader descriptor and subscribes the
+//! alarm watch. Call once from main(), before the scheduler starts.
+void flashcheck_init();
+
+//! One bounded slice of the crc walk (a few hundred table reads). Called
+//! from vApplicationIdleHook; must stay preemptable and never block.
+void flashcheck_idle_step();
+
+#endif // FLASHCHECK_H
@@ -1,6 +1,7 @@
 
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
 
 // Include all FreeRTOS header files
 #include "FreeRTOS/FreeRTOS.h"
@@ -23,18 +24,77 @@
 #include "task_control.h"
 #include "configuration.h"
 #include "gluonscript.h"
+#include "warmstart.h"
+#include "uart1_queue/uart1_queue.h"
 
 
 volatile struct GluonscriptData gluonscript_data = {.current_codeline = 0, .last_code = 0, .tick = 0 };
 
+//! Dispatch table: the handler responsible for each opcode. NULL entries
+//! are the flow control opcodes handled in gluonscript_do() itself.
+static ScriptHandlerReturn (*opcode_handlers[SERVO_START_DST_TRIGGER + 1]) (struct GluonscriptCode *);
+
+//! Comparison ops of the compiled condition predicates. IF and UNTIL
+//! pairs share one op; the flow consequence (skip 2 lines vs. step back)
+//! stays with the opcode in gluonscript_do().
+enum predicate_op { PRED_GR = 0, PRED_SM, PRED_EQ, PRED_NE };
+
+//! Compiled form of an IF/UNTIL condition, one per codeline, filled in
+//! by gluonscript_compile(): the variable id resolved to its getter, the
+//! comparison op and the threshold. The tick path evaluates this record
+//! with one indirect call and one compare instead of re-walking the
+//! variable switch inside an 8-way opcode case.
+struct ScriptPredicate
+{
+	float (*get)(void);
+	float threshold;
+	unsigned char op;
+};
+static struct ScriptPredicate predicates[MAX_GLUONSCRIPTCODES];
+
+static int predicate_holds(int codeline);
+
 void gluonscript_init()
 {
+	int i;
+
 	gluonscript_data.current_codeline = 0;
 	gluonscript_data.last_code = 0;
 	gluonscript_data.tick = 0;
+
+	// after an in-flight reset: resume the flightplan at the codeline that
+	// was active, instead of restarting it from line 0 (last_code stays 0,
+	// so the line is re-entered and its handler re-initializes itself)
+	if (warmstart_codeline() >= 0)
+		gluonscript_data.current_codeline = warmstart_codeline();
+
+	for (i = 0; i <= SERVO_START_DST_TRIGGER; i++)
+		opcode_handlers[i] = NULL;
+	opcode_handlers[CLIMB] = navigation_handle_gluonscriptcommand;
+	opcode_handlers[FROM_TO_REL] = navigation_handle_gluonscriptcommand;
+	opcode_handlers[FROM_TO_ABS] = navigation_handle_gluonscriptcommand;
+	opcode_handlers[FLY_TO_REL] = navigation_handle_gluonscriptcommand;
+	opcode_handlers[FLY_TO_ABS] = navigation_handle_gluonscriptcommand;
+	opcode_handlers[CIRCLE_ABS] = navigation_handle_gluonscriptcommand;
+	opcode_handlers[CIRCLE_REL] = navigation_handle_gluonscriptcommand;
+	opcode_handlers[CIRCLE_TO_ABS] = navigation_handle_gluonscriptcommand;
+	opcode_handlers[CIRCLE_TO_REL] = navigation_handle_gluonscriptcommand;
+	opcode_handlers[FLARE_TO_ABS] = navigation_handle_gluonscriptcommand;
+	opcode_handlers[FLARE_TO_REL] = navigation_handle_gluonscriptcommand;
+	opcode_handlers[GLIDE_TO_ABS] = navigation_handle_gluonscriptcommand;
+	opcode_handlers[GLIDE_TO_REL] = navigation_handle_gluonscriptcommand;
+	opcode_handlers[SET_LOITER_POSITION] = navigation_handle_gluonscriptcommand;
+	opcode_handlers[LOITER_CIRCLE] = navigation_handle_gluonscriptcommand;
+	opcode_handlers[SERVO_TRIGGER] = trigger_handle_gluonscriptcommand;
+	opcode_handlers[SERVO_START_TRIGGER] = trigger_handle_gluonscriptcommand;
+	opcode_handlers[SERVO_STOP_TRIGGER] = trigger_handle_gluonscriptcommand;
+	opcode_handlers[SET_BATTERY_ALARM] = alarms_handle_gluonscriptcommand;
+	opcode_handlers[SET_FLIGHTPLAN_SWITCH] = flightplan_switch_handle_gluonscriptcommand;
+	opcode_handlers[SET_MAXIMUM_RANGE] = maximum_range_handle_gluonscriptcommand;
+
 	gluonscript_load();
 	navigation_init();
-}	
+}
 
 
 #define STACK_DEPTH 3
@@ -75,20 +135,26 @@ inline int stack_empty()
 }
 
 
-void gluonscript_do()  // executed when a new GPS line has arrived (5Hz)
+void gluonscript_do()  // executed at GLUONSCRIPT_HZ, clocked by the gps task's timer
 {
-	struct GluonscriptCode *current_code = & gluonscript_data.codes[gluonscript_data.current_codeline];
+	struct GluonscriptCode *current_code = (struct GluonscriptCode *) & gluonscript_data.codes[gluonscript_data.current_codeline];
 	ScriptHandlerReturn handlers_result = 0;
 	
 	gluonscript_data.tick++;
 	
-	// call all handlers, returns UNHANDLED 0, HANDLED_FINISHED 1 or HANDLED_UNFINISHED 2
-    handlers_result |= maximum_range_handle_gluonscriptcommand(current_code);
-    handlers_result |= flightplan_switch_handle_gluonscriptcommand(current_code);
-	handlers_result |= alarms_handle_gluonscriptcommand(current_code);
- 	handlers_result |= trigger_handle_gluonscriptcommand(current_code);
- 	handlers_result |= navigation_handle_gluonscriptcommand(current_code);
- 	
+	// the opcode independent (watchdog style) work of every handler
+    handlers_result |= maximum_range_periodic();
+    handlers_result |= flightplan_switch_periodic();
+	handlers_result |= alarms_periodic();
+ 	handlers_result |= trigger_periodic();
+ 	handlers_result |= navigation_periodic();
+
+	// one indexed call instead of an opcode switch in every handler,
+	// returns UNHANDLED 0, HANDLED_FINISHED 1 or HANDLED_UNFINISHED 2
+	if (current_code->opcode <= SERVO_START_DST_TRIGGER && opcode_handlers[current_code->opcode] != NULL)
+		handlers_result |= opcode_handlers[current_code->opcode](current_code);
+
+
  	if (handlers_result & HANDLED_FINISHED)  // one of the handlers already handled it completely
  	{
 		gluonscript_data.current_codeline++;
@@ -99,65 +165,29 @@ void gluonscript_do()  // executed when a new GPS line has arrived (5Hz)
 		{
 			case CALL:
 				push_codeline();
-				if (current_code->a < 0)
-					gluonscript_data.current_codeline = gluonscript_data.current_codeline + current_code->a;
-				else
-					gluonscript_data.current_codeline = current_code->a;
+				gluonscript_data.current_codeline = current_code->a;   // folded to absolute by gluonscript_compile()
 				break;
 			case RETURN:
 				pop_codeline();
 				gluonscript_data.current_codeline++;
 				break;
 			case GOTO:
-				if (current_code->a < 0)
-					gluonscript_data.current_codeline = gluonscript_data.current_codeline + current_code->a;
-				else
-					gluonscript_data.current_codeline = current_code->a;
-				break;
-			case UNTIL_GR:
-				if (gluonscript_get_variable(current_code->a) > current_code->x)
-					gluonscript_data.current_codeline++;
-				else
-					gluonscript_data.current_codeline--;
-				break;
-			case UNTIL_SM:
-				if (gluonscript_get_variable(current_code->a) < current_code->x)
-					gluonscript_data.current_codeline++;
-				else
-					gluonscript_data.current_codeline--;
+				gluonscript_data.current_codeline = current_code->a;   // folded to absolute by gluonscript_compile()
 				break;
+			case UNTIL_GR:   // getter, op and threshold were compiled into the
+			case UNTIL_SM:   // predicate record by gluonscript_compile()
 			case UNTIL_EQ:
-				if (fabs(gluonscript_get_variable(current_code->a) - current_code->x) < 1e-6f)
-					gluonscript_data.current_codeline++;
-				else
-					gluonscript_data.current_codeline--;
-				break;
 			case UNTIL_NE:
-				if (fabs(gluonscript_get_variable(current_code->a) - current_code->x) > 1e-6f)
+				if (predicate_holds(gluonscript_data.current_codeline))
 					gluonscript_data.current_codeline++;
 				else
 					gluonscript_data.current_codeline--;
 				break;
 			case IF_GR:
-				if (gluonscript_get_variable(current_code->a) > current_code->x)
-					gluonscript_data.current_codeline++;
-				else
-					gluonscript_data.current_codeline += 2;
-				break;
 			case IF_SM:
-				if (gluonscript_get_variable(current_code->a) < current_code->x)
-					gluonscript_data.current_codeline++;
-				else
-					gluonscript_data.current_codeline += 2;
-				break;
 			case IF_EQ:
-				if (fabs(gluonscript_get_variable(current_code->a) - current_code->x) < 1e-6f)
-					gluonscript_data.current_codeline++;
-				else
-					gluonscript_data.current_codeline += 2;
-				break;
 			case IF_NE:
-				if (fabs(gluonscript_get_variable(current_code->a) - current_code->x) > 1e-6f)
+				if (predicate_holds(gluonscript_data.current_codeline))
 					gluonscript_data.current_codeline++;
 				else
 					gluonscript_data.current_codeline += 2;
@@ -192,7 +222,7 @@ void gluonscript_do()  // executed when a new GPS line has arrived (5Hz)
 			case EMPTYCMD: // should not happen!!!
 				navigation_data.desired_pre_bank = 0.0f;
 				navigation_data.desired_throttle_pct = -1;
-                //printf("\r\nEmpty navigation command\r\n");
+                //uart1_printf("\r\nEmpty navigation command\r\n");
 				gluonscript_data.current_codeline = 0;
 				// also return home @ 100m height
 				navigation_data.desired_heading_rad = navigation_heading_rad_fromto(sensor_data.gps.longitude_rad,
@@ -203,7 +233,7 @@ void gluonscript_do()  // executed when a new GPS line has arrived (5Hz)
 				if (handlers_result == NOT_HANDLED)
 				{
 					navigation_data.desired_pre_bank = 0.0f;
-                    printf("\r\nUnhandled navigation command: opcode %d\r\n", current_code->opcode);
+                    uart1_printf("\r\nUnhandled navigation command: opcode %d\r\n", current_code->opcode);
 					gluonscript_data.current_codeline = 0;
 					// also return home @ 100m height
 					navigation_data.desired_heading_rad = navigation_heading_rad_fromto(sensor_data.gps.longitude_rad,
@@ -223,101 +253,177 @@ void gluonscript_goto_from_gcs(int line_number)
 		gluonscript_data.current_codeline = line_number;
 }
 
+/*
+ *  Per-variable getters behind gluonscript_get_variable() and the
+ *  compiled condition predicates, indexed by enum gluonscript_variable
+ *  through variable_getters[] below.
+ */
+static float get_height()
+{
+	if (config.control.altitude_mode == GPS_ABSOLUTE)
+		return sensor_data.gps.height_m;
+	else if (config.control.altitude_mode == GPS_RELATIVE)
+		return sensor_data.gps.height_m - navigation_data.home_gps_height;
+	else //if (config.control.altitude_mode == PRESSURE)
+		return sensor_data.pressure_height - navigation_data.home_pressure_height;
+}
+
+static float get_speed_ms()
+{
+	return sensor_data.gps.speed_ms;
+}
+
+static float get_heading_deg()
+{
+	return RAD2DEG(sensor_data.gps.heading_rad);
+}
+
+static float get_flight_time_s()
+{
+	return (float)navigation_data.time_airborne_s;
+}
+
+static float get_satellites_in_view()
+{
+	return sensor_data.gps.satellites_in_view;
+}
+
+static float get_home_distance()
+{
+	return navigation_distance_between_meter(sensor_data.gps.longitude_rad, navigation_data.home_longitude_rad,
+	                                         sensor_data.gps.latitude_rad, navigation_data.home_latitude_rad);
+}
+
+static float get_ppm_link_alive()
+{
+	return ppm.connection_alive ? 1.0f : 0.0f;
+}
+
+static float get_channel_1() { return (float)ppm.channel[0]; }
+static float get_channel_2() { return (float)ppm.channel[1]; }
+static float get_channel_3() { return (float)ppm.channel[2]; }
+static float get_channel_4() { return (float)ppm.channel[3]; }
+static float get_channel_5() { return (float)ppm.channel[4]; }
+static float get_channel_6() { return (float)ppm.channel[5]; }
+static float get_channel_7() { return (float)ppm.channel[6]; }
+static float get_channel_8() { return (float)ppm.channel[7]; }
+
+static float get_batt_v()
+{
+	return (float)(sensor_data.battery1_voltage_10)/10.0f;
+}
+
+static float get_block_time()
+{
+	return (float)navigation_data.time_block_s;
+}
+
+static float get_abs_altitude_error()
+{
+	return fabs(control_state.desired_altitude - get_height());
+}
+
+static float get_abs_heading_error()
+{
+	float heading_error;
+	struct GluonscriptCode *next_code = (struct GluonscriptCode *) & gluonscript_data.codes[gluonscript_data.current_codeline+1];
+	if (next_code->opcode != FROM_TO_ABS && next_code->opcode != FLY_TO_ABS && next_code->opcode != CIRCLE_ABS &&
+	    next_code->opcode != FLARE_TO_ABS && next_code->opcode != GLIDE_TO_ABS && next_code->opcode != CIRCLE_TO_ABS)  // was || next_code->opcode != CIRCLE_TO_ABS
+	{
+		next_code = (struct GluonscriptCode *) & gluonscript_data.codes[gluonscript_data.current_codeline+2];
+		if (next_code->opcode != FROM_TO_ABS && next_code->opcode != FLY_TO_ABS && next_code->opcode != CIRCLE_ABS &&
+		    next_code->opcode != FLARE_TO_ABS && next_code->opcode != GLIDE_TO_ABS && next_code->opcode != CIRCLE_TO_ABS)
+		{
+			next_code = (struct GluonscriptCode *) & gluonscript_data.codes[gluonscript_data.current_codeline+3];
+			if (next_code->opcode != FROM_TO_ABS && next_code->opcode != FLY_TO_ABS && next_code->opcode != CIRCLE_ABS &&
+			    next_code->opcode != FLARE_TO_ABS && next_code->opcode != GLIDE_TO_ABS && next_code->opcode != CIRCLE_TO_ABS)
+				uart1_printf("\r\nBad ABS_HEADING_ERR position\r\n");
+		}
+	}
+
+	heading_error = navigation_heading_rad_fromto((float)(sensor_data.gps.longitude_rad - (double)(next_code->y)),
+	                                              (float)(sensor_data.gps.latitude_rad - (double)(next_code->x)));
+	heading_error = RAD2DEG(heading_error - sensor_data.gps.heading_rad);
+	if (heading_error > 180.0f)
+		heading_error -= 360.0f;
+	else if (heading_error < -180.0f)
+		heading_error += 360.0f;
+	return fabs(heading_error);
+}
+
+static float get_abs_alt_and_heading_err()
+{
+	/*struct GluonscriptCode *next = gluonscript_next_waypoint_code(gluonscript_data.current_codeline);
+
+	float heading_error = navigation_heading_rad_fromto((float)(sensor_data.gps.longitude_rad - (double)(next->y)),
+                                                           (float)(sensor_data.gps.latitude_rad - (double)(next->x)));
+	heading_error = RAD2DEG(heading_error - sensor_data.gps.heading_rad);
+	//uart1_printf("\r\n%d\r\n", (int)heading_error);
+	if (heading_error > 180.0f)
+		heading_error -= 360.0f;
+	else if (heading_error < -180.0f)
+		heading_error += 360.0f;*/
+	return get_abs_altitude_error() + get_abs_heading_error(); //fabs(heading_error);
+}
+
+//! Getter dispatch, indexed by enum gluonscript_variable. Resolved into
+//! the predicate records at compile time; the id 0 slot stays NULL.
+static float (* const variable_getters[ABS_ALT_AND_HEADING_ERR + 1])(void) =
+{
+	[HEIGHT]                  = get_height,
+	[SPEED_MS]                = get_speed_ms,
+	[HEADING_DEG]             = get_heading_deg,
+	[FLIGHT_TIME_S]           = get_flight_time_s,
+	[SATELLITES_IN_VIEW]      = get_satellites_in_view,
+	[HOME_DISTANCE]           = get_home_distance,
+	[PPM_LINK_ALIVE]          = get_ppm_link_alive,
+	[CHANNEL_1]               = get_channel_1,
+	[CHANNEL_2]               = get_channel_2,
+	[CHANNEL_3]               = get_channel_3,
+	[CHANNEL_4]               = get_channel_4,
+	[CHANNEL_5]               = get_channel_5,
+	[CHANNEL_6]               = get_channel_6,
+	[CHANNEL_7]               = get_channel_7,
+	[CHANNEL_8]               = get_channel_8,
+	[BATT_V]                  = get_batt_v,
+	[BLOCK_TIME]              = get_block_time,
+	[ABS_ALTITUDE_ERROR]      = get_abs_altitude_error,
+	[ABS_HEADING_ERROR]       = get_abs_heading_error,
+	[ABS_ALT_AND_HEADING_ERR] = get_abs_alt_and_heading_err
+};
+
 float gluonscript_get_variable(enum gluonscript_variable i)
 {
-	switch (i)
+	if (i < HEIGHT || i > ABS_ALT_AND_HEADING_ERR || variable_getters[i] == NULL)
+		return 0.0;
+	return variable_getters[i]();
+}
+
+
+//! Evaluates the compiled condition of the given codeline: one indirect
+//! call into the getter table, one compare against the stored threshold.
+static int predicate_holds(int codeline)
+{
+	struct ScriptPredicate *p = & predicates[codeline];
+	float value = p->get();
+
+	switch (p->op)
 	{
-		case HEIGHT:
-            if (config.control.altitude_mode == GPS_ABSOLUTE)
-                return sensor_data.gps.height_m;
-            else if (config.control.altitude_mode == GPS_RELATIVE)
-                return sensor_data.gps.height_m - navigation_data.home_gps_height;
-            else //if (config.control.altitude_mode == PRESSURE)
-                return sensor_data.pressure_height - navigation_data.home_pressure_height;
-		case SPEED_MS:
-			return sensor_data.gps.speed_ms;
-		case HEADING_DEG:
-			return RAD2DEG(sensor_data.gps.heading_rad);
-		case FLIGHT_TIME_S:
-			return (float)navigation_data.time_airborne_s;
-		case SATELLITES_IN_VIEW:
-			return sensor_data.gps.satellites_in_view;
-		case HOME_DISTANCE:
-			return navigation_distance_between_meter(sensor_data.gps.longitude_rad, navigation_data.home_longitude_rad,
-			                                         sensor_data.gps.latitude_rad, navigation_data.home_latitude_rad);
-		case PPM_LINK_ALIVE:
-			return ppm.connection_alive ? 1.0f : 0.0f;
-		case CHANNEL_1:
-			return (float)ppm.channel[0];
-		case CHANNEL_2:
-			return (float)ppm.channel[1];
-		case CHANNEL_3:
-			return (float)ppm.channel[2];
-		case CHANNEL_4:
-			return (float)ppm.channel[3];
-		case CHANNEL_5:
-			return (float)ppm.channel[4];
-		case CHANNEL_6:
-			return (float)ppm.channel[5];
-		case CHANNEL_7:
-			return (float)ppm.channel[6];
-		case CHANNEL_8:
-			return (float)ppm.channel[7];
-		case BATT_V:
-			return (float)(sensor_data.battery1_voltage_10)/10.0f;
-        case BLOCK_TIME:
-            return (float)navigation_data.time_block_s;
-        case ABS_ALTITUDE_ERROR:
-        	return fabs(control_state.desired_altitude - gluonscript_get_variable(HEIGHT));
-        case ABS_HEADING_ERROR:
-        {
-	        struct GluonscriptCode *next_code = & gluonscript_data.codes[gluonscript_data.current_codeline+1];
-	        if (next_code->opcode != FROM_TO_ABS && next_code->opcode != FLY_TO_ABS && next_code->opcode != CIRCLE_ABS && 
-                next_code->opcode != FLARE_TO_ABS && next_code->opcode != GLIDE_TO_ABS && next_code->opcode != CIRCLE_TO_ABS)  // was || next_code->opcode != CIRCLE_TO_ABS
-            {
-                next_code = & gluonscript_data.codes[gluonscript_data.current_codeline+2];
-	            if (next_code->opcode != FROM_TO_ABS && next_code->opcode != FLY_TO_ABS && next_code->opcode != CIRCLE_ABS && 
-	                next_code->opcode != FLARE_TO_ABS && next_code->opcode != GLIDE_TO_ABS && next_code->opcode != CIRCLE_TO_ABS)
-	            {
-	                next_code = & gluonscript_data.codes[gluonscript_data.current_codeline+3];
-	            	if (next_code->opcode != FROM_TO_ABS && next_code->opcode != FLY_TO_ABS && next_code->opcode != CIRCLE_ABS && 
-	                	next_code->opcode != FLARE_TO_ABS && next_code->opcode != GLIDE_TO_ABS && next_code->opcode != CIRCLE_TO_ABS)
-	               		printf("\r\nBad ABS_HEADING_ERR position\r\n");
-	            }   		
-			}
-			
-            float heading_error = navigation_heading_rad_fromto((float)(sensor_data.gps.longitude_rad - (double)(next_code->y)),
-	                                                           (float)(sensor_data.gps.latitude_rad - (double)(next_code->x)));
-	        heading_error = RAD2DEG(heading_error - sensor_data.gps.heading_rad);
-	        if (heading_error > 180.0f)
-	        	heading_error -= 360.0f;
-	        else if (heading_error < -180.0f)
-	        	heading_error += 360.0f;
-        	return fabs(heading_error);
-	    } 
-        case ABS_ALT_AND_HEADING_ERR:
-        {
-            /*struct GluonscriptCode *next = gluonscript_next_waypoint_code(gluonscript_data.current_codeline);
-			                
-            float heading_error = navigation_heading_rad_fromto((float)(sensor_data.gps.longitude_rad - (double)(next->y)),
-	                                                           (float)(sensor_data.gps.latitude_rad - (double)(next->x)));
-			heading_error = RAD2DEG(heading_error - sensor_data.gps.heading_rad);
-			//printf("\r\n%d\r\n", (int)heading_error);
-	        if (heading_error > 180.0f)
-	        	heading_error -= 360.0f;
-	        else if (heading_error < -180.0f)
-	        	heading_error += 360.0f;*/
-        	return gluonscript_get_variable(ABS_ALTITUDE_ERROR) + gluonscript_get_variable(ABS_HEADING_ERROR); //fabs(heading_error);
-        }	
-        default:
-			return 0.0;
-	}	
-}	
+		case PRED_GR:
+			return value > p->threshold;
+		case PRED_SM:
+			return value < p->threshold;
+		case PRED_EQ:
+			return fabs(value - p->threshold) < 1e-6f;
+		default: // PRED_NE
+			return fabs(value - p->threshold) > 1e-6f;
+	}
+}
 
 
 struct GluonscriptCode * gluonscript_next_waypoint_code(int current_codeline)
 {
-	struct GluonscriptCode *next = & (gluonscript_data.codes[current_codeline+1]);
+	struct GluonscriptCode *next = (struct GluonscriptCode *) & (gluonscript_data.codes[current_codeline+1]);
 	
 	if (next->opcode != FROM_TO_ABS && next->opcode != FLY_TO_ABS && next->opcode != CIRCLE_ABS && 
         next->opcode != FLARE_TO_ABS && next->opcode != GLIDE_TO_ABS && next->opcode != CIRCLE_TO_ABS)
@@ -330,7 +436,7 @@ struct GluonscriptCode * gluonscript_next_waypoint_code(int current_codeline)
 				current_codeline = (current_codeline + 1) + next->a - 2;
 		}		
 		
-		next = & gluonscript_data.codes[current_codeline+2];
+		next = (struct GluonscriptCode *) & gluonscript_data.codes[current_codeline+2];
 		if (next->opcode != FROM_TO_ABS && next->opcode != FLY_TO_ABS && next->opcode != CIRCLE_ABS && 
             next->opcode != FLARE_TO_ABS && next->opcode != GLIDE_TO_ABS && next->opcode != CIRCLE_TO_ABS)
 		{
@@ -341,23 +447,209 @@ struct GluonscriptCode * gluonscript_next_waypoint_code(int current_codeline)
 				else
 					current_codeline = (current_codeline + 1) + next->a - 3;
 			}
-			next = & gluonscript_data.codes[current_codeline+3];
+			next = (struct GluonscriptCode *) & gluonscript_data.codes[current_codeline+3];
 			if (next->opcode != FROM_TO_ABS && next->opcode != FLY_TO_ABS && next->opcode != CIRCLE_ABS && 
 			    next->opcode != FLARE_TO_ABS && next->opcode != GLIDE_TO_ABS)
-				printf("\r\nNext code not found!!\r\n");
+				uart1_printf("\r\nNext code not found!!\r\n");
 		}   		
 	}
 	return next;
 }
 
 
+/*!
+ *  One-shot validation / constant folding pass over gluonscript_data.codes.
+ *
+ *  The runtime used to trust whatever came out of dataflash: GOTO and CALL
+ *  paid an "is the target relative?" branch on every tick, and a corrupt
+ *  opcode only surfaced mid-flight as an "Unhandled navigation command"
+ *  reset to line 0. Running this pass after every load or upload instead
+ *   - rejects unknown opcodes,
+ *   - folds relative GOTO/CALL targets (a < 0) into absolute line indices
+ *     and rejects targets outside the program,
+ *   - rejects out-of-range IF/UNTIL variable ids, an UNTIL on line 0 (it
+ *     would step back to line -1) and bad SERVO_SET channels,
+ *  so gluonscript_do() can take every flow target unconditionally.
+ *  It also compiles every IF/UNTIL condition into its predicate record,
+ *  resolving the variable id to a getter once, here, instead of once per
+ *  tick in the interpreter loop.
+ *  Returns -1 for a valid program, or the first offending codeline.
+ */
+
+//! Fills the predicate record of a validated IF/UNTIL line.
+static void compile_predicate(int codeline, struct GluonscriptCode *code)
+{
+	struct ScriptPredicate *p = & predicates[codeline];
+
+	p->get = variable_getters[code->a];
+	p->threshold = code->x;
+	switch (code->opcode)
+	{
+		case IF_GR:
+		case UNTIL_GR:
+			p->op = PRED_GR;
+			break;
+		case IF_SM:
+		case UNTIL_SM:
+			p->op = PRED_SM;
+			break;
+		case IF_EQ:
+		case UNTIL_EQ:
+			p->op = PRED_EQ;
+			break;
+		default: // IF_NE / UNTIL_NE
+			p->op = PRED_NE;
+			break;
+	}
+}
+
+int gluonscript_compile()
+{
+	int i;
+
+	for (i = 0; i < MAX_GLUONSCRIPTCODES; i++)
+	{
+		struct GluonscriptCode *code = (struct GluonscriptCode *) & gluonscript_data.codes[i];
+
+		if (code->opcode > SERVO_START_DST_TRIGGER)
+			return i;
+
+		switch (code->opcode)
+		{
+			case GOTO:
+			case CALL:
+				if (code->a < 0)
+					code->a += i;   // fold relative -> absolute, once
+				if (code->a < 0 || code->a >= MAX_GLUONSCRIPTCODES)
+					return i;
+				break;
+			case IF_GR:
+			case IF_SM:
+			case IF_EQ:
+			case IF_NE:
+				if (i + 2 >= MAX_GLUONSCRIPTCODES)   // "false" skips 2 lines
+					return i;
+				if (code->a < HEIGHT || code->a > ABS_ALT_AND_HEADING_ERR)
+					return i;
+				compile_predicate(i, code);
+				break;
+			case UNTIL_GR:
+			case UNTIL_SM:
+			case UNTIL_EQ:
+			case UNTIL_NE:
+				if (i == 0)   // "not yet" steps back to the previous line
+					return i;
+				if (code->a < HEIGHT || code->a > ABS_ALT_AND_HEADING_ERR)
+					return i;
+				compile_predicate(i, code);
+				break;
+			case SERVO_SET:
+				if (code->a < 0 || code->a > 7)
+					return i;
+				break;
+			default:   // the handler opcodes check their own arguments
+				break;
+		}
+	}
+	return -1;
+}
+
+
+//! Marks a script image that carries the crc trailer (0.9 and later).
+#define GLUONSCRIPT_BURN_MAGIC 0x6B5C
+
 void gluonscript_burn()
 {
-	dataflash.write(NAVIGATION_PAGE, sizeof(gluonscript_data.codes), (unsigned char*) & (gluonscript_data.codes));
+	gluonscript_data.burn_magic = GLUONSCRIPT_BURN_MAGIC;
+	gluonscript_data.burn_crc = configuration_crc_update(0xffff,
+	                (unsigned char*) & (gluonscript_data.codes), sizeof(gluonscript_data.codes));
+	// codes, magic and crc are contiguous in the struct: one write
+	dataflash.write(NAVIGATION_PAGE, sizeof(gluonscript_data.codes) + 2*sizeof(unsigned int),
+	                (unsigned char*) & (gluonscript_data.codes));
+}
+
+
+/*!
+ *    One step of the background flash scrub (see datalogger_scrub() in
+ *    task_datalogger.c): reads one dataflash page of the burned script per
+ *    call and accumulates its crc. The script has no second bank to repair
+ *    from - and the ram copy may hold unburned edits - so a mismatch is
+ *    only reported, not repaired.
+ *    @return 0 while a pass is in progress, 1 when the pass finished clean
+ *            (or the flash holds a pre-crc burn there is nothing to check
+ *            against), -1 when the stored script fails its crc.
+ */
+int gluonscript_scrub_step()
+{
+	static unsigned char *scratch = 0;
+	static int pass_page = 0;
+	static unsigned int running_crc;
+	static unsigned char trailer[2 * sizeof(unsigned int)];
+	const int codes_size = (int)sizeof(gluonscript_data.codes);
+	const int image_size = codes_size + 2 * (int)sizeof(unsigned int);
+	long offset = (long)pass_page * PAGE_SIZE;
+	unsigned int flash_magic, flash_crc;
+	int i, n, crc_n;
+
+	if (scratch == 0)
+		scratch = (unsigned char*) pvPortMalloc(PAGE_SIZE);   // heap_1: allocated once, never freed
+
+	if (pass_page == 0)
+		running_crc = 0xffff;
+
+	n = PAGE_SIZE;
+	if (offset + n > image_size)
+		n = image_size - (int)offset;
+	dataflash.read(NAVIGATION_PAGE + pass_page, n, scratch);
+
+	crc_n = n;
+	if (offset + crc_n > codes_size)
+		crc_n = codes_size - (int)offset;   // negative when this chunk is pure trailer
+	if (crc_n > 0)
+		running_crc = configuration_crc_update(running_crc, scratch, crc_n);
+	for (i = (crc_n > 0 ? crc_n : 0); i < n; i++)
+		trailer[offset + i - codes_size] = scratch[i];
+
+	pass_page++;
+	if (offset + n < image_size)
+		return 0;   // more pages to go
+
+	pass_page = 0;
+	memcpy(&flash_magic, &trailer[0], sizeof(unsigned int));
+	memcpy(&flash_crc, &trailer[sizeof(unsigned int)], sizeof(unsigned int));
+	if (flash_magic != GLUONSCRIPT_BURN_MAGIC)
+		return 1;
+	return (flash_crc == running_crc) ? 1 : -1;
 }
 
 
 void gluonscript_load()
 {
-	dataflash.read(NAVIGATION_PAGE, sizeof(gluonscript_data.codes), (unsigned char*) & (gluonscript_data.codes));
+	int bad;
+	int cleared = 0;
+
+	dataflash.read(NAVIGATION_PAGE, sizeof(gluonscript_data.codes) + 2*sizeof(unsigned int),
+	               (unsigned char*) & (gluonscript_data.codes));
+
+	// burned with a crc trailer? Then catch bit rot loudly instead of
+	// flying a silently corrupted plan; the compile pass below still
+	// blanks anything structurally invalid either way.
+	if (gluonscript_data.burn_magic == GLUONSCRIPT_BURN_MAGIC &&
+	    gluonscript_data.burn_crc != configuration_crc_update(0xffff,
+	            (unsigned char*) & (gluonscript_data.codes), sizeof(gluonscript_data.codes)))
+		uart1_printf("\r\nGluonscript: stored script fails its crc!\r\n");
+
+	// flash may hold a legacy plan with relative targets, or plain garbage
+	// when the page was never burned: fold/validate here and blank every
+	// line that does not survive it (EMPTYCMD = return home), so the
+	// runtime never executes an invalid one
+	while ((bad = gluonscript_compile()) >= 0)
+	{
+		gluonscript_data.codes[bad].opcode = EMPTYCMD;
+		gluonscript_data.codes[bad].a = 0;
+		gluonscript_data.codes[bad].b = 0;
+		cleared++;
+	}
+	if (cleared > 0)
+		uart1_printf("\r\nGluonscript: %d invalid line(s) cleared\r\n", cleared);
 }	
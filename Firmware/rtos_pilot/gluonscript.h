@@ -3,7 +3,7 @@
 
 
 #define MAX_GLUONSCRIPTCODES 72
-#define GLUONSCRIPT_HZ 5
+#define GLUONSCRIPT_HZ 10
 
 enum gluonscript_handler_return
 {
@@ -93,6 +93,11 @@ struct GluonscriptData
 {
 	//! Stores the list of waypoints.
 	struct GluonscriptCode codes[MAX_GLUONSCRIPTCODES];
+	//! Burned to flash right behind the codes, in the same write: lets the
+	//! background scrub (and gluonscript_load) crc-check the stored script.
+	//! Scripts burned by older firmware lack the magic and are not checked.
+	unsigned int burn_magic;
+	unsigned int burn_crc;
 	int current_codeline;       //!< Index in the waypoint array pointing to the current waypoint.
 	int last_code;
 	unsigned int tick;
@@ -103,8 +108,11 @@ extern volatile struct GluonscriptData gluonscript_data;
 void gluonscript_do();
 float gluonscript_get_variable(enum gluonscript_variable i);
 struct GluonscriptCode * gluonscript_next_waypoint_code(int current_codeline);
+int gluonscript_compile();
 void gluonscript_burn();	
 void gluonscript_load();
+//! One page of the background crc check of the burned script; see gluonscript.c.
+int gluonscript_scrub_step();
 void gluonscript_init();
 
 void gluonscript_goto_from_gcs(int line_number);
@@ -0,0 +1,157 @@
+/*!
+ *  On-demand raw 1kHz gyro capture, see gyrocapture.h.
+ *
+ *  Producer/consumer split like the LogLine ring in task_datalogger.c:
+ *  the sensor task pushes raw samples at 1kHz, the datalogger task pops
+ *  them into capture pages. Single producer, single consumer, int index
+ *  stores are atomic on this core, so no locking. The ring buffers 96
+ *  samples (96ms at capture rate against the datalogger's 20ms capture
+ *  wakes), which rides out a page program; a flash stall beyond that
+ *  shows up in the drop counter instead of blocking the sampling loop.
+ *
+ *  @file     gyrocapture.c
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#include "FreeRTOS/FreeRTOS.h"
+#include "FreeRTOS/task.h"
+
+#include "mpu6000/mpu6000.h"
+
+#include "heartbeat.h"
+#include "gyrocapture.h"
+
+
+struct GyroCapture gyrocapture;
+
+enum CaptureStates { CAPTURE_IDLE = 0, CAPTURE_ARMED, CAPTURE_SAMPLING, CAPTURE_DRAINING };
+static volatile int state = CAPTURE_IDLE;
+static int capture_seconds = 1;
+
+#define CAPTURE_RING_SAMPLES 96
+static int ring[CAPTURE_RING_SAMPLES][3];
+static volatile int ring_head = 0;   // next slot the sensor task fills
+static volatile int ring_tail = 0;   // next slot the datalogger drains
+
+
+void gyrocapture_start(int seconds)
+{
+	if (state != CAPTURE_IDLE)
+		return;
+	if (seconds < 1)
+		seconds = 1;
+	if (seconds > GYROCAPTURE_MAX_SECONDS)
+		seconds = GYROCAPTURE_MAX_SECONDS;
+	capture_seconds = seconds;
+	gyrocapture.samples = 0;
+	gyrocapture.drops = 0;
+	gyrocapture.timeouts = 0;
+	ring_head = 0;
+	ring_tail = 0;
+	state = CAPTURE_ARMED;
+}
+
+
+int gyrocapture_sampling_due()
+{
+	return state == CAPTURE_ARMED;
+}
+
+
+int gyrocapture_active()
+{
+	return state != CAPTURE_IDLE;
+}
+
+
+#ifdef MPU6000_USE_INT
+
+void gyrocapture_sample(int heartbeat_id)
+{
+	unsigned long target = (unsigned long)capture_seconds * GYROCAPTURE_RATE_HZ;
+	int next;
+
+	state = CAPTURE_SAMPLING;
+	mpu6000_enable_data_ready_int(0);   // 1kHz / (0+1)
+
+	while (gyrocapture.samples + gyrocapture.timeouts < target)
+	{
+		// checkin every 8th sample: 8ms, inside the task's 20ms heartbeat
+		if (((gyrocapture.samples + gyrocapture.timeouts) & 0x07) == 0)
+			heartbeat_checkin(heartbeat_id);
+
+		if (! mpu6000_wait_data_ready( ( portTickType ) 4 / portTICK_RATE_MS ))
+		{
+			gyrocapture.timeouts++;   // dead INT line degrades to a short capture
+			continue;
+		}
+#ifdef MPU6000_USE_DMA
+		mpu6000_start_sensor_readings();
+		mpu6000_wait_sensor_readings();
+#else
+		mpu6000_update_sensor_readings();
+#endif
+		next = ring_head + 1;
+		if (next >= CAPTURE_RING_SAMPLES)
+			next = 0;
+		if (next == ring_tail)
+		{
+			gyrocapture.drops++;
+			gyrocapture.samples++;   // keep the capture length in time, not in samples
+			continue;
+		}
+		ring[ring_head][0] = mpu6000_raw_sensor_readings.gyro_x;
+		ring[ring_head][1] = mpu6000_raw_sensor_readings.gyro_y;
+		ring[ring_head][2] = mpu6000_raw_sensor_readings.gyro_z;
+		ring_head = next;
+		gyrocapture.samples++;
+	}
+
+	// back to the build's normal loop clock
+#ifdef ENABLE_QUADROCOPTER
+	mpu6000_enable_data_ready_int(3);    // 250Hz
+#else
+	mpu6000_enable_data_ready_int(19);   // 50Hz
+#endif
+	state = CAPTURE_DRAINING;
+}
+
+#else    // no data-ready line: cannot pace 1kHz, the capture degrades to a no-op
+
+void gyrocapture_sample(int heartbeat_id)
+{
+	state = CAPTURE_DRAINING;
+}
+
+#endif   // MPU6000_USE_INT
+
+
+int gyrocapture_read_sample(int *xyz)
+{
+	int next;
+
+	if (ring_tail == ring_head)
+		return 0;
+	xyz[0] = ring[ring_tail][0];
+	xyz[1] = ring[ring_tail][1];
+	xyz[2] = ring[ring_tail][2];
+	next = ring_tail + 1;
+	if (next >= CAPTURE_RING_SAMPLES)
+		next = 0;
+	ring_tail = next;
+	return 1;
+}
+
+
+int gyrocapture_drained()
+{
+	return state == CAPTURE_DRAINING && ring_tail == ring_head;
+}
+
+
+void gyrocapture_complete()
+{
+	state = CAPTURE_IDLE;
+}
@@ -0,0 +1,70 @@
+/*!
+ *  On-demand raw 1kHz gyro capture to dataflash.
+ *
+ *  Filter design (notch center, lowpass corners) needs raw full-rate gyro
+ *  data, and neither the telemetry link nor the 50Hz log mode can carry
+ *  it. Started with the CR;seconds console command, the sensor task owns
+ *  the MPU6000 for the duration of the capture: the sample divider drops
+ *  to 1kHz, every data-ready sample goes straight into a small ring
+ *  (bypassing the AHRS, which freezes for those seconds - bench use
+ *  only), and the datalogger task drains the ring into raw pages in the
+ *  normal log stream. Capture pages carry their own flag in the page
+ *  index word, so the LogLine readout skips them; they are fetched with
+ *  the raw bulk-read protocol (DB command / GluonCS raw download) and
+ *  analyzed offline. The completion line on the console names the page
+ *  range to download.
+ *
+ *  @file     gyrocapture.h
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#ifndef GYROCAPTURE_H
+#define GYROCAPTURE_H
+
+//! Bounds for the CR;seconds argument. 10s = 10000 samples = some 120
+//! pages on the smallest chip, well under one lap of the log region.
+#define GYROCAPTURE_MAX_SECONDS 10
+
+//! Capture sample rate; also the MPU6000 internal sample clock.
+#define GYROCAPTURE_RATE_HZ 1000
+
+//! Progress counters, reported on the completion line.
+struct GyroCapture
+{
+	unsigned long samples;    //!< samples pushed into the ring
+	unsigned long drops;      //!< samples lost to a full ring (flash stalled)
+	unsigned long timeouts;   //!< missed data-ready edges
+};
+
+extern struct GyroCapture gyrocapture;
+
+//! Arms a capture of the given length (CR console command); clamped to
+//! 1..GYROCAPTURE_MAX_SECONDS, ignored while one is still running.
+void gyrocapture_start(int seconds);
+
+//! 1 when a capture is armed; the sensor task polls this at its loop top.
+int gyrocapture_sampling_due();
+
+//! Runs the whole capture from the sensor task: reconfigures the sample
+//! divider, samples until done, restores the divider. The task's
+//! heartbeat id keeps the watchdog fed while the loop owns the task.
+void gyrocapture_sample(int heartbeat_id);
+
+//! 1 from the moment a capture is armed until its last page is flushed;
+//! the datalogger task drains faster while this holds.
+int gyrocapture_active();
+
+//! Pops one sample (3 raw gyro ints) for the page builder in
+//! task_datalogger.c; returns 0 when the ring is empty.
+int gyrocapture_read_sample(int *xyz);
+
+//! 1 once sampling ended and the ring is empty: time to flush the
+//! partial page and call gyrocapture_complete().
+int gyrocapture_drained();
+
+//! Datalogger side: the last page went out; back to idle.
+void gyrocapture_complete();
+
+#endif // GYROCAPTURE_H
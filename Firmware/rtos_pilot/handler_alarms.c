@@ -5,43 +5,170 @@
 #include "sensors.h"
 #include "gluonscript.h"
 #include "task_osd.h"
+#include "uart1_queue/uart1_queue.h"
 
 
 struct BatteryAlarm battery_alarm = { .panic_v = 0.0, .warning_v = 0.0, .panic_line = -1, .alarm_battery_panic = 0, .alarm_battery_warning = 0};
 
 
-ScriptHandlerReturn alarms_handle_gluonscriptcommand (struct GluonscriptCode *code)
+/*
+ *   The alarms used to redo every comparison (and the float threshold
+ *   conversions) on every script tick. Each monitored value is now a
+ *   threshold-crossing subscription: the tick compares the field against
+ *   the copy it evaluated last time and the real threshold test only runs
+ *   when the field actually changed - the battery fields update at 2Hz
+ *   while the script ticks at GLUONSCRIPT_HZ, so most ticks cost one
+ *   compare per watch. A crossing fires once and the watch re-arms only
+ *   after the value has moved back through a hysteresis band, so a
+ *   voltage sagging onto the threshold under throttle cannot fire on
+ *   every update.
+ */
+
+#define MAX_ALARM_WATCHES 6
+
+struct AlarmWatch
+{
+	unsigned int *field;           //!< monitored sensor_data field
+	unsigned int last_value;       //!< last evaluated copy; unchanged = one compare and out
+	unsigned int threshold;        //!< crossing level, in the field's own unit
+	unsigned int rearm_margin;     //!< re-arms this far back across the threshold
+	unsigned int below : 1;        //!< 1 = fire when the field drops below the threshold
+	unsigned int armed : 1;        //!< 1 while the next crossing may fire
+	void (*fire)();                //!< crossing action; runs in script-tick context
+};
+
+static struct AlarmWatch watch[MAX_ALARM_WATCHES];
+static int watch_count = 0;
+
+//! Set by the battery panic action so alarms_periodic() can report the
+//! codeline jump to the script engine.
+static int panic_jumped = 0;
+
+
+int alarms_subscribe(unsigned int *field, unsigned int threshold,
+                     unsigned int rearm_margin, int below, void (*fire)())
+{
+	struct AlarmWatch *w;
+
+	if (watch_count >= MAX_ALARM_WATCHES)
+		return -1;
+
+	w = &watch[watch_count];
+	w->field = field;
+	w->last_value = *field + 1;   // differs from the field: evaluated on the next tick
+	w->threshold = threshold;
+	w->rearm_margin = rearm_margin;
+	w->below = below ? 1 : 0;
+	w->armed = 1;
+	w->fire = fire;
+
+	return watch_count++;
+}
+
+
+void alarms_retune(int watch_index, unsigned int threshold)
+{
+	if (watch_index < 0 || watch_index >= watch_count)
+		return;
+
+	watch[watch_index].threshold = threshold;
+	watch[watch_index].armed = 1;
+	watch[watch_index].last_value = *(watch[watch_index].field) + 1;
+}
+
+
+static void alarms_battery_warning_fire()
 {
+	battery_alarm.alarm_battery_warning = 1;   // the telemetry task prints and clears this
+	osd_post_message("Battery warning", 1);
+}
 
-	// Alarms, check every 10 seconds
-	if (gluonscript_data.tick % (GLUONSCRIPT_HZ*10) == 0) // check for alarms every 10 seconds
+
+static void alarms_battery_panic_fire()
+{
+	battery_alarm.alarm_battery_panic++;
+	if (battery_alarm.panic_line >= 0 && battery_alarm.alarm_battery_panic == 1)  // only do this one time
 	{
-		if ((int)sensor_data.battery1_voltage_10 < (int)(battery_alarm.panic_v*10.0))
+		uart1_printf("\r\nAlarm: new block selected\r\n");
+		gluonscript_data.current_codeline = battery_alarm.panic_line;
+		osd_post_message("Battery panic", 1);
+		panic_jumped = 1;
+	}
+}
+
+
+/*!
+ *    Opcode independent part, runs once per gluonscript tick: evaluates
+ *    the watches whose field changed since the last tick.
+ */
+ScriptHandlerReturn alarms_periodic ()
+{
+	unsigned int value;
+	struct AlarmWatch *w;
+	int i;
+
+	panic_jumped = 0;
+	for (i = 0; i < watch_count; i++)
+	{
+		w = &watch[i];
+		value = *(w->field);
+		if (value == w->last_value)
+			continue;   // no update on this field: nothing to evaluate
+		w->last_value = value;
+
+		if (w->below)
+		{
+			if (w->armed && value < w->threshold)
+			{
+				w->armed = 0;
+				w->fire();
+			}
+			else if (! w->armed && value >= w->threshold + w->rearm_margin)
+				w->armed = 1;
+		}
+		else
 		{
-			//printf("%d < %d\r\n", sensor_data.battery_voltage_10, (int)(battery_alarm.panic_v*10.0));
-			battery_alarm.alarm_battery_panic++;
-			if (battery_alarm.panic_line >= 0 && battery_alarm.alarm_battery_panic == 1)  // only do this one time
+			if (w->armed && value > w->threshold)
 			{
-                printf("\r\nAlarm: new block selected\r\n");
-				gluonscript_data.current_codeline = battery_alarm.panic_line;
-				//printf ("Goto %d\r\n", gluonscript_data.current_codeline);
-                osd_post_message("Battery panic", 1);
-				return HANDLED_UNFINISHED;
-			}	
+				w->armed = 0;
+				w->fire();
+			}
+			else if (! w->armed && value + w->rearm_margin <= w->threshold)
+				w->armed = 1;
 		}
-		else if (sensor_data.battery1_voltage_10 < (int)(battery_alarm.warning_v*10.0))
-        {
-			battery_alarm.alarm_battery_warning++;
-            osd_post_message("Battery warning", 1);
-        }
 	}
-	
-	// handle command
+
+	return panic_jumped ? HANDLED_UNFINISHED : NOT_HANDLED;
+}
+
+
+ScriptHandlerReturn alarms_handle_gluonscriptcommand (struct GluonscriptCode *code)
+{
 	if (code->opcode == SET_BATTERY_ALARM)
 	{
+		static int warning_watch = -1;
+		static int panic_watch = -1;
+
 		battery_alarm.panic_v = code->y;
 		battery_alarm.warning_v = code->x;
 		battery_alarm.panic_line = code->a;
+
+		// 0.2V of hysteresis: the sag under full throttle crosses the
+		// threshold, the recovery at idle re-arms the watch
+		if (warning_watch == -1)
+			warning_watch = alarms_subscribe(&sensor_data.battery1_voltage_10,
+			                (unsigned int)(battery_alarm.warning_v*10.0), 2, 1,
+			                &alarms_battery_warning_fire);
+		else
+			alarms_retune(warning_watch, (unsigned int)(battery_alarm.warning_v*10.0));
+
+		if (panic_watch == -1)
+			panic_watch = alarms_subscribe(&sensor_data.battery1_voltage_10,
+			              (unsigned int)(battery_alarm.panic_v*10.0), 2, 1,
+			              &alarms_battery_panic_fire);
+		else
+			alarms_retune(panic_watch, (unsigned int)(battery_alarm.panic_v*10.0));
+
 		return HANDLED_FINISHED;
 	}	
 	return NOT_HANDLED;
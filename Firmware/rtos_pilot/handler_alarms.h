@@ -7,13 +7,26 @@ struct BatteryAlarm {
 	float panic_v;
 	float warning_v;
 	int panic_line;
-	
+
 	int alarm_battery_panic;
 	int alarm_battery_warning;
 };
 
 extern struct BatteryAlarm battery_alarm;
 
+//! Registers a threshold-crossing subscription on a sensor field: fire()
+//! runs once when the field crosses the threshold (below = 1: drops under
+//! it), then the watch re-arms only after the field has moved rearm_margin
+//! back across it (hysteresis). The field is only evaluated on ticks where
+//! its value actually changed. Returns the watch index, or -1 when full.
+int alarms_subscribe(unsigned int *field, unsigned int threshold,
+                     unsigned int rearm_margin, int below, void (*fire)());
+
+//! Moves an existing watch to a new threshold, re-arms it and forces a
+//! re-evaluation on the next tick.
+void alarms_retune(int watch_index, unsigned int threshold);
+
+ScriptHandlerReturn alarms_periodic ();
 ScriptHandlerReturn alarms_handle_gluonscriptcommand (struct GluonscriptCode *code);
 
 
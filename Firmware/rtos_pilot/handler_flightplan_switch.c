@@ -2,13 +2,18 @@
 #include "ppm_in/ppm_in.h"
 #include "gluonscript.h"
 #include "handler_flightplan_switch.h"
+#include "uart1_queue/uart1_queue.h"
 
 struct flightplan_switch flightplan_switch = { .active = 0, .current_state = -1 };
 
 static int last_switch_state = -1;
 static int i = 0;
 
-ScriptHandlerReturn flightplan_switch_handle_gluonscriptcommand (struct GluonscriptCode *code)
+/*!
+ *    Opcode independent part, runs once per gluonscript tick: polls the
+ *    RC channel and jumps to another block when the switch changed.
+ */
+ScriptHandlerReturn flightplan_switch_periodic ()
 {
     enum FlightplanStates this_state;
 
@@ -30,8 +35,8 @@ ScriptHandlerReturn flightplan_switch_handle_gluonscriptcommand (struct Gluonscr
 
         if (this_state != flightplan_switch.current_state && this_state == last_switch_state)
         {
-            //printf("\r\nVal %d -> State %d->%d -> Line %d \r\n", channel_value, flightplan_switch.current_state, this_state, gluonscript_data.current_codeline+2); // not + 1 -> ++ follows after HANDLED_FINISHED
-            printf("\r\nFlightplan switch: new block selected\r\n");
+            //uart1_printf("\r\nVal %d -> State %d->%d -> Line %d \r\n", channel_value, flightplan_switch.current_state, this_state, gluonscript_data.current_codeline+2); // not + 1 -> ++ follows after HANDLED_FINISHED
+            uart1_printf("\r\nFlightplan switch: new block selected\r\n");
             gluonscript_data.current_codeline = flightplan_switch.target[this_state] - 1;  // is incremented on HANDLED_FINISHED
             flightplan_switch.current_state = this_state;
             last_switch_state = this_state;
@@ -42,7 +47,12 @@ ScriptHandlerReturn flightplan_switch_handle_gluonscriptcommand (struct Gluonscr
             last_switch_state = this_state;
         }
     }
+    return NOT_HANDLED;
+}
 
+
+ScriptHandlerReturn flightplan_switch_handle_gluonscriptcommand (struct GluonscriptCode *code)
+{
     if (code->opcode == SET_FLIGHTPLAN_SWITCH)
     {
         flightplan_switch.active = 1;
@@ -15,6 +15,7 @@ struct flightplan_switch
     enum FlightplanStates current_state;
 };
 
+ScriptHandlerReturn flightplan_switch_periodic ();
 ScriptHandlerReturn flightplan_switch_handle_gluonscriptcommand (struct GluonscriptCode *code);
 
 #endif // HANDLER_FLIGHTPLAN_SWITCH_H
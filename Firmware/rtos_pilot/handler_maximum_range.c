@@ -4,12 +4,115 @@
 #include "handler_maximum_range.h"
 #include "handler_navigation.h"
 #include "sensors.h"
+#include "uart1_queue/uart1_queue.h"
 
 struct maximum_range maximum_range = { .active = 0 };
+struct geofence geofence = { .active = 0 };
 
 static int i = 0;
 
-ScriptHandlerReturn maximum_range_handle_gluonscriptcommand (struct GluonscriptCode *code)
+// Uploaded fence vertices, kept in radians until FG compiles them.
+static float fence_lat_rad[GEOFENCE_MAX_POINTS];
+static float fence_lon_rad[GEOFENCE_MAX_POINTS];
+
+// Compiled edge tables: vertex coordinates in whole meters relative to
+// vertex 0 (x = north, y = east) and the inverse slope of every edge in
+// Q8 fixed point, so the crossing test below needs no division. Edge i
+// runs from vertex i to vertex i+1 (wrapping).
+static int fence_x[GEOFENCE_MAX_POINTS];
+static int fence_y[GEOFENCE_MAX_POINTS];
+static long fence_slope_q8[GEOFENCE_MAX_POINTS];
+static int fence_min_x, fence_max_x, fence_min_y, fence_max_y;
+static double fence_origin_lat_rad, fence_origin_lon_rad;
+static int fence_holdoff = 0;
+
+
+void geofence_set_point (int index, float latitude_rad, float longitude_rad)
+{
+    if (index < 0 || index >= GEOFENCE_MAX_POINTS)
+        return;
+    fence_lat_rad[index] = latitude_rad;
+    fence_lon_rad[index] = longitude_rad;
+}
+
+
+int geofence_compile (int point_count, int target)
+{
+    int i;
+
+    if (point_count == 0)
+    {
+        geofence.active = 0;
+        return 0;
+    }
+    if (point_count < 3 || point_count > GEOFENCE_MAX_POINTS)
+        return -1;
+
+    geofence.active = 0;   // don't let the periodic test see a half-built table
+
+    fence_origin_lat_rad = fence_lat_rad[0];
+    fence_origin_lon_rad = fence_lon_rad[0];
+    fence_min_x = fence_max_x = 0;
+    fence_min_y = fence_max_y = 0;
+    for (i = 0; i < point_count; i++)
+    {
+        fence_x[i] = (int)((fence_lat_rad[i] - fence_origin_lat_rad) * latitude_meter_per_radian);
+        fence_y[i] = (int)((fence_lon_rad[i] - fence_origin_lon_rad) * longitude_meter_per_radian);
+        if (fence_x[i] < fence_min_x) fence_min_x = fence_x[i];
+        if (fence_x[i] > fence_max_x) fence_max_x = fence_x[i];
+        if (fence_y[i] < fence_min_y) fence_min_y = fence_y[i];
+        if (fence_y[i] > fence_max_y) fence_max_y = fence_y[i];
+    }
+    for (i = 0; i < point_count; i++)
+    {
+        int j = (i + 1 == point_count) ? 0 : i + 1;
+        int dy = fence_y[j] - fence_y[i];
+        if (dy == 0)
+            fence_slope_q8[i] = 0;   // horizontal edges never pass the straddle test
+        else
+            fence_slope_q8[i] = ((long)(fence_x[j] - fence_x[i]) << 8) / dy;
+    }
+
+    geofence.point_count = point_count;
+    geofence.target = target;
+    geofence.active = 1;
+    fence_holdoff = 0;
+    return 0;
+}
+
+
+/*!
+ *    Even/odd crossing test against the compiled edge tables. Per edge
+ *    this is 2 compares, and one 16x16 multiply only for edges that
+ *    actually straddle the craft's y; a 32-edge fence stays well inside
+ *    the gluonscript tick budget. The multiply cannot overflow: on a
+ *    straddling edge |py - fence_y[i]| <= |dy|, so the product is
+ *    bounded by |dx| << 8.
+ */
+static int geofence_inside (int px, int py)
+{
+    int i;
+    int inside = 0;
+
+    for (i = 0; i < geofence.point_count; i++)
+    {
+        int j = (i + 1 == geofence.point_count) ? 0 : i + 1;
+        if ((fence_y[i] > py) != (fence_y[j] > py))
+        {
+            int xcross = fence_x[i] + (int)(((long)(py - fence_y[i]) * fence_slope_q8[i]) >> 8);
+            if (px < xcross)
+                inside = !inside;
+        }
+    }
+    return inside;
+}
+
+
+/*!
+ *    Opcode independent part, runs once per gluonscript tick: jump to the
+ *    configured block when the plane gets too far from home.
+ */
+ScriptHandlerReturn maximum_range_periodic ()
 {
     if (maximum_range.active)
     {
@@ -22,7 +125,7 @@ ScriptHandlerReturn maximum_range_handle_gluonscriptcommand (struct GluonscriptC
             if (navigation_distance_between_meter(sensor_data.gps.longitude_rad, navigation_data.home_longitude_rad,
                                                   sensor_data.gps.latitude_rad, navigation_data.home_latitude_rad) > maximum_range.maximum_range)
             {
-                printf("\r\nMax range: new block selected\r\n");
+                uart1_printf("\r\nMax range: new block selected\r\n");
                 gluonscript_data.current_codeline = maximum_range.target - 1;  // is incremented on HANDLED_FINISHED
                 i = -GLUONSCRIPT_HZ*10;    // disable this for 10 seconds
                 return HANDLED_FINISHED;
@@ -30,6 +133,38 @@ ScriptHandlerReturn maximum_range_handle_gluonscriptcommand (struct GluonscriptC
         }
     }
 
+    if (geofence.active && navigation_data.airborne)   // gps position is meaningless before launch
+    {
+        if (fence_holdoff > 0)
+            fence_holdoff--;
+        else
+        {
+            // One radians->meters conversion per tick; everything after is integer.
+            long px = (long)((sensor_data.gps.latitude_rad - fence_origin_lat_rad) * latitude_meter_per_radian);
+            long py = (long)((sensor_data.gps.longitude_rad - fence_origin_lon_rad) * longitude_meter_per_radian);
+            int outside;
+
+            if (px < fence_min_x || px > fence_max_x || py < fence_min_y || py > fence_max_y)
+                outside = 1;   // cheap bounding box reject
+            else
+                outside = ! geofence_inside((int)px, (int)py);
+
+            if (outside)
+            {
+                uart1_printf("\r\nGeofence: new block selected\r\n");
+                gluonscript_data.current_codeline = geofence.target - 1;  // is incremented on HANDLED_FINISHED
+                fence_holdoff = GLUONSCRIPT_HZ*10;    // disable this for 10 seconds
+                return HANDLED_FINISHED;
+            }
+        }
+    }
+
+    return NOT_HANDLED;
+}
+
+
+ScriptHandlerReturn maximum_range_handle_gluonscriptcommand (struct GluonscriptCode *code)
+{
     if (code->opcode == SET_MAXIMUM_RANGE)
     {
         maximum_range.active = 1;
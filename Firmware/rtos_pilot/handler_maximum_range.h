@@ -10,6 +10,30 @@ struct maximum_range
     int target;
 };
 
+//! Polygon geofence. Vertices are uploaded over the console (WF) in
+//! radians and compiled (FG) into integer edge tables in meters relative
+//! to the first vertex, so the per-tick inside test is a handful of
+//! 16-bit compares per edge and never touches the float trigonometry.
+#define GEOFENCE_MAX_POINTS 32
+
+struct geofence
+{
+    int active;
+    int point_count;
+    int target;     //!< codeline to jump to when the fence is breached
+};
+
+extern struct geofence geofence;
+
+//! Stores one fence vertex (0-based) for the next geofence_compile.
+void geofence_set_point (int index, float latitude_rad, float longitude_rad);
+
+//! Compiles the first point_count uploaded vertices into the edge tables
+//! and arms the fence; breaching it jumps to the target codeline. A
+//! point_count of 0 disarms. Returns 0 on success, -1 on a bad count.
+int geofence_compile (int point_count, int target);
+
+ScriptHandlerReturn maximum_range_periodic ();
 ScriptHandlerReturn maximum_range_handle_gluonscriptcommand (struct GluonscriptCode *code);
 
 #endif // HANDLER_MAXIMUM_RANGE_H
@@ -28,11 +28,15 @@
 #include "handler_trigger.h"
 #include "handler_alarms.h"
 #include "gluonscript.h"
+#include "uart1_queue/uart1_queue.h"
 
 
 volatile struct NavigationData navigation_data;
 
 float cos_latitude;
+//! cos(latitude) in Q14 for the integer math; default matches the 50N
+//! assumption of longitude_meter_per_radian below (0.6428 * 16384).
+long cos_latitude_q14 = 10531;
 //! Convert latitude coordinates from radians into meters.
 float latitude_meter_per_radian = 6363057.32484;
 
@@ -59,6 +63,8 @@ void navigation_init ()
 	navigation_data.home_pressure_height = sensor_data.pressure_height;  // as opposed to GPS height!!
 
 	navigation_data.desired_heading_rad = 0.0;
+	navigation_data.dr_latitude_rad = 0.0;
+	navigation_data.dr_longitude_rad = 0.0;
 	//navigation_data.distance_next_waypoint = 0.0;
 	
 	navigation_data.airborne = 0;
@@ -66,6 +72,10 @@ void navigation_init ()
 	navigation_data.time_airborne_s = 0;
 	navigation_data.time_block_s = 0;
 	navigation_data.wind_heading_set = 0;
+	navigation_data.wind_north_ms = 0.0f;
+	navigation_data.wind_east_ms = 0.0f;
+	navigation_data.wind_speed_ms = 0.0f;
+	navigation_data.wind_valid = 0;
 	navigation_data.relative_positions_calculated = 0;
 	navigation_data.desired_throttle_pct = -1;
 }
@@ -115,6 +125,59 @@ void navigation_calculate_relative_positions()
 		navigation_calculate_relative_position(i);
 	}
 	navigation_data.relative_positions_calculated = 1;
+
+	navigation_calculate_leg_cache();
+}
+
+
+//! Memory allocation for the per-codeline leg geometry.
+struct NavigationLegCache navigation_leg_cache[MAX_GLUONSCRIPTCODES];
+
+/*!
+ *    Walks the gluonscript and precomputes the leg geometry for every
+ *    FROM/TO line, so the navigation tick only needs table lookups. The
+ *    "from" position is the waypoint of the last preceding line that
+ *    moves the plane (home for the first one); when the script jumps in
+ *    from somewhere else, last_waypoint won't match the cached start and
+ *    navigation_handle_gluonscriptcommand() falls back to computing the
+ *    leg on the fly.
+ */
+void navigation_calculate_leg_cache()
+{
+	int i;
+	float prev_lat = navigation_data.home_latitude_rad;
+	float prev_lon = navigation_data.home_longitude_rad;
+
+	for (i = 0; i < MAX_GLUONSCRIPTCODES; i++)
+	{
+		struct GluonscriptCode *code = (struct GluonscriptCode*) &gluonscript_data.codes[i];
+		navigation_leg_cache[i].valid = 0;
+
+		switch (code->opcode)
+		{
+			case FROM_TO_ABS:
+			case FLARE_TO_ABS:
+			case GLIDE_TO_ABS:
+			{
+				struct NavigationLegCache *leg = &navigation_leg_cache[i];
+				leg->from_latitude_rad = prev_lat;
+				leg->from_longitude_rad = prev_lon;
+				leg->leg_x = (code->x - prev_lat) * latitude_meter_per_radian;
+				leg->leg_y = (code->y - prev_lon) * longitude_meter_per_radian;
+				leg->leg2 = MAX(leg->leg_x*leg->leg_x + leg->leg_y*leg->leg_y, 1.f);
+				leg->length = sqrtf(leg->leg2);
+				leg->valid = 1;
+			}	// fall through: this line also moves the plane
+			case FLY_TO_ABS:
+			case CIRCLE_ABS:
+			case CIRCLE_TO_ABS:
+				prev_lat = code->x;
+				prev_lon = code->y;
+				break;
+			default:   // REL lines not converted yet, conditions, ...
+				break;
+		}
+	}
 }
 
 
@@ -128,9 +191,174 @@ void convert_parameters_to_abs(int i)
 
 
 
-//void navigation_update()
-ScriptHandlerReturn navigation_handle_gluonscriptcommand (struct GluonscriptCode *current_code)
+/*!
+ *    Leg geometry towards current_code: from the cache when its start
+ *    matches the runtime from-waypoint (the common case of a sequential
+ *    plan), computed on the fly otherwise (jumps, loiter, ...).
+ */
+static void navigation_get_leg(struct GluonscriptCode *current_code, float *leg_x, float *leg_y, float *leg2, float *length)
+{
+	struct NavigationLegCache *leg = &navigation_leg_cache[gluonscript_data.current_codeline];
+
+	if (leg->valid &&
+	    leg->from_latitude_rad == navigation_data.last_waypoint_latitude_rad &&
+	    leg->from_longitude_rad == navigation_data.last_waypoint_longitude_rad)
+	{
+		*leg_x = leg->leg_x;
+		*leg_y = leg->leg_y;
+		*leg2 = leg->leg2;
+		*length = leg->length;
+		return;
+	}
+
+	*leg_x = (current_code->x - navigation_data.last_waypoint_latitude_rad) * latitude_meter_per_radian;  // lat
+	*leg_y = (current_code->y - navigation_data.last_waypoint_longitude_rad) * longitude_meter_per_radian;  // lon
+	*leg2 = MAX((*leg_x) * (*leg_x) + (*leg_y) * (*leg_y), 1.f);
+	*length = sqrtf(*leg2);
+}
+
+
+/*!
+ *    Desired heading for tracking the leg towards current_code from the
+ *    given position: project the position on the leg and aim for the
+ *    carrot laying ahead of the projection. Read-only on the gluonscript
+ *    state, so it is shared by navigation_handle_gluonscriptcommand()
+ *    and the 50Hz dead-reckoning update.
+ */
+static void navigation_track_leg(struct GluonscriptCode *current_code, double latitude_rad, double longitude_rad)
+{
+	float leg_x, leg_y, leg2, nav_leg_length;
+	navigation_get_leg(current_code, &leg_x, &leg_y, &leg2, &nav_leg_length);
+	float dx = (latitude_rad - navigation_data.last_waypoint_latitude_rad) * latitude_meter_per_radian;
+	float dy = (longitude_rad - navigation_data.last_waypoint_longitude_rad) * longitude_meter_per_radian;
+	float nav_leg_progress = (dx * leg_x + dy * leg_y) / leg2;
+
+	// signed perpendicular distance to the leg: the 50Hz dead-reckon calls
+	// keep it moving between fixes, every fresh fix re-anchors it. Published
+	// to the control task with the next sensor snapshot.
+	sensor_data.cross_track_m = (leg_x * dy - leg_y * dx) / nav_leg_length;
+
+	  /** distance of carrot (in meter) */
+	float carrot = 4.0f * sensor_data.gps.speed_ms;
+
+	if (nav_leg_progress >= 1.0f) // did we pass (miss) the waypoint?
+	{
+		navigation_data.desired_heading_rad = navigation_heading_rad_fromto((float)(longitude_rad - (double)current_code->y),
+	                                                                        (float)(latitude_rad - (double)current_code->x));
+	}
+	else
+	{
+		float aim_cross_m = 0.0f;
+
+		nav_leg_progress += MAX(carrot / nav_leg_length, 0.f); // fly towards carrot
+
+		// Wind feedforward: over the ~4s it takes to reach the carrot, the
+		// wind displaces us by its cross-leg component times that time. Aim
+		// that far upwind of the carrot, so we converge on the line in one
+		// move instead of chasing the drift through the heading pid.
+		if (navigation_data.wind_valid && sensor_data.gps.speed_ms > 3.0f)
+		{
+			float wind_cross = (leg_x * navigation_data.wind_east_ms -
+			                    leg_y * navigation_data.wind_north_ms) / nav_leg_length;
+			aim_cross_m = -wind_cross * (carrot / sensor_data.gps.speed_ms);
+		}
+
+		navigation_data.desired_heading_rad = navigation_heading_rad_fromto(
+			(float)(longitude_rad - (double)( navigation_data.last_waypoint_longitude_rad + (nav_leg_progress * leg_y + aim_cross_m * leg_x / nav_leg_length) / longitude_meter_per_radian)),
+            (float)(latitude_rad - (double)( navigation_data.last_waypoint_latitude_rad + (nav_leg_progress * leg_x - aim_cross_m * leg_y / nav_leg_length) / latitude_meter_per_radian ) ) );
+	}
+}
+
+
+/*!
+ *    Advances the last GPS position along the last fix's velocity vector
+ *    and re-aims the carrot for the leg being tracked. Called at 50Hz
+ *    from the control task, so the cross-track correction keeps moving
+ *    between two GPS fixes instead of updating in fix-rate steps.
+ *    Waypoint switching stays in navigation_handle_gluonscriptcommand();
+ *    this only refreshes desired_heading_rad.
+ */
+void navigation_dead_reckon (float dt)
+{
+	static int last_sentence_number = -1;
+	static float v_north = 0.0f, v_east = 0.0f;   // m/s
+
+	if (sensor_data.gps.status != ACTIVE || !navigation_data.airborne)
+		return;
+
+	if (sensor_data.gps.sentence_number_last_fix != last_sentence_number)
+	{
+		// fresh fix: restart the prediction from it
+		last_sentence_number = sensor_data.gps.sentence_number_last_fix;
+		navigation_data.dr_latitude_rad = sensor_data.gps.latitude_rad;
+		navigation_data.dr_longitude_rad = sensor_data.gps.longitude_rad;
+		v_north = cosf(sensor_data.gps.heading_rad) * sensor_data.gps.speed_ms;
+		v_east = sinf(sensor_data.gps.heading_rad) * sensor_data.gps.speed_ms;
+		return;   // the gluonscript tick already aimed on this fix
+	}
+
+	navigation_data.dr_latitude_rad += (double)(v_north * dt) / latitude_meter_per_radian;
+	navigation_data.dr_longitude_rad += (double)(v_east * dt) / longitude_meter_per_radian;
+
+	struct GluonscriptCode *current_code = (struct GluonscriptCode*) &gluonscript_data.codes[gluonscript_data.current_codeline];
+	if (current_code->opcode == FROM_TO_ABS)
+		navigation_track_leg(current_code, navigation_data.dr_latitude_rad, navigation_data.dr_longitude_rad);
+}
+
+
+/*
+ *   In-flight wind estimate: the gps ground vector minus the air vector
+ *   (attitude yaw at the configured cruising speed - there is no airspeed
+ *   sensor) leaves the wind. A small recursive gain averages it, so the
+ *   estimate converges in tens of seconds and still follows slow changes.
+ *   On a single heading the along-track component absorbs any airspeed
+ *   error; a mapping pattern visits reciprocal headings, which cancels it.
+ */
+#define WIND_GAIN        0.01f   // per gluonscript tick: time constant ~10s
+#define WIND_VALID_TICKS 300     // no feedforward before ~30s of data
+
+static void navigation_wind_update()
+{
+	static unsigned int samples = 0;
+	float wind_north, wind_east;
+
+	if (!navigation_data.airborne || sensor_data.gps.status != ACTIVE ||
+	    sensor_data.gps.satellites_in_view < 5 || sensor_data.gps.speed_ms < 3.0f)
+		return;
+
+	wind_north = cosf(sensor_data.gps.heading_rad) * sensor_data.gps.speed_ms -
+	             cosf(sensor_data.yaw) * config.control.cruising_speed_ms;
+	wind_east  = sinf(sensor_data.gps.heading_rad) * sensor_data.gps.speed_ms -
+	             sinf(sensor_data.yaw) * config.control.cruising_speed_ms;
+
+	navigation_data.wind_north_ms += WIND_GAIN * (wind_north - navigation_data.wind_north_ms);
+	navigation_data.wind_east_ms  += WIND_GAIN * (wind_east - navigation_data.wind_east_ms);
+	navigation_data.wind_speed_ms = sqrtf(navigation_data.wind_north_ms * navigation_data.wind_north_ms +
+	                                      navigation_data.wind_east_ms * navigation_data.wind_east_ms);
+
+	if (samples < WIND_VALID_TICKS)
+		samples++;
+	else
+	{
+		navigation_data.wind_valid = 1;
+		// keep the "wind comes from" heading live for the CLIMB opcode,
+		// which used to freeze it at the take-off ground track
+		if (navigation_data.wind_speed_ms > 2.0f)
+			navigation_data.wind_heading = atan2f(-navigation_data.wind_east_ms,
+			                                      -navigation_data.wind_north_ms);
+	}
+}
+
+
+/*!
+ *    Opcode independent part, runs once per gluonscript tick: time
+ *    keeping, home position, the initial wind heading and the wind
+ *    estimate.
+ */
+ScriptHandlerReturn navigation_periodic ()
 {
+	navigation_wind_update();
+
 	// keep our "time" up to date
 	if (gluonscript_data.tick % GLUONSCRIPT_HZ == 0)
 	{
@@ -157,7 +385,7 @@ ScriptHandlerReturn navigation_handle_gluonscriptcommand (struct GluonscriptCode
 			if (sensor_data.gps.status != ACTIVE || sensor_data.gps.satellites_in_view < 5)
 			{
 				navigation_data.home_pressure_height = sensor_data.pressure_height;  // as opposed to GPS height!!
-				//printf("\r\nHome altitude set\r\n");
+				//uart1_printf("\r\nHome altitude set\r\n");
 			}
 			navigation_set_home(); // set temporary home, not airborne
 			
@@ -179,8 +407,13 @@ ScriptHandlerReturn navigation_handle_gluonscriptcommand (struct GluonscriptCode
 		// lock yaw
 		sensor_data.yaw = sensor_data.gps.heading_rad;
 	}
-	
-		
+	return NOT_HANDLED;
+}
+
+
+//void navigation_update()
+ScriptHandlerReturn navigation_handle_gluonscriptcommand (struct GluonscriptCode *current_code)
+{
 	switch(current_code->opcode)
 	{
 		case CLIMB:
@@ -202,33 +435,9 @@ ScriptHandlerReturn navigation_handle_gluonscriptcommand (struct GluonscriptCode
 		{
 			navigation_data.desired_pre_bank = 0.0f;
 			navigation_data.desired_throttle_pct = -1;
-			
-			float leg_x = (current_code->x - navigation_data.last_waypoint_latitude_rad) * latitude_meter_per_radian;  // lat
-  			float leg_y = (current_code->y - navigation_data.last_waypoint_longitude_rad) * longitude_meter_per_radian;  // lon
-  			float leg2 = MAX(leg_x * leg_x + leg_y * leg_y, 1.f);
-  			float nav_leg_progress = ((sensor_data.gps.latitude_rad - navigation_data.last_waypoint_latitude_rad) * latitude_meter_per_radian * leg_x + 
-  			                          (sensor_data.gps.longitude_rad - navigation_data.last_waypoint_longitude_rad) * longitude_meter_per_radian * leg_y) / leg2;
-  			float nav_leg_length = sqrtf(leg2);
 
-			  /** distance of carrot (in meter) */
-			float carrot = 4.0f * sensor_data.gps.speed_ms;
-			
-			//nav_leg_progress += MAX(carrot / nav_leg_length, 0.f);
-			
-			if (nav_leg_progress >= 1.0f) // did we pass (miss) the waypoint?
-			{
-				navigation_data.desired_heading_rad = navigation_heading_rad_fromto((float)(sensor_data.gps.longitude_rad - (double)current_code->y),
-		                                                                            (float)(sensor_data.gps.latitude_rad - (double)current_code->x));
-			}
-			else
-			{
-				nav_leg_progress += MAX(carrot / nav_leg_length, 0.f); // fly towards carrot
-				
-				navigation_data.desired_heading_rad = navigation_heading_rad_fromto(
-					(float)(sensor_data.gps.longitude_rad - (double)( navigation_data.last_waypoint_longitude_rad + nav_leg_progress * leg_y / longitude_meter_per_radian)),
-		            (float)(sensor_data.gps.latitude_rad - (double)( navigation_data.last_waypoint_latitude_rad + nav_leg_progress * leg_x / latitude_meter_per_radian ) ) );
-			}
-				                                                         
+			navigation_track_leg(current_code, sensor_data.gps.latitude_rad, sensor_data.gps.longitude_rad);
+
 	        navigation_data.desired_altitude_agl = current_code->a;
 			
 			if (waypoint_reached(current_code))
@@ -315,12 +524,10 @@ ScriptHandlerReturn navigation_handle_gluonscriptcommand (struct GluonscriptCode
 			
 			navigation_data.desired_throttle_pct = current_code->b;
 			
-			float leg_x = (current_code->x - navigation_data.last_waypoint_latitude_rad) * latitude_meter_per_radian;  // lat
-  			float leg_y = (current_code->y - navigation_data.last_waypoint_longitude_rad) * longitude_meter_per_radian;  // lon
-  			float leg2 = MAX(leg_x * leg_x + leg_y * leg_y, 1.f);
-  			float nav_leg_progress = ((sensor_data.gps.latitude_rad - navigation_data.last_waypoint_latitude_rad) * latitude_meter_per_radian * leg_x + 
+			float leg_x, leg_y, leg2, nav_leg_length;
+			navigation_get_leg(current_code, &leg_x, &leg_y, &leg2, &nav_leg_length);
+  			float nav_leg_progress = ((sensor_data.gps.latitude_rad - navigation_data.last_waypoint_latitude_rad) * latitude_meter_per_radian * leg_x +
   			                          (sensor_data.gps.longitude_rad - navigation_data.last_waypoint_longitude_rad) * longitude_meter_per_radian * leg_y) / leg2;
-  			float nav_leg_length = sqrtf(leg2);
 
 			  /** distance of carrot (in meter) */
 			float carrot = 4.0f * sensor_data.gps.speed_ms;
@@ -347,12 +554,10 @@ ScriptHandlerReturn navigation_handle_gluonscriptcommand (struct GluonscriptCode
 			
 			navigation_data.desired_throttle_pct = current_code->b;
 			
-			float leg_x = (current_code->x - navigation_data.last_waypoint_latitude_rad) * latitude_meter_per_radian;  // lat
-  			float leg_y = (current_code->y - navigation_data.last_waypoint_longitude_rad) * longitude_meter_per_radian;  // lon
-  			float leg2 = MAX(leg_x * leg_x + leg_y * leg_y, 1.f);
-  			float nav_leg_progress = ((sensor_data.gps.latitude_rad - navigation_data.last_waypoint_latitude_rad) * latitude_meter_per_radian * leg_x + 
+			float leg_x, leg_y, leg2, nav_leg_length;
+			navigation_get_leg(current_code, &leg_x, &leg_y, &leg2, &nav_leg_length);
+  			float nav_leg_progress = ((sensor_data.gps.latitude_rad - navigation_data.last_waypoint_latitude_rad) * latitude_meter_per_radian * leg_x +
   			                          (sensor_data.gps.longitude_rad - navigation_data.last_waypoint_longitude_rad) * longitude_meter_per_radian * leg_y) / leg2;
-  			float nav_leg_length = sqrtf(leg2);
 
 			  /** distance of carrot (in meter) */
 			float carrot = 4.0f * sensor_data.gps.speed_ms;
@@ -386,7 +591,7 @@ ScriptHandlerReturn navigation_handle_gluonscriptcommand (struct GluonscriptCode
             if (config.control.altitude_mode == GPS_ABSOLUTE)
                 navigation_data.desired_altitude_agl += navigation_data.home_gps_height;
 	        
-	        //printf("\r\n%d: %d %d (%d-%d | %d)\r\n", (int)(nav_leg_progress*100.f), (int)navigation_data.desired_altitude_agl, (int)altitude_agl, (int)(desired_pitch/3.14*180.0), (int)(control_state.desired_pitch/3.14*180.0), (int)(sensor_data.pitch/3.14*180.0));
+	        //uart1_printf("\r\n%d: %d %d (%d-%d | %d)\r\n", (int)(nav_leg_progress*100.f), (int)navigation_data.desired_altitude_agl, (int)altitude_agl, (int)(desired_pitch/3.14*180.0), (int)(control_state.desired_pitch/3.14*180.0), (int)(sensor_data.pitch/3.14*180.0));
 		    return HANDLED_UNFINISHED;
 		}
 		case SET_LOITER_POSITION:
@@ -458,53 +663,59 @@ int waypoint_reached(struct GluonscriptCode *current_code)
 
 void navigation_do_circle(struct GluonscriptCode *current_code)
 {
+	// sin/cos of the look-ahead angle only move when the gps speed does;
+	// cache them so the tick itself is free of library trig
+	static float rad_ahead_cached = 100.0f;   // forces a refresh on the first tick
+	static float cos_ahead = 1.0f;
+	static float sin_ahead = 0.0f;
+
 	float r = (float)current_code->a; // meter
 	float rad_s = sensor_data.gps.speed_ms / r;   // rad/s for this circle
 #define carrot 4.0
 	float distance_ahead = carrot * sensor_data.gps.speed_ms;
 	float abs_r = fabs(r);
 
-	// heading towards center of circle
-	float current_alpha = navigation_heading_rad_fromto(current_code->y - sensor_data.gps.longitude_rad,
-	                                                    current_code->x - sensor_data.gps.latitude_rad);  // 0� = top of circle
+	// aircraft relative to the circle center, in meter
+	float dx = (sensor_data.gps.latitude_rad - current_code->x) * latitude_meter_per_radian;
+	float dy = (sensor_data.gps.longitude_rad - current_code->y) * longitude_meter_per_radian;
+	float distance_center = sqrt(dx*dx + dy*dy);
 
-	float distance_center = 
-	 	navigation_distance_between_meter(sensor_data.gps.longitude_rad, current_code->y,
-	                                      sensor_data.gps.latitude_rad, current_code->x);
-	float next_alpha;
 	float rad_ahead = rad_s*carrot;
-	
+
 	if (rad_ahead > 0.0f)
 		rad_ahead = BIND(rad_ahead, DEG2RAD(10.0f), DEG2RAD(45.0f));   // because of /cos(rad_ahead)
 	else
 		rad_ahead = BIND(rad_ahead, DEG2RAD(-45.0f), DEG2RAD(-10.0f));   // because of /cos(rad_ahead)
-		
-		
-	//if (distance_center > abs_r + distance_ahead ||
-	//    distance_center < abs_r - distance_ahead)  // too far in or out of the circle?
-	//{
-	//	next_alpha = current_alpha + DEG2RAD(90.0); // fly to point where you would touch the circle
-	//}
-	//else
-	//{
-		/*if (rad_ahead > 3.14159/4.0)	
-			next_alpha = current_alpha + 3.14159/4.0; // go to the position one second ahead
-		if (rad_ahead < 3.14159/16.0)	
-			next_alpha = current_alpha + 3.14159/16.0; // go to the position one second ahead
-		else*/
-			next_alpha = current_alpha + rad_ahead; //atan(distance_ahead/r);   CHANGE
-	//}	
 
-	
+	if (fabs(rad_ahead - rad_ahead_cached) > 0.01f)  // ~0.6 degree
+	{
+		rad_ahead_cached = rad_ahead;
+		cos_ahead = cosf(rad_ahead);
+		sin_ahead = sinf(rad_ahead);
+	}
+
+	// unit vector from the center to the aircraft: exactly (cos, sin) of
+	// the old current_alpha (0 = top of circle, clockwise positive), but
+	// straight from the position - no atan2. And since it is re-derived
+	// from the position every tick it never needs renormalizing.
+	float inv_d = 1.0f / MAX(distance_center, 1.0f);
+	float cos_alpha = dx * inv_d;
+	float sin_alpha = dy * inv_d;
+
+	// rotate it rad_ahead along the circle to aim at the carrot point:
+	// four multiplies instead of the old sinf/cosf of the summed angle
+	float cos_next = cos_alpha * cos_ahead - sin_alpha * sin_ahead;
+	float sin_next = sin_alpha * cos_ahead + cos_alpha * sin_ahead;
+
 	navigation_data.desired_pre_bank = (distance_center > abs_r + distance_ahead*2.0 || 
 	                                   distance_center < abs_r - distance_ahead) ? 0 :
   				                          atan(sensor_data.gps.speed_ms*sensor_data.gps.speed_ms / (G*r));
 
-	float next_r = abs_r / cosf(rad_ahead); // CHANGE sqrt(r*r + distance_ahe^ ad*distance_ahead);
+	float next_r = abs_r / cos_ahead;
 			
 	// max desired_heading
-	float pointlon = current_code->y + sinf(next_alpha) * next_r / longitude_meter_per_radian;
-	float pointlat = current_code->x + cosf(next_alpha) * next_r / latitude_meter_per_radian;
+	float pointlon = current_code->y + sin_next * next_r / longitude_meter_per_radian;
+	float pointlat = current_code->x + cos_next * next_r / latitude_meter_per_radian;
 	
 	
 	navigation_data.desired_heading_rad = navigation_heading_rad_fromto(sensor_data.gps.longitude_rad - pointlon,
@@ -517,9 +728,9 @@ void navigation_do_circle(struct GluonscriptCode *current_code)
 		
 	navigation_data.desired_altitude_agl = current_code->b;
 	
-	/*printf("-> %f | %f", distance_center, current_alpha);
-	printf("(%f) %f\r\n", navigation_data.desired_pre_bank/3.14159*180.0, navigation_data.desired_heading_rad/3.14159*180.0);
-	printf("(%f, %f) @ %d\r\n", RAD2DEG(current_code->x), RAD2DEG(current_code->y), current_code->a);*/
+	/*uart1_printf("-> %f | %f", distance_center, cos_alpha);
+	uart1_printf("(%f) %f\r\n", navigation_data.desired_pre_bank/3.14159*180.0, navigation_data.desired_heading_rad/3.14159*180.0);
+	uart1_printf("(%f, %f) @ %d\r\n", RAD2DEG(current_code->x), RAD2DEG(current_code->y), current_code->a);*/
 }	
 
 
@@ -534,7 +745,11 @@ void navigation_set_home()
 	
 	cos_latitude = cos(sensor_data.gps.latitude_rad);
 	longitude_meter_per_radian = latitude_meter_per_radian * cos_latitude;  // approx
-	
+	cos_latitude_q14 = (long) (cos_latitude * 16384.0);
+
+	navigation_data.home_longitude_1e7 = sensor_data.gps.longitude_deg_1e7;
+	navigation_data.home_latitude_1e7 = sensor_data.gps.latitude_deg_1e7;
+
 	// set loiter position to home
 	navigation_data.loiter_waypoint_latitude_rad = sensor_data.gps.latitude_rad;
 	navigation_data.loiter_waypoint_longitude_rad = sensor_data.gps.longitude_rad;
@@ -585,3 +800,105 @@ float navigation_distance_between_meter(float long1, float long2, float lat1, fl
 
 	return sqrt(difflong*difflong + difflat*difflat);
 }
+
+
+///////////////////////////////////////////////////////////////////////////
+//      Integer versions, working on 1e-7 degree positions               //
+///////////////////////////////////////////////////////////////////////////
+
+#define PI_1E4    31416l
+#define PI_2_1E4  15708l
+#define PI_4_1E4   7854l
+
+/*!
+ *  Bitwise square root of a 64-bit value; the result always fits in 32 bit.
+ */
+static unsigned long isqrt64(unsigned long long x)
+{
+	unsigned long long rem = 0, root = 0;
+	int i;
+	for (i = 0; i < 32; i++)
+	{
+		root <<= 1;
+		rem = (rem << 2) | (x >> 62);
+		x <<= 2;
+		if (root < rem)
+		{
+			rem -= root | 1;
+			root += 2;
+		}
+	}
+	return (unsigned long) (root >> 1);
+}
+
+
+/*!
+ *  atan for z in Q15 (0..1), result in 1e-4 radians.
+ *  atan(z) ~ z*PI/4 + 0.273*z*(1-z); the error stays below 0.22 degrees.
+ */
+static long atan_q15_1e4(long z)
+{
+	return (long) (((long long) z * PI_4_1E4) >> 15)
+	     + (long) ((((long long) z * (32768l - z)) >> 15) * 2730l >> 15);
+}
+
+
+/*!
+ *  atan2 in 1e-4 radians (-PI..PI), integer only.
+ */
+static long atan2_1e4(long y, long x)
+{
+	long abs_y = y >= 0 ? y : -y;
+	long abs_x = x >= 0 ? x : -x;
+	long a;
+
+	if (abs_x == 0 && abs_y == 0)
+		return 0;
+
+	if (abs_x >= abs_y)
+		a = atan_q15_1e4((long) (((long long) abs_y << 15) / abs_x));
+	else
+		a = PI_2_1E4 - atan_q15_1e4((long) (((long long) abs_x << 15) / abs_y));
+
+	if (x < 0)
+		a = PI_1E4 - a;
+
+	return y >= 0 ? a : -a;
+}
+
+
+/*!
+ *  Integer twin of navigation_heading_rad_fromto(): same convention
+ *  (origin - destination differences, zero is north, clockwise positive)
+ *  but positions in 1e-7 degrees and the result in 1e-4 radians.
+ */
+long navigation_heading_1e4rad_fromto_int(long diff_long_1e7, long diff_lat_1e7)
+{
+	long diff_long = (long) (((long long) diff_long_1e7 * cos_latitude_q14) >> 14);   // Local, flat earth approximation!
+
+	long waypointHeading = atan2_1e4(diff_long, -diff_lat_1e7);
+
+	// make clockwise direction positive (CCW is +ve as is)
+	if (diff_long_1e7 > 0)
+		waypointHeading = 2l*PI_1E4 - waypointHeading;
+	else
+		waypointHeading = -waypointHeading;
+
+	return waypointHeading;
+}
+
+
+/*!
+ *  Integer twin of navigation_distance_between_meter().
+ *  One 1e-7 degree step is 0.011107m on the meridian, which is 91/8192
+ *  to within 0.02%, so the scaling is a multiply and a shift.
+ */
+long navigation_distance_between_meter_int(long long1_1e7, long long2_1e7, long lat1_1e7, long lat2_1e7)
+{
+	long difflong = (long) (((long long) (long1_1e7 - long2_1e7) * 91) >> 13);
+	long difflat = (long) (((long long) (lat1_1e7 - lat2_1e7) * 91) >> 13);
+	difflong = (long) (((long long) difflong * cos_latitude_q14) >> 14);
+
+	return (long) isqrt64((unsigned long long) ((long long) difflong * difflong +
+	                                            (long long) difflat * difflat));
+}
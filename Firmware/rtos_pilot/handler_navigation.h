@@ -7,8 +7,34 @@ void navigation_init();
 //void navigation_update();
 float navigation_heading_rad_fromto (float diff_long, float diff_lat); // used in OSD-code
 float navigation_distance_between_meter(float long1, float long2, float lat1, float lat2);
+
+// Integer variants working on 1e-7 degree positions (see gps_info): distance
+// in meter, heading in 1e-4 radian. Same flat-earth approximation with the
+// cos(latitude) factor cached at navigation_set_home(), but no double trig,
+// so they are cheap enough for the 5Hz gluonscript tick and the OSD.
+long navigation_heading_1e4rad_fromto_int(long diff_long_1e7, long diff_lat_1e7);
+long navigation_distance_between_meter_int(long long1_1e7, long long2_1e7, long lat1_1e7, long lat2_1e7);
 void navigation_calculate_relative_position(int i);
 void navigation_calculate_relative_positions();
+void navigation_calculate_leg_cache();
+
+
+/*!
+ *  Geometry of a FROM/TO leg, computed once when the flightplan changes
+ *  (upload, load, home set) instead of on every 5Hz navigation tick.
+ */
+struct NavigationLegCache
+{
+	float from_latitude_rad;   //!< Resolved start of the leg.
+	float from_longitude_rad;
+	float leg_x;               //!< Leg vector in meter, latitude direction.
+	float leg_y;               //!< Leg vector in meter, longitude direction.
+	float leg2;                //!< Squared leg length, clipped to >= 1.
+	float length;              //!< Leg length in meter.
+	unsigned int valid : 1;
+};
+
+extern struct NavigationLegCache navigation_leg_cache[MAX_GLUONSCRIPTCODES];
 
 
 /*!
@@ -30,6 +56,8 @@ struct NavigationData
 {
 	double home_longitude_rad;     //!< Home position, radians.
 	double home_latitude_rad;      //!< Home position, radians.
+	long home_longitude_1e7;       //!< Home position, 1e-7 degrees (for the integer math).
+	long home_latitude_1e7;        //!< Home position, 1e-7 degrees.
 	float home_gps_height;        //!< Height of home.
 	float home_pressure_height;
 	
@@ -48,12 +76,24 @@ struct NavigationData
 	unsigned int airborne : 1;                //!< Is 0 when the plane didn't take off yet.	
 	float wind_heading;           //!< Wind comes from...
 	unsigned int wind_heading_set : 1;
+
+	//! Wind vector estimated in flight by navigation_wind_update(); axes
+	//! follow the leg math: north = latitude, east = longitude.
+	float wind_north_ms;
+	float wind_east_ms;
+	float wind_speed_ms;
+	unsigned int wind_valid : 1;
 	
 	int desired_throttle_pct; // -1 = auto
 	
 	float desired_heading_rad;    //!< Last calculated desired heading. In radians. Zero is north.
 	float desired_altitude_agl;
 	float desired_pre_bank;
+
+	//! Last GPS position advanced along the last velocity vector, updated
+	//! at 50Hz by navigation_dead_reckon().
+	double dr_latitude_rad;
+	double dr_longitude_rad;
 	
 	//float height_error;       
 	//float distance_next_waypoint; //!< Distance to next waypoint in meter.
@@ -65,6 +105,12 @@ struct NavigationData
 
 volatile extern struct NavigationData navigation_data;
 
+//! Radians <-> meter conversion factors, updated for the home latitude.
+extern float latitude_meter_per_radian;
+extern float longitude_meter_per_radian;
+
+ScriptHandlerReturn navigation_periodic ();
 ScriptHandlerReturn navigation_handle_gluonscriptcommand (struct GluonscriptCode *code);
+void navigation_dead_reckon (float dt);
 
 #endif // NAVIGATION_H
@@ -7,24 +7,146 @@
 #include "FreeRTOS/semphr.h"
 
 #include "servo/servo.h"
+#include "timer/timer.h"
+#include "microcontroller/microcontroller.h"
 
 #include "common.h"
 #include "handler_trigger.h"
 #include "handler_navigation.h"
 #include "gluonscript.h"
 #include "sensors.h"
+#include "uart1_queue/uart1_queue.h"
 
 
 struct trigger_state trigger = { .mode = TRIGGER_PWM_INTERVAL_MODE, .is_triggering = 0, .servo_channel = 5,
                                  .usec_pulse = 2000, .delay_s = 0.5, .period_s = 2, .trigger_counter = 0, .distance_m = 0};
 enum trigger_mode mode;
 
-ScriptHandlerReturn trigger_handle_gluonscriptcommand (struct GluonscriptCode *code)
+static float last_delay_s = 0.5;  // will be reused by the start-trigger command
+
+/*
+ *    Distance mode used to fire from the script tick itself, which
+ *    quantized the shot to the tick period: 100-200ms, or several meters
+ *    of along-track error at survey speeds. The shot now comes from the
+ *    one-shot deadline timer (see timer_deadline_us): every tick the
+ *    remaining distance to the trigger point is converted via ground
+ *    speed into a microsecond deadline, refined until it falls inside the
+ *    coming tick, and the timer interrupt moves the servo exactly on
+ *    time. The restore to the rest position stays in task context.
+ */
+static volatile unsigned long fire_ms = 0;  // timer_millis() at the shot; 0 = no restore pending
+static volatile int deadline_armed = 0;
+static unsigned int rest_us = 0;            // servo position to put back after delay_s
+
+//! Runs in the timer deadline interrupt (priority 5): the shot itself.
+static void trigger_fire()
+{
+    if (trigger.usec_pulse > 2499)
+        servo_set_logical_1(trigger.servo_channel);
+    else if (trigger.usec_pulse == 0)
+        servo_set_logical_0(trigger.servo_channel);
+    else
+        servo_set_us(trigger.servo_channel, trigger.usec_pulse);
+
+    fire_ms = timer_millis();
+    if (fire_ms == 0)   // 0 means no restore pending
+        fire_ms = 1;
+    deadline_armed = 0;
+    trigger.trigger_counter++;
+}
+
+/*!
+ *    Opcode independent part, runs once per gluonscript tick: the
+ *    interval and distance based triggering.
+ *    Keeps the historical HANDLED_UNFINISHED return even when idle.
+ */
+ScriptHandlerReturn trigger_periodic ()
 {
-    static int counter_5hz = 0;
-    static float last_delay_s = 0.5;  // will be reused by the start-trigger command
+    static int tick_counter = 0;
     static double last_lng = 0.0, last_lat = 0.0;  // for distance trigger
 
+    if (trigger.is_triggering && trigger.mode == TRIGGER_PWM_INTERVAL_MODE)
+    {
+        tick_counter++;
+        if ((float)tick_counter >= trigger.period_s * (float)GLUONSCRIPT_HZ)
+        {
+            trigger_servo(trigger.servo_channel, trigger.usec_pulse, trigger.delay_s);
+            trigger.trigger_counter++;
+            tick_counter = 0;
+        }
+    }
+    else if (trigger.is_triggering && trigger.mode == TRIGGER_PWM_DISTANCE_MODE)
+    {
+        if (fire_ms)   // a shot went out; put the servo back after delay_s
+        {
+            unsigned int ms_delay = (unsigned int)(trigger.delay_s * 1000.0f);
+            ms_delay = MIN(ms_delay, 3000);
+            if (timer_millis() - fire_ms >= (unsigned long)ms_delay)
+            {
+                if (rest_us > 2499)
+                    servo_set_logical_1(trigger.servo_channel);
+                else if (rest_us == 0)
+                    servo_set_logical_0(trigger.servo_channel);
+                else
+                    servo_set_us(trigger.servo_channel, rest_us);
+
+                // re-anchor the travelled distance at the shot position
+                last_lat = sensor_data.gps.latitude_rad;
+                last_lng = sensor_data.gps.longitude_rad;
+                fire_ms = 0;
+                uart1_printf("\r\nTrigger %d\r\n", trigger.trigger_counter);
+            }
+        }
+        else
+        {
+            float remaining_m = trigger.distance_m -
+                navigation_distance_between_meter(sensor_data.gps.longitude_rad, last_lng,
+                                                  sensor_data.gps.latitude_rad, last_lat);
+
+            if (remaining_m <= 0.0f)
+            {
+                // already past the point (first tick, or we lost gps for a while)
+                rest_us = servo_read_us(trigger.servo_channel);
+                INTERRUPT_PROTECT(
+                    if (fire_ms == 0)
+                    {
+                        timer_deadline_us(0, &trigger_fire);
+                        deadline_armed = 1;
+                    }
+                );
+            }
+            else if (sensor_data.gps.speed_ms > 1.0f)
+            {
+                float eta_us = remaining_m / sensor_data.gps.speed_ms * 1.0e6f;
+
+                // refine the deadline every tick; once it falls within the
+                // coming two ticks, the last arming is the authoritative one
+                if (eta_us < 2.0e6f / (float)GLUONSCRIPT_HZ)
+                {
+                    rest_us = servo_read_us(trigger.servo_channel);
+                    INTERRUPT_PROTECT(
+                        if (fire_ms == 0)
+                        {
+                            timer_deadline_us((unsigned long)eta_us, &trigger_fire);
+                            deadline_armed = 1;
+                        }
+                    );
+                }
+                else if (deadline_armed)   // slowed down: the point moved out again
+                {
+                    timer_deadline_cancel();
+                    deadline_armed = 0;
+                }
+            }
+        }
+    }
+
+    return HANDLED_UNFINISHED;
+}
+
+
+ScriptHandlerReturn trigger_handle_gluonscriptcommand (struct GluonscriptCode *code)
+{
 	if (code->opcode == SERVO_TRIGGER)
 	{
 		trigger_servo(code->a, code->b, code->x);
@@ -56,6 +178,11 @@ ScriptHandlerReturn trigger_handle_gluonscriptcommand (struct GluonscriptCode *c
     else if (code->opcode == SERVO_STOP_TRIGGER)
     {
         trigger.is_triggering = 0;
+        if (deadline_armed)
+        {
+            timer_deadline_cancel();
+            deadline_armed = 0;
+        }
         if (trigger.mode == TRIGGER_CHDK_MODE)
         {
             servo_set_logical_0(trigger.servo_channel);
@@ -63,31 +190,7 @@ ScriptHandlerReturn trigger_handle_gluonscriptcommand (struct GluonscriptCode *c
         return HANDLED_FINISHED;
     }
 
-    if (trigger.is_triggering && trigger.mode == TRIGGER_PWM_INTERVAL_MODE)
-    {
-        counter_5hz++;
-        if ((float)counter_5hz >= trigger.period_s * 5.0)
-        {
-            trigger_servo(trigger.servo_channel, trigger.usec_pulse, trigger.delay_s);
-            trigger.trigger_counter++;
-            counter_5hz = 0;
-        }
-    }
-    else if (trigger.is_triggering && trigger.mode == TRIGGER_PWM_DISTANCE_MODE)
-    {
-        if (navigation_distance_between_meter(sensor_data.gps.longitude_rad, last_lng,
-                                              sensor_data.gps.latitude_rad, last_lat) > trigger.distance_m)
-        {
-            last_lat = sensor_data.gps.latitude_rad;
-            last_lng = sensor_data.gps.longitude_rad;
-            trigger_servo(trigger.servo_channel, trigger.usec_pulse, trigger.delay_s);
-            printf("\r\nTrigger %d\r\n", trigger.trigger_counter);
-            trigger.trigger_counter++;
-        }
-
-    }
-
-    return HANDLED_UNFINISHED;
+    return NOT_HANDLED;
 }
 
 
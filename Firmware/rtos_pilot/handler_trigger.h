@@ -30,6 +30,7 @@ extern struct trigger_state trigger;
 void trigger_set_mode(enum trigger_mode mode);
 void trigger_servo(int servo, int usec_pulse, float delay_s);
 
+ScriptHandlerReturn trigger_periodic ();
 ScriptHandlerReturn trigger_handle_gluonscriptcommand (struct GluonscriptCode *code);
 
 #endif //TRIGGER_H
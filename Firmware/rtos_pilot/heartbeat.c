@@ -0,0 +1,129 @@
+/*!
+ *  @file     heartbeat.c
+ *  @brief    Per-task heartbeat registry feeding the hardware watchdog.
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#include "FreeRTOS/FreeRTOS.h"
+#include "FreeRTOS/task.h"
+
+#include "microcontroller/microcontroller.h"
+
+#include "heartbeat.h"
+
+
+struct HeartbeatEntry
+{
+	const char *name;
+	portTickType period;    //!< expected check-in period, in ticks
+	portTickType last;      //!< tick count at the last check-in
+	unsigned int misses;    //!< overdue episodes since boot
+	char overdue;           //!< currently past the deadline
+};
+
+static struct HeartbeatEntry entry[HEARTBEAT_MAX_TASKS];
+static int entries = 0;
+static int armed = 0;
+
+
+int heartbeat_register(const char *name, unsigned int period_ms)
+{
+	int id = -1;
+
+	// unlike stackwatch_register this runs from the tasks themselves, after
+	// the scheduler started, so the slot must be filled before it is
+	// published: the idle task may supervise between any two instructions
+	taskENTER_CRITICAL();
+	if (entries < HEARTBEAT_MAX_TASKS)
+	{
+		id = entries;
+		entry[id].name = name;
+		entry[id].period = ( portTickType ) period_ms / portTICK_RATE_MS;
+		entry[id].last = xTaskGetTickCount();
+		entry[id].misses = 0;
+		entry[id].overdue = 0;
+		entries = id + 1;
+	}
+	taskEXIT_CRITICAL();
+	return id;
+}
+
+
+void heartbeat_checkin(int id)
+{
+	if (id < 0)
+		return;
+	entry[id].last = xTaskGetTickCount();   // single 16-bit write, atomic on this core
+}
+
+
+void heartbeat_supervise()
+{
+	portTickType now;
+	portTickType age;
+	int i;
+	int all_ok = 1;
+
+	if (! armed)
+	{
+		// the idle task only runs once every created task got through its
+		// init, so a slow gps autodetect or rc wait at boot cannot trip the
+		// watchdog; period comes from the WDTPRE/WDTPOST fuses (~1s)
+		RCONbits.SWDTEN = 1;
+		armed = 1;
+	}
+
+	now = xTaskGetTickCount();
+	for (i = 0; i < entries; i++)
+	{
+		age = now - entry[i].last;   // unsigned, so safe across the 16-bit tick wrap
+		if (age > entry[i].period * 2 + 2)   // +2 ticks rounding slack
+		{
+			if (! entry[i].overdue)
+			{
+				entry[i].overdue = 1;
+				entry[i].misses++;
+			}
+			all_ok = 0;
+		}
+		else if (entry[i].overdue && age <= entry[i].period)
+			entry[i].overdue = 0;   // a fresh check-in ended the episode
+	}
+
+	if (all_ok)
+		asm("clrwdt");
+	// else: starve the watchdog; warmstart_init() recovers after the reset
+}
+
+
+int heartbeat_count()
+{
+	return entries;
+}
+
+
+const char *heartbeat_name(int i)
+{
+	return entry[i].name;
+}
+
+
+unsigned int heartbeat_period_ms(int i)
+{
+	return (unsigned int) (entry[i].period * portTICK_RATE_MS);
+}
+
+
+unsigned int heartbeat_misses(int i)
+{
+	return entry[i].misses;
+}
+
+
+unsigned int heartbeat_age_ms(int i)
+{
+	portTickType age = xTaskGetTickCount() - entry[i].last;
+	return (unsigned int) (age * portTICK_RATE_MS);
+}
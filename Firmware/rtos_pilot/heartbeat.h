@@ -0,0 +1,54 @@
+/*!
+ *  @file     heartbeat.h
+ *  @brief    Per-task heartbeat registry feeding the hardware watchdog.
+ *  @detailed The stack-overflow hook catches a task that scribbles past its
+ *            stack, but nothing caught a task that simply stops meeting its
+ *            period: a gps task blocked on a wedged uart2, a loop spinning
+ *            on a semaphore that never comes. Every periodic task registers
+ *            here with its expected period and checks in once per loop
+ *            iteration; the idle hook calls heartbeat_supervise(), which
+ *            feeds the watchdog only while every registered task made its
+ *            deadline. A wedged task therefore ends in a watchdog reset -
+ *            which warmstart.c already turns back into level flight - and
+ *            every missed deadline is counted and reported on the TK
+ *            telemetry line (CH console command).
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+#ifndef HEARTBEAT_H
+#define HEARTBEAT_H
+
+//! Same bound as the stackwatch registry: rtos_pilot.c creates at most 8
+//! tasks. The console input task blocks on uart1 indefinitely by design
+//! and must not register.
+#define HEARTBEAT_MAX_TASKS 8
+
+//! Called once from the task itself, after its init code and right before
+//! its main loop; name must be a string literal (the pointer is kept, not
+//! the content). period_ms is the longest gap between two check-ins in
+//! normal operation; the task counts as overdue when it stays silent for
+//! more than twice that. Returns the id to pass to heartbeat_checkin(),
+//! or -1 when the table is full.
+int heartbeat_register(const char *name, unsigned int period_ms);
+
+//! Called once per loop iteration from the task; one tick read, no blocking.
+void heartbeat_checkin(int id);
+
+//! Called from vApplicationIdleHook(). Arms the watchdog on its first call -
+//! only then did every task get through its init - and from then on feeds
+//! it as long as no registered task is overdue. Counts one miss per overdue
+//! episode, not one per idle pass.
+void heartbeat_supervise();
+
+//! Number of registered tasks.
+int heartbeat_count();
+
+//! Name, expected period, missed-deadline count and time since the last
+//! check-in of task i, for the TK line and the CH command.
+const char *heartbeat_name(int i);
+unsigned int heartbeat_period_ms(int i);
+unsigned int heartbeat_misses(int i);
+unsigned int heartbeat_age_ms(int i);
+
+#endif // HEARTBEAT_H
@@ -0,0 +1,79 @@
+/*!
+ *  Sensor-to-servo latency histograms, see latency.h.
+ *
+ *  All marks read the free-running TMR4/TMR5 cycle counter and only modular
+ *  differences are used, so the ~107s wrap does not matter. The sample
+ *  timestamp is written by the sensor task and read by the control task; a
+ *  32 bit read is not atomic on the dsPIC, so a preemption in exactly the
+ *  wrong cycle can tear it. That puts one bogus entry in the overflow bucket
+ *  at worst, which is acceptable for a diagnostic.
+ *
+ *  @file     latency.c
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#include "microcontroller/microcontroller.h"
+#include "timer/timer.h"
+
+#include "latency.h"
+
+
+struct LatencyHistogram latency_sample_to_ahrs;
+struct LatencyHistogram latency_sample_to_servo;
+
+//! Counter value at the last raw sensor read, written by the sensor task.
+static volatile unsigned long sample_ticks = 0;
+
+
+static void latency_book(struct LatencyHistogram *h, unsigned long since_ticks)
+{
+	unsigned long us = (timer_ticks_32() - since_ticks) / (FCY / 1000000l);
+	int bucket = (int) (us / LATENCY_BUCKET_US);
+
+	if (bucket >= LATENCY_BUCKETS)
+		bucket = LATENCY_BUCKETS - 1;
+	h->count[bucket]++;
+
+	if (us > h->max_us)
+		h->max_us = us;
+}
+
+
+void latency_init()
+{
+	latency_reset();
+}
+
+
+void latency_reset()
+{
+	int i;
+
+	for (i = 0; i < LATENCY_BUCKETS; i++)
+	{
+		latency_sample_to_ahrs.count[i] = 0;
+		latency_sample_to_servo.count[i] = 0;
+	}
+	latency_sample_to_ahrs.max_us = 0;
+	latency_sample_to_servo.max_us = 0;
+}
+
+
+void latency_mark_sample()
+{
+	sample_ticks = timer_ticks_32();
+}
+
+
+void latency_mark_ahrs()
+{
+	latency_book(&latency_sample_to_ahrs, sample_ticks);
+}
+
+
+void latency_mark_servo()
+{
+	latency_book(&latency_sample_to_servo, sample_ticks);
+}
@@ -0,0 +1,52 @@
+/*!
+ *  Sensor-to-servo latency histograms.
+ *
+ *  @file     latency.h
+ *  @brief    Measures the time between a raw sensor sample and the moment it
+ *            reaches the servos, and keeps a bucketed histogram of it.
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ *
+ *  @detailed The attitude loops are tuned for gust rejection, and that tuning
+ *            is only as good as the end-to-end actuation latency. This module
+ *            timestamps three points with the free-running TMR4/TMR5 cycle
+ *            counter (timer/timer.c): sample completion in the sensor task,
+ *            the ahrs_filter() output, and the servo register write in
+ *            control_mix_out(). It books two histograms from them:
+ *            sample-to-ahrs and sample-to-servo. Query them (and reset) with
+ *            the CL console command in communication_csv.c.
+ */
+
+//! Number of histogram buckets; the last one catches everything above.
+#define LATENCY_BUCKETS    16
+//! Width of one bucket in microseconds (16 x 2ms covers a full 50Hz period).
+#define LATENCY_BUCKET_US  2000
+
+
+struct LatencyHistogram
+{
+	unsigned long count[LATENCY_BUCKETS];   //!< count[i] = latencies in [i, i+1) * LATENCY_BUCKET_US
+	unsigned long max_us;                   //!< worst latency seen since the last reset
+};
+
+//! Raw sample -> attitude out of ahrs_filter().
+extern struct LatencyHistogram latency_sample_to_ahrs;
+//! Raw sample -> servo register write in control_mix_out().
+extern struct LatencyHistogram latency_sample_to_servo;
+
+
+//! Zeroes the histograms. The cycle counter itself is started by profiler_init().
+void latency_init();
+
+//! Empties both histograms; called after every CL report.
+void latency_reset();
+
+//! Called by the sensor task right after the raw gyro/accelerometer read.
+void latency_mark_sample();
+
+//! Called at the end of ahrs_filter(); books into latency_sample_to_ahrs.
+void latency_mark_ahrs();
+
+//! Called at the end of control_mix_out(); books into latency_sample_to_servo.
+void latency_mark_servo();
@@ -0,0 +1,219 @@
+/*!
+ *  Two-board redundancy link, see mirror.h.
+ *
+ *  @file     mirror.c
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#include "uart2/uart2.h"
+#include "servo/servo.h"
+#include "timer/timer.h"
+
+#include "sensors.h"
+#include "communication_binary.h"
+#include "configuration.h"
+#include "gluonscript.h"
+#include "mirror.h"
+
+
+struct MirrorShadow mirror_shadow;
+
+//! Payload bytes between the length byte and the checksum pair.
+#define MIRROR_PAYLOAD_BYTES (MIRROR_FRAME_BYTES - 6)
+
+
+static void mirror_put16(unsigned char *b, unsigned int v)
+{
+	b[0] = (unsigned char)(v & 0xff);
+	b[1] = (unsigned char)(v >> 8);
+}
+
+
+static void mirror_put32(unsigned char *b, unsigned long v)
+{
+	b[0] = (unsigned char)(v & 0xff);
+	b[1] = (unsigned char)((v >> 8) & 0xff);
+	b[2] = (unsigned char)((v >> 16) & 0xff);
+	b[3] = (unsigned char)(v >> 24);
+}
+
+
+void mirror_send_state()
+{
+	unsigned char payload[MIRROR_PAYLOAD_BYTES];
+	unsigned char msgid = BIN_MSG_MIRROR | (unsigned char)(config.telemetry.aircraft_id << 5);
+	unsigned char ck_a = 0, ck_b = 0;
+	int i;
+
+	mirror_put16(payload + 0, (unsigned int)(int)(sensor_data.roll * 1000.0));
+	mirror_put16(payload + 2, (unsigned int)(int)(sensor_data.pitch * 1000.0));
+	mirror_put16(payload + 4, (unsigned int)(int)(sensor_data.yaw * 1000.0));
+	mirror_put16(payload + 6, (unsigned int)(int)(sensor_data.p_bias * 10000.0));
+	mirror_put16(payload + 8, (unsigned int)(int)(sensor_data.q_bias * 10000.0));
+	payload[10] = (unsigned char)control_state.flight_mode;
+	payload[11] = (unsigned char)sensor_data.gps.satellites_in_view;
+	mirror_put16(payload + 12, (unsigned int)gluonscript_data.current_codeline);
+	for (i = 0; i < 6; i++)
+		mirror_put16(payload + 14 + 2*i, servo_read_us(i));
+	mirror_put32(payload + 26, (unsigned long)sensor_data.gps.latitude_deg_1e7);
+	mirror_put32(payload + 30, (unsigned long)sensor_data.gps.longitude_deg_1e7);
+	mirror_put16(payload + 34, (unsigned int)(sensor_data.gps.speed_ms * 10.0));
+	mirror_put16(payload + 36, (unsigned int)(sensor_data.gps.heading_rad * 100.0));
+	mirror_put16(payload + 38, (unsigned int)sensor_data.gps.height_m);
+
+	uart2_putc(BIN_SYNC1);
+	uart2_putc(BIN_SYNC2);
+	uart2_putc((char)msgid);
+	uart2_putc((char)MIRROR_PAYLOAD_BYTES);
+	ck_a += msgid;                ck_b += ck_a;
+	ck_a += MIRROR_PAYLOAD_BYTES; ck_b += ck_a;
+	for (i = 0; i < MIRROR_PAYLOAD_BYTES; i++)
+	{
+		uart2_putc((char)payload[i]);
+		ck_a += payload[i];
+		ck_b += ck_a;
+	}
+	uart2_putc((char)ck_a);
+	uart2_putc((char)ck_b);
+}
+
+
+/* Explicit sign extension: int and long are exactly the wire widths on the
+target, but the host build (sim) has wider ones. */
+
+static int mirror_get16(unsigned char *b)
+{
+	unsigned int v = b[0] | ((unsigned int)b[1] << 8);
+
+	if (v & 0x8000u)
+		return -(int)((~v + 1) & 0xffffu);
+	return (int)v;
+}
+
+
+static long mirror_get32(unsigned char *b)
+{
+	unsigned long v = b[0] | ((unsigned long)b[1] << 8) |
+	                  ((unsigned long)b[2] << 16) | ((unsigned long)b[3] << 24);
+
+	if (v & 0x80000000ul)
+		return -(long)((~v + 1) & 0xfffffffful);
+	return (long)v;
+}
+
+
+/*!
+ *  Decodes a checksum-valid payload into mirror_shadow.
+ */
+static void mirror_decode(unsigned char *payload)
+{
+	int i;
+
+	mirror_shadow.roll_mrad = mirror_get16(payload + 0);
+	mirror_shadow.pitch_mrad = mirror_get16(payload + 2);
+	mirror_shadow.yaw_mrad = mirror_get16(payload + 4);
+	mirror_shadow.p_bias_e4 = mirror_get16(payload + 6);
+	mirror_shadow.q_bias_e4 = mirror_get16(payload + 8);
+	mirror_shadow.flight_mode = payload[10];
+	mirror_shadow.satellites = payload[11];
+	mirror_shadow.codeline = mirror_get16(payload + 12);
+	for (i = 0; i < 6; i++)
+		mirror_shadow.servo_us[i] = (unsigned int)mirror_get16(payload + 14 + 2*i);
+	mirror_shadow.latitude_deg_1e7 = mirror_get32(payload + 26);
+	mirror_shadow.longitude_deg_1e7 = mirror_get32(payload + 30);
+	mirror_shadow.speed_dm_s = (unsigned int)mirror_get16(payload + 34);
+	mirror_shadow.heading_crad = (unsigned int)mirror_get16(payload + 36);
+	mirror_shadow.height_m = mirror_get16(payload + 38);
+	mirror_shadow.last_update_ms = timer_millis();
+	mirror_shadow.frames++;
+}
+
+
+int mirror_receive_char(unsigned char c)
+{
+	static enum { M_SYNC1, M_SYNC2, M_MSGID, M_LENGTH, M_PAYLOAD, M_CK_A, M_CK_B } state = M_SYNC1;
+	static unsigned char payload[MIRROR_PAYLOAD_BYTES];
+	static unsigned char pos = 0;
+	static unsigned char ck_a = 0, ck_b = 0;
+
+	switch (state)
+	{
+		case M_SYNC1:
+			if (c == BIN_SYNC1)
+				state = M_SYNC2;
+			break;
+		case M_SYNC2:
+			state = (c == BIN_SYNC2) ? M_MSGID : M_SYNC1;
+			break;
+		case M_MSGID:
+			// aircraft id rides in the top 3 bits, see communication_binary.h
+			if ((c & 0x1f) == BIN_MSG_MIRROR)
+			{
+				ck_a = c;
+				ck_b = c;
+				state = M_LENGTH;
+			}
+			else
+				state = M_SYNC1;
+			break;
+		case M_LENGTH:
+			if (c == MIRROR_PAYLOAD_BYTES)
+			{
+				ck_a += c;
+				ck_b += ck_a;
+				pos = 0;
+				state = M_PAYLOAD;
+			}
+			else
+				state = M_SYNC1;
+			break;
+		case M_PAYLOAD:
+			payload[pos++] = c;
+			ck_a += c;
+			ck_b += ck_a;
+			if (pos == MIRROR_PAYLOAD_BYTES)
+				state = M_CK_A;
+			break;
+		case M_CK_A:
+			state = (c == ck_a) ? M_CK_B : M_SYNC1;
+			if (state == M_SYNC1)
+				mirror_shadow.crc_errors++;
+			break;
+		case M_CK_B:
+			state = M_SYNC1;
+			if (c == ck_b)
+			{
+				mirror_decode(payload);
+				return 1;
+			}
+			mirror_shadow.crc_errors++;
+			break;
+	}
+	return 0;
+}
+
+
+void mirror_apply()
+{
+	// Follow the script: plain assignment, not gluonscript_goto_from_gcs() -
+	// this runs at 10Hz and must not grow the script's call stack. On a
+	// failover the backup simply keeps executing from the line it is on.
+	if (mirror_shadow.codeline >= 0 && mirror_shadow.codeline < MAX_GLUONSCRIPTCODES &&
+	    mirror_shadow.codeline != gluonscript_data.current_codeline)
+		gluonscript_data.current_codeline = mirror_shadow.codeline;
+
+	// The mirrored gps solution substitutes for the local receiver (the
+	// backup's uart2 carries this stream instead of a gps).
+	sensor_data.gps.latitude_deg_1e7 = mirror_shadow.latitude_deg_1e7;
+	sensor_data.gps.longitude_deg_1e7 = mirror_shadow.longitude_deg_1e7;
+	sensor_data.gps.latitude_rad = (double)mirror_shadow.latitude_deg_1e7 * 1.745329252e-9;   // 1e-7 deg -> rad
+	sensor_data.gps.longitude_rad = (double)mirror_shadow.longitude_deg_1e7 * 1.745329252e-9;
+	sensor_data.gps.speed_ms = (float)mirror_shadow.speed_dm_s * 0.1f;
+	sensor_data.gps.speed_cm_s = (long)mirror_shadow.speed_dm_s * 10;
+	sensor_data.gps.heading_rad = (float)mirror_shadow.heading_crad * 0.01f;
+	sensor_data.gps.height_m = mirror_shadow.height_m;
+	sensor_data.gps.satellites_in_view = mirror_shadow.satellites;
+	sensor_data.gps.status = ACTIVE;
+}
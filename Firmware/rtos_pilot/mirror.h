@@ -0,0 +1,79 @@
+/*!
+ *  Two-board redundancy link: state mirroring over uart2.
+ *
+ *  For flights with a second gluonpilot board behind an external servo
+ *  mux, the primary streams its flight state - attitude and gyro bias,
+ *  active gluonscript codeline, servo outputs and the gps solution - as
+ *  one compact binary frame at 10Hz on uart2, and the backup board
+ *  shadows it: its navigation follows the primary's codeline and its gps
+ *  fields are fed from the mirrored solution, so the script and the
+ *  position estimate are warm the moment the mux fails over. The backup
+ *  runs its own sensors, AHRS and control loop the whole time; the
+ *  mirrored attitude is kept for cross-checking the two boards (CM
+ *  console line), not forced into the filters.
+ *
+ *  The frame uses the binary telemetry framing (sync, msgid, length,
+ *  Fletcher checksum pair, see communication_binary.h) with msgid
+ *  BIN_MSG_MIRROR. 46 wire bytes at 10Hz is under 2% of the port at the
+ *  mirror baudrate, and well under 2% CPU on either side. Roles are
+ *  selected with the SX console command (config.telemetry.mirror); the
+ *  backup side claims uart2 from the gps driver at boot, like the wired
+ *  telemetry mode does.
+ *
+ *  @file     mirror.h
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#ifndef MIRROR_H
+#define MIRROR_H
+
+//! Values of config.telemetry.mirror.
+#define MIRROR_OFF      0
+#define MIRROR_PRIMARY  1
+#define MIRROR_BACKUP   2
+
+//! Board-to-board wire, not a radio: fast enough that a frame's blocking
+//! writes cost the telemetry tick well under 2ms.
+#define MIRROR_BAUDRATE 230400l
+
+//! Wire size of one mirror frame (sync + msgid + length + payload + cksum);
+//! the backup uses it as the receive wake threshold.
+#define MIRROR_FRAME_BYTES 46
+
+//! Last received mirror frame, decoded. Valid once frames > 0; check
+//! last_update_ms against timer_millis() for staleness.
+struct MirrorShadow
+{
+	int roll_mrad, pitch_mrad, yaw_mrad;
+	int p_bias_e4, q_bias_e4;       //!< gyro bias states, 1e-4 rad/s
+	unsigned char flight_mode;
+	int codeline;                   //!< active gluonscript line
+	unsigned int servo_us[6];
+	long latitude_deg_1e7, longitude_deg_1e7;
+	unsigned int speed_dm_s;        //!< 0.1 m/s
+	unsigned int heading_crad;      //!< 0.01 rad
+	int height_m;
+	unsigned char satellites;
+	unsigned long last_update_ms;   //!< timer_millis() at the last good frame
+	unsigned long frames;           //!< good frames received
+	unsigned long crc_errors;
+};
+
+extern struct MirrorShadow mirror_shadow;
+
+//! Primary side: sends one state frame on uart2. Called from the telemetry
+//! tick (10Hz); the port must already be open at MIRROR_BAUDRATE.
+void mirror_send_state();
+
+//! Backup side: feeds one received character into the frame parser.
+//! Returns 1 when a frame just completed (mirror_shadow is fresh).
+int mirror_receive_char(unsigned char c);
+
+//! Backup side: folds the shadow into the live state - follows the
+//! primary's codeline and feeds the mirrored gps solution into
+//! sensor_data.gps. Gps task context, call after a completed frame.
+void mirror_apply();
+
+#endif // MIRROR_H
@@ -0,0 +1,113 @@
+/*!
+ *  Per-task CPU load profiler, see profiler.h.
+ *
+ *  The accumulation itself happens in the traceTASK_SWITCHED_OUT() macro in
+ *  FreeRTOSConfig.h (only when the project defines PROFILING, so the example
+ *  projects keep linking without this file). Every context switch reads the
+ *  free-running TMR5:TMR4 cycle counter and books the delta on the tag of
+ *  the task that is being switched out; the scheduler's own time ends up in
+ *  the incoming task's bucket, which is where a tuner wants to see it.
+ *
+ *  @file     profiler.c
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#include "microcontroller/microcontroller.h"
+#include "microcontroller/isr_time.h"
+#include "timer/timer.h"
+
+#include "profiler.h"
+
+
+//! Cycles booked per task tag; written by the trace macro in FreeRTOSConfig.h.
+volatile unsigned long ulProfilerTaskTime[PROFILER_MAX_TAGS];
+//! Counter value when the running task was switched in.
+volatile unsigned long ulProfilerSwitchedInTime = 0;
+
+
+void profiler_init()
+{
+	int i;
+
+	for (i = 0; i < PROFILER_MAX_TAGS; i++)
+		ulProfilerTaskTime[i] = 0;
+
+	// The free-running 32-bit TMR4/TMR5 counter (timer/timer.c) is cycle
+	// accurate and wraps every ~107s at 40MHz. The trace macro only uses
+	// modular deltas, so the wrap doesn't matter as long as the load is
+	// read out more often than that (the telemetry task reports every 5s).
+	// The same counter serves the control loop's dt measurement.
+	timer_init_freerunning();
+}
+
+
+int profiler_get_load_pct10(unsigned int pct10[], int size)
+{
+	static unsigned long last_time[PROFILER_MAX_TAGS];
+	unsigned long delta[PROFILER_MAX_TAGS];
+	unsigned long total = 0;
+	int n = (size < PROFILER_MAX_TAGS) ? size : PROFILER_MAX_TAGS;
+	int i;
+
+	for (i = 0; i < n; i++)
+	{
+		unsigned long t = ulProfilerTaskTime[i];
+		delta[i] = t - last_time[i];
+		last_time[i] = t;
+		total += delta[i];
+	}
+
+	if (total < 1000l)   // freshly started; avoid dividing by 0
+		total = 1000l;
+
+	for (i = 0; i < n; i++)
+		pct10[i] = (unsigned int) (delta[i] / (total / 1000l));
+
+	return n;
+}
+
+
+#ifdef ISR_PROFILING
+
+//! Cycles and invocations per vector; written by the ISR_TIME_ENTER/EXIT
+//! macros (microcontroller/isr_time.h) in the instrumented library ISRs.
+volatile unsigned long ulIsrTimeCycles[ISR_TIME_MAX_VECTORS];
+volatile unsigned long ulIsrTimeCount[ISR_TIME_MAX_VECTORS];
+
+
+int profiler_get_isr_load_pct10(unsigned int pct10[], int size,
+                                unsigned long *interrupts)
+{
+	static unsigned long last_cycles[ISR_TIME_MAX_VECTORS];
+	static unsigned long last_count[ISR_TIME_MAX_VECTORS];
+	static unsigned long last_ticks = 0;
+	unsigned long now = timer_ticks_32();
+	// ISR load is measured against wall time, not scheduled time: the
+	// interrupts steal from every task alike
+	unsigned long wall = now - last_ticks;
+	unsigned long ints = 0;
+	int n = (size < ISR_TIME_MAX_VECTORS) ? size : ISR_TIME_MAX_VECTORS;
+	int i;
+
+	last_ticks = now;
+	if (wall < 1000l)   // freshly started; avoid dividing by 0
+		wall = 1000l;
+
+	for (i = 0; i < n; i++)
+	{
+		unsigned long c = ulIsrTimeCycles[i];
+		unsigned long k = ulIsrTimeCount[i];
+		pct10[i] = (unsigned int) ((c - last_cycles[i]) / (wall / 1000l));
+		ints += k - last_count[i];
+		last_cycles[i] = c;
+		last_count[i] = k;
+	}
+
+	if (interrupts)
+		*interrupts = ints;
+	return n;
+}
+
+#endif // ISR_PROFILING
@@ -0,0 +1,38 @@
+/*!
+ *  @file     profiler.h
+ *  @brief    Per-task CPU load profiler.
+ *  @detailed TMR4/TMR5 run as one free-running 32-bit cycle counter and the
+ *            context-switch trace macro in FreeRTOSConfig.h books the elapsed
+ *            cycles on the outgoing task's application tag. This module owns
+ *            the storage and turns the accumulated cycles into load figures,
+ *            so we can see in the field which task is saturating the CPU.
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+#ifndef PROFILER_H
+#define PROFILER_H
+
+//! Task tags run 1..8 (see the vTaskSetApplicationTaskTag calls); bucket 0
+//! catches kernel time and tasks that have not set a tag yet.
+#define PROFILER_MAX_TAGS 9
+
+//! Starts the 32-bit TMR4/TMR5 pair and clears the per-tag counters.
+void profiler_init();
+
+//! Fills pct10[] with the CPU load per task tag since the previous call,
+//! in 0.1% units. Returns the number of entries filled (at most size).
+int profiler_get_load_pct10(unsigned int pct10[], int size);
+
+#ifdef ISR_PROFILING
+//! Fills pct10[] with the CPU share per instrumented interrupt vector
+//! (index order: microcontroller/isr_time.h) since the previous call, in
+//! 0.1% units of wall time, and stores the total interrupt count of the
+//! interval in *interrupts. Returns the number of entries filled.
+//! Define ISR_PROFILING in the build configuration (rtos_pilot.X); the
+//! entry/exit macros in the library ISRs compile away without it.
+int profiler_get_isr_load_pct10(unsigned int pct10[], int size,
+                                unsigned long *interrupts);
+#endif // ISR_PROFILING
+
+#endif // PROFILER_H
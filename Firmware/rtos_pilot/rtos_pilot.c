@@ -24,10 +24,12 @@
 
 // Gluonpilot library includes
 #include "microcontroller/microcontroller.h"
+#include "microcontroller/spi_bus.h"
 #include "uart1_queue/uart1_queue.h"
 #include "dataflash/dataflash.h"
 #include "pwm_in/pwm_in.h"
 #include "ppm_in/ppm_in.h"
+#include "pps/pps.h"
 #include "led/led.h"
 #include "servo/servo.h"
 
@@ -42,70 +44,123 @@
 #include "gluonscript.h"
 #include "task_osd.h"
 #include "task_gps.h"
+#include "profiler.h"
+#include "latency.h"
+#include "warmstart.h"
+#include "blackbox.h"
+#include "stackwatch.h"
+#include "heartbeat.h"
+#include "bootstats.h"
+#include "flashcheck.h"
 
 #include "common.h"
 
 extern xSemaphoreHandle xGpsSemaphore;
-extern xSemaphoreHandle xSpiSemaphore;
 
 static char version[] = "0.9 Beta 2";
 
 unsigned long idle_counter = 0;
 
+//! Scratch for the task-creation macros below; the handle of the task that
+//! was just created, so it can be registered with the stackwatch module.
+static xTaskHandle xCreatedTask;
+
+#ifdef STATIC_TASK_STACKS
+// Task stacks at link time instead of carved from the heap at boot: the map
+// file shows the exact RAM layout and a misjudged configTOTAL_HEAP_SIZE can
+// no longer make a task creation fail halfway through startup.
+// xTaskGenericCreate() accepts the buffer; only the TCBs, the idle task and
+// the queues/semaphores still come from the (much smaller) heap, because
+// this V7.2.0 kernel has no static path for those.
+static portSTACK_TYPE xControlStack  [ configMINIMAL_STACK_SIZE * 3 ];
+static portSTACK_TYPE xSensorsStack  [ configMINIMAL_STACK_SIZE * 5 ];
+static portSTACK_TYPE xGpsStack      [ configMINIMAL_STACK_SIZE * 4 ];
+static portSTACK_TYPE xConsoleStack  [ configMINIMAL_STACK_SIZE * 5 ];
+static portSTACK_TYPE xDataflashStack[ configMINIMAL_STACK_SIZE * 3 ];
+static portSTACK_TYPE xTelemetryStack[ configMINIMAL_STACK_SIZE * 2 ];
+static portSTACK_TYPE xOsdStack      [ configMINIMAL_STACK_SIZE * 1 ];
+
+#define xTaskCreateStack( pvTaskCode, pcName, pxStack, uxPriority ) \
+	do { \
+		xTaskGenericCreate( ( pvTaskCode ), ( signed portCHAR * ) ( pcName ), \
+		                    sizeof( pxStack ) / sizeof( portSTACK_TYPE ), NULL, \
+		                    ( uxPriority ), &xCreatedTask, ( pxStack ), NULL ); \
+		stackwatch_register( xCreatedTask, ( pcName ), sizeof( pxStack ) / sizeof( portSTACK_TYPE ) ); \
+	} while (0)
+#else
+// Same, for the heap-allocated stack path.
+#define xTaskCreateWatched( pvTaskCode, pcName, usStackDepth, uxPriority ) \
+	do { \
+		xTaskCreate( ( pvTaskCode ), ( signed portCHAR * ) ( pcName ), ( usStackDepth ), NULL, ( uxPriority ), &xCreatedTask ); \
+		stackwatch_register( xCreatedTask, ( pcName ), ( usStackDepth ) ); \
+	} while (0)
+#endif
+
 void setup_trace_pins();
 
 int main()
 {
+	int bp;
+
 	microcontroller_init();
 
 	uart1_queue_init(57600l);  // default baudrate: 57600 due to XBee bi-direction communication
 
 
-	printf("Gluonpilot v%s ", version);
+	uart1_printf("Gluonpilot v%s ", version);
 #ifdef LIMITED  // Limited version is pre-loaded on modules sent to Non-European countries
-	printf("Limited version");
+	uart1_printf("Limited version");
 #endif
 	
-	printf(" [%s %s, config: %dB, logline: %dB, navigation: %dB, double: %dB]\r\n\r\n",
+	uart1_printf(" [%s %s, config: %dB, logline: %dB, navigation: %dB, double: %dB]\r\n\r\n",
                 __DATE__, __TIME__, sizeof(struct Configuration), sizeof(struct LogLine), sizeof(gluonscript_data.codes), sizeof(double));
 	
 	microcontroller_reset_type();  // printf out reason of reset; for debugging
+	warmstart_init();  // after a watchdog/brownout reset the in-flight state snapshot is still in RAM
+	blackbox_init();   // hook the crash-dump capture into the trap handlers
 	led_init();
 
 	// Create semaphores needed for FreeRTOS synchronization (better to do it know, they are changed in interrupts of uart2 and ppm)
-	vSemaphoreCreateBinary( xSpiSemaphore );
+	spi_bus_init();
 	vSemaphoreCreateBinary( xGpsSemaphore );
 
+	profiler_init();  // the context-switch hook starts booking cycles right away
+	latency_init();   // shares the profiler's free-running cycle counter
+
 	// What hardware version are we using?
 	configuration_determine_hardware_version();
 	if (HARDWARE_VERSION == V01N)
-		printf("Found hardware version v0.1n\r\n");
+		uart1_printf("Found hardware version v0.1n\r\n");
 	else if (HARDWARE_VERSION == V01O)
-		printf("Found hardware version v0.1o\r\n");
+		uart1_printf("Found hardware version v0.1o\r\n");
     else if (HARDWARE_VERSION == V01Q)
-		printf("Found hardware version v0.1q (GP2)\r\n");
+		uart1_printf("Found hardware version v0.1q (GP2)\r\n");
 	else
-		printf("Found hardware version v0.1j or earlier\r\n");
+		uart1_printf("Found hardware version v0.1j or earlier\r\n");
 	
 	// Open flash & load configuration
+	bp = bootstats_begin("dataflash");
 	dataflash_open();
-	printf("%d MB flash found \r\n", (int)PAGE_SIZE/264);
-	//printf("Loading configuration...");
+	bootstats_end(bp);
+	uart1_printf("%d MB flash found \r\n", (int)PAGE_SIZE/264);
+	//uart1_printf("Loading configuration...");
+	bp = bootstats_begin("config");
 	configuration_load();
-	//printf("done\r\n");
+	bootstats_end(bp);
+	//uart1_printf("done\r\n");
+	bp = bootstats_begin("blackbox");
+	blackbox_check();  // flush + print a crash dump from the previous run, if any
+	bootstats_end(bp);
+	flashcheck_init();  // arm the idle-time CRC walk over the program flash
 
 	
-	// Open RC receiver input: pwm_in/ppm_in task: in ppm_in/pwm_in.c
-	// This is too low level to do it in the control task
+	// Open RC receiver input: only the peripheral setup happens here. The
+	// wait for the receiver to boot moved into the control task, so the
+	// sensor, gps and console tasks initialize in parallel with it.
+	bp = bootstats_begin("rc open");
 	if (config.control.use_pwm)
 	{
 		pwm_in_open(); 
-		uart1_puts("Waiting for pwm");
-		pwm_in_wait_for();
-		if (! (ppm.channel[0] > 900 && ppm.channel[0] < 2100))
-			uart1_puts("not found!\r\n");
-		else
-			uart1_puts("done\r\n");
 	} 
 	else
 	{
@@ -113,27 +168,62 @@ int main()
 		ppm_in_open(); // We need a complete frame (which takes at least 20ms) to start so never can start early enough!
 		uart1_puts(" done\r\n");
 	}	
+	bootstats_end(bp);
+	
+	pps_open();  // gps 1Hz pulse on IC7; harmless when the pin is not wired
 	
 
-	// Create our tasks. 
+	// The control path is selected at build time: the quadrocopter target
+	// defines ENABLE_QUADROCOPTER (which already picked the AHRS) and only
+	// compiles the copter task and mixer, the fixed-wing targets only the
+	// wing ones. Warn when the burned configuration disagrees.
+#ifdef ENABLE_QUADROCOPTER
+	if (config.control.servo_mix != QUADROCOPTER)
+		uart1_printf("Warning: quadrocopter firmware, but servo_mix = %d\r\n", config.control.servo_mix);
+#else
 	if (config.control.servo_mix == QUADROCOPTER)
-		xTaskCreate( control_copter_task,            ( signed portCHAR * ) "CControl",      ( configMINIMAL_STACK_SIZE * 3 ), NULL, tskIDLE_PRIORITY + 7, NULL );
-	else
-		xTaskCreate( control_wing_task,            ( signed portCHAR * ) "WControl",      ( configMINIMAL_STACK_SIZE * 3 ), NULL, tskIDLE_PRIORITY + 7, NULL );
+		uart1_printf("Warning: fixed-wing firmware, but servo_mix = QUADROCOPTER\r\n");
+#endif
+
+	// Create our tasks.
+#ifdef STATIC_TASK_STACKS
+#ifdef ENABLE_QUADROCOPTER
+	xTaskCreateStack( control_copter_task,               "CControl",     xControlStack,   tskIDLE_PRIORITY + 7 );
+#else
+	xTaskCreateStack( control_wing_task,                 "WControl",     xControlStack,   tskIDLE_PRIORITY + 7 );
+#endif
+
+    if (HARDWARE_VERSION == V01Q)
+    	xTaskCreateStack( sensors_mpu6000_task,          "Sensors",      xSensorsStack,   tskIDLE_PRIORITY + 6 );
+    else
+        xTaskCreateStack( sensors_analog_task,           "Sensors",      xSensorsStack,   tskIDLE_PRIORITY + 6 );
+
+    xTaskCreateStack( sensors_gps_task,                  "GpsNavi",      xGpsStack,       tskIDLE_PRIORITY + 5 );
+	xTaskCreateStack( communication_input_task,          "ConsoleInput", xConsoleStack,   tskIDLE_PRIORITY + 4 );
+	xTaskCreateStack( datalogger_task,                   "Dataflash",    xDataflashStack, tskIDLE_PRIORITY + 3 );
+	xTaskCreateStack( communication_telemetry_task,      "Telemetry",    xTelemetryStack, tskIDLE_PRIORITY + 2 );
+    xTaskCreateStack( osd_task,                          "OSD",          xOsdStack,       tskIDLE_PRIORITY + 1 );
+#else
+#ifdef ENABLE_QUADROCOPTER
+	xTaskCreateWatched( control_copter_task,             "CControl",     configMINIMAL_STACK_SIZE * 3, tskIDLE_PRIORITY + 7 );
+#else
+	xTaskCreateWatched( control_wing_task,               "WControl",     configMINIMAL_STACK_SIZE * 3, tskIDLE_PRIORITY + 7 );
+#endif
 
     if (HARDWARE_VERSION == V01Q)
-    	xTaskCreate( sensors_mpu6000_task,                 ( signed portCHAR * ) "Sensors",      ( configMINIMAL_STACK_SIZE * 5 ), NULL, tskIDLE_PRIORITY + 6, NULL );
+    	xTaskCreateWatched( sensors_mpu6000_task,        "Sensors",      configMINIMAL_STACK_SIZE * 5, tskIDLE_PRIORITY + 6 );
     else
-        xTaskCreate( sensors_analog_task,                 ( signed portCHAR * ) "Sensors",      ( configMINIMAL_STACK_SIZE * 5 ), NULL, tskIDLE_PRIORITY + 6, NULL );
+        xTaskCreateWatched( sensors_analog_task,         "Sensors",      configMINIMAL_STACK_SIZE * 5, tskIDLE_PRIORITY + 6 );
 
-    xTaskCreate( sensors_gps_task,             ( signed portCHAR * ) "GpsNavi",      ( configMINIMAL_STACK_SIZE * 4 ), NULL, tskIDLE_PRIORITY + 5, NULL );
-	xTaskCreate( communication_input_task,     ( signed portCHAR * ) "ConsoleInput", ( configMINIMAL_STACK_SIZE * 5 ), NULL, tskIDLE_PRIORITY + 4, NULL );
-	xTaskCreate( datalogger_task,              ( signed portCHAR * ) "Dataflash",    ( configMINIMAL_STACK_SIZE * 3 ), NULL, tskIDLE_PRIORITY + 3, NULL );
-	xTaskCreate( communication_telemetry_task, ( signed portCHAR * ) "Telemetry",    ( configMINIMAL_STACK_SIZE * 2 ), NULL, tskIDLE_PRIORITY + 2, NULL );
-    xTaskCreate( osd_task,                     ( signed portCHAR * ) "OSD",          ( configMINIMAL_STACK_SIZE * 1 ), NULL, tskIDLE_PRIORITY + 1, NULL );
+    xTaskCreateWatched( sensors_gps_task,                "GpsNavi",      configMINIMAL_STACK_SIZE * 4, tskIDLE_PRIORITY + 5 );
+	xTaskCreateWatched( communication_input_task,        "ConsoleInput", configMINIMAL_STACK_SIZE * 5, tskIDLE_PRIORITY + 4 );
+	xTaskCreateWatched( datalogger_task,                 "Dataflash",    configMINIMAL_STACK_SIZE * 3, tskIDLE_PRIORITY + 3 );
+	xTaskCreateWatched( communication_telemetry_task,    "Telemetry",    configMINIMAL_STACK_SIZE * 2, tskIDLE_PRIORITY + 2 );
+    xTaskCreateWatched( osd_task,                        "OSD",          configMINIMAL_STACK_SIZE * 1, tskIDLE_PRIORITY + 1 );
+#endif
 
 #ifdef USE_TRACING
-    printf("\r\nENABLING TRACING\r\n");
+    uart1_printf("\r\nENABLING TRACING\r\n");
     setup_trace_pins();
 #endif
 
@@ -149,10 +239,7 @@ int main()
 
 void vApplicationStackOverflowHook( xTaskHandle *pxTask, signed portCHAR *pcTaskName )
 {
-	uart1_puts("\n\rStack overflow! ");
-	uart1_puts((char*)pcTaskName);
-	uart1_puts("\n\r");
-	while(1) ; 
+	blackbox_stack_overflow((char*)pcTaskName);  // captures a dump and resets
 }
 
 
@@ -166,6 +253,8 @@ void vApplicationIdleHook( void )
         idle_counter+=2;
         PORTBbits.RB2 = 1;
         idle_counter-=1;
+        heartbeat_supervise();   // feeds the watchdog while every task meets its deadline
+        flashcheck_idle_step();  // burns the leftover cycles re-verifying the flash
     }
 }
 
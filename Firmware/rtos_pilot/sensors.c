@@ -1,5 +1,108 @@
+#include <math.h>
 
 #include "sensors.h"
 
 //! Contains all usefull (processed) sensor data
 struct SensorData sensor_data;
+
+
+/*
+ *   Double-buffered snapshot of sensor_data, so readers in other tasks
+ *   get a coherent roll/pitch/p/q/r set without disabling interrupts or
+ *   taking a semaphore. The sensor task keeps writing sensor_data as
+ *   before and calls sensors_publish_snapshot() once per loop, after the
+ *   ahrs update. The sequence counter is odd while a publication is in
+ *   progress, so sensors_get_snapshot() only retries the copy when it
+ *   raced the writer; with a 20ms (or 4ms) publish period and a copy of
+ *   ~150 bytes that is at most one retry.
+ */
+static struct SensorData sensor_snapshot_buffer[2];
+static volatile int snapshot_index = 0;   // the buffer readers should copy
+static volatile unsigned int snapshot_sequence = 0;
+
+
+void sensors_publish_snapshot()
+{
+	int next = 1 - snapshot_index;
+
+	snapshot_sequence++;   // odd: publication in progress
+	sensor_snapshot_buffer[next] = sensor_data;
+	snapshot_index = next;   // single int write: atomic on the dsPIC
+	snapshot_sequence++;   // even again
+}
+
+
+void sensors_get_snapshot(struct SensorData *out)
+{
+	unsigned int sequence;
+
+	do
+	{
+		sequence = snapshot_sequence;
+		*out = sensor_snapshot_buffer[snapshot_index];
+	} while (sequence != snapshot_sequence || (sequence & 1));
+}
+
+
+/*
+ *   Battery current integration: the sensor task only stores and sums raw
+ *   ADC counts; the scaling to amps and mAh happens here, when telemetry
+ *   or the OSD asks, with the whole calibration folded into one constant
+ *   per unit. The 10A sense reads 3.3V full scale over 16 bits with a x2
+ *   board correction; one charge count is one 0.5s sample (2Hz), and the
+ *   historical /4 stays folded in so logged packs keep their calibration.
+ */
+#define BATTERY1_AMP_PER_COUNT  (3.30f * 10.0f / 65520.0f * 2.0f)
+#define BATTERY1_MAH_PER_COUNT  (BATTERY1_AMP_PER_COUNT * (1000.0f * 0.5f / 3600.0f) / 4.0f)
+
+float sensors_battery1_current()
+{
+	return (float)sensor_data.battery1_current_raw * BATTERY1_AMP_PER_COUNT;
+}
+
+float sensors_battery1_mAh()
+{
+	return (float)sensor_data.battery1_charge_raw * BATTERY1_MAH_PER_COUNT;
+}
+
+
+/*
+ *   Accelerometer health gate for the attitude filters. A component close
+ *   to the sensor's clipping level, or a vector magnitude far from 1g,
+ *   means the measurement no longer points "down": applying it would drag
+ *   the attitude toward the maneuver instead of gravity. While degraded
+ *   the filters fly on pure gyro integration (which is also the cheap
+ *   path, exactly when the control loops work hardest). Once the readings
+ *   are clean again the corrections are eased back in: a hold-off first,
+ *   then the gain ramps from 0 to full, so the covariance that grew
+ *   during the outage cannot step the attitude in one cycle.
+ */
+#define ACC_SAT_G        1.9f           // just under the accelerometer's clipping level
+#define ACC_NORM_MIN_G2  (0.5f * 0.5f)  // |a|^2 sanity band around 1g
+#define ACC_NORM_MAX_G2  (1.5f * 1.5f)
+#define ACC_HOLDOFF      25             // clean filter cycles before re-entry (~0.5s at 50Hz)
+#define ACC_RAMP         50             // cycles to ramp the correction gain back to full
+
+int sensors_acc_confidence()
+{
+	// boot healthy: ahrs_init levels from the accelerometers on the bench anyway
+	static int clean_cycles = ACC_HOLDOFF + ACC_RAMP;
+
+	float norm2 = sensor_data.acc_x * sensor_data.acc_x +
+	              sensor_data.acc_y * sensor_data.acc_y +
+	              sensor_data.acc_z * sensor_data.acc_z;
+
+	if (fabs(sensor_data.acc_x) > ACC_SAT_G || fabs(sensor_data.acc_y) > ACC_SAT_G ||
+	    fabs(sensor_data.acc_z) > ACC_SAT_G ||
+	    norm2 < ACC_NORM_MIN_G2 || norm2 > ACC_NORM_MAX_G2)
+	{
+		clean_cycles = 0;
+		return 0;
+	}
+
+	if (clean_cycles < ACC_HOLDOFF + ACC_RAMP)
+		clean_cycles++;
+	if (clean_cycles <= ACC_HOLDOFF)
+		return 0;
+	return ((clean_cycles - ACC_HOLDOFF) * 256) / ACC_RAMP;
+}
@@ -19,16 +19,26 @@ struct SensorData
 	float roll_acc, pitch_acc;
 	float vertical_speed; // estimated speed along z axis
 	float p_bias, q_bias;  // used in kalman filter
+	int stationary;        // 1 when the craft sits still (bench, pre-arm); gates the lazy covariance mode
 
 	float pressure;
 	float temperature;
 	float pressure_height;
 	int temperature_10;
 	unsigned int battery1_voltage_10;
-    float battery1_current;
-    float battery1_mAh;
+	//! Current sense, raw ADC counts; sensors_battery1_current() converts
+	unsigned int battery1_current_raw;
+	//! Sum of the 2Hz raw current readings. Integer, so the sensor task
+	//! never touches float for this; sensors_battery1_mAh() converts at
+	//! read time. Wraps after ~9h of full-scale draw - not in one flight.
+	unsigned long battery1_charge_raw;
     unsigned int battery2_voltage_10;
 
+	//! Signed distance to the tracked navigation leg in meter, + = right of
+	//! track. Dead reckoned at 50Hz between GPS fixes, re-anchored on every
+	//! fix; only meaningful while a FROM_TO style line is being flown.
+	float cross_track_m;
+
 	struct gps_info gps;
 };
 
@@ -48,4 +58,25 @@ struct SensorConfig
 
 extern struct SensorData sensor_data;
 
+//! Called by the sensor task once per loop: publishes sensor_data as a
+//! coherent snapshot for the other tasks (double buffer + sequence counter).
+void sensors_publish_snapshot();
+
+//! Copies the last published snapshot into *out. Lock-free: retries the
+//! copy when it raced the writer, never blocks and never touches IEC/SR.
+void sensors_get_snapshot(struct SensorData *out);
+
+//! Battery 1 current draw in A, converted from the raw ADC reading with
+//! the calibration scale folded into one constant. Telemetry/OSD rate.
+float sensors_battery1_current();
+
+//! Consumed charge in mAh, converted from the raw accumulator the same way.
+float sensors_battery1_mAh();
+
+//! Gain gate for the accelerometer corrections in the attitude filters.
+//! Call once per filter cycle. 0 while the accelerometers saturate or
+//! read far from 1g (fly on the gyros alone), then ramps back to 256
+//! (= full correction) after the readings have stayed clean for a while.
+int sensors_acc_confidence();
+
 #endif // SENSORS_ANALOG_H
@@ -0,0 +1,61 @@
+/*!
+ *  @file     stackwatch.c
+ *  @brief    Per-task stack high-water registry.
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#include "FreeRTOS/FreeRTOS.h"
+#include "FreeRTOS/task.h"
+
+#include "stackwatch.h"
+
+
+struct StackwatchEntry
+{
+	xTaskHandle task;
+	const char *name;
+	unsigned int depth;   //!< configured stack size, in words
+};
+
+static struct StackwatchEntry entry[STACKWATCH_MAX_TASKS];
+static int entries = 0;
+
+
+void stackwatch_register(xTaskHandle task, const char *name, unsigned int depth_words)
+{
+	if (task == NULL || entries >= STACKWATCH_MAX_TASKS)
+		return;
+
+	entry[entries].task = task;
+	entry[entries].name = name;
+	entry[entries].depth = depth_words;
+	entries++;
+}
+
+
+int stackwatch_count()
+{
+	return entries;
+}
+
+
+const char *stackwatch_name(int i)
+{
+	return entry[i].name;
+}
+
+
+unsigned int stackwatch_depth(int i)
+{
+	return entry[i].depth;
+}
+
+
+unsigned int stackwatch_free(int i)
+{
+	// walks the stack pattern from configCHECK_FOR_STACK_OVERFLOW method 2;
+	// cheap enough for a telemetry line, not for a control loop
+	return uxTaskGetStackHighWaterMark(entry[i].task);
+}
@@ -0,0 +1,36 @@
+/*!
+ *  @file     stackwatch.h
+ *  @brief    Per-task stack high-water registry.
+ *  @detailed The task stacks are sized by hand and were only ever measured
+ *            once, manually. This module keeps the handle, name and
+ *            configured depth of every task created in rtos_pilot.c, so the
+ *            TW telemetry line and the CW console command can report live
+ *            uxTaskGetStackHighWaterMark figures. With real numbers the
+ *            over-provisioned stacks can be shrunk and the RAM reclaimed.
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+#ifndef STACKWATCH_H
+#define STACKWATCH_H
+
+#include "FreeRTOS/FreeRTOS.h"
+#include "FreeRTOS/task.h"
+
+//! rtos_pilot.c creates at most 8 tasks (one control + one sensor variant).
+#define STACKWATCH_MAX_TASKS 8
+
+//! Called once per created task; name must be a string literal (the pointer
+//! is kept, not the content). Silently ignores a NULL handle.
+void stackwatch_register(xTaskHandle task, const char *name, unsigned int depth_words);
+
+//! Number of registered tasks.
+int stackwatch_count();
+
+//! Name, configured stack depth and current high-water mark (the smallest
+//! amount of stack that was ever left free) of task i. All in 16-bit words.
+const char *stackwatch_name(int i);
+unsigned int stackwatch_depth(int i);
+unsigned int stackwatch_free(int i);
+
+#endif // STACKWATCH_H
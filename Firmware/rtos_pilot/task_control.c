@@ -31,12 +31,18 @@
 #include "pid/pid.h"
 #include "button/button.h"
 #include "uart1_queue/uart1_queue.h"
+#include "timer/timer.h"
 
 // rtos_pilot includes
 #include "task_control.h"
+#include "task_datalogger.h"
 #include "configuration.h"
+#include "communication_binary.h"
 #include "sensors.h"
 #include "handler_navigation.h"
+#include "latency.h"
+#include "heartbeat.h"
+#include "bootstats.h"
 #include "common.h"
 
 void control_wing_manual();
@@ -55,11 +61,399 @@ int elevator_out = 0, aileron_out = 0, yaw_out = 0, motor_out = 0;
 //! Mix xyz_out to servo_out
 void control_mix_out();
 
+//! Set by control_request_selftest() (CP console command), cleared by the
+//! fixed-wing control task once it has run the self-test.
+static volatile int selftest_requested = 0;
+
+void control_request_selftest()
+{
+	selftest_requested = 1;
+}
+
+//! Axis requested by control_request_autotune() (CT console command),
+//! picked up by the fixed-wing control task at its next loop boundary.
+static volatile int autotune_request = -1;
+
+void control_request_autotune(int axis)
+{
+#ifdef ENABLE_QUADROCOPTER
+	uart1_printf("\r\nAutotune: fixed-wing builds only\r\n");
+#else
+	if (axis < 0 || axis > 1)
+	{
+		uart1_printf("\r\nAutotune: axis 0 = roll, 1 = pitch\r\n");
+		return;
+	}
+	autotune_request = axis;
+#endif
+}
+
+//! One staged gain set from control_stage_pid(), waiting for the control
+//! task to apply it. The target is written last and read first: while it
+//! is -1 the struct may be mid-write and the control task leaves it alone.
+static struct pid staged_pid;
+static volatile int staged_pid_target = -1;
+
+void control_stage_pid(enum ControlPids target, struct pid *gains)
+{
+	staged_pid = *gains;
+	staged_pid_target = (int)target;
+}
+
+/*!
+ *    Copies a staged gain set into the configuration and refolds the
+ *    precomputed gains, between two control cycles. Only the gains and
+ *    limits move; the live pid state (i_state etc.) is left alone, so a
+ *    fixed-wing loop keeps flying smoothly through a retune. Runs in the
+ *    control task, so nothing here races the pid updates.
+ */
+static void control_apply_staged_pid()
+{
+	struct pid *dst;
+
+	switch (staged_pid_target)
+	{
+		case CONTROL_PID_ROLL:     dst = &config.control.pid_roll2aileron; break;
+		case CONTROL_PID_PITCH:    dst = &config.control.pid_pitch2elevator; break;
+		case CONTROL_PID_HEADING:  dst = &config.control.pid_heading2roll; break;
+		case CONTROL_PID_ALTITUDE: dst = &config.control.pid_altitude2pitch; break;
+		default: return;
+	}
+
+	dst->p_gain = staged_pid.p_gain;
+	dst->i_gain = staged_pid.i_gain;
+	dst->d_gain = staged_pid.d_gain;
+	dst->i_min = staged_pid.i_min;
+	dst->i_max = staged_pid.i_max;
+	dst->d_term_min_var = staged_pid.d_term_min_var;
+	staged_pid_target = -1;
+
+	control_precompute_mix();   // refold the fixed-point copter gains
+}
+
+// Use the incremental fixed-point PID from pid.c for the copter attitude
+// loops: 3 long multiply-accumulates per axis instead of a software-float
+// pid_update(), which is what makes the higher inner loop rate affordable.
+// The gains still come from the same configuration; control_precompute_mix()
+// folds them to integers whenever the groundstation changes them.
+#ifdef ENABLE_QUADROCOPTER
+#define COPTER_PID_FIXED
+#endif
+
+// Total-energy altitude/speed control (TECS style) for the fixed wing:
+// throttle commands the total energy, pitch the balance between height
+// and speed, so the altitude pid and the auto-throttle stop fighting
+// each other and hunting around the cruise setting. Reuses the existing
+// auto-throttle percent settings and the altitude2pitch gains; comment
+// in to replace the independent altitude->pitch + proportional throttle.
+//#define TECS_ENERGY_CONTROL
+
+#ifdef TECS_ENERGY_CONTROL
+//! Integrating throttle pid on the total energy error, see
+//! control_wing_energy(); gains folded in control_precompute_mix().
+static struct pid pid_energy2throttle;
+#endif
+
+// The copter inner loop period. The 2ms (500Hz) option is for builds where
+// the imu publish rate is raised as well; with the stock 4ms sensor loop
+// the extra cycles would only re-read the same snapshot.
+#ifdef COPTER_CONTROL_500HZ
+#define COPTER_CONTROL_PERIOD_MS 2
+#else
+#define COPTER_CONTROL_PERIOD_MS 4
+#endif
+
+// Feedforward gain for the copter yaw axis, in mixer units per rad/s of
+// commanded yaw rate. The commanded rate goes straight to the mixer, so
+// yaw tracks the stick without cranking the P gain (or the loop rate).
+// Tune per airframe; 0.0 disables the term.
+#define COPTER_YAW_FF_GAIN 300.0
+
+#ifdef COPTER_PID_FIXED
+// Cascade defaults: rate setpoint ceiling (~200 deg/s) and the angle-to-rate
+// slope used when the configured attitude PID has no D gain to derive it from.
+#define COPTER_MAX_RATE_MRAD_S    3500
+#define COPTER_ANGLE2RATE_DEFAULT 4.5f
+#endif
+
+//! Mix coefficients folded out of the configuration by control_precompute_mix(),
+//! so the 50Hz mix works with multiplies only:
+//! +1 or -1 per servo, from the reverse_servoX bits
+static int servo_dir[6] = {1, 1, 1, 1, 1, 1};
+//! aileron_differential/10 as a Q8 multiplier, replacing 2 divides per mix
+static long aileron_diff_q8 = 0;
+//! max_roll/500 and max_pitch/500, replacing a divide per stick per cycle
+static float stick_to_roll = 0.0;
+static float stick_to_pitch = 0.0;
+
+//! Inputs of the mixer stage, in mixer units (roughly -500..500, motor
+//! 0..1000). Aileron comes in twice so the differential (which depends on
+//! the runtime sign of the deflection) stays out of the per-servo math.
+enum MixInput { MIX_AILERON_RIGHT = 0, MIX_AILERON_LEFT, MIX_ELEVATOR, MIX_YAW, MIX_MOTOR, MIX_CAM_ROLL, MIX_INPUTS };
+
+//! One mixer row per servo: servo i = neutral + (row i . inputs) with Q8
+//! coefficients. Built from servo_mix by control_build_mix_rows(), so
+//! every airframe pays the same multiply-accumulate cost per servo and a
+//! new airframe is a table, not a new case in the 50/250Hz path.
+struct MixRow
+{
+	int coef[MIX_INPUTS];       //!< Q8: 256 = 1.0
+	unsigned int cam_servo : 1; //!< camera compensation row: offset 1500, not servo_neutral
+};
+static struct MixRow mix_row[6];
+static int mix_channels = 6;
+
+#ifdef COPTER_PID_FIXED
+//! Cascaded copter attitude control, folded by control_precompute_mix():
+//! a half-rate angle pass turns attitude error into body-rate setpoints,
+//! and these rate loops run on the gyro axes every cycle.
+static struct pid_fixed pid_p_rate_fixed, pid_q_rate_fixed, pid_r_rate_fixed;
+//! Angle-to-rate slope per axis (roll, pitch, yaw), Q8: (mrad/s) per mrad.
+static int angle2rate_q8[3];
+//! Body-rate setpoints (mrad/s), refreshed by the half-rate angle pass.
+static int rate_sp_p = 0, rate_sp_q = 0, rate_sp_r = 0;
+#endif
+
 //! Contains the currect state of the control loop
 struct ControlState control_state;
+
+//! Coherent copy of sensor_data for the current 20ms tick, refreshed at the
+//! top of the control loop with sensors_get_snapshot(). Reading the global
+//! directly can tear: the sensor task updates it mid-read.
+static struct SensorData sensor_snapshot;
       
 	          
 
+/*!
+ *    Helper for control_build_mix_rows(): coefficient of one input of one
+ *    row, as +-gain with the servo's reverse bit applied.
+ */
+static void mix_set(int servo, enum MixInput input, float gain, int reversible)
+{
+	if (reversible)
+		gain *= (float)servo_dir[servo];
+	mix_row[servo].coef[input] = (int)(gain * 256.0);
+}
+
+
+/*!
+ *    Validates config.control.servo_mix against this build and compiles it
+ *    into the Q8 mixer rows. An airframe the firmware was not built for
+ *    falls back to the build's default mix with a console warning, which
+ *    beats flying an elevon mix on a quad.
+ */
+static void control_build_mix_rows()
+{
+	int i, j;
+
+	for (i = 0; i < 6; i++)
+	{
+		for (j = 0; j < MIX_INPUTS; j++)
+			mix_row[i].coef[j] = 0;
+		mix_row[i].cam_servo = 0;
+	}
+	mix_channels = 6;
+
+#ifdef ENABLE_QUADROCOPTER
+	if (config.control.servo_mix != QUADROCOPTER && config.control.servo_mix != HEXACOPTER)
+	{
+		uart1_printf("servo_mix %d not in this firmware; using QUADROCOPTER\r\n", config.control.servo_mix);
+		config.control.servo_mix = QUADROCOPTER;
+	}
+
+	if (config.control.servo_mix == HEXACOPTER)
+	{
+		/*  Flat hex-X: motors clockwise from front-right, bearings 30, 90,
+		 *  150, 210, 270, 330 degrees; roll = -sin(bearing), pitch =
+		 *  cos(bearing), yaw alternates with prop direction. Same 1/5
+		 *  authority scale as the quad mix.
+		 */
+		static const float hex_roll[6]  = {-0.5, -1.0, -0.5,  0.5,  1.0,  0.5};
+		static const float hex_pitch[6] = {0.87,  0.0, -0.87, -0.87, 0.0, 0.87};
+		static const float hex_yaw[6]   = { 1.0, -1.0,  1.0, -1.0,  1.0, -1.0};
+		for (i = 0; i < 6; i++)
+		{
+			mix_set(i, MIX_MOTOR, 1.0, 0);
+			mix_set(i, MIX_AILERON_RIGHT, hex_roll[i] * 0.2, 0);
+			mix_set(i, MIX_ELEVATOR, hex_pitch[i] * 0.2, 0);
+			mix_set(i, MIX_YAW, hex_yaw[i] * 0.2, 0);
+		}
+	}
+	else  // QUADROCOPTER
+	{
+		/*          >
+		 *          0
+		 *      < /   \ <
+		 *      3       1        FRONT
+		 *        \ > /
+		 *          2
+		 */
+		mix_channels = 4;
+		for (i = 0; i < 4; i++)
+			mix_set(i, MIX_MOTOR, 1.0, 0);
+		mix_set(0, MIX_AILERON_RIGHT, 0.2, 0);
+		mix_set(0, MIX_YAW, 0.2, 0);
+		mix_set(1, MIX_ELEVATOR, 0.2, 0);
+		mix_set(1, MIX_YAW, -0.2, 0);
+		mix_set(2, MIX_AILERON_RIGHT, -0.2, 0);
+		mix_set(2, MIX_YAW, 0.2, 0);
+		mix_set(3, MIX_ELEVATOR, -0.2, 0);
+		mix_set(3, MIX_YAW, -0.2, 0);
+	}
+#else
+	if (config.control.servo_mix == QUADROCOPTER || config.control.servo_mix == HEXACOPTER)
+	{
+		uart1_printf("servo_mix %d not in this firmware; using AILERON\r\n", config.control.servo_mix);
+		config.control.servo_mix = AILERON;
+	}
+
+	switch (config.control.servo_mix)
+	{
+		case DELTA_PLUS:
+			mix_channels = 5;
+			mix_set(0, MIX_AILERON_RIGHT, -1.0, 1);
+			mix_set(0, MIX_ELEVATOR, -1.0, 1);
+			mix_set(1, MIX_AILERON_LEFT, -1.0, 1);
+			mix_set(1, MIX_ELEVATOR, 1.0, 1);
+			mix_set(3, MIX_MOTOR, 1.0, 1);
+			mix_set(4, MIX_CAM_ROLL, 1.0, 1);
+			mix_row[4].cam_servo = 1;
+			break;
+		case DELTA_MIN:
+			mix_channels = 5;
+			mix_set(0, MIX_AILERON_RIGHT, -1.0, 1);
+			mix_set(0, MIX_ELEVATOR, 1.0, 1);
+			mix_set(1, MIX_AILERON_LEFT, -1.0, 1);
+			mix_set(1, MIX_ELEVATOR, -1.0, 1);
+			mix_set(3, MIX_MOTOR, 1.0, 1);
+			mix_set(4, MIX_CAM_ROLL, 1.0, 1);
+			mix_row[4].cam_servo = 1;
+			break;
+		case AILERONS_FLAPERONS:
+			mix_set(0, MIX_AILERON_RIGHT, 1.0, 1);
+			mix_set(0, MIX_YAW, -1.0, 1);
+			mix_set(1, MIX_AILERON_LEFT, -1.0, 1);
+			mix_set(1, MIX_YAW, -1.0, 1);
+			mix_set(2, MIX_ELEVATOR, 1.0, 1);
+			mix_set(3, MIX_MOTOR, 1.0, 1);
+			mix_set(4, MIX_YAW, -1.0, 1);
+			mix_set(5, MIX_CAM_ROLL, 1.0, 1);
+			mix_row[5].cam_servo = 1;
+			break;
+		case VTAIL:
+			// ailerons on 1/2, the two ruddervators where the elevator and
+			// rudder servos used to plug in; reverse bits sort the geometry
+			mix_set(0, MIX_AILERON_RIGHT, 1.0, 1);
+			mix_set(1, MIX_AILERON_LEFT, -1.0, 1);
+			mix_set(2, MIX_ELEVATOR, 1.0, 1);
+			mix_set(2, MIX_YAW, 1.0, 1);
+			mix_set(3, MIX_MOTOR, 1.0, 1);
+			mix_set(4, MIX_ELEVATOR, 1.0, 1);
+			mix_set(4, MIX_YAW, -1.0, 1);
+			mix_set(5, MIX_CAM_ROLL, 1.0, 1);
+			mix_row[5].cam_servo = 1;
+			break;
+		default:  // aileron
+			mix_set(0, MIX_AILERON_RIGHT, 1.0, 1);
+			mix_set(1, MIX_AILERON_LEFT, -1.0, 1);
+			mix_set(2, MIX_ELEVATOR, 1.0, 1);
+			mix_set(3, MIX_MOTOR, 1.0, 1);
+			mix_set(4, MIX_YAW, -1.0, 1);
+			mix_set(5, MIX_CAM_ROLL, 1.0, 1);
+			mix_row[5].cam_servo = 1;
+			break;
+	}
+#endif
+}
+
+
+#ifdef COPTER_PID_FIXED
+/*!
+ *    Splits one configured attitude PID into the cascade's two loops.
+ *    With a D gain the mapping is exact for slow setpoints (d(error)/dt
+ *    is -rate): the rate loop's P is the old D, the angle-to-rate slope
+ *    is P/D, and I moves into the rate loop scaled so the DC stiffness
+ *    P * angle_error is unchanged. Without a D gain the slope falls back
+ *    to COPTER_ANGLE2RATE_DEFAULT, again keeping the DC stiffness. A
+ *    derivative on the gyro axis itself would only amplify noise, so the
+ *    rate loop runs PI.
+ */
+static void control_fold_rate_pid(struct pid_fixed *rate, int *a2r_q8,
+                                  struct pid *cfg, float scale, float dt)
+{
+	struct pid rate_cfg;
+	float kr = cfg->d_gain;
+	float ka;
+
+	if (kr < 0.001f)
+	{
+		ka = COPTER_ANGLE2RATE_DEFAULT;
+		kr = cfg->p_gain / ka;
+	}
+	else
+		ka = cfg->p_gain / kr;
+
+	rate_cfg.p_gain = kr;
+	rate_cfg.i_gain = (ka > 0.001f) ? cfg->i_gain / ka : 0.0f;
+	rate_cfg.d_gain = 0.0f;
+
+	*a2r_q8 = (int)(ka * 256.0f);
+	pid_fixed_init(rate, &rate_cfg, scale, dt, -800, 800);
+}
+#endif
+
+
+/*!
+ *    Folds the servo reverse bits, the aileron differential and the stick
+ *    scales from the configuration into the coefficients the mixing code
+ *    uses every cycle. Call it again whenever the configuration changes
+ *    (the SC and SR console commands do).
+ */
+void control_precompute_mix()
+{
+	servo_dir[0] = config.control.reverse_servo1 ? -1 : 1;
+	servo_dir[1] = config.control.reverse_servo2 ? -1 : 1;
+	servo_dir[2] = config.control.reverse_servo3 ? -1 : 1;
+	servo_dir[3] = config.control.reverse_servo4 ? -1 : 1;
+	servo_dir[4] = config.control.reverse_servo5 ? -1 : 1;
+	servo_dir[5] = config.control.reverse_servo6 ? -1 : 1;
+
+	aileron_diff_q8 = (long)config.control.aileron_differential * 256 / 10;
+
+	stick_to_roll = config.control.max_roll / 500.0;
+	stick_to_pitch = config.control.max_pitch / 500.0;
+
+	control_build_mix_rows();
+
+#ifdef COPTER_PID_FIXED
+	// Cascaded copter attitude control: each configured attitude PID is
+	// split by control_fold_rate_pid() into an angle-to-rate slope and a
+	// full-rate PI loop on the gyro axis. Errors stay in mrad (mrad/s for
+	// the rate loops); pitch/roll come out in mixer units (630 per rad/s
+	// of rate P), yaw gains are configured in output units per rad.
+	// Refolding resets the accumulators, so retuning in flight gives the
+	// same transient as the float PID's i_state reset did.
+	control_fold_rate_pid(&pid_q_rate_fixed, &angle2rate_q8[1], &config.control.pid_pitch2elevator, 0.63, COPTER_CONTROL_PERIOD_MS * 0.001);
+	control_fold_rate_pid(&pid_p_rate_fixed, &angle2rate_q8[0], &config.control.pid_roll2aileron, 0.63, COPTER_CONTROL_PERIOD_MS * 0.001);
+	control_fold_rate_pid(&pid_r_rate_fixed, &angle2rate_q8[2], &config.control.pid_heading2roll, 0.001, COPTER_CONTROL_PERIOD_MS * 0.001);
+#endif
+
+#ifdef TECS_ENERGY_CONTROL
+	// Energy-to-throttle loop: proportional slope from the configured
+	// pct/m auto-throttle gain, plus a slow integrator that finds the
+	// real cruise throttle for the conditions - the anti-hunting part.
+	// The integrator is bounded so it alone cannot push past the
+	// configured throttle limits.
+	pid_init(&pid_energy2throttle, 0.0f,
+	         (float)config.control.auto_throttle_p_gain * 0.1f,
+	         (float)config.control.auto_throttle_p_gain * 0.005f,
+	         (float)(config.control.auto_throttle_min_pct - config.control.auto_throttle_cruise_pct),
+	         (float)(config.control.auto_throttle_max_pct - config.control.auto_throttle_cruise_pct),
+	         0.0f);
+#endif
+}
+
+
 /*!
  *    Initializes the control module.
  *    It uses the current RC-transmitter's input to determine the servo's neutral settings.
@@ -70,6 +464,8 @@ void control_init()
 	int i;
 	control_state.simulation_mode = 0;
 
+	control_precompute_mix();
+
 	// Manual trim mode: the servo's neutral settings are defined by the RC-transmitters trim settings. See wiki.
 	if (! config.control.manual_trim)
 	{	
@@ -98,7 +494,7 @@ void control_init()
 		for (i = 0; i < 6; i++)
 			config.control.servo_neutral[i] = servo_out[i];
 			
-		//printf("\r\n<- %d ->\r\n", config.control.servo_neutral[0]);
+		//uart1_printf("\r\n<- %d ->\r\n", config.control.servo_neutral[0]);
 	}
     else // manual trim in gluonconfig
     {
@@ -109,7 +505,41 @@ void control_init()
     }
 	
 	if (config.control.cruising_speed_ms < 0.5)  // not valid? change to 18 to avoid /0
-		config.control.cruising_speed_ms = 18.0;  
+		config.control.cruising_speed_ms = 18.0;
+}
+
+
+/*!
+ *   Waits for the RC-receiver to boot and output pwm pulses. This used to run
+ *   in main() before the scheduler started, stalling the whole boot (and
+ *   after a mid-flight brownout: the recovery) behind a receiver that may
+ *   not even be connected. In task context the sensor, gps and console tasks
+ *   initialize in parallel with the wait.
+ */
+static void control_wait_for_rc()
+{
+	int i;
+	int bp;
+
+	if (! config.control.use_pwm)
+		return;   // a complete ppm frame only takes ~20ms; no use waiting
+
+	bp = bootstats_begin("rc detect");
+	uart1_puts("Waiting for pwm");
+	for (i = 0; i < 150; i++)   // how long a 2.4GHz receiver can take to come online
+	{
+		if (ppm.channel[1] > 800 && ppm.channel[1] < 2200)   // valid signal
+			break;
+		uart1_putc('.');
+		vTaskDelay( ( portTickType ) 25 / portTICK_RATE_MS );
+	}
+	vTaskDelay( ( portTickType ) 40 / portTICK_RATE_MS );   // wait for whole frame to finish (worst case)
+
+	if (! (ppm.channel[0] > 900 && ppm.channel[0] < 2100))
+		uart1_puts("not found!\r\n");
+	else
+		uart1_puts("done\r\n");
+	bootstats_end(bp);
 }
 
 
@@ -121,6 +551,243 @@ void control_init()
  ******************************************************************************/
 
 
+#ifndef ENABLE_QUADROCOPTER
+
+//! Iterations of the timed control-cycle loop in the self-test.
+#define SELFTEST_TIMING_RUNS 100
+
+/*!
+ *   Pre-arm self-test, scheduled over the console with the CP command.
+ *   Sweeps every servo once from servo_min to servo_max and back to
+ *   neutral, watching the battery current sense for an actuation response
+ *   where the board has one (an unloaded or unplugged servo draws no extra
+ *   current). Then times SELFTEST_TIMING_RUNS full control cycles - rc
+ *   decode, sensor snapshot, navigation, pid, mix, servo write - back to
+ *   back and reports the worst case in microseconds next to the 50Hz
+ *   budget: a misconfigured build that runs the loop several times slower
+ *   now fails on the ground instead of in the air. The end-to-end
+ *   sample-to-servo maximum from the latency histograms is checked too,
+ *   since it also covers the sensor task and the scheduler. Refused while
+ *   airborne; the servo sweep keeps feeding the task's heartbeat so the
+ *   watchdog supervision stays honest.
+ */
+static void control_selftest(int hb)
+{
+	unsigned long tref, worst_us = 0, cycle_us;
+	float baseline_a, peak_a, a;
+	int servo, pos, i;
+	int ok = 1;
+
+	if (navigation_data.airborne)
+	{
+		uart1_printf("\r\nSelf-test refused: airborne\r\n");
+		return;
+	}
+
+	uart1_printf("\r\nSelf-test: sweeping servos...\r\n");
+	baseline_a = sensors_battery1_current();
+	for (servo = 0; servo < 6; servo++)
+	{
+		peak_a = baseline_a;
+		for (pos = 0; pos < 2; pos++)
+		{
+			servo_set_us(servo, (unsigned int)(pos == 0 ? config.control.servo_min[servo]
+			                                            : config.control.servo_max[servo]));
+			for (i = 0; i < 5; i++)   // 500ms hold; the current sense updates at 2Hz
+			{
+				vTaskDelay( ( portTickType ) 100 / portTICK_RATE_MS );
+				heartbeat_checkin(hb);
+				a = sensors_battery1_current();
+				if (a > peak_a)
+					peak_a = a;
+			}
+		}
+		servo_set_us(servo, (unsigned int)config.control.servo_neutral[servo]);
+		uart1_printf("Self-test: servo %d swept %d..%dus, current peak +%dmA\r\n",
+		       servo + 1, config.control.servo_min[servo], config.control.servo_max[servo],
+		       (int)((peak_a - baseline_a) * 1000.0f));
+	}
+
+	for (i = 0; i < SELFTEST_TIMING_RUNS; i++)
+	{
+		tref = timer_ticks_32();
+		ppm_in_decode();
+		sensors_get_snapshot(&sensor_snapshot);
+		navigation_dead_reckon(0.020f);
+		control_wing_navigate(0.020f, config.control.stabilization_with_altitude_hold);
+		cycle_us = (unsigned long)(timer_dt_from(&tref) * 1.0e6f);
+		if (cycle_us > worst_us)
+			worst_us = cycle_us;
+		if ((i & 7) == 7)
+			heartbeat_checkin(hb);
+	}
+
+	uart1_printf("Self-test: worst control cycle %luus over %d runs (50Hz budget 20000us)\r\n",
+	       worst_us, SELFTEST_TIMING_RUNS);
+	if (worst_us > 20000ul)
+		ok = 0;
+	if (latency_sample_to_servo.max_us > 0)
+	{
+		uart1_printf("Self-test: worst sample-to-servo latency %luus\r\n", latency_sample_to_servo.max_us);
+		if (latency_sample_to_servo.max_us > 40000ul)   // 2 periods end to end
+			ok = 0;
+	}
+	uart1_printf("Self-test: %s\r\n", ok ? "PASS" : "FAIL");
+}
+
+
+/******************************************************************************
+ *                     Relay-feedback autotune (CT command)                   *
+ ******************************************************************************/
+
+// Relay output amplitude, in the radians the attitude pids command
+// (folded to mixer units by the *630 at the end of the cycle).
+#define AUTOTUNE_RELAY_RAD     0.26f   // ~15 deg of surface
+// Switching hysteresis on the attitude error: rides out attitude noise
+// without distorting the measured period at realistic amplitudes.
+#define AUTOTUNE_HYST_RAD      0.035f  // ~2 deg
+// Half-cycles measured, after the ones discarded while the limit cycle
+// settles from whatever attitude the relay started at.
+#define AUTOTUNE_HALF_CYCLES   12
+#define AUTOTUNE_SKIP_CYCLES   4
+#define AUTOTUNE_TIMEOUT_S     15.0f
+
+//! Axis being tuned: -1 = idle, 0 = roll, 1 = pitch. Owned by the
+//! control task; everything below runs inside the 50Hz cycle.
+static int autotune_axis = -1;
+static int autotune_sign;               // current relay output sign
+static int autotune_halves;             // half-cycles seen, incl. skipped
+static unsigned long autotune_t_switch; // timer capture of the last relay flip
+static float autotune_period_sum;       // measured half-periods, seconds
+static float autotune_peak;             // |error| peak since the last flip
+static float autotune_amp_sum;          // peaks of the measured half-cycles
+static float autotune_elapsed;
+
+static void control_autotune_begin(int axis)
+{
+	autotune_axis = axis;
+	autotune_sign = 1;
+	autotune_halves = 0;
+	autotune_period_sum = 0.0f;
+	autotune_peak = 0.0f;
+	autotune_amp_sum = 0.0f;
+	autotune_elapsed = 0.0f;
+	autotune_t_switch = timer_ticks_32();
+	uart1_printf("\r\nAutotune %s: relay on, hold the other sticks neutral\r\n",
+	       axis == 0 ? "roll" : "pitch");
+}
+
+static void control_autotune_abort(const char *reason)
+{
+	uart1_printf("\r\nAutotune aborted: %s\r\n", reason);
+	autotune_axis = -1;
+}
+
+/*!
+ *   End of a successful run: ultimate gain from the relay describing
+ *   function (Ku = 4d / (pi a)), ultimate period from the averaged
+ *   half-periods, Ziegler-Nichols pid gains from both. The suggestion
+ *   goes through control_stage_pid() into the ram configuration - live
+ *   immediately, gone on reboot - so the pilot accepts it by flying it
+ *   and burning with FC, or rejects it with a power cycle.
+ */
+static void control_autotune_finish()
+{
+	int measured = AUTOTUNE_HALF_CYCLES - AUTOTUNE_SKIP_CYCLES;
+	int axis = autotune_axis;
+	float amp = autotune_amp_sum / (float)measured;
+	float tu = 2.0f * autotune_period_sum / (float)measured;
+	float ku;
+	struct pid suggested;
+
+	autotune_axis = -1;
+	if (amp < 0.01f)   // airframe barely responded; gains would be nonsense
+	{
+		uart1_printf("\r\nAutotune failed: oscillation amplitude too small\r\n");
+		return;
+	}
+	ku = 4.0f * AUTOTUNE_RELAY_RAD / (PI * amp);
+
+	// keep the configured limits, replace the gains (Ziegler-Nichols pid)
+	suggested = (axis == 0) ? config.control.pid_roll2aileron
+	                        : config.control.pid_pitch2elevator;
+	suggested.p_gain = 0.6f * ku;
+	suggested.i_gain = 1.2f * ku / tu;
+	suggested.d_gain = 0.075f * ku * tu;
+	control_stage_pid(axis == 0 ? CONTROL_PID_ROLL : CONTROL_PID_PITCH, &suggested);
+
+	uart1_printf("\r\nAutotune: Ku=%f Tu=%dms -> P=%f I=%f D=%f\r\n",
+	       (double)ku, (int)(tu * 1000.0f),
+	       (double)suggested.p_gain, (double)suggested.i_gain, (double)suggested.d_gain);
+	uart1_printf("Autotune: gains staged in ram; burn with FC to keep them\r\n");
+}
+
+/*!
+ *   One 50Hz step of the relay experiment, called at the end of
+ *   control_wing_desired_to_servos(): overrides the tuned axis with the
+ *   relay output and times the resulting limit cycle on the free-running
+ *   microsecond timer. The pilot keeps the other axis and the throttle;
+ *   flipping the mode switch out of stabilized aborts, as does an
+ *   attitude past 1.5x the configured limit or the timeout.
+ */
+static void control_autotune_step(float dt)
+{
+	float limit = (autotune_axis == 0) ? config.control.max_roll
+	                                   : config.control.max_pitch;
+	float error = (autotune_axis == 0)
+	            ? control_state.desired_roll - sensor_snapshot.roll
+	            : control_state.desired_pitch - sensor_snapshot.pitch;
+	int sign = autotune_sign;
+
+	if (control_state.flight_mode != STABILIZED)
+	{
+		control_autotune_abort("left stabilized mode");
+		return;
+	}
+	if (fabs(error) > limit * 1.5f)
+	{
+		control_autotune_abort("attitude limit");
+		return;
+	}
+	autotune_elapsed += dt;
+	if (autotune_elapsed > AUTOTUNE_TIMEOUT_S)
+	{
+		control_autotune_abort("timeout, no stable oscillation");
+		return;
+	}
+
+	if (fabs(error) > autotune_peak)
+		autotune_peak = fabs(error);
+
+	if (error > AUTOTUNE_HYST_RAD)
+		sign = 1;
+	else if (error < -AUTOTUNE_HYST_RAD)
+		sign = -1;
+	if (sign != autotune_sign)   // relay flips: one half-cycle complete
+	{
+		float half_period = timer_dt_from(&autotune_t_switch);
+		autotune_sign = sign;
+		autotune_halves++;
+		if (autotune_halves > AUTOTUNE_SKIP_CYCLES)
+		{
+			autotune_period_sum += half_period;
+			autotune_amp_sum += autotune_peak;
+		}
+		autotune_peak = 0.0f;
+		if (autotune_halves >= AUTOTUNE_HALF_CYCLES)
+		{
+			control_autotune_finish();
+			return;
+		}
+	}
+
+	if (autotune_axis == 0)
+		aileron_out = autotune_sign * (int)(AUTOTUNE_RELAY_RAD * 630.0f);
+	else
+		elevator_out = autotune_sign * (int)(AUTOTUNE_RELAY_RAD * 630.0f);
+}
+
+
 /*!
  *   FreeRTOS task for fixed wing aircraft (not QUAD mixing)
  *
@@ -131,23 +798,65 @@ void control_wing_task(void *parameters)
 {
 	enum FlightModes lastMode = MANUAL;
     static int i = 0; // for F1E
-	
+	unsigned long dt_ticks;
+	float dt;
+	int hb;
+
 	/* Used to wake the task at the correct frequency. */
-	portTickType xLastExecutionTime; 
+	portTickType xLastExecutionTime;
 
-	uart1_puts("Control task initializing...");	
+	uart1_puts("Control task initializing...");
 	servo_init();
+	control_wait_for_rc();   // control_init() samples the sticks for the neutral values
+	ppm_in_decode();         // freshest RC frame for the neutral sampling
 	control_init();
+	servo_set_highrate_mask((unsigned char)config.control.servo_highrate_mask);
 	uart1_puts("done\r\n");
 
     vTaskSetApplicationTaskTag( NULL, ( void * ) 1 );
 	/* Initialise xLastExecutionTime so the first call to vTaskDelayUntil()	works correctly. */
 	xLastExecutionTime = xTaskGetTickCount();
+	dt_ticks = timer_ticks_32();
+	hb = heartbeat_register("WControl", 20);
 
 	for( ;; )
 	{
 		vTaskDelayUntil( &xLastExecutionTime, ( ( portTickType ) 20 / portTICK_RATE_MS ) );   //!> 50Hz
-		
+		heartbeat_checkin(hb);
+
+		if (selftest_requested)
+		{
+			selftest_requested = 0;
+			control_selftest(hb);   // pre-arm only: servo sweep + loop timing
+			xLastExecutionTime = xTaskGetTickCount();   // the sweep took seconds; no catch-up burst
+		}
+
+		if (staged_pid_target >= 0)
+			control_apply_staged_pid();   // in-flight retune, between cycles
+
+		if (autotune_request >= 0)
+		{
+			// guarded: only starts while flying stabilized on a live RC
+			// link, so the pilot can take the axis back with the mode switch
+			if (control_state.flight_mode == STABILIZED && ppm.connection_alive
+			    && navigation_data.airborne && autotune_axis < 0)
+				control_autotune_begin(autotune_request);
+			else
+				uart1_printf("\r\nAutotune refused: fly stabilized first\r\n");
+			autotune_request = -1;
+		}
+
+		ppm_in_decode();   // pulse widths captured since last loop -> ppm.channel[]
+
+		// Actually elapsed time: under telemetry/logging load the loop can
+		// jitter by several ticks and the PID derivative terms suffer from
+		// an assumed-constant dt.
+		dt = timer_dt_from(&dt_ticks);
+		if (dt < 0.005f || dt > 0.1f)   // scheduler hiccup or timer restart
+			dt = 0.020f;
+
+		sensors_get_snapshot(&sensor_snapshot);
+
 		// Update RC link status
 		if (config.control.use_pwm)
 		{
@@ -166,7 +875,7 @@ void control_wing_task(void *parameters)
 			control_state.flight_mode = AUTOPILOT;
 			
 			if (lastMode != control_state.flight_mode)  // target altitude = altitude when switching from manual to stabilized
-				control_state.desired_altitude = sensor_data.pressure_height;
+				control_state.desired_altitude = sensor_snapshot.pressure_height;
 				
 #ifdef F1E_STEERING  // Add this define for F1E steering mode
 			{
@@ -176,7 +885,7 @@ void control_wing_task(void *parameters)
 					err_heading -= 2.0*PI;
 				else if (err_heading < -3.0)
 					err_heading += 2.0*PI;
-				//printf("\r\n%f\r\n", err_heading);
+				//uart1_printf("\r\n%f\r\n", err_heading);
 				//aileron_out = (int)(pid_update(&config.control.pid_heading2roll, err_heading, 0.02)*630.0);
 				aileron_out *= 2;
 				aileron_out += (int)(pid_update(&config.control.pid_heading2roll, err_heading, 0.02)*630.0);
@@ -193,53 +902,69 @@ void control_wing_task(void *parameters)
 				if (button_down())
 				{
 					sensor_data.gps.speed_ms = config.control.cruising_speed_ms;  // no GPS, so we need a cruising speed for kalman filter
-					//printf("\r\nDesired %d - Actual %d -> %d\r\n", (int)RAD2DEG(navigation_data.desired_heading_rad), (int)RAD2DEG(sensor_data.yaw), servo_out[0]);
+					//uart1_printf("\r\nDesired %d - Actual %d -> %d\r\n", (int)RAD2DEG(navigation_data.desired_heading_rad), (int)RAD2DEG(sensor_data.yaw), servo_out[0]);
 					navigation_data.desired_heading_rad = sensor_data.yaw;
 				}
 				if (i++ % 50 == 0)
 				{
-					printf("\r\nDesired %d - Actual %d -> %d\r\n", (int)RAD2DEG(navigation_data.desired_heading_rad), (int)RAD2DEG(sensor_data.yaw), servo_out[0]);
+					uart1_printf("\r\nDesired %d - Actual %d -> %d\r\n", (int)RAD2DEG(navigation_data.desired_heading_rad), (int)RAD2DEG(sensor_data.yaw), servo_out[0]);
 				}
 			}
-#else	
-				control_wing_navigate(0.020, config.control.stabilization_with_altitude_hold); // stabilized mode as long as navigation isn't available
+#else
+				navigation_dead_reckon(dt);  // keep the cross-track correction moving between GPS fixes
+				control_wing_navigate(dt, config.control.stabilization_with_altitude_hold); // stabilized mode as long as navigation isn't available
 #endif
 		} 
 		else if (ppm.channel[config.control.channel_ap] < 1666)
 		{
 			control_state.flight_mode = STABILIZED;
 			if (lastMode != control_state.flight_mode)  // target altitude = altitude when switching from manual to stabilized
-				control_state.desired_altitude = sensor_data.pressure_height; //home_height + 65.0;
-			control_wing_stabilized(0.020, config.control.stabilization_with_altitude_hold); // stabilized mode
+				control_state.desired_altitude = sensor_snapshot.pressure_height; //home_height + 65.0;
+			control_wing_stabilized(dt, config.control.stabilization_with_altitude_hold); // stabilized mode
 		} 
 		else
 		{
 			control_state.flight_mode = MANUAL;
-			control_wing_manual(); // manual mode	
+			control_wing_manual(); // manual mode
 		}
 		lastMode = control_state.flight_mode;
+
+		datalogger_collect();   // commit this cycle's LogLine into the log ring
+
+		if (control_state.simulation_mode)
+			comm_binary_send_hil_servos();   // this cycle's outputs for the flight-dynamics model
 	}
 }
 
 
+#endif   // !ENABLE_QUADROCOPTER
+
+
 /*!
  *   Reads the input from the RC-transmitter, mixes it and sends it to the servos.
+ *   Both builds need this one: the copter task uses it in manual mode.
  */
 void control_wing_manual()
 {
+	// All sticks from the same frame; reading ppm.channel[] 4 times in a
+	// row can mix 2 frames when the decoder interrupt runs in between.
+	struct ppm_info frame;
+	ppm_in_get_frame(&frame);
+
 	// > 0 => Up
-	elevator_out = ppm.channel[config.control.channel_pitch] - config.control.channel_neutral[config.control.channel_pitch];
+	elevator_out = frame.channel[config.control.channel_pitch] - config.control.channel_neutral[config.control.channel_pitch];
 	// > 0 => Right
-	aileron_out = ppm.channel[config.control.channel_roll] - config.control.channel_neutral[config.control.channel_roll];
+	aileron_out = frame.channel[config.control.channel_roll] - config.control.channel_neutral[config.control.channel_roll];
 	// > 0 => Motor on
-	motor_out = ppm.channel[config.control.channel_motor] - config.control.channel_neutral[config.control.channel_motor];
+	motor_out = frame.channel[config.control.channel_motor] - config.control.channel_neutral[config.control.channel_motor];
 	// > 0 => Right
-	yaw_out = ppm.channel[config.control.channel_yaw] - config.control.channel_neutral[config.control.channel_yaw];
-	
+	yaw_out = frame.channel[config.control.channel_yaw] - config.control.channel_neutral[config.control.channel_yaw];
+
 	control_mix_out();
 }
 
 
+#ifndef ENABLE_QUADROCOPTER
 /*!
  *   The RC-transmitter's sticks define the "desired" attitude. The sensors that define
  *   the module's attitude are used in a PID loop to position the servo's so the
@@ -248,10 +973,10 @@ void control_wing_manual()
 void control_wing_stabilized(float dt, int altitude_hold)
 {
 	control_state.desired_roll = (float)((int)ppm.channel[config.control.channel_roll]
-	                             - config.control.channel_neutral[config.control.channel_roll]) / 500.0 * (config.control.max_roll);
+	                             - config.control.channel_neutral[config.control.channel_roll]) * stick_to_roll;
 
 	control_state.desired_pitch = (float)((int)ppm.channel[config.control.channel_pitch]
-	                              - config.control.channel_neutral[config.control.channel_pitch]) / 500.0 * (config.control.max_pitch);
+	                              - config.control.channel_neutral[config.control.channel_pitch]) * stick_to_pitch;
 
 
 	// Comment this line if you want pitch stabilization instead of altitude hold
@@ -260,10 +985,10 @@ void control_wing_stabilized(float dt, int altitude_hold)
 		if (fabs(control_state.desired_pitch) > (config.control.max_pitch / 5.0)) // elevator stick not in neutral position
 		{
 			// Keep RC-input desired pitch
-			control_state.desired_altitude = sensor_data.pressure_height;  // keep height in case stick goes back to neutral
+			control_state.desired_altitude = sensor_snapshot.pressure_height;  // keep height in case stick goes back to neutral
 		}	
 		else  // altitude hold
-		  control_state.desired_pitch = (control_state.desired_altitude - sensor_data.pressure_height)  / 20.0 * config.control.max_pitch; 
+		  control_state.desired_pitch = (control_state.desired_altitude - sensor_snapshot.pressure_height)  / 20.0 * config.control.max_pitch; 
 	} 
        
 	motor_out = ppm.channel[config.control.channel_motor] - config.control.channel_neutral[config.control.channel_motor];
@@ -272,6 +997,44 @@ void control_wing_stabilized(float dt, int altitude_hold)
 
 
 
+#ifdef TECS_ENERGY_CONTROL
+/*
+ *   Total energy control: normalized by weight, the plane's energy is a
+ *   height, h + V^2/2g, in meters. Throttle is the only way to add
+ *   energy and pitch only trades speed for height, so the loops are
+ *   assigned along those lines: throttle gets the sum of the height and
+ *   speed errors, pitch their difference. The independent pids this
+ *   replaces each saw only half the picture, so the throttle pushed
+ *   against the pitch command and both hunted around the equilibrium.
+ */
+static void control_wing_energy(float dt, float altitude_error)
+{
+	float v = sensor_snapshot.gps.speed_ms;
+	float v_set = (float)config.control.cruising_speed_ms;
+	// speed error expressed in meters of height (V^2 / 2g)
+	float kinetic_error_m = (v_set * v_set - v * v) * (0.5f / G);
+	int target;
+
+	target = config.control.auto_throttle_cruise_pct +
+	         (int)pid_update(&pid_energy2throttle, altitude_error + kinetic_error_m, dt);
+	if (target > config.control.auto_throttle_max_pct)
+		target = config.control.auto_throttle_max_pct;
+	else if (target < config.control.auto_throttle_min_pct)
+		target = config.control.auto_throttle_min_pct;
+
+	if (navigation_data.desired_throttle_pct != -1)  // currently only flare & glide
+		target = navigation_data.desired_throttle_pct;
+
+	motor_out = target * 10;
+
+	// energy balance to pitch, with the existing altitude gains: flying
+	// too slow pushes the nose down even when below the glide path
+	control_state.desired_pitch = pid_update(&config.control.pid_altitude2pitch,
+	                                         altitude_error - kinetic_error_m, dt);
+}
+#endif
+
+
 /*!
  *   The RC-transmitter's sticks define the "desired" attitude. The sensors that define
  *   the module's attitude are used in a PID loop to position the servo's so the
@@ -280,7 +1043,7 @@ void control_wing_stabilized(float dt, int altitude_hold)
 void control_wing_navigate(float dt, int altitude_controllable)
 {
 	/* Calculate desired roll */
-	float heading_error_rad = navigation_data.desired_heading_rad - sensor_data.gps.heading_rad;
+	float heading_error_rad = navigation_data.desired_heading_rad - sensor_snapshot.gps.heading_rad;
 	
 	// Choose shortest turn-direction
 	if (heading_error_rad >= PI)
@@ -294,12 +1057,12 @@ void control_wing_navigate(float dt, int altitude_controllable)
 	
 	// Not enough GPS satellites? Fly flat and hope to get a new lock :-)
 #ifndef F1E_STEERING
-	if (sensor_data.gps.satellites_in_view < 4)
+	if (sensor_snapshot.gps.satellites_in_view < 4)
 		control_state.desired_roll = 0.0;
 #endif
 
 	// from paparazzi
-	/*float speed_depend_nav = sensor_data.gps.speed_ms / config.control.cruising_speed_ms;
+	/*float speed_depend_nav = sensor_snapshot.gps.speed_ms / config.control.cruising_speed_ms;
  	if (speed_depend_nav > 1.3)	{
  		control_state.desired_roll *= 1.3;
  	} else if (speed_depend_nav < 0.8) { // good idea for takeoff?
@@ -315,36 +1078,48 @@ void control_wing_navigate(float dt, int altitude_controllable)
     if (config.control.altitude_mode == GPS_ABSOLUTE)
     {
         control_state.desired_altitude = navigation_data.desired_altitude_agl;
-        altitude_error = control_state.desired_altitude - sensor_data.gps.height_m;
+        altitude_error = control_state.desired_altitude - sensor_snapshot.gps.height_m;
     }
     else if (config.control.altitude_mode == GPS_RELATIVE)
     {
         control_state.desired_altitude = navigation_data.desired_altitude_agl;
-        altitude_error = control_state.desired_altitude  + navigation_data.home_gps_height - sensor_data.gps.height_m;
+        altitude_error = control_state.desired_altitude  + navigation_data.home_gps_height - sensor_snapshot.gps.height_m;
     }
     else //if (config.control.altitude_mode == PRESSURE)
     {
         control_state.desired_altitude = navigation_data.desired_altitude_agl;
-        altitude_error = control_state.desired_altitude  + navigation_data.home_pressure_height - sensor_data.pressure_height;
+        altitude_error = control_state.desired_altitude  + navigation_data.home_pressure_height - sensor_snapshot.pressure_height;
     }
 
+#ifdef TECS_ENERGY_CONTROL
+	if (config.control.autopilot_auto_throttle)
+		control_wing_energy(dt, altitude_error);   // also sets motor_out
+	else   // without throttle authority there is no total energy to manage
+		control_state.desired_pitch = pid_update(&config.control.pid_altitude2pitch,
+		                                         altitude_error, dt);
+#else
     control_state.desired_pitch = pid_update(&config.control.pid_altitude2pitch,
 	                                         altitude_error, dt);
+#endif
 
-	//control_state.desired_pitch = (control_state.desired_height - sensor_data.pressure_height) / 10.0 * config.control.max_pitch; 
+	//control_state.desired_pitch = (control_state.desired_height - sensor_snapshot.pressure_height) / 10.0 * config.control.max_pitch; 
 	
 	if (altitude_controllable)  // control altitude with pitch transmitter stick?
 	{
 		float manual_desired_pitch = (float)((int)ppm.channel[config.control.channel_pitch]
-		                              - config.control.channel_neutral[config.control.channel_pitch]) / 500.0 * (config.control.max_pitch);
+		                              - config.control.channel_neutral[config.control.channel_pitch]) * stick_to_pitch;
 	    if (fabs(manual_desired_pitch) > (config.control.max_pitch / 5.0)) // elevator stick not in neutral position
 	    {
 			control_state.desired_pitch = manual_desired_pitch;
-			control_state.desired_altitude = sensor_data.pressure_height;  // save current height in case stick goes back to neutral
+			control_state.desired_altitude = sensor_snapshot.pressure_height;  // save current height in case stick goes back to neutral
 		}
 	}
 
 	// auto-throttle
+#ifdef TECS_ENERGY_CONTROL
+	if (! config.control.autopilot_auto_throttle)   // with TECS the throttle came out of the energy loop
+		motor_out = ppm.channel[config.control.channel_motor] - config.control.channel_neutral[config.control.channel_motor];
+#else
 	if (config.control.autopilot_auto_throttle)
 	{
 		int d_altitude = (int)altitude_error;
@@ -359,10 +1134,11 @@ void control_wing_navigate(float dt, int altitude_controllable)
 			target = navigation_data.desired_throttle_pct;
 
 		motor_out = /*1000 + */target*10;
-		//printf("\r\n%d = %d + (%d*%d)/10 - %d %d\r\n", target, config.control.auto_throttle_cruise_pct, d_altitude, config.control.auto_throttle_p_gain, (int)control_state.desired_altitude, (int)sensor_data.pressure_height);
+		//uart1_printf("\r\n%d = %d + (%d*%d)/10 - %d %d\r\n", target, config.control.auto_throttle_cruise_pct, d_altitude, config.control.auto_throttle_p_gain, (int)control_state.desired_altitude, (int)sensor_snapshot.pressure_height);
 
 	} else
 		motor_out = ppm.channel[config.control.channel_motor] - config.control.channel_neutral[config.control.channel_motor];
+#endif
 
 	control_wing_desired_to_servos(dt);
 }
@@ -384,22 +1160,22 @@ void control_wing_desired_to_servos(float dt)
 	control_state.desired_roll = MAX(control_state.desired_roll, -config.control.max_roll);
 
 	// compensate the loss in lift
-	//control_state.desired_pitch += (1.0/cosf(sensor_data.roll) - 1.0)*0.25; // (0.5: 12� up at 45� roll)
+	//control_state.desired_pitch += (1.0/cosf(sensor_snapshot.roll) - 1.0)*0.25; // (0.5: 12� up at 45� roll)
 	
 	elevator_out_radians = pid_update(&config.control.pid_pitch2elevator, 
-	                                         control_state.desired_pitch - sensor_data.pitch, dt);
+	                                         control_state.desired_pitch - sensor_snapshot.pitch, dt);
 	aileron_out_radians = pid_update(&config.control.pid_roll2aileron, 
-	                                        control_state.desired_roll - sensor_data.roll, dt);
+	                                        control_state.desired_roll - sensor_snapshot.roll, dt);
 	yaw_out = ppm.channel[config.control.channel_yaw] - config.control.channel_neutral[config.control.channel_yaw];
 
 	
 	// Experimental: when flying with the wind, the elevons become less effective. Avoid have a too large roll angle!
 	// Fixme: gain scheduling depending on V_air
-	/*if (sensor_data.roll > config.control.max_roll)
+	/*if (sensor_snapshot.roll > config.control.max_roll)
 		aileron_out_radians *= 1.2;
-	if (sensor_data.roll < -config.control.max_roll)
+	if (sensor_snapshot.roll < -config.control.max_roll)
 		aileron_out_radians *= 1.2;
-	if (sensor_data.pitch > config.control.max_pitch)
+	if (sensor_snapshot.pitch > config.control.max_pitch)
 		elevator_out_radians *= 1.2;*/
 	
 
@@ -408,8 +1184,14 @@ void control_wing_desired_to_servos(float dt)
 	elevator_out = (int)(elevator_out_radians * 630.0); // +-45� -> +- 500
 	aileron_out = (int)(aileron_out_radians * 630.0);
 
+	if (autotune_axis >= 0)
+		control_autotune_step(dt);   // relay override on the tuned axis
+
 	control_mix_out();
-}	
+}
+
+
+#endif   // !ENABLE_QUADROCOPTER
 
 
 /******************************************************************************
@@ -418,35 +1200,57 @@ void control_wing_desired_to_servos(float dt)
  *                                                                            *
  ******************************************************************************/
 
+#ifdef ENABLE_QUADROCOPTER
 /*!
  *   FreeRTOS task for multicopter aircraft (e.g. QUAD mixing)
  */
 void control_copter_task( void *parameters )
 {
 	enum FlightModes lastMode = MANUAL;
-	
+	unsigned long dt_ticks;
+	float dt;
+	int hb;
+
 	/* Used to wake the task at the correct frequency. */
-	portTickType xLastExecutionTime; 
+	portTickType xLastExecutionTime;
 
 	uart1_puts("Control task initializing...");
-	
+
 	servo_init();
+	control_wait_for_rc();   // control_init() samples the sticks for the neutral values
+	ppm_in_decode();         // freshest RC frame for the neutral sampling
 	control_init();
 
     vTaskSetApplicationTaskTag( NULL, ( void * ) 1 );
 	vTaskDelayUntil( &xLastExecutionTime, ( ( portTickType ) 1000 / portTICK_RATE_MS ) );
-	servo_turbopwm();
+	// ESCs have seen a second of normal frames by now; switch the motor
+	// channels to the 400Hz frame so they pick up every 250Hz command
+	servo_set_highrate_mask((unsigned char)config.control.servo_highrate_mask);
 	int i = 0;
 
 	uart1_puts("done\r\n");
 	
 	/* Initialise xLastExecutionTime so the first call to vTaskDelayUntil()	works correctly. */
 	xLastExecutionTime = xTaskGetTickCount();
+	dt_ticks = timer_ticks_32();
+	hb = heartbeat_register("CControl", COPTER_CONTROL_PERIOD_MS);
 
 	for( ;; )
 	{
-		vTaskDelayUntil( &xLastExecutionTime, ( ( portTickType ) 4 / portTICK_RATE_MS ) );    //!> 250Hz
-	
+		vTaskDelayUntil( &xLastExecutionTime, ( ( portTickType ) COPTER_CONTROL_PERIOD_MS / portTICK_RATE_MS ) );    //!> 250Hz (500Hz with COPTER_CONTROL_500HZ)
+		heartbeat_checkin(hb);
+
+		if (staged_pid_target >= 0)
+			control_apply_staged_pid();   // in-flight retune, between cycles
+
+		ppm_in_decode();   // pulse widths captured since last loop -> ppm.channel[]
+
+		dt = timer_dt_from(&dt_ticks);
+		if (dt < 0.001f || dt > 0.1f)   // scheduler hiccup or timer restart
+			dt = 0.004f;
+
+		sensors_get_snapshot(&sensor_snapshot);
+
 		if (i++ == 5)
 			ppm_in_update_status_ticks_50hz();
 
@@ -456,22 +1260,27 @@ void control_copter_task( void *parameters )
 			
 			//control_state.desired_height = home_height + 65.0;
 			if (lastMode != control_state.flight_mode)  // target altitude = altitude when switching from manual to stabilized
-				control_state.desired_altitude = sensor_data.pressure_height;
+				control_state.desired_altitude = sensor_snapshot.pressure_height;
 				
 			//control_navigate(0.004, config.control.stabilization_with_altitude_hold); // stabilized mode as long as navigation isn't available
 		} 
 		else if (ppm.channel[config.control.channel_ap] < 1666)
 		{
 			control_state.flight_mode = STABILIZED;
-			control_copter_stabilized(0.004, 0); // stabilized mode
+			control_copter_stabilized(dt, 0); // stabilized mode
 		} 
 		else
 		{
 			control_state.flight_mode = MANUAL;
 			control_wing_manual(); // manual mode
-			
+
 		}
 		lastMode = control_state.flight_mode;
+
+		datalogger_collect();   // commit this cycle's LogLine into the log ring
+
+		if (control_state.simulation_mode)
+			comm_binary_send_hil_servos();   // this cycle's outputs for the flight-dynamics model
 	}
 }
 
@@ -484,10 +1293,10 @@ void control_copter_task( void *parameters )
 void control_copter_stabilized(float dt, int altitude_hold)
 {
 	control_state.desired_roll = (float)((int)ppm.channel[config.control.channel_roll]
-	                             - config.control.channel_neutral[config.control.channel_roll]) / 500.0 * (config.control.max_roll);
+	                             - config.control.channel_neutral[config.control.channel_roll]) * stick_to_roll;
 
 	control_state.desired_pitch = (float)((int)ppm.channel[config.control.channel_pitch]
-	                              - config.control.channel_neutral[config.control.channel_pitch]) / 500.0 * (config.control.max_pitch);
+	                              - config.control.channel_neutral[config.control.channel_pitch]) * stick_to_pitch;
 
 
 
@@ -497,10 +1306,10 @@ void control_copter_stabilized(float dt, int altitude_hold)
 		if (fabs(control_state.desired_pitch) > (config.control.max_pitch / 5.0)) // elevator stick not in neutral position
 		{
 			// Keep RC-input desired pitch
-			control_state.desired_altitude = sensor_data.pressure_height;  // keep height in case stick goes back to neutral
+			control_state.desired_altitude = sensor_snapshot.pressure_height;  // keep height in case stick goes back to neutral
 		}	
 		else  // altitude hold
-		  control_state.desired_pitch = (control_state.desired_altitude - sensor_data.pressure_height)  / 20.0 * config.control.max_pitch; 
+		  control_state.desired_pitch = (control_state.desired_altitude - sensor_snapshot.pressure_height)  / 20.0 * config.control.max_pitch; 
 	} */
 
 	control_copter_desired_to_servos(dt);
@@ -513,13 +1322,17 @@ void control_copter_stabilized(float dt, int altitude_hold)
  */
 void control_copter_desired_to_servos(float dt)
 {
+#ifndef COPTER_PID_FIXED
 	float elevator_out_radians,
-	      aileron_out_radians;     
+	      aileron_out_radians;
+#else
+	static int angle_pass = 0;   // the angle loop runs on every 2nd cycle
+#endif
 	static float desired_yaw = 0.0;
 	
 	motor_out = ppm.channel[config.control.channel_motor] - config.control.channel_neutral[config.control.channel_motor];	
 	if (motor_out < 100)  // when the quad is on the ground, keep this yaw angle when taking off
-		desired_yaw = sensor_data.yaw;
+		desired_yaw = sensor_snapshot.yaw;
 	
 	// Keep pitch & roll within limits
 	control_state.desired_pitch = MIN(control_state.desired_pitch, config.control.max_pitch);
@@ -527,11 +1340,29 @@ void control_copter_desired_to_servos(float dt)
 	control_state.desired_roll = MIN(control_state.desired_roll, config.control.max_roll);
 	control_state.desired_roll = MAX(control_state.desired_roll, -config.control.max_roll);
 
+#ifdef COPTER_PID_FIXED
+	// Half-rate angle pass: attitude error -> body-rate setpoints. The
+	// rate loops below run every cycle on the gyro axes, which are a
+	// sensor cycle fresher than the filtered attitude they feed.
+	angle_pass ^= 1;
+	if (angle_pass)
+	{
+		rate_sp_q = (int)(((long)(int)((control_state.desired_pitch - sensor_snapshot.pitch) * 1000.0) * angle2rate_q8[1]) >> 8);
+		rate_sp_p = (int)(((long)(int)((control_state.desired_roll - sensor_snapshot.roll) * 1000.0) * angle2rate_q8[0]) >> 8);
+		rate_sp_q = MAX(MIN(rate_sp_q, COPTER_MAX_RATE_MRAD_S), -COPTER_MAX_RATE_MRAD_S);
+		rate_sp_p = MAX(MIN(rate_sp_p, COPTER_MAX_RATE_MRAD_S), -COPTER_MAX_RATE_MRAD_S);
+	}
+	elevator_out = pid_fixed_update(&pid_q_rate_fixed,
+	                                rate_sp_q - (int)(sensor_snapshot.q * 1000.0));
+	aileron_out = pid_fixed_update(&pid_p_rate_fixed,
+	                               rate_sp_p - (int)(sensor_snapshot.p * 1000.0));
+#else
 	elevator_out_radians = pid_update(&config.control.pid_pitch2elevator, 
-	                                   control_state.desired_pitch - sensor_data.pitch, dt);
+	                                   control_state.desired_pitch - sensor_snapshot.pitch, dt);
 	
 	aileron_out_radians = pid_update(&config.control.pid_roll2aileron, 
-	                                  control_state.desired_roll - sensor_data.roll, dt);
+	                                  control_state.desired_roll - sensor_snapshot.roll, dt);
+#endif
 	
 	float desired_yaw_rate  = (float)((int)ppm.channel[config.control.channel_yaw]
 		                            - config.control.channel_neutral[config.control.channel_yaw]) / 500.0 * (DEG2RAD(30.0)); // max 30�/s
@@ -544,16 +1375,37 @@ void control_copter_desired_to_servos(float dt)
 	if (desired_yaw < -DEG2RAD(360.0))
 		desired_yaw	 += DEG2RAD(360.0);
 	
-	yaw_out = pid_update(&config.control.pid_heading2roll, desired_yaw - sensor_data.yaw, dt);
+#ifdef COPTER_PID_FIXED
+	// Yaw angle pass: the commanded rate feeds the setpoint directly, so
+	// the stick feedforward happens inside the cascade instead of being
+	// patched onto the output.
+	if (angle_pass)
+	{
+		rate_sp_r = (int)(((long)(int)((desired_yaw - sensor_snapshot.yaw) * 1000.0) * angle2rate_q8[2]) >> 8)
+		          + (int)(desired_yaw_rate * 1000.0);
+		rate_sp_r = MAX(MIN(rate_sp_r, COPTER_MAX_RATE_MRAD_S), -COPTER_MAX_RATE_MRAD_S);
+	}
+	yaw_out = pid_fixed_update(&pid_r_rate_fixed,
+	                           rate_sp_r - (int)(sensor_snapshot.r * 1000.0));
+#else
+	yaw_out = pid_update(&config.control.pid_heading2roll, desired_yaw - sensor_snapshot.yaw, dt);
 
 	yaw_out = MAX(yaw_out, -800);
 	yaw_out = MIN(yaw_out, 800);	
 
-	elevator_out = (int)(elevator_out_radians * 630.0); // +-45� -> +- 500
+	elevator_out = (int)(elevator_out_radians * 630.0); // +-45 deg -> +- 500
 	aileron_out = (int)(aileron_out_radians * 630.0);
+#endif
+
+#ifndef COPTER_PID_FIXED
+	yaw_out += (int)(desired_yaw_rate * COPTER_YAW_FF_GAIN);   // feedforward
+#endif
+	yaw_out = MAX(yaw_out, -800);
+	yaw_out = MIN(yaw_out, 800);
 
 	control_mix_out();
 }	
+#endif   // ENABLE_QUADROCOPTER
 
 
 
@@ -562,204 +1414,72 @@ void control_copter_desired_to_servos(float dt)
 
 
 /*!
- *   Mixes variables aileron_out and elevator_out into correct servo positions, according to the configured mixing type.
- * 
- *   Input: 
+ *   Mixes variables aileron_out and elevator_out into correct servo positions,
+ *   by running every servo through its precompiled mixer row.
+ *
+ *   Input:
  *      aileron_out: > 0 means right [-500..500]
  *      elevator_out: > 0 means up   [-500..500]
  *      motor_out: > 0 means on/more gas [0..1000]
  *
+ *   Per servo this is one short multiply-accumulate over the input vector,
+ *   the same cost for every airframe; all the branching happened in
+ *   control_build_mix_rows() at configuration time.
  */
 void control_mix_out()
 {
-	int i;
-	int aileron_out_left, aileron_out_right;
-	int number_of_controlled_channels = 4;
-	
-	// aileron differential
+	int i, j;
+	int in[MIX_INPUTS];
+	long acc;
+
+#ifdef ENABLE_QUADROCOPTER
+	// motors get the full deflection; differential is a control-surface thing
+	in[MIX_AILERON_RIGHT] = aileron_out;
+	in[MIX_AILERON_LEFT] = aileron_out;
+#else
+	// aileron differential, with the differential/10 factor folded into a Q8 multiplier
+	int aileron_diff = (int)(((long)aileron_out * aileron_diff_q8) >> 8);
 	if (aileron_out > 0)
 	{
-		aileron_out_right = aileron_out + (aileron_out / 10) * config.control.aileron_differential;
-		aileron_out_left = aileron_out - (aileron_out / 10) * config.control.aileron_differential;
-	} 
+		in[MIX_AILERON_RIGHT] = aileron_out + aileron_diff;
+		in[MIX_AILERON_LEFT] = aileron_out - aileron_diff;
+	}
 	else
 	{
-		aileron_out_right = aileron_out - (aileron_out / 10) * config.control.aileron_differential;
-		aileron_out_left = aileron_out + (aileron_out / 10) * config.control.aileron_differential;		
+		in[MIX_AILERON_RIGHT] = aileron_out - aileron_diff;
+		in[MIX_AILERON_LEFT] = aileron_out + aileron_diff;
 	}
-	
-	// no differential
-	//aileron_out_right = aileron_out;
-	//aileron_out_left = aileron_out;
-		
-	
-	switch(config.control.servo_mix)
-	{
-		case DELTA_PLUS:
-			number_of_controlled_channels = 5;
-            if (config.control.reverse_servo5)
-				servo_out[4] = (int)(-sensor_data.roll*636.0) + 1500;//config.control.servo_neutral[6];
-			else
-				servo_out[4] = +(int)(sensor_data.roll*636.0) + 1500;//config.control.servo_neutral[6];
-				
-			if (config.control.reverse_servo1)
-				servo_out[0] = +aileron_out_right + elevator_out + config.control.servo_neutral[0];
-			else
-				servo_out[0] = -aileron_out_right - elevator_out + config.control.servo_neutral[0];
-				
-			if (config.control.reverse_servo2)
-				servo_out[1] = +aileron_out_left - elevator_out + config.control.servo_neutral[1];
-			else
-				servo_out[1] = -aileron_out_left + elevator_out + config.control.servo_neutral[1];
-				
-			if (config.control.reverse_servo4)
-				servo_out[3] = -motor_out + config.control.servo_neutral[3];
-			else 
-				servo_out[3] = motor_out + config.control.servo_neutral[3];
-
-			break;
-		case DELTA_MIN:
-			number_of_controlled_channels = 5;
-            if (config.control.reverse_servo5)
-				servo_out[4] = (int)(-sensor_data.roll*636.0) + 1500;//config.control.servo_neutral[6];
-			else
-				servo_out[4] = +(int)(sensor_data.roll*636.0) + 1500;//config.control.servo_neutral[6];
-				
-			if (config.control.reverse_servo1)
-				servo_out[0] = +aileron_out_right - elevator_out + config.control.servo_neutral[0];
-			else
-				servo_out[0] = -aileron_out_right + elevator_out + config.control.servo_neutral[0];
-				
-			if (config.control.reverse_servo2)
-				servo_out[1] = +aileron_out_left + elevator_out + config.control.servo_neutral[1];
-			else
-				servo_out[1] = -aileron_out_left - elevator_out + config.control.servo_neutral[1];
-			
-			if (config.control.reverse_servo4)
-				servo_out[3] = -motor_out + config.control.servo_neutral[3];
-			else 
-				servo_out[3] = motor_out + config.control.servo_neutral[3];
-
-			break;
-		case QUADROCOPTER:
-		{
-			number_of_controlled_channels = 4;
-			/*          >
-			 *          0
-			 *      < /   \ <
-			 *      3       1        FRONT
-			 *        \ > /
-			 *          2
-			 *    
-			 */
-			
-			/*if (motor_out < 100) // about zero throttle
-			{
-				servo_out[0] = config.control.servo_neutral[3];
-				servo_out[1] = config.control.servo_neutral[3];
-				servo_out[2] = config.control.servo_neutral[3];
-				servo_out[3] = config.control.servo_neutral[3];
-			} 
-			else*/
-			{	
-				// channel[motor] neutral = 1200
-				// servo_neutral(init) = 1500
-				// motor_out(init) = 1200 - 1500 = -300 -> in mix -> 
-				// servo_neutral(mix) = 1200
-				
-				// P:0.4 (convergeert traag), D: 0.45 (0.6 oscilleert)
-
-				servo_out[0] = motor_out + aileron_out/5 + yaw_out/5 + config.control.servo_neutral[0];
-				servo_out[1] = motor_out + elevator_out/5 - yaw_out/5 + config.control.servo_neutral[1];
-				servo_out[2] = motor_out - aileron_out/5  + yaw_out/5 + config.control.servo_neutral[2];
-				servo_out[3] = motor_out - elevator_out/5 - yaw_out/5 + config.control.servo_neutral[3];
-				//safety:
-				if (motor_out < 100)
-				{
-					servo_out[0] = 0;
-					servo_out[1] = 0;
-					servo_out[2] = 0;
-					servo_out[3] = 0;
-				}	
-			}
-			break;
-		}	
-		case AILERONS_FLAPERONS:
-			number_of_controlled_channels = 6;
-            if (config.control.reverse_servo6)
-				servo_out[5] = (int)(-sensor_data.roll*636.0) + 1500;//config.control.servo_neutral[6];
-			else
-				servo_out[5] = +(int)(sensor_data.roll*636.0) + 1500;//config.control.servo_neutral[6];
-
-			if (config.control.reverse_servo1)
-				servo_out[0] = -aileron_out_right + config.control.servo_neutral[0] + ppm.channel[config.control.channel_yaw] - config.control.channel_neutral[config.control.channel_yaw];
-			else
-				servo_out[0] = +aileron_out_right + config.control.servo_neutral[0] - ppm.channel[config.control.channel_yaw] + config.control.channel_neutral[config.control.channel_yaw];
-
-			if (config.control.reverse_servo2)
-				servo_out[1] = +aileron_out_left + config.control.servo_neutral[1] + ppm.channel[config.control.channel_yaw] - config.control.channel_neutral[config.control.channel_yaw];
-			else
-				servo_out[1] = -aileron_out_left + config.control.servo_neutral[1] - ppm.channel[config.control.channel_yaw] + config.control.channel_neutral[config.control.channel_yaw];
-				
-			if (config.control.reverse_servo3)
-				servo_out[2] = -elevator_out + config.control.servo_neutral[2];
-			else
-				servo_out[2] = elevator_out + config.control.servo_neutral[2];
-				
-			if (config.control.reverse_servo4)
-				servo_out[3] = -motor_out + config.control.servo_neutral[3];
-			else
-				servo_out[3] = motor_out + config.control.servo_neutral[3];
-			
-			if (config.control.reverse_servo5)
-				servo_out[4] = +yaw_out + config.control.servo_neutral[4];
-			else 
-				servo_out[4] = -yaw_out + config.control.servo_neutral[4];
-
-			break;
-		default:  // aileron
-			number_of_controlled_channels = 6;
-            if (config.control.reverse_servo6)
-				servo_out[5] = (int)(-sensor_data.roll*636.0) + 1500;//config.control.servo_neutral[6];
-			else
-				servo_out[5] = +(int)(sensor_data.roll*636.0) + 1500;//config.control.servo_neutral[6];
-
-			if (config.control.reverse_servo1)
-				servo_out[0] = -aileron_out_right + config.control.servo_neutral[0];
-			else
-				servo_out[0] = +aileron_out_right + config.control.servo_neutral[0];
-				
-			if (config.control.reverse_servo2)
-				servo_out[1] = +aileron_out_left + config.control.servo_neutral[1];
-			else
-				servo_out[1] = -aileron_out_left + config.control.servo_neutral[1];
-				
-			if (config.control.reverse_servo3)
-				servo_out[2] = -elevator_out + config.control.servo_neutral[2];
-			else
-				servo_out[2] = elevator_out + config.control.servo_neutral[2];
-				
-			if (config.control.reverse_servo4)
-				servo_out[3] = -motor_out + config.control.servo_neutral[3];
-			else
-				servo_out[3] = motor_out + config.control.servo_neutral[3];
-			
-			if (config.control.reverse_servo5)
-				servo_out[4] = +yaw_out + config.control.servo_neutral[4];
-			else 
-				servo_out[4] = -yaw_out + config.control.servo_neutral[4];
+#endif
+	in[MIX_ELEVATOR] = elevator_out;
+	in[MIX_YAW] = yaw_out;
+	in[MIX_MOTOR] = motor_out;
+	in[MIX_CAM_ROLL] = (int)(sensor_snapshot.roll * 636.0);
 
-			break;
+	for (i = 0; i < mix_channels; i++)
+	{
+		acc = 0;
+		for (j = 0; j < MIX_INPUTS; j++)
+			acc += (long)mix_row[i].coef[j] * in[j];   // mul.ss + 32-bit add per term
+		servo_out[i] = (int)(acc >> 8) + (mix_row[i].cam_servo ? 1500 : config.control.servo_neutral[i]);
 	}
 
-	
-	for(i = 0; i < number_of_controlled_channels; i++)
-	{	
+#ifdef ENABLE_QUADROCOPTER
+	//safety: throttle closed means every motor stops dead
+	if (motor_out < 100)
+		for (i = 0; i < mix_channels; i++)
+			servo_out[i] = 0;
+#endif
+
+	for (i = 0; i < mix_channels; i++)
+	{
 		if (servo_out[i] > config.control.servo_max[i])
 			servo_out[i] = config.control.servo_max[i];
 		if (servo_out[i] < config.control.servo_min[i])
 			servo_out[i] = config.control.servo_min[i];
 
-		servo_set_us(i, servo_out[i]);
+		servo_stage_us(i, servo_out[i]);
 	}
+	servo_commit();   // all channels latch into the same output frame
+
+	latency_mark_servo();   // commands are in the servo registers; sample-to-servo latency ends here
 }
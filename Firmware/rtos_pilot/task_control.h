@@ -4,12 +4,16 @@
 #include "pid/pid.h"
 
 
-enum MixTypes { AILERON = 0, DELTA_PLUS = 1, DELTA_MIN = 2, QUADROCOPTER  = 3, AILERONS_FLAPERONS = 4};
+enum MixTypes { AILERON = 0, DELTA_PLUS = 1, DELTA_MIN = 2, QUADROCOPTER  = 3, AILERONS_FLAPERONS = 4, HEXACOPTER = 5, VTAIL = 6};
 
 enum FlightModes { MANUAL = 0, STABILIZED = 1, AUTOPILOT = 2, LOITER = 3, RTL = 4};
 
 enum AltitudeModes { PRESSURE = 1, GPS_ABSOLUTE = 2, GPS_RELATIVE = 3 };
 
+//! Targets for control_stage_pid(), one per pid struct in ControlConfig.
+enum ControlPids { CONTROL_PID_ROLL = 0, CONTROL_PID_PITCH = 1,
+                   CONTROL_PID_HEADING = 2, CONTROL_PID_ALTITUDE = 3 };
+
 struct ControlState
 {
 	enum FlightModes flight_mode;
@@ -71,11 +75,35 @@ struct ControlConfig
     int auto_throttle_p_gain; // pct/m
 
     enum AltitudeModes altitude_mode;
+
+    //! Since 0.9: channels pulsed at 400Hz frames (bit 0 = servo 0).
+    //! Motor ESCs go here; gimbal/analog servos stay outside at 50Hz.
+    unsigned int servo_highrate_mask;
 };	
 
 
 void control_init();
 
+//! Re-folds the mix coefficients (servo direction, aileron differential,
+//! stick scales) out of the configuration; call after changing it.
+void control_precompute_mix();
+
+//! Schedules the pre-arm self-test (CP console command); the fixed-wing
+//! control task runs it at the top of its next cycle and reports.
+void control_request_selftest();
+
+//! Schedules the relay-feedback autotune of one axis (CT console command,
+//! 0 = roll, 1 = pitch). The fixed-wing control task runs the relay
+//! experiment inside its stabilized loop and stages the suggested gains
+//! in ram for the pilot to accept; see task_control.c.
+void control_request_autotune(int axis);
+
+//! Stages new gains for one of the ControlConfig pid structs (PP/PR/PH/PA
+//! console commands). The control task copies them into the configuration
+//! and refolds at its next loop boundary, so a control cycle never sees a
+//! half-applied gain set; nothing here touches flash (FC persists, later).
+void control_stage_pid(enum ControlPids target, struct pid *gains);
+
 void control_copter_task( void *pvParameters );
 void control_wing_task( void *pvParameters );
 
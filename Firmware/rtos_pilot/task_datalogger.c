@@ -5,7 +5,7 @@
  *    |  Configuration  | Index+1| Logging .................|
  *     
  *     Logging page=    
- *    [ 2Bytes: index number (0 = unused) | Bytes 3...528: Array of LogLines.... ]
+ *    [ 2Bytes: index number (0 = unused) | Bytes 3...PAGE_SIZE: Array of LogLines.... ]
  *
  */
  
@@ -20,21 +20,33 @@
 #include "FreeRTOS/semphr.h"
 
 #include "microcontroller/microcontroller.h"
+#include "timer/timer.h"
+#include "pps/pps.h"
+#include "microcontroller/spi_bus.h"
 #include "dataflash/dataflash.h"
 #include "uart1_queue/uart1_queue.h"
 
 #include "task_datalogger.h"
+#include "configuration.h"
+#include "communication_binary.h"
 #include "sensors.h"
 #include "task_control.h"
 #include "gluonscript.h"
+#include "cpuload.h"
+#include "ahrs.h"
 #include "handler_navigation.h"
 #include "handler_trigger.h"
+#include "heartbeat.h"
+#include "gyrocapture.h"
 #include "common.h"
 
 
 struct LogIndex datalogger_index_table[MAX_INDEX];
 
-unsigned char buffer[528];  // WARNING: won't work with AT45DB321
+// One dataflash page, allocated in datalogger_init() once dataflash_open()
+// has published the chip geometry: 528 bytes on the 16/32Mbit chips, 1056
+// on the 64Mbit AT45DB642. heap_1 never frees, so it is allocated once.
+unsigned char *buffer = 0;
 
 
 int current_page;
@@ -42,87 +54,140 @@ int current_index = 0;
 
 int disable_logging = 0; // used when reading out data
 
+// Or-ed into the 2-byte page index word when the page holds delta-compressed
+// records (see LOG_DELTA_FORMAT in task_datalogger.h); raw pages written by
+// older firmware keep reading out unchanged.
+#define LOG_PAGE_DELTA_FLAG 0x4000
+// Or-ed into the index word when the header carries a 32-bit page sequence
+// number; pages written by pre-sequence firmware lack it and read as sequence 0.
+#define LOG_PAGE_SEQ_FLAG   0x2000
+// Or-ed into the index word when the page holds raw 1kHz gyro capture samples
+// (gyrocapture.c) instead of LogLines; the LogLine readouts skip such pages,
+// they are fetched with the raw bulk-read protocol.
+#define LOG_PAGE_GYRO_FLAG  0x1000
+#define LOG_PAGE_INDEX(x)   ((x) & ~(LOG_PAGE_DELTA_FLAG | LOG_PAGE_SEQ_FLAG | LOG_PAGE_GYRO_FLAG))
+#ifdef LOG_DELTA_FORMAT
+#define LOG_PAGE_SEQ_AT     4    // the delta record count keeps living at [2]
+#else
+#define LOG_PAGE_SEQ_AT     2
+#endif
+#define LOG_RAW_LINES_AT    6    // raw LogLines start after index word + sequence
+
+// Sequence number the next written log page gets. Strictly increasing over
+// the lifetime of the flash (32 bits outlive the chip), which is what lets
+// datalogger_init() binary-search for the write frontier instead of scanning.
+unsigned long log_sequence = 1;
+
+int log_highrate = 0;    // 1: log attitude/gyro/servo at 50Hz, see datalogger_set_highrate()
+
+// Erase-ahead state (see datalogger_erase_ahead): the pages from current_page
+// up to (not including) erase_ahead_page have been pre-erased, so log writes
+// there can take the fast program-without-erase path.
+#define ERASE_AHEAD_WINDOW 8
+int erase_ahead_page = -1;   // first page not yet pre-erased; -1 until datalogger_init() ran
+
 
-xSemaphoreHandle xSpiSemaphore;
 void datalogger_read(int page, int size, unsigned char *buffer);
 void datalogger_write(int page, int size, unsigned char *buffer);
+void datalogger_write_pingpong(int page, int size, unsigned char *buffer);
+void datalogger_write_pingpong_noerase(int page, int size, unsigned char *buffer);
+void datalogger_write_current_page();
+void datalogger_write_page_buffer(unsigned char *page_buffer);
+static void datalogger_capture_drain();
+void datalogger_erase_ahead();
+int log_page_distance(int from, int to);
+unsigned long log_page_sequence(int page);
+
+/*!
+ *   Sequence number of a log page; 0 when the page is blank, pre-erased or
+ *   written by pre-sequence firmware (no LOG_PAGE_SEQ_FLAG in the header).
+ */
+unsigned long log_page_sequence(int page)
+{
+	int *hdr = (int*) &(buffer[0]);
+	unsigned long *seq = (unsigned long*) &(buffer[LOG_PAGE_SEQ_AT]);
+
+	datalogger_read(page, LOG_PAGE_SEQ_AT + 4, buffer);
+	if (*hdr == -1 || ! (*hdr & LOG_PAGE_SEQ_FLAG))
+		return 0;
+	return *seq;
+}
+
 
 /*!
  *   Initializes the datalogging (to dataflash) functionality.
  *
- *   First the current index page is read out.
- *   Then we look for the oldest index. 
- *   Then we look for the youngest page
- *   Then we take the first page after the youngest page, that is not from the youngest index
+ *   The index entry with the lowest session sequence (0 = unused) is the one
+ *   we recycle. The first page to write is found with a binary search: pages
+ *   are written in circular order with a strictly increasing sequence number,
+ *   so the sequences form one increasing run from START_LOG_PAGE up to the
+ *   youngest page, and everything behind the frontier (previous lap,
+ *   pre-erased or blank) is smaller. ~12 page reads on a full 4096-page
+ *   flash, where the old date-compare scan read up to every page.
  */
 void datalogger_init()
 {
-	int i, start_page = START_LOG_PAGE, last_index = -1;
-	unsigned long date2 = 0xFFFFFFFF;
-	unsigned long date;
+	int i, lo, hi, mid;
+	int *index;
+	unsigned long seq, seq_oldest = 0xFFFFFFFF, seq_youngest = 0;
 	
+	if (buffer == 0)
+		buffer = (unsigned char*) pvPortMalloc(PAGE_SIZE);
+
 	current_page = START_LOG_PAGE;
+	log_sequence = 1;
 	
-	//printf("formatting...");
+	//uart1_printf("formatting...");
 	//datalogger_format();
-	//printf("done");
+	//uart1_printf("done");
 	
 	// read index page
 	datalogger_read(LOG_INDEX_PAGE, sizeof(struct LogIndex) * MAX_INDEX, (unsigned char*)datalogger_index_table);
 	
-	// find the index with the oldest date: date
 	for (i = 0; i < MAX_INDEX; i++)
 	{
-		date = (datalogger_index_table[i].date % 100) * 100000000 + 
-		       ((datalogger_index_table[i].date % 10000) / 100) * 1000000 + 
-		       ((datalogger_index_table[i].date / 10000) * 10000) +
-		       datalogger_index_table[i].time / 100;
-		if (date < date2)
+		if (datalogger_index_table[i].sequence < seq_oldest)
 		{
-			date2 = date;
-			//start_page = datalogger_index_table[i].page_num + 1;
+			seq_oldest = datalogger_index_table[i].sequence;
 			current_index = (i)%MAX_INDEX + 1;
 		}
+		if (datalogger_index_table[i].sequence > seq_youngest)
+			seq_youngest = datalogger_index_table[i].sequence;
 	}
 	
-	// find the index with the youngest date: we need to find the first available page after the one used by the youngest index
-	date2 = 0;
-	for (i = 0; i < MAX_INDEX; i++)
+	seq = log_page_sequence(START_LOG_PAGE);
+	if (seq == 0)
 	{
-		date = (datalogger_index_table[i].date % 100) * 100000000 + 
-		       ((datalogger_index_table[i].date % 10000) / 100) * 1000000 + 
-		       ((datalogger_index_table[i].date / 10000) * 10000) +
-		       datalogger_index_table[i].time / 100;
-		if (date > date2)
-		{
-			date2 = date;
-			start_page = datalogger_index_table[i].page_num + 1;
-		}
-	}	
-	
-	if (start_page < START_LOG_PAGE)  // possible after a format
-		start_page = START_LOG_PAGE;
-
-	// Lets find the first page	that is
-	//    - 0: not been written yet: OK
-	//    - (current index) = page written by this index: the previous index didn't overwrite it: OK
-	//    - A change in index: this is the one we will need to sacrifice...
-	for (i = start_page; i < MAX_PAGE; i++)
-	{
-		int *index;
-		datalogger_read(i, 4, buffer);
-		index = (int*) &(buffer[0]);
-		if (*index == 0 || *index == (current_index) || (*index != last_index && last_index > 0))
+		current_page = START_LOG_PAGE;   // blank flash, or only pre-sequence logs
+	}
+	else
+	{
+		// find the last page of the increasing run that starts at START_LOG_PAGE
+		lo = START_LOG_PAGE;
+		hi = MAX_PAGE - 1;
+		while (lo < hi)
 		{
-			current_page = i;
-			*index = (current_index); // buffer[0] + [1] contains current_index + 1
-			break;
+			mid = lo + (hi - lo + 1) / 2;
+			if (log_page_sequence(mid) >= seq)
+				lo = mid;
+			else
+				hi = mid - 1;
 		}
-		last_index = *index;
+		log_sequence = log_page_sequence(lo) + 1;
+		current_page = lo + 1;
+		if (current_page >= MAX_PAGE)
+			current_page = START_LOG_PAGE;
 	}
+	if (log_sequence <= seq_youngest)   // an indexed session whose pages were overwritten already
+		log_sequence = seq_youngest + 1;
+
+	// prime the header word of the first raw page (see datalogger_writeline)
+	index = (int*) &(buffer[0]);
+	*index = current_index | LOG_PAGE_SEQ_FLAG;
 
+	erase_ahead_page = current_page;   // the eraser starts right where the writer starts
     
-	//printf("index %d , page %d\r\n", current_index, current_page);
+	//uart1_printf("index %d , page %d, sequence %lu\r\n", current_index, current_page, log_sequence);
 }
 
 
@@ -133,6 +198,7 @@ void datalogger_start_session()
 {	
 	// update the index
 	datalogger_index_table[current_index - 1].page_num = current_page;
+	datalogger_index_table[current_index - 1].sequence = log_sequence;
 	if (control_state.simulation_mode)
 	{
 		// set using Enable Simulation command
@@ -145,31 +211,518 @@ void datalogger_start_session()
 		datalogger_index_table[current_index - 1].date = sensor_data.gps.date;
 	}
 	datalogger_write(LOG_INDEX_PAGE, sizeof(struct LogIndex) * MAX_INDEX, (unsigned char*)datalogger_index_table);
-	//printf("Starting to datalog to page %d, index %d\r\n", current_page, current_index);
+	//uart1_printf("Starting to datalog to page %d, index %d\r\n", current_page, current_index);
 }	
 
 
 void datalogger_read(int page, int size, unsigned char *buffer)
 {
-	if (xSemaphoreTake( xSpiSemaphore, ( portTickType ) 0 ) == pdTRUE )   // Spi1 is shared with SCP1000 and Dataflash
+	if (spi_bus_take( SPI_BUS_PRIORITY_LOG, ( portTickType ) 0 ) == pdTRUE )   // Spi1 is shared with SCP1000 and Dataflash
 	{
 		dataflash.read(page, size, buffer);
-		xSemaphoreGive( xSpiSemaphore );
+		spi_bus_give();
 	} else
-        printf("\r\nSPI Flash not available\r\n");
+        uart1_printf("\r\nSPI Flash not available\r\n");
 }	
 
 void datalogger_write(int page, int size, unsigned char *buffer)
 {
-	if (xSemaphoreTake( xSpiSemaphore, ( portTickType ) 0 ) == pdTRUE )   // Spi1 is shared with SCP1000 and Dataflash
+	if (spi_bus_take( SPI_BUS_PRIORITY_LOG, ( portTickType ) 0 ) == pdTRUE )   // Spi1 is shared with SCP1000 and Dataflash
 	{
 		dataflash.write(page, size, buffer);
-		xSemaphoreGive( xSpiSemaphore );
-        //printf("\r\nSPI Flash available\r\n");
+		spi_bus_give();
+        //uart1_printf("\r\nSPI Flash available\r\n");
     } else
-        printf("\r\nSPI Flash not available\r\n");
-}	
+        uart1_printf("\r\nSPI Flash not available\r\n");
+}
+
+/*!
+ *   Single-page write on the ping-pong path: the AT45 programs the previous
+ *   page while this one is clocked into its other SRAM buffer, so log lines
+ *   are not dropped at page boundaries.
+ */
+void datalogger_write_pingpong(int page, int size, unsigned char *buffer)
+{
+	if (spi_bus_take( SPI_BUS_PRIORITY_LOG, ( portTickType ) 0 ) == pdTRUE )   // Spi1 is shared with SCP1000 and Dataflash
+	{
+		dataflash.write_pingpong(page, size, buffer);
+		spi_bus_give();
+    } else
+        uart1_printf("\r\nSPI Flash not available\r\n");
+}
+
+void datalogger_write_pingpong_noerase(int page, int size, unsigned char *buffer)
+{
+	if (spi_bus_take( SPI_BUS_PRIORITY_LOG, ( portTickType ) 0 ) == pdTRUE )   // Spi1 is shared with SCP1000 and Dataflash
+	{
+		dataflash.write_pingpong_noerase(page, size, buffer);
+		spi_bus_give();
+    } else
+        uart1_printf("\r\nSPI Flash not available\r\n");
+}
+
+
+/*!
+ *   Number of log pages from "from" to "to", following the writer's wrap
+ *   from MAX_PAGE back to START_LOG_PAGE.
+ */
+int log_page_distance(int from, int to)
+{
+	int d = to - from;
+	if (d < 0)
+		d += MAX_PAGE - START_LOG_PAGE;
+	return d;
+}
+
+
+/*!
+ *   Writes the filled log buffer to current_page and advances it. Inside the
+ *   pre-erased window the program command without built-in erase is roughly
+ *   5x faster; outside it (right after boot, or when the eraser has been
+ *   overtaken) we fall back to the classic erase+program write, which works
+ *   on any page.
+ */
+void datalogger_write_current_page()
+{
+	datalogger_write_page_buffer(buffer);
+}
+
+
+/*!
+ *   Stamps the next sequence number into a filled page buffer, writes it to
+ *   current_page and advances the writer. Shared by the LogLine pages and
+ *   the gyro capture pages, so both stay inside the sequence ordering the
+ *   init binary search relies on.
+ */
+void datalogger_write_page_buffer(unsigned char *page_buffer)
+{
+	int ahead = (erase_ahead_page == -1) ? 0 : log_page_distance(current_page, erase_ahead_page);
+	unsigned long *seq = (unsigned long*) &(page_buffer[LOG_PAGE_SEQ_AT]);
+
+	*seq = log_sequence++;
+	if (ahead >= 1 && ahead <= ERASE_AHEAD_WINDOW)
+		datalogger_write_pingpong_noerase(current_page, PAGE_SIZE, page_buffer);
+	else
+		datalogger_write_pingpong(current_page, PAGE_SIZE, page_buffer);
+
+	current_page++;
+	if (current_page >= MAX_PAGE)
+		current_page = START_LOG_PAGE;
+}
+
+
+/*!
+ *   Background erase-ahead: keeps a window of ERASE_AHEAD_WINDOW pages in
+ *   front of the writer pre-erased. Called once per task tick; starts at most
+ *   one page erase, and only when the chip is idle, so the erase runs in the
+ *   shadow of the logging period instead of stalling the SPI bus during a
+ *   page write. The pages it wipes hold the oldest log data, which the
+ *   writer was about to overwrite anyway.
+ */
+void datalogger_erase_ahead()
+{
+	int ahead;
+
+	if (erase_ahead_page == -1)   // datalogger_init() has not run yet
+		return;
+
+	ahead = log_page_distance(current_page, erase_ahead_page);
+	if (ahead > ERASE_AHEAD_WINDOW)   // the writer overtook the eraser: restart at the writer
+	{
+		erase_ahead_page = current_page;
+		ahead = 0;
+	}
+	if (ahead >= ERASE_AHEAD_WINDOW)   // window is full
+		return;
+
+	if (spi_bus_take( SPI_BUS_PRIORITY_LOG, ( portTickType ) 0 ) == pdTRUE )
+	{
+		if (dataflash.ready())   // never make a pending page write wait behind a fresh erase
+		{
+			dataflash.erase_page(erase_ahead_page);
+			erase_ahead_page++;
+			if (erase_ahead_page >= MAX_PAGE)
+				erase_ahead_page = START_LOG_PAGE;
+		}
+		spi_bus_give();
+	}
+	// bus busy or chip busy: no problem, we try again next tick
+}
+
+
+//! Pause between two full scrub passes over the configuration banks and the
+//! stored flightplan; bit rot is a months-scale process.
+#define SCRUB_PASS_INTERVAL_MS 600000ul
+
+/*!
+ *   Background media scrub: aircraft stored over winter have come back with
+ *   a silently rotten dataflash (wrong configuration after load). One small
+ *   step per logging cycle - one configuration bank or one page of the
+ *   burned script - verifies the stored crcs. A corrupt configuration bank
+ *   is rewritten from the ram copy (the banks are redundant, so this is
+ *   detect and repair); a corrupt script is only reported, the live copy
+ *   may hold unburned edits. Runs at the lowest bus priority with a zero
+ *   wait: it only ever touches an otherwise idle spi bus and can never
+ *   delay a log write or a sensor read.
+ */
+static void datalogger_scrub()
+{
+	static unsigned long scrub_due_ms = 0;
+	static int scrub_target = 0;   // counts the config banks, then the script
+	int result;
+
+	if ((long)(timer_millis() - scrub_due_ms) < 0)
+		return;
+
+	if (spi_bus_take( SPI_BUS_PRIORITY_SCRUB, ( portTickType ) 0 ) != pdTRUE)
+		return;   // somebody holds (or waits for) the bus: retry next cycle
+
+	if (scrub_target < CONFIGURATION_BANKS)
+	{
+		result = configuration_scrub(scrub_target);
+		spi_bus_give();
+		if (result == 1)
+			uart1_printf("\r\nScrub: configuration bank %d failed its crc, rewritten from ram\r\n", scrub_target);
+		scrub_target++;
+	}
+	else
+	{
+		result = gluonscript_scrub_step();
+		spi_bus_give();
+		if (result == -1)
+			uart1_printf("\r\nScrub: stored flightplan fails its crc, burn it again (FN)\r\n");
+		if (result != 0)   // the pass over the script image is complete
+		{
+			scrub_target = 0;
+			scrub_due_ms = timer_millis() + SCRUB_PASS_INTERVAL_MS;
+		}
+	}
+}
+
 
+/*
+ *   Gyro capture page layout (LOG_PAGE_GYRO_FLAG set in the index word):
+ *   sample count and a wrapping page counter next to the sequence number,
+ *   then raw samples of 3 ints (gyro x, y, z) from byte 8. Written into
+ *   the normal log stream with the normal sequence numbers, so the init
+ *   binary search and the page recycling treat them like any log page.
+ */
+#ifdef LOG_DELTA_FORMAT
+#define CAP_COUNT_AT   2    // the delta record count slot, free on capture pages
+#define CAP_PAGENO_AT  3
+#else
+#define CAP_COUNT_AT   6    // behind the sequence number at [2]
+#define CAP_PAGENO_AT  7
+#endif
+#define CAP_SAMPLES_AT 8
+
+// Capture pages get their own buffer: 'buffer' holds the partially filled
+// LogLine page of the session logging running alongside. heap_1 never
+// frees, so it is allocated once, on the first capture.
+static unsigned char *cap_buffer = 0;
+static int cap_fill = 0;         // samples in cap_buffer
+static int cap_first_page = -1;  // first page of the running capture
+static int cap_pages = 0;
+static unsigned char cap_page_no = 0;
+
+
+static void datalogger_capture_write_page()
+{
+	int *hdr = (int*) &(cap_buffer[0]);
+
+	*hdr = current_index | LOG_PAGE_SEQ_FLAG | LOG_PAGE_GYRO_FLAG;
+	cap_buffer[CAP_COUNT_AT] = (unsigned char)cap_fill;
+	cap_buffer[CAP_PAGENO_AT] = cap_page_no++;
+	if (cap_first_page == -1)
+		cap_first_page = current_page;
+	datalogger_write_page_buffer(cap_buffer);
+	cap_pages++;
+	cap_fill = 0;
+}
+
+
+/*!
+ *   Consumer side of the gyro capture ring (see gyrocapture.c): packs the
+ *   samples the sensor task pushed since the last wake into capture pages.
+ *   The task wakes at 20ms instead of 100ms while a capture runs, so at
+ *   most ~20 samples queue up between drains. Prints the page range to
+ *   bulk-read (DB / raw download) when the capture completes.
+ */
+static void datalogger_capture_drain()
+{
+	int max_fill = (PAGE_SIZE - CAP_SAMPLES_AT) / (3 * sizeof(int));
+	int sample[3];
+	int *store;
+
+	if (! gyrocapture_active())
+		return;
+	if (cap_buffer == 0)
+		cap_buffer = (unsigned char*) pvPortMalloc(PAGE_SIZE);
+
+	while (gyrocapture_read_sample(sample))
+	{
+		store = (int*) &(cap_buffer[CAP_SAMPLES_AT + cap_fill * 3 * sizeof(int)]);
+		store[0] = sample[0];
+		store[1] = sample[1];
+		store[2] = sample[2];
+		cap_fill++;
+		if (cap_fill >= max_fill)
+			datalogger_capture_write_page();
+	}
+
+	if (gyrocapture_drained())
+	{
+		if (cap_fill > 0)
+			datalogger_capture_write_page();
+		uart1_printf("\r\nGyro capture done: %d pages from page %d, %lu samples, %lu drops, %lu timeouts\r\n",
+		       cap_pages, cap_first_page, gyrocapture.samples, gyrocapture.drops, gyrocapture.timeouts);
+		cap_first_page = -1;
+		cap_pages = 0;
+		cap_page_no = 0;
+		gyrocapture_complete();
+	}
+}
+
+
+#ifdef LOG_DELTA_FORMAT
+
+/*
+ *   Delta-compressed page layout:
+ *   [ 2B: index | LOG_PAGE_DELTA_FLAG | 1B: delta record count | 1B: reserved |
+ *     4B: page sequence number | keyframe LogLine | delta records ... ]
+ *
+ *   A delta record is a 3-byte field bitmask followed by, for every set bit,
+ *   the change of that field as one signed byte; LOG_DELTA_ESCAPE followed by
+ *   a 4-byte little-endian delta when it does not fit. Fields that did not
+ *   change cost nothing, which is what makes a typical record ~11 bytes
+ *   instead of 44. The encoder tracks the decoder's reconstructed view, so
+ *   quantization of lat/lon (stored in 1e-7 degree units) does not drift.
+ */
+
+#ifdef AHRS_SHADOW
+#define LOG_DELTA_FIELD_COUNT 24   // exactly fills the 3-byte field mask
+#else
+#define LOG_DELTA_FIELD_COUNT 21
+#endif
+#define LOG_DELTA_ESCAPE      0x80
+#define LOG_DELTA_KEYFRAME_AT 8     // after the sequence number, word aligned
+
+/*!
+ *   Field value in delta units: lat/lon as 1e-7 degrees, the rest as stored.
+ */
+static long logline_get_field(struct LogLine *l, int f)
+{
+	switch (f)
+	{
+		case 0:  return (long)(l->gps_latitude_rad * RAD2DEG(1.0e7));
+		case 1:  return (long)(l->gps_longitude_rad * RAD2DEG(1.0e7));
+		case 2:  return (long)l->date;
+		case 3:  return (long)l->time;
+		case 4:  return l->gps_height_m;
+		case 5:  return l->gps_speed_m_s;
+		case 6:  return l->gps_heading;
+		case 7:  return l->pitch;
+		case 8:  return l->roll;
+		case 9:  return l->yaw;
+		case 10: return l->control_state;
+		case 11: return l->temperature_c;
+		case 12: return l->height_m;
+		case 13: return l->navigation_code_line;
+		case 14: return (long)l->servo_trigger;
+		case 15: return l->p;
+		case 16: return l->q;
+		case 17: return l->r;
+		case 18: return (long)l->time_ms;
+		case 19: return l->pps_offset_ms;
+		case 20: return l->cpu_load;
+#ifdef AHRS_SHADOW
+		case 21: return l->shadow_pitch;
+		case 22: return l->shadow_roll;
+		case 23: return (long)l->ahrs_cycles;
+#endif
+	}
+	return 0;
+}
+
+
+static void logline_set_field(struct LogLine *l, int f, long v)
+{
+	switch (f)
+	{
+		case 0:  l->gps_latitude_rad = (double)v * DEG2RAD(1.0e-7); break;
+		case 1:  l->gps_longitude_rad = (double)v * DEG2RAD(1.0e-7); break;
+		case 2:  l->date = (unsigned long)v; break;
+		case 3:  l->time = (unsigned long)v; break;
+		case 4:  l->gps_height_m = (int)v; break;
+		case 5:  l->gps_speed_m_s = (unsigned char)v; break;
+		case 6:  l->gps_heading = (int)v; break;
+		case 7:  l->pitch = (int)v; break;
+		case 8:  l->roll = (int)v; break;
+		case 9:  l->yaw = (int)v; break;
+		case 10: l->control_state = (char)v; break;
+		case 11: l->temperature_c = (char)v; break;
+		case 12: l->height_m = (int)v; break;
+		case 13: l->navigation_code_line = (int)v; break;
+		case 14: l->servo_trigger = (unsigned int)v; break;
+		case 15: l->p = (int)v; break;
+		case 16: l->q = (int)v; break;
+		case 17: l->r = (int)v; break;
+		case 18: l->time_ms = (unsigned long)v; break;
+		case 19: l->pps_offset_ms = v; break;
+		case 20: l->cpu_load = (unsigned char)v; break;
+#ifdef AHRS_SHADOW
+		case 21: l->shadow_pitch = (int)v; break;
+		case 22: l->shadow_roll = (int)v; break;
+		case 23: l->ahrs_cycles = (unsigned long)v; break;
+#endif
+	}
+}
+
+
+/*!
+ *   Apply one delta record from src onto l. Returns the record length in bytes.
+ *   Also used by the encoder to keep its reference line in sync with what a
+ *   decoder will reconstruct.
+ */
+static int logline_apply_delta(struct LogLine *l, unsigned char *src)
+{
+	unsigned long mask = (unsigned long)src[0] | ((unsigned long)src[1] << 8) | ((unsigned long)src[2] << 16);
+	int len = 3;
+	int f;
+	long d;
+
+	for (f = 0; f < LOG_DELTA_FIELD_COUNT; f++)
+	{
+		if (! (mask & (1l << f)))
+			continue;
+		if (src[len] == LOG_DELTA_ESCAPE)
+		{
+			d = (long)src[len+1] | ((long)src[len+2] << 8) |
+			    ((long)src[len+3] << 16) | ((long)src[len+4] << 24);
+			len += 5;
+		}
+		else
+		{
+			d = (signed char)src[len];
+			len += 1;
+		}
+		logline_set_field(l, f, logline_get_field(l, f) + d);
+	}
+	return len;
+}
+
+
+/*!
+ *   Encode line as a delta against prev into dst. Returns the record length,
+ *   or -1 when it doesn't fit in maxlen. prev is not modified.
+ */
+static int logline_encode_delta(struct LogLine *prev, struct LogLine *line, unsigned char *dst, int maxlen)
+{
+	unsigned long mask = 0;
+	int len = 3;
+	int f;
+	long d;
+
+	for (f = 0; f < LOG_DELTA_FIELD_COUNT; f++)
+	{
+		d = logline_get_field(line, f) - logline_get_field(prev, f);
+		if (d == 0)
+			continue;
+		mask |= 1l << f;
+		if (d >= -127l && d <= 127l)
+		{
+			dst[len++] = (unsigned char)(signed char)d;
+		}
+		else
+		{
+			dst[len++] = LOG_DELTA_ESCAPE;
+			dst[len++] = (unsigned char)(d & 0xff);
+			dst[len++] = (unsigned char)((d >> 8) & 0xff);
+			dst[len++] = (unsigned char)((d >> 16) & 0xff);
+			dst[len++] = (unsigned char)((d >> 24) & 0xff);
+		}
+		if (len > maxlen)
+			return -1;
+	}
+	dst[0] = (unsigned char)(mask & 0xff);
+	dst[1] = (unsigned char)((mask >> 8) & 0xff);
+	dst[2] = (unsigned char)(mask >> 16);
+	return len;
+}
+
+
+/*!
+ *    Save the LogLine line to a buffer, delta-compressed. Write the buffer when full.
+ */
+void datalogger_writeline(struct LogLine *line)
+{
+	static struct LogLine prev_line;
+	static int page_offset = 0;   // 0: page still needs its keyframe
+	unsigned char scratch[3 + LOG_DELTA_FIELD_COUNT*5];
+	int len, i;
+	int *hdr = (int*) &(buffer[0]);
+
+	if (page_offset == 0)
+	{
+		unsigned char *a = (unsigned char*) line;
+		*hdr = current_index | LOG_PAGE_DELTA_FLAG | LOG_PAGE_SEQ_FLAG;
+		buffer[2] = 0;   // delta record count
+		buffer[3] = 0;
+		for (i = 0; i < sizeof(struct LogLine); i++)
+			buffer[LOG_DELTA_KEYFRAME_AT + i] = a[i];
+		prev_line = *line;
+		page_offset = LOG_DELTA_KEYFRAME_AT + sizeof(struct LogLine);
+		return;
+	}
+
+	len = logline_encode_delta(&prev_line, line, scratch, PAGE_SIZE - page_offset);
+	if (len < 0 || buffer[2] == 255)   // full -> flush and restart with a keyframe
+	{
+		for (i = page_offset; i < PAGE_SIZE; i++)
+			buffer[i] = 0;
+		datalogger_write_current_page();
+		page_offset = 0;
+		datalogger_writeline(line);   // recurses exactly once: writes the keyframe
+		return;
+	}
+
+	for (i = 0; i < len; i++)
+		buffer[page_offset + i] = scratch[i];
+	page_offset += len;
+	buffer[2]++;
+	logline_apply_delta(&prev_line, scratch);   // track the decoder's view
+}
+
+
+/*!
+ *   Decode and print the delta page sitting in buffer.
+ */
+static int datalogger_print_delta_page(void(*printer)(struct LogLine*))
+{
+	static struct LogLine l;
+	unsigned char *a = (unsigned char*) &l;
+	int *hdr = (int*) &(buffer[0]);
+	int count = buffer[2];
+	int base = (*hdr & LOG_PAGE_SEQ_FLAG) ? LOG_DELTA_KEYFRAME_AT : 4;   // pre-sequence pages have no sequence number
+	int offset = base + sizeof(struct LogLine);
+	int i, j;
+
+	for (i = 0; i < sizeof(struct LogLine); i++)
+		a[i] = buffer[base + i];
+
+	if (! (l.gps_latitude_rad < DEG2RAD(360.0) && l.gps_longitude_rad < DEG2RAD(360.0)))
+		return 0;
+	printer(&l);
+
+	for (j = 0; j < count && offset < PAGE_SIZE; j++)
+	{
+		offset += logline_apply_delta(&l, &buffer[offset]);
+		printer(&l);
+	}
+	return 1;
+}
+
+#else    // LOG_DELTA_FORMAT
 
 int current_line = 0;
 /*!
@@ -179,25 +732,24 @@ void datalogger_writeline(struct LogLine *line)
 {
 	unsigned char *a, *b;
 	int i;
-	struct LogLine *lines = (struct LogLine*) &(buffer[2]);   // buffer[0-1] set in datalogger_init()
-	
-	if (2+(current_line+1)*sizeof(struct LogLine) >= PAGE_SIZE)
+	struct LogLine *lines = (struct LogLine*) &(buffer[LOG_RAW_LINES_AT]);   // buffer[0-1] set in datalogger_init(), [2-5] in datalogger_write_current_page()
+
+	if (LOG_RAW_LINES_AT+(current_line+1)*sizeof(struct LogLine) >= PAGE_SIZE)
 	{
-		datalogger_write(current_page, sizeof(buffer), buffer);
-		current_page++;
-		if (current_page >= MAX_PAGE)
-			current_page = START_LOG_PAGE;
+		datalogger_write_current_page();
 		current_line = 0;
-		//printf("write page!\n\r");
-	}	
-	
+		//uart1_printf("write page!\n\r");
+	}
+
 	a = (unsigned char*) line;
 	b = (unsigned char*) &(lines[current_line++]);
-	
+
 	for (i = 0; i < sizeof(struct LogLine); i++)
 		b[i] = a[i];
 }
 
+#endif   // LOG_DELTA_FORMAT
+
 
 //static long last_totalseconds = -1;
 /*!
@@ -212,7 +764,8 @@ int datalogger_print_next_page(int index, void(*printer)(struct LogLine*))
 {
 	static int last_index = -1;
 	static int last_page = -1;
-	static struct LogLine *lines = (struct LogLine*) &(buffer[2]);
+	struct LogLine *lines = (struct LogLine*) &(buffer[2]);
+	int lines_at = 2;
 	
 	int *i = (int*) &(buffer[0]);
 	int j;
@@ -223,14 +776,23 @@ int datalogger_print_next_page(int index, void(*printer)(struct LogLine*))
 		last_index = index;
 	}
 
-	datalogger_read(last_page++, sizeof(buffer), buffer);
+	datalogger_read(last_page++, PAGE_SIZE, buffer);
 	if (last_page >= MAX_PAGE)
 			last_page = START_LOG_PAGE;
 
+	if (*i != -1 && (*i & LOG_PAGE_SEQ_FLAG))   // raw LogLines moved behind the page sequence number
+	{
+		lines_at = LOG_RAW_LINES_AT;
+		lines = (struct LogLine*) &(buffer[LOG_RAW_LINES_AT]);
+	}
+
+	if (*i != -1 && (*i & LOG_PAGE_GYRO_FLAG))   // gyro capture page: no LogLines, fetched via DB
+		return 1;
+
 #ifdef DETAILED_LOG //|| RAW_50HZ_LOG
-    if (*i != index+1)
+    if (LOG_PAGE_INDEX(*i) != index+1)
 	{
-		printf ("%d != %d\r\n", *i, index+1);
+		uart1_printf ("%d != %d\r\n", LOG_PAGE_INDEX(*i), index+1);
 		return 0;
 	}
 #else
@@ -240,7 +802,7 @@ int datalogger_print_next_page(int index, void(*printer)(struct LogLine*))
 	long totalseconds =  seconds + minutes * 60 + hours * 3600;
     if (abs(totalseconds  - last_totalseconds) > 2 && last_totalseconds != -1)
     {
-        printf("\r\n Stop: new line: %lu  %lu \r\n", lines[0].date, lines[0].time);
+        uart1_printf("\r\n Stop: new line: %lu  %lu \r\n", lines[0].date, lines[0].time);
         return 0;
     }
     hours = (lines[PAGE_SIZE / sizeof(struct LogLine) - 2].time / 10000);
@@ -248,14 +810,19 @@ int datalogger_print_next_page(int index, void(*printer)(struct LogLine*))
     seconds = (lines[PAGE_SIZE / sizeof(struct LogLine) - 2].time) % 100;
 	totalseconds =  seconds + minutes * 60 + hours * 3600;
     last_totalseconds = totalseconds;*/
-    if (*i != index+1)
+    if (LOG_PAGE_INDEX(*i) != index+1)
 	{
-		printf ("%d != %d\r\n", *i, index+1);
+		uart1_printf ("%d != %d\r\n", LOG_PAGE_INDEX(*i), index+1);
 		return 0;
 	}
 #endif
 
-	for (j = 0; j < (PAGE_SIZE - 2) / sizeof(struct LogLine); j++)
+#ifdef LOG_DELTA_FORMAT
+	if (*i & LOG_PAGE_DELTA_FLAG)
+		return datalogger_print_delta_page(printer);
+#endif
+
+	for (j = 0; j < (PAGE_SIZE - lines_at) / sizeof(struct LogLine); j++)
     {
         if (lines[j].gps_latitude_rad < DEG2RAD(360.0) && lines[j].gps_longitude_rad < DEG2RAD(360.0) )
             printer(&lines[j]);
@@ -269,8 +836,9 @@ int datalogger_print_next_page(int index, void(*printer)(struct LogLine*))
 int datalogger_print_next_page_of_all(int index, void(*printer)(struct LogLine*))
 {
 	static int last_page = -1;
-	static struct LogLine *lines = (struct LogLine*) &(buffer[2]);
 	static int processed_lines = 0;
+	struct LogLine *lines = (struct LogLine*) &(buffer[2]);
+	int lines_at = 2;
 
 	int *current_i = (int*) &(buffer[0]);
 	int j;
@@ -278,12 +846,21 @@ int datalogger_print_next_page_of_all(int index, void(*printer)(struct LogLine*)
 	if (last_page == -1)
 		last_page = datalogger_index_table[index].page_num; // start to read at the current page (oldest entry to be overwritten)
 
-	datalogger_read(last_page++, sizeof(buffer), buffer);
+	datalogger_read(last_page++, PAGE_SIZE, buffer);
 	processed_lines++;
 
+	if (*current_i != -1 && (*current_i & LOG_PAGE_SEQ_FLAG))   // raw LogLines moved behind the page sequence number
+	{
+		lines_at = LOG_RAW_LINES_AT;
+		lines = (struct LogLine*) &(buffer[LOG_RAW_LINES_AT]);
+	}
+
+	if (*current_i != -1 && (*current_i & LOG_PAGE_GYRO_FLAG))   // gyro capture page: no LogLines, fetched via DB
+		return 1;
+
 	if (last_page == datalogger_index_table[index].page_num || processed_lines > 4095 - START_LOG_PAGE)
 	{
-		printf("\r\nAll log-pages have been processed\r\n");
+		uart1_printf("\r\nAll log-pages have been processed\r\n");
 		processed_lines = 0;
 		last_page = -1;
 		return 0;
@@ -293,32 +870,114 @@ int datalogger_print_next_page_of_all(int index, void(*printer)(struct LogLine*)
 
 	/*if (*current_i != index+1)
 	{
-		printf ("%d != %d\r\n", *current_i, index+1);
+		uart1_printf ("%d != %d\r\n", *current_i, index+1);
 		return 0;
 	}*/
 
-	for (j = 0; j < (PAGE_SIZE - 2) / sizeof(struct LogLine); j++)
+#ifdef LOG_DELTA_FORMAT
+	if (*current_i & LOG_PAGE_DELTA_FLAG)
 	{
-		if (*current_i == index)
+		if (LOG_PAGE_INDEX(*current_i) == index)
+			datalogger_print_delta_page(printer);
+		uart1_printf("\r\n processed page %d having index %d\r\n", last_page, LOG_PAGE_INDEX(*current_i));
+		return 1;
+	}
+#endif
+
+	for (j = 0; j < (PAGE_SIZE - lines_at) / sizeof(struct LogLine); j++)
+	{
+		if (LOG_PAGE_INDEX(*current_i) == index)
 			printer(&lines[j]);
 	}
-	printf("\r\n processed page %d having index %d\r\n", last_page, *current_i);
+	uart1_printf("\r\n processed page %d having index %d\r\n", last_page, LOG_PAGE_INDEX(*current_i));
 	return 1;
 }
 	
 
+/*!
+ *   Binary chunked readout of one flash page, used by the DP serial command
+ *   and by datalogger_stream_pages. Any page goes - configuration, index and
+ *   blackbox pages included - so a corrupted index can be inspected offline.
+ *
+ *   Unlike the DR text readout this does not stop the logging task: the page
+ *   is read into its own buffer, the dataflash driver waits out a pending
+ *   page-program (the writer uses the AT45's second SRAM buffer, so it never
+ *   waits on us either), and the SPI bus is only claimed for the ~0.7ms page
+ *   read. The page goes out as 4 checksummed BIN_MSG_LOG_CHUNK frames. The
+ *   groundstation requests one page at a time and simply re-requests a page
+ *   with a bad chunk, which doubles as resume support after a dropped link.
+ */
+int datalogger_stream_page(int page)
+{
+	static unsigned char stream_buffer[528];  // WARNING: won't work with AT45DB321
+	int chunk_size = PAGE_SIZE / 4;
+	int c;
+
+	if (page < 0 || page > MAX_PAGE)
+		return 0;
+
+	if (spi_bus_take( SPI_BUS_PRIORITY_LOG, ( portTickType ) 200 / portTICK_RATE_MS ) != pdTRUE)
+	{
+		uart1_printf("\r\nSPI Flash not available\r\n");
+		return 0;
+	}
+	dataflash.read(page, PAGE_SIZE, stream_buffer);
+	spi_bus_give();
+
+	for (c = 0; c < 4; c++)
+	{
+		// Flow control: a chunk is chunk_size+9 bytes on the wire. Wait until
+		// it fits in the transmit ring with headroom to spare, so a bulk
+		// readout saturates the uart without ever busy-waiting inside the
+		// ring (which would hold the uart semaphore and starve telemetry).
+		while (uart1_tx_free() < chunk_size + 9 + 64)
+			vTaskDelay( ( portTickType ) 10 / portTICK_RATE_MS );
+		comm_binary_send_log_chunk((unsigned int)page, (unsigned char)c,
+		                           &stream_buffer[c*chunk_size], (unsigned char)chunk_size);
+	}
+	return 1;
+}
+
+
+/*!
+ *   Bulk raw readout: streams count pages starting at start_page, the DB
+ *   serial command and the fast path of the GluonCS download manager. Built
+ *   on datalogger_stream_page, so it shares its chunk framing, its per-chunk
+ *   flow control and its access to every flash region.
+ */
+int datalogger_stream_pages(int start_page, int count)
+{
+	int page;
+
+	if (start_page < 0 || start_page > MAX_PAGE || count < 1)
+		return 0;
+	if (count > MAX_PAGE - start_page + 1)
+		count = MAX_PAGE - start_page + 1;
+
+	for (page = start_page; count > 0; page++, count--)
+	{
+		if (! datalogger_stream_page(page))
+			return 0;
+	}
+	return 1;
+}
+
+
 /*!
  *   Formats all dataflash pages except the first 2 (used for configuration)
  */
 void datalogger_format()
 {
 	int i;
+	if (buffer == 0)   // format can be ordered from the console before a log init
+		buffer = (unsigned char*) pvPortMalloc(PAGE_SIZE);
+
 	for (i = 0; i < PAGE_SIZE; i++)
 		buffer[i] = 0;
 		
-	for (i = LOG_INDEX_PAGE; i <= MAX_PAGE; i++)
+	for (i = LOG_INDEX_PAGE; i < MAX_PAGE; i++)   // MAX_PAGE itself is BLACKBOX_PAGE: keep the crash dump
 	{
-		printf("page %d\r\n", i);
+		uart1_printf("page %d\r\n", i);
 		datalogger_write(i, PAGE_SIZE, buffer);
 	}	
 	
@@ -338,6 +997,163 @@ void datalogger_enable()
 }
 
 
+/*!
+ *   50Hz logging for control tuning: the attitude, gyro and servo fields are
+ *   refreshed every tick, the GPS and temperature fields only every 10th one.
+ *   Decimated fields cost no log space in between because their deltas are
+ *   empty (see LOG_DELTA_FORMAT), which keeps 50Hz within dataflash bandwidth.
+ */
+void datalogger_set_highrate(int enable)
+{
+	log_highrate = enable;
+}
+
+
+
+// SPSC ring of completed LogLines between the control task (producer) and
+// this task (consumer). Compile-time sized, statically allocated: 16 slots
+// buffer 320ms of the 50Hz mode, which rides out a page program plus an
+// erase without the producer ever waiting on the flash.
+#define LOG_RING_LINES 16
+static struct LogLine log_ring[LOG_RING_LINES];
+static volatile int log_ring_head = 0;   // next slot the producer fills
+static volatile int log_ring_tail = 0;   // next slot the consumer drains
+static int logging_active = 0;           // set once the session index is written
+unsigned int log_ring_drops = 0;         // lines lost to a full ring
+
+
+/*!
+ *    Producer side of the log ring, called by the control task at the end of
+ *    every cycle: samples the sensor/control state into a LogLine and commits
+ *    it. Lock-free single-producer/single-consumer - each index is written by
+ *    one side only and an int store is atomic on this core - so a page
+ *    program or erase stalls only the drain in datalogger_task, never the
+ *    control loop. Rate-limits itself to the cadences the logging task used
+ *    to sleep: 20ms in the 50Hz modes, 250ms otherwise.
+ */
+void datalogger_collect()
+{
+	static struct LogLine l;
+	static int decimate_tick = 0;
+	static unsigned long last_commit_ms = 0;
+	unsigned long now;
+	unsigned long interval_ms;
+	int next;
+
+	if (! logging_active || disable_logging)
+		return;
+
+	now = timer_millis();
+#ifdef RAW_50HZ_LOG
+	interval_ms = 20;
+#else
+	interval_ms = log_highrate ? 20 : 250;
+#endif
+	if (now - last_commit_ms < interval_ms)
+		return;
+	last_commit_ms = now;
+
+#ifdef DETAILED_LOG
+	// Normal logging
+	l.temperature_c = (char)sensor_data.temperature; // -128�C...+128�C
+	l.height_m = (int)sensor_data.pressure_height;
+	l.gps_latitude_rad = sensor_data.gps.latitude_rad;
+	l.gps_longitude_rad = sensor_data.gps.longitude_rad;
+	l.gps_height_m = sensor_data.gps.height_m;
+	l.gps_heading = (int)(sensor_data.gps.heading_rad * (180.0/3.14159));
+	l.gps_speed_m_s = (int)(sensor_data.gps.speed_ms*100.0);
+	l.gps_satellites = (char)sensor_data.gps.satellites_in_view;
+	//l.acc_x = sensor_data.acc_x_raw;
+	//l.acc_y = sensor_data.acc_y_raw;
+	//l.acc_z = sensor_data.acc_z_raw;
+	l.acc_x_g = sensor_data.acc_x;
+	l.acc_y_g = sensor_data.acc_y;
+	l.acc_z_g = sensor_data.acc_z;
+
+	//l.gyro_x = sensor_data.gyro_x_raw;
+	//l.gyro_y = sensor_data.gyro_y_raw;
+	//l.gyro_z = sensor_data.gyro_z_raw;
+	l.p = (int)(sensor_data.p * (180.0/3.14159));
+	l.q = (int)(sensor_data.q * (180.0/3.14159));
+	l.r = (int)(sensor_data.r * (180.0/3.14159));
+	l.pitch = (int)(sensor_data.pitch * (180.0/3.14159));
+	l.roll = (int)(sensor_data.roll * (180.0/3.14159));
+	l.desired_pitch = (int)(control_state.desired_pitch * (180.0/3.14159));
+	l.desired_roll = (int)(control_state.desired_roll * (180.0/3.14159));
+	//l.pitch_acc = (int)(sensor_data.pitch_acc * (180.0/3.14159));
+	//l.roll_acc = (int)(sensor_data.roll_acc * (180.0/3.14159));
+	l.control_state = control_state.flight_mode;
+	l.desired_heading = ((int)(navigation_data.desired_heading_rad * 180.0/3.14159));
+	l.navigation_code_line = gluonscript_data.current_codeline;
+	l.desired_height = control_state.desired_altitude;
+#elif RAW_50HZ_LOG
+	// Raw sensor logging at 50Hz
+	l.height_m_5 = (int)(sensor_data.pressure_height*5);
+	l.gps_latitude_rad = sensor_data.gps.latitude_rad;
+	l.gps_longitude_rad = sensor_data.gps.longitude_rad;
+	l.gps_heading_2 = (unsigned char)(sensor_data.gps.heading_rad * (180.0/3.14159) / 2.0);
+	l.gps_speed_m_s_10 = (unsigned char)(sensor_data.gps.speed_ms * 10.0);
+	l.gps_time = sensor_data.gps.time;
+	l.acc_x = sensor_data.acc_x_raw;
+	l.acc_y = sensor_data.acc_y_raw;
+	l.acc_z = sensor_data.acc_z_raw;
+	l.gyro_x = sensor_data.gyro_x_raw;
+	l.gyro_y = sensor_data.gyro_y_raw;
+	l.gyro_z = sensor_data.gyro_z_raw;
+	//l.idg500_vref = sensor_data.idg500_vref;
+	l.pitch = (int)(sensor_data.pitch * (180.0/3.14159));
+	l.pitch_acc = (int)(sensor_data.pitch_acc * (180.0/3.14159));
+	l.roll = (int)(sensor_data.roll * (180.0/3.14159));
+	//l.control_state = control_state.flight_mode;
+
+#else
+	    // Simple logging
+	if (!log_highrate || ++decimate_tick >= 10)   // GPS and temperature at 5Hz in the 50Hz mode
+	{
+		decimate_tick = 0;
+		l.temperature_c = (char)sensor_data.temperature; // -128�C...+128�C
+		l.gps_latitude_rad = sensor_data.gps.latitude_rad;
+		l.gps_longitude_rad = sensor_data.gps.longitude_rad;
+		l.gps_height_m = sensor_data.gps.height_m;
+		l.gps_heading = (int)(sensor_data.gps.heading_rad * (180.0/3.14159));
+		l.gps_speed_m_s = (unsigned char)(sensor_data.gps.speed_ms*3.0);
+		l.date = sensor_data.gps.date;
+		l.time = sensor_data.gps.time;
+	}
+	l.height_m = (int)sensor_data.pressure_height;
+
+	l.pitch = (int)(sensor_data.pitch * (180.0/3.14159));
+	l.roll = (int)(sensor_data.roll * (180.0/3.14159));
+	    l.yaw = (int)(sensor_data.yaw * (180.0/3.14159));
+	l.p = (int)(sensor_data.p * (180.0/3.14159));
+	l.q = (int)(sensor_data.q * (180.0/3.14159));
+	l.r = (int)(sensor_data.r * (180.0/3.14159));
+	l.control_state = control_state.flight_mode;
+	l.navigation_code_line = gluonscript_data.current_codeline;
+	    l.servo_trigger = trigger.trigger_counter;
+	l.time_ms = timer_millis();   // same clock as the telemetry stamps
+	l.pps_offset_ms = pps_offset_ms();  // time_ms + this = gps ms-of-day
+	l.cpu_load = cpuload_percent();
+#ifdef AHRS_SHADOW
+	l.shadow_pitch = (int)(ahrs_shadow.pitch * (180.0/3.14159));
+	l.shadow_roll = (int)(ahrs_shadow.roll * (180.0/3.14159));
+	l.ahrs_cycles = ((unsigned long)(unsigned int)(ahrs_shadow.shadow_cycles >> 2) << 16)
+	              | (unsigned int)(ahrs_shadow.primary_cycles >> 2);
+#endif
+#endif
+	next = log_ring_head + 1;
+	if (next >= LOG_RING_LINES)
+		next = 0;
+	if (next == log_ring_tail)   // the flash writer stalled long enough to lap us
+	{
+		log_ring_drops++;
+		return;
+	}
+	log_ring[log_ring_head] = l;
+	log_ring_head = next;
+}
+
+
 /*!
  *    This task takes care of the logging, both initialization and actual logging.
  * 
@@ -348,10 +1164,9 @@ void datalogger_enable()
  */
 void datalogger_task( void *parameters )
 {
-	static struct LogLine l;
-	
 	/* Used to wake the task at the correct frequency. */
-	portTickType xLastExecutionTime; 
+	portTickType xLastExecutionTime;
+	int hb;
 
 	uart1_puts("Datalogger task initializing...");
 
@@ -365,100 +1180,45 @@ void datalogger_task( void *parameters )
 	
 	// wait for GPS	(date & time!)
 	while(sensor_data.gps.status != ACTIVE)
-		vTaskDelayUntil( &xLastExecutionTime, ( ( portTickType ) 1000 / portTICK_RATE_MS ) );   // 1Hz
+	{
+		vTaskDelayUntil( &xLastExecutionTime, ( ( portTickType ) (gyrocapture_active() ? 20 : 1000) / portTICK_RATE_MS ) );   // 1Hz
+		datalogger_capture_drain();   // bench gyro captures run without a fix
+		configuration_commit();   // bench sessions have no GPS fix, but FC must still reach the flash
+	}
 	
 	// ok, now we've got the current date and time, we can find an available page and write the index	
 	datalogger_start_session();
+	logging_active = 1;   // from here on the control task commits log lines
+	hb = heartbeat_register("Dataflash", 1000);   // covers drain wakes and flash stalls
 	
 	for( ;; )
-	{	
-#ifndef RAW_50HZ_LOG
-		vTaskDelayUntil( &xLastExecutionTime, ( ( portTickType ) 250 / portTICK_RATE_MS ) );   // 4Hz
-#else
-		vTaskDelayUntil( &xLastExecutionTime, ( ( portTickType ) 20 / portTICK_RATE_MS ) );   // 50Hz
-#endif		
+	{
+		// 10Hz drain: at most 5 committed lines per wake in the 50Hz mode,
+		// well inside the ring's 16 slots; 50Hz while a gyro capture streams
+		vTaskDelayUntil( &xLastExecutionTime, ( ( portTickType ) (gyrocapture_active() ? 20 : 100) / portTICK_RATE_MS ) );
 
-		if (! disable_logging)   // logging is disabled when the config tool reads out logging.
-		{
-#ifdef DETAILED_LOG
-			// Normal logging
-			l.temperature_c = (char)sensor_data.temperature; // -128�C...+128�C
-			l.height_m = (int)sensor_data.pressure_height;
-			l.gps_latitude_rad = sensor_data.gps.latitude_rad;
-			l.gps_longitude_rad = sensor_data.gps.longitude_rad;
-			l.gps_height_m = sensor_data.gps.height_m;
-			l.gps_heading = (int)(sensor_data.gps.heading_rad * (180.0/3.14159));
-			l.gps_speed_m_s = (int)(sensor_data.gps.speed_ms*100.0);
-			l.gps_satellites = (char)sensor_data.gps.satellites_in_view;
-			//l.acc_x = sensor_data.acc_x_raw;
-			//l.acc_y = sensor_data.acc_y_raw;
-			//l.acc_z = sensor_data.acc_z_raw;
-			l.acc_x_g = sensor_data.acc_x;
-			l.acc_y_g = sensor_data.acc_y;
-			l.acc_z_g = sensor_data.acc_z;
-
-			//l.gyro_x = sensor_data.gyro_x_raw;
-			//l.gyro_y = sensor_data.gyro_y_raw;
-			//l.gyro_z = sensor_data.gyro_z_raw;
-			l.p = (int)(sensor_data.p * (180.0/3.14159));
-			l.q = (int)(sensor_data.q * (180.0/3.14159));
-			l.r = (int)(sensor_data.r * (180.0/3.14159));
-			l.pitch = (int)(sensor_data.pitch * (180.0/3.14159));
-			l.roll = (int)(sensor_data.roll * (180.0/3.14159));
-			l.desired_pitch = (int)(control_state.desired_pitch * (180.0/3.14159));
-			l.desired_roll = (int)(control_state.desired_roll * (180.0/3.14159));
-			//l.pitch_acc = (int)(sensor_data.pitch_acc * (180.0/3.14159));
-			//l.roll_acc = (int)(sensor_data.roll_acc * (180.0/3.14159));
-			l.control_state = control_state.flight_mode;
-			l.desired_heading = ((int)(navigation_data.desired_heading_rad * 180.0/3.14159));
-			l.navigation_code_line = gluonscript_data.current_codeline;
-			l.desired_height = control_state.desired_altitude;
-#elif RAW_50HZ_LOG
-			// Raw sensor logging at 50Hz
-			l.height_m_5 = (int)(sensor_data.pressure_height*5);
-			l.gps_latitude_rad = sensor_data.gps.latitude_rad;
-			l.gps_longitude_rad = sensor_data.gps.longitude_rad;
-			l.gps_heading_2 = (unsigned char)(sensor_data.gps.heading_rad * (180.0/3.14159) / 2.0);
-			l.gps_speed_m_s_10 = (unsigned char)(sensor_data.gps.speed_ms * 10.0);
-			l.gps_time = sensor_data.gps.time;
-			l.acc_x = sensor_data.acc_x_raw;
-			l.acc_y = sensor_data.acc_y_raw;
-			l.acc_z = sensor_data.acc_z_raw;
-			l.gyro_x = sensor_data.gyro_x_raw;
-			l.gyro_y = sensor_data.gyro_y_raw;
-			l.gyro_z = sensor_data.gyro_z_raw;
-			//l.idg500_vref = sensor_data.idg500_vref;
-			l.pitch = (int)(sensor_data.pitch * (180.0/3.14159));
-			l.pitch_acc = (int)(sensor_data.pitch_acc * (180.0/3.14159));
-			l.roll = (int)(sensor_data.roll * (180.0/3.14159));
-			//l.control_state = control_state.flight_mode;
+		heartbeat_checkin(hb);
+		configuration_commit();   // deferred FC write, if one is scheduled
 
-#else
-            // Simple logging
-			l.temperature_c = (char)sensor_data.temperature; // -128�C...+128�C
-			l.height_m = (int)sensor_data.pressure_height;
-			l.gps_latitude_rad = sensor_data.gps.latitude_rad;
-			l.gps_longitude_rad = sensor_data.gps.longitude_rad;
-			l.gps_height_m = sensor_data.gps.height_m;
-			l.gps_heading = (int)(sensor_data.gps.heading_rad * (180.0/3.14159));
-			l.gps_speed_m_s = (unsigned char)(sensor_data.gps.speed_ms*3.0);
-
-			l.pitch = (int)(sensor_data.pitch * (180.0/3.14159));
-			l.roll = (int)(sensor_data.roll * (180.0/3.14159));
-            l.yaw = (int)(sensor_data.yaw * (180.0/3.14159));
-			l.control_state = control_state.flight_mode;
-			l.navigation_code_line = gluonscript_data.current_codeline;
-            l.date = sensor_data.gps.date;
-            l.time = sensor_data.gps.time;
-            l.servo_trigger = trigger.trigger_counter;
-#endif
-			datalogger_writeline(&l);
+		if (disable_logging)   // logging is disabled when the config tool reads out logging.
+		{
+			uart1_printf("\r\nLogging task stopped\r\n");
+			vTaskDelete(NULL);
+		}
 
+		// Copy what the control task committed since the last wake into the
+		// page buffer; the page programs and erases all happen down here,
+		// decoupled from the producer's timing by the ring.
+		while (log_ring_tail != log_ring_head)
+		{
+			int next = log_ring_tail + 1;
+			if (next >= LOG_RING_LINES)
+				next = 0;
+			datalogger_writeline(&log_ring[log_ring_tail]);
+			log_ring_tail = next;
 		}
-        else // logging disabled:
-        {
-            printf("\r\nLogging task stopped\r\n");
-            vTaskDelete(NULL);
-        }
+		datalogger_capture_drain(); // raw 1kHz gyro pages, while a capture runs
+		datalogger_erase_ahead();   // keep clean flash in front of the writer
+		datalogger_scrub();         // idle-bandwidth crc verify of config + script
 	}
 }
@@ -6,12 +6,24 @@
 // Uncomment this define if you want to use 50Hz raw data logging
 //#define RAW_50HZ_LOG 1
 
+// Delta-compressed logging: every dataflash page starts with one full LogLine
+// keyframe, the following records only store the fields that changed since the
+// previous record, as variable length deltas. Fits roughly 3x more records in
+// the dataflash. The LD readout decodes before printing, so the groundstation
+// still receives plain LogLines. Comment out to go back to raw LogLines.
+#if !defined(DETAILED_LOG) && !defined(RAW_50HZ_LOG)
+#define LOG_DELTA_FORMAT 1
+#endif
+
 struct LogIndex
 {
 	int  page_num;
 	long date;
 	long time;
-	long boot_sequence; // Gps OK, Ppm OK, Reboot
+	// Session start in the global page sequence (see log_sequence in
+	// task_datalogger.c); 0 = unused entry, the lowest one gets recycled.
+	// Same size and offset as the never-used boot_sequence it replaced.
+	unsigned long sequence;
 };
 
 extern struct LogIndex datalogger_index_table[MAX_INDEX];
@@ -98,8 +110,21 @@ struct LogLine
 	char  control_state;        // 1
 	char temperature_c;         // 1
 	int  height_m;              // 2
-	int  navigation_code_line;  // 2 
+	int  navigation_code_line;  // 2
     unsigned int servo_trigger; // 2 = 44
+	int p;                      // 2   gyro rates in deg/s, mainly for the
+	int q;                      // 2   50Hz control-tuning mode
+	int r;                      // 2 = 50
+	unsigned long time_ms;      // 4 = 54  timer_millis() at the write, for
+	                            //         correlating log and telemetry
+	long pps_offset_ms;         // 4 = 58  gps ms-of-day minus timer_millis()
+	                            //         at the last pps edge, see lib/pps
+	unsigned char cpu_load;     // 1 = 59  cpuload_percent() at the write
+#ifdef AHRS_SHADOW
+	int shadow_pitch;           // 2       shadow ahrs attitude, deg
+	int shadow_roll;            // 2
+	unsigned long ahrs_cycles;  // 4 = 67  shadow << 16 | primary, cycles/4
+#endif
 };
 
 #endif
@@ -108,13 +133,26 @@ struct LogLine
 
 void datalogger_init();
 void datalogger_writeline(struct LogLine *line);
+
+//! Producer side of the log ring: the control task calls this at the end of
+//! every cycle; it samples the sensor/control state, rate-limits itself and
+//! commits the LogLine lock-free. datalogger_task drains the ring into
+//! dataflash pages, so the control loop never waits on the flash.
+void datalogger_collect();
+
+//! LogLines dropped because the ring was full (flash stalled beyond 320ms).
+extern unsigned int log_ring_drops;
+
 void datalogger_task( void *parameters );
 void datalogger_format();
 int datalogger_print_next_page(int index, void(*printer)(struct LogLine*));
 int datalogger_print_next_page_of_all(int index, void(*printer)(struct LogLine*));
+int datalogger_stream_page(int page);
+int datalogger_stream_pages(int start_page, int count);
 
 void datalogger_enable();
 void datalogger_disable();
+void datalogger_set_highrate(int enable);
 
 
 
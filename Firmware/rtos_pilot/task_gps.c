@@ -7,14 +7,20 @@
 #include "FreeRTOS/semphr.h"
 
 #include "gps/gps.h"
+#include "pps/pps.h"
 #include "uart1_queue/uart1_queue.h"
 #include "task_gps.h"
 #include "led/led.h"
+#include "timer/timer.h"
 
 #include "configuration.h"
 #include "common.h"
+#include "communication.h"
 #include "gluonscript.h"
 #include "handler_navigation.h"
+#include "heartbeat.h"
+#include "bootstats.h"
+#include "mirror.h"
 
 
 /*!
@@ -35,6 +41,10 @@ xSemaphoreHandle xGpsSemaphore = NULL;
 void sensors_gps_task( void *parameters )
 {
 	int i = 0;
+	int hb;
+	int bp;
+	unsigned long script_due_ms, last_fix_ms, now_ms;
+	long wait_ms;
 
 #ifdef F1E_STEERING
 	/*while(1)
@@ -53,6 +63,64 @@ void sensors_gps_task( void *parameters )
 
 	gluonscript_init();
 
+	if (telemetry_uart2_enabled())
+	{
+		// The wired telemetry port claimed uart2 (S2 command), so there is
+		// no gps this session; park the task instead of opening the port.
+		uart1_puts("Gps task: uart2 is in wired telemetry mode\r\n");
+		for( ;; )
+			vTaskDelay( ( ( portTickType ) 1000 / portTICK_RATE_MS ) );
+	}
+
+	if (config.telemetry.mirror == MIRROR_BACKUP)
+	{
+		// Redundancy backup (SX command): uart2 carries the primary's
+		// mirror stream instead of a gps. Shadow it - the script follows
+		// the primary's codeline and the mirrored gps solution feeds
+		// sensor_data.gps - so a failover through the external servo mux
+		// continues the same flight plan leg with warm navigation state.
+		// The script tick keeps running on the local clock the whole time.
+		int ch;
+
+		uart1_puts("Gps task: uart2 is in mirror backup mode\r\n");
+		gps_open_raw(MIRROR_BAUDRATE, MIRROR_FRAME_BYTES);
+		script_due_ms = timer_millis() + 1000 / GLUONSCRIPT_HZ;
+		hb = heartbeat_register("GpsNavi", 1000);
+		for( ;; )
+		{
+			heartbeat_checkin(hb);
+
+			wait_ms = (long) (script_due_ms - timer_millis());
+			if (wait_ms < 0)
+				wait_ms = 0;
+			if( xSemaphoreTake( xGpsSemaphore, ( portTickType ) wait_ms / portTICK_RATE_MS ) == pdTRUE )
+			{
+				while ((ch = gps_raw_getc()) >= 0)
+				{
+					if (mirror_receive_char((unsigned char)ch))
+						mirror_apply();
+				}
+			}
+
+			if (timer_millis() - mirror_shadow.last_update_ms > 1000)
+			{
+				// stale mirror: stop trusting the position, like a gps dropout
+				sensor_data.gps.status = EMPTY;
+				sensor_data.gps.satellites_in_view = 0;
+			}
+
+			now_ms = timer_millis();
+			if ((long) (now_ms - script_due_ms) >= 0)
+			{
+				gluonscript_do();
+				script_due_ms += 1000 / GLUONSCRIPT_HZ;
+				if ((long) (now_ms - script_due_ms) >= 0)
+					script_due_ms = now_ms + 1000 / GLUONSCRIPT_HZ;
+			}
+		}
+	}
+
+	bp = bootstats_begin("gps detect");
 	gps_open_port(&(config.gps));
 
 	// Wait for GPS output. On some old EB85 devices, this can take over 2sec
@@ -61,42 +129,69 @@ void sensors_gps_task( void *parameters )
 		if (! gps_valid_frames_receiving())
 			vTaskDelay( ( ( portTickType ) i / portTICK_RATE_MS ) );
 	}
+	bootstats_end(bp);
 
 
+	bp = bootstats_begin("gps config");
 	gps_config_output();  // configure sentences and switch to 115200 baud
+	bootstats_end(bp);
 
 
 	vTaskDelay(( ( portTickType ) 100 / portTICK_RATE_MS ) );
 
+	// gluonscript used to be clocked by the GPS wakeups, which froze the
+	// script - time based UNTIL conditions, alarms, camera triggers - on
+	// a GPS dropout. It now runs off the millisecond clock at a fixed
+	// GLUONSCRIPT_HZ and the GPS data is consumed whenever it is fresh.
+	script_due_ms = timer_millis() + 1000 / GLUONSCRIPT_HZ;
+	last_fix_ms = timer_millis();
+
 	uart1_puts("Gps & Navigation task initialized\r\n");
 	if (sensor_data.gps.status == EMPTY)
 		led2_off();
 	else if (sensor_data.gps.status == VOID)
 		led2_on();
 
+	// the script tick bounds the semaphore wait, so the loop keeps turning
+	// even without a gps; only a wedged uart2 (or a parser that never
+	// returns) stops the check-ins
+	hb = heartbeat_register("GpsNavi", 1000);
+
 	//portTickType xLastExecutionTime = xTaskGetTickCount();
 	for( ;; )
 	{
-		/* Wait until it is time for the next cycle. */
+		heartbeat_checkin(hb);
+
+		/* Wait for a sentence, but never past the next script tick. */
 		if (control_state.simulation_mode)
 		{
 			i++;
-			vTaskDelay(( ( portTickType ) 100 / portTICK_RATE_MS ) );
+			vTaskDelay(( ( portTickType ) (1000 / GLUONSCRIPT_HZ) / portTICK_RATE_MS ) );
 			sensor_data.gps.satellites_in_view = 9;
 			sensor_data.gps.status = ACTIVE;
-		}
-		else if( xSemaphoreTake( xGpsSemaphore, ( portTickType ) 205 / portTICK_RATE_MS ) == pdTRUE )
-		{
-			gps_update_info(&(sensor_data.gps)); // 5Hz (needed?)
-			i++;
+			last_fix_ms = timer_millis();
 		}
 		else
 		{
-			// alert: no message received from GPS!
-			sensor_data.gps.status = EMPTY;
-			led2_off();
-			i = 0;
-			sensor_data.gps.satellites_in_view = 0;
+			wait_ms = (long) (script_due_ms - timer_millis());
+			if (wait_ms < 0)
+				wait_ms = 0;
+			if( xSemaphoreTake( xGpsSemaphore, ( portTickType ) wait_ms / portTICK_RATE_MS ) == pdTRUE )
+			{
+				gps_update_info(&(sensor_data.gps)); // 5 or 10Hz (needed?)
+				if (sensor_data.gps.status == ACTIVE)
+					pps_label_second(sensor_data.gps.time);
+				last_fix_ms = timer_millis();
+				i++;
+			}
+			else if (timer_millis() - last_fix_ms > 205)
+			{
+				// alert: no message received from GPS!
+				sensor_data.gps.status = EMPTY;
+				led2_off();
+				i = 0;
+				sensor_data.gps.satellites_in_view = 0;
+			}
 		}
 
 		// Speed is use for calculating accelerations (in the attitude filter)
@@ -105,8 +200,14 @@ void sensors_gps_task( void *parameters )
 		if (sensor_data.gps.satellites_in_view < 4 && navigation_data.airborne)
 				sensor_data.gps.speed_ms = config.control.cruising_speed_ms;
 
-		if (i % 2 == 0) // this is used for both RMC and GGA, so only update every other tick
+		now_ms = timer_millis();
+		if ((long) (now_ms - script_due_ms) >= 0)
+		{
 			gluonscript_do();
+			script_due_ms += 1000 / GLUONSCRIPT_HZ;
+			if ((long) (now_ms - script_due_ms) >= 0)   // fell behind by over a period: don't burst to catch up
+				script_due_ms = now_ms + 1000 / GLUONSCRIPT_HZ;
+		}
 
 		if ((i % 6 == 0 || (i+1) % 6 == 0 || (i+2) % 6 == 0) &&  sensor_data.gps.status == ACTIVE && sensor_data.gps.satellites_in_view > 5)
 			led2_off();
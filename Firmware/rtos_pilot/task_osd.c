@@ -1,6 +1,7 @@
- 
+
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "FreeRTOS/FreeRTOS.h"
 #include "FreeRTOS/task.h"
@@ -9,6 +10,7 @@
 #include "FreeRTOS/semphr.h"
 
 #include "max7456/max7456.h"
+#include "microcontroller/spi_bus.h"
 #include "button/button.h"
 #include "ppm_in/ppm_in.h"
 #include "adc/adc.h"
@@ -20,8 +22,7 @@
 #include "configuration.h"
 #include "sensors.h"
 #include "handler_navigation.h"
-
-extern xSemaphoreHandle xSpiSemaphore;
+#include "heartbeat.h"
 
 
 // Other characters
@@ -44,6 +45,24 @@ const unsigned char heading45[] = {219, 218, 217, 224, 223, 222, 221, 220};
 const unsigned char number_large[] = {0x0A, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09};
 const unsigned char number_small[] = {0x7A, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79};
 
+//! One slot per numeric field on screen; the slot remembers the last value
+//! it rendered so an unchanged value skips digit extraction completely.
+enum osd_field_slot
+{
+    FIELD_SPEED = 0,
+    FIELD_LINK,
+    FIELD_VOLT1,
+    FIELD_VOLT2,
+    FIELD_CURRENT,
+    FIELD_MAH,
+    OSD_MAX_FIELDS
+};
+
+void osd_fields_init();
+void osd_fields_invalidate();
+void osd_print_field(enum osd_field_slot slot, long value, int row, int col, int width,
+                     unsigned char point, unsigned char unit, int small);
+
 int home_heading_deg = 0;
 
 int osd_input_available();
@@ -57,6 +76,9 @@ void osd_write_char(unsigned char x);
 void osd_write_string(const unsigned char *x);
 void osd_write_ascii_char(unsigned char x, int small);
 void osd_write_ascii_string(unsigned char *x, int small);
+void osd_advance_position();
+void osd_clear_screen();
+void osd_flush_frame();
 void osd_print_static_data();
 void osd_print_integer(int num, int row, int col, int small);
 void print_meters(int row, int col, int m, int small);
@@ -95,6 +117,27 @@ enum menu active_menu = BLOCKS;
 
 int last_roll_ppm;
 
+// Keep a RAM shadow of the 30x16 character screen and only transmit the characters
+// that changed since the previous frame, runs of changes going out in one MAX7456
+// auto-increment burst. A full redraw used to hold the SPI bus for 6 register
+// writes per character, starving the dataflash logging on the shared SPI bus.
+#define OSD_SHADOW_BUFFER
+
+// Upper bound on the SPI bytes one osd_flush_frame() call may transmit
+// (2 per register write, 1 per auto-increment character). Bounding the
+// bus occupancy of every 200ms slot - instead of only yielding when the
+// datalogger asks - is what actually guarantees the flash page cadence:
+// a full redraw (480 characters after a clear) now spreads over ~4
+// frames instead of going out in one long burst.
+#define OSD_FLUSH_BUDGET_BYTES 160
+
+#ifdef OSD_SHADOW_BUFFER
+#define OSD_SCREEN_SIZE (16*30)
+static unsigned char osd_shadow[OSD_SCREEN_SIZE];   // what the print functions drew this frame
+static unsigned char osd_sent[OSD_SCREEN_SIZE];     // what the MAX7456 display memory contains
+static int osd_cursor = 0;
+#endif
+
 /*
  *
  *   Used stackspace: 260 / 430
@@ -104,6 +147,7 @@ void osd_task( void *parameters )
 	/* Used to wake the task at the correct frequency. */
 	portTickType xLastExecutionTime; 
 	int i;
+	int hb;
 	
 	
 	uart1_puts("OSD task initializing...\r\n");
@@ -127,11 +171,12 @@ void osd_task( void *parameters )
 	xLastExecutionTime = xTaskGetTickCount();
 	vTaskDelay( ( ( portTickType )100 / portTICK_RATE_MS ) );   // 5Hz
 	
-    spiWriteReg(0x04, 0x04); // clear
+    osd_fields_init();
+    osd_clear_screen();
 
 
     osd_print_gluonpilot_logo(5, 8);
-    spiWriteReg(0x04, 0x04); // clear
+    osd_clear_screen();
     osd_print_gluonpilot_logo(5, 8);
     osd_print_centered(10, "  Menu >", 0);
     osd_print_centered(14, "http://www.gluonpilot.com", 0);
@@ -146,21 +191,25 @@ void osd_task( void *parameters )
             osd_write_char(ball++);
         }
     }
+    osd_flush_frame();
 
-    spiWriteReg(0x04, 0x04); // clear
+    osd_clear_screen();
     //osd_print_static_data();
 
+	hb = heartbeat_register("OSD", 1000);   // 200ms loop, with slack for the menus
+
 	for( ;; )
 	{
 		vTaskDelayUntil( &xLastExecutionTime, ( ( portTickType ) 200 / portTICK_RATE_MS ) );   // 5Hz
+		heartbeat_checkin(hb);
 
-        if (xSemaphoreTake( xSpiSemaphore, ( portTickType ) 0 ) == pdTRUE )  // only execute this when SPI port is available
+        if (spi_bus_take( SPI_BUS_PRIORITY_OSD, ( portTickType ) 0 ) == pdTRUE )  // only execute this when SPI port is available
         {
             //vTaskDelay( ( ( portTickType ) 1 / portTICK_RATE_MS ) );   // 5Hz
             
             if (do_clear_screen)
             {
-                spiWriteReg(0x04, 0x04);
+                osd_clear_screen();
                 do_clear_screen = 0;
             }
 
@@ -183,10 +232,12 @@ void osd_task( void *parameters )
                 osd_menu_osd();
 
             last_roll_ppm = ppm.channel[config.control.channel_roll];
-            
-            xSemaphoreGive( xSpiSemaphore );
+
+            osd_flush_frame();
+
+            spi_bus_give();
         } else
-            printf("\r\nSPI OSD not available\r\n");
+            uart1_printf("\r\nSPI OSD not available\r\n");
 	}
 }
 
@@ -260,7 +311,7 @@ void osd_menu_blocks()
                     selected_blocknum--;
                     if (selected_blocknum == 0)
                     {
-                        printf("\r\nOSD: new block selected\r\n");
+                        uart1_printf("\r\nOSD: new block selected\r\n");
                         gluonscript_data.current_codeline = i;
                         active_menu = OSD;
                         do_clear_screen = 1;
@@ -502,7 +553,7 @@ void osd_print_rcinfo(int small)
             link_pct = 0;
         else if (link_pct > 100)
             link_pct = 100;
-        //printf("\r\n%u %d\r\n", adc_get_channel(3), link_pct);
+        //uart1_printf("\r\n%u %d\r\n", adc_get_channel(3), link_pct);
     }
     else if (config.osd.rssi >= Ch1)
     {
@@ -520,142 +571,34 @@ void osd_print_rcinfo(int small)
 
 	//if (no_frame_times_20_s > 50)
 	//	no_frame_times_20_s = 50;
-	osd_print_integer(link_pct, 1, 3, small);
-	osd_write_ascii_char('%', small);
-
-    if (link_pct < 100)
-    {
-        osd_set_position (1, 6);
-		osd_write_char(0x00);
-    }
-    if (link_pct < 10)
-    {
-        osd_set_position (1, 5);
-		osd_write_char(0x00);
-    } else if (link_pct == 100)
-    {
-        osd_set_position (1, 7);
-		osd_write_char(0x00);
-    }
-
+	osd_print_field(FIELD_LINK, link_pct, 1, 3, 4, 0x00, 0x95, small);
 }
 
 #define VOLTAGE_LINE 14
 void osd_print_voltage1(int small)
 {
-    const unsigned char* number;
-    if (small)
-        number = number_small;
-    else
-        number = number_large;
-    
     osd_set_position(VOLTAGE_LINE, 1);
     osd_write_char(0xE4);
 
-    int volt10 = sensor_data.battery1_voltage_10;
-    int decrement = 1;
-	if (volt10 >= 100)  // > 10v0
-	{
-		osd_set_position (VOLTAGE_LINE, 2);
-		osd_write_char(number[1]);
-		volt10 = volt10 % 100;
-        decrement = 0;
-	}
-	osd_set_position (VOLTAGE_LINE, 3 - decrement);
-	osd_write_char(number[volt10/10]);
-	osd_set_position (VOLTAGE_LINE, 4 - decrement);
-	osd_write_char(0x9E);
-	osd_set_position (VOLTAGE_LINE, 5 - decrement);
-	osd_write_char(number[volt10%10]);
+    osd_print_field(FIELD_VOLT1, (long)sensor_data.battery1_voltage_10, VOLTAGE_LINE, 2, 4, 0x9E, 0x00, small);
 }
 
 void osd_print_voltage2(int small)
 {
-    const unsigned char* number;
-    if (small)
-        number = number_small;
-    else
-        number = number_large;
-
     osd_set_position(VOLTAGE_LINE-1, 1);
     osd_write_char(0xE5);
 
-    int current10 = sensor_data.battery2_voltage_10;
-    int decrement = 1;
-	if (current10 >= 100)  // > 10v0
-	{
-		osd_set_position (VOLTAGE_LINE-1, 2);
-		osd_write_char(number[1]);
-		current10 = current10 % 100;
-        decrement = 0;
-	}
-	osd_set_position (VOLTAGE_LINE-1, 3 - decrement);
-	osd_write_char(number[current10/10]);
-	osd_set_position (VOLTAGE_LINE-1, 4 - decrement);
-	osd_write_char(0x9E);
-	osd_set_position (VOLTAGE_LINE-1, 5 - decrement);
-	osd_write_char(number[current10%10]);
+    osd_print_field(FIELD_VOLT2, (long)sensor_data.battery2_voltage_10, VOLTAGE_LINE-1, 2, 4, 0x9E, 0x00, small);
 }
 
 void osd_print_current1(int small)
 {
-    const unsigned char* number;
-    if (small)
-        number = number_small;
-    else
-        number = number_large;
-
-    int current10 = (int)(sensor_data.battery1_current * 10.0);
-    int decrement = 1;
-	if (current10 >= 100)  // > 10v0
-	{
-		osd_set_position (VOLTAGE_LINE, 15);
-		osd_write_char(number[1]);
-		current10 = current10 % 100;
-        decrement = 0;
-	}
-	osd_set_position (VOLTAGE_LINE, 16 - decrement);
-	osd_write_char(number[current10/10]);
-	osd_set_position (VOLTAGE_LINE, 17 - decrement);
-	//osd_write_char(0x5A);
-    osd_write_char(0x9D);
-	osd_set_position (VOLTAGE_LINE, 18 - decrement);
-	osd_write_char(number[current10%10]);
+    osd_print_field(FIELD_CURRENT, (long)(sensors_battery1_current() * 10.0), VOLTAGE_LINE, 15, 4, 0x9D, 0x00, small);
 }
 
 void osd_print_mah1(int small)
 {
-    int mah = sensor_data.battery1_mAh;
-    int decrement = 1;
-    const unsigned char* number;
-    if (small)
-        number = number_small;
-    else
-        number = number_large;
-
-	if (mah >= 1000)
-	{
-		osd_set_position (VOLTAGE_LINE, 8);
-		osd_write_char(number[mah/1000]);
-		mah = mah % 1000;
-        decrement = 0;
-	}
-    if (mah >= 100)
-	{
-        osd_set_position (VOLTAGE_LINE, 9 - decrement);
-        osd_write_char(number[mah/100]);
-        mah = mah % 100;
-    }
-    if (mah >= 10)
-    {
-        osd_set_position (VOLTAGE_LINE, 10 - decrement);
-        osd_write_char(number[mah/10]);
-        mah = mah % 10;
-    }
-	osd_set_position (VOLTAGE_LINE, 11 - decrement);
-	osd_write_char(number[mah]);
-    osd_set_position (VOLTAGE_LINE, 12 - decrement);
-	osd_write_char(0x64);
+    osd_print_field(FIELD_MAH, (long)sensors_battery1_mAh(), VOLTAGE_LINE, 8, 5, 0x00, 0x64, small);
 }
 
 void osd_print_speed(int small)
@@ -666,26 +609,7 @@ void osd_print_speed(int small)
 	else  // to mph
 		speed = sensor_data.gps.speed_ms * (3.6 * 0.62);
 
-	osd_print_integer((int) speed, 7, 2, small);
-	if (use_metric)
-    {
-		osd_write_char(0x65);
-    }
-	else
-    {
-		osd_write_char(0x66);
-    }
-        
-    if (speed < 10)
-    {
-        osd_set_position (7, 4);
-        osd_write_char(0x00);
-    }
-    if (speed < 100)
-    {
-        osd_set_position (7, 5);
-        osd_write_char(0x00);
-    }
+	osd_print_field(FIELD_SPEED, (long)speed, 7, 2, 4, 0x00, use_metric ? 0x65 : 0x66, small);
 }
 
 void osd_print_fly_time(int small)
@@ -741,8 +665,8 @@ void osd_print_fly_time(int small)
 
 void osd_print_home_distance(int small)
 {
-    int home_distance = (int) navigation_distance_between_meter(sensor_data.gps.longitude_rad, navigation_data.home_longitude_rad,
-	                                                            sensor_data.gps.latitude_rad, navigation_data.home_latitude_rad);
+    int home_distance = (int) navigation_distance_between_meter_int(sensor_data.gps.longitude_deg_1e7, navigation_data.home_longitude_1e7,
+	                                                                sensor_data.gps.latitude_deg_1e7, navigation_data.home_latitude_1e7);
     //osd_set_position(12, 16);
 	//osd_write_char(DISTANCE_M);
 	print_meters(12,13,home_distance, small);
@@ -887,6 +811,80 @@ float gravity_to_pitch2(float a_x, float a_z)
 }
 
 #define AH_LINE_START 4
+
+//! Precomputed horizon slopes: entry [bucket][i-1] is (int)(tan(roll)*18*i/7),
+//! the vertical offset of horizon column offset i = 1..7 (the left half
+//! mirrors by sign). 64 roll buckets spanning +/-60 degree; steeper rolls
+//! clamp to the outermost bucket and mostly fall off screen anyway.
+#define HORIZON_ROLL_BUCKETS 64
+#define HORIZON_ROLL_MAX_RAD 1.0472f   // 60 degree
+static const signed char horizon_slope[HORIZON_ROLL_BUCKETS][7] = {
+	{   -4,   -8,  -12,  -17,  -21,  -25,  -30 },
+	{   -3,   -7,  -11,  -15,  -19,  -23,  -27 },
+	{   -3,   -7,  -11,  -14,  -18,  -22,  -26 },
+	{   -3,   -6,  -10,  -13,  -17,  -20,  -24 },
+	{   -3,   -6,   -9,  -12,  -16,  -19,  -22 },
+	{   -3,   -6,   -9,  -12,  -15,  -18,  -21 },
+	{   -2,   -5,   -8,  -11,  -14,  -17,  -19 },
+	{   -2,   -5,   -7,  -10,  -13,  -15,  -18 },
+	{   -2,   -4,   -7,   -9,  -12,  -14,  -17 },
+	{   -2,   -4,   -6,   -9,  -11,  -13,  -16 },
+	{   -2,   -4,   -6,   -8,  -10,  -13,  -15 },
+	{   -2,   -4,   -6,   -8,  -10,  -12,  -14 },
+	{   -1,   -3,   -5,   -7,   -9,  -11,  -13 },
+	{   -1,   -3,   -5,   -7,   -8,  -10,  -12 },
+	{   -1,   -3,   -4,   -6,   -8,   -9,  -11 },
+	{   -1,   -3,   -4,   -6,   -7,   -9,  -10 },
+	{   -1,   -2,   -4,   -5,   -7,   -8,  -10 },
+	{   -1,   -2,   -3,   -5,   -6,   -7,   -9 },
+	{   -1,   -2,   -3,   -4,   -6,   -7,   -8 },
+	{   -1,   -2,   -3,   -4,   -5,   -6,   -7 },
+	{   -1,   -2,   -3,   -4,   -5,   -6,   -7 },
+	{    0,   -1,   -2,   -3,   -4,   -5,   -6 },
+	{    0,   -1,   -2,   -3,   -4,   -4,   -5 },
+	{    0,   -1,   -2,   -2,   -3,   -4,   -5 },
+	{    0,   -1,   -1,   -2,   -3,   -3,   -4 },
+	{    0,   -1,   -1,   -2,   -2,   -3,   -3 },
+	{    0,    0,   -1,   -1,   -2,   -2,   -3 },
+	{    0,    0,   -1,   -1,   -1,   -2,   -2 },
+	{    0,    0,    0,   -1,   -1,   -1,   -2 },
+	{    0,    0,    0,    0,   -1,   -1,   -1 },
+	{    0,    0,    0,    0,    0,    0,    0 },
+	{    0,    0,    0,    0,    0,    0,    0 },
+	{    0,    0,    0,    0,    0,    0,    0 },
+	{    0,    0,    0,    0,    0,    0,    0 },
+	{    0,    0,    0,    0,    1,    1,    1 },
+	{    0,    0,    0,    1,    1,    1,    2 },
+	{    0,    0,    1,    1,    1,    2,    2 },
+	{    0,    0,    1,    1,    2,    2,    3 },
+	{    0,    1,    1,    2,    2,    3,    3 },
+	{    0,    1,    1,    2,    3,    3,    4 },
+	{    0,    1,    2,    2,    3,    4,    5 },
+	{    0,    1,    2,    3,    4,    4,    5 },
+	{    0,    1,    2,    3,    4,    5,    6 },
+	{    1,    2,    3,    4,    5,    6,    7 },
+	{    1,    2,    3,    4,    5,    6,    7 },
+	{    1,    2,    3,    4,    6,    7,    8 },
+	{    1,    2,    3,    5,    6,    7,    9 },
+	{    1,    2,    4,    5,    7,    8,   10 },
+	{    1,    3,    4,    6,    7,    9,   10 },
+	{    1,    3,    4,    6,    8,    9,   11 },
+	{    1,    3,    5,    7,    8,   10,   12 },
+	{    1,    3,    5,    7,    9,   11,   13 },
+	{    2,    4,    6,    8,   10,   12,   14 },
+	{    2,    4,    6,    8,   10,   13,   15 },
+	{    2,    4,    6,    9,   11,   13,   16 },
+	{    2,    4,    7,    9,   12,   14,   17 },
+	{    2,    5,    7,   10,   13,   15,   18 },
+	{    2,    5,    8,   11,   14,   17,   19 },
+	{    3,    6,    9,   12,   15,   18,   21 },
+	{    3,    6,    9,   12,   16,   19,   22 },
+	{    3,    6,   10,   13,   17,   20,   24 },
+	{    3,    7,   11,   14,   18,   22,   26 },
+	{    3,    7,   11,   15,   19,   23,   27 },
+	{    4,    8,   12,   17,   21,   25,   30 },
+};
+
 void osd_print_artificial_horizon2()
 {
     static int previous_positions[16] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
@@ -901,13 +899,20 @@ void osd_print_artificial_horizon2()
     // 6 vertical positions => 6 * 6 = 36 possible positions (18 up & down)
     int pitch_increment = (int)(sensor_data.pitch*(180.0/3.14/FOV_V*18.0)) + 3;
 
-    //double FOV_H =
-    float tanroll = tanf(sensor_data.roll);
+    // roll -> slope table bucket; replaces the per frame tanf()
+    int bucket = (int)((sensor_data.roll + HORIZON_ROLL_MAX_RAD) *
+                       ((float)HORIZON_ROLL_BUCKETS / (2.0f * HORIZON_ROLL_MAX_RAD)));
+    if (bucket < 0)
+        bucket = 0;
+    else if (bucket >= HORIZON_ROLL_BUCKETS)
+        bucket = HORIZON_ROLL_BUCKETS - 1;
+    const signed char *slope = horizon_slope[bucket];
+
     for (i = -7; i < 8; i++) // -0.7..0.7 -> -18..18
     {
         if (i == 0)
             continue;
-        int y = 18 - (int)(tanroll / 1.0f * 18.0f * ((float)i/7.0f) ) + pitch_increment;  // -45..45 -> 0..36
+        int y = 18 - (i > 0 ? (int)slope[i-1] : -(int)slope[-i-1]) + pitch_increment;  // -45..45 -> 0..36
         // y = -18..18 => 3..7 = 3 + (y+18)
         // hor: 7..14..21    ver: 3.3 .. 7.1 (15 stappen) -> 1..8..15
         if (y <= 36 && y >= 0)
@@ -933,7 +938,7 @@ void osd_print_artificial_horizon()
         osd_write_char(0x00);
     }
 
-	int pitch_increment = (int)(sensor_data.pitch*(180.0/3.14/22.0*7.0));   // > 22� = out of screen
+	int pitch_increment = (int)(sensor_data.pitch*(180.0/3.14/22.0*7.0));   // > 22� = out of screen
 	// hor: 7..14..21    ver: 3.3 .. 7.1 (15 stappen) -> 1..8..15
 	//// optimize me: precalculated tanf
 	int y7 = 8 - (int)(tanf(sensor_data.roll)*-10.8) + pitch_increment;
@@ -1066,14 +1071,14 @@ void print_meters(int row, int col, int m, int small)
 			
 			osd_print_integer((m % 1000) / 100, row, col, small);
 			osd_write_char(DISTANCE_KM); // km
-            spiWriteReg(DM_ADDRL_WRITE, spiReadReg(DM_ADDRL_READ)+1);
+            osd_advance_position();
 			osd_write_char(0x00);
 		}
 		else
 		{
 			osd_print_integer(m, row, col, small);
 			osd_write_char(DISTANCE_M); // m
-            spiWriteReg(DM_ADDRL_WRITE, spiReadReg(DM_ADDRL_READ)+1);
+            osd_advance_position();
 			osd_write_char(0x00);
 		}		
 	} 
@@ -1092,14 +1097,14 @@ void print_meters(int row, int col, int m, int small)
 			
 			osd_print_integer((m % 5280) / 528, row, col, small);
 			osd_write_char(DISTANCE_MI); // mi
-            spiWriteReg(DM_ADDRL_WRITE, spiReadReg(DM_ADDRL_READ)+1);
+            osd_advance_position();
 			osd_write_char(0x00);
 		}
 		else
 		{
 			osd_print_integer(m, row, col, small);
 			osd_write_char(DISTANCE_FT); // ft
-            spiWriteReg(DM_ADDRL_WRITE, spiReadReg(DM_ADDRL_READ)+1);
+            osd_advance_position();
 			osd_write_char(0x00); 
 		}		
 	}	
@@ -1160,6 +1165,113 @@ void osd_print_integer(int num, int row, int col, int small)
 	}
 }	
 
+// ---- numeric field composition --------------------------------------------
+// The shadow buffer keeps the previous frame, so a field whose value did not
+// change needs no redraw work at all - not even digit extraction. Changed
+// values render right-aligned from a pre-rendered strip of "00".."99" glyph
+// pairs: one division per two digits instead of one per digit.
+
+static long osd_field_value[OSD_MAX_FIELDS];
+static unsigned char osd_field_valid[OSD_MAX_FIELDS];
+static unsigned char pair_strip_large[200];   // glyph pairs for "00".."99"
+static unsigned char pair_strip_small[200];
+
+void osd_fields_init()
+{
+	int i;
+	for (i = 0; i < 100; i++)
+	{
+		pair_strip_large[i*2]   = number_large[i/10];
+		pair_strip_large[i*2+1] = number_large[i%10];
+		pair_strip_small[i*2]   = number_small[i/10];
+		pair_strip_small[i*2+1] = number_small[i%10];
+	}
+	osd_fields_invalidate();
+}
+
+//! The screen no longer shows what the slots rendered (e.g. after a clear):
+//! force every field to redraw on its next print.
+void osd_fields_invalidate()
+{
+	int i;
+	for (i = 0; i < OSD_MAX_FIELDS; i++)
+		osd_field_valid[i] = 0;
+}
+
+/*!
+ *    Right-aligned numeric field of fixed width cells ending at column
+ *    col+width-1: optional unit glyph, optional decimal point glyph before
+ *    the last digit (point != 0 means value is in tenths), leading blanks.
+ *    Returns immediately when the slot already shows this value.
+ */
+void osd_print_field(enum osd_field_slot slot, long value, int row, int col, int width,
+                     unsigned char point, unsigned char unit, int small)
+{
+	const unsigned char *strip = small ? pair_strip_small : pair_strip_large;
+	const unsigned char *number = small ? number_small : number_large;
+	int pos = col + width - 1;
+	long v = value;
+	int negative = 0;
+
+	if (osd_field_valid[slot] && osd_field_value[slot] == value)
+		return;
+	osd_field_value[slot] = value;
+	osd_field_valid[slot] = 1;
+
+	if (v < 0)
+	{
+		negative = 1;
+		v = -v;
+	}
+
+	if (unit)
+	{
+		osd_set_position(row, pos--);
+		osd_write_char(unit);
+	}
+	if (point)
+	{
+		osd_set_position(row, pos--);
+		osd_write_char(number[v % 10]);
+		osd_set_position(row, pos--);
+		osd_write_char(point);
+		v /= 10;
+	}
+	while (v >= 100 && pos >= col + 1)   // two digits per division
+	{
+		const unsigned char *pair = & strip[(v % 100) * 2];
+		osd_set_position(row, pos--);
+		osd_write_char(pair[1]);
+		osd_set_position(row, pos--);
+		osd_write_char(pair[0]);
+		v /= 100;
+	}
+	if (v >= 10 && pos >= col + 1)
+	{
+		const unsigned char *pair = & strip[v * 2];
+		osd_set_position(row, pos--);
+		osd_write_char(pair[1]);
+		osd_set_position(row, pos--);
+		osd_write_char(pair[0]);
+	}
+	else if (pos >= col)
+	{
+		osd_set_position(row, pos--);
+		osd_write_char(number[v % 10]);   // % 10: a too narrow field drops high digits
+	}
+	if (negative && pos >= col)
+	{
+		osd_set_position(row, pos--);
+		osd_write_char(0x49);   // '-'
+	}
+	while (pos >= col)   // blank the cells the value does not need
+	{
+		osd_set_position(row, pos--);
+		osd_write_char(0x00);
+	}
+}
+
+
 /*!
  *    Initialize the OSD. Return 0 if no OSD is found.
  */
@@ -1167,7 +1279,7 @@ int osd_initialize(portTickType *xLastExecutionTime)
 {
 	char x;
 
-    if (xSemaphoreTake( xSpiSemaphore, ( portTickType ) 1000 ) == pdTRUE )
+    if (spi_bus_take( SPI_BUS_PRIORITY_OSD, ( portTickType ) 1000 ) == pdTRUE )
     {
         max7456_init();
 
@@ -1178,8 +1290,8 @@ int osd_initialize(portTickType *xLastExecutionTime)
         vTaskDelay( ( portTickType ) 100 / portTICK_RATE_MS );
         if (spiReadReg(VIDEO_MODE_0_READ) != VIDEO_MODE_0_40_PAL)
         {
-            printf("no OSD found!\r\n");
-            xSemaphoreGive( xSpiSemaphore );
+            uart1_printf("no OSD found!\r\n");
+            spi_bus_give();
             return 0;
         }
 
@@ -1216,11 +1328,11 @@ int osd_initialize(portTickType *xLastExecutionTime)
         spiWriteReg(0x6C, x);
         vTaskDelayUntil( xLastExecutionTime, ( ( portTickType ) 1 / portTICK_RATE_MS ) );
         spiWriteReg(0x04, 0x00);
-        xSemaphoreGive( xSpiSemaphore );
+        spi_bus_give();
     }
     else
     {
-        printf("\r\nCould not initialize OSD\r\n");
+        uart1_printf("\r\nCould not initialize OSD\r\n");
     }
 	return 1;
 }
@@ -1295,6 +1407,168 @@ char osd_get_char(int c, int small)
 }
 
 
+#ifdef OSD_SHADOW_BUFFER
+
+/*!
+ *    Set the cursor of the OSD.
+ *    Row = 0..15, Column = 0..29
+ */
+void osd_set_position(int row, int column)
+{
+	osd_cursor = (row * 30) + column;
+}
+
+
+void osd_write_char(unsigned char x)
+{
+	if (osd_cursor < 0 || osd_cursor >= OSD_SCREEN_SIZE)
+		return;
+	if (x == 0xFF)         // 0xFF ends an auto-increment burst: it can never be transmitted
+		x = 0x00;
+	osd_shadow[osd_cursor] = x;
+}
+
+
+/*!
+ *    Advance the cursor one position without writing (keeps the character on screen).
+ */
+void osd_advance_position()
+{
+	osd_cursor++;
+}
+
+
+/*!
+ *   Write string x (ended with '\0');
+ */
+void osd_write_string(const unsigned char *x)
+{
+	while (*x != 0x00)
+	{
+		osd_write_char(*x++);
+		osd_cursor++;
+	}
+}
+
+
+void osd_write_ascii_char(unsigned char x, int small)
+{
+	osd_write_char(osd_get_char(x, small));
+}
+
+
+void osd_write_ascii_string(unsigned char *x, int small)
+{
+	while (*x != 0x00)
+	{
+		osd_write_char(osd_get_char(*x++, small));
+		osd_cursor++;
+	}
+}
+
+
+/*!
+ *    Clear the screen: hardware clear of the display memory + both shadow buffers.
+ */
+void osd_clear_screen()
+{
+	spiWriteReg(DM_MODE_WRITE, 0x04);   // clear display memory, bit is self-clearing
+	memset(osd_shadow, 0x00, OSD_SCREEN_SIZE);
+	memset(osd_sent, 0x00, OSD_SCREEN_SIZE);
+	osd_fields_invalidate();
+}
+
+
+/*!
+ *    Diff the shadow against what the MAX7456 already shows and transmit only
+ *    the changed characters. Runs of changes go out in one auto-increment
+ *    burst: 1 register write per character instead of 3. Each call transmits
+ *    at most OSD_FLUSH_BUDGET_BYTES and remembers where it stopped, so a
+ *    budget-capped flush resumes there next frame instead of restarting at
+ *    the top of the screen.
+ */
+void osd_flush_frame()
+{
+	static int pos = 0;   // resume point of a budget-capped flush
+	int budget = OSD_FLUSH_BUDGET_BYTES;
+	int scanned = 0;
+
+	while (scanned < OSD_SCREEN_SIZE)
+	{
+		int end, clean, start;
+
+		if (spi_bus_preempt_requested())   // somebody more urgent wants the bus;
+			return;                        // osd_sent is up to date, the rest goes next frame
+
+		if (pos >= OSD_SCREEN_SIZE)
+			pos = 0;
+		if (osd_shadow[pos] == osd_sent[pos])
+		{
+			pos++;
+			scanned++;
+			continue;
+		}
+
+		// Extend the run over small clean gaps: resending a few unchanged
+		// characters is cheaper than a fresh address + mode setup.
+		end = pos + 1;
+		clean = 0;
+		while (end < OSD_SCREEN_SIZE && clean < 4)
+		{
+			if (osd_shadow[end] == osd_sent[end])
+				clean++;
+			else
+				clean = 0;
+			end++;
+		}
+		end -= clean;
+
+		// Book the run against the byte budget. An oversized run is capped,
+		// not skipped, so a full redraw keeps making progress through a
+		// tight budget; the remainder goes out next frame from the resume
+		// point.
+		start = pos;
+		if (end - pos > 1)
+		{
+			if (budget < 10)              // address + mode setup + 1 char + escape
+				return;
+			if (end - pos > budget - 9)
+				end = pos + (budget - 9);
+			budget -= 9 + (end - pos);
+		}
+		else
+		{
+			if (budget < 6)               // address + one single write
+				return;
+			budget -= 6;
+		}
+
+		spiWriteReg(DM_ADDRH_WRITE, (unsigned char)(pos >> 8));
+		spiWriteReg(DM_ADDRL_WRITE, (unsigned char)(pos & 0xFF));
+		if (end - pos > 1)
+		{
+			spiWriteReg(DM_MODE_WRITE, 0x41);   // 8-bit operation, auto-increment
+			while (pos < end)
+			{
+				spiWriteRegAutoIncr(osd_shadow[pos]);
+				osd_sent[pos] = osd_shadow[pos];
+				pos++;
+			}
+			spiWriteRegAutoIncr(0xFF);          // escape character ends the burst
+			spiWriteReg(DM_MODE_WRITE, 0x00);   // back to 16-bit operation for single writes
+		}
+		else
+		{
+			spiWriteReg(DM_CODE_IN_WRITE, osd_shadow[pos]);
+			osd_sent[pos] = osd_shadow[pos];
+			pos++;
+		}
+		scanned += pos - start;
+	}
+}
+
+#else    // OSD_SHADOW_BUFFER
+
 /*!
  *    Set the cursor of the OSD.
  *    Row = 0..15, Column = 0..29
@@ -1307,13 +1581,19 @@ void osd_set_position(int row, int column)
 
 	spiWriteReg(DM_ADDRH_WRITE, high);
 	spiWriteReg(DM_ADDRL_WRITE, low);
-}	
+}
 
 
 void osd_write_char(unsigned char x)
 {
-	spiWriteReg(DM_CODE_IN_WRITE, x);	
-}	
+	spiWriteReg(DM_CODE_IN_WRITE, x);
+}
+
+
+void osd_advance_position()
+{
+	spiWriteReg(DM_ADDRL_WRITE, spiReadReg(DM_ADDRL_READ)+1);
+}
 
 
 /*!
@@ -1331,7 +1611,7 @@ void osd_write_string(const unsigned char *x)
 		if (pos == 256)
 			spiWriteReg(DM_ADDRH_WRITE, (unsigned char)(pos>255?1:0));
 		spiWriteReg(DM_ADDRL_WRITE, (unsigned char)(pos%256));
-	}	
+	}
 }
 
 
@@ -1353,10 +1633,25 @@ void osd_write_ascii_string(unsigned char *x, int small)
 		if (pos == 256)
 			spiWriteReg(DM_ADDRH_WRITE, (unsigned char)(pos>255?1:0));
 		spiWriteReg(DM_ADDRL_WRITE, (unsigned char)(pos%256));
-	}	
+	}
 }
 
 
+void osd_clear_screen()
+{
+	spiWriteReg(DM_MODE_WRITE, 0x04);
+	osd_fields_invalidate();
+}
+
+
+void osd_flush_frame()
+{
+	// every write already went straight to the MAX7456
+}
+
+#endif   // OSD_SHADOW_BUFFER
+
+
 /*!
  * Is there an input video signal?
  */
@@ -30,30 +30,39 @@
 
 // Include all gluon libraries
 #include "scp1000/scp1000.h"
+#include "microcontroller/spi_bus.h"
 #include "adc/adc.h"
 #include "button/button.h"
 #include "pid/pid.h"
 #include "uart1_queue/uart1_queue.h"
 #include "i2c/i2c.h"
 #include "bmp085/bmp085.h"
+#include "tempcomp/tempcomp.h"
 
 #include "sensors.h"
+#include "latency.h"
+#include "heartbeat.h"
 #include "task_sensors_analog.h"
 #include "configuration.h"
 #include "ahrs.h"
+#include "altitude_filter.h"
 #include "common.h"
 #include "gluonscript.h"
+#include "warmstart.h"
 
 #define INVERT_X -1.0   // set to -1 if front becomes back
 
 
 static const float acc_value_g = 6600.0f;
 
-extern xSemaphoreHandle xSpiSemaphore;
+// last coherent ADC scan, refreshed once per loop in read_raw_sensor_data()
+static struct AdcScan adc_scan;
 
 void read_raw_sensor_data();
 void scale_raw_sensor_data();
 void bmp085_do_10Hz();
+void bmp085_do_10Hz_collect();
+void bmp085_phase_start(int phase);
 unsigned int squared(unsigned int a, unsigned int b, unsigned int c);
 
 float scale_z_gyro = 0.0f;
@@ -69,9 +78,9 @@ float scale_z_gyro = 0.0f;
 void sensors_analog_task( void *parameters )
 {
 	unsigned int temperature_10 = 200;
-	float last_height = 0.0f;
-	float dt_since_last_height = 0.0f;
 	unsigned int low_update_counter = 0;
+	int calibration_applied = 0;
+	int hb;
 
     unsigned int mean_gyro_x, mean_gyro_y, mean_gyro_z;
     unsigned long var_gyros, var_gyros_temp = 0;
@@ -102,7 +111,11 @@ void sensors_analog_task( void *parameters )
 	vTaskDelay( ( ( portTickType ) 20 / portTICK_RATE_MS ) );
 	read_raw_sensor_data();
 	scale_raw_sensor_data();
+#ifdef AHRS_SHADOW
+	ahrs_shadow_open();   // primary + shadow filter
+#else
 	ahrs_init();
+#endif
 
      mean_gyro_x = sensor_data.gyro_x_raw;
      mean_gyro_y = sensor_data.gyro_y_raw;
@@ -119,24 +132,30 @@ void sensors_analog_task( void *parameters )
 	
 	/* Initialise xLastExecutionTime so the first call to vTaskDelayUntil()	works correctly. */
 	xLastExecutionTime = xTaskGetTickCount();
+	hb = heartbeat_register("Sensors", 20);   // 4ms loop on a quad, but 20 covers both builds
 
 	for( ;; )
 	{
 #ifdef ENABLE_QUADROCOPTER
 		vTaskDelayUntil( &xLastExecutionTime, ( ( portTickType ) 4 / portTICK_RATE_MS ) );   // 250Hz
-		dt_since_last_height += 0.004f;
 		low_update_counter += 1;
 #else
 		vTaskDelayUntil( &xLastExecutionTime, ( ( portTickType ) 20 / portTICK_RATE_MS ) );   // 50Hz
-		dt_since_last_height += 0.02f;
 		low_update_counter += 5;
 #endif
+		heartbeat_checkin(hb);
 		if (low_update_counter > 65000)
 			low_update_counter = 0;
 		read_raw_sensor_data();
-				
+		latency_mark_sample();   // this sample's timestamp for the latency histograms
+
 		adc_start();  // restart ADC sampling to make sure we have our samples on the next loop iteration.
 
+#if (ENABLE_QUADROCOPTER || F1E_STEERING)
+		if (low_update_counter % 25 == 0)
+			hmc5843_request_read();   // the interrupt engine clocks the burst in while we work
+#endif
+
 		scale_raw_sensor_data();
 		
 		if (low_update_counter % 25 == 0) // 10Hz
@@ -150,10 +169,40 @@ void sensors_analog_task( void *parameters )
                                 (unsigned int)(mean_gyro_y - sensor_data.gyro_y_raw),
                                 (unsigned int)(mean_gyro_z - sensor_data.gyro_z_raw) );
             var_gyros = var_gyros_temp >> 2;
+            sensor_data.stationary = (var_gyros <= 10);
+
+            // seed the gyro bias states from the calibration cache as soon
+            // as we know the board temperature, then let the cache refresh
+            // itself once the filter has re-converged on a still craft
+            // (sensor_data.temperature works for both the SCP1000 and BMP085 path)
+            if (!calibration_applied)
+            {
+                if (sensor_data.temperature != 0.0f)   // first pressure sensor readout is in
+                {
+                    calibration_apply((int)(sensor_data.temperature * 10.0f));
+                    calibration_applied = 1;
+                }
+            }
+            else
+                calibration_update((int)(sensor_data.temperature * 10.0f), sensor_data.stationary);
+
+            warmstart_save();   // keep the in-flight reset snapshot fresh (10Hz)
+
+            // keep the active temperature compensation row current; during a
+            // calibration run, stationary samples refine the table instead
+            if (tempcomp_calibrating())
+            {
+                if (sensor_data.stationary)
+                    tempcomp_calibrate_sample((int)(sensor_data.temperature * 10.0f),
+                                              sensor_data.gyro_x_raw, sensor_data.gyro_y_raw, sensor_data.gyro_z_raw,
+                                              config.sensors.gyro_x_neutral, config.sensors.gyro_y_neutral, config.sensors.gyro_z_neutral);
+            }
+            else
+                tempcomp_set_temperature((int)(sensor_data.temperature * 10.0f));
             //if (var_gyros <= 10)
-            //    printf("\r\n still \r\n");
+            //    uart1_printf("\r\n still \r\n");
             //else if (low_update_counter % 300 == 0)
-            //    printf("\r\n%lu [%u %u] [%u %u] [%u %u]\r\n", var_gyros, (unsigned int)(mean_gyro_x - sensor_data.gyro_x_raw), sensor_data.gyro_x_raw,mean_gyro_y, sensor_data.gyro_y_raw,mean_gyro_z, sensor_data.gyro_z_raw);
+            //    uart1_printf("\r\n%lu [%u %u] [%u %u] [%u %u]\r\n", var_gyros, (unsigned int)(mean_gyro_x - sensor_data.gyro_x_raw), sensor_data.gyro_x_raw,mean_gyro_y, sensor_data.gyro_y_raw,mean_gyro_z, sensor_data.gyro_z_raw);
 
 			if (control_state.simulation_mode)
             {
@@ -161,7 +210,9 @@ void sensors_analog_task( void *parameters )
 				vTaskDelete(xTaskGetCurrentTaskHandle());
             }
 				
-			sensor_data.battery1_voltage_10 = ((float)adc_get_channel(8) * (3.3f * 5.1f / 6550.0f));
+			// integer only: 1683 / 655000 = 3.3 * 5.1 / 6550 / 10 (counts to volts)
+			// same scale as adc_get_channel(), but from the coherent scan
+			sensor_data.battery1_voltage_10 = (unsigned int)((unsigned long)adc_scan.channel[8] * 1683 / 655000);
 			if (HARDWARE_VERSION >= V01O)
 			{
 				bmp085_do_10Hz();
@@ -172,24 +223,15 @@ void sensors_analog_task( void *parameters )
 			if (HARDWARE_VERSION < V01O && scp1000_dataready())   // New reading from the pressure sensor -> calculate vertical speed
 			{
 				// this should be at 9Hz ->0.11s
-				if (xSemaphoreTake( xSpiSemaphore, ( portTickType ) 0 ))  // Spi1 is shared with SCP1000 and Dataflash
+				if (spi_bus_take( SPI_BUS_PRIORITY_SENSOR, ( portTickType ) 0 ))  // Spi1 is shared with SCP1000 and Dataflash
 				{
 					sensor_data.pressure = scp1000_get_pressure();
 					sensor_data.temperature = scp1000_get_temperature();
-					xSemaphoreGive( xSpiSemaphore );
-				}	
+					spi_bus_give();
+				}
 				temperature_10 = (unsigned int)sensor_data.temperature * 10;
-				float height = scp1000_pressure_to_height(sensor_data.pressure, sensor_data.temperature);
-				if (height > -30000.0f && height < 30000.0f)   // sometimes we get bad readings ~ -31000
-					sensor_data.pressure_height = height;
-
-				sensor_data.vertical_speed = sensor_data.vertical_speed * 0.9f + (sensor_data.pressure_height - last_height)/dt_since_last_height * 0.1f; // too much noise otherwise
-				
-				if (fabs(sensor_data.vertical_speed) > MAX(5.0f, sensor_data.gps.speed_ms))  // validity check
-					sensor_data.vertical_speed = 0.0f;
-					
-				last_height = sensor_data.pressure_height;
-				dt_since_last_height = 0.0f;
+				// fuses into pressure_height + vertical_speed
+				altitude_filter_correct(scp1000_pressure_to_height(sensor_data.pressure, sensor_data.temperature));
 			}
 		}
 
@@ -198,15 +240,27 @@ void sensors_analog_task( void *parameters )
 #if (ENABLE_QUADROCOPTER || F1E_STEERING)
 		if (low_update_counter % 25 == 0)
 		{
-			hmc5843_read(&sensor_data.magnetometer_raw); 
+			hmc5843_requested_read(&sensor_data.magnetometer_raw);   // submitted at the top of the loop
 		}
 #endif
 
 #ifdef ENABLE_QUADROCOPTER
-		ahrs_filter(0.005f);	
+		ahrs_filter(0.005f);
+		altitude_filter_predict(0.005f);
+#elif defined AHRS_SHADOW
+		ahrs_shadow_step(0.02f);   // primary + shadow, both timed
+		altitude_filter_predict(0.02f);
 #else
-		ahrs_filter(0.02f);	
+		ahrs_filter(0.02f);
+		altitude_filter_predict(0.02f);
 #endif
+
+		bmp085_do_10Hz_collect();   // readout submitted before the AHRS is in by now
+
+		if (HARDWARE_VERSION >= V01O)
+			bmp085_phase_start((int)(low_update_counter % 25));   // conversion starts land in the tail ticks
+
+		sensors_publish_snapshot();   // this tick's coherent set for the other tasks
 	}
 }
 
@@ -235,54 +289,113 @@ unsigned int squared(unsigned int a, unsigned int b, unsigned int c)
 }
 
 
+static int bmp085_converting = 0;   // 0 = idle, 1 = temp, 2 = pressure
+static int bmp085_next = 1;         // conversion the next phase start submits
+static int bmp085_readout_pending = 0;
+
+// Phase (low_update_counter % 25) at which bmp085_phase_start() submits
+// the next conversion, chosen so the conversion (temp 4.5ms, pressure 25.5ms
+// at OSS 3) completes shortly before the 10Hz readout slot at phase 0 instead
+// of ~75ms earlier. The start's blocking i2c writes land in the tail ticks of
+// the cycle - dead time: the control task (higher priority) has already
+// finished its slot and the readout slot's extra work is ticks away.
+#ifdef ENABLE_QUADROCOPTER
+#define BMP085_PRESSURE_START_PHASE 18   // 28ms before the readout slot
+#define BMP085_TEMP_START_PHASE     23   // 8ms before
+#else
+#define BMP085_PRESSURE_START_PHASE 15   // 40ms before the readout slot
+#define BMP085_TEMP_START_PHASE     20   // 20ms before
+#endif
+
+/*!
+ *   Submit half of the barometer update: starts the asynchronous readout of
+ *   the finished conversion, so the bus clocks it in while ahrs_filter()
+ *   runs. bmp085_do_10Hz_collect() picks up the result afterwards.
+ */
 void bmp085_do_10Hz()
 {
-	static int state = 0;
-	long tmp;
-
-	switch (state)
+	switch (bmp085_converting)
 	{
-		case 0:
-			bmp085_start_convert_temp();
-			state = 1;
-			break;
 		case 1:
-		{
-			tmp = bmp085_read_temp();
-			bmp085_convert_temp(tmp, &sensor_data.temperature_10);
-			sensor_data.temperature = (float)sensor_data.temperature_10 / 10.0f;
-		}
-			bmp085_start_convert_pressure();
-			state = 2;
+			bmp085_request_temp();
+			bmp085_readout_pending = 1;
 			break;
 		case 2:
-            {
-                long pressure;
-                tmp = bmp085_read_pressure();
-                bmp085_convert_pressure(tmp, &pressure);
+			bmp085_request_pressure();
+			bmp085_readout_pending = 1;
+			break;
+		default:   // nothing converting yet (before the first phase start)
+			break;
+	}
+}
 
-                sensor_data.pressure = (float)pressure;
-            }
-            sensor_data.pressure_height = scp1000_pressure_to_height(sensor_data.pressure, sensor_data.temperature);
+void bmp085_do_10Hz_collect()
+{
+	if (!bmp085_readout_pending)
+		return;
+	bmp085_readout_pending = 0;
+
+	if (bmp085_converting == 1)
+	{
+		bmp085_convert_temp(bmp085_requested_temp(), &sensor_data.temperature_10);
+		sensor_data.temperature = (float)sensor_data.temperature_10 / 10.0f;
+		bmp085_next = 2;
+	}
+	else
+	{
+		long pressure;
+		bmp085_convert_pressure(bmp085_requested_pressure(), &pressure);
 
-            bmp085_start_convert_temp();
-            state = 1;
-            break;
+		sensor_data.pressure = (float)pressure;
+		altitude_filter_correct(scp1000_pressure_to_height(sensor_data.pressure, sensor_data.temperature));
+		bmp085_next = 1;
 	}
+	bmp085_converting = 0;   // the sensor sits idle until the phase start
 }
 
-void read_raw_sensor_data()
+
+/*!
+ *   Phase-aligned conversion start, called every tick with the loop's
+ *   position inside the 100ms cycle. The BMP085 has no end-of-conversion
+ *   line on this board, so the only scheduling knob is the start time: late
+ *   enough in the cycle that the result is fresh at the readout slot, early
+ *   enough that the conversion is certain to have finished by then.
+ */
+void bmp085_phase_start(int phase)
 {
-	sensor_data.acc_x_raw = adc_get_channel(6);
-	sensor_data.acc_z_raw = adc_get_channel(1);
-	sensor_data.acc_y_raw = adc_get_channel(0);
+	if (bmp085_converting != 0)
+		return;
+	if (bmp085_next == 2 && phase == BMP085_PRESSURE_START_PHASE)
+	{
+		bmp085_start_convert_pressure();
+		bmp085_converting = 2;
+	}
+	else if (bmp085_next == 1 && phase == BMP085_TEMP_START_PHASE)
+	{
+		bmp085_start_convert_temp();
+		bmp085_converting = 1;
+	}
+}
 
-	sensor_data.gyro_x_raw = adc_get_channel(4);
-	sensor_data.gyro_y_raw = adc_get_channel(7);
-	sensor_data.gyro_z_raw = adc_get_channel(5);  //*0.6 = 3V max	
-	
-	sensor_data.idg500_vref = adc_get_channel(3);
-}	
+void read_raw_sensor_data()
+{
+	// one snapshot of the whole scan list: every channel below comes from
+	// the same conversion burst, so accelerometer/gyro pairs carry no
+	// inter-channel skew into the attitude math. The filtered values keep
+	// the full 16x oversampling precision; matters most for the
+	// gyroscopes, which drive the Kalman filter
+	adc_get_scan(&adc_scan);
+
+	sensor_data.acc_x_raw = adc_scan.channel[6];
+	sensor_data.acc_z_raw = adc_scan.channel[1];
+	sensor_data.acc_y_raw = adc_scan.channel[0];
+
+	sensor_data.gyro_x_raw = adc_scan.channel[4];
+	sensor_data.gyro_y_raw = adc_scan.channel[7];
+	sensor_data.gyro_z_raw = adc_scan.channel[5];  //*0.6 = 3V max
+
+	sensor_data.idg500_vref = adc_scan.channel[3];
+}
 
 
 void scale_raw_sensor_data()
@@ -292,10 +405,10 @@ void scale_raw_sensor_data()
 	sensor_data.acc_y = ((float)(sensor_data.acc_y_raw) - (float)config.sensors.acc_y_neutral) / (-acc_value_g*INVERT_X);
 	sensor_data.acc_z = ((float)(sensor_data.acc_z_raw) - (float)config.sensors.acc_z_neutral) / (-acc_value_g);
 			
-	// scale to rad/sec
-	sensor_data.p = ((float)(sensor_data.gyro_x_raw)-config.sensors.gyro_x_neutral) * (-0.02518315f*3.14159f/180.0f * INVERT_X);  // 0.02518315f
-	sensor_data.q = ((float)(sensor_data.gyro_y_raw)-config.sensors.gyro_y_neutral) * (-0.02538315f*3.14159f/180.0f * INVERT_X);
-	sensor_data.r = ((float)(sensor_data.gyro_z_raw)-config.sensors.gyro_z_neutral) * scale_z_gyro;
+	// scale to rad/sec; the tempcomp offsets hold the per-degree neutral drift (lib/tempcomp)
+	sensor_data.p = ((float)((int)sensor_data.gyro_x_raw - tempcomp_gyro_x)-config.sensors.gyro_x_neutral) * (-0.02518315f*3.14159f/180.0f * INVERT_X);  // 0.02518315f
+	sensor_data.q = ((float)((int)sensor_data.gyro_y_raw - tempcomp_gyro_y)-config.sensors.gyro_y_neutral) * (-0.02538315f*3.14159f/180.0f * INVERT_X);
+	sensor_data.r = ((float)((int)sensor_data.gyro_z_raw - tempcomp_gyro_z)-config.sensors.gyro_z_neutral) * scale_z_gyro;
 }	
 
 
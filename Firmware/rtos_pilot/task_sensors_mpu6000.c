@@ -26,19 +26,35 @@
 #include "i2c/i2c.h"
 #include "bmp085/bmp085.h"
 #include "mpu6000/mpu6000.h"
+#include "notch/notch.h"
 
 #include "sensors.h"
+#include "latency.h"
 #include "task_sensors_mpu6000.h"
 #include "configuration.h"
 #include "ahrs.h"
+#include "altitude_filter.h"
+#include "warmstart.h"
+#include "vibration.h"
+#include "gyrocapture.h"
+#include "heartbeat.h"
 #include "common.h"
 #include "gluonscript.h"
 
 #define INVERT_X -1.0   // set to -1 if front becomes back
 
 
+// Adaptive gyro notch (CN command / vibration analyzer). A retune is
+// staged here and picked up by the sensor loop, so the coefficients
+// never change in the middle of an update.
+static struct notch_fixed gyro_notch[3];
+static volatile float gyro_notch_request_hz = -1.0f;   // < 0: nothing staged
+static int gyro_notch_enabled = 0;
+
 void read_mpu6000_sensor_data();
 void bmp085_do_10Hz_2();
+void bmp085_do_10Hz_2_collect();
+void bmp085_phase_start_2(int phase);
 
 
 /*!
@@ -51,11 +67,14 @@ void bmp085_do_10Hz_2();
  */
 void sensors_mpu6000_task( void *parameters )
 {
-	float last_height = 0.0f, dt_since_last_height = 0.0f;
 	unsigned int low_update_counter = 0;
+	int calibration_applied = 0;
+	int hb;
 
+#ifndef MPU6000_USE_INT
 	/* Used to wake the task at the correct frequency. */
 	portTickType xLastExecutionTime;
+#endif
     
     vTaskSetApplicationTaskTag( NULL, ( void * ) 2 );
 
@@ -89,29 +108,93 @@ void sensors_mpu6000_task( void *parameters )
 
     read_mpu6000_sensor_data();
 
+#ifdef MPU6000_USE_INT
+	// After the last mpu6000_init(), which rewrites the interrupt enables.
+	// The divider makes the sensor's sample clock the loop clock below.
+#ifdef ENABLE_QUADROCOPTER
+	mpu6000_enable_data_ready_int(3);    // 1kHz / (3+1) = 250Hz
+#else
+	mpu6000_enable_data_ready_int(19);   // 1kHz / (19+1) = 50Hz
+#endif
+#endif
+
+#ifdef AHRS_SHADOW
+	ahrs_shadow_open();   // primary + shadow filter
+#else
 	ahrs_init();
+#endif
 
 	uart1_puts("done\r\n");
 
+#ifndef MPU6000_USE_INT
 	/* Initialise xLastExecutionTime so the first call to vTaskDelayUntil()	works correctly. */
 	xLastExecutionTime = xTaskGetTickCount();
+#endif
+	hb = heartbeat_register("Sensors", 20);   // 4ms loop on a quad, but 20 covers both builds
 
 	for( ;; )
 	{
+#ifdef MPU6000_USE_INT
+		// A requested raw capture (CR command) owns the sensor until it is
+		// done: 1kHz sampling straight to the capture ring, AHRS frozen.
+		if (gyrocapture_sampling_due())
+			gyrocapture_sample(hb);
+
+		// Data-ready paced: the sensor's crystal sets dt, the RTOS tick only
+		// bounds the timeout that keeps us (and the heartbeat) alive when
+		// the INT line is dead - then the loop degrades to tick pacing.
+#ifdef ENABLE_QUADROCOPTER
+		mpu6000_wait_data_ready( ( portTickType ) 8 / portTICK_RATE_MS );    // 2 sample periods
+		low_update_counter += 1;
+#else
+		mpu6000_wait_data_ready( ( portTickType ) 40 / portTICK_RATE_MS );
+		low_update_counter += 5;
+#endif
+#else
 #ifdef ENABLE_QUADROCOPTER
 		vTaskDelayUntil( &xLastExecutionTime, ( ( portTickType ) 4 / portTICK_RATE_MS ) );   // 250Hz
-		dt_since_last_height += 0.004f;
 		low_update_counter += 1;
 #else
 		vTaskDelayUntil( &xLastExecutionTime, ( ( portTickType ) 20 / portTICK_RATE_MS ) );   // 50Hz
 		low_update_counter += 5;
 #endif
+#endif
+		heartbeat_checkin(hb);
 		if (low_update_counter > 65000)
 			low_update_counter = 0;
 
 		adc_start();  // restart ADC sampling to make sure we have our samples on the next loop iteration.
 
+		if (gyro_notch_request_hz >= 0.0f)   // staged retune from the console or the analyzer
+		{
+#ifdef ENABLE_QUADROCOPTER
+			const float sample_hz = 250.0f;
+#else
+			const float sample_hz = 50.0f;
+#endif
+			int i;
+			for (i = 0; i < 3; i++)
+			{
+				notch_fixed_tune(&gyro_notch[i], gyro_notch_request_hz, sample_hz, gyro_notch_request_hz * 0.2f);
+				notch_fixed_reset(&gyro_notch[i]);
+			}
+			gyro_notch_enabled = (gyro_notch_request_hz > 0.0f);
+			gyro_notch_request_hz = -1.0f;
+		}
+
 		read_mpu6000_sensor_data();
+		latency_mark_sample();   // this sample's timestamp for the latency histograms
+
+#ifdef ENABLE_QUADROCOPTER
+		vibration_feed(250);   // vibration burst capture runs at the loop rate
+#else
+		vibration_feed(50);
+#endif
+
+#if (ENABLE_QUADROCOPTER || F1E_STEERING)
+		if (low_update_counter % 25 == 0)
+			hmc5843_request_read();   // the interrupt engine clocks the burst in while we work
+#endif
 
 		if (low_update_counter % 25 == 0) // 2Hz
 		{
@@ -121,68 +204,149 @@ void sensors_mpu6000_task( void *parameters )
 				vTaskDelete(xTaskGetCurrentTaskHandle());
             }
 
-			sensor_data.battery1_voltage_10 = (int)((float)adc_get_channel(8) * (3.3f * 5.1f / 6552.0f * 10.0f)) / 10;
-            sensor_data.battery2_voltage_10 = (int)((float)adc_get_channel(9) * (3.3f * 5.1f / 6552.0f * 10.0f)) / 10;
-            sensor_data.battery1_current = ((float)adc_get_channel(23) * (3.30f * (10.0f) / 65520.0f) * 2.0f); // correction factor 2
-            sensor_data.battery1_mAh += sensor_data.battery1_current * (1000.0 / 60.0 / 60.0 * 0.5) / 4.0;
-            //printf("\r\n%fA\r\n",sensor_data.battery1_current);
-            //printf("\r\n%u %u %u %u %u\r\n",
+			// integer only: 1683 / 655200 = 3.3 * 5.1 / 6552 / 10 (counts to volts)
+			sensor_data.battery1_voltage_10 = (unsigned int)((unsigned long)adc_get_channel(8) * 1683 / 655200);
+            sensor_data.battery2_voltage_10 = (unsigned int)((unsigned long)adc_get_channel(9) * 1683 / 655200);
+            // current stays in raw counts; sensors_battery1_current/_mAh scale at read time
+            sensor_data.battery1_current_raw = adc_get_channel(23);
+            sensor_data.battery1_charge_raw += sensor_data.battery1_current_raw;
+            //uart1_printf("\r\n%u %u %u %u %u\r\n",
             //        adc_get_channel(7), adc_get_channel(8), adc_get_channel(9),
             //        adc_get_channel(10), adc_get_channel(11));
 			bmp085_do_10Hz_2();
-            sensor_data.vertical_speed = sensor_data.vertical_speed * 0.9f + (sensor_data.pressure_height - last_height)/0.5 * 0.1f; // too much noise otherwise
-            last_height = sensor_data.pressure_height;
+
+			// "did anything move since the last poll"; reading clears it
+			sensor_data.stationary = (mpu6000_is_moving() == 0);
+
+			// seed the gyro bias states from the calibration cache as soon
+			// as the board temperature is known, then let the cache refresh
+			// itself once the filter has re-converged on a still craft
+			if (!calibration_applied)
+			{
+				if (sensor_data.temperature_10 != 0)   // first barometer readout is in
+				{
+					calibration_apply(sensor_data.temperature_10);
+					calibration_applied = 1;
+				}
+			}
+			else
+				calibration_update(sensor_data.temperature_10, sensor_data.stationary);
+
+			warmstart_save();   // keep the in-flight reset snapshot fresh
 		}
 
 #if (ENABLE_QUADROCOPTER || F1E_STEERING)
 		if (low_update_counter % 25 == 0)
 		{
-			hmc5843_read(&sensor_data.magnetometer_raw);
+			hmc5843_requested_read(&sensor_data.magnetometer_raw);   // submitted at the top of the loop
 		}
 #endif
 
 #ifdef ENABLE_QUADROCOPTER
 		ahrs_filter(0.004f);
+		altitude_filter_predict(0.004f);
+#elif defined AHRS_SHADOW
+		ahrs_shadow_step(0.02f);   // primary + shadow, both timed
+		altitude_filter_predict(0.02f);
 #else
 		ahrs_filter(0.02f);
+		altitude_filter_predict(0.02f);
 #endif
+
+		bmp085_do_10Hz_2_collect();   // readout submitted before the AHRS is in by now
+
+		bmp085_phase_start_2((int)(low_update_counter % 25));   // conversion starts land in the tail ticks
+
+		sensors_publish_snapshot();   // this tick's coherent set for the other tasks
 	}
 }
 
 
+static int bmp085_converting = 0;   // 0 = idle, 1 = temp, 2 = pressure
+static int bmp085_next = 1;         // conversion the next phase start submits
+static int bmp085_readout_pending = 0;
+
+// Phase (low_update_counter % 25) at which bmp085_phase_start_2() submits
+// the next conversion, chosen so the conversion (temp 4.5ms, pressure 25.5ms
+// at OSS 3) completes shortly before the 10Hz readout slot at phase 0 instead
+// of ~75ms earlier. The start's blocking i2c writes land in the tail ticks of
+// the cycle - dead time: the control task (higher priority) has already
+// finished its slot and the readout slot's extra work is ticks away.
+#ifdef ENABLE_QUADROCOPTER
+#define BMP085_PRESSURE_START_PHASE 18   // 28ms before the readout slot
+#define BMP085_TEMP_START_PHASE     23   // 8ms before
+#else
+#define BMP085_PRESSURE_START_PHASE 15   // 40ms before the readout slot
+#define BMP085_TEMP_START_PHASE     20   // 20ms before
+#endif
+
+/*!
+ *   Submit half of the barometer update: starts the asynchronous readout of
+ *   the finished conversion, so the bus clocks it in while ahrs_filter()
+ *   runs. bmp085_do_10Hz_2_collect() picks up the result afterwards.
+ */
 void bmp085_do_10Hz_2()
 {
-	static int state = 0;
-	long tmp;
-
-	switch (state)
+	switch (bmp085_converting)
 	{
-		case 0:
-			bmp085_start_convert_temp();
-			state = 1;
-			break;
 		case 1:
-		{
-			tmp = bmp085_read_temp();
-			bmp085_convert_temp(tmp, &sensor_data.temperature_10);
-			sensor_data.temperature = (float)sensor_data.temperature_10 / 10.0f;
-		}
-			bmp085_start_convert_pressure();
-			state = 2;
+			bmp085_request_temp();
+			bmp085_readout_pending = 1;
 			break;
 		case 2:
-            {
-                long pressure;
-                tmp = bmp085_read_pressure();
-                bmp085_convert_pressure(tmp, &pressure);
+			bmp085_request_pressure();
+			bmp085_readout_pending = 1;
+			break;
+		default:   // nothing converting yet (before the first phase start)
+			break;
+	}
+}
+
+void bmp085_do_10Hz_2_collect()
+{
+	if (!bmp085_readout_pending)
+		return;
+	bmp085_readout_pending = 0;
+
+	if (bmp085_converting == 1)
+	{
+		bmp085_convert_temp(bmp085_requested_temp(), &sensor_data.temperature_10);
+		sensor_data.temperature = (float)sensor_data.temperature_10 / 10.0f;
+		bmp085_next = 2;
+	}
+	else
+	{
+		long pressure;
+		bmp085_convert_pressure(bmp085_requested_pressure(), &pressure);
+
+		sensor_data.pressure = (float)pressure;
+		altitude_filter_correct(scp1000_pressure_to_height(sensor_data.pressure, sensor_data.temperature));
+		bmp085_next = 1;
+	}
+	bmp085_converting = 0;   // the sensor sits idle until the phase start
+}
 
-                sensor_data.pressure = (float)pressure;
-            }
-            sensor_data.pressure_height = scp1000_pressure_to_height(sensor_data.pressure, sensor_data.temperature);
 
-            bmp085_start_convert_temp();
-            state = 1;
-            break;
+/*!
+ *   Phase-aligned conversion start, called every tick with the loop's
+ *   position inside the 100ms cycle. The BMP085 has no end-of-conversion
+ *   line on this board, so the only scheduling knob is the start time: late
+ *   enough in the cycle that the result is fresh at the readout slot, early
+ *   enough that the conversion is certain to have finished by then.
+ */
+void bmp085_phase_start_2(int phase)
+{
+	if (bmp085_converting != 0)
+		return;
+	if (bmp085_next == 2 && phase == BMP085_PRESSURE_START_PHASE)
+	{
+		bmp085_start_convert_pressure();
+		bmp085_converting = 2;
+	}
+	else if (bmp085_next == 1 && phase == BMP085_TEMP_START_PHASE)
+	{
+		bmp085_start_convert_temp();
+		bmp085_converting = 1;
 	}
 }
 
@@ -190,6 +354,13 @@ void read_mpu6000_sensor_data()
 {
     mpu6000_update_sensor_readings();
 
+    // notch out the prop-rate peak on the raw gyro counts: one filter per
+    // physical axis, ahead of the imu_rotated swizzling below, so a retune
+    // needs no orientation bookkeeping. Pass-through while disabled.
+    mpu6000_raw_sensor_readings.gyro_x = notch_fixed_update(&gyro_notch[0], mpu6000_raw_sensor_readings.gyro_x);
+    mpu6000_raw_sensor_readings.gyro_y = notch_fixed_update(&gyro_notch[1], mpu6000_raw_sensor_readings.gyro_y);
+    mpu6000_raw_sensor_readings.gyro_z = notch_fixed_update(&gyro_notch[2], mpu6000_raw_sensor_readings.gyro_z);
+
     if (mpu6000_raw_sensor_readings.acc_x < 0)
         sensor_data.acc_x_raw = 32768 + (long)mpu6000_raw_sensor_readings.acc_x;
     else
@@ -221,7 +392,7 @@ void read_mpu6000_sensor_data()
         sensor_data.gyro_z_raw = 32768 + (unsigned int)mpu6000_raw_sensor_readings.gyro_z;
 
     
-    if (config.sensors.imu_rotated == 1)  // 90� CCW
+    if (config.sensors.imu_rotated == 1)  // 90� CCW
     {
         sensor_data.acc_y = -((float)config.sensors.acc_x_neutral - (float)sensor_data.acc_x_raw) / 4096.0;
         sensor_data.acc_x = ((float)sensor_data.acc_y_raw - (float)config.sensors.acc_y_neutral) / 4096.0;
@@ -231,7 +402,7 @@ void read_mpu6000_sensor_data()
         sensor_data.p = ((float)sensor_data.gyro_y_raw - (float)config.sensors.gyro_y_neutral) * (3.14159 / 180.0 / 32.8);
         sensor_data.r = ((float)config.sensors.gyro_z_neutral - (float)sensor_data.gyro_z_raw) * (3.14159 / 180.0 / 32.8);
     }
-    else if (config.sensors.imu_rotated == 3)  // 270� CCW
+    else if (config.sensors.imu_rotated == 3)  // 270� CCW
     {
         sensor_data.acc_y = ((float)config.sensors.acc_x_neutral - (float)sensor_data.acc_x_raw) / 4096.0;
         sensor_data.acc_x = -((float)sensor_data.acc_y_raw - (float)config.sensors.acc_y_neutral) / 4096.0;
@@ -241,7 +412,7 @@ void read_mpu6000_sensor_data()
         sensor_data.p = -((float)sensor_data.gyro_y_raw - (float)config.sensors.gyro_y_neutral) * (3.14159 / 180.0 / 32.8);
         sensor_data.r = ((float)config.sensors.gyro_z_neutral - (float)sensor_data.gyro_z_raw) * (3.14159 / 180.0 / 32.8);
     }
-    else if (config.sensors.imu_rotated == 2)  // 180�
+    else if (config.sensors.imu_rotated == 2)  // 180�
     {
         sensor_data.acc_x = ((float)sensor_data.acc_x_raw - (float)config.sensors.acc_x_neutral) / 4096.0;
         sensor_data.acc_y = ((float)config.sensors.acc_y_neutral - (float)sensor_data.acc_y_raw) / 4096.0;
@@ -273,3 +444,18 @@ void read_mpu6000_sensor_data()
     }
 }
 
+
+/*!
+ *   Stages a gyro notch retune; the sensor loop applies it on its next
+ *   iteration. 0 disables the filter. Callable from any task.
+ */
+void sensors_notch_request(float freq_hz)
+{
+	gyro_notch_request_hz = freq_hz;
+}
+
+
+int sensors_notch_enabled()
+{
+	return gyro_notch_enabled;
+}
@@ -7,4 +7,9 @@
 
 void sensors_mpu6000_task( void *parameters );
 
+//! Stages a retune of the adaptive gyro notch filter (0 = off).
+void sensors_notch_request(float freq_hz);
+//! 1 while the gyro notch is active.
+int sensors_notch_enabled();
+
 #endif // SENSORS_MPU6000_H
@@ -0,0 +1,150 @@
+/*!
+ *   Single source of truth for the CSV telemetry frame layouts.
+ *
+ *   Every periodic telemetry frame is declared here once as an X-macro
+ *   field list. communication_csv.c expands the lists into the type
+ *   tables its table-driven serializer walks, and
+ *   Software/Gluonconfig/SerialCommunication/Frames/generate_frame_schema.py
+ *   expands the very same lists into FrameSchema.cs for the GluonCS
+ *   parser. Adding, removing or reordering a field here updates both
+ *   sides at once; the hand-written format strings on the firmware side
+ *   and the hand-counted field indices in the groundstation drifted
+ *   apart more than once before this file existed.
+ *
+ *   The generator only understands the one-field-per-line
+ *   "	F(name, TF_x) \" shape used below - keep new lists in that shape.
+ *
+ *   @file   telemetry_frames.h
+ *   @author Tom Pycke
+ *   @date   31-aug-2026
+ *   @since  0.9
+ */
+
+#ifndef TELEMETRY_FRAMES_H
+#define TELEMETRY_FRAMES_H
+
+
+//! Field types; the serializer maps each to one comm_format conversion.
+enum telemetry_field_type
+{
+	TF_D,    // int, "%d"
+	TF_U,    // unsigned int, "%u"
+	TF_LD,   // long, "%ld"
+	TF_LU,   // unsigned long, "%lu"
+	TF_F9,   // float, "%.9f" (gps coordinates)
+	TF_C     // char, "%c"
+};
+
+//! One slot per field, filled at the call site in schema order; use the
+//! TELEMETRY_<tag>_<field> index enums below, never bare numbers.
+union telemetry_value
+{
+	int d;
+	unsigned int u;
+	long ld;
+	unsigned long lu;
+	float f;
+	char c;
+};
+
+
+//! Attitude, the frame the stream scheduler never defers.
+#define TELEMETRY_TA_FIELDS(F) \
+	F(roll_mrad, TF_D) \
+	F(pitch_mrad, TF_D) \
+	F(yaw_mrad, TF_D)
+
+//! Control and housekeeping; GluonCS parses this one progressively so
+//! append-only changes stay compatible with older groundstations.
+#define TELEMETRY_TC_FIELDS(F) \
+	F(flight_mode, TF_D) \
+	F(navigation_line, TF_D) \
+	F(altitude_m, TF_D) \
+	F(batt1_voltage_10, TF_U) \
+	F(flight_time_s, TF_D) \
+	F(block_time_s, TF_D) \
+	F(rc_link_pct, TF_D) \
+	F(throttle_pct, TF_D) \
+	F(target_altitude_agl_m, TF_D) \
+	F(batt2_voltage_10, TF_U) \
+	F(batt1_mah_10, TF_U) \
+	F(cpu_pct, TF_U)
+
+#define TELEMETRY_TG_FIELDS(F) \
+	F(status, TF_C) \
+	F(latitude_rad, TF_F9) \
+	F(longitude_rad, TF_F9) \
+	F(speed_ms_10, TF_U) \
+	F(heading_rad_100, TF_U) \
+	F(satellites_in_view, TF_U) \
+	F(height_m, TF_U)
+
+//! RC transmitter input, raw servo pulse widths in microseconds.
+#define TELEMETRY_TT_FIELDS(F) \
+	F(channel_1, TF_U) \
+	F(channel_2, TF_U) \
+	F(channel_3, TF_U) \
+	F(channel_4, TF_U) \
+	F(channel_5, TF_U) \
+	F(channel_6, TF_U) \
+	F(channel_7, TF_U) \
+	F(channel_8, TF_U)
+
+#define TELEMETRY_TR_FIELDS(F) \
+	F(acc_x_raw, TF_U) \
+	F(acc_y_raw, TF_U) \
+	F(acc_z_raw, TF_U) \
+	F(gyro_x_raw, TF_U) \
+	F(gyro_y_raw, TF_U) \
+	F(gyro_z_raw, TF_U)
+
+#define TELEMETRY_TP_FIELDS(F) \
+	F(acc_x_mg, TF_D) \
+	F(acc_y_mg, TF_D) \
+	F(acc_z_mg, TF_D) \
+	F(p_mrad_s, TF_D) \
+	F(q_mrad_s, TF_D) \
+	F(r_mrad_s, TF_D)
+
+#define TELEMETRY_TH_FIELDS(F) \
+	F(pressure_pa, TF_LU) \
+	F(temperature, TF_D)
+
+//! Every frame the serializer and the generator know about.
+#define TELEMETRY_FRAME_LIST(FRAME) \
+	FRAME(TA) \
+	FRAME(TC) \
+	FRAME(TG) \
+	FRAME(TT) \
+	FRAME(TR) \
+	FRAME(TP) \
+	FRAME(TH)
+
+//! Large enough for the widest field list above (TC).
+#define TELEMETRY_MAX_FIELDS 12
+
+
+// Per-frame field indices into the telemetry_value array, generated from
+// the lists so a reordered schema moves every call site along with it.
+#define TELEMETRY_FIELD_INDEX_TA(name, ftype) TELEMETRY_TA_##name,
+enum { TELEMETRY_TA_FIELDS(TELEMETRY_FIELD_INDEX_TA) TELEMETRY_TA_NFIELDS };
+#define TELEMETRY_FIELD_INDEX_TC(name, ftype) TELEMETRY_TC_##name,
+enum { TELEMETRY_TC_FIELDS(TELEMETRY_FIELD_INDEX_TC) TELEMETRY_TC_NFIELDS };
+#define TELEMETRY_FIELD_INDEX_TG(name, ftype) TELEMETRY_TG_##name,
+enum { TELEMETRY_TG_FIELDS(TELEMETRY_FIELD_INDEX_TG) TELEMETRY_TG_NFIELDS };
+#define TELEMETRY_FIELD_INDEX_TT(name, ftype) TELEMETRY_TT_##name,
+enum { TELEMETRY_TT_FIELDS(TELEMETRY_FIELD_INDEX_TT) TELEMETRY_TT_NFIELDS };
+#define TELEMETRY_FIELD_INDEX_TR(name, ftype) TELEMETRY_TR_##name,
+enum { TELEMETRY_TR_FIELDS(TELEMETRY_FIELD_INDEX_TR) TELEMETRY_TR_NFIELDS };
+#define TELEMETRY_FIELD_INDEX_TP(name, ftype) TELEMETRY_TP_##name,
+enum { TELEMETRY_TP_FIELDS(TELEMETRY_FIELD_INDEX_TP) TELEMETRY_TP_NFIELDS };
+#define TELEMETRY_FIELD_INDEX_TH(name, ftype) TELEMETRY_TH_##name,
+enum { TELEMETRY_TH_FIELDS(TELEMETRY_FIELD_INDEX_TH) TELEMETRY_TH_NFIELDS };
+
+//! Frame ids, in TELEMETRY_FRAME_LIST order; index the descriptor table
+//! built in communication_csv.c.
+#define TELEMETRY_FRAME_ID(tag) TELEMETRY_FRAME_##tag,
+enum telemetry_frame_id { TELEMETRY_FRAME_LIST(TELEMETRY_FRAME_ID) TELEMETRY_NUM_FRAMES };
+
+
+#endif // TELEMETRY_FRAMES_H
@@ -0,0 +1,170 @@
+/*!
+ *  Vibration spectrum analyzer.
+ *
+ *  The capture side runs in the sensor task and only copies one centered
+ *  raw value per loop; all the real work (window, FFT, peak search) happens
+ *  in vibration_analyze() from the telemetry task, where a few ms of Q1.15
+ *  butterflies hurt nobody.
+ *
+ *  @file     vibration.c
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#include <math.h>
+
+#include "fft/fft.h"
+#include "fastmath/fastmath.h"
+
+#include "sensors.h"
+#include "configuration.h"
+#include "vibration.h"
+
+
+#define VIBRATION_IDLE       0
+#define VIBRATION_CAPTURING  1
+#define VIBRATION_READY      2
+
+// re doubles as the capture buffer; im is only needed during the FFT
+static fractional vib_re[VIBRATION_SAMPLES];
+static fractional vib_im[VIBRATION_SAMPLES];
+
+static volatile int vib_state = VIBRATION_IDLE;
+static int vib_axis = 0;
+static int vib_index = 0;
+static unsigned int vib_sample_hz = 0;
+
+
+void vibration_start(int axis)
+{
+	if (vib_state == VIBRATION_CAPTURING)
+		return;
+	if (axis < 0 || axis > 2)
+		axis = 2;
+
+	vib_axis = axis;
+	vib_index = 0;
+	vib_state = VIBRATION_CAPTURING;
+}
+
+
+void vibration_feed(unsigned int sample_hz)
+{
+	long raw;
+	long neutral;
+
+	if (vib_state != VIBRATION_CAPTURING)
+		return;
+
+	switch (vib_axis)
+	{
+		case 0:
+			raw = sensor_data.acc_x_raw;
+			neutral = (long) config.sensors.acc_x_neutral;
+			break;
+		case 1:
+			raw = sensor_data.acc_y_raw;
+			neutral = (long) config.sensors.acc_y_neutral;
+			break;
+		default:
+			raw = sensor_data.acc_z_raw;
+			neutral = (long) config.sensors.acc_z_neutral;
+			break;
+	}
+
+	// centered raw counts happen to span the Q1.15 range exactly
+	vib_re[vib_index] = (fractional) (raw - neutral);
+	vib_sample_hz = sample_hz;
+
+	if (++vib_index == VIBRATION_SAMPLES)
+		vib_state = VIBRATION_READY;
+}
+
+
+int vibration_ready()
+{
+	return vib_state == VIBRATION_READY;
+}
+
+
+//! Magnitude of bin i in raw accel counts. The FFT scales by 1/N and the
+//! Hann window by 1/2: the factor 4 undoes both.
+static float bin_magnitude(int i)
+{
+	return sqrtf((float) vib_re[i] * (float) vib_re[i] +
+	             (float) vib_im[i] * (float) vib_im[i]) * 4.0f;
+}
+
+
+void vibration_analyze(struct VibrationPeak *peaks)
+{
+	static const float two_pi_over_n = 6.2831853f / VIBRATION_SAMPLES;
+	int peak_bin[VIBRATION_PEAKS];
+	int i, p, q;
+
+	// Hann window against spectral leakage of the (non-periodic) burst
+	for (i = 0; i < VIBRATION_SAMPLES; i++)
+	{
+		float w = 0.5f * (1.0f - fast_cos(two_pi_over_n * i));
+		vib_re[i] = (fractional) (vib_re[i] * w);
+		vib_im[i] = 0;
+	}
+
+	fft_q15(vib_re, vib_im, 8);   // 2^8 = VIBRATION_SAMPLES
+
+	for (p = 0; p < VIBRATION_PEAKS; p++)
+	{
+		int best = -1;
+		float best_magnitude = 0.0f;
+
+		// bin 0 is the leftover neutral offset, not vibration; bins within
+		// 2 of an earlier peak are its window skirt, not a second peak
+		for (i = 1; i < VIBRATION_SAMPLES / 2; i++)
+		{
+			float m;
+			int skirt = 0;
+
+			for (q = 0; q < p; q++)
+			{
+				if (i >= peak_bin[q] - 2 && i <= peak_bin[q] + 2)
+					skirt = 1;
+			}
+			if (skirt)
+				continue;
+
+			m = bin_magnitude(i);
+			if (m > best_magnitude)
+			{
+				best_magnitude = m;
+				best = i;
+			}
+		}
+
+		peak_bin[p] = best;
+		if (best < 0)
+		{
+			peaks[p].frequency = 0.0f;
+			peaks[p].magnitude = 0.0f;
+		}
+		else
+		{
+			peaks[p].frequency = (float) best * (float) vib_sample_hz / VIBRATION_SAMPLES;
+			peaks[p].magnitude = best_magnitude;
+		}
+	}
+
+	vib_state = VIBRATION_IDLE;
+}
+
+
+int vibration_axis()
+{
+	return vib_axis;
+}
+
+
+unsigned int vibration_sample_hz()
+{
+	return vib_sample_hz;
+}
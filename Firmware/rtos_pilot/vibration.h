@@ -0,0 +1,48 @@
+/*!
+ *  Vibration spectrum analyzer.
+ *
+ *  Prop imbalance shows up as a narrow-band peak in the raw accelerometer
+ *  signal and ruins the accelerometer-based attitude correction, but the
+ *  57600 baud link cannot stream raw samples for analysis on the ground.
+ *  This module captures a 256-sample burst of one raw accel axis in the
+ *  sensor task, runs the fixed-point FFT from lib/fft on it and reports
+ *  the dominant frequency bins (TV telemetry line, started with CV;axis).
+ *
+ *  @file     vibration.h
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#ifndef VIBRATION_H
+#define VIBRATION_H
+
+#define VIBRATION_SAMPLES 256   //!< burst length; one FFT input
+#define VIBRATION_PEAKS   4     //!< reported bins per analysis
+
+struct VibrationPeak
+{
+	float frequency;   //!< Hz
+	float magnitude;   //!< raw accel counts (amplitude/2 after the window)
+};
+
+//! Starts a capture of axis 0=x, 1=y, 2=z; ignored while one is running.
+void vibration_start(int axis);
+
+//! One raw sample per call, from the sensor task at its loop rate.
+//! Cheap no-op unless a capture is running.
+void vibration_feed(unsigned int sample_hz);
+
+//! 1 when a full burst is waiting for vibration_analyze().
+int vibration_ready();
+
+//! Hann window + FFT + peak search; fills peaks[VIBRATION_PEAKS] (unused
+//! entries zeroed) and returns to idle. Takes a few ms: call from a low
+//! priority task, not from the sensor loop.
+void vibration_analyze(struct VibrationPeak *peaks);
+
+//! Axis and sample rate of the last completed capture.
+int vibration_axis();
+unsigned int vibration_sample_hz();
+
+#endif // VIBRATION_H
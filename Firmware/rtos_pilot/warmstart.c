@@ -0,0 +1,127 @@
+/*!
+ *  Warm-restart snapshot for in-flight resets.
+ *
+ *  The snapshot lives in a persistent variable (section .pbss): the C
+ *  runtime does not zero it, so it survives every reset that keeps the
+ *  supply up - watchdog, trap, RESET instruction and most brownouts. A
+ *  magic number and a checksum guard against a true power-up (garbage RAM)
+ *  and against a reset that hit in the middle of warmstart_save().
+ *
+ *  @file     warmstart.c
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#include "microcontroller/microcontroller.h"
+#include "uart1_queue/uart1_queue.h"
+
+#include "sensors.h"
+#include "gluonscript.h"
+#include "warmstart.h"
+
+
+//! Everything we want back after an in-flight reset.
+struct WarmstartSnapshot
+{
+	unsigned int magic;     //!< WARMSTART_MAGIC while the snapshot is live
+	float roll;             //!< published attitude (sensor_data.roll/pitch)
+	float pitch;
+	float p_bias;           //!< kalman gyro bias states
+	float q_bias;
+	int codeline;           //!< active gluonscript codeline
+	unsigned int checksum;  //!< catches a reset in the middle of a save
+};
+
+#define WARMSTART_MAGIC 0x3A5C
+
+//! The C runtime leaves persistent variables alone at startup, which is the
+//! whole point: after a warm reset yesterday's content is still here.
+static struct WarmstartSnapshot __attribute__((persistent)) snapshot;
+
+//! Decided once by warmstart_init(); the snapshot itself is overwritten by
+//! warmstart_save() as soon as the sensor task runs.
+static int snapshot_usable = 0;
+
+
+//! Simple additive checksum over the payload fields.
+static unsigned int warmstart_checksum(struct WarmstartSnapshot *s)
+{
+	unsigned char *p = (unsigned char*)s;
+	unsigned int sum = 0x5a17;
+	int i;
+
+	// everything between magic and the checksum field itself
+	for (i = sizeof(s->magic); i < sizeof(struct WarmstartSnapshot) - sizeof(s->checksum); i++)
+		sum += p[i];
+	return sum;
+}
+
+
+/*!
+ *  Checks whether the snapshot survived the reset. On a cold boot (power-up
+ *  or external reset) the snapshot is discarded even if the RAM happens to
+ *  hold a valid-looking one: the craft was handled, so yesterday's attitude
+ *  is meaningless.
+ */
+void warmstart_init()
+{
+	if (microcontroller_after_reboot() &&
+	    snapshot.magic == WARMSTART_MAGIC &&
+	    snapshot.checksum == warmstart_checksum(&snapshot))
+	{
+		snapshot_usable = 1;
+		uart1_puts("Warm restart: attitude and script state recovered\r\n");
+	}
+	else
+	{
+		snapshot.magic = 0;
+		snapshot_usable = 0;
+	}
+}
+
+
+int warmstart_valid()
+{
+	return snapshot_usable;
+}
+
+
+/*!
+ *  Captures the running state. Invalidate first, checksum last: a reset
+ *  that lands in the middle leaves a snapshot that fails validation
+ *  instead of one that restores half-old, half-new state.
+ */
+void warmstart_save()
+{
+	snapshot.magic = 0;
+	snapshot.roll = sensor_data.roll;
+	snapshot.pitch = sensor_data.pitch;
+	snapshot.p_bias = sensor_data.p_bias;
+	snapshot.q_bias = sensor_data.q_bias;
+	snapshot.codeline = gluonscript_data.current_codeline;
+	snapshot.checksum = warmstart_checksum(&snapshot);
+	snapshot.magic = WARMSTART_MAGIC;
+}
+
+
+int warmstart_attitude(float *roll_rad, float *pitch_rad, float *p_bias, float *q_bias)
+{
+	if (! snapshot_usable)
+		return 0;
+
+	*roll_rad = snapshot.roll;
+	*pitch_rad = snapshot.pitch;
+	*p_bias = snapshot.p_bias;
+	*q_bias = snapshot.q_bias;
+	return 1;
+}
+
+
+int warmstart_codeline()
+{
+	if (! snapshot_usable)
+		return -1;
+
+	return snapshot.codeline;
+}
@@ -0,0 +1,39 @@
+/*!
+ *  Warm-restart snapshot for in-flight resets.
+ *
+ *  A watchdog, trap or brownout reset mid-flight restarts the firmware, but
+ *  RAM keeps its content through all of those (only a real power-up loses
+ *  it). This module keeps a small snapshot of the state that is expensive
+ *  to re-estimate - the attitude, the gyro bias states and the active
+ *  gluonscript codeline - in a noinit RAM section, so after a reset the
+ *  filters resume where they were ~100ms earlier instead of re-converging
+ *  from scratch over tens of seconds.
+ *
+ *  @file     warmstart.h
+ *  @author   Tom Pycke
+ *  @date     31-aug-2026
+ *  @since    0.9
+ */
+
+#ifndef WARMSTART_H
+#define WARMSTART_H
+
+//! Validates a surviving snapshot (or discards it on a cold boot).
+//! Call from main(), after microcontroller_init().
+void warmstart_init();
+
+//! 1 when a usable snapshot survived the reset.
+int warmstart_valid();
+
+//! Captures the current attitude, bias states and codeline; housekeeping
+//! call from the sensor task, a few Hz is plenty.
+void warmstart_save();
+
+//! Fills in the attitude and gyro bias states from the snapshot.
+//! Returns 0 (and touches nothing) when there is no valid snapshot.
+int warmstart_attitude(float *roll_rad, float *pitch_rad, float *p_bias, float *q_bias);
+
+//! The gluonscript codeline that was active before the reset, or -1.
+int warmstart_codeline();
+
+#endif // WARMSTART_H
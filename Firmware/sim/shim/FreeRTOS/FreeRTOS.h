@@ -0,0 +1,23 @@
+/*
+ *   Host-build stand-in for the FreeRTOS kernel header. Only the names the
+ *   simulated modules actually touch are provided; anything scheduling
+ *   related is a no-op, because the replay driver clocks the modules itself.
+ *
+ *   @author   Tom Pycke
+ *   @date     31-aug-2026
+ */
+#ifndef SIM_FREERTOS_H
+#define SIM_FREERTOS_H
+
+typedef long portTickType;
+typedef long portBASE_TYPE;
+#define portCHAR char
+#define portTICK_RATE_MS 1
+#define tskIDLE_PRIORITY 0
+
+void vTaskDelay(portTickType ticks);
+void vTaskDelayUntil(portTickType *last, portTickType ticks);
+portTickType xTaskGetTickCount();
+void *pvPortMalloc(unsigned long size);
+
+#endif
@@ -0,0 +1,2 @@
+/* Host-build stand-in; see FreeRTOS.h in this directory. */
+#include "FreeRTOS/FreeRTOS.h"
@@ -0,0 +1,21 @@
+/*
+ *   Host-build stand-in for lib/microcontroller/microcontroller.h, which
+ *   pulls in the dsPIC register header. The simulated modules only touch
+ *   INTERRUPT_PROTECT (the host build is single threaded, so it reduces
+ *   to running the protected statement) and the prototypes below.
+ *
+ *   @author   Tom Pycke
+ *   @date     31-aug-2026
+ */
+#ifndef SIM_MICROCONTROLLER_H
+#define SIM_MICROCONTROLLER_H
+
+void microcontroller_init();
+void microcontroller_delay_us(unsigned long us);
+void microcontroller_delay_ms(unsigned long ms);
+int microcontroller_after_reboot();
+void microcontroller_reset_type();
+
+#define INTERRUPT_PROTECT(x) { x; } (void) 0;
+
+#endif
@@ -0,0 +1,422 @@
+/*
+ *   Host-side mission driver for the gluonscript interpreter.
+ *
+ *   Compiles gluonscript.c and all of its handlers unmodified for a PC
+ *   (same shim/ arrangement as sim_replay) and flies a flightplan with a
+ *   synthetic point-mass aircraft: position advances at cruising speed
+ *   towards navigation's desired heading, heading and altitude slew at
+ *   realistic rates, and the simulated gps feeds gluonscript_do() at the
+ *   on-target 10Hz - but at full host speed, so a 60-waypoint mission
+ *   that takes half an hour to fly finishes in well under a second.
+ *
+ *   The driver asserts what a flight test would check by hand: the plan
+ *   survives gluonscript_compile(), every waypoint line is left within
+ *   the waypoint radius, no line stalls, and the plan runs to its end.
+ *   It also times gluonscript_do() per tick, so interpreter changes get
+ *   a cost number under a realistic plan instead of a guess.
+ *
+ *   Run without arguments for a built-in 60-waypoint zigzag mission, or
+ *   pass plan files with one "line;opcode;x;y;a;b" line per codeline
+ *   (the fields of the console's ND frames). Exit code 0 means every
+ *   mission passed, so a directory of plans doubles as a regression
+ *   suite:
+ *
+ *     ./sim_mission *.gsp
+ *
+ *   @author   Tom Pycke
+ *   @date     31-aug-2026
+ */
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "FreeRTOS/FreeRTOS.h"
+#include "ppm_in/ppm_in.h"
+#include "dataflash/dataflash.h"
+
+#include "common.h"
+#include "sensors.h"
+#include "configuration.h"
+#include "gluonscript.h"
+#include "handler_navigation.h"
+#include "task_control.h"
+#include "warmstart.h"
+
+/* Globals normally owned by the firmware tasks. */
+struct Configuration config;
+struct ControlState control_state;
+volatile struct ppm_info ppm;
+int HARDWARE_VERSION = V01N;
+
+/* Home of the built-in mission; any mid-latitude spot works. */
+#define HOME_LAT_RAD 0.88
+#define HOME_LON_RAD 0.077
+
+#define SIM_DT        (1.0 / GLUONSCRIPT_HZ)
+#define TURN_RATE     DEG2RAD(30.0)     /* rad/s, a gentle fixed-wing turn */
+#define CLIMB_RATE    5.0               /* m/s */
+#define MAX_TICKS     1000000L          /* ~28 simulated hours: a stuck plan, not a slow one */
+#define STALL_TICKS   3000              /* 5 minutes on one codeline means the model stopped converging */
+
+static int verbose = 0;
+
+extern float latitude_meter_per_radian;     /* set by navigation_set_home() */
+extern float longitude_meter_per_radian;
+
+/* Simulated aircraft state lives directly in sensor_data.gps. */
+static void aircraft_reset(void)
+{
+	memset((void*)&sensor_data, 0, sizeof(sensor_data));
+	sensor_data.gps.latitude_rad = HOME_LAT_RAD;
+	sensor_data.gps.longitude_rad = HOME_LON_RAD;
+	sensor_data.gps.speed_ms = config.control.cruising_speed_ms;
+	sensor_data.gps.heading_rad = 0.0;
+	sensor_data.gps.status = ACTIVE;
+	sensor_data.gps.satellites_in_view = 8;
+	sensor_data.pressure_height = 0.0f;
+	sensor_data.yaw = sensor_data.gps.heading_rad;   /* no wind: track = attitude */
+}
+
+/*
+ *   One 100ms step of the point mass: slew heading towards the
+ *   interpreter's desired heading, slew altitude towards the desired AGL
+ *   and integrate the position.
+ */
+static void aircraft_step(void)
+{
+	double err = navigation_data.desired_heading_rad - sensor_data.gps.heading_rad;
+	double desired_height, height_err;
+
+	while (err > PI)
+		err -= 2.0 * PI;
+	while (err < -PI)
+		err += 2.0 * PI;
+	if (err > TURN_RATE * SIM_DT)
+		err = TURN_RATE * SIM_DT;
+	else if (err < -TURN_RATE * SIM_DT)
+		err = -TURN_RATE * SIM_DT;
+	sensor_data.gps.heading_rad += err;
+	while (sensor_data.gps.heading_rad >= 2.0 * PI)
+		sensor_data.gps.heading_rad -= 2.0 * PI;
+	while (sensor_data.gps.heading_rad < 0.0)
+		sensor_data.gps.heading_rad += 2.0 * PI;
+	sensor_data.yaw = sensor_data.gps.heading_rad;
+
+	desired_height = navigation_data.home_pressure_height + navigation_data.desired_altitude_agl;
+	height_err = desired_height - sensor_data.pressure_height;
+	if (height_err > CLIMB_RATE * SIM_DT)
+		height_err = CLIMB_RATE * SIM_DT;
+	else if (height_err < -CLIMB_RATE * SIM_DT)
+		height_err = -CLIMB_RATE * SIM_DT;
+	sensor_data.pressure_height += height_err;
+
+	sensor_data.gps.latitude_rad += cos(sensor_data.gps.heading_rad) *
+	        sensor_data.gps.speed_ms * SIM_DT / latitude_meter_per_radian;
+	sensor_data.gps.longitude_rad += sin(sensor_data.gps.heading_rad) *
+	        sensor_data.gps.speed_ms * SIM_DT / longitude_meter_per_radian;
+}
+
+static void plan_clear(void)
+{
+	int i;
+	for (i = 0; i < MAX_GLUONSCRIPTCODES; i++)
+	{
+		gluonscript_data.codes[i].opcode = EMPTYCMD;
+		gluonscript_data.codes[i].x = 0.0f;
+		gluonscript_data.codes[i].y = 0.0f;
+		gluonscript_data.codes[i].a = 0;
+		gluonscript_data.codes[i].b = 0;
+	}
+}
+
+/*
+ *   Built-in mission: CLIMB, then 60 FLY_TO_ABS waypoints zigzagging
+ *   across a ~600m wide strip - about as waypoint-dense as a mapping
+ *   flight, which is the plan shape the interpreter cost matters for.
+ */
+static int plan_builtin(const char *unused)
+{
+	(void)unused;
+	int i;
+	int line = 0;
+
+	plan_clear();
+	gluonscript_data.codes[line].opcode = CLIMB;
+	gluonscript_data.codes[line].x = 80.0f;   /* climb out to 80m agl */
+	line++;
+	for (i = 0; i < 60; i++)
+	{
+		double north_m = 100.0 + 80.0 * i;
+		double east_m = (i & 1) ? 300.0 : -300.0;
+		gluonscript_data.codes[line].opcode = FLY_TO_ABS;
+		gluonscript_data.codes[line].x = (float)(HOME_LAT_RAD + north_m / 6363057.32484);
+		gluonscript_data.codes[line].y = (float)(HOME_LON_RAD + east_m / (6363057.32484 * cos(HOME_LAT_RAD)));
+		gluonscript_data.codes[line].a = 100 + (i % 3) * 10;   /* altitude agl */
+		line++;
+	}
+	return line;   /* first line past the plan */
+}
+
+/* One codeline per "line;opcode;x;y;a;b" text line, the ND frame fields. */
+static int plan_from_file(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	char text[256];
+	int last_line = 0;
+
+	if (!f)
+	{
+		fprintf(stderr, "%s: cannot open\n", path);
+		return -1;
+	}
+	plan_clear();
+	while (fgets(text, sizeof(text), f))
+	{
+		int line, opcode, a, b;
+		double x, y;
+
+		if (sscanf(text, "%d;%d;%lf;%lf;%d;%d", &line, &opcode, &x, &y, &a, &b) != 6)
+			continue;   /* comments, blank lines */
+		if (line < 1 || line > MAX_GLUONSCRIPTCODES)
+		{
+			fprintf(stderr, "%s: codeline %d out of range\n", path, line);
+			fclose(f);
+			return -1;
+		}
+		gluonscript_data.codes[line - 1].opcode = (unsigned char)opcode;
+		gluonscript_data.codes[line - 1].x = (float)x;
+		gluonscript_data.codes[line - 1].y = (float)y;
+		gluonscript_data.codes[line - 1].a = a;
+		gluonscript_data.codes[line - 1].b = b;
+		if (line > last_line)
+			last_line = line;
+	}
+	fclose(f);
+	if (last_line == 0)
+	{
+		fprintf(stderr, "%s: no codelines found\n", path);
+		return -1;
+	}
+	return last_line;
+}
+
+static int is_waypoint_opcode(unsigned char opcode)
+{
+	return opcode == FLY_TO_ABS || opcode == FLY_TO_REL ||
+	       opcode == FROM_TO_ABS || opcode == FROM_TO_REL;
+}
+
+static int fly_mission(const char *name, int (*install_plan)(const char *), const char *arg)
+{
+	int plan_end;
+	long tick = 0;
+	long ticks_on_line = 0;
+	int last_line = 0;
+	int waypoints_hit = 0;
+	int failed = 0;
+	double tol = config.control.waypoint_radius_m + config.control.cruising_speed_ms * SIM_DT + 1.0;
+	double do_seconds = 0.0;
+	clock_t wall_start = clock();
+
+	/* the ram dataflash is blank, so init "loads" an all-EMPTYCMD plan;
+	 * the real plan is installed afterwards, like a console upload */
+	gluonscript_init();
+	plan_end = install_plan(arg);
+	if (plan_end < 0)
+		return -1;
+
+	if (gluonscript_compile() >= 0)
+	{
+		fprintf(stderr, "%s: plan rejected by gluonscript_compile() at line %d\n",
+		        name, gluonscript_compile() + 1);
+		return -1;
+	}
+	navigation_calculate_leg_cache();
+	aircraft_reset();
+
+	while (tick < MAX_TICKS)
+	{
+		int line_before = gluonscript_data.current_codeline;
+		clock_t t0 = clock();
+
+		gluonscript_do();
+		do_seconds += (double)(clock() - t0) / CLOCKS_PER_SEC;
+		tick++;
+
+		if (gluonscript_data.current_codeline != line_before)
+		{
+			struct GluonscriptCode *done = (struct GluonscriptCode*)&gluonscript_data.codes[line_before];
+
+			if (is_waypoint_opcode(done->opcode))
+			{
+				double miss = navigation_distance_between_meter(
+				        sensor_data.gps.longitude_rad, done->y,
+				        sensor_data.gps.latitude_rad, done->x);
+				waypoints_hit++;
+				if (miss > tol)
+				{
+					fprintf(stderr, "%s: line %d left %.1fm from its waypoint (radius %.1fm)\n",
+					        name, line_before + 1, miss, (double)config.control.waypoint_radius_m);
+					failed = 1;
+				}
+				if (verbose)
+					printf("t=%7.1fs line %2d reached, %5.1fm off, %3.0fm agl\n",
+					       tick * SIM_DT, line_before + 1, miss,
+					       sensor_data.pressure_height - navigation_data.home_pressure_height);
+			}
+			ticks_on_line = 0;
+			if (gluonscript_data.current_codeline >= plan_end)
+				break;   /* ran off the end of the plan: mission complete */
+		}
+		else if (++ticks_on_line > STALL_TICKS)
+		{
+			fprintf(stderr, "%s: stalled on line %d (opcode %d) for %ds of simulated time\n",
+			        name, line_before + 1,
+			        gluonscript_data.codes[line_before].opcode,
+			        (int)(STALL_TICKS * SIM_DT));
+			failed = 1;
+			break;
+		}
+
+		aircraft_step();
+		last_line = gluonscript_data.current_codeline;
+	}
+
+	if (tick >= MAX_TICKS)
+	{
+		fprintf(stderr, "%s: never reached the end of the plan (stuck near line %d)\n",
+		        name, last_line + 1);
+		failed = 1;
+	}
+	if (!navigation_data.airborne)
+	{
+		fprintf(stderr, "%s: never detected take-off\n", name);
+		failed = 1;
+	}
+
+	{
+		double wall = (double)(clock() - wall_start) / CLOCKS_PER_SEC;
+		printf("%s: %s, %d waypoints, %.1f simulated minutes in %.2fs (%.0fx), gluonscript_do %.2fus/tick\n",
+		       name, failed ? "FAILED" : "ok", waypoints_hit,
+		       tick * SIM_DT / 60.0, wall,
+		       wall > 0.0 ? tick * SIM_DT / wall : 0.0,
+		       tick > 0 ? do_seconds * 1e6 / tick : 0.0);
+	}
+	return failed ? -1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+	int i, plans = 0, failures = 0;
+
+	config.control.waypoint_radius_m = 30.0f;
+	config.control.cruising_speed_ms = 20.0f;
+	config.control.altitude_mode = PRESSURE;
+	config.control.max_roll = DEG2RAD(35.0);
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-v") == 0)
+		{
+			verbose = 1;
+			continue;
+		}
+		plans++;
+		if (fly_mission(argv[i], plan_from_file, argv[i]) != 0)
+			failures++;
+	}
+
+	if (plans == 0)   /* no files: fly the built-in regression mission */
+	{
+		if (fly_mission("builtin-zigzag-60", plan_builtin, 0) != 0)
+			failures++;
+	}
+	return failures > 0 ? 1 : 0;
+}
+
+
+/* Stubs for the firmware facilities the simulated modules call into. */
+
+void uart1_puts(char *str) { fputs(str, stderr); }
+
+void uart1_printf(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+}
+
+void latency_init() {}
+void latency_reset() {}
+void latency_mark_sample() {}
+void latency_mark_ahrs() {}
+void latency_mark_servo() {}
+
+int warmstart_attitude(float *roll_rad, float *pitch_rad, float *p_bias, float *q_bias)
+{
+	(void)roll_rad; (void)pitch_rad; (void)p_bias; (void)q_bias;
+	return 0;
+}
+int warmstart_codeline() { return -1; }   /* a mission always starts at line 0 */
+int warmstart_valid() { return 0; }
+void warmstart_init() {}
+void warmstart_save() {}
+
+void vTaskDelay(portTickType ticks) { (void)ticks; }
+void vTaskDelayUntil(portTickType *last, portTickType ticks) { (void)last; (void)ticks; }
+portTickType xTaskGetTickCount() { return 0; }
+void *pvPortMalloc(unsigned long size) { return malloc(size); }
+
+/* The servo opcodes just record; the mission checks navigation outputs. */
+static unsigned int servo_us[8];
+void servo_set_us(int servo, unsigned int us) { if (servo >= 0 && servo < 8) servo_us[servo] = us; }
+void servo_set_logical_0(int servo) { servo_set_us(servo, 1000); }
+void servo_set_logical_1(int servo) { servo_set_us(servo, 2000); }
+unsigned int servo_read_us(int channel) { return (channel >= 0 && channel < 8) ? servo_us[channel] : 0; }
+
+void osd_post_message(char *str, int blink) { (void)blink; fprintf(stderr, "[osd] %s\n", str); }
+
+/* The trigger handler's deadline shots fire immediately on the host. */
+static unsigned long sim_millis = 0;
+unsigned long timer_millis() { return sim_millis++; }
+void timer_deadline_us(unsigned long us, void (*handler)(void)) { (void)us; handler(); }
+void timer_deadline_cancel() {}
+
+/* Ram-backed dataflash: blank until a burn, so gluonscript_load() starts
+ * from an empty plan and gluonscript_burn()/scrub exercise their real code. */
+int PAGE_SIZE = 528;
+int NAVIGATION_PAGE = 0;
+#define SIM_FLASH_PAGES 8
+static unsigned char sim_flash[SIM_FLASH_PAGES * 528];
+
+static void sim_flash_open() {}
+static void sim_flash_read(int page, int size, unsigned char *buffer)
+{
+	memcpy(buffer, &sim_flash[page * PAGE_SIZE], size);
+}
+static void sim_flash_write(int page, int size, unsigned char *buffer)
+{
+	memcpy(&sim_flash[page * PAGE_SIZE], buffer, size);
+}
+struct Dataflash dataflash = { sim_flash_open, sim_flash_read, sim_flash_write,
+                               sim_flash_write, sim_flash_write, 0, 0, 0 };
+
+/* Same crc16-ccitt as configuration.c; linking configuration.c itself
+ * would drag in the whole console/uart stack. */
+unsigned int configuration_crc_update(unsigned int crc, unsigned char *data, int size)
+{
+	int i, b;
+
+	for (i = 0; i < size; i++)
+	{
+		crc ^= ((unsigned int)data[i]) << 8;
+		for (b = 0; b < 8; b++)
+			crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) & 0xffff : (crc << 1) & 0xffff;
+	}
+	return crc;
+}
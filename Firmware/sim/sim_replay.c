@@ -0,0 +1,216 @@
+/*
+ *   Host-side replay driver for the AHRS and control-stack modules.
+ *
+ *   Compiles ahrs_kalman_2x3.c and the pid/matrix/quaternion/fastmath
+ *   libraries unmodified for a PC (see the Makefile and the FreeRTOS shim
+ *   headers in shim/), then replays raw 50Hz log files through the filter
+ *   at full host speed. Input is the RAW_50HZ_LOG readout format the
+ *   firmware prints over the console:
+ *
+ *     DD;lat;lon;time;speed;heading;acc_x;acc_y;acc_z;gyro_x;gyro_y;gyro_z;height;pitch;roll;pitch_acc
+ *
+ *   For every file the driver reports the RMS and maximum deviation between
+ *   the attitude logged in flight and the attitude the current filter code
+ *   computes from the same raw samples, so a filter-tuning change can be
+ *   evaluated over hundreds of logged flights in minutes. -v additionally
+ *   dumps one line per sample for plotting.
+ *
+ *   @author   Tom Pycke
+ *   @date     31-aug-2026
+ */
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "FreeRTOS/FreeRTOS.h"
+#include "ppm_in/ppm_in.h"
+
+#include "sensors.h"
+#include "configuration.h"
+#include "ahrs.h"
+#include "gluonscript.h"
+#include "latency.h"
+#include "warmstart.h"
+
+/* Globals normally owned by the firmware tasks. */
+struct Configuration config;
+struct ControlState control_state;
+volatile struct GluonscriptData gluonscript_data;
+volatile struct ppm_info ppm;
+int HARDWARE_VERSION = V01N;
+
+static int verbose = 0;
+
+/* The same raw-to-physical scaling the on-target replay uses
+ * (print_logline_simulation() in communication_csv.c). */
+static void scale_raw(void)
+{
+	sensor_data.acc_x = ((float)sensor_data.acc_x_raw - (float)config.sensors.acc_x_neutral) / (-6600.0 * -1.0);
+	sensor_data.acc_y = ((float)sensor_data.acc_y_raw - (float)config.sensors.acc_y_neutral) / (-6600.0 * -1.0);
+	sensor_data.acc_z = ((float)sensor_data.acc_z_raw - (float)config.sensors.acc_z_neutral) / (-6600.0);
+
+	sensor_data.p = ((float)sensor_data.gyro_x_raw - config.sensors.gyro_x_neutral) * (-0.02518315 * 3.14159 / 180.0 * -1.0);
+	sensor_data.q = ((float)sensor_data.gyro_y_raw - config.sensors.gyro_y_neutral) * (-0.02538315 * 3.14159 / 180.0 * -1.0);
+	sensor_data.r = ((float)sensor_data.gyro_z_raw - config.sensors.gyro_z_neutral) * (0.0062286 * 3.14159 / 180.0);
+}
+
+static int replay_file(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	char line[256];
+	long samples = 0;
+	double sum_sq_pitch = 0.0, sum_sq_roll = 0.0;
+	double max_pitch = 0.0, max_roll = 0.0;
+	int initialized = 0;
+
+	if (!f)
+	{
+		fprintf(stderr, "%s: cannot open\n", path);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), f))
+	{
+		double lat, lon, speed;
+		long time_l;
+		int heading;
+		unsigned int ax, ay, az, gx, gy, gz;
+		double height;
+		int log_pitch, log_roll, log_pitch_acc;
+		double err_pitch, err_roll;
+
+		if (sscanf(line, "DD;%lf;%lf;%ld;%lf;%d;%u;%u;%u;%u;%u;%u;%lf;%d;%d;%d",
+		           &lat, &lon, &time_l, &speed, &heading,
+		           &ax, &ay, &az, &gx, &gy, &gz,
+		           &height, &log_pitch, &log_roll, &log_pitch_acc) != 15)
+			continue;   // headers, checksum frames, truncated lines
+
+		sensor_data.acc_x_raw = ax;
+		sensor_data.acc_y_raw = ay;
+		sensor_data.acc_z_raw = az;
+		sensor_data.gyro_x_raw = gx;
+		sensor_data.gyro_y_raw = gy;
+		sensor_data.gyro_z_raw = gz;
+		sensor_data.gps.speed_ms = (float)speed;
+		sensor_data.pressure_height = (float)height;
+		scale_raw();
+
+		if (!initialized)
+		{
+			ahrs_init();   // attitude from the first accelerometer sample
+			initialized = 1;
+		}
+		ahrs_filter(0.02f);
+		samples++;
+
+		err_pitch = sensor_data.pitch * (180.0 / 3.14159) - (double)log_pitch;
+		err_roll = sensor_data.roll * (180.0 / 3.14159) - (double)log_roll;
+		sum_sq_pitch += err_pitch * err_pitch;
+		sum_sq_roll += err_roll * err_roll;
+		if (fabs(err_pitch) > max_pitch)
+			max_pitch = fabs(err_pitch);
+		if (fabs(err_roll) > max_roll)
+			max_roll = fabs(err_roll);
+
+		if (verbose)
+			printf("%ld;%d;%d;%.2f;%.2f\n", samples, log_pitch, log_roll,
+			       sensor_data.pitch * (180.0 / 3.14159), sensor_data.roll * (180.0 / 3.14159));
+	}
+	fclose(f);
+
+	if (samples == 0)
+	{
+		fprintf(stderr, "%s: no RAW_50HZ_LOG lines found\n", path);
+		return -1;
+	}
+
+	printf("%s: %ld samples (%.1f min), rms pitch %.2f deg, rms roll %.2f deg, max pitch %.2f, max roll %.2f\n",
+	       path, samples, (double)samples * 0.02 / 60.0,
+	       sqrt(sum_sq_pitch / (double)samples), sqrt(sum_sq_roll / (double)samples),
+	       max_pitch, max_roll);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int i, files = 0;
+
+	/* the defaults from configuration_default(); override per flight with
+	 * the neutrals noted in the log's boot banner when they matter */
+	config.sensors.acc_x_neutral = 32000;
+	config.sensors.acc_y_neutral = 32000;
+	config.sensors.acc_z_neutral = 32000;
+	config.sensors.gyro_x_neutral = 27180.0f;
+	config.sensors.gyro_y_neutral = 26304.0f;
+	config.sensors.gyro_z_neutral = 31850.0f;
+	config.sensors.neutral_pitch = 0.0f;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-v") == 0)
+		{
+			verbose = 1;
+			continue;
+		}
+		if (replay_file(argv[i]) == 0)
+			files++;
+	}
+
+	if (files == 0)
+	{
+		fprintf(stderr, "usage: sim_replay [-v] logfile...\n");
+		fprintf(stderr, "  logfile: RAW_50HZ_LOG console readout (DD;... lines)\n");
+		return 1;
+	}
+	return 0;
+}
+
+
+/* Stubs for the firmware facilities the simulated modules call into. */
+
+void uart1_puts(char *str) { fputs(str, stderr); }
+
+void uart1_printf(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+}
+
+struct GluonscriptCode *gluonscript_next_waypoint_code(int current_codeline)
+{
+	(void)current_codeline;
+	return (struct GluonscriptCode*)0;
+}
+
+float gluonscript_get_variable(enum gluonscript_variable v)
+{
+	(void)v;
+	return 0.0f;
+}
+
+void latency_init() {}
+void latency_reset() {}
+void latency_mark_sample() {}
+void latency_mark_ahrs() {}
+void latency_mark_servo() {}
+struct LatencyHistogram latency_sample_to_ahrs;
+struct LatencyHistogram latency_sample_to_servo;
+
+int warmstart_attitude(float *roll_rad, float *pitch_rad, float *p_bias, float *q_bias)
+{
+	(void)roll_rad; (void)pitch_rad; (void)p_bias; (void)q_bias;
+	return 0;   // a replay always cold-starts the filter
+}
+int warmstart_codeline() { return -1; }
+int warmstart_valid() { return 0; }
+void warmstart_init() {}
+void warmstart_save() {}
+
+void vTaskDelay(portTickType ticks) { (void)ticks; }
+void vTaskDelayUntil(portTickType *last, portTickType ticks) { (void)last; (void)ticks; }
+portTickType xTaskGetTickCount() { return 0; }
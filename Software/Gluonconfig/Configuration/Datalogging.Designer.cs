@@ -29,6 +29,7 @@
             this.toolStrip1 = new System.Windows.Forms.ToolStrip();
             this._btn_read = new System.Windows.Forms.ToolStripButton();
             this._btn_download = new System.Windows.Forms.ToolStripButton();
+            this._btn_raw_download = new System.Windows.Forms.ToolStripButton();
             this.toolStripSeparator2 = new System.Windows.Forms.ToolStripSeparator();
             this._btn_open = new System.Windows.Forms.ToolStripButton();
             this.toolStripDropDownButton1 = new System.Windows.Forms.ToolStripDropDownButton();
@@ -144,6 +145,7 @@
             this.toolStrip1.Items.AddRange(new System.Windows.Forms.ToolStripItem[] {
             this._btn_read,
             this._btn_download,
+            this._btn_raw_download,
             this.toolStripSeparator2,
             this._btn_open,
             this.toolStripDropDownButton1,
@@ -176,6 +178,15 @@
             this._btn_download.ToolTipText = "Download selected logging";
             this._btn_download.Click += new System.EventHandler(this._btn_download_Click);
             // 
+            // _btn_raw_download
+            // 
+            this._btn_raw_download.DisplayStyle = System.Windows.Forms.ToolStripItemDisplayStyle.Text;
+            this._btn_raw_download.Name = "_btn_raw_download";
+            this._btn_raw_download.Size = new System.Drawing.Size(81, 22);
+            this._btn_raw_download.Text = "Raw download";
+            this._btn_raw_download.ToolTipText = "Download the raw flash pages of the selected logging (binary protocol, resumable)";
+            this._btn_raw_download.Click += new System.EventHandler(this._btn_raw_download_Click);
+            // 
             // toolStripSeparator2
             // 
             this.toolStripSeparator2.Name = "toolStripSeparator2";
@@ -303,6 +314,7 @@
         private System.Windows.Forms.Button _btn_readloggings;
         private System.Windows.Forms.ToolStripButton _btn_read;
         private System.Windows.Forms.ToolStripButton _btn_download;
+        private System.Windows.Forms.ToolStripButton _btn_raw_download;
         private System.Windows.Forms.ToolStripSeparator toolStripSeparator2;
         private System.Windows.Forms.ToolStripDropDownButton toolStripDropDownButton1;
         private System.Windows.Forms.ToolStripButton _btn_open;
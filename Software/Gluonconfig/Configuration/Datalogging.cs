@@ -18,6 +18,10 @@ namespace Configuration
     {
         private SerialCommunication serial;
         private DataSet loglines;
+        private DatalogDownloader downloader;
+        // builds the KML track incrementally while the lines download
+        private Kml.KmlTrackStreamWriter kml_writer;
+        private DateTime download_timestamp = DateTime.Now;
 
         public Datalogging()
         {
@@ -58,6 +62,11 @@ namespace Configuration
 
             serial.DatalogTableCommunicationReceived += new SerialCommunication.ReceiveDatalogTableCommunicationFrame(ReceiveDatalogTable);
             serial.DatalogLineCommunicationReceived += new SerialCommunication.ReceiveDatalogLineCommunicationFrame(ReceiveDatalogLine);
+
+            // a raw download interrupted by a disconnect continues where it
+            // stopped: only the missing pages are requested again
+            if (downloader != null && !downloader.Complete)
+                downloader.Resume(serial);
         }
 
         public void Disconnect()
@@ -83,7 +92,18 @@ namespace Configuration
                 _lv_datalogtable.SelectedIndices[0] > 15)
                 MessageBox.Show("Please select 1 row from the index table.");
             else
+            {
+                kml_writer = null;
+                try
+                {
+                    download_timestamp = (DateTime)_lv_datalogtable.SelectedItems[0].Tag;
+                }
+                catch (Exception ex)
+                {
+                    download_timestamp = DateTime.Now;
+                }
                 serial.SendDatalogTableRead(_lv_datalogtable.SelectedIndices[0]);
+            }
         }
 
         private void _btn_readloggings_Click(object sender, EventArgs e)
@@ -91,6 +111,64 @@ namespace Configuration
             _btn_download_Click(sender, e);
         }
 
+        private void _btn_raw_download_Click(object sender, EventArgs e)
+        {
+            if (downloader != null && !downloader.Complete)
+            {
+                downloader.Resume(serial);
+                return;
+            }
+            if (_lv_datalogtable.SelectedIndices.Count != 1)
+            {
+                MessageBox.Show("Please select 1 row from the index table.");
+                return;
+            }
+
+            // the selected logging runs from its start page up to the start
+            // page of the next one (or the end of the 4096 page flash)
+            int index = _lv_datalogtable.SelectedIndices[0];
+            int first_page = int.Parse(_lv_datalogtable.Items[index].SubItems[1].Text);
+            int last_page = 4095;
+            if (index + 1 < _lv_datalogtable.Items.Count &&
+                _lv_datalogtable.Items[index + 1].SubItems.Count > 1 &&
+                _lv_datalogtable.Items[index + 1].SubItems[1].Text != "")
+                last_page = int.Parse(_lv_datalogtable.Items[index + 1].SubItems[1].Text) - 1;
+            if (last_page < first_page)
+                last_page = 4095;
+
+            SaveFileDialog sfd = new SaveFileDialog();
+            sfd.DefaultExt = "bin";
+            sfd.Filter = "Raw log files (*.bin)|*.bin|All files (*.*)|*.*";
+            if (sfd.ShowDialog() != DialogResult.OK)
+                return;
+
+            downloader = new DatalogDownloader(serial, first_page, last_page, sfd.FileName);
+            downloader.ProgressChanged += new DatalogDownloader.ProgressChangedHandler(DownloaderProgressChanged);
+            downloader.DownloadCompleted += new DatalogDownloader.DownloadCompletedHandler(DownloaderCompleted);
+        }
+
+        void DownloaderProgressChanged(int pagesDone, int pagesTotal, double kbPerSecond)
+        {
+            this.BeginInvoke(new DatalogDownloader.ProgressChangedHandler(UpdateDownloadProgress),
+                             new object[] { pagesDone, pagesTotal, kbPerSecond });
+        }
+        private void UpdateDownloadProgress(int pagesDone, int pagesTotal, double kbPerSecond)
+        {
+            _pb.Value = pagesTotal > 0 ? pagesDone * 100 / pagesTotal : 0;
+            _btn_raw_download.Text = "Raw download (" + kbPerSecond.ToString("F1") + " kB/s)";
+        }
+
+        void DownloaderCompleted(string filename)
+        {
+            this.BeginInvoke(new DatalogDownloader.DownloadCompletedHandler(DownloadCompleted),
+                             new object[] { filename });
+        }
+        private void DownloadCompleted(string filename)
+        {
+            _btn_raw_download.Text = "Raw download";
+            MessageBox.Show("Raw log saved to " + filename);
+        }
+
 
         void ReceiveDatalogTable(DatalogTable table)
         {
@@ -141,6 +219,7 @@ namespace Configuration
             // first call: init dataset & headers
             if (loglines == null)
             {
+                kml_writer = new Kml.KmlTrackStreamWriter(download_timestamp);
                 loglines = new DataSet();
                 loglines.Tables.Add("Data");
 
@@ -161,6 +240,20 @@ namespace Configuration
                 dr[i] = line.Line[i];
             loglines.Tables["Data"].Rows.Add(dr);
 
+            // grow the KML track while the download runs: the export is
+            // ready the moment the last line arrives
+            if (kml_writer != null)
+            {
+                try
+                {
+                    kml_writer.AddLine(line);
+                }
+                catch (Exception ex)   // line without the track columns
+                {
+                    kml_writer = null;
+                }
+            }
+
             _pb.Value = (_pb.Value + 1) % 100;
 
         }
@@ -257,7 +350,10 @@ namespace Configuration
                 StreamWriter sw = new StreamWriter(s);
                 try
                 {
-                    sw.Write(Kml.KmlTrackGenerator.BuildKml(loglines, timestamp));
+                    if (kml_writer != null && kml_writer.Rows > 0)
+                        sw.Write(kml_writer.Finish());   // prebuilt during the download
+                    else
+                        sw.Write(Kml.KmlTrackGenerator.BuildKml(loglines, timestamp));
                 }
                 catch (Exception ex)
                 {
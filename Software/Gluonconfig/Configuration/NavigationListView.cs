@@ -57,7 +57,10 @@ namespace Configuration
             base.Dispose(disposing);
 
             if (serial != null)
+            {
                 serial.NavigationInstructionCommunicationReceived -= new SerialCommunication.ReceiveNavigationInstructionCommunicationFrame(_serial_NavigationInstructionCommunicationReceived);
+                serial.NavigationHashCommunicationReceived -= new SerialCommunication.ReceiveNavigationHashCommunicationFrame(_serial_NavigationHashCommunicationReceived);
+            }
 
         }
 
@@ -67,6 +70,7 @@ namespace Configuration
             {
                 this.serial = serial;
                 serial.NavigationInstructionCommunicationReceived += new SerialCommunication.ReceiveNavigationInstructionCommunicationFrame(_serial_NavigationInstructionCommunicationReceived);
+                serial.NavigationHashCommunicationReceived += new SerialCommunication.ReceiveNavigationHashCommunicationFrame(_serial_NavigationHashCommunicationReceived);
 
                 _btn_burn.Enabled = true;
                 _btn_read.Enabled = true;
@@ -79,6 +83,7 @@ namespace Configuration
         public void Disconnect()
         {
             serial.NavigationInstructionCommunicationReceived -= new SerialCommunication.ReceiveNavigationInstructionCommunicationFrame(_serial_NavigationInstructionCommunicationReceived);
+            serial.NavigationHashCommunicationReceived -= new SerialCommunication.ReceiveNavigationHashCommunicationFrame(_serial_NavigationHashCommunicationReceived);
 
             _btn_burn.Enabled = false;
             _btn_read.Enabled = false;
@@ -111,6 +116,24 @@ namespace Configuration
             }
         }
 
+        private void _serial_NavigationHashCommunicationReceived(int crc, int line_count)
+        {
+            this.BeginInvoke(new D_ReceiveNavigationHash(NavigationHashReceived), new object[] { crc, line_count });
+        }
+        private delegate void D_ReceiveNavigationHash(int crc, int line_count);
+        private void NavigationHashReceived(int crc, int line_count)
+        {
+            int local = serial.LocalNavigationCrc(line_count);
+            if (local == crc)
+                return;   // plans match; every line upload was already echoed back
+
+            // either we haven't seen the full plan yet (local < 0) or a line got
+            // mangled in transit: fall back to a full read
+            if (local >= 0)
+                MessageBox.Show("The flightplan on the module differs from the local copy; re-reading all lines.", "Verification failed", MessageBoxButtons.OK, MessageBoxIcon.Exclamation);
+            serial.SendNavigationRead();
+        }
+
 
         private void _btn_read_Click(object sender, EventArgs e)
         {
@@ -172,7 +195,9 @@ namespace Configuration
 
             _pb.Value = 100;
 
-            serial.SendNavigationRead();
+            // each written line was echoed back as an ND frame; ask the module
+            // for its plan crc instead of re-reading all the lines
+            serial.SendNavigationHashRequest();
         }
 
         private void _btn_burn_Click(object sender, EventArgs e)
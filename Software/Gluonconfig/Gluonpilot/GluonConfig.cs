@@ -217,14 +217,52 @@ namespace Gluonpilot
             if (_serial.IsOpen)  // Close the current connection if it's open
                 _serial.Close(); //_btn_connect_Click(null, null);
 
-            string c = " -k=" + port + " -f=\"" + fd.FileName + "\"  -p -d=dsPIC33FJ256MC710 -u=" + baudrate + " -q=0a;5a;5a;3b;31;31;32;33;0a -r=115200 -b=1200 -o";
+            // Differential update: when we still have the hex that was last flashed
+            // from this PC, offer to upload only the erase pages that changed (see
+            // HexDiff). A tuning iteration then flashes in seconds instead of minutes.
+            string hexToFlash = fd.FileName;
+            string lastHex = Path.Combine(
+                Path.Combine(Environment.GetFolderPath(Environment.SpecialFolder.ApplicationData), "Gluonpilot"),
+                "lastflashed.hex");
+            if (File.Exists(lastHex))
+            {
+                int changedPages, totalPages;
+                string reducedHex = Path.Combine(Path.GetTempPath(), "gluonpilot_diff.hex");
+                if (HexDiff.TryWriteDiff(lastHex, fd.FileName, reducedHex, out changedPages, out totalPages) &&
+                    changedPages < totalPages)
+                {
+                    if (MessageBox.Show("Only " + changedPages + " of " + totalPages + " flash pages differ from the firmware last flashed from this PC.\r\nFlash only the changed pages?\r\n\r\nChoose No if another board was flashed in between.",
+                                        "Differential update", MessageBoxButtons.YesNo, MessageBoxIcon.Question) == DialogResult.Yes)
+                        hexToFlash = reducedHex;
+                }
+            }
+
+            // --polltime=1: the console polls the serial port for the per-row ack at this
+            // interval; the default adds most of a poll period of dead time to every one
+            // of the ~1300 row handshakes, which dominates the flash time over XBee.
+            // --disable-empty-pages: blank pages in a padded hex are not transferred.
+            // The upload itself already runs at the bootloader's fixed 115200 baud (-r).
+            string c = " -k=" + port + " -f=\"" + hexToFlash + "\"  -p -d=dsPIC33FJ256MC710 -u=" + baudrate + " -q=0a;5a;5a;3b;31;31;32;33;0a -r=115200 -b=1200 -o --polltime=1 --disable-empty-pages";
             Process p = System.Diagnostics.Process.Start(Application.StartupPath + "\\ds30loader\\ds30LoaderConsole.exe", c);
             p.WaitForExit();
 
 
 
             if (p.ExitCode != -1)
+            {
+                try
+                {
+                    // Always cache the full hex, also after a differential flash:
+                    // the board now matches fd.FileName completely.
+                    Directory.CreateDirectory(Path.GetDirectoryName(lastHex));
+                    File.Copy(fd.FileName, lastHex, true);
+                }
+                catch (Exception)
+                {
+                    // failing to cache only disables the next differential offer
+                }
                 MessageBox.Show("New firmware has been written", "Success", MessageBoxButtons.OK, MessageBoxIcon.Information);
+            }
             else
             {
                 if (MessageBox.Show("There has been an error!", "Error", MessageBoxButtons.RetryCancel, MessageBoxIcon.Error) == DialogResult.Retry)
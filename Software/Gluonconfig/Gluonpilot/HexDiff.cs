@@ -0,0 +1,201 @@
+﻿using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Text;
+
+namespace Gluonpilot
+{
+    /*
+     * Differential firmware upload helper: compares a new Intel HEX file with
+     * the hex that was last flashed from this PC and writes a reduced hex that
+     * only contains the erase pages that actually changed. ds30LoaderConsole
+     * programs just the rows present in the file it is given, so flashing the
+     * reduced hex reprograms only those pages: a typical tuning iteration that
+     * touches a few KB of control code flashes in seconds, and the untouched
+     * pages keep their erase cycles.
+     *
+     * Safety rules:
+     *  - granularity is one erase page (512 instructions = 0x800 hex byte
+     *    addresses), because the bootloader erases a whole page before writing
+     *    the first row in it: a page is either fully present or fully absent;
+     *  - page 0 is always included, so the console can always regenerate the
+     *    "goto user application" it writes into the bootloader page;
+     *  - the configuration registers (0xF80000 in program addresses) are
+     *    always included;
+     *  - any parse problem makes TryWriteDiff return false and the caller
+     *    falls back to a full upload.
+     */
+    public static class HexDiff
+    {
+        private const long PageBytes = 0x800;        // one erase page in hex byte addresses (2x program address)
+        private const long ConfigStart = 0x1F00000;  // config registers at program address 0xF80000
+
+        /*
+         * Writes reducedHexPath with only the changed pages of newHexPath.
+         * Returns false (and writes nothing) when either hex cannot be parsed;
+         * changedPages/totalPages tell the caller what a differential flash
+         * would save.
+         */
+        public static bool TryWriteDiff(string lastHexPath, string newHexPath, string reducedHexPath,
+                                        out int changedPages, out int totalPages)
+        {
+            changedPages = 0;
+            totalPages = 0;
+            try
+            {
+                Dictionary<long, byte> last = Parse(lastHexPath);
+                Dictionary<long, byte> fresh = Parse(newHexPath);
+
+                // pages (below the config registers) present in the new hex
+                Dictionary<long, bool> pages = new Dictionary<long, bool>();
+                foreach (long a in fresh.Keys)
+                    if (a < ConfigStart)
+                        pages[PageOf(a)] = true;
+
+                // pages where any byte differs; absent bytes read as 0xFF
+                Dictionary<long, bool> keep = new Dictionary<long, bool>();
+                keep[0] = true;   // reset vector page, source of the bootloader goto
+                foreach (KeyValuePair<long, byte> kv in fresh)
+                {
+                    if (kv.Key >= ConfigStart)
+                        continue;
+                    byte old;
+                    if (!last.TryGetValue(kv.Key, out old))
+                        old = 0xFF;
+                    if (old != kv.Value)
+                        keep[PageOf(kv.Key)] = true;
+                }
+                foreach (KeyValuePair<long, byte> kv in last)
+                {
+                    if (kv.Key >= ConfigStart || fresh.ContainsKey(kv.Key))
+                        continue;
+                    if (kv.Value != 0xFF && pages.ContainsKey(PageOf(kv.Key)))
+                        keep[PageOf(kv.Key)] = true;
+                }
+
+                totalPages = pages.Count;
+                foreach (long page in keep.Keys)
+                    if (pages.ContainsKey(page))
+                        changedPages++;
+
+                SortedDictionary<long, byte> reduced = new SortedDictionary<long, byte>();
+                foreach (KeyValuePair<long, byte> kv in fresh)
+                    if (kv.Key >= ConfigStart || keep.ContainsKey(PageOf(kv.Key)))
+                        reduced[kv.Key] = kv.Value;
+
+                Write(reducedHexPath, reduced);
+                return true;
+            }
+            catch (Exception)
+            {
+                return false;
+            }
+        }
+
+        private static long PageOf(long address)
+        {
+            return address - (address % PageBytes);
+        }
+
+        private static int Hex8(string line, int at)
+        {
+            return Convert.ToInt32(line.Substring(at, 2), 16);
+        }
+
+        // byte address -> value from the :LLAAAATTdd..CC records
+        private static Dictionary<long, byte> Parse(string path)
+        {
+            Dictionary<long, byte> bytes = new Dictionary<long, byte>();
+            long upper = 0;
+
+            foreach (string raw in File.ReadAllLines(path))
+            {
+                string line = raw.Trim();
+                if (line.Length == 0)
+                    continue;
+                if (line[0] != ':' || line.Length < 11 || (line.Length % 2) == 0)
+                    throw new FormatException("Not an Intel HEX record: " + line);
+
+                int len = Hex8(line, 1);
+                int address = (Hex8(line, 3) << 8) | Hex8(line, 5);
+                int type = Hex8(line, 7);
+                if (line.Length != 11 + len * 2)
+                    throw new FormatException("Record length mismatch: " + line);
+
+                int sum = 0;
+                for (int i = 1; i < line.Length; i += 2)
+                    sum += Hex8(line, i);
+                if ((sum & 0xFF) != 0)
+                    throw new FormatException("Record checksum error: " + line);
+
+                if (type == 0)
+                {
+                    for (int i = 0; i < len; i++)
+                        bytes[upper + address + i] = (byte)Hex8(line, 9 + i * 2);
+                }
+                else if (type == 4)
+                {
+                    upper = (long)((Hex8(line, 9) << 8) | Hex8(line, 11)) << 16;
+                }
+                else if (type == 1)
+                {
+                    break;
+                }
+                else if (type != 3 && type != 5)   // start address records carry no data
+                {
+                    throw new FormatException("Unsupported record type " + type);
+                }
+            }
+            return bytes;
+        }
+
+        private static void AppendRecord(StringBuilder sb, int address, int type, byte[] data)
+        {
+            int sum = data.Length + (address >> 8) + (address & 0xFF) + type;
+            sb.Append(':');
+            sb.Append(data.Length.ToString("X2"));
+            sb.Append(address.ToString("X4"));
+            sb.Append(type.ToString("X2"));
+            foreach (byte b in data)
+            {
+                sb.Append(b.ToString("X2"));
+                sum += b;
+            }
+            sb.Append(((byte)(-sum)).ToString("X2"));
+            sb.Append("\r\n");
+        }
+
+        private static void Write(string path, SortedDictionary<long, byte> bytes)
+        {
+            StringBuilder sb = new StringBuilder();
+            List<long> addresses = new List<long>(bytes.Keys);   // sorted
+            long upper = -1;
+            int i = 0;
+
+            while (i < addresses.Count)
+            {
+                long start = addresses[i];
+                if ((start >> 16) != upper)
+                {
+                    upper = start >> 16;
+                    AppendRecord(sb, 0, 4, new byte[] { (byte)(upper >> 8), (byte)upper });
+                }
+
+                // up to 16 contiguous bytes that stay inside this 64K block
+                int n = 1;
+                while (n < 16 && i + n < addresses.Count &&
+                       addresses[i + n] == start + n && ((start + n) >> 16) == upper)
+                    n++;
+
+                byte[] data = new byte[n];
+                for (int j = 0; j < n; j++)
+                    data[j] = bytes[start + j];
+                AppendRecord(sb, (int)(start & 0xFFFF), 0, data);
+                i += n;
+            }
+
+            AppendRecord(sb, 0, 1, new byte[0]);
+            File.WriteAllText(path, sb.ToString());
+        }
+    }
+}
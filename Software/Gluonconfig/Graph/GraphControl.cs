@@ -23,6 +23,100 @@ namespace Graph
         private int _timewindow = 30;
         private Dictionary<string, LineItem> _lineItems = new Dictionary<string, LineItem>();
 
+        // Min/max decimation: samples are collected into one bucket per
+        // horizontal pixel and only the bucket envelope (min and max, in
+        // sample order) is appended to the curve. At 50Hz streams this keeps
+        // the point lists and the repaint cost bounded by the plot width
+        // instead of the sample rate.
+        private class SeriesBucket
+        {
+            public double BucketEnd;
+            public double Min, Max;
+            public double MinTime, MaxTime;
+            public bool Filled;
+        }
+        private Dictionary<string, SeriesBucket> _buckets = new Dictionary<string, SeriesBucket>();
+        private DateTime _lastRedraw = DateTime.MinValue;
+
+        private double BucketWidth()
+        {
+            double pixels = _zed_graph.GraphPane.Chart.Rect.Width;
+            if (pixels < 1.0)
+                pixels = Width > 0 ? Width : 500.0;
+            return (double)_timewindow / pixels;
+        }
+
+        private void AppendPoint(string key, double time, double value)
+        {
+            if (!_lineItems.ContainsKey(key))
+                return;
+
+            SeriesBucket b;
+            if (!_buckets.TryGetValue(key, out b))
+            {
+                b = new SeriesBucket();
+                _buckets.Add(key, b);
+            }
+
+            if (b.Filled && time >= b.BucketEnd)
+            {
+                // bucket complete: append its envelope in sample order
+                LineItem li = _lineItems[key];
+                if (b.MinTime <= b.MaxTime)
+                {
+                    li.AddPoint(new PointPair(b.MinTime, b.Min));
+                    if (b.MaxTime > b.MinTime)
+                        li.AddPoint(new PointPair(b.MaxTime, b.Max));
+                }
+                else
+                {
+                    li.AddPoint(new PointPair(b.MaxTime, b.Max));
+                    li.AddPoint(new PointPair(b.MinTime, b.Min));
+                }
+                b.Filled = false;
+            }
+
+            if (!b.Filled)
+            {
+                b.BucketEnd = time + BucketWidth();
+                b.Min = value;
+                b.Max = value;
+                b.MinTime = time;
+                b.MaxTime = time;
+                b.Filled = true;
+            }
+            else
+            {
+                if (value < b.Min)
+                {
+                    b.Min = value;
+                    b.MinTime = time;
+                }
+                if (value > b.Max)
+                {
+                    b.Max = value;
+                    b.MaxTime = time;
+                }
+            }
+        }
+
+        private void RedrawIfDue(double time)
+        {
+            // 25 fps is plenty; the samples keep accumulating in the buckets
+            if ((DateTime.Now - _lastRedraw).TotalMilliseconds < 40.0)
+                return;
+            _lastRedraw = DateTime.Now;
+
+            Scale xScale = _zed_graph.GraphPane.XAxis.Scale;
+            if (time > xScale.Max - xScale.MajorStep)
+            {
+                xScale.Max = time + xScale.MajorStep;
+                xScale.Min = xScale.Max - _timewindow;
+            }
+            _zed_graph.AxisChange();
+            _zed_graph.Invalidate(true);
+        }
+
         public GraphControl()
         {
             InitializeComponent();
@@ -60,31 +154,13 @@ namespace Graph
         private void UpdateGyroAccRaw(GyroAccRaw ga)
         {
             double time = (DateTime.Now - _beginDateTime).TotalSeconds;
-            if (_lineItems.ContainsKey("Raw acceleration X"))
-                _lineItems["Raw acceleration X"].AddPoint(new PointPair(time, ga.AccXRaw));
-
-            if (_lineItems.ContainsKey("Raw acceleration Y"))
-                _lineItems["Raw acceleration Y"].AddPoint(new PointPair(time, ga.AccYRaw));
-                
-            if (_lineItems.ContainsKey("Raw acceleration Z"))
-                _lineItems["Raw acceleration Z"].AddPoint(new PointPair(time, ga.AccZRaw));
-
-            if (_lineItems.ContainsKey("Raw gyro X"))
-                _lineItems["Raw gyro X"].AddPoint(new PointPair(time, ga.GyroXRaw));
-            if (_lineItems.ContainsKey("Raw gyro Y"))
-                _lineItems["Raw gyro Y"].AddPoint(new PointPair(time, ga.GyroYRaw));
-            if (_lineItems.ContainsKey("Raw gyro Z"))
-                _lineItems["Raw gyro Z"].AddPoint(new PointPair(time, ga.GyroZRaw));
-
-
-            Scale xScale = _zed_graph.GraphPane.XAxis.Scale;
-            if (time > xScale.Max - xScale.MajorStep)
-            {
-                xScale.Max = time + xScale.MajorStep;
-                xScale.Min = xScale.Max - _timewindow;
-            }
-            _zed_graph.AxisChange();
-            _zed_graph.Invalidate(true);
+            AppendPoint("Raw acceleration X", time, ga.AccXRaw);
+            AppendPoint("Raw acceleration Y", time, ga.AccYRaw);
+            AppendPoint("Raw acceleration Z", time, ga.AccZRaw);
+            AppendPoint("Raw gyro X", time, ga.GyroXRaw);
+            AppendPoint("Raw gyro Y", time, ga.GyroYRaw);
+            AppendPoint("Raw gyro Z", time, ga.GyroZRaw);
+            RedrawIfDue(time);
         }
 
 
@@ -96,28 +172,13 @@ namespace Graph
         private void UpdateGyroAccProc(GyroAccProcessed ga)
         {
             double time = (DateTime.Now - _beginDateTime).TotalSeconds;
-
-            if (_lineItems.ContainsKey("Rotationrate X"))
-                _lineItems["Rotationrate X"].AddPoint(new PointPair(time, ga.GyroX));
-            if (_lineItems.ContainsKey("Rotationrate Y"))
-                _lineItems["Rotationrate Y"].AddPoint(new PointPair(time, ga.GyroY));
-            if (_lineItems.ContainsKey("Rotationrate Z"))
-                _lineItems["Rotationrate Z"].AddPoint(new PointPair(time, ga.GyroZ));
-            if (_lineItems.ContainsKey("Acceleration X"))
-                _lineItems["Acceleration X"].AddPoint(new PointPair(time, ga.AccX));
-            if (_lineItems.ContainsKey("Acceleration Y"))
-                _lineItems["Acceleration Y"].AddPoint(new PointPair(time, ga.AccY));
-            if (_lineItems.ContainsKey("Acceleration Z"))
-                _lineItems["Acceleration Z"].AddPoint(new PointPair(time, ga.AccZ));
-
-            Scale xScale = _zed_graph.GraphPane.XAxis.Scale;
-            if (time > xScale.Max - xScale.MajorStep)
-            {
-                xScale.Max = time + xScale.MajorStep;
-                xScale.Min = xScale.Max - _timewindow;
-            }
-            _zed_graph.AxisChange();
-            _zed_graph.Invalidate(true);
+            AppendPoint("Rotationrate X", time, ga.GyroX);
+            AppendPoint("Rotationrate Y", time, ga.GyroY);
+            AppendPoint("Rotationrate Z", time, ga.GyroZ);
+            AppendPoint("Acceleration X", time, ga.AccX);
+            AppendPoint("Acceleration Y", time, ga.AccY);
+            AppendPoint("Acceleration Z", time, ga.AccZ);
+            RedrawIfDue(time);
         }
 
 
@@ -129,27 +190,12 @@ namespace Graph
         private void UpdateAttitude(Attitude attitude)
         {
             double time = (DateTime.Now - _beginDateTime).TotalSeconds;
-            if (_lineItems.ContainsKey("Roll"))
-                _lineItems["Roll"].AddPoint(new PointPair(time, attitude.RollDeg));
-
-            if (_lineItems.ContainsKey("Pitch"))
-                _lineItems["Pitch"].AddPoint(new PointPair(time, attitude.PitchDeg));
-            if (_lineItems.ContainsKey("Roll acc"))
-                _lineItems["Roll acc"].AddPoint(new PointPair(time, attitude.RollAccDeg));
-            if (_lineItems.ContainsKey("Pitch acc"))
-                _lineItems["Pitch acc"].AddPoint(new PointPair(time, attitude.PitchAccDeg));
-            if (_lineItems.ContainsKey("Yaw"))
-                _lineItems["Yaw"].AddPoint(new PointPair(time, attitude.YawDeg));
-
-
-            Scale xScale = _zed_graph.GraphPane.XAxis.Scale;
-            if (time > xScale.Max - xScale.MajorStep)
-            {
-                xScale.Max = time + xScale.MajorStep;
-                xScale.Min = xScale.Max - _timewindow;
-            }
-            _zed_graph.AxisChange();
-            _zed_graph.Invalidate(true);
+            AppendPoint("Roll", time, attitude.RollDeg);
+            AppendPoint("Pitch", time, attitude.PitchDeg);
+            AppendPoint("Roll acc", time, attitude.RollAccDeg);
+            AppendPoint("Pitch acc", time, attitude.PitchAccDeg);
+            AppendPoint("Yaw", time, attitude.YawDeg);
+            RedrawIfDue(time);
         }
 
 
@@ -166,21 +212,9 @@ namespace Graph
         private void UpdateScp1000(PressureTemp pt)
         {
             double time = (DateTime.Now - _beginDateTime).TotalSeconds;
-            if (_lineItems.ContainsKey("Height (SCP1000)"))
-                _lineItems["Height (SCP1000)"].AddPoint(new PointPair(time, pt.Height));
-
-            if (_lineItems.ContainsKey("Temperature (SCP1000)"))
-                _lineItems["Temperature (SCP1000)"].AddPoint(new PointPair(time, pt.Temperature));
-
-
-            Scale xScale = _zed_graph.GraphPane.XAxis.Scale;
-            if (time > xScale.Max - xScale.MajorStep)
-            {
-                xScale.Max = time + xScale.MajorStep;
-                xScale.Min = xScale.Max - _timewindow;
-            }
-            _zed_graph.AxisChange();
-            _zed_graph.Invalidate(true);
+            AppendPoint("Height (SCP1000)", time, pt.Height);
+            AppendPoint("Temperature (SCP1000)", time, pt.Temperature);
+            RedrawIfDue(time);
         }
 
         private void Graph_Load(object sender, EventArgs e)
@@ -240,6 +274,7 @@ namespace Graph
                         // not checheckt but in graph list -> delete
                         _zed_graph.GraphPane.CurveList.Remove(_lineItems[o.ToString()]);
                         _lineItems.Remove(o.ToString());
+                        _buckets.Remove(o.ToString());
                     }
                 }
             }
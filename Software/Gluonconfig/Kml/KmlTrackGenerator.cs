@@ -197,7 +197,7 @@ namespace Kml
            return sb.ToString();
        }
 
-       private static void WriteTrackStyle(StringBuilder sb)
+       internal static void WriteTrackStyle(StringBuilder sb)
        {
            sb.Append(
                "<Style id=\"gp_manual\">\r\n" +
@@ -214,7 +214,7 @@ namespace Kml
                "</Style>\r\n");
        }
 
-       private static void WriteTrackSchema(StringBuilder sb)
+       internal static void WriteTrackSchema(StringBuilder sb)
        {
            sb.Append("<Schema id=\"schema\">\r\n" +
                      "<gx:SimpleArrayField name=\"gps_satellites\" type=\"int\">\r\n" +
@@ -241,14 +241,14 @@ namespace Kml
                      "</Schema>\r\n");
        }
 
-       private static void WriteKmlHeader(StringBuilder sb)
+       internal static void WriteKmlHeader(StringBuilder sb)
        {
            sb.Append("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\r\n" +
                      "<kml xmlns=\"http://www.opengis.net/kml/2.2\" xmlns:gx=\"http://www.google.com/kml/ext/2.2\" xmlns:kml=\"http://www.opengis.net/kml/2.2\" xmlns:atom=\"http://www.w3.org/2005/Atom\">\r\n" +
                      "<Document>\r\n");
        }
 
-       private static void WriteKmlFooter(StringBuilder sb)
+       internal static void WriteKmlFooter(StringBuilder sb)
        {
            sb.Append("</Document>\r\n</kml>");
        }
@@ -0,0 +1,166 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Text;
+
+using System.Data;
+using System.Globalization;
+
+using Communication.Frames.Incoming;
+
+namespace Kml
+{
+    /*
+     *  Incremental counterpart of KmlTrackGenerator. Feed it every
+     *  DatalogLine as it arrives during the download: the per-line parsing
+     *  and formatting overlaps the transfer and the track sections (when,
+     *  coordinates, angles and the extended data arrays - a gx:Track wants
+     *  each of them grouped) grow as the lines come in. Finish() only
+     *  stitches the prebuilt sections together, so the export is ready the
+     *  moment the download ends instead of re-walking the full DataSet
+     *  afterwards.
+     */
+    public class KmlTrackStreamWriter
+    {
+        private const int stepsize = 4;
+
+        private Dictionary<string, int> columns;
+        private int row = 0;
+        private double first_height = double.NegativeInfinity;
+        private DateTime dt;
+
+        private StringBuilder sb_when = new StringBuilder();
+        private StringBuilder sb_coord = new StringBuilder();
+        private StringBuilder sb_angles = new StringBuilder();
+        private StringBuilder sb_sat = new StringBuilder();
+        private StringBuilder sb_temp = new StringBuilder();
+        private StringBuilder sb_speed = new StringBuilder();
+        private StringBuilder sb_heading = new StringBuilder();
+        private StringBuilder sb_roll = new StringBuilder();
+
+        public KmlTrackStreamWriter(DateTime timestamp)
+        {
+            dt = new DateTime(timestamp.Ticks);
+        }
+
+        public void AddLine(DatalogLine line)
+        {
+            if (columns == null)
+            {
+                columns = new Dictionary<string, int>();
+                for (int i = 0; i < line.Header.Length; i++)
+                    if (!columns.ContainsKey(line.Header[i]))
+                        columns.Add(line.Header[i], i);
+            }
+
+            if (row++ % stepsize != 0)
+                return;
+
+            sb_when.Append(
+                "<when>" +
+                    dt.ToString("yyyy-MM-ddTHH:mm:ssZ") +
+                "</when>\r\n");
+            dt = dt.AddMilliseconds(1000);
+
+            if (first_height == double.NegativeInfinity)
+                first_height = double.Parse(line.Line[columns["HeightBaro"]], CultureInfo.InvariantCulture);
+
+            sb_coord.Append(
+                "<gx:coord>" +
+                 line.Line[columns["Longitude"]] + " " +
+                 line.Line[columns["Latitude"]] + " " +
+                 (double.Parse(line.Line[columns["HeightBaro"]], CultureInfo.InvariantCulture) - first_height) +
+                "</gx:coord>\r\n");
+
+            sb_angles.Append(
+                "<gx:angles>" +
+                line.Line[columns["HeadingGPS"]] + " " +
+                line.Line[columns["Pitch"]] + " " +
+                line.Line[columns["Roll"]] +
+                "</gx:angles>\r\n");
+
+            try
+            {
+                sb_sat.Append(
+                    "<gx:value>" +
+                     line.Line[columns["SatellitesGPS"]] +
+                    "</gx:value>\r\n");
+
+                sb_temp.Append(
+                    "<gx:value>" +
+                     line.Line[columns["TempC"]] +
+                    "</gx:value>\r\n");
+            }
+            catch (Exception ex)
+            {
+            }
+
+            sb_speed.Append(
+                "<gx:value>" +
+                 (double.Parse(line.Line[columns["SpeedGPS"]], CultureInfo.InvariantCulture) * 3.6).ToString(CultureInfo.InvariantCulture) +
+                "</gx:value>\r\n");
+
+            sb_heading.Append(
+                "<gx:value>" +
+                 line.Line[columns["HeadingGPS"]] +
+                "</gx:value>\r\n");
+
+            sb_roll.Append(
+                "<gx:value>" +
+                 line.Line[columns["Roll"]] +
+                "</gx:value>\r\n");
+        }
+
+        public int Rows
+        {
+            get { return row; }
+        }
+
+        /*
+         *  Assembles the document from the sections built up by AddLine().
+         *  Cheap compared to the per-line work, so it can be called more
+         *  than once (e.g. to export again with more lines received).
+         */
+        public string Finish()
+        {
+            StringBuilder sb = new StringBuilder();
+
+            KmlTrackGenerator.WriteKmlHeader(sb);
+            sb.Append("<name>Gluonpilot export</name>");
+            KmlTrackGenerator.WriteTrackSchema(sb);
+            KmlTrackGenerator.WriteTrackStyle(sb);
+
+            sb.Append("<Placemark><styleUrl>#gp_manual</styleUrl>\r\n" +
+                      "  <name>Name</name>\r\n" +
+                      "<gx:MultiTrack>\r\n" +
+                      "<gx:Track><altitudeMode>relativeToGround</altitudeMode>\r\n" +
+                        sb_when + "\r\n" + sb_coord + "\r\n" + sb_angles + "\r\n" +
+                      "<ExtendedData>" +
+                      "<SchemaData schemaUrl=\"#schema\">" +
+                      "   <gx:SimpleArrayData name=\"gps_satellites\">" +
+                              sb_sat.ToString() +
+                      "   </gx:SimpleArrayData>" +
+                      "   <gx:SimpleArrayData name=\"temperature\">" +
+                              sb_temp.ToString() +
+                      "   </gx:SimpleArrayData>" +
+                      "   <gx:SimpleArrayData name=\"speed\">" +
+                              sb_speed.ToString() +
+                      "   </gx:SimpleArrayData>" +
+                      "   <gx:SimpleArrayData name=\"desiredheading\">" +
+                      "   </gx:SimpleArrayData>" +
+                      "   <gx:SimpleArrayData name=\"heading\">" +
+                              sb_heading.ToString() +
+                      "   </gx:SimpleArrayData>" +
+                      "   <gx:SimpleArrayData name=\"desiredroll\">" +
+                      "   </gx:SimpleArrayData>" +
+                      "   <gx:SimpleArrayData name=\"roll\">" +
+                              sb_roll.ToString() +
+                      "   </gx:SimpleArrayData>" +
+                      "</SchemaData></ExtendedData>" +
+                      "</gx:Track></gx:MultiTrack>\r\n</Placemark>\r\n");
+
+            KmlTrackGenerator.WriteKmlFooter(sb);
+
+            return sb.ToString();
+        }
+    }
+}
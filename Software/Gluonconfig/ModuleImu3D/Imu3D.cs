@@ -45,6 +45,7 @@ are met:
  */
 #endregion Original Credits / License
 
+using System;
 using CsGL.Basecode;
 using System.Reflection;
 using Communication;
@@ -64,19 +65,142 @@ namespace ModuleImu3D
         private static float rquad = 0;													// Angle For The Quad
         private SerialCommunication serial;
         private float roll = 0.0f, pitch = 0.0f, yaw = 0.0f;
+        // cursor and scratch struct for the zero-allocation attitude ring
+        private long attitude_cursor;
+        private Communication.Frames.Incoming.AttitudeFrame attitude_frame;
+
+        // Interpolation state: the last two attitude samples as quaternions
+        // (w,x,y,z) in the gl rotation order used below (yaw about Y, pitch
+        // about Z, roll about X). The render loop slerps between them based
+        // on the smoothed arrival spacing, so burst arrivals and gaps still
+        // produce smooth motion. Guarded by quat_lock: the CSV event path
+        // pushes from the serial thread while Draw() samples.
+        private readonly object quat_lock = new object();
+        private float[] quat_prev = new float[4] { 1, 0, 0, 0 };
+        private float[] quat_next = new float[4] { 1, 0, 0, 0 };
+        private float[] quat_render = new float[4] { 1, 0, 0, 0 };
+        private int last_arrival_ms = Environment.TickCount;
+        private float frame_interval_ms = 100.0f;   // smoothed, absorbs bursts
         #endregion Private Fields
 
         public Imu3D(SerialCommunication serial)
         {
             this.serial = serial;
+            attitude_cursor = serial.AttitudeFrames.Head;
             serial.AttitudeCommunicationReceived += new SerialCommunication.ReceiveAttitudeCommunicationFrame(serial_AttitudeCommunicationReceived);
         }
 
         void serial_AttitudeCommunicationReceived(Communication.Frames.Incoming.Attitude attitude)
         {
-            roll = (float)attitude.RollDeg;
-            pitch = (float)attitude.PitchDeg;
-            yaw = -(float)attitude.YawDeg;
+            PushAttitude((float)attitude.RollDeg, (float)attitude.PitchDeg, -(float)attitude.YawDeg);
+        }
+
+        /*!
+         *    Shifts the sample pair and restarts the interpolation clock.
+         *    Angles are the gl rotation angles in degrees.
+         */
+        private void PushAttitude(float roll_deg, float pitch_deg, float yaw_deg)
+        {
+            int now = Environment.TickCount;
+            lock (quat_lock)
+            {
+                int gap = now - last_arrival_ms;
+                if (gap < 1)
+                    gap = 1;
+                if (gap > 1000)
+                    gap = 1000;
+                frame_interval_ms = frame_interval_ms * 0.9f + gap * 0.1f;
+                last_arrival_ms = now;
+
+                quat_prev[0] = quat_next[0];
+                quat_prev[1] = quat_next[1];
+                quat_prev[2] = quat_next[2];
+                quat_prev[3] = quat_next[3];
+                QuaternionFromGlAngles(roll_deg, pitch_deg, yaw_deg, quat_next);
+                // keep the slerp on the short arc
+                if (quat_prev[0] * quat_next[0] + quat_prev[1] * quat_next[1] +
+                    quat_prev[2] * quat_next[2] + quat_prev[3] * quat_next[3] < 0)
+                {
+                    quat_next[0] = -quat_next[0];
+                    quat_next[1] = -quat_next[1];
+                    quat_next[2] = -quat_next[2];
+                    quat_next[3] = -quat_next[3];
+                }
+            }
+        }
+
+        // q = qy(yaw) * qz(pitch) * qx(roll), mirroring the glRotatef order
+        private static void QuaternionFromGlAngles(float roll_deg, float pitch_deg, float yaw_deg, float[] q)
+        {
+            double r = roll_deg * Math.PI / 360.0;    // half angles
+            double p = pitch_deg * Math.PI / 360.0;
+            double y = yaw_deg * Math.PI / 360.0;
+            double cr = Math.Cos(r), sr = Math.Sin(r);
+            double cp = Math.Cos(p), sp = Math.Sin(p);
+            double cy = Math.Cos(y), sy = Math.Sin(y);
+
+            q[0] = (float)(cy * cp * cr - sy * sp * sr);
+            q[1] = (float)(cy * cp * sr + sy * sp * cr);
+            q[2] = (float)(sy * cp * cr + cy * sp * sr);
+            q[3] = (float)(cy * sp * cr - sy * cp * sr);
+        }
+
+        /*!
+         *    Slerps between the two newest samples at the position the
+         *    interpolation clock has reached (held at the newest sample when
+         *    the stream pauses - no extrapolation) and decomposes the result
+         *    back into the three glRotatef angles, which is exact for this
+         *    rotation order.
+         */
+        private void SampleInterpolatedAttitude()
+        {
+            float w, x, yq, z;
+
+            lock (quat_lock)
+            {
+                float t = (Environment.TickCount - last_arrival_ms) / frame_interval_ms;
+                if (t < 0.0f)
+                    t = 0.0f;
+                if (t > 1.0f)
+                    t = 1.0f;
+
+                float dot = quat_prev[0] * quat_next[0] + quat_prev[1] * quat_next[1] +
+                            quat_prev[2] * quat_next[2] + quat_prev[3] * quat_next[3];
+                float wa, wb;
+                if (dot > 0.9995f)
+                {
+                    wa = 1.0f - t;   // nearly parallel: lerp, normalized below
+                    wb = t;
+                }
+                else
+                {
+                    float angle = (float)Math.Acos(dot);
+                    float sin_angle = (float)Math.Sin(angle);
+                    wa = (float)Math.Sin((1.0f - t) * angle) / sin_angle;
+                    wb = (float)Math.Sin(t * angle) / sin_angle;
+                }
+                quat_render[0] = quat_prev[0] * wa + quat_next[0] * wb;
+                quat_render[1] = quat_prev[1] * wa + quat_next[1] * wb;
+                quat_render[2] = quat_prev[2] * wa + quat_next[2] * wb;
+                quat_render[3] = quat_prev[3] * wa + quat_next[3] * wb;
+            }
+
+            float norm = (float)Math.Sqrt(quat_render[0] * quat_render[0] + quat_render[1] * quat_render[1] +
+                                          quat_render[2] * quat_render[2] + quat_render[3] * quat_render[3]);
+            w = quat_render[0] / norm;
+            x = quat_render[1] / norm;
+            yq = quat_render[2] / norm;
+            z = quat_render[3] / norm;
+
+            // inverse of QuaternionFromGlAngles: R10 = sin(pitch)
+            float sp = 2.0f * (x * yq + w * z);
+            if (sp > 1.0f)
+                sp = 1.0f;
+            if (sp < -1.0f)
+                sp = -1.0f;
+            pitch = (float)(Math.Asin(sp) * 180.0 / Math.PI);
+            roll = (float)(Math.Atan2(-2.0 * (yq * z - w * x), 1.0 - 2.0 * (x * x + z * z)) * 180.0 / Math.PI);
+            yaw = (float)(Math.Atan2(-2.0 * (x * z - w * yq), 1.0 - 2.0 * (yq * yq + z * z)) * 180.0 / Math.PI);
         }
 
         #region Public Properties
@@ -129,6 +253,15 @@ namespace ModuleImu3D
         /// </summary>
         public override void Draw()
         {													// Here's Where We Do All The Drawing
+            // binary protocol path: drain the struct ring at render time, no
+            // allocation and no event marshalling per telemetry frame (the
+            // event subscription above still serves the CSV protocol)
+            while (serial.AttitudeFrames.TryRead(ref attitude_cursor, ref attitude_frame))
+                PushAttitude((float)attitude_frame.RollDeg, (float)attitude_frame.PitchDeg, -(float)attitude_frame.YawDeg);
+
+            // render-rate interpolation between the last two samples
+            SampleInterpolatedAttitude();
+
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);							// Clear Screen And Depth Buffer
             
             glLoadIdentity();															// Reset The Current Modelview Matrix
@@ -0,0 +1,284 @@
+﻿/*!
+ *   BinaryLog.cs
+ *   Compact binary container for recorded telemetry sessions.
+ *
+ *   The text logs ("[timestamp] TA;...") cost a DateTime.Parse and a
+ *   string split per line when they are loaded again, which adds up to
+ *   minutes per flight for the fleet analytics jobs. This container keeps
+ *   the on-wire line untouched but stores the timestamp as raw ticks and
+ *   length-prefixes every record, so a 2 hour flight loads in well under
+ *   a second. An index block at the end of the file carries the record
+ *   count and all timestamps; a file without one (recording interrupted)
+ *   still loads by scanning the records.
+ *
+ *   Layout (all values little endian, strings BinaryWriter-prefixed):
+ *     "GPLG" 0x01                          file header, format version
+ *     [type:1][ticks:8][line:string]       one record per logged line
+ *        type 0 = received telemetry line (replayable)
+ *        type 1 = raw text (sent commands), exported verbatim
+ *     [count:4][ticks:8]*count             index block
+ *     [index_offset:8] "GPLX"              trailer, written on Close()
+ *
+ *   ExportText()/ImportText() convert to and from the classic text log
+ *   format, so the existing analytics that want CSV still get it.
+ *
+ *   @author  Tom Pycke
+ */
+
+using System;
+using System.Collections.Generic;
+using System.Globalization;
+using System.IO;
+using System.Text;
+
+namespace Communication
+{
+    /*!
+     *   Streams records into a binary log; used by SerialCommunication_CSV
+     *   when the session log filename carries the binary extension.
+     */
+    public class BinaryLogWriter
+    {
+        private BinaryWriter writer;
+        private List<long> index_ticks = new List<long>();
+
+        public BinaryLogWriter(string filename)
+        {
+            writer = new BinaryWriter(File.Create(filename));
+            writer.Write(BinaryLog.Magic);
+            writer.Write(BinaryLog.Version);
+        }
+
+        //! A received (replayable) telemetry line, without line terminator.
+        public void LogLine(DateTime timestamp, string line)
+        {
+            lock (this)
+            {
+                if (writer == null)
+                    return;
+                writer.Write((byte)0);
+                writer.Write(timestamp.Ticks);
+                writer.Write(line);
+                index_ticks.Add(timestamp.Ticks);
+            }
+        }
+
+        //! Raw text (sent commands): kept for the text export, not replayed.
+        public void LogRaw(string text)
+        {
+            lock (this)
+            {
+                if (writer == null)
+                    return;
+                writer.Write((byte)1);
+                writer.Write(DateTime.Now.Ticks);
+                writer.Write(text);
+            }
+        }
+
+        //! Appends the index block and the trailer. Without it the file is
+        //! still loadable (the reader falls back to scanning).
+        public void Close()
+        {
+            lock (this)
+            {
+                if (writer == null)
+                    return;
+                long index_offset = writer.BaseStream.Position;
+                writer.Write(index_ticks.Count);
+                foreach (long t in index_ticks)
+                    writer.Write(t);
+                writer.Write(index_offset);
+                writer.Write(BinaryLog.TrailerMagic);
+                writer.Close();
+                writer = null;
+            }
+        }
+    }
+
+    public static class BinaryLog
+    {
+        public const string Extension = ".glog";
+        public const string FileDialogFilter = "Binary log files (*.glog)|*.glog|Log files (*.log)|*.log|All files (*.*)|*.*";
+
+        public static readonly byte[] Magic = Encoding.ASCII.GetBytes("GPLG");
+        public static readonly byte[] TrailerMagic = Encoding.ASCII.GetBytes("GPLX");
+        public const byte Version = 1;
+
+        //! Checks the header magic, not just the extension, so renamed text
+        //! logs take the text path.
+        public static bool IsBinaryLog(string filename)
+        {
+            try
+            {
+                using (FileStream fs = File.OpenRead(filename))
+                {
+                    byte[] magic = new byte[4];
+                    if (fs.Read(magic, 0, 4) != 4)
+                        return false;
+                    for (int i = 0; i < 4; i++)
+                        if (magic[i] != Magic[i])
+                            return false;
+                    return true;
+                }
+            }
+            catch (Exception e)
+            {
+                return false;
+            }
+        }
+
+        /*!
+         *   Loads the replayable lines with their time offset relative to
+         *   the first record, clamped monotonic like the text loader does
+         *   when the clock stepped back during the recording. Raw records
+         *   (sent commands) are skipped, as the text loader skips lines
+         *   without a timestamp prefix.
+         */
+        public static void Load(string filename, List<TimeSpan> times, List<string> lines)
+        {
+            using (BinaryReader reader = Open(filename))
+            {
+                long record_end = FindRecordEnd(reader, times, lines);
+                long first_ticks = -1;
+                TimeSpan last_time = TimeSpan.Zero;
+
+                while (reader.BaseStream.Position < record_end)
+                {
+                    byte type;
+                    long ticks;
+                    string line;
+                    try
+                    {
+                        type = reader.ReadByte();
+                        ticks = reader.ReadInt64();
+                        line = reader.ReadString();
+                    }
+                    catch (EndOfStreamException e)
+                    {
+                        break;   // recording was cut short mid-record
+                    }
+                    if (type != 0)
+                        continue;
+                    if (first_ticks < 0)
+                        first_ticks = ticks;
+                    TimeSpan t = TimeSpan.FromTicks(ticks - first_ticks);
+                    if (t < last_time)
+                        t = last_time;
+                    last_time = t;
+                    times.Add(t);
+                    lines.Add(line);
+                }
+            }
+        }
+
+        //! Rewrites a binary log as a classic text log (the CSV form all of
+        //! the old tooling parses).
+        public static void ExportText(string binary_filename, string text_filename)
+        {
+            using (BinaryReader reader = Open(binary_filename))
+            using (StreamWriter sw = new StreamWriter(text_filename))
+            {
+                long record_end = FindRecordEnd(reader, null, null);
+                while (reader.BaseStream.Position < record_end)
+                {
+                    byte type;
+                    long ticks;
+                    string line;
+                    try
+                    {
+                        type = reader.ReadByte();
+                        ticks = reader.ReadInt64();
+                        line = reader.ReadString();
+                    }
+                    catch (EndOfStreamException e)
+                    {
+                        break;
+                    }
+                    if (type == 0)
+                        sw.WriteLine("[" + new DateTime(ticks).ToString("MM/dd/yyyy HH:mm:ss.fff", CultureInfo.InvariantCulture) + "] " + line);
+                    else
+                        sw.WriteLine(line);
+                }
+            }
+        }
+
+        //! Converts an existing text log into the binary container.
+        public static void ImportText(string text_filename, string binary_filename)
+        {
+            BinaryLogWriter writer = new BinaryLogWriter(binary_filename);
+            using (StreamReader sr = new StreamReader(text_filename))
+            {
+                while (!sr.EndOfStream)
+                {
+                    string s = sr.ReadLine();
+                    try
+                    {
+                        string[] parts = s.TrimStart('[').Split(']');
+                        DateTime timestamp = DateTime.Parse(parts[0], CultureInfo.InvariantCulture);
+                        writer.LogLine(timestamp, parts[1].TrimStart(' '));
+                    }
+                    catch (Exception e)
+                    {
+                        writer.LogRaw(s);   // no timestamp prefix
+                    }
+                }
+            }
+            writer.Close();
+        }
+
+        private static BinaryReader Open(string filename)
+        {
+            BinaryReader reader = new BinaryReader(File.OpenRead(filename));
+            byte[] magic = reader.ReadBytes(4);
+            byte version = reader.ReadByte();
+            for (int i = 0; i < 4; i++)
+                if (magic.Length < 4 || magic[i] != Magic[i])
+                    throw new IOException(filename + " is not a binary log");
+            if (version != Version)
+                throw new IOException(filename + ": unknown binary log version " + version);
+            return reader;
+        }
+
+        /*!
+         *   Returns the file offset where the records stop, taken from the
+         *   trailer. A file without a valid trailer (the recording was cut
+         *   short) has records up to the end of the stream; the readers
+         *   above stop cleanly at the first truncated record anyway because
+         *   every record is length-prefixed.
+         */
+        private static long FindRecordEnd(BinaryReader reader, List<TimeSpan> times, List<string> lines)
+        {
+            Stream s = reader.BaseStream;
+            long data_start = s.Position;
+            long record_end = s.Length;
+
+            if (s.Length >= data_start + 12)
+            {
+                s.Seek(-12, SeekOrigin.End);
+                long index_offset = reader.ReadInt64();
+                byte[] trailer = reader.ReadBytes(4);
+                bool valid = trailer.Length == 4 && index_offset >= data_start && index_offset < s.Length;
+                for (int i = 0; valid && i < 4; i++)
+                    if (trailer[i] != TrailerMagic[i])
+                        valid = false;
+                if (valid)
+                {
+                    // let the loaders pre-allocate from the index count
+                    s.Seek(index_offset, SeekOrigin.Begin);
+                    int count = reader.ReadInt32();
+                    if (count >= 0)
+                    {
+                        if (times != null)
+                            times.Capacity = times.Count + count;
+                        if (lines != null)
+                            lines.Capacity = lines.Count + count;
+                        record_end = index_offset;
+                    }
+                }
+            }
+            s.Seek(data_start, SeekOrigin.Begin);
+            return record_end;
+        }
+    }
+}
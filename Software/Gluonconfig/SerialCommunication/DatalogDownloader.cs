@@ -0,0 +1,270 @@
+﻿/*!
+ *   DatalogDownloader.cs
+ *   Windowed bulk download of raw dataflash pages over the binary
+ *   LOG_CHUNK frames (DP command).
+ *   
+ *   @author  Tom Pycke
+ */
+
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Threading;
+
+using Amib.Threading;
+using Common;
+
+namespace Communication
+{
+    /*!
+     *    Downloads a range of dataflash pages with the binary DP readout
+     *    and writes them to a file.
+     *
+     *    The firmware answers one DP request with 4 LOG_CHUNK frames, each
+     *    protected by the frame checksum: a corrupted chunk is dropped by
+     *    the receiver and simply never arrives. The downloader keeps a
+     *    window of page requests outstanding so the link stays filled,
+     *    re-requests any page whose chunks stay out for too long, and
+     *    writes completed pages to disk from its own thread (write-behind,
+     *    the serial receive thread never touches the disk). Pages complete
+     *    out of order, so every page is written at its own file offset -
+     *    which also makes resuming after a disconnect trivial: call
+     *    Resume() with the fresh connection and only the pages still
+     *    missing are requested again.
+     */
+    public class DatalogDownloader
+    {
+        public delegate void ProgressChangedHandler(int pagesDone, int pagesTotal, double kbPerSecond);
+        public event ProgressChangedHandler ProgressChanged;
+        public delegate void DownloadCompletedHandler(string filename);
+        public event DownloadCompletedHandler DownloadCompleted;
+
+        private const int WINDOW = 4;           // outstanding page requests
+        private const int CHUNKS_PER_PAGE = 4;  // datalogger_stream_page() sends 4 chunks
+        private const double RETRY_S = 2.0;     // re-request a page that stays silent
+
+        private SerialCommunication serial;
+        private string filename;
+        private int first_page;
+        private int page_count;
+        private int page_size = 0;              // learned from the first complete page
+
+        private bool[] page_done;
+        private int done_count = 0;
+        // in-flight state, all guarded by sync
+        private Dictionary<int, byte[][]> chunks_by_page = new Dictionary<int, byte[][]>();
+        private Dictionary<int, DateTime> request_time = new Dictionary<int, DateTime>();
+        // completed pages waiting for the writer (parallel queues, no tuples
+        // on this framework)
+        private Queue<int> write_pages = new Queue<int>();
+        private Queue<byte[]> write_data = new Queue<byte[]>();
+        private object sync = new object();
+
+        private bool cancelled = false;
+        private bool paused = false;
+        private int bytes_since_report = 0;
+
+        public DatalogDownloader(SerialCommunication serial, int firstPage, int lastPage, string filename)
+        {
+            this.serial = serial;
+            this.filename = filename;
+            first_page = firstPage;
+            page_count = lastPage - firstPage + 1;
+            page_done = new bool[page_count];
+
+            serial.DatalogPageChunkCommunicationReceived += new SerialCommunication.ReceiveDatalogPageChunkCommunicationFrame(ReceiveChunk);
+            SmartThreadPoolSingleton.GetInstance().QueueWorkItem(
+                new WorkItemCallback(this.DownloadThreadedData), null);
+        }
+
+        public bool Complete
+        {
+            get { return done_count >= page_count; }
+        }
+
+        public string Filename
+        {
+            get { return filename; }
+        }
+
+        /*!
+         *    Stops requesting without forgetting what arrived already.
+         */
+        public void Pause()
+        {
+            paused = true;
+        }
+
+        /*!
+         *    Continues the download, on a fresh connection after a
+         *    disconnect or on the same one after Pause(). Only the pages
+         *    that are still missing get requested.
+         */
+        public void Resume(SerialCommunication serial)
+        {
+            if (this.serial != serial)
+            {
+                this.serial.DatalogPageChunkCommunicationReceived -= new SerialCommunication.ReceiveDatalogPageChunkCommunicationFrame(ReceiveChunk);
+                this.serial = serial;
+                serial.DatalogPageChunkCommunicationReceived += new SerialCommunication.ReceiveDatalogPageChunkCommunicationFrame(ReceiveChunk);
+            }
+            lock (sync)
+            {
+                // forget the in-flight requests so they go out again at once
+                request_time.Clear();
+            }
+            paused = false;
+        }
+
+        public void Cancel()
+        {
+            cancelled = true;
+        }
+
+        /*!
+         *    Called on the serial receive thread: only bookkeeping here,
+         *    the disk write happens on the download thread.
+         */
+        private void ReceiveChunk(int page, int chunk, byte[] data)
+        {
+            lock (sync)
+            {
+                int index = page - first_page;
+                if (index < 0 || index >= page_count || page_done[index])
+                    return;
+                if (chunk < 0 || chunk >= CHUNKS_PER_PAGE)
+                    return;
+
+                byte[][] chunks;
+                if (!chunks_by_page.TryGetValue(page, out chunks))
+                {
+                    chunks = new byte[CHUNKS_PER_PAGE][];
+                    chunks_by_page.Add(page, chunks);
+                }
+                chunks[chunk] = data;
+
+                int size = 0;
+                for (int i = 0; i < CHUNKS_PER_PAGE; i++)
+                {
+                    if (chunks[i] == null)
+                        return;   // page not complete yet
+                    size += chunks[i].Length;
+                }
+
+                byte[] page_data = new byte[size];
+                int offset = 0;
+                for (int i = 0; i < CHUNKS_PER_PAGE; i++)
+                {
+                    Array.Copy(chunks[i], 0, page_data, offset, chunks[i].Length);
+                    offset += chunks[i].Length;
+                }
+                if (page_size == 0)
+                    page_size = size;
+
+                page_done[index] = true;
+                done_count++;
+                bytes_since_report += size;
+                chunks_by_page.Remove(page);
+                request_time.Remove(page);
+                write_pages.Enqueue(page);
+                write_data.Enqueue(page_data);
+            }
+        }
+
+        /*!
+         *    Download thread: keeps the request window filled, retries
+         *    silent pages and flushes completed pages to disk.
+         */
+        private object DownloadThreadedData(object state)
+        {
+            FileStream fs = new FileStream(filename, FileMode.OpenOrCreate, FileAccess.Write);
+            DateTime last_report = DateTime.Now;
+
+            while (!cancelled && done_count < page_count)
+            {
+                try
+                {
+                    if (!paused)
+                    {
+                        lock (sync)
+                        {
+                            // retries first: a silent page blocks the window
+                            List<int> retry = null;
+                            foreach (KeyValuePair<int, DateTime> kvp in request_time)
+                            {
+                                if ((DateTime.Now - kvp.Value).TotalSeconds >= RETRY_S)
+                                {
+                                    if (retry == null)
+                                        retry = new List<int>();
+                                    retry.Add(kvp.Key);
+                                }
+                            }
+                            if (retry != null)
+                            {
+                                foreach (int page in retry)
+                                {
+                                    serial.SendDatalogPageRequest(page);
+                                    request_time[page] = DateTime.Now;
+                                }
+                            }
+
+                            // fill the window with the next missing pages
+                            for (int i = 0; i < page_count && request_time.Count < WINDOW; i++)
+                            {
+                                if (page_done[i] || request_time.ContainsKey(first_page + i))
+                                    continue;
+                                serial.SendDatalogPageRequest(first_page + i);
+                                request_time.Add(first_page + i, DateTime.Now);
+                            }
+                        }
+                    }
+
+                    // write-behind: flush the completed pages
+                    for (; ; )
+                    {
+                        int page;
+                        byte[] data;
+                        lock (sync)
+                        {
+                            if (write_pages.Count == 0)
+                                break;
+                            page = write_pages.Dequeue();
+                            data = write_data.Dequeue();
+                        }
+                        fs.Seek((long)(page - first_page) * data.Length, SeekOrigin.Begin);
+                        fs.Write(data, 0, data.Length);
+                    }
+
+                    if ((DateTime.Now - last_report).TotalSeconds >= 0.5)
+                    {
+                        double kb_s = bytes_since_report / (DateTime.Now - last_report).TotalSeconds / 1024.0;
+                        bytes_since_report = 0;
+                        last_report = DateTime.Now;
+                        if (ProgressChanged != null)
+                            ProgressChanged(done_count, page_count, kb_s);
+                    }
+                }
+                catch (Exception e)
+                {
+                    // disconnects surface here as write exceptions on the
+                    // serial port; keep the state, the user can Resume()
+                    Thread.Sleep(500);
+                }
+
+                Thread.Sleep(50);
+            }
+
+            fs.Close();
+            serial.DatalogPageChunkCommunicationReceived -= new SerialCommunication.ReceiveDatalogPageChunkCommunicationFrame(ReceiveChunk);
+
+            if (!cancelled)
+            {
+                if (ProgressChanged != null)
+                    ProgressChanged(done_count, page_count, 0.0);
+                if (DownloadCompleted != null)
+                    DownloadCompleted(filename);
+            }
+            return null;
+        }
+    }
+}
@@ -0,0 +1,158 @@
+﻿/*!
+ *   FlightSummary.cs
+ *   Per-flight performance summary computed from a recorded binary log.
+ *
+ *   One row of headline numbers per flight, written as a small CSV next
+ *   to the log when the recording closes. The rows concatenate across a
+ *   fleet, so a gain change that raises the average loop load or the
+ *   mAh per km shows up in a spreadsheet instead of in manual log
+ *   reading. Everything is computed from the streams the log actually
+ *   carries:
+ *
+ *     - control-loop load: the cpu field on the TC line (avg and max)
+ *     - altitude tracking rms: TC altitude vs target, autopilot mode only
+ *     - distance and battery efficiency: TG track length, TC mAh counter
+ *     - servo saturation: share of TS samples pinned at the travel ends
+ *       (TS only streams in simulation mode, so this column may be empty)
+ *
+ *   @author  Tom Pycke
+ */
+
+using System;
+using System.Collections.Generic;
+using System.Globalization;
+using System.IO;
+using System.Text;
+
+namespace Communication
+{
+    public static class FlightSummary
+    {
+        //! Pulse widths at or beyond these count as a pinned servo.
+        private const int ServoSatLow = 1020;
+        private const int ServoSatHigh = 1980;
+
+        /*!
+         *   Computes the summary of a binary log and writes it next to the
+         *   log as <name>.summary.csv (header row + one data row). Returns
+         *   the path of the summary file.
+         */
+        public static string Compute(string binary_filename)
+        {
+            List<TimeSpan> times = new List<TimeSpan>();
+            List<string> lines = new List<string>();
+            BinaryLog.Load(binary_filename, times, lines);
+
+            double cpu_sum = 0, cpu_max = 0; int cpu_samples = 0;
+            double alt_err_sq_sum = 0; int alt_err_samples = 0;
+            double throttle_sum = 0; int throttle_samples = 0;
+            double mah_min = double.MaxValue, mah_max = 0;
+            double distance_km = 0;
+            double last_lat = double.NaN, last_lon = double.NaN;
+            int servo_samples = 0, servo_saturated = 0;
+
+            foreach (string line in lines)
+            {
+                string[] parts = line.Split(';');
+                try
+                {
+                    if (parts[0].EndsWith("TC") && parts.Length >= 9)
+                    {
+                        int flight_mode = int.Parse(parts[1]);
+                        int altitude = int.Parse(parts[3]);
+                        throttle_sum += int.Parse(parts[8]);
+                        throttle_samples++;
+                        if (parts.Length >= 10 && flight_mode == 2 /* autopilot */)
+                        {
+                            double e = altitude - int.Parse(parts[9]);
+                            alt_err_sq_sum += e * e;
+                            alt_err_samples++;
+                        }
+                        if (parts.Length >= 12)
+                        {
+                            double mah = double.Parse(parts[11], CultureInfo.InvariantCulture) * 10.0;
+                            if (mah < mah_min)
+                                mah_min = mah;
+                            if (mah > mah_max)
+                                mah_max = mah;
+                        }
+                        if (parts.Length >= 13)
+                        {
+                            double cpu = double.Parse(parts[12], CultureInfo.InvariantCulture);
+                            cpu_sum += cpu;
+                            cpu_samples++;
+                            if (cpu > cpu_max)
+                                cpu_max = cpu;
+                        }
+                    }
+                    else if (parts[0].EndsWith("TG") && parts.Length >= 4)
+                    {
+                        if (parts[1] != "0")   // skip NO_FIX samples
+                        {
+                            double lat = double.Parse(parts[2], CultureInfo.InvariantCulture);
+                            double lon = double.Parse(parts[3], CultureInfo.InvariantCulture);
+                            if (!double.IsNaN(last_lat) && (lat != 0.0 || lon != 0.0))
+                            {
+                                double d = DistanceKm(last_lat, last_lon, lat, lon);
+                                if (d < 1.0)   // a jump over 1km between samples is a glitch
+                                    distance_km += d;
+                            }
+                            if (lat != 0.0 || lon != 0.0)
+                            {
+                                last_lat = lat;
+                                last_lon = lon;
+                            }
+                        }
+                    }
+                    else if (parts[0].EndsWith("TS") && parts.Length >= 4)
+                    {
+                        servo_samples++;
+                        for (int i = 1; i <= 3; i++)
+                        {
+                            int us = int.Parse(parts[i]);
+                            if (us <= ServoSatLow || us >= ServoSatHigh)
+                            {
+                                servo_saturated++;
+                                break;
+                            }
+                        }
+                    }
+                }
+                catch (Exception e)
+                {
+                    // a malformed line spoils one sample, not the summary
+                }
+            }
+
+            double duration_s = times.Count > 0 ? times[times.Count - 1].TotalSeconds : 0;
+            double mah_used = mah_max > mah_min ? mah_max - mah_min : 0;
+
+            StringBuilder sb = new StringBuilder();
+            sb.AppendLine("log;duration_s;lines;cpu_avg_pct;cpu_max_pct;alt_rms_m;distance_km;mah_used;mah_per_km;throttle_avg_pct;servo_sat_pct");
+            sb.Append(Path.GetFileName(binary_filename)).Append(';');
+            sb.Append(duration_s.ToString("F0", CultureInfo.InvariantCulture)).Append(';');
+            sb.Append(lines.Count).Append(';');
+            sb.Append(cpu_samples > 0 ? (cpu_sum / cpu_samples).ToString("F1", CultureInfo.InvariantCulture) : "").Append(';');
+            sb.Append(cpu_samples > 0 ? cpu_max.ToString("F0", CultureInfo.InvariantCulture) : "").Append(';');
+            sb.Append(alt_err_samples > 0 ? Math.Sqrt(alt_err_sq_sum / alt_err_samples).ToString("F1", CultureInfo.InvariantCulture) : "").Append(';');
+            sb.Append(distance_km.ToString("F2", CultureInfo.InvariantCulture)).Append(';');
+            sb.Append(mah_used.ToString("F0", CultureInfo.InvariantCulture)).Append(';');
+            sb.Append(distance_km > 0.01 ? (mah_used / distance_km).ToString("F1", CultureInfo.InvariantCulture) : "").Append(';');
+            sb.Append(throttle_samples > 0 ? (throttle_sum / throttle_samples).ToString("F0", CultureInfo.InvariantCulture) : "").Append(';');
+            sb.Append(servo_samples > 0 ? (100.0 * servo_saturated / servo_samples).ToString("F1", CultureInfo.InvariantCulture) : "");
+            sb.AppendLine();
+
+            string summary_filename = binary_filename + ".summary.csv";
+            File.WriteAllText(summary_filename, sb.ToString());
+            return summary_filename;
+        }
+
+        //! Equirectangular approximation; plenty for leg-by-leg track length.
+        private static double DistanceKm(double lat1, double lon1, double lat2, double lon2)
+        {
+            double dlat = (lat2 - lat1) * Math.PI / 180.0;
+            double dlon = (lon2 - lon1) * Math.PI / 180.0 * Math.Cos(lat1 * Math.PI / 180.0);
+            return Math.Sqrt(dlat * dlat + dlon * dlon) * 6371.0;
+        }
+    }
+}
@@ -0,0 +1,57 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Text;
+
+namespace Communication.Frames
+{
+    /*!
+     *   Fixed-size overwrite-oldest ring of value-type frames.
+     *
+     *   The parser thread deserializes a frame straight into its reused
+     *   scratch struct and hands it in by ref; Publish() copies it into a
+     *   preallocated slot, so the steady state allocates nothing at all.
+     *   Each subscriber owns a cursor (start it at Head) and polls with
+     *   TryRead(), which copies the next unread frame out by ref. A slow
+     *   subscriber that gets lapped is skipped forward and simply loses
+     *   the oldest frames - at telemetry rates that beats growing a queue.
+     */
+    public class FrameRing<T> where T : struct
+    {
+        private readonly T[] slot;
+        private long head;   // sequence number of the next slot written
+
+        public FrameRing(int capacity)
+        {
+            slot = new T[capacity];
+        }
+
+        //! Cursor value that makes a new subscriber see only future frames.
+        public long Head
+        {
+            get { lock (this) return head; }
+        }
+
+        public void Publish(ref T frame)
+        {
+            lock (this)
+            {
+                slot[(int)(head % slot.Length)] = frame;
+                head++;
+            }
+        }
+
+        public bool TryRead(ref long cursor, ref T frame)
+        {
+            lock (this)
+            {
+                if (cursor >= head)
+                    return false;
+                if (cursor < head - slot.Length)
+                    cursor = head - slot.Length;   // lapped: drop the lost frames
+                frame = slot[(int)(cursor % slot.Length)];
+                cursor++;
+                return true;
+            }
+        }
+    }
+}
@@ -0,0 +1,44 @@
+﻿// <auto-generated>
+//   Generated from Firmware/rtos_pilot/telemetry_frames.h by
+//   generate_frame_schema.py. Do not edit by hand: edit the header
+//   and re-run the script, so firmware and groundstation keep
+//   agreeing on the frame layouts.
+// </auto-generated>
+using System.Collections.Generic;
+
+namespace Communication.Frames
+{
+    public static class FrameSchema
+    {
+        // tag -> field names, in on-the-wire order
+        static readonly Dictionary<string, string[]> _fields =
+            new Dictionary<string, string[]>
+        {
+            { "TA", new string[] { "roll_mrad", "pitch_mrad", "yaw_mrad" } },
+            { "TC", new string[] { "flight_mode", "navigation_line", "altitude_m", "batt1_voltage_10", "flight_time_s", "block_time_s", "rc_link_pct", "throttle_pct", "target_altitude_agl_m", "batt2_voltage_10", "batt1_mah_10", "cpu_pct" } },
+            { "TG", new string[] { "status", "latitude_rad", "longitude_rad", "speed_ms_10", "heading_rad_100", "satellites_in_view", "height_m" } },
+            { "TT", new string[] { "channel_1", "channel_2", "channel_3", "channel_4", "channel_5", "channel_6", "channel_7", "channel_8" } },
+            { "TR", new string[] { "acc_x_raw", "acc_y_raw", "acc_z_raw", "gyro_x_raw", "gyro_y_raw", "gyro_z_raw" } },
+            { "TP", new string[] { "acc_x_mg", "acc_y_mg", "acc_z_mg", "p_mrad_s", "q_mrad_s", "r_mrad_s" } },
+            { "TH", new string[] { "pressure_pa", "temperature" } },
+        };
+
+        // Number of fields the firmware serializes after the tag;
+        // parsers guard with lines.Length > FieldCount(tag) since
+        // lines[0] holds the tag itself.
+        public static int FieldCount(string tag)
+        {
+            return _fields[tag].Length;
+        }
+
+        public static string[] FieldNames(string tag)
+        {
+            return _fields[tag];
+        }
+
+        public static bool Knows(string tag)
+        {
+            return _fields.ContainsKey(tag);
+        }
+    }
+}
@@ -0,0 +1,16 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Text;
+
+namespace Communication.Frames.Incoming
+{
+    // Value-type counterpart of Attitude, published through
+    // SerialCommunication.AttitudeFrames by the binary protocol parser.
+    public struct AttitudeFrame
+    {
+        public double RollDeg;
+        public double PitchDeg;
+        public double YawDeg;
+        public int AircraftId;
+    }
+}
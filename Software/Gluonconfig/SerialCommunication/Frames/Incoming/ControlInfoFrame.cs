@@ -0,0 +1,24 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Text;
+
+namespace Communication.Frames.Incoming
+{
+    // Value-type counterpart of ControlInfo, published through
+    // SerialCommunication.ControlInfoFrames by the binary protocol parser.
+    public struct ControlInfoFrame
+    {
+        public ControlInfo.FlightModes FlightMode;
+        public int CurrentNavigationLine;
+        public double Altitude;
+        public double TargetAltitude;
+        public double Batt1Voltage;
+        public double Batt2Voltage;
+        public double Batt_mAh;
+        public int FlightTime;
+        public int BlockTime;
+        public int Throttle;
+        public int RcLink;
+        public int AircraftId;
+    }
+}
@@ -0,0 +1,20 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Text;
+
+namespace Communication.Frames.Incoming
+{
+    // Value-type counterpart of GpsBasic, published through
+    // SerialCommunication.GpsBasicFrames by the binary protocol parser.
+    public struct GpsBasicFrame
+    {
+        public double Latitude;
+        public double Longitude;
+        public double Height_m;
+        public double Heading_deg;
+        public double Speed_ms;
+        public int NumberOfSatellites;
+        public int Status;
+        public int AircraftId;
+    }
+}
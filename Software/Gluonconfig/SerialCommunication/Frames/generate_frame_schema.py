@@ -0,0 +1,118 @@
+#!/usr/bin/env python
+# Regenerates FrameSchema.cs from the telemetry frame schema header in the
+# firmware tree, so the groundstation parser and the firmware serializer
+# share one definition of every frame layout. Run it from this directory
+# after editing the header:
+#
+#   python generate_frame_schema.py
+#
+# It only understands the one-field-per-line "F(name, TF_x) \" shape the
+# header documents; anything fancier and it stops with an error rather
+# than emitting a wrong schema.
+
+import os
+import re
+import sys
+
+HEADER = os.path.join(os.path.dirname(__file__) or '.',
+                      '..', '..', '..', '..',
+                      'Firmware', 'rtos_pilot', 'telemetry_frames.h')
+OUTPUT = os.path.join(os.path.dirname(__file__) or '.', 'FrameSchema.cs')
+
+FIELD_RE = re.compile(r'^\tF\((\w+), (TF_\w+)\)( \\)?$')
+LIST_RE = re.compile(r'^#define TELEMETRY_(\w+)_FIELDS\(F\) \\$')
+FRAME_RE = re.compile(r'^\tFRAME\((\w+)\)( \\)?$')
+
+
+def parse_header(path):
+    frames = {}      # tag -> [(field, type)]
+    order = []       # tags in TELEMETRY_FRAME_LIST order
+    tag = None
+    in_frame_list = False
+    for line in open(path):
+        line = line.rstrip('\r\n')
+        m = LIST_RE.match(line)
+        if m:
+            tag = m.group(1)
+            frames[tag] = []
+            continue
+        if line == '#define TELEMETRY_FRAME_LIST(FRAME) \\':
+            in_frame_list = True
+            continue
+        if in_frame_list:
+            m = FRAME_RE.match(line)
+            if not m:
+                in_frame_list = False
+                continue
+            order.append(m.group(1))
+            continue
+        if tag is not None:
+            m = FIELD_RE.match(line)
+            if m:
+                frames[tag].append((m.group(1), m.group(2)))
+                if not m.group(3):   # last field has no continuation
+                    tag = None
+                continue
+            if line.startswith('\tF('):
+                sys.exit('unparsable field line in %s: %r' % (path, line))
+            tag = None
+    missing = [t for t in order if not frames.get(t)]
+    if not order or missing:
+        sys.exit('no frames parsed from %s (missing: %s)' % (path, missing))
+    return order, frames
+
+
+def write_schema(order, frames, path):
+    out = open(path, 'wb')
+
+    def w(line=''):
+        out.write((line + '\r\n').encode('utf-8'))
+
+    out.write(b'\xef\xbb\xbf')   # BOM, like the hand-written sources
+    w('// <auto-generated>')
+    w('//   Generated from Firmware/rtos_pilot/telemetry_frames.h by')
+    w('//   generate_frame_schema.py. Do not edit by hand: edit the header')
+    w('//   and re-run the script, so firmware and groundstation keep')
+    w('//   agreeing on the frame layouts.')
+    w('// </auto-generated>')
+    w('using System.Collections.Generic;')
+    w()
+    w('namespace Communication.Frames')
+    w('{')
+    w('    public static class FrameSchema')
+    w('    {')
+    w('        // tag -> field names, in on-the-wire order')
+    w('        static readonly Dictionary<string, string[]> _fields =')
+    w('            new Dictionary<string, string[]>')
+    w('        {')
+    for tag in order:
+        names = ', '.join('"%s"' % f for f, _ in frames[tag])
+        w('            { "%s", new string[] { %s } },' % (tag, names))
+    w('        };')
+    w()
+    w('        // Number of fields the firmware serializes after the tag;')
+    w('        // parsers guard with lines.Length > FieldCount(tag) since')
+    w('        // lines[0] holds the tag itself.')
+    w('        public static int FieldCount(string tag)')
+    w('        {')
+    w('            return _fields[tag].Length;')
+    w('        }')
+    w()
+    w('        public static string[] FieldNames(string tag)')
+    w('        {')
+    w('            return _fields[tag];')
+    w('        }')
+    w()
+    w('        public static bool Knows(string tag)')
+    w('        {')
+    w('            return _fields.ContainsKey(tag);')
+    w('        }')
+    w('    }')
+    w('}')
+    out.close()
+
+
+if __name__ == '__main__':
+    order, frames = parse_header(HEADER)
+    write_schema(order, frames, OUTPUT)
+    print('FrameSchema.cs: %d frames (%s)' % (len(order), ', '.join(order)))
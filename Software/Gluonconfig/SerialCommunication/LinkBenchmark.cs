@@ -0,0 +1,132 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Text;
+
+namespace Communication
+{
+    /*!
+     *   Receive-side statistics for a link benchmark run (BE command).
+     *
+     *   The autopilot streams sequenced BENCH frames, each stamped with its
+     *   timer_millis() clock. The parser thread calls Record() per valid
+     *   frame; loss falls out of the sequence gaps, goodput out of wire
+     *   bytes over wall time, and latency jitter out of how far each
+     *   arrival drifts from the sender's own timestamps. The two clocks are
+     *   never synchronized, so the jitter numbers are relative to the
+     *   fastest frame of the run - good enough to compare protocol changes,
+     *   which is what the benchmark exists for.
+     */
+    public class LinkBenchmark
+    {
+        private long frames_received;
+        private long wire_bytes;
+        private long min_seq = -1;
+        private long max_seq = -1;
+        private int first_arrival_ms;
+        private int last_arrival_ms;
+        private long first_remote_ms = -1;
+        private List<double> offsets_ms = new List<double>();
+
+        public void Reset()
+        {
+            lock (this)
+            {
+                frames_received = 0;
+                wire_bytes = 0;
+                min_seq = -1;
+                max_seq = -1;
+                first_remote_ms = -1;
+                offsets_ms.Clear();
+            }
+        }
+
+        //! Called from the parser thread for every valid BENCH frame.
+        public void Record(long seq, long remote_ms, int frame_wire_bytes, int arrival_tick_ms)
+        {
+            lock (this)
+            {
+                if (frames_received == 0)
+                {
+                    first_arrival_ms = arrival_tick_ms;
+                    first_remote_ms = remote_ms;
+                    min_seq = seq;
+                    max_seq = seq;
+                }
+                frames_received++;
+                wire_bytes += frame_wire_bytes;
+                last_arrival_ms = arrival_tick_ms;
+                if (seq < min_seq)
+                    min_seq = seq;
+                if (seq > max_seq)
+                    max_seq = seq;
+
+                // drift of this arrival against the sender's schedule; the
+                // common offset between the two clocks cancels in the
+                // percentile differences
+                offsets_ms.Add((arrival_tick_ms - first_arrival_ms) - (double)(remote_ms - first_remote_ms));
+            }
+        }
+
+        public long FramesReceived
+        {
+            get { lock (this) return frames_received; }
+        }
+
+        //! Gaps in the sequence numbers seen so far.
+        public long FramesLost
+        {
+            get
+            {
+                lock (this)
+                {
+                    if (frames_received == 0)
+                        return 0;
+                    return (max_seq - min_seq + 1) - frames_received;
+                }
+            }
+        }
+
+        //! Valid frame bytes per second over the run so far, checksum and
+        //! framing included - the number to hold against the baud rate.
+        public double GoodputBytesPerSecond
+        {
+            get
+            {
+                lock (this)
+                {
+                    int span = last_arrival_ms - first_arrival_ms;
+                    if (span <= 0)
+                        return 0.0;
+                    return wire_bytes * 1000.0 / span;
+                }
+            }
+        }
+
+        /*!
+         *   Latency above the run's fastest frame, in milliseconds, at the
+         *   given percentile (0..100). Call with 50, 90 and 99 for the
+         *   usual before/after table.
+         */
+        public double LatencyPercentileMs(double percentile)
+        {
+            lock (this)
+            {
+                if (offsets_ms.Count == 0)
+                    return 0.0;
+                List<double> sorted = new List<double>(offsets_ms);
+                sorted.Sort();
+                int index = (int)((sorted.Count - 1) * percentile / 100.0);
+                return sorted[index] - sorted[0];
+            }
+        }
+
+        public override string ToString()
+        {
+            return FramesReceived + " frames, " + FramesLost + " lost, " +
+                   GoodputBytesPerSecond.ToString("F0") + " B/s, latency p50/p90/p99 = " +
+                   LatencyPercentileMs(50).ToString("F0") + "/" +
+                   LatencyPercentileMs(90).ToString("F0") + "/" +
+                   LatencyPercentileMs(99).ToString("F0") + " ms";
+        }
+    }
+}
@@ -12,6 +12,7 @@ using System.Collections.Generic;
 using System.Text;
 using System.IO;
 using System.IO.Ports;
+using Communication.Frames;
 using Communication.Frames.Configuration;
 using Communication.Frames.Incoming;
 
@@ -22,6 +23,25 @@ namespace Communication
         protected SerialPort _serialPort;   // COM communication port
         public abstract string LogToFilename { get; set; }
 
+        // Shared-channel operation: the binary frames carry an aircraft id
+        // (top 3 bits of the msgid byte) so one receiver can hear several
+        // interleaved autopilots. -1 accepts frames from any aircraft; set
+        // an id to follow only that aircraft - the other ones still keep
+        // their decoder state up to date, so switching is instant.
+        public int SelectedAircraft = -1;
+        public int LastAircraftSeen = 0;
+
+        // Zero-allocation publication path for the binary telemetry: the
+        // parser deserializes each frame straight into a struct and copies
+        // it into these fixed-size rings, so high-rate subscribers (the 3D
+        // view in particular) can poll with their own cursor without a heap
+        // allocation per frame. The class-based events below remain for the
+        // low-rate CSV consumers. Sized for a couple of seconds at the 50Hz
+        // attitude stream.
+        public readonly FrameRing<AttitudeFrame> AttitudeFrames = new FrameRing<AttitudeFrame>(128);
+        public readonly FrameRing<GpsBasicFrame> GpsBasicFrames = new FrameRing<GpsBasicFrame>(32);
+        public readonly FrameRing<ControlInfoFrame> ControlInfoFrames = new FrameRing<ControlInfoFrame>(32);
+
         // delegates used for the communication frames events
         public delegate void ReceiveCommunication(string line);
         public delegate void ReceiveNonParsedCommunication(string line);
@@ -34,7 +54,10 @@ namespace Communication
         public delegate void ReceiveAttitudeCommunicationFrame(Attitude attitude);
         public delegate void ReceiveDatalogTableCommunicationFrame(DatalogTable table);
         public delegate void ReceiveDatalogLineCommunicationFrame(DatalogLine line);
+        public delegate void ReceiveDatalogPageChunkCommunicationFrame(int page, int chunk, byte[] data);
         public delegate void ReceiveNavigationInstructionCommunicationFrame(NavigationInstruction ni);
+        public delegate void ReceiveNavigationHashCommunicationFrame(int crc, int line_count);
+        public delegate void ReceiveLinkBenchmarkCommunicationFrame(long frames_sent, long elapsed_ms);
         public delegate void ReceiveControlInfoCommunicationFrame(ControlInfo ci);
         public delegate void ReceiveServosCommunicationFrame(Servos s);
 
@@ -62,8 +85,11 @@ namespace Communication
         // Datalog
         public abstract event ReceiveDatalogTableCommunicationFrame DatalogTableCommunicationReceived;
         public abstract event ReceiveDatalogLineCommunicationFrame DatalogLineCommunicationReceived;
+        public abstract event ReceiveDatalogPageChunkCommunicationFrame DatalogPageChunkCommunicationReceived;
         // Navigation
         public abstract event ReceiveNavigationInstructionCommunicationFrame NavigationInstructionCommunicationReceived;
+        public abstract event ReceiveNavigationHashCommunicationFrame NavigationHashCommunicationReceived;
+        public abstract event ReceiveLinkBenchmarkCommunicationFrame LinkBenchmarkCompleted;
         // ControlInfo
         public abstract event ReceiveControlInfoCommunicationFrame ControlInfoCommunicationReceived;
         public abstract event ReceiveServosCommunicationFrame ServosCommunicationReceived;
@@ -137,6 +163,8 @@ namespace Communication
 
         public abstract void SendDatalogTableRead(int i);
 
+        public abstract void SendDatalogPageRequest(int page);
+
         public abstract void SendNavigationInstruction(NavigationInstruction ni);
 
         public abstract void SendJumpToNavigationLine(int line);
@@ -145,6 +173,27 @@ namespace Communication
 
         public abstract void SendNavigationRead();
 
+        //! Asks the autopilot for the crc of its flightplan (NH reply);
+        //! compare against LocalNavigationCrc() to verify a diff upload
+        //! without re-reading every line.
+        public abstract void SendNavigationHashRequest();
+
+        //! Crc over the flightplan as last reported by the autopilot, or -1
+        //! when fewer than line_count lines have been seen this session.
+        public virtual int LocalNavigationCrc(int line_count)
+        {
+            return -1;
+        }
+
+        //! Receive-side counters for a link benchmark run; reset by
+        //! SendLinkBenchmark(), filled by the parser, read by the gui.
+        public readonly LinkBenchmark Benchmark = new LinkBenchmark();
+
+        //! Starts a link benchmark (BE command): the autopilot streams
+        //! rate_hz * seconds sequenced test frames with filler_bytes of
+        //! padding each; completion raises LinkBenchmarkCompleted.
+        public abstract void SendLinkBenchmark(int rate_hz, int seconds, int filler_bytes);
+
         public abstract void SendNavigationLoad();
 
         public abstract void SendReboot();
@@ -12,6 +12,7 @@ using System.IO;
 using System.IO.Ports;
 
 using Amib.Threading;
+using Communication.Frames;
 using Communication.Frames.Configuration;
 using Communication.Frames.Incoming;
 using System.Threading;
@@ -30,28 +31,53 @@ namespace Communication
                 try
                 {
                         filename = value;
-                        logfile = new System.IO.StreamWriter(filename);
+                        // the binary container skips the text parse on reload;
+                        // see BinaryLog.cs
+                        if (filename.EndsWith(BinaryLog.Extension, StringComparison.OrdinalIgnoreCase))
+                            binarylog = new BinaryLogWriter(filename);
+                        else
+                            logfile = new System.IO.StreamWriter(filename);
                 }
                 catch (Exception e)
                 {
                     logfile = null;
+                    binarylog = null;
                 }
             }
             get
             {
-                if (logfile == null)
+                if (logfile == null && binarylog == null)
                     return "";
                 else
                     return filename;
             }
         }
         private System.IO.StreamWriter logfile;
+        private BinaryLogWriter binarylog;
+
+        private void LogReceivedLine(string line)
+        {
+            if (binarylog != null)
+                binarylog.LogLine(DateTime.Now, line);
+            else if (logfile != null)
+                logfile.WriteLine("[" + DateTime.Now.ToString("MM/dd/yyyy HH:mm:ss.fff", CultureInfo.InvariantCulture) + "] " + line);
+        }
+
+        private void LogSentText(string text)
+        {
+            if (binarylog != null)
+                binarylog.LogRaw(text);
+            else if (logfile != null)
+                logfile.WriteLine(text);
+        }
 
         private SmartThreadPool _smartThreadPool;
         private int bytes_read = 0;
         private double download_speed_kb_s;
         private DateTime last_throughput_calculation;
         private int FramesReceived = 0;
+        // When set, the ST command asks the firmware for binary TA/TG/TC frames
+        public bool UseBinaryProtocol = false;
         private bool CommunicationAlive = false;
         private DateTime LastValidFrame;
         //private Timer CheckCommunicationReceived = new Timer();
@@ -75,8 +101,11 @@ namespace Communication
         // Datalog
         public override event ReceiveDatalogTableCommunicationFrame DatalogTableCommunicationReceived;
         public override event ReceiveDatalogLineCommunicationFrame DatalogLineCommunicationReceived;
+        public override event ReceiveDatalogPageChunkCommunicationFrame DatalogPageChunkCommunicationReceived;
         // Navigation
         public override event ReceiveNavigationInstructionCommunicationFrame NavigationInstructionCommunicationReceived;
+        public override event ReceiveNavigationHashCommunicationFrame NavigationHashCommunicationReceived;
+        public override event ReceiveLinkBenchmarkCommunicationFrame LinkBenchmarkCompleted;
         // ControlInfo
         public override event ReceiveControlInfoCommunicationFrame ControlInfoCommunicationReceived;
         public override event ReceiveServosCommunicationFrame ServosCommunicationReceived;
@@ -103,6 +132,9 @@ namespace Communication
             //_smartThreadPool.Name = "ReceiveThreadedData";
 
             IWorkItemResult wir =
+                        _smartThreadPool.QueueWorkItem(
+                            new WorkItemCallback(this.ReadPortData), _serialPort);
+            IWorkItemResult wir2 =
                         _smartThreadPool.QueueWorkItem(
                             new WorkItemCallback(this.ReceiveThreadedData), _serialPort);
         }
@@ -178,16 +210,159 @@ namespace Communication
             if (logfile != null)
                 logfile.Close();
             logfile = null;
+            if (binarylog != null)
+            {
+                binarylog.Close();   // writes the index block and the trailer
+                try
+                {
+                    // one row of headline numbers next to the log, for the
+                    // fleet-wide aggregation (see FlightSummary.cs)
+                    FlightSummary.Compute(filename);
+                }
+                catch (Exception e)
+                {
+                }
+            }
+            binarylog = null;
+        }
+
+        // Producer/consumer pipeline: the port thread moves bytes into pooled
+        // buffers and nothing else, the parser thread drains them. Heavy work
+        // (string splits, event handlers, UI invokes) can no longer stall the
+        // port reads, which is what used to drop bytes during 50Hz bursts and
+        // log downloads. Buffers cycle through rx_pool instead of the GC.
+        private const int RX_CHUNK_SIZE = 4096;
+        private readonly Queue<byte[]> rx_filled = new Queue<byte[]>();
+        private readonly Queue<int> rx_filled_len = new Queue<int>();   // parallel to rx_filled
+        private readonly Stack<byte[]> rx_pool = new Stack<byte[]>();
+        private readonly object rx_lock = new object();
+        private byte[] rx_current;
+        private int rx_current_len, rx_current_pos;
+        private readonly byte[] line_bytes = new byte[512];
+
+        /*!
+         *    Producer half: blocks on the serial port and enqueues whatever
+         *    arrived. Runs in its own pool thread.
+         */
+        private object ReadPortData(object state)
+        {
+            while (!SmartThreadPool.IsWorkItemCanceled)
+            {
+                try
+                {
+                    if (_serialPort == null || !_serialPort.IsOpen)
+                    {
+                        Thread.Sleep(100);
+                        continue;
+                    }
+                    _serialPort.ReadTimeout = 1000;
+                    byte[] buf;
+                    lock (rx_lock)
+                        buf = rx_pool.Count > 0 ? rx_pool.Pop() : new byte[RX_CHUNK_SIZE];
+                    int n = 0;
+                    try
+                    {
+                        n = _serialPort.Read(buf, 0, buf.Length);   // blocks for at least one byte
+                    }
+                    catch (TimeoutException)
+                    {
+                    }
+                    lock (rx_lock)
+                    {
+                        if (n > 0)
+                        {
+                            rx_filled.Enqueue(buf);
+                            rx_filled_len.Enqueue(n);
+                            Monitor.Pulse(rx_lock);
+                        }
+                        else
+                            rx_pool.Push(buf);
+                    }
+                }
+                catch (IOException)
+                {
+                    Thread.Sleep(100);   // port closed under us
+                }
+                catch (Exception)
+                {
+                    Thread.Sleep(100);
+                }
+            }
+            return null;
+        }
+
+        /*!
+         *    One byte for the parser, -1 after a second without data.
+         */
+        private int NextByte()
+        {
+            lock (rx_lock)
+            {
+                while (rx_current == null || rx_current_pos >= rx_current_len)
+                {
+                    if (rx_current != null)
+                    {
+                        rx_pool.Push(rx_current);
+                        rx_current = null;
+                    }
+                    if (rx_filled.Count == 0 && !Monitor.Wait(rx_lock, 1000))
+                        return -1;
+                    if (rx_filled.Count > 0)
+                    {
+                        rx_current = rx_filled.Dequeue();
+                        rx_current_len = rx_filled_len.Dequeue();
+                        rx_current_pos = 0;
+                    }
+                }
+                return rx_current[rx_current_pos++];
+            }
+        }
+
+        /*!
+         *    True when the parser can fetch the next byte without blocking;
+         *    used to flush the batched attitude update when a burst ends.
+         */
+        private bool MoreBuffered()
+        {
+            lock (rx_lock)
+                return (rx_current != null && rx_current_pos < rx_current_len) || rx_filled.Count > 0;
+        }
+
+        private string ReadLineFromQueue()
+        {
+            int len = 0;
+            for (; ; )
+            {
+                int b = NextByte();
+                if (b < 0 || b == '\n')
+                    break;
+                if (b != '\r' && len < line_bytes.Length)
+                    line_bytes[len++] = (byte)b;
+            }
+            return Encoding.ASCII.GetString(line_bytes, 0, len);
+        }
+
+        // During stream bursts only the most recent attitude sample reaches
+        // the UI; it is flushed as soon as the input queue runs dry, so the
+        // map view redraws once per burst instead of once per frame.
+        private Attitude pending_attitude;
+        private void QueueAttitude(Attitude att)
+        {
+            pending_attitude = att;
+        }
+        private void FlushPendingAttitude()
+        {
+            if (pending_attitude != null && AttitudeCommunicationReceived != null)
+                AttitudeCommunicationReceived(pending_attitude);
+            pending_attitude = null;
         }
 
         /*!
-         *    This function (that executes in a separate thread) is an
-         *    infinite loop that receives all lines from the serial port
-         *    and parses and executes them.
+         *    Consumer half: an infinite loop that assembles frames from the
+         *    queued buffers, parses them and raises the events.
          */
         private object ReceiveThreadedData(object state)
         {
-            _serialPort.ReadTimeout = 1000;
             bool recognised_frame = true;
             string line = string.Empty;
 
@@ -195,29 +370,52 @@ namespace Communication
             {
                 try
                 {
-                    if (_serialPort == null || !_serialPort.IsOpen)
+                    line = "";
+                    recognised_frame = false;
+
+                    // Binary frames start with 'G' 'P' (see communication_binary.h in the
+                    // firmware), everything else is an ASCII CSV line. Read byte per byte
+                    // until we know which one we have.
+                    string prefix = "";
+                    int first = NextByte();
+                    if (first < 0)
                     {
-                        Thread.Sleep(100);
+                        // a second without data
+                        FlushPendingAttitude();
+                        if (CommunicationAlive && SecondsConnectionLost() >= 5.0)
+                        {
+                            CommunicationAlive = false;
+                            if (CommunicationLost != null)
+                                CommunicationLost();
+                        }
                         continue;
                     }
-                    line = "";
-                    recognised_frame = false;
-                    // A bit extra logic to set communication lost after 1 second of no data 
-                    while (_serialPort.BytesToRead < 3)
+                    if (first == 'G')
                     {
-                        if (CommunicationAlive && SecondsConnectionLost() > 1.0)
+                        int second = NextByte();
+                        if (second == 'P')
                         {
-                            if (CommunicationLost != null && SecondsConnectionLost() >= 5.0)
+                            if (ParseBinaryFrame())
                             {
-                                CommunicationAlive = false;
-                                CommunicationLost();
+                                LastValidFrame = DateTime.Now;
+                                FramesReceived++;
+                                if (!CommunicationAlive)
+                                {
+                                    CommunicationAlive = true;
+                                    if (CommunicationEstablished != null)
+                                        CommunicationEstablished();
+                                }
                             }
+                            if (!MoreBuffered())
+                                FlushPendingAttitude();
+                            continue;   // good or bad: resync on the next sync bytes
                         }
-                        Thread.Sleep(50);
-                        //Console.WriteLine("Waiting for communication...");
+                        prefix = "G" + (second >= 0 ? ((char)second).ToString() : "");
                     }
+                    else if (first >= 0)
+                        prefix = ((char)first).ToString();
 
-                    line = _serialPort.ReadLine().Replace("\r", "").Replace("\n", "");
+                    line = prefix + ReadLineFromQueue();
                     if (line.Length < 3)
                         continue;
 
@@ -232,21 +430,18 @@ namespace Communication
                             throw new Exception("Checksum error");
                     }
 
-                    if (logfile != null)
-                        logfile.WriteLine("[" + DateTime.Now.ToString("MM/dd/yyyy HH:mm:ss.fff", CultureInfo.InvariantCulture) + "] " + line);
+                    LogReceivedLine(line);
 
                     lock (this)
                     {
                         bytes_read += line.Length + 1;
                     }
 
-                    line = line.Replace("\r", "");
-
                     string[] lines = line.Split(';');
                     //Console.WriteLine(line + "\n\r");
                     // TR: Gyro & Acc raw
                     recognised_frame = true;
-                    if (lines[0].EndsWith("TR") && lines.Length >= 6)
+                    if (lines[0].EndsWith("TR") && lines.Length > FrameSchema.FieldCount("TR"))
                     {
                         double acc_x_raw = double.Parse(lines[1]);
                         double acc_y_raw = double.Parse(lines[2]);
@@ -268,7 +463,7 @@ namespace Communication
                     }
 
                     // TP: Processed gyro & acc
-                    else if (lines[0].EndsWith("TP") && lines.Length >= 6)
+                    else if (lines[0].EndsWith("TP") && lines.Length > FrameSchema.FieldCount("TP"))
                     {
                         double acc_x = double.Parse(lines[1]) / 1000.0;
                         double acc_y = double.Parse(lines[2]) / 1000.0;
@@ -282,7 +477,7 @@ namespace Communication
                     }
 
                     // TH: Pressure & Temp
-                    else if (lines[0].EndsWith("TH") && lines.Length >= 2)
+                    else if (lines[0].EndsWith("TH") && lines.Length > FrameSchema.FieldCount("TH"))
                     {
                         float pressure = float.Parse(lines[1]);
                         float temp = float.Parse(lines[2]);
@@ -427,7 +622,7 @@ namespace Communication
                     }
 
                     // TT: RC transmitter
-                    else if (lines[0].EndsWith("TT") && lines.Length >= 7)
+                    else if (lines[0].EndsWith("TT") && lines.Length > FrameSchema.FieldCount("TT"))
                     {
                         RcInput rc = new RcInput(
                             new int[] { 
@@ -442,7 +637,7 @@ namespace Communication
                             RcInputCommunicationReceived(rc);
                     }
                     // TG: GPS basic
-                    else if (lines[0].EndsWith("TG") && lines.Length >= 7)
+                    else if (lines[0].EndsWith("TG") && lines.Length > FrameSchema.FieldCount("TG"))
                     {
                         //Console.WriteLine(line);
                         GpsBasic gb = new GpsBasic(
@@ -458,7 +653,7 @@ namespace Communication
                             GpsBasicCommunicationReceived(gb);
                     }
                     // TA: Attitude
-                    else if (lines[0].EndsWith("TA") && lines.Length >= 3)
+                    else if (lines[0].EndsWith("TA") && lines.Length > FrameSchema.FieldCount("TA"))
                     {
                         Attitude att = new Attitude(
                             double.Parse(lines[1], CultureInfo.InvariantCulture) / 1000.0 / 3.14 * 180.0,
@@ -467,8 +662,7 @@ namespace Communication
                             double.Parse(lines[4], CultureInfo.InvariantCulture) / 1000.0 / 3.14 * 180.0,*/0, 0,
                             double.Parse(lines[3], CultureInfo.InvariantCulture) / 1000.0 / 3.14 * 180.0
                             );
-                        if (AttitudeCommunicationReceived != null)
-                            AttitudeCommunicationReceived(att);
+                        QueueAttitude(att);
                     }
                     // DT: Datalog table
                     else if (lines[0].EndsWith("DT") && lines.Length >= 4)
@@ -521,9 +715,25 @@ namespace Communication
                                 double.Parse(lines[4], CultureInfo.InvariantCulture),
                                 int.Parse(lines[5]),
                                 int.Parse(lines[6]));
+                        // keep the exact wire text: the VN verification crc
+                        // runs over these payloads on both sides
+                        if (lines[0] == "ND" && ni.line >= 1 && ni.line <= nav_line_text.Length)
+                            nav_line_text[ni.line - 1] = line;
                         if (NavigationInstructionCommunicationReceived != null)
                             NavigationInstructionCommunicationReceived(ni);
                     }
+                    // NH: Navigation hash (VN reply): crc over the ND wire form of the full plan
+                    else if (lines[0].EndsWith("NH") && lines.Length >= 3)
+                    {
+                        if (NavigationHashCommunicationReceived != null)
+                            NavigationHashCommunicationReceived(int.Parse(lines[1]), int.Parse(lines[2]));
+                    }
+                    // BE: a link benchmark run finished; frames sent and elapsed ms
+                    else if (lines[0].EndsWith("BE") && lines.Length >= 3)
+                    {
+                        if (LinkBenchmarkCompleted != null)
+                            LinkBenchmarkCompleted(long.Parse(lines[1]), long.Parse(lines[2]));
+                    }
                     // TS: Servos (simulation)
                     else if (lines[0].EndsWith("TS") && lines.Length >= 3)
                     {
@@ -611,6 +821,8 @@ namespace Communication
                     }
                     if (CommunicationReceived != null)
                         CommunicationReceived(line);
+                    if (!MoreBuffered())
+                        FlushPendingAttitude();
                 }
                 catch (Exception e)
                 {
@@ -621,6 +833,256 @@ namespace Communication
             return null;
         }
 
+        // Delta stream state: the last decoded field values in raw wire units
+        // and the sequence byte expected on the next frame. -1 means no
+        // keyframe has been seen yet or a frame was lost; delta frames are
+        // then ignored until the next keyframe resynchronizes the stream.
+        // One instance per aircraft id: the top 3 bits of the msgid byte
+        // address up to 8 autopilots interleaved on one shared channel, and
+        // each keeps its own baselines and sequence numbers.
+        private class AircraftState
+        {
+            public int att_seq = -1;
+            public int att_roll, att_pitch, att_yaw;
+            public int gps_seq = -1;
+            public int gps_status, gps_lat, gps_lon, gps_speed, gps_heading, gps_sats, gps_height;
+        }
+        private AircraftState[] aircraft_state = new AircraftState[8] {
+            new AircraftState(), new AircraftState(), new AircraftState(), new AircraftState(),
+            new AircraftState(), new AircraftState(), new AircraftState(), new AircraftState() };
+
+        // Reused by the binary parser: the payload buffer and the scratch
+        // structs published into the frame rings. Nothing on this path
+        // allocates per frame; the class-based events are only served (and
+        // their objects only built) when somebody actually subscribed.
+        private readonly byte[] binary_payload = new byte[160];
+        private AttitudeFrame att_frame;
+        private GpsBasicFrame gps_frame;
+        private ControlInfoFrame control_frame;
+
+        // Builds the attitude update from the cached raw stream values, shared
+        // by the keyframe and the delta frame; batched via QueueAttitude().
+        private void RaiseBinaryAttitude(AircraftState st, int aircraft_id)
+        {
+            att_frame.RollDeg = st.att_roll / 1000.0 / 3.14 * 180.0;
+            att_frame.PitchDeg = st.att_pitch / 1000.0 / 3.14 * 180.0;
+            att_frame.YawDeg = st.att_yaw / 1000.0 / 3.14 * 180.0;
+            att_frame.AircraftId = aircraft_id;
+            AttitudeFrames.Publish(ref att_frame);
+
+            if (AttitudeCommunicationReceived != null)
+                QueueAttitude(new Attitude(
+                    att_frame.RollDeg,
+                    att_frame.PitchDeg,
+                    0, 0,
+                    att_frame.YawDeg));
+        }
+
+        private void RaiseBinaryGpsBasic(AircraftState st, int aircraft_id)
+        {
+            gps_frame.Latitude = st.gps_lat / 100000000.0;
+            gps_frame.Longitude = st.gps_lon / 100000000.0;
+            gps_frame.Height_m = st.gps_height;
+            gps_frame.Heading_deg = st.gps_heading / 100.0;
+            gps_frame.Speed_ms = st.gps_speed / 10.0;
+            gps_frame.NumberOfSatellites = st.gps_sats;
+            gps_frame.Status = st.gps_status;
+            gps_frame.AircraftId = aircraft_id;
+            GpsBasicFrames.Publish(ref gps_frame);
+
+            if (GpsBasicCommunicationReceived != null)
+                GpsBasicCommunicationReceived(new GpsBasic(
+                    gps_frame.Latitude,
+                    gps_frame.Longitude,
+                    gps_frame.Height_m,
+                    gps_frame.Heading_deg,
+                    gps_frame.Speed_ms,
+                    gps_frame.NumberOfSatellites,
+                    gps_frame.Status));
+        }
+
+        /*!
+         *    Reads one binary frame (the two sync bytes have already been consumed):
+         *    msgid, payload length, payload, Fletcher checksum pair. Returns true and
+         *    raises the same event as the matching CSV line when the frame is valid.
+         */
+        private bool ParseBinaryFrame()
+        {
+            int msgid = NextByte();
+            int len = NextByte();
+            if (msgid < 0 || len < 0 || len > 160)   // largest frame is a log page chunk (135)
+                return false;
+
+            byte[] payload = binary_payload;   // reused, no per-frame allocation
+            for (int i = 0; i < len; i++)
+            {
+                int b = NextByte();
+                if (b < 0)
+                    return false;
+                payload[i] = (byte)b;
+            }
+
+            byte ck_a = (byte)msgid, ck_b = (byte)msgid;
+            ck_a += (byte)len; ck_b += ck_a;
+            for (int i = 0; i < len; i++)
+            {
+                ck_a += payload[i];
+                ck_b += ck_a;
+            }
+            if (NextByte() != ck_a || NextByte() != ck_b)
+                return false;
+
+            lock (this)
+            {
+                bytes_read += len + 6;
+            }
+
+            // the checksum runs over the full msgid byte; only now split off
+            // the aircraft id carried in its top 3 bits
+            int aircraft_id = (msgid >> 5) & 0x07;
+            msgid &= 0x1f;
+
+            // every aircraft's decoder state stays up to date, but only the
+            // selected one raises events - switching planes is instant and
+            // never involves the gui thread in filtering
+            AircraftState st = aircraft_state[aircraft_id];
+            bool deliver = SelectedAircraft < 0 || SelectedAircraft == aircraft_id;
+            LastAircraftSeen = aircraft_id;
+
+            if (msgid == 0x01 && len >= 6)  // attitude keyframe, same content as "TA"
+            {
+                st.att_roll = BitConverter.ToInt16(payload, 0);
+                st.att_pitch = BitConverter.ToInt16(payload, 2);
+                st.att_yaw = BitConverter.ToInt16(payload, 4);
+                // the trailing sequence byte is missing on old firmware, which
+                // sends no delta frames either
+                st.att_seq = len >= 7 ? (payload[6] + 1) & 0xff : -1;
+                if (deliver)
+                    RaiseBinaryAttitude(st, aircraft_id);
+            }
+            else if (msgid == 0x02 && len >= 16)  // gps basic keyframe, same content as "TG"
+            {
+                st.gps_status = payload[0];
+                st.gps_lat = BitConverter.ToInt32(payload, 1);
+                st.gps_lon = BitConverter.ToInt32(payload, 5);
+                st.gps_speed = BitConverter.ToInt16(payload, 9);
+                st.gps_heading = BitConverter.ToInt16(payload, 11);
+                st.gps_sats = payload[13];
+                st.gps_height = BitConverter.ToInt16(payload, 14);
+                st.gps_seq = len >= 17 ? (payload[16] + 1) & 0xff : -1;
+                if (deliver)
+                    RaiseBinaryGpsBasic(st, aircraft_id);
+            }
+            else if (msgid == 0x03 && len >= 19)  // control, same content as "TC"
+            {
+                control_frame.FlightMode = (ControlInfo.FlightModes)payload[0];
+                control_frame.CurrentNavigationLine = BitConverter.ToInt16(payload, 1);
+                control_frame.Altitude = BitConverter.ToInt16(payload, 3);
+                control_frame.Batt1Voltage = BitConverter.ToInt16(payload, 5) / 10.0;
+                control_frame.FlightTime = BitConverter.ToInt16(payload, 7);
+                control_frame.BlockTime = BitConverter.ToInt16(payload, 9);
+                control_frame.RcLink = payload[11];
+                control_frame.Throttle = payload[12];
+                control_frame.TargetAltitude = BitConverter.ToInt16(payload, 13);
+                control_frame.Batt2Voltage = BitConverter.ToInt16(payload, 15) / 10.0;
+                control_frame.Batt_mAh = BitConverter.ToInt16(payload, 17) * 10.0;
+                control_frame.AircraftId = aircraft_id;
+                if (deliver)
+                {
+                    ControlInfoFrames.Publish(ref control_frame);
+                    if (ControlInfoCommunicationReceived != null)
+                    {
+                        ControlInfo ci = new ControlInfo();
+                        ci.FlightMode = control_frame.FlightMode;
+                        ci.CurrentNavigationLine = control_frame.CurrentNavigationLine;
+                        ci.Altitude = control_frame.Altitude;
+                        ci.Batt1Voltage = control_frame.Batt1Voltage;
+                        ci.FlightTime = control_frame.FlightTime;
+                        ci.BlockTime = control_frame.BlockTime;
+                        ci.RcLink = control_frame.RcLink;
+                        ci.Throttle = control_frame.Throttle;
+                        ci.TargetAltitude = control_frame.TargetAltitude;
+                        ci.Batt2Voltage = control_frame.Batt2Voltage;
+                        ci.Batt_mAh = control_frame.Batt_mAh;
+                        ControlInfoCommunicationReceived(ci);
+                    }
+                }
+            }
+            else if (msgid == 0x06 && len >= 2)  // attitude delta: seq, mask, changed fields
+            {
+                int mask = payload[1];
+                int need = 2;
+                for (int bit = 0x01; bit <= 0x04; bit <<= 1)
+                    if ((mask & bit) != 0)
+                        need++;
+                if (len < need)
+                    return false;
+                if (st.att_seq < 0 || payload[0] != st.att_seq)
+                {
+                    st.att_seq = -1;   // gap in the stream: wait for the next keyframe
+                    return true;
+                }
+                st.att_seq = (st.att_seq + 1) & 0xff;
+                int pos = 2;
+                if ((mask & 0x01) != 0) st.att_roll += (sbyte)payload[pos++];
+                if ((mask & 0x02) != 0) st.att_pitch += (sbyte)payload[pos++];
+                if ((mask & 0x04) != 0) st.att_yaw += (sbyte)payload[pos++];
+                if (deliver)
+                    RaiseBinaryAttitude(st, aircraft_id);
+            }
+            else if (msgid == 0x07 && len >= 2)  // gps delta: seq, mask, changed fields
+            {
+                int mask = payload[1];
+                int need = 2;
+                if ((mask & 0x01) != 0) need += 1;
+                if ((mask & 0x02) != 0) need += 2;
+                if ((mask & 0x04) != 0) need += 2;
+                if ((mask & 0x08) != 0) need += 1;
+                if ((mask & 0x10) != 0) need += 1;
+                if ((mask & 0x20) != 0) need += 1;
+                if ((mask & 0x40) != 0) need += 1;
+                if (len < need)
+                    return false;
+                if (st.gps_seq < 0 || payload[0] != st.gps_seq)
+                {
+                    st.gps_seq = -1;   // gap in the stream: wait for the next keyframe
+                    return true;
+                }
+                st.gps_seq = (st.gps_seq + 1) & 0xff;
+                int pos = 2;
+                if ((mask & 0x01) != 0) st.gps_status = payload[pos++];
+                if ((mask & 0x02) != 0) { st.gps_lat += BitConverter.ToInt16(payload, pos); pos += 2; }
+                if ((mask & 0x04) != 0) { st.gps_lon += BitConverter.ToInt16(payload, pos); pos += 2; }
+                if ((mask & 0x08) != 0) st.gps_speed += (sbyte)payload[pos++];
+                if ((mask & 0x10) != 0) st.gps_heading += (sbyte)payload[pos++];
+                if ((mask & 0x20) != 0) st.gps_sats = payload[pos++];
+                if ((mask & 0x40) != 0) st.gps_height += (sbyte)payload[pos++];
+                if (deliver)
+                    RaiseBinaryGpsBasic(st, aircraft_id);
+            }
+            else if (msgid == 0x08 && len >= 8)  // sequenced benchmark frame (BE command)
+            {
+                Benchmark.Record(
+                    BitConverter.ToUInt32(payload, 0),
+                    BitConverter.ToUInt32(payload, 4),
+                    len + 6,
+                    Environment.TickCount);
+            }
+            else if (msgid == 0x04 && len > 3)  // one chunk of a datalog page (DP request)
+            {
+                int page = BitConverter.ToUInt16(payload, 0);
+                int chunk = payload[2];
+                byte[] data = new byte[len - 3];
+                Array.Copy(payload, 3, data, 0, len - 3);
+                if (deliver && DatalogPageChunkCommunicationReceived != null)
+                    DatalogPageChunkCommunicationReceived(page, chunk, data);
+            }
+            else
+                return false;   // unknown msgid: count it as noise
+
+            return true;
+        }
+
 
         public override void SendTelemetry(int basicgps, int gyroaccraw, int gyroaccproc, int ppm, int pressuretemp, int attitude, int control)
         {
@@ -632,7 +1094,8 @@ namespace Communication
                 ppm.ToString() + ";" +
                 pressuretemp.ToString() + ";" +
                 attitude.ToString() + ";" +
-                control.ToString() + "");
+                control.ToString() +
+                (UseBinaryProtocol ? ";1" : ""));
             /*Console.WriteLine("\nST;" +
                 basicgps.ToString() + ";" +
                 gyroaccraw.ToString() + ";" +
@@ -879,7 +1342,8 @@ namespace Communication
                 ppm + ";" +
                 pressuretemp + ";" +
                 attitude + ";" +
-                control + "");
+                control +
+                (UseBinaryProtocol ? ";1" : ""));
             Thread.Sleep(200);
         }
 
@@ -913,6 +1377,12 @@ namespace Communication
             _serialPort.WriteLine("\nDR;" + i.ToString() + "\n");
         }
 
+        public override void SendDatalogPageRequest(int page)
+        {
+            // binary chunked readout; unlike DR this doesn't stop the logging task
+            _serialPort.WriteLine("\nDP;" + page.ToString() + "\n");
+        }
+
         public override void SendNavigationInstruction(NavigationInstruction ni)
         {
             WriteChecksumLine("WN;" + ni.line.ToString() + ";" + (int)ni.opcode + ";" + 
@@ -940,6 +1410,44 @@ namespace Communication
             WriteChecksumLine("RN;");
         }
 
+        public override void SendNavigationHashRequest()
+        {
+            WriteChecksumLine("VN;");
+        }
+
+        public override void SendLinkBenchmark(int rate_hz, int seconds, int filler_bytes)
+        {
+            Benchmark.Reset();
+            WriteChecksumLine("BE;" + rate_hz + ";" + seconds + ";" + filler_bytes);
+        }
+
+        // The autopilot formats every line it confirms or reads back as an
+        // "ND;..." payload; those strings are cached verbatim per line, so
+        // the same crc16-ccitt the firmware runs over its own formatting can
+        // be reproduced here without worrying about float round-tripping.
+        private string[] nav_line_text = new string[72];   // MAX_GLUONSCRIPTCODES
+
+        public override int LocalNavigationCrc(int line_count)
+        {
+            int crc = 0xffff;
+
+            if (line_count > nav_line_text.Length)
+                return -1;
+            for (int i = 0; i < line_count; i++)
+            {
+                string text = nav_line_text[i];
+                if (text == null)
+                    return -1;   // never seen this line: nothing to verify against
+                foreach (char c in text)
+                {
+                    crc ^= ((byte)c) << 8;
+                    for (int b = 0; b < 8; b++)
+                        crc = ((crc & 0x8000) != 0 ? (crc << 1) ^ 0x1021 : (crc << 1)) & 0xffff;
+                }
+            }
+            return crc;
+        }
+
         public override void SendNavigationLoad()
         {
             WriteChecksumLine("LN;");
@@ -1016,16 +1524,14 @@ namespace Communication
                 if (_serialPort.BytesToWrite > 0)
                     Thread.Sleep(200);
                 _serialPort.WriteLine("\n$" + s + "*0" + Convert.ToString(chk, 16) + "\n");
-                if (logfile != null)
-                    logfile.WriteLine("-> \r\n$" + s + "*0" + Convert.ToString(chk, 16) + "\r\n");
+                LogSentText("-> \r\n$" + s + "*0" + Convert.ToString(chk, 16) + "\r\n");
                 //Console.WriteLine("\n$" + s + "*0" + Convert.ToString(chk, 16) + "\n");
             }
             else
             {
                 Console.WriteLine("\n$" + s + "*" + Convert.ToString(chk, 16) + "\n");
                 _serialPort.WriteLine("\n$" + s + "*" + Convert.ToString(chk, 16) + "\n");
-                if (logfile != null)
-                    logfile.WriteLine("-> \r\n$" + s + "*" + Convert.ToString(chk, 16) + "\n");
+                LogSentText("-> \r\n$" + s + "*" + Convert.ToString(chk, 16) + "\n");
             }
         }
 
@@ -25,6 +25,12 @@ namespace Communication
         public bool Play = true;
         public bool DoubleSpeed = false;
         public bool QuadSpeed = false;
+        // Extra playback speed multiplier, on top of the Double/QuadSpeed flags
+        public double PlaybackSpeed = 1.0;
+        // Fast scan drops the pacing sleeps and replays only every
+        // FastScanDecimation-th line: a 2 hour flight scans in minutes
+        public bool FastScan = false;
+        public int FastScanDecimation = 10;
 
         private string filename;
         public override string LogToFilename
@@ -79,8 +85,11 @@ namespace Communication
         // Datalog
         public override event ReceiveDatalogTableCommunicationFrame DatalogTableCommunicationReceived;
         public override event ReceiveDatalogLineCommunicationFrame DatalogLineCommunicationReceived;
+        public override event ReceiveDatalogPageChunkCommunicationFrame DatalogPageChunkCommunicationReceived;
         // Navigation
         public override event ReceiveNavigationInstructionCommunicationFrame NavigationInstructionCommunicationReceived;
+        public override event ReceiveNavigationHashCommunicationFrame NavigationHashCommunicationReceived;
+        public override event ReceiveLinkBenchmarkCommunicationFrame LinkBenchmarkCompleted;
         // ControlInfo
         public override event ReceiveControlInfoCommunicationFrame ControlInfoCommunicationReceived;
         public override event ReceiveServosCommunicationFrame ServosCommunicationReceived;
@@ -93,6 +102,15 @@ namespace Communication
         private string[] DatalogHeader;
         private System.IO.StreamReader file_to_replay;
 
+        // Index built on load: every line of the logfile with its timestamp
+        // relative to the first line. Two parallel lists (no tuples on this
+        // framework); a BinarySearch on replay_times gives instant seek.
+        private List<string> replay_lines = new List<string>();
+        private List<TimeSpan> replay_times = new List<TimeSpan>();
+        private int replay_pos = 0;
+        private int replay_seek = -1;   // requested position, -1 = none
+        private bool replay_closing = false;
+
         public override double SecondsConnectionLost()
         {
             return (DateTime.Now - LastValidFrame).TotalSeconds;
@@ -103,24 +121,116 @@ namespace Communication
             LastValidFrame = DateTime.Now;
             //_serialPort = new SerialPort();
             last_throughput_calculation = DateTime.Now;
-            file_to_replay = new StreamReader(filename);
+            if (BinaryLog.IsBinaryLog(filename))
+            {
+                // the binary container already carries the timestamps as
+                // ticks plus an index block, so no per-line parsing here
+                BinaryLog.Load(filename, replay_times, replay_lines);
+            }
+            else
+            {
+                file_to_replay = new StreamReader(filename);
+                BuildReplayIndex();
+                file_to_replay.Close();
+                file_to_replay = null;
+            }
             Open();
         }
 
-        DateTime last_timestamp = DateTime.MaxValue;
-        public KeyValuePair<TimeSpan, string> ReadReplayLine()
+        /*!
+         *    Reads the complete logfile once and fills the replay index.
+         *    Lines without a parsable [timestamp] prefix are skipped.
+         */
+        private void BuildReplayIndex()
         {
-            if (!file_to_replay.EndOfStream)
+            DateTime first_timestamp = DateTime.MinValue;
+            TimeSpan last_time = TimeSpan.Zero;
+            while (!file_to_replay.EndOfStream)
             {
                 string s = file_to_replay.ReadLine();
-                s = s.TrimStart('[');  // remove "[";
-                string[] parts = s.Split(']');
-                DateTime timestamp = DateTime.Parse(parts[0], CultureInfo.InvariantCulture);
-                TimeSpan delay = timestamp - last_timestamp;
-                if (delay.TotalSeconds < 0)
-                    delay = TimeSpan.Zero;
-                last_timestamp = timestamp;
-                return new KeyValuePair<TimeSpan, string>(delay, parts[1].TrimStart(' '));
+                try
+                {
+                    s = s.TrimStart('[');  // remove "[";
+                    string[] parts = s.Split(']');
+                    DateTime timestamp = DateTime.Parse(parts[0], CultureInfo.InvariantCulture);
+                    if (first_timestamp == DateTime.MinValue)
+                        first_timestamp = timestamp;
+                    TimeSpan t = timestamp - first_timestamp;
+                    if (t < last_time)  // clock stepped back during the recording
+                        t = last_time;
+                    last_time = t;
+                    replay_times.Add(t);
+                    replay_lines.Add(parts[1].TrimStart(' '));
+                }
+                catch (Exception e)
+                {
+                    // no timestamp prefix, not replayable
+                }
+            }
+        }
+
+        // Total length of the recorded session
+        public TimeSpan Duration
+        {
+            get
+            {
+                if (replay_times.Count == 0)
+                    return TimeSpan.Zero;
+                return replay_times[replay_times.Count - 1];
+            }
+        }
+
+        // Timestamp of the line that plays next
+        public TimeSpan Position
+        {
+            get
+            {
+                if (replay_times.Count == 0)
+                    return TimeSpan.Zero;
+                int p = replay_pos;
+                if (p >= replay_times.Count)
+                    p = replay_times.Count - 1;
+                return replay_times[p];
+            }
+        }
+
+        /*!
+         *    Jumps the playback to the first line at or after the given
+         *    timestamp. Takes effect before the next line is replayed;
+         *    seeking backwards after the recording ended resumes it.
+         */
+        public void SeekTo(TimeSpan t)
+        {
+            int i = replay_times.BinarySearch(t);
+            if (i < 0)
+                i = ~i;   // first line after t
+            if (i >= replay_lines.Count)
+                i = replay_lines.Count - 1;
+            replay_seek = i;
+        }
+
+        // Seek to a fraction (0..1) of the total duration, for a scrub bar
+        public void SeekFraction(double fraction)
+        {
+            SeekTo(TimeSpan.FromSeconds(Duration.TotalSeconds * fraction));
+        }
+
+        public KeyValuePair<TimeSpan, string> ReadReplayLine()
+        {
+            int seek = replay_seek;
+            if (seek >= 0)
+            {
+                replay_seek = -1;
+                replay_pos = seek;
+                // nothing to catch up with after a jump
+                return new KeyValuePair<TimeSpan, string>(TimeSpan.Zero, replay_lines[replay_pos++]);
+            }
+            if (replay_pos < replay_lines.Count)
+            {
+                TimeSpan delay = TimeSpan.Zero;
+                if (replay_pos > 0)
+                    delay = replay_times[replay_pos] - replay_times[replay_pos - 1];
+                return new KeyValuePair<TimeSpan, string>(delay, replay_lines[replay_pos++]);
             }
             else
                 return new KeyValuePair<TimeSpan, string>(TimeSpan.MaxValue, "");
@@ -167,6 +277,7 @@ namespace Communication
         {
             //_serialPort.Close();
             //_smartThreadPool.Shutdown(false, 100);
+            replay_closing = true;
             if (logfile != null)
                 logfile.Close();
             if (file_to_replay != null)
@@ -184,20 +295,50 @@ namespace Communication
             bool recognised_frame = true;
             string line = string.Empty;
 
-            while (file_to_replay != null && file_to_replay.BaseStream != null && !file_to_replay.EndOfStream)
+            while (!replay_closing)
             {
                 try
                 {
-                    while (!Play)
+                    while (!Play && replay_seek < 0 && !replay_closing)
                         Thread.Sleep(100);
+                    if (replay_closing)
+                        break;
+
+                    if (replay_pos >= replay_lines.Count && replay_seek < 0)
+                    {
+                        // end of the recording: pause instead of exiting, a
+                        // seek backwards resumes the review
+                        if (CommunicationAlive)
+                        {
+                            CommunicationAlive = false;
+                            if (CommunicationLost != null)
+                                CommunicationLost();
+                        }
+                        Play = false;
+                        continue;
+                    }
+
+                    if (FastScan && replay_seek < 0)
+                    {
+                        // decimated scan: skip all but every FastScanDecimation-th line
+                        int skip = FastScanDecimation - 1;
+                        while (skip-- > 0 && replay_pos < replay_lines.Count - 1)
+                            replay_pos++;
+                        Thread.Sleep(1);   // keep the gui responsive
+                    }
 
                     KeyValuePair<TimeSpan, string> kvp = ReadReplayLine();
-                    if (DoubleSpeed)
-                        Thread.Sleep((int)(kvp.Key.TotalMilliseconds / 2.0));
-                    else if (QuadSpeed)
-                        Thread.Sleep((int)(kvp.Key.TotalMilliseconds / 4.0));
-                    else
-                        Thread.Sleep(kvp.Key);
+                    if (!FastScan)
+                    {
+                        double speed = PlaybackSpeed;
+                        if (DoubleSpeed)
+                            speed *= 2.0;
+                        else if (QuadSpeed)
+                            speed *= 4.0;
+                        if (speed <= 0.0)
+                            speed = 1.0;
+                        Thread.Sleep((int)(kvp.Key.TotalMilliseconds / speed));
+                    }
                     //Console.WriteLine(kvp.Key.ToString() + " - " + kvp.Value);
                     line = kvp.Value;
 
@@ -592,8 +733,12 @@ namespace Communication
                 }
 
             }
-            CommunicationAlive = false;
-            CommunicationLost();
+            if (CommunicationAlive)
+            {
+                CommunicationAlive = false;
+                if (CommunicationLost != null)
+                    CommunicationLost();
+            }
 
             return null;
         }
@@ -679,6 +824,10 @@ namespace Communication
         {
         }
 
+        public override void SendDatalogPageRequest(int page)
+        {
+        }
+
         public override void SendNavigationInstruction(NavigationInstruction ni)
         {
         }
@@ -695,6 +844,14 @@ namespace Communication
         {
         }
 
+        public override void SendNavigationHashRequest()
+        {
+        }
+
+        public override void SendLinkBenchmark(int rate_hz, int seconds, int filler_bytes)
+        {
+        }
+
         public override void SendNavigationLoad()
         {
         }